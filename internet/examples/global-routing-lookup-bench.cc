@@ -0,0 +1,184 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures Ipv4GlobalRouting::RouteInput lookups per second against the
+// size of the routing table.
+//
+// A switch with one downlink and --ecmp uplinks gets, for each table size,
+// host routes to that many hosts (10.x.y.z), each reachable through every
+// uplink as in a fat-tree, plus one network route per /24 of hosts.  It then
+// forwards packets to random hosts, and to addresses only covered by the
+// network routes, through RouteInput.  The first lookup after the routes
+// are installed compiles the forwarding table; its cost is reported
+// separately.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/simple-net-device.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("GlobalRoutingLookupBenchmark");
+
+static uint64_t g_forwarded = 0; //!< packets forwarded
+
+/**
+ * \brief Count a forwarded packet.
+ */
+static void
+Forward (Ptr<Ipv4Route>, Ptr<const Packet>, const Ipv4Header &)
+{
+  ++g_forwarded;
+}
+
+/**
+ * \brief Drop a packet without a route.
+ */
+static void
+Error (Ptr<const Packet>, const Ipv4Header &, Socket::SocketErrno)
+{
+}
+
+/**
+ * \brief Add an interface with an address to a node.
+ * \param node the node
+ * \param address the address of the interface
+ * \return the device of the interface
+ */
+static Ptr<NetDevice>
+AddInterface (Ptr<Node> node, Ipv4Address address)
+{
+  Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+  device->SetAddress (Mac48Address::Allocate ());
+  node->AddDevice (device);
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  uint32_t interface = ipv4->AddInterface (device);
+  ipv4->AddAddress (interface, Ipv4InterfaceAddress (address, Ipv4Mask ("/24")));
+  ipv4->SetUp (interface);
+  return device;
+}
+
+/**
+ * \param i index of a host
+ * \return the address of the host
+ */
+static Ipv4Address
+HostAddress (uint32_t i)
+{
+  // 250 hosts per /24, starting at 10.0.0.1
+  return Ipv4Address (0x0a000000 + (i / 250) * 256 + i % 250 + 1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t ecmp = 8;
+  uint32_t lookups = 2000000;
+  uint32_t maxHosts = 65536;
+
+  CommandLine cmd;
+  cmd.AddValue ("ecmp", "Number of equal-cost uplinks", ecmp);
+  cmd.AddValue ("lookups", "Number of lookups per table size", lookups);
+  cmd.AddValue ("maxHosts", "Largest number of hosts", maxHosts);
+  cmd.Parse (argc, argv);
+
+  std::cout << std::setw (8) << "hosts" << std::setw (10) << "routes"
+            << std::setw (12) << "build ms" << std::setw (14) << "host Mlps"
+            << std::setw (14) << "network Mlps" << std::endl;
+
+  for (uint32_t hosts = 16; hosts <= maxHosts; hosts *= 4)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      InternetStackHelper stack;
+      stack.SetRoutingHelper (Ipv4StaticRoutingHelper ());
+      stack.Install (node);
+      Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+      Ptr<NetDevice> downlink = AddInterface (node, Ipv4Address ("192.168.0.1"));
+      for (uint32_t i = 1; i <= ecmp; ++i)
+        {
+          AddInterface (node, Ipv4Address (0xc0a80001 + (i << 8)));
+        }
+
+      Ptr<Ipv4GlobalRouting> routing = CreateObject<Ipv4GlobalRouting> ();
+      routing->SetIpv4 (ipv4);
+      for (uint32_t h = 0; h < hosts; ++h)
+        {
+          for (uint32_t i = 1; i <= ecmp; ++i)
+            {
+              routing->AddHostRouteTo (HostAddress (h), Ipv4Address (0xc0a80002 + (i << 8)), i);
+            }
+        }
+      for (uint32_t net = 0; net <= (hosts - 1) / 250; ++net)
+        {
+          for (uint32_t i = 1; i <= ecmp; ++i)
+            {
+              routing->AddNetworkRouteTo (Ipv4Address (0x0a000000 + net * 256), Ipv4Mask ("/24"),
+                                          Ipv4Address (0xc0a80002 + (i << 8)), i);
+            }
+        }
+
+      Ptr<UniformRandomVariable> rand = CreateObject<UniformRandomVariable> ();
+      std::vector<Ipv4Header> hostHeaders (1024);
+      std::vector<Ipv4Header> networkHeaders (1024);
+      for (uint32_t i = 0; i < hostHeaders.size (); ++i)
+        {
+          Ipv4Address host = HostAddress (rand->GetInteger (0, hosts - 1));
+          hostHeaders[i].SetDestination (host);
+          // Host 251 to 254 of each /24 have no host route
+          networkHeaders[i].SetDestination (Ipv4Address ((host.Get () & 0xffffff00) + 251 + i % 4));
+        }
+
+      Ptr<Packet> p = Create<Packet> (100);
+      Ipv4RoutingProtocol::UnicastForwardCallback ucb = MakeCallback (&Forward);
+      Ipv4RoutingProtocol::MulticastForwardCallback mcb;
+      Ipv4RoutingProtocol::LocalDeliverCallback lcb;
+      Ipv4RoutingProtocol::ErrorCallback ecb = MakeCallback (&Error);
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      routing->RouteInput (p, hostHeaders[0], downlink, ucb, mcb, lcb, ecb);
+      double buildMs = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+      double rate[2];
+      std::vector<Ipv4Header> const *headers[2] = { &hostHeaders, &networkHeaders };
+      for (uint32_t k = 0; k < 2; ++k)
+        {
+          g_forwarded = 0;
+          start = std::chrono::steady_clock::now ();
+          for (uint32_t i = 0; i < lookups; ++i)
+            {
+              routing->RouteInput (p, (*headers[k])[i & 1023], downlink, ucb, mcb, lcb, ecb);
+            }
+          double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+          NS_ABORT_MSG_IF (g_forwarded != lookups, "Some packets were not forwarded");
+          rate[k] = lookups / seconds / 1e6;
+        }
+
+      std::cout << std::setw (8) << hosts << std::setw (10) << routing->GetNRoutes ()
+                << std::fixed << std::setprecision (2)
+                << std::setw (12) << buildMs << std::setw (14) << rate[0]
+                << std::setw (14) << rate[1] << std::endl;
+
+      routing->Dispose ();
+      Simulator::Destroy ();
+    }
+  return 0;
+}
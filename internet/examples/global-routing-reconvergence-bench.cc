@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the time taken to update the global routes after a link fails
+// and comes back.
+//
+// For each size given with --sizes, the routers form the topology of
+// global-routing-scale-bench (a ring with a chord from every other router
+// to a random one).  --failures random links are then taken down and up
+// again, one at a time.  After each change, the routes are either updated
+// with Ipv4GlobalRoutingHelper::UpdateRoutingTables, or recomputed from
+// scratch with RecomputeRoutingTables; the mean time of both is reported.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/simple-net-device-helper.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("GlobalRoutingReconvergenceBenchmark");
+
+/**
+ * \brief Connect two routers with a new point-to-point link.
+ * \param helper the device helper
+ * \param address the address helper, moved to the next subnet
+ * \param a first router
+ * \param b second router
+ * \return the devices of the link
+ */
+static NetDeviceContainer
+Connect (SimpleNetDeviceHelper &helper, Ipv4AddressHelper &address, Ptr<Node> a, Ptr<Node> b)
+{
+  NodeContainer pair (a, b);
+  NetDeviceContainer devices = helper.Install (pair);
+  address.Assign (devices);
+  address.NewNetwork ();
+  return devices;
+}
+
+/**
+ * \brief Take both interfaces of a link down or up.
+ * \param link the devices of the link
+ * \param up whether to take the interfaces up
+ */
+static void
+SetLink (NetDeviceContainer const &link, bool up)
+{
+  for (uint32_t i = 0; i < link.GetN (); ++i)
+    {
+      Ptr<Ipv4> ipv4 = link.Get (i)->GetNode ()->GetObject<Ipv4> ();
+      int32_t interface = ipv4->GetInterfaceForDevice (link.Get (i));
+      if (up)
+        {
+          ipv4->SetUp (interface);
+        }
+      else
+        {
+          ipv4->SetDown (interface);
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string sizes = "250,500,1000";
+  uint32_t failures = 5;
+  uint32_t threads = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("sizes", "Comma-separated numbers of routers", sizes);
+  cmd.AddValue ("failures", "Number of links taken down and up again", failures);
+  cmd.AddValue ("threads", "Number of threads running the SPF calculations (0 for one per processor)", threads);
+  cmd.Parse (argc, argv);
+
+  GlobalValue::Bind ("GlobalRoutingThreads", UintegerValue (threads));
+
+  std::cout << std::setw (8) << "routers" << std::setw (8) << "links"
+            << std::setw (14) << "update ms" << std::setw (14) << "recompute ms"
+            << std::setw (10) << "speedup" << std::endl;
+
+  std::istringstream list (sizes);
+  std::string item;
+  while (std::getline (list, item, ','))
+    {
+      uint32_t n = std::atoi (item.c_str ());
+      NodeContainer routers;
+      routers.Create (n);
+      InternetStackHelper stack;
+      stack.Install (routers);
+
+      SimpleNetDeviceHelper helper;
+      helper.SetNetDevicePointToPointMode (true);
+      Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+      Ptr<UniformRandomVariable> rand = CreateObject<UniformRandomVariable> ();
+      std::vector<NetDeviceContainer> links;
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          links.push_back (Connect (helper, address, routers.Get (i), routers.Get ((i + 1) % n)));
+          uint32_t j = rand->GetInteger (0, n - 1);
+          if (i % 2 == 0 && j != i && j != (i + 1) % n && (j + 1) % n != i)
+            {
+              links.push_back (Connect (helper, address, routers.Get (i), routers.Get (j)));
+            }
+        }
+      std::vector<uint32_t> failed;
+      for (uint32_t i = 0; i < failures; ++i)
+        {
+          failed.push_back (rand->GetInteger (0, links.size () - 1));
+        }
+
+      double seconds[2] = { 0, 0 };
+      for (uint32_t k = 0; k < 2; ++k)
+        {
+          // The first update computes the routes from scratch, so is not timed
+          Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+          if (k == 0)
+            {
+              Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+            }
+          for (uint32_t i = 0; i < failed.size (); ++i)
+            {
+              for (uint32_t up = 0; up < 2; ++up)
+                {
+                  SetLink (links[failed[i]], up);
+                  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+                  if (k == 0)
+                    {
+                      Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+                    }
+                  else
+                    {
+                      Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+                    }
+                  seconds[k] += std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+                }
+            }
+        }
+
+      double changes = 2.0 * failed.size ();
+      std::cout << std::setw (8) << n << std::setw (8) << links.size ()
+                << std::fixed << std::setprecision (2)
+                << std::setw (14) << 1e3 * seconds[0] / changes
+                << std::setw (14) << 1e3 * seconds[1] / changes
+                << std::setw (10) << seconds[1] / seconds[0] << std::endl;
+
+      Simulator::Destroy ();
+    }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the time taken to build global routes for large topologies.
+//
+// For each size given with --sizes, the routers form a ring with a chord
+// from every other router to a random one (so about 1.5 point-to-point
+// links per router, each a /30), and the global routes are built with
+// GlobalRouteManager.  The time of the two phases (building the link state
+// database and running the SPF calculation of every router) is reported.
+// The SPF calculations run on --threads threads (GlobalRoutingThreads).
+//
+// Every router ends up with a route to every link, so memory grows as the
+// square of the number of routers: 10000 routers need several GB.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/global-route-manager.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("GlobalRoutingScaleBenchmark");
+
+/**
+ * \brief Connect two routers with a new point-to-point link.
+ * \param helper the device helper
+ * \param address the address helper, moved to the next subnet
+ * \param a first router
+ * \param b second router
+ */
+static void
+Connect (SimpleNetDeviceHelper &helper, Ipv4AddressHelper &address, Ptr<Node> a, Ptr<Node> b)
+{
+  NodeContainer pair (a, b);
+  NetDeviceContainer devices = helper.Install (pair);
+  address.Assign (devices);
+  address.NewNetwork ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string sizes = "1000,5000,10000";
+  uint32_t threads = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("sizes", "Comma-separated numbers of routers", sizes);
+  cmd.AddValue ("threads", "Number of threads running the SPF calculations (0 for one per processor)", threads);
+  cmd.Parse (argc, argv);
+
+  GlobalValue::Bind ("GlobalRoutingThreads", UintegerValue (threads));
+
+  std::cout << std::setw (8) << "routers" << std::setw (8) << "links"
+            << std::setw (14) << "database s" << std::setw (14) << "SPF s"
+            << std::setw (14) << "routes/node" << std::endl;
+
+  std::istringstream list (sizes);
+  std::string item;
+  while (std::getline (list, item, ','))
+    {
+      uint32_t n = std::atoi (item.c_str ());
+      NodeContainer routers;
+      routers.Create (n);
+      InternetStackHelper stack;
+      stack.Install (routers);
+
+      SimpleNetDeviceHelper helper;
+      helper.SetNetDevicePointToPointMode (true);
+      Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+      Ptr<UniformRandomVariable> rand = CreateObject<UniformRandomVariable> ();
+      uint32_t links = 0;
+      for (uint32_t i = 0; i < n; ++i)
+        {
+          Connect (helper, address, routers.Get (i), routers.Get ((i + 1) % n));
+          ++links;
+          uint32_t j = rand->GetInteger (0, n - 1);
+          if (i % 2 == 0 && j != i && j != (i + 1) % n && (j + 1) % n != i)
+            {
+              Connect (helper, address, routers.Get (i), routers.Get (j));
+              ++links;
+            }
+        }
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      GlobalRouteManager::BuildGlobalRoutingDatabase ();
+      std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now ();
+      GlobalRouteManager::InitializeRoutes ();
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now ();
+
+      Ptr<Ipv4RoutingProtocol> protocol = routers.Get (0)->GetObject<Ipv4> ()->GetRoutingProtocol ();
+      Ptr<Ipv4GlobalRouting> routing = Ipv4RoutingHelper::GetRouting<Ipv4GlobalRouting> (protocol);
+      std::cout << std::setw (8) << n << std::setw (8) << links
+                << std::fixed << std::setprecision (3)
+                << std::setw (14) << std::chrono::duration<double> (built - start).count ()
+                << std::setw (14) << std::chrono::duration<double> (end - built).count ()
+                << std::setw (14) << routing->GetNRoutes () << std::endl;
+
+      Simulator::Destroy ();
+    }
+  return 0;
+}
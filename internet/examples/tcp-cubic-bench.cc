@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the per-ACK cost of the congestion control algorithms.
+//
+// An ACK clock feeds --acks ACKs, one per segment, --rtt apart per window,
+// to a congestion control algorithm, which calls PktsAcked and
+// IncreaseWindow as TcpSocketBase does.  Each time cWnd reaches the window
+// size, a loss halves it through GetSsThresh, so that CUBIC goes through
+// its epochs and takes its cube roots.  The "none" algorithm only runs the
+// ACK clock, the cost of the events of the simulator.  For each window
+// size, the program reports the time and the heap allocations per ACK.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/tcp-congestion-ops.h"
+#include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-bic.h"
+#include "ns3/tcp-cubic.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpCubicBenchmark");
+
+static uint64_t g_allocations = 0; //!< operator new calls so far
+
+void *
+operator new (std::size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+/**
+ * \brief Feed an ACK to a congestion control algorithm, and schedule the next.
+ * \param cong the algorithm, or 0 for the ACK clock alone
+ * \param tcb the socket state
+ * \param window cWnd, in segments, at which a loss happens
+ * \param rtt the RTT
+ * \param left ACKs left, this one included
+ */
+static void
+Ack (Ptr<TcpCongestionOps> cong, Ptr<TcpSocketState> tcb, uint32_t window, Time rtt,
+     uint32_t left)
+{
+  tcb->m_lastAckedSeq += tcb->m_segmentSize;
+  tcb->m_highTxMark = tcb->m_lastAckedSeq + tcb->m_cWnd;
+
+  if (cong != 0)
+    {
+      cong->PktsAcked (tcb, 1, rtt);
+      cong->IncreaseWindow (tcb, 1);
+      if (tcb->GetCwndInSegments () >= window)
+        {
+          tcb->m_ssThresh = cong->GetSsThresh (tcb, tcb->m_cWnd);
+          tcb->m_cWnd = tcb->m_ssThresh;
+        }
+    }
+
+  if (--left > 0)
+    {
+      Time spacing = TimeStep (rtt.GetTimeStep () / tcb->GetCwndInSegments ());
+      Simulator::Schedule (spacing, &Ack, cong, tcb, window, rtt, left);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t acks = 1000000;
+  uint32_t segmentSize = 1448;
+  Time rtt = MilliSeconds (10);
+  uint32_t maxWindow = 16384;
+
+  CommandLine cmd;
+  cmd.AddValue ("acks", "Number of ACKs per window size and algorithm", acks);
+  cmd.AddValue ("segmentSize", "Segment size", segmentSize);
+  cmd.AddValue ("rtt", "Round trip time", rtt);
+  cmd.AddValue ("maxWindow", "Largest window, in segments", maxWindow);
+  cmd.Parse (argc, argv);
+
+  const char *algorithms[] = { "none", "ns3::TcpNewReno", "ns3::TcpBic", "ns3::TcpCubic" };
+
+  std::cout << std::setw (10) << "window" << std::setw (18) << "algorithm"
+            << std::setw (10) << "ns/ack" << std::setw (12) << "allocs/ack" << std::endl;
+
+  for (uint32_t window = 16; window <= maxWindow; window *= 4)
+    {
+      for (uint32_t i = 0; i < sizeof (algorithms) / sizeof (algorithms[0]); ++i)
+        {
+          std::string name = algorithms[i];
+          Ptr<TcpCongestionOps> cong;
+          if (name != "none")
+            {
+              ObjectFactory factory (name);
+              cong = factory.Create<TcpCongestionOps> ();
+            }
+
+          Ptr<TcpSocketState> tcb = CreateObject<TcpSocketState> ();
+          tcb->m_segmentSize = segmentSize;
+          tcb->m_cWnd = window / 2 * segmentSize;
+          tcb->m_ssThresh = UINT32_MAX;
+          tcb->m_initialCWnd = 10;
+
+          Simulator::ScheduleNow (&Ack, cong, tcb, window, rtt, acks);
+
+          uint64_t allocations = g_allocations;
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+          Simulator::Run ();
+          double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+          std::cout << std::setw (10) << window << std::setw (18) << name << std::fixed
+                    << std::setw (10) << std::setprecision (1) << seconds * 1e9 / acks
+                    << std::setw (12) << std::setprecision (2)
+                    << double (g_allocations - allocations) / acks << std::endl;
+
+          Simulator::Destroy ();
+        }
+    }
+  return 0;
+}
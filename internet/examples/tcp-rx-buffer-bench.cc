@@ -0,0 +1,141 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the cost of TcpRxBuffer with reordered segments.
+//
+// The segments are sprayed over --paths paths, and each window of segments
+// arrives one path after the other: the first path delivers segments 0,
+// paths, 2 * paths, ..., then the second path fills the holes after them,
+// and so on, so that up to window / paths holes are open at once.  The
+// application reads all the in-order data after each segment.  For each
+// window size, the program reports the time and the heap allocations per
+// segment.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/tcp-header.h"
+#include "ns3/tcp-rx-buffer.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpRxBufferBenchmark");
+
+static uint64_t g_allocations = 0; //!< operator new calls so far
+
+void *
+operator new (std::size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+/**
+ * \brief Receive sprayed segments in a buffer.
+ * \param buffer the buffer
+ * \param segments number of segments to receive
+ * \param segmentSize segment size
+ * \param window number of segments reordered together
+ * \param paths number of paths
+ * \param chain whether to read with ExtractChain rather than Extract
+ */
+static void
+Receive (Ptr<TcpRxBuffer> buffer, uint32_t segments, uint32_t segmentSize,
+         uint32_t window, uint32_t paths, bool chain)
+{
+  Ptr<Packet> data = Create<Packet> (segmentSize);
+  TcpRxBuffer::PacketChain packets;
+  TcpHeader header;
+  for (uint32_t i = 0; i < segments; i += window)
+    {
+      SequenceNumber32 base = buffer->NextRxSequence ();
+      for (uint32_t path = 0; path < paths; ++path)
+        {
+          for (uint32_t j = path; j < window; j += paths)
+            {
+              header.SetSequenceNumber (base + SequenceNumber32 (j * segmentSize));
+              buffer->Add (data, header);
+              if (chain)
+                {
+                  packets.clear ();
+                  buffer->ExtractChain (buffer->Available (), packets);
+                }
+              else
+                {
+                  buffer->Extract (buffer->Available ());
+                }
+            }
+        }
+      NS_ABORT_MSG_IF (buffer->Size () != 0, "Data left in the buffer");
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t segments = 1000000;
+  uint32_t segmentSize = 1448;
+  uint32_t paths = 4;
+  uint32_t maxWindow = 16384;
+  bool chain = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("segments", "Number of segments per window size", segments);
+  cmd.AddValue ("segmentSize", "Segment size", segmentSize);
+  cmd.AddValue ("paths", "Number of paths the segments are sprayed over", paths);
+  cmd.AddValue ("maxWindow", "Largest window, in segments", maxWindow);
+  cmd.AddValue ("chain", "Read with ExtractChain rather than Extract", chain);
+  cmd.Parse (argc, argv);
+
+  std::cout << std::setw (10) << "window" << std::setw (14) << "ns/segment"
+            << std::setw (16) << "allocs/segment" << std::endl;
+
+  for (uint32_t window = 16; window <= maxWindow; window *= 4)
+    {
+      Ptr<TcpRxBuffer> buffer = CreateObject<TcpRxBuffer> (1);
+      buffer->SetMaxBufferSize (window * segmentSize);
+
+      // Warm up
+      Receive (buffer, 4 * window, segmentSize, window, paths, chain);
+
+      uint64_t allocations = g_allocations;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      Receive (buffer, segments, segmentSize, window, paths, chain);
+      double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+      std::cout << std::setw (10) << window << std::fixed
+                << std::setw (14) << std::setprecision (1) << seconds * 1e9 / segments
+                << std::setw (16) << std::setprecision (2)
+                << double (g_allocations - allocations) / segments << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,226 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the cost of short TCP connections on a busy node.
+//
+// A client and a server on the same node exchange --connections short RPCs
+// over the loopback interface: the client connects, sends a request, and
+// the server answers and closes the connection.  --parallel connections
+// are open at once, and --open idle sockets stay bound on the node all
+// along, as the listening and long-lived sockets of a server would.  The
+// maximum segment lifetime is 0, so that the connections leave TIME_WAIT
+// at once.  For each number of idle sockets, the program reports the time
+// and the heap allocations per connection.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpSocketChurnBenchmark");
+
+static uint64_t g_allocations = 0; //!< operator new calls so far
+
+void *
+operator new (std::size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+static const uint16_t SERVER_PORT = 9;      //!< port of the server
+static const uint32_t REQUEST_SIZE = 100;   //!< size of the requests
+static const uint32_t RESPONSE_SIZE = 100;  //!< size of the responses
+
+static uint32_t g_remaining = 0; //!< connections not started yet
+static uint32_t g_completed = 0; //!< connections closed by the client
+
+static void StartConnection (Ptr<Node> node);
+
+/**
+ * \brief Send the request once the connection is established.
+ * \param socket the client socket
+ */
+static void
+ConnectionSucceeded (Ptr<Socket> socket)
+{
+  socket->Send (Create<Packet> (REQUEST_SIZE));
+}
+
+/**
+ * \brief Read the response.
+ * \param socket the client socket
+ */
+static void
+ClientRecv (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+    }
+}
+
+/**
+ * \brief Close the client side, and start another connection.
+ * \param socket the client socket
+ */
+static void
+ClientClose (Ptr<Socket> socket)
+{
+  socket->Close ();
+  ++g_completed;
+  StartConnection (socket->GetNode ());
+}
+
+/**
+ * \brief Start a connection, if any is left.
+ * \param node the node
+ */
+static void
+StartConnection (Ptr<Node> node)
+{
+  if (g_remaining == 0)
+    {
+      return;
+    }
+  --g_remaining;
+  Ptr<Socket> socket = Socket::CreateSocket (node, TcpSocketFactory::GetTypeId ());
+  socket->SetConnectCallback (MakeCallback (&ConnectionSucceeded),
+                              MakeNullCallback<void, Ptr<Socket> > ());
+  socket->SetRecvCallback (MakeCallback (&ClientRecv));
+  socket->SetCloseCallbacks (MakeCallback (&ClientClose), MakeCallback (&ClientClose));
+  socket->Bind ();
+  socket->Connect (InetSocketAddress (Ipv4Address::GetLoopback (), SERVER_PORT));
+}
+
+/**
+ * \brief Answer the request, and close the connection.
+ * \param socket the server socket
+ */
+static void
+ServerRecv (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+    }
+  socket->Send (Create<Packet> (RESPONSE_SIZE));
+  socket->Close ();
+}
+
+/**
+ * \brief Accept a connection.
+ * \param socket the server socket
+ * \param from the address of the client
+ */
+static void
+ServerAccept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&ServerRecv));
+}
+
+/**
+ * \brief Run connections.
+ * \param node the node
+ * \param connections number of connections
+ * \param parallel number of connections open at once
+ */
+static void
+Churn (Ptr<Node> node, uint32_t connections, uint32_t parallel)
+{
+  g_remaining = connections;
+  g_completed = 0;
+  for (uint32_t i = 0; i < parallel; ++i)
+    {
+      Simulator::ScheduleNow (&StartConnection, node);
+    }
+  Simulator::Run ();
+  NS_ABORT_MSG_IF (g_completed != connections, "Only " << g_completed << " connections completed");
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t connections = 1000000;
+  uint32_t parallel = 16;
+  uint32_t maxOpen = 16384;
+
+  CommandLine cmd;
+  cmd.AddValue ("connections", "Number of connections per number of idle sockets", connections);
+  cmd.AddValue ("parallel", "Number of connections open at once", parallel);
+  cmd.AddValue ("maxOpen", "Largest number of idle sockets", maxOpen);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::TcpSocketBase::MaxSegLifetime", DoubleValue (0));
+
+  std::cout << std::setw (10) << "open" << std::setw (14) << "ns/conn"
+            << std::setw (16) << "allocs/conn" << std::endl;
+
+  for (uint32_t open = 16; open <= maxOpen; open *= 4)
+    {
+      Ptr<Node> node = CreateObject<Node> ();
+      InternetStackHelper stack;
+      stack.Install (node);
+
+      Ptr<Socket> server = Socket::CreateSocket (node, TcpSocketFactory::GetTypeId ());
+      server->Bind (InetSocketAddress (Ipv4Address::GetAny (), SERVER_PORT));
+      server->Listen ();
+      server->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                 MakeCallback (&ServerAccept));
+
+      // Idle sockets, bound below the ephemeral ports of the clients
+      std::vector<Ptr<Socket> > idle;
+      for (uint32_t i = 0; i < open; ++i)
+        {
+          Ptr<Socket> socket = Socket::CreateSocket (node, TcpSocketFactory::GetTypeId ());
+          socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), 10000 + i));
+          idle.push_back (socket);
+        }
+
+      // Warm up
+      Churn (node, 4 * parallel, parallel);
+
+      uint64_t allocations = g_allocations;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      Churn (node, connections, parallel);
+      double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+      std::cout << std::setw (10) << open << std::fixed
+                << std::setw (14) << std::setprecision (1) << seconds * 1e9 / connections
+                << std::setw (16) << std::setprecision (2)
+                << double (g_allocations - allocations) / connections << std::endl;
+
+      Simulator::Destroy ();
+    }
+  return 0;
+}
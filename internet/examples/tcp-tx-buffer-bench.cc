@@ -0,0 +1,126 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the cost of TcpTxBuffer in a bulk transfer.
+//
+// The application writes --write bytes at a time, as long as the buffer has
+// room; the sender keeps a window of segments in flight, sending each with
+// CopyFromSequence and checking the pipe with BytesInFlight, and the
+// receiver acknowledges every other segment with DiscardUpTo.  For each
+// window size, the program reports the time and the heap allocations per
+// segment, once the buffer has reached its steady state.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/tcp-tx-buffer.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpTxBufferBenchmark");
+
+static uint64_t g_allocations = 0; //!< operator new calls so far
+
+void *
+operator new (std::size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+/**
+ * \brief Run a bulk transfer through a buffer.
+ * \param buffer the buffer
+ * \param segments number of segments to send
+ * \param segmentSize segment size
+ * \param window number of segments in flight
+ * \param write size of the application writes
+ */
+static void
+Transfer (Ptr<TcpTxBuffer> buffer, uint32_t segments, uint32_t segmentSize,
+          uint32_t window, uint32_t write)
+{
+  Ptr<Packet> data = Create<Packet> (write);
+  for (uint32_t i = 0; i < segments; ++i)
+    {
+      while (buffer->Available () >= write)
+        {
+          buffer->Add (data);
+        }
+      SequenceNumber32 next = buffer->HeadSequence () + buffer->BytesInFlight (3, segmentSize);
+      Ptr<Packet> segment = buffer->CopyFromSequence (segmentSize, next);
+      NS_ABORT_MSG_IF (segment->GetSize () != segmentSize, "Short segment");
+      if (buffer->BytesInFlight (3, segmentSize) >= window * segmentSize)
+        {
+          buffer->DiscardUpTo (buffer->HeadSequence () + 2 * segmentSize);
+        }
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t segments = 1000000;
+  uint32_t segmentSize = 1448;
+  uint32_t write = 65536;
+  uint32_t maxWindow = 16384;
+
+  CommandLine cmd;
+  cmd.AddValue ("segments", "Number of segments per window size", segments);
+  cmd.AddValue ("segmentSize", "Segment size", segmentSize);
+  cmd.AddValue ("write", "Size of the application writes", write);
+  cmd.AddValue ("maxWindow", "Largest window, in segments", maxWindow);
+  cmd.Parse (argc, argv);
+
+  std::cout << std::setw (10) << "window" << std::setw (14) << "ns/segment"
+            << std::setw (16) << "allocs/segment" << std::endl;
+
+  for (uint32_t window = 16; window <= maxWindow; window *= 4)
+    {
+      Ptr<TcpTxBuffer> buffer = CreateObject<TcpTxBuffer> (1);
+      buffer->SetMaxBufferSize ((window + 2) * segmentSize + write);
+
+      // Warm up, until the window and the buffer are full
+      Transfer (buffer, 4 * window, segmentSize, window, write);
+
+      uint64_t allocations = g_allocations;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      Transfer (buffer, segments, segmentSize, window, write);
+      double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+      std::cout << std::setw (10) << window << std::fixed
+                << std::setw (14) << std::setprecision (1) << seconds * 1e9 / segments
+                << std::setw (16) << std::setprecision (2)
+                << double (g_allocations - allocations) / segments << std::endl;
+    }
+  return 0;
+}
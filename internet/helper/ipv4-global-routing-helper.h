@@ -84,6 +84,21 @@ public:
    *
    */
   static void RecomputeRoutingTables (void);
+  /**
+   * \brief Update the routes after links went up or down.
+   *
+   * Gives the same routes as RecomputeRoutingTables(), but only the routes
+   * depending on the links that changed since the previous call are
+   * recomputed.  The routes replaced go to the end of the routing table,
+   * which does not change the next hops as long as the networks of the
+   * changed links do not overlap other networks; otherwise all the routes
+   * are recomputed.  The first call recomputes all the routes and keeps the
+   * shortest path tree of each router, which takes memory proportional to
+   * the square of the number of routers.
+   *
+   * \see GlobalRouteManagerImpl::UpdateGlobalRoutes
+   */
+  static void UpdateRoutingTables (void);
 private:
   /**
    * \brief Assignment operator declared private and not implemented to disallow
@@ -86,7 +86,9 @@ ArpCache::GetTypeId (void)
 
 ArpCache::ArpCache ()
   : m_device (0), 
-    m_interface (0)
+    m_interface (0),
+    m_firstWaitReply (0),
+    m_lastWaitReply (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -195,42 +197,43 @@ void
 ArpCache::HandleWaitReplyTimeout (void)
 {
   NS_LOG_FUNCTION (this);
-  ArpCache::Entry* entry;
   bool restartWaitReplyTimer = false;
-  for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++) 
+  // Only the entries in WAIT_REPLY state are visited.  Marking an entry
+  // dead takes it off the list, so the next one is fetched first; the
+  // entries entering WAIT_REPLY meanwhile are appended and visited too, as
+  // they would be by a scan of the whole cache.
+  ArpCache::Entry *next = m_firstWaitReply;
+  while (next != 0)
     {
-      entry = (*i).second;
-      if (entry != 0 && entry->IsWaitReply ())
+      ArpCache::Entry *entry = next;
+      next = entry->m_nextWaitReply;
+      if (entry->GetRetries () < m_maxRetries)
         {
-          if (entry->GetRetries () < m_maxRetries)
-            {
-              NS_LOG_LOGIC ("node="<< m_device->GetNode ()->GetId () <<
-                            ", ArpWaitTimeout for " << entry->GetIpv4Address () <<
-                            " expired -- retransmitting arp request since retries = " <<
-                            entry->GetRetries ());
-              m_arpRequestCallback (this, entry->GetIpv4Address ());
-              restartWaitReplyTimer = true;
-              entry->IncrementRetries ();
-            }
-          else
+          NS_LOG_LOGIC ("node="<< m_device->GetNode ()->GetId () <<
+                        ", ArpWaitTimeout for " << entry->GetIpv4Address () <<
+                        " expired -- retransmitting arp request since retries = " <<
+                        entry->GetRetries ());
+          m_arpRequestCallback (this, entry->GetIpv4Address ());
+          restartWaitReplyTimer = true;
+          entry->IncrementRetries ();
+        }
+      else
+        {
+          NS_LOG_LOGIC ("node="<<m_device->GetNode ()->GetId () <<
+                        ", wait reply for " << entry->GetIpv4Address () <<
+                        " expired -- drop since max retries exceeded: " <<
+                        entry->GetRetries ());
+          entry->MarkDead ();
+          entry->ClearRetries ();
+          Ipv4PayloadHeaderPair pending = entry->DequeuePending ();
+          while (pending.first != 0)
             {
-              NS_LOG_LOGIC ("node="<<m_device->GetNode ()->GetId () <<
-                            ", wait reply for " << entry->GetIpv4Address () <<
-                            " expired -- drop since max retries exceeded: " <<
-                            entry->GetRetries ());
-              entry->MarkDead ();
-              entry->ClearRetries ();
-              Ipv4PayloadHeaderPair pending = entry->DequeuePending ();
-              while (pending.first != 0)
-                {
-                  // add the Ipv4 header for tracing purposes
-                  pending.first->AddHeader (pending.second);
-                  m_dropTrace (pending.first);
-                  pending = entry->DequeuePending ();
-                }
+              // add the Ipv4 header for tracing purposes
+              pending.first->AddHeader (pending.second);
+              m_dropTrace (pending.first);
+              pending = entry->DequeuePending ();
             }
         }
-
     }
   if (restartWaitReplyTimer)
     {
@@ -240,15 +243,54 @@ ArpCache::HandleWaitReplyTimeout (void)
     }
 }
 
+void
+ArpCache::LinkWaitReply (ArpCache::Entry *entry)
+{
+  NS_LOG_FUNCTION (this << entry);
+  entry->m_prevWaitReply = m_lastWaitReply;
+  entry->m_nextWaitReply = 0;
+  if (m_lastWaitReply != 0)
+    {
+      m_lastWaitReply->m_nextWaitReply = entry;
+    }
+  else
+    {
+      m_firstWaitReply = entry;
+    }
+  m_lastWaitReply = entry;
+}
+
+void
+ArpCache::UnlinkWaitReply (ArpCache::Entry *entry)
+{
+  NS_LOG_FUNCTION (this << entry);
+  if (entry->m_prevWaitReply != 0)
+    {
+      entry->m_prevWaitReply->m_nextWaitReply = entry->m_nextWaitReply;
+    }
+  else
+    {
+      m_firstWaitReply = entry->m_nextWaitReply;
+    }
+  if (entry->m_nextWaitReply != 0)
+    {
+      entry->m_nextWaitReply->m_prevWaitReply = entry->m_prevWaitReply;
+    }
+  else
+    {
+      m_lastWaitReply = entry->m_prevWaitReply;
+    }
+  entry->m_prevWaitReply = 0;
+  entry->m_nextWaitReply = 0;
+}
+
 void 
 ArpCache::Flush (void)
 {
   NS_LOG_FUNCTION (this);
-  for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++) 
-    {
-      delete (*i).second;
-    }
-  m_arpCache.erase (m_arpCache.begin (), m_arpCache.end ());
+  m_arpCache.Clear ();
+  m_firstWaitReply = 0;
+  m_lastWaitReply = 0;
   if (m_waitReplyTimer.IsRunning ())
     {
       NS_LOG_LOGIC ("Stopping WaitReplyTimer at " << Simulator::Now ().GetSeconds () << " due to ArpCache flush");
@@ -262,9 +304,14 @@ ArpCache::PrintArpCache (Ptr<OutputStreamWrapper> stream)
   NS_LOG_FUNCTION (this << stream);
   std::ostream* os = stream->GetStream ();
 
-  for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++)
+  for (uint32_t i = 0; i < m_arpCache.GetNSlots (); i++)
     {
-      *os << i->first << " dev ";
+      ArpCache::Entry *entry = m_arpCache.GetSlot (i);
+      if (entry == 0)
+        {
+          continue;
+        }
+      *os << entry->GetIpv4Address () << " dev ";
       std::string found = Names::FindName (m_device);
       if (Names::FindName (m_device) != "")
         {
@@ -275,17 +322,17 @@ ArpCache::PrintArpCache (Ptr<OutputStreamWrapper> stream)
           *os << static_cast<int> (m_device->GetIfIndex ());
         }
 
-      *os << " lladdr " << i->second->GetMacAddress ();
+      *os << " lladdr " << entry->GetMacAddress ();
 
-      if (i->second->IsAlive ())
+      if (entry->IsAlive ())
         {
           *os << " REACHABLE\n";
         }
-      else if (i->second->IsWaitReply ())
+      else if (entry->IsWaitReply ())
         {
           *os << " DELAY\n";
         }
-      else if (i->second->IsPermanent ())
+      else if (entry->IsPermanent ())
 	{
 	  *os << " PERMANENT\n";
 	}
@@ -302,10 +349,10 @@ ArpCache::LookupInverse (Address to)
   NS_LOG_FUNCTION (this << to);
 
   std::list<ArpCache::Entry *> entryList;
-  for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++)
+  for (uint32_t i = 0; i < m_arpCache.GetNSlots (); i++)
     {
-      ArpCache::Entry *entry = (*i).second;
-      if (entry->GetMacAddress () == to)
+      ArpCache::Entry *entry = m_arpCache.GetSlot (i);
+      if (entry != 0 && entry->GetMacAddress () == to)
         {
           entryList.push_back (entry);
         }
@@ -318,22 +365,16 @@ ArpCache::Entry *
 ArpCache::Lookup (Ipv4Address to)
 {
   NS_LOG_FUNCTION (this << to);
-  CacheI it = m_arpCache.find (to);
-  if (it != m_arpCache.end ())
-    {
-      return it->second;
-    }
-  return 0;
+  return m_arpCache.Find (to);
 }
 
 ArpCache::Entry *
 ArpCache::Add (Ipv4Address to)
 {
   NS_LOG_FUNCTION (this << to);
-  NS_ASSERT (m_arpCache.find (to) == m_arpCache.end ());
+  NS_ASSERT (m_arpCache.Find (to) == 0);
 
-  ArpCache::Entry *entry = new ArpCache::Entry (this);
-  m_arpCache[to] = entry;
+  ArpCache::Entry *entry = m_arpCache.Add (to, this);
   entry->SetIpv4Address (to);
   return entry;
 }
@@ -342,24 +383,23 @@ void
 ArpCache::Remove (ArpCache::Entry *entry)
 {
   NS_LOG_FUNCTION (this << entry);
-  
-  for (CacheI i = m_arpCache.begin (); i != m_arpCache.end (); i++)
+
+  if (m_arpCache.Find (entry->GetIpv4Address ()) != entry)
     {
-      if ((*i).second == entry)
-        {
-          m_arpCache.erase (i);
-          entry->ClearPendingPacket (); //clear the pending packets for entry's ipaddress
-          delete entry;
-          return;
-        }
+      NS_LOG_WARN ("Entry not found in this ARP Cache");
+      return;
     }
-  NS_LOG_WARN ("Entry not found in this ARP Cache");
+  entry->LeaveWaitReply ();
+  entry->ClearPendingPacket (); //clear the pending packets for entry's ipaddress
+  m_arpCache.Remove (entry->GetIpv4Address ());
 }
 
 ArpCache::Entry::Entry (ArpCache *arp)
   : m_arp (arp),
     m_state (ALIVE),
-    m_retries (0)
+    m_retries (0),
+    m_prevWaitReply (0),
+    m_nextWaitReply (0)
 {
   NS_LOG_FUNCTION (this << arp);
 }
@@ -396,6 +436,7 @@ ArpCache::Entry::MarkDead (void)
 {
   NS_LOG_FUNCTION (this);
   NS_ASSERT (m_state == ALIVE || m_state == WAIT_REPLY || m_state == DEAD);
+  LeaveWaitReply ();
   m_state = DEAD;
   ClearRetries ();
   UpdateSeen ();
@@ -405,6 +446,7 @@ ArpCache::Entry::MarkAlive (Address macAddress)
 {
   NS_LOG_FUNCTION (this << macAddress);
   NS_ASSERT (m_state == WAIT_REPLY);
+  LeaveWaitReply ();
   m_macAddress = macAddress;
   m_state = ALIVE;
   ClearRetries ();
@@ -416,6 +458,7 @@ ArpCache::Entry::MarkPermanent (void)
   NS_LOG_FUNCTION (this << m_macAddress);
   NS_ASSERT (!m_macAddress.IsInvalid ());
 
+  LeaveWaitReply ();
   m_state = PERMANENT;
   ClearRetries ();
   UpdateSeen ();
@@ -429,11 +472,11 @@ ArpCache::Entry::UpdateWaitReply (Ipv4PayloadHeaderPair waiting)
    * we dump the previously waiting packet and
    * replace it with this one.
    */
-  if (m_pending.size () >= m_arp->m_pendingQueueSize)
+  if (m_pending.GetSize () >= m_arp->m_pendingQueueSize)
     {
       return false;
     }
-  m_pending.push_back (waiting);
+  m_pending.Push (waiting);
   return true;
 }
 void 
@@ -441,11 +484,12 @@ ArpCache::Entry::MarkWaitReply (Ipv4PayloadHeaderPair waiting)
 {
   NS_LOG_FUNCTION (this << waiting.first);
   NS_ASSERT (m_state == ALIVE || m_state == DEAD);
-  NS_ASSERT (m_pending.empty ());
+  NS_ASSERT (m_pending.IsEmpty ());
   NS_ASSERT_MSG (waiting.first, "Can not add a null packet to the ARP queue");
 
   m_state = WAIT_REPLY;
-  m_pending.push_back (waiting);
+  m_arp->LinkWaitReply (this);
+  m_pending.Push (waiting);
   UpdateSeen ();
   m_arp->StartWaitReplyTimer ();
 }
@@ -516,23 +560,21 @@ ArpCache::Ipv4PayloadHeaderPair
 ArpCache::Entry::DequeuePending (void)
 {
   NS_LOG_FUNCTION (this);
-  if (m_pending.empty ())
+  if (m_pending.IsEmpty ())
     {
       Ipv4Header h;
       return Ipv4PayloadHeaderPair (0, h);
     }
   else
     {
-      Ipv4PayloadHeaderPair p = m_pending.front ();
-      m_pending.pop_front ();
-      return p;
+      return m_pending.Pop ();
     }
 }
 void 
 ArpCache::Entry::ClearPendingPacket (void)
 {
   NS_LOG_FUNCTION (this);
-  m_pending.clear ();
+  m_pending.Clear ();
 }
 void 
 ArpCache::Entry::UpdateSeen (void)
@@ -540,6 +582,15 @@ ArpCache::Entry::UpdateSeen (void)
   NS_LOG_FUNCTION (this);
   m_lastSeen = Simulator::Now ();
 }
+void
+ArpCache::Entry::LeaveWaitReply (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_state == WAIT_REPLY)
+    {
+      m_arp->UnlinkWaitReply (this);
+    }
+}
 uint32_t
 ArpCache::Entry::GetRetries (void) const
 {
@@ -32,14 +32,14 @@
 #include "ns3/ptr.h"
 #include "ns3/object.h"
 #include "ns3/traced-callback.h"
-#include "ns3/sgi-hashmap.h"
 #include "ns3/output-stream-wrapper.h"
+#include "ipv4-header.h"
+#include "neighbor-table.h"
 
 namespace ns3 {
 
 class NetDevice;
 class Ipv4Interface;
-class Ipv4Header;
 
 /**
  * \ingroup arp
@@ -162,6 +162,10 @@ public:
   ArpCache::Entry *Add (Ipv4Address to);
   /**
    * \brief Remove an entry.
+   *
+   * The entry is found by its address, so this does not depend on the
+   * size of the cache.
+   *
    * \param entry pointer to delete it from the list
    */
   void Remove (ArpCache::Entry *entry);
@@ -306,24 +310,33 @@ private:
      */
     Time GetTimeout (void) const;
 
+    /**
+     * \brief Leave the list of entries in WAIT_REPLY state, if in it.
+     */
+    void LeaveWaitReply (void);
+
     ArpCache *m_arp; //!< pointer to the ARP cache owning the entry
     ArpCacheEntryState_e m_state; //!< state of the entry
     Time m_lastSeen; //!< last moment a packet from that address has been seen
     Address m_macAddress; //!< entry's MAC address
     Ipv4Address m_ipv4Address; //!< entry's IP address
-    std::list<Ipv4PayloadHeaderPair> m_pending; //!< list of pending packets for the entry's IP
+    /**
+     * pending packets for the entry's IP; the first ones (as many as the
+     * default PendingQueueSize) are kept in the entry itself
+     */
+    InlineQueue<Ipv4PayloadHeaderPair, 3> m_pending;
     uint32_t m_retries; //!< rerty counter
+    Entry *m_prevWaitReply; //!< previous entry in WAIT_REPLY state
+    Entry *m_nextWaitReply; //!< next entry in WAIT_REPLY state
+
+    friend class ArpCache;
   };
 
 private:
   /**
    * \brief ARP Cache container
    */
-  typedef sgi::hash_map<Ipv4Address, ArpCache::Entry *, Ipv4AddressHash> Cache;
-  /**
-   * \brief ARP Cache container iterator
-   */
-  typedef sgi::hash_map<Ipv4Address, ArpCache::Entry *, Ipv4AddressHash>::iterator CacheI;
+  typedef NeighborTable<Ipv4Address, ArpCache::Entry, Ipv4AddressHash> Cache;
 
   virtual void DoDispose (void);
 
@@ -342,8 +355,24 @@ private:
    * If there are no Arp requests pending, this event is not scheduled.
    */
   void HandleWaitReplyTimeout (void);
+  /**
+   * \brief Add an entry at the end of the list of entries in WAIT_REPLY state.
+   * \param entry the entry
+   */
+  void LinkWaitReply (ArpCache::Entry *entry);
+  /**
+   * \brief Remove an entry from the list of entries in WAIT_REPLY state.
+   * \param entry the entry
+   */
+  void UnlinkWaitReply (ArpCache::Entry *entry);
   uint32_t m_pendingQueueSize; //!< number of packets waiting for a resolution
   Cache m_arpCache; //!< the ARP cache
+  /**
+   * The entries in WAIT_REPLY state, oldest first, so that the WaitReply
+   * timer only visits the entries it has to retry.
+   */
+  ArpCache::Entry *m_firstWaitReply;
+  ArpCache::Entry *m_lastWaitReply; //!< last entry in WAIT_REPLY state
   TracedCallback<Ptr<const Packet> > m_dropTrace; //!< trace for packets dropped by the ARP cache queue
 };
 
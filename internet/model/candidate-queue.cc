@@ -49,24 +49,24 @@ operator<< (std::ostream& os, const SPFVertex::VertexType& t)
 std::ostream& 
 operator<< (std::ostream& os, const CandidateQueue& q)
 {
-  typedef CandidateQueue::CandidateList_t List_t;
-  typedef List_t::const_iterator CIter_t;
-  const CandidateQueue::CandidateList_t& list = q.m_candidates;
+  CandidateQueue::CandidateHeap_t sorted = q.m_candidates;
+  std::sort (sorted.begin (), sorted.end (), &CandidateQueue::Before);
 
   os << "*** CandidateQueue Begin (<id, distance, LSA-type>) ***" << std::endl;
-  for (CIter_t iter = list.begin (); iter != list.end (); iter++)
+  for (CandidateQueue::CandidateHeap_t::const_iterator iter = sorted.begin (); iter != sorted.end (); iter++)
     {
       os << "<" 
-      << (*iter)->GetVertexId () << ", "
-      << (*iter)->GetDistanceFromRoot () << ", "
-      << (*iter)->GetVertexType () << ">" << std::endl;
+      << iter->vertex->GetVertexId () << ", "
+      << iter->vertex->GetDistanceFromRoot () << ", "
+      << iter->vertex->GetVertexType () << ">" << std::endl;
     }
   os << "*** CandidateQueue End ***";
   return os;
 }
 
 CandidateQueue::CandidateQueue()
-  : m_candidates ()
+  : m_candidates (),
+    m_sequence (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -81,12 +81,13 @@ void
 CandidateQueue::Clear (void)
 {
   NS_LOG_FUNCTION (this);
-  while (!m_candidates.empty ())
+  for (CandidateHeap_t::iterator i = m_candidates.begin (); i != m_candidates.end (); i++)
     {
-      SPFVertex *p = Pop ();
-      delete p;
-      p = 0;
+      delete i->vertex;
     }
+  m_candidates.clear ();
+  m_positions.clear ();
+  m_byId.clear ();
 }
 
 void
@@ -94,11 +95,14 @@ CandidateQueue::Push (SPFVertex *vNew)
 {
   NS_LOG_FUNCTION (this << vNew);
 
-  CandidateList_t::iterator i = std::upper_bound (
-      m_candidates.begin (), m_candidates.end (), vNew,
-      &CandidateQueue::CompareSPFVertex
-      );
-  m_candidates.insert (i, vNew);
+  Entry e;
+  e.vertex = vNew;
+  SetKey (e);
+  e.sequence = m_sequence++;
+  m_candidates.push_back (e);
+  m_positions[vNew] = m_candidates.size () - 1;
+  m_byId.insert (std::make_pair (vNew->GetVertexId (), vNew));
+  SiftUp (m_candidates.size () - 1);
 }
 
 SPFVertex *
@@ -110,8 +114,25 @@ CandidateQueue::Pop (void)
       return 0;
     }
 
-  SPFVertex *v = m_candidates.front ();
-  m_candidates.pop_front ();
+  SPFVertex *v = m_candidates.front ().vertex;
+  Entry last = m_candidates.back ();
+  m_candidates.pop_back ();
+  if (!m_candidates.empty ())
+    {
+      Place (0, last);
+      SiftDown (0);
+    }
+
+  m_positions.erase (v);
+  std::pair<IdMap_t::iterator, IdMap_t::iterator> range = m_byId.equal_range (v->GetVertexId ());
+  for (IdMap_t::iterator i = range.first; i != range.second; i++)
+    {
+      if (i->second == v)
+        {
+          m_byId.erase (i);
+          break;
+        }
+    }
   return v;
 }
 
@@ -124,7 +145,7 @@ CandidateQueue::Top (void) const
       return 0;
     }
 
-  return m_candidates.front ();
+  return m_candidates.front ().vertex;
 }
 
 bool
@@ -145,18 +166,21 @@ SPFVertex *
 CandidateQueue::Find (const Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (this);
-  CandidateList_t::const_iterator i = m_candidates.begin ();
+  std::pair<IdMap_t::const_iterator, IdMap_t::const_iterator> range = m_byId.equal_range (addr);
+  SPFVertex *found = 0;
+  uint32_t foundPosition = 0;
 
-  for (; i != m_candidates.end (); i++)
+  // Of several vertices with that address, return the one popped first
+  for (IdMap_t::const_iterator i = range.first; i != range.second; i++)
     {
-      SPFVertex *v = *i;
-      if (v->GetVertexId () == addr)
+      uint32_t position = m_positions.find (i->second)->second;
+      if (found == 0 || Before (m_candidates[position], m_candidates[foundPosition]))
         {
-          return v;
+          found = i->second;
+          foundPosition = position;
         }
     }
-
-  return 0;
+  return found;
 }
 
 void
@@ -164,11 +188,68 @@ CandidateQueue::Reorder (void)
 {
   NS_LOG_FUNCTION (this);
 
-  m_candidates.sort (&CandidateQueue::CompareSPFVertex);
+  //
+  // Sort on the current keys, keeping the former order between vertices
+  // whose current keys are equal, as a stable sort of a sorted list would.
+  //
+  std::vector<std::pair<Entry, Entry> > order;
+  order.reserve (m_candidates.size ());
+  for (CandidateHeap_t::const_iterator i = m_candidates.begin (); i != m_candidates.end (); i++)
+    {
+      Entry current = *i;
+      SetKey (current);
+      order.push_back (std::make_pair (current, *i));
+    }
+  std::sort (order.begin (), order.end (), &CandidateQueue::BeforeCurrent);
+
+  // A sorted array is a valid heap
+  for (uint32_t i = 0; i < order.size (); ++i)
+    {
+      Entry e = order[i].first;
+      e.sequence = m_sequence++;
+      Place (i, e);
+    }
   NS_LOG_LOGIC ("After reordering the CandidateQueue");
   NS_LOG_LOGIC (*this);
 }
 
+void
+CandidateQueue::Update (SPFVertex *v)
+{
+  NS_LOG_FUNCTION (this << v);
+
+  std::unordered_map<const SPFVertex *, uint32_t>::const_iterator position = m_positions.find (v);
+  NS_ASSERT_MSG (position != m_positions.end (), "Vertex not in the CandidateQueue");
+  uint32_t i = position->second;
+  Entry e = m_candidates[i];
+  SetKey (e);
+  if (e.distance == m_candidates[i].distance && e.rank == m_candidates[i].rank)
+    {
+      return;
+    }
+  if (Before (e, m_candidates[i]))
+    {
+      //
+      // Like a stable sort of the former list would, place the vertex after
+      // the vertices already queued with its new key.
+      //
+      e.sequence = m_sequence++;
+      Place (i, e);
+      SiftUp (i);
+    }
+  else
+    {
+      Reorder ();
+    }
+}
+
+void
+CandidateQueue::SetKey (Entry &e)
+{
+  e.distance = e.vertex->GetDistanceFromRoot ();
+  e.rank = e.vertex->GetVertexType () == SPFVertex::VertexNetwork ? 0 : 1;
+}
+
 /*
  * In this implementation, SPFVertex follows the ordering where
  * a vertex is ranked first if its GetDistanceFromRoot () is smaller;
@@ -176,25 +257,82 @@ CandidateQueue::Reorder (void)
  *
  * This ordering is necessary for implementing ECMP
  */
-bool 
-CandidateQueue::CompareSPFVertex (const SPFVertex* v1, const SPFVertex* v2)
+bool
+CandidateQueue::Before (Entry const &a, Entry const &b)
 {
-  NS_LOG_FUNCTION (&v1 << &v2);
+  if (a.distance != b.distance)
+    {
+      return a.distance < b.distance;
+    }
+  if (a.rank != b.rank)
+    {
+      return a.rank < b.rank;
+    }
+  return a.sequence < b.sequence;
+}
 
-  bool result = false;
-  if (v1->GetDistanceFromRoot () < v2->GetDistanceFromRoot ())
+bool
+CandidateQueue::BeforeCurrent (std::pair<Entry, Entry> const &a, std::pair<Entry, Entry> const &b)
+{
+  if (a.first.distance != b.first.distance)
     {
-      result = true;
+      return a.first.distance < b.first.distance;
     }
-  else if (v1->GetDistanceFromRoot () == v2->GetDistanceFromRoot ())
+  if (a.first.rank != b.first.rank)
     {
-      if (v1->GetVertexType () == SPFVertex::VertexNetwork 
-          && v2->GetVertexType () == SPFVertex::VertexRouter)
+      return a.first.rank < b.first.rank;
+    }
+  return Before (a.second, b.second);
+}
+
+void
+CandidateQueue::SiftUp (uint32_t i)
+{
+  Entry e = m_candidates[i];
+  while (i > 0)
+    {
+      uint32_t parent = (i - 1) / 2;
+      if (!Before (e, m_candidates[parent]))
         {
-          result = true;
+          break;
         }
+      Place (i, m_candidates[parent]);
+      i = parent;
     }
-  return result;
+  Place (i, e);
+}
+
+void
+CandidateQueue::SiftDown (uint32_t i)
+{
+  Entry e = m_candidates[i];
+  uint32_t n = m_candidates.size ();
+  for (;;)
+    {
+      uint32_t child = 2 * i + 1;
+      if (child >= n)
+        {
+          break;
+        }
+      if (child + 1 < n && Before (m_candidates[child + 1], m_candidates[child]))
+        {
+          child++;
+        }
+      if (!Before (m_candidates[child], e))
+        {
+          break;
+        }
+      Place (i, m_candidates[child]);
+      i = child;
+    }
+  Place (i, e);
+}
+
+void
+CandidateQueue::Place (uint32_t i, Entry const &e)
+{
+  m_candidates[i] = e;
+  m_positions[e.vertex] = i;
 }
 
 } // namespace ns3
@@ -22,7 +22,8 @@
 #define CANDIDATE_QUEUE_H
 
 #include <stdint.h>
-#include <list>
+#include <unordered_map>
+#include <vector>
 #include "ns3/ipv4-address.h"
 
 namespace ns3 {
@@ -47,6 +48,13 @@ class SPFVertex;
  * for a Find () operation, the dynamic nature of the data and the derived
  * requirement for a Reorder () operation led us to implement this simple 
  * enhanced priority queue.
+ *
+ * It is an indexed binary heap: Push (), Pop () and Update () (the
+ * decrease-key operation of the SPF calculation) take O(log n) time, and
+ * Find () takes constant time.  Vertices at the same distance and of the
+ * same type are popped in the order they were pushed, or in which their
+ * distance last decreased, which is the order the former sorted list
+ * implementation gave them.
  */
 class CandidateQueue
 {
@@ -154,6 +162,18 @@ public:
  */
   void Reorder (void);
 
+/**
+ * @brief Restores the order of the Candidate Queue after the distance from
+ * the root of one vertex in the queue has changed.
+ *
+ * This is equivalent to, and much cheaper than, Reorder () when a single
+ * vertex changed.
+ *
+ * @see SPFVertex
+ * @param v The Shortest Path First Vertex whose distance changed.
+ */
+  void Update (SPFVertex *v);
+
 private:
 /**
  * Candidate Queue copy construction is disallowed (not implemented) to 
@@ -171,21 +191,70 @@ private:
  * \return copied object
  */
   CandidateQueue& operator= (CandidateQueue& sr);
-/**
- * \brief return true if v1 < v2
- *
- * SPFVertexes are added into the queue according to the ordering
- * defined by this method. If v1 should be popped before v2, this 
- * method return true; false otherwise
- *
- * \param v1 first operand
- * \param v2 second operand
- * \return True if v1 should be popped before v2; false otherwise
- */
-  static bool CompareSPFVertex (const SPFVertex* v1, const SPFVertex* v2);
 
-  typedef std::list<SPFVertex*> CandidateList_t; //!< container of SPFVertex pointers
-  CandidateList_t m_candidates;  //!< SPFVertex candidates
+  /**
+   * \brief A vertex in the heap, with the key it is ordered by.
+   */
+  struct Entry
+  {
+    SPFVertex *vertex;  //!< the vertex
+    uint32_t distance;  //!< distance from root when last ordered
+    uint32_t rank;      //!< 0 for network vertices, 1 for others
+    uint32_t sequence;  //!< tie breaker: order of insertion or last decrease
+  };
+
+  /**
+   * \brief Fill the key of an entry from the current state of its vertex.
+   * \param e the entry
+   */
+  static void SetKey (Entry &e);
+
+  /**
+   * \brief return true if a < b
+   *
+   * Entries are ordered by distance from the root, then network vertices
+   * before router vertices, then by sequence number.
+   *
+   * \param a first entry
+   * \param b second entry
+   * \return true if a should be popped before b
+   */
+  static bool Before (Entry const &a, Entry const &b);
+
+  /**
+   * \brief Compare entries on their vertex's current key, then on the key
+   * they were ordered by.
+   * \param a first entry, current key first
+   * \param b second entry, current key first
+   * \return true if a should be popped before b
+   */
+  static bool BeforeCurrent (std::pair<Entry, Entry> const &a, std::pair<Entry, Entry> const &b);
+
+  /**
+   * \brief Move an entry towards the top of the heap.
+   * \param i position of the entry
+   */
+  void SiftUp (uint32_t i);
+
+  /**
+   * \brief Move an entry towards the bottom of the heap.
+   * \param i position of the entry
+   */
+  void SiftDown (uint32_t i);
+
+  /**
+   * \brief Store an entry at a position of the heap.
+   * \param i the position
+   * \param e the entry
+   */
+  void Place (uint32_t i, Entry const &e);
+
+  typedef std::vector<Entry> CandidateHeap_t; //!< binary heap of SPFVertex pointers
+  CandidateHeap_t m_candidates;  //!< SPFVertex candidates
+  std::unordered_map<const SPFVertex *, uint32_t> m_positions; //!< position of each vertex in m_candidates
+  typedef std::unordered_multimap<Ipv4Address, SPFVertex *, Ipv4AddressHash> IdMap_t; //!< vertices by vertex ID
+  IdMap_t m_byId;                //!< vertices by vertex ID
+  uint32_t m_sequence;           //!< next entry sequence number
 
   /**
    * \brief Stream insertion operator.
@@ -27,9 +27,19 @@
 #include <queue>
 #include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <unordered_set>
+#include "ns3/core-config.h"
+#ifdef HAVE_PTHREAD_H
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
 #include "ns3/assert.h"
 #include "ns3/fatal-error.h"
 #include "ns3/log.h"
+#include "ns3/global-value.h"
+#include "ns3/uinteger.h"
 #include "ns3/node-list.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
@@ -44,6 +54,16 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("GlobalRouteManagerImpl");
 
+/**
+ * \brief The number of threads computing global routes.
+ */
+static GlobalValue g_globalRoutingThreads = GlobalValue ("GlobalRoutingThreads",
+                                                         "The number of threads running the SPF calculations "
+                                                         "of the routers when building global routes "
+                                                         "(0 for one per processor)",
+                                                         UintegerValue (1),
+                                                         MakeUintegerChecker<uint32_t> ());
+
 /**
  * \brief Stream insertion operator.
  *
@@ -139,9 +159,10 @@ SPFVertex::~SPFVertex ()
       // remove the current vertex from its parent's children list. Check
       // if the size of the list is reduced, or the child<->parent relation
       // is not bidirectional
-      uint32_t orgCount = (*piter)->m_children.size ();
-      (*piter)->m_children.remove (this);
-      uint32_t newCount = (*piter)->m_children.size ();
+      ListOfSPFVertex_t &children = (*piter)->m_children;
+      uint32_t orgCount = children.size ();
+      children.erase (std::remove (children.begin (), children.end (), this), children.end ());
+      uint32_t newCount = children.size ();
       if (orgCount > newCount)
         {
           NS_ASSERT_MSG (orgCount > newCount, "Unable to find the current vertex from its parents --- impossible!");
@@ -174,6 +195,35 @@ SPFVertex::~SPFVertex ()
   NS_LOG_LOGIC ("Vertex-" << m_vertexId << " completed deleted");
 }
 
+void
+SPFVertex::Reset (GlobalRoutingLSA* lsa)
+{
+  NS_LOG_FUNCTION (this << lsa);
+  m_vertexType = VertexUnknown;
+  m_vertexId = Ipv4Address ("255.255.255.255");
+  m_lsa = lsa;
+  m_distanceFromRoot = SPF_INFINITY;
+  m_rootOif = SPF_INFINITY;
+  m_nextHop = Ipv4Address::GetZero ();
+  // The lists keep their capacity for the next calculation
+  m_ecmpRootExits.clear ();
+  m_parents.clear ();
+  m_children.clear ();
+  m_vertexProcessed = false;
+  if (lsa)
+    {
+      m_vertexId = lsa->GetLinkStateId ();
+      if (lsa->GetLSType () == GlobalRoutingLSA::RouterLSA)
+        {
+          m_vertexType = VertexRouter;
+        }
+      else if (lsa->GetLSType () == GlobalRoutingLSA::NetworkLSA)
+        {
+          m_vertexType = VertexNetwork;
+        }
+    }
+}
+
 void
 SPFVertex::SetVertexType (SPFVertex::VertexType type)
 {
@@ -251,12 +301,7 @@ SPFVertex::GetParent (uint32_t i) const
       NS_LOG_LOGIC ("Index to SPFVertex's parent is out-of-range.");
       return 0;
     }
-  ListOfSPFVertex_t::const_iterator iter = m_parents.begin ();
-  while (i-- > 0) 
-    {
-      iter++;
-    }
-  return *iter;
+  return m_parents[i];
 }
 
 void 
@@ -269,8 +314,8 @@ SPFVertex::MergeParent (const SPFVertex* v)
   m_parents.insert (m_parents.end (), 
                     v->m_parents.begin (), v->m_parents.end ());
   // remove duplication
-  m_parents.sort ();
-  m_parents.unique ();
+  std::sort (m_parents.begin (), m_parents.end ());
+  m_parents.erase (std::unique (m_parents.begin (), m_parents.end ()), m_parents.end ());
   NS_LOG_LOGIC ("After merge, list of parents = " << m_parents);
 }
 
@@ -299,13 +344,8 @@ SPFVertex::NodeExit_t
 SPFVertex::GetRootExitDirection (uint32_t i) const
 {
   NS_LOG_FUNCTION (this << i);
-  typedef ListOfNodeExit_t::const_iterator CIter_t;
-
   NS_ASSERT_MSG (i < m_ecmpRootExits.size (), "Index out-of-range when accessing SPFVertex::m_ecmpRootExits!");
-  CIter_t iter = m_ecmpRootExits.begin ();
-  while (i-- > 0) { iter++; }
-
-  return *iter;
+  return m_ecmpRootExits[i];
 }
 
 SPFVertex::NodeExit_t 
@@ -328,8 +368,9 @@ SPFVertex::MergeRootExitDirections (const SPFVertex* vertex)
   const ListOfNodeExit_t& extList = vertex->m_ecmpRootExits;
   m_ecmpRootExits.insert (m_ecmpRootExits.end (), 
                           extList.begin (), extList.end ());
-  m_ecmpRootExits.sort ();
-  m_ecmpRootExits.unique ();
+  std::sort (m_ecmpRootExits.begin (), m_ecmpRootExits.end ());
+  m_ecmpRootExits.erase (std::unique (m_ecmpRootExits.begin (), m_ecmpRootExits.end ()),
+                         m_ecmpRootExits.end ());
 }
 
 void 
@@ -366,19 +407,8 @@ SPFVertex*
 SPFVertex::GetChild (uint32_t n) const
 {
   NS_LOG_FUNCTION (this << n);
-  uint32_t j = 0;
-
-  for ( ListOfSPFVertex_t::const_iterator i = m_children.begin ();
-        i != m_children.end ();
-        i++, j++)
-    {
-      if (j == n)
-        {
-          return *i;
-        }
-    }
-  NS_ASSERT_MSG (false, "Index <n> out of range.");
-  return 0;
+  NS_ASSERT_MSG (n < m_children.size (), "Index <n> out of range.");
+  return m_children[n];
 }
 
 uint32_t
@@ -422,7 +452,9 @@ SPFVertex::ClearVertexProcessed (void)
 
 GlobalRouteManagerLSDB::GlobalRouteManagerLSDB ()
   :
+    m_lsas (),
     m_database (),
+    m_linkData (),
     m_extdatabase ()
 {
   NS_LOG_FUNCTION (this);
@@ -431,11 +463,10 @@ GlobalRouteManagerLSDB::GlobalRouteManagerLSDB ()
 GlobalRouteManagerLSDB::~GlobalRouteManagerLSDB ()
 {
   NS_LOG_FUNCTION (this);
-  LSDBMap_t::iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  for (uint32_t j = 0; j < m_lsas.size (); j++)
     {
       NS_LOG_LOGIC ("free LSA");
-      GlobalRoutingLSA* temp = i->second;
+      GlobalRoutingLSA* temp = m_lsas[j];
       delete temp;
     }
   for (uint32_t j = 0; j < m_extdatabase.size (); j++)
@@ -445,17 +476,18 @@ GlobalRouteManagerLSDB::~GlobalRouteManagerLSDB ()
       delete temp;
     }
   NS_LOG_LOGIC ("clear map");
+  m_lsas.clear ();
   m_database.clear ();
+  m_linkData.clear ();
 }
 
 void
 GlobalRouteManagerLSDB::Initialize ()
 {
   NS_LOG_FUNCTION (this);
-  LSDBMap_t::iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
+  for (uint32_t j = 0; j < m_lsas.size (); j++)
     {
-      GlobalRoutingLSA* temp = i->second;
+      GlobalRoutingLSA* temp = m_lsas[j];
       temp->SetStatus (GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED);
     }
 }
@@ -467,10 +499,33 @@ GlobalRouteManagerLSDB::Insert (Ipv4Address addr, GlobalRoutingLSA* lsa)
   if (lsa->GetLSType () == GlobalRoutingLSA::ASExternalLSAs) 
     {
       m_extdatabase.push_back (lsa);
+      return;
     } 
-  else
+  uint32_t index = m_lsas.size ();
+  if (!m_database.insert (LSDBPair_t (addr, index)).second)
     {
-      m_database.insert (LSDBPair_t (addr, lsa));
+      // As with a map, the first LSA of an address is kept
+      NS_LOG_WARN ("Duplicate LSA " << addr);
+      return;
+    }
+  m_lsas.push_back (lsa);
+//
+// Index the transit records by their LinkData.  The router found for an
+// address used to be the first one in address order, so the lowest link
+// state ID wins.
+//
+  for (uint32_t j = 0; j < lsa->GetNLinkRecords (); j++)
+    {
+      GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecord::TransitNetwork)
+        {
+          continue;
+        }
+      std::pair<LSDBMap_t::iterator, bool> i = m_linkData.insert (LSDBPair_t (lr->GetLinkData (), index));
+      if (!i.second && addr < m_lsas[i.first->second]->GetLinkStateId ())
+        {
+          i.first->second = index;
+        }
     }
 }
 
@@ -488,6 +543,37 @@ GlobalRouteManagerLSDB::GetNumExtLSAs () const
   return m_extdatabase.size ();
 }
 
+uint32_t
+GlobalRouteManagerLSDB::GetNumLSAs () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_lsas.size ();
+}
+
+GlobalRoutingLSA*
+GlobalRouteManagerLSDB::GetLSAByIndex (uint32_t index) const
+{
+  NS_LOG_FUNCTION (this << index);
+  NS_ASSERT (index < m_lsas.size ());
+  return m_lsas[index];
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetLSAIndex (Ipv4Address addr) const
+{
+  NS_LOG_FUNCTION (this << addr);
+  LSDBMap_t::const_iterator i = m_database.find (addr);
+  return i == m_database.end () ? m_lsas.size () : i->second;
+}
+
+uint32_t
+GlobalRouteManagerLSDB::GetLSAIndexByLinkData (Ipv4Address addr) const
+{
+  NS_LOG_FUNCTION (this << addr);
+  LSDBMap_t::const_iterator i = m_linkData.find (addr);
+  return i == m_linkData.end () ? m_lsas.size () : i->second;
+}
+
 GlobalRoutingLSA*
 GlobalRouteManagerLSDB::GetLSA (Ipv4Address addr) const
 {
@@ -495,15 +581,8 @@ GlobalRouteManagerLSDB::GetLSA (Ipv4Address addr) const
 //
 // Look up an LSA by its address.
 //
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
-    {
-      if (i->first == addr)
-        {
-          return i->second;
-        }
-    }
-  return 0;
+  uint32_t index = GetLSAIndex (addr);
+  return index < m_lsas.size () ? m_lsas[index] : 0;
 }
 
 GlobalRoutingLSA*
@@ -511,24 +590,10 @@ GlobalRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 {
   NS_LOG_FUNCTION (this << addr);
 //
-// Look up an LSA by its address.
+// Look up an LSA by the address of one of its transit records.
 //
-  LSDBMap_t::const_iterator i;
-  for (i= m_database.begin (); i!= m_database.end (); i++)
-    {
-      GlobalRoutingLSA* temp = i->second;
-// Iterate among temp's Link Records
-      for (uint32_t j = 0; j < temp->GetNLinkRecords (); j++)
-        {
-          GlobalRoutingLinkRecord *lr = temp->GetLinkRecord (j);
-          if ( lr->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork &&
-               lr->GetLinkData () == addr)
-            {
-              return temp;
-            }
-        }
-    }
-  return 0;
+  uint32_t index = GetLSAIndexByLinkData (addr);
+  return index < m_lsas.size () ? m_lsas[index] : 0;
 }
 
 // ---------------------------------------------------------------------------
@@ -538,8 +603,7 @@ GlobalRouteManagerLSDB::GetLSAByLinkData (Ipv4Address addr) const
 // ---------------------------------------------------------------------------
 
 GlobalRouteManagerImpl::GlobalRouteManagerImpl () 
-  :
-    m_spfroot (0)
+  : m_statesValid (false)
 {
   NS_LOG_FUNCTION (this);
   m_lsdb = new GlobalRouteManagerLSDB ();
@@ -563,6 +627,7 @@ GlobalRouteManagerImpl::DebugUseLsdb (GlobalRouteManagerLSDB* lsdb)
       delete m_lsdb;
     }
   m_lsdb = lsdb;
+  m_statesValid = false;
 }
 
 void
@@ -592,6 +657,9 @@ GlobalRouteManagerImpl::DeleteGlobalRoutes ()
         }
       NS_LOG_LOGIC ("Deleted " << j << " global routes from node "<< node->GetId ());
     }
+  m_statesValid = false;
+  std::vector<SPFState> ().swap (m_states);
+  m_vertexIndex.clear ();
   if (m_lsdb)
     {
       NS_LOG_LOGIC ("Deleting LSDB, creating new one");
@@ -694,12 +762,26 @@ GlobalRouteManagerImpl::BuildGlobalRoutingDatabase ()
 //
 void
 GlobalRouteManagerImpl::InitializeRoutes ()
+{
+  NS_LOG_FUNCTION (this);
+  m_statesValid = false;
+  std::vector<SPFState> ().swap (m_states);
+  m_vertexIndex.clear ();
+  ComputeRoutes (false);
+}
+
+void
+GlobalRouteManagerImpl::FindRoots (std::vector<std::pair<Ipv4Address, Ptr<Node> > > &roots)
 {
   NS_LOG_FUNCTION (this);
 //
+// Routes are written to the first node having the router ID of the root.
+//
+  std::unordered_map<Ipv4Address, Ptr<Node>, Ipv4AddressHash> routerNodes;
+  std::vector<Ipv4Address> routerIds;
+//
 // Walk the list of nodes in the system.
 //
-  NS_LOG_INFO ("About to start SPF calculation");
   NodeList::Iterator listEnd = NodeList::End ();
   for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
     {
@@ -710,6 +792,10 @@ GlobalRouteManagerImpl::InitializeRoutes ()
 //
       Ptr<GlobalRouter> rtr = 
         node->GetObject<GlobalRouter> ();
+      if (rtr)
+        {
+          routerNodes.insert (std::make_pair (rtr->GetRouterId (), node));
+        }
 
       uint32_t systemId = MpiInterface::GetSystemId ();
       // Ignore nodes that are not assigned to our systemId (distributed sim)
@@ -724,10 +810,703 @@ GlobalRouteManagerImpl::InitializeRoutes ()
 //
       if (rtr && rtr->GetNumLSAs () )
         {
-          SPFCalculate (rtr->GetRouterId ());
+          routerIds.push_back (rtr->GetRouterId ());
+        }
+    }
+
+  roots.clear ();
+  for (std::vector<Ipv4Address>::const_iterator i = routerIds.begin (); i != routerIds.end (); ++i)
+    {
+      roots.push_back (std::make_pair (*i, routerNodes[*i]));
+    }
+}
+
+void
+GlobalRouteManagerImpl::ComputeRoutes (bool keep)
+{
+  NS_LOG_FUNCTION (this << keep);
+  NS_LOG_INFO ("About to start SPF calculation");
+  std::vector<std::pair<Ipv4Address, Ptr<Node> > > roots;
+  FindRoots (roots);
+
+  if (keep)
+    {
+//
+// Number the router and network LSAs, which are the vertices of the SPF
+// trees.
+//
+      m_vertexIndex.clear ();
+      for (uint32_t i = 0; i < m_lsdb->GetNumLSAs (); ++i)
+        {
+          m_vertexIndex.insert (std::make_pair (m_lsdb->GetLSAByIndex (i)->GetLinkStateId (), i));
+        }
+      m_states.assign (roots.size (), SPFState ());
+    }
+
+  std::vector<SPFContext> contexts (roots.size ());
+  for (uint32_t i = 0; i < roots.size (); ++i)
+    {
+      PrepareSPF (contexts[i], roots[i].first, roots[i].second);
+      if (keep)
+        {
+          contexts[i].state = &m_states[i];
+        }
+    }
+
+  UintegerValue threads;
+  g_globalRoutingThreads.GetValue (threads);
+  SPFCalculateAll (contexts, threads.Get ());
+  m_statesValid = keep;
+  NS_LOG_INFO ("Finished SPF calculation");
+}
+
+void
+GlobalRouteManagerImpl::UpdateGlobalRoutes ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_statesValid)
+    {
+      GlobalRouteManagerLSDB* old = m_lsdb;
+      m_lsdb = new GlobalRouteManagerLSDB ();
+      BuildGlobalRoutingDatabase ();
+      bool updated = UpdateRoutes (old);
+      delete old;
+      if (updated)
+        {
+          return;
+        }
+      NS_LOG_INFO ("Routes can not be updated, computing them again");
+    }
+  DeleteGlobalRoutes ();
+  BuildGlobalRoutingDatabase ();
+  ComputeRoutes (true);
+}
+
+/**
+ * \brief Compare the contents of two LSAs.
+ * \param a an LSA
+ * \param b another LSA
+ * \returns true if the LSAs advertise the same links
+ */
+static bool
+SameLSA (GlobalRoutingLSA* a, GlobalRoutingLSA* b)
+{
+  if (a->GetLSType () != b->GetLSType ()
+      || a->GetLinkStateId () != b->GetLinkStateId ()
+      || a->GetAdvertisingRouter () != b->GetAdvertisingRouter ()
+      || a->GetNetworkLSANetworkMask () != b->GetNetworkLSANetworkMask ()
+      || a->GetNLinkRecords () != b->GetNLinkRecords ()
+      || a->GetNAttachedRouters () != b->GetNAttachedRouters ())
+    {
+      return false;
+    }
+  for (uint32_t i = 0; i < a->GetNLinkRecords (); ++i)
+    {
+      GlobalRoutingLinkRecord *la = a->GetLinkRecord (i);
+      GlobalRoutingLinkRecord *lb = b->GetLinkRecord (i);
+      if (la->GetLinkType () != lb->GetLinkType ()
+          || la->GetLinkId () != lb->GetLinkId ()
+          || la->GetLinkData () != lb->GetLinkData ()
+          || la->GetMetric () != lb->GetMetric ())
+        {
+          return false;
+        }
+    }
+  for (uint32_t i = 0; i < a->GetNAttachedRouters (); ++i)
+    {
+      if (a->GetAttachedRouter (i) != b->GetAttachedRouter (i))
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+void
+GlobalRouteManagerImpl::CollectEdges (GlobalRouteManagerLSDB* lsdb, std::vector<SPFEdge> &edges) const
+{
+  NS_LOG_FUNCTION (this << lsdb);
+  typedef std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator IndexIter_t;
+
+  edges.clear ();
+  for (uint32_t i = 0; i < lsdb->GetNumLSAs (); ++i)
+    {
+      SPFEdge edge;
+      GlobalRoutingLSA *lsa = lsdb->GetLSAByIndex (i);
+      edge.from = m_vertexIndex.find (lsa->GetLinkStateId ())->second;
+      if (lsa->GetLSType () == GlobalRoutingLSA::RouterLSA)
+        {
+          for (uint32_t j = 0; j < lsa->GetNLinkRecords (); ++j)
+            {
+              GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+              if (l->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint
+                  && l->GetLinkType () != GlobalRoutingLinkRecord::TransitNetwork)
+                {
+                  continue;
+                }
+              IndexIter_t to = m_vertexIndex.find (l->GetLinkId ());
+              if (to != m_vertexIndex.end ())
+                {
+                  edge.to = to->second;
+                  edge.metric = l->GetMetric ();
+                  edges.push_back (edge);
+                }
+            }
+        }
+      else if (lsa->GetLSType () == GlobalRoutingLSA::NetworkLSA)
+        {
+          for (uint32_t j = 0; j < lsa->GetNAttachedRouters (); ++j)
+            {
+              // The routers attached to a network are found as in SPFNext ()
+              GlobalRoutingLSA *router = lsdb->GetLSAByLinkData (lsa->GetAttachedRouter (j));
+              if (router)
+                {
+                  edge.to = m_vertexIndex.find (router->GetLinkStateId ())->second;
+                  edge.metric = 0;
+                  edges.push_back (edge);
+                }
+            }
+        }
+    }
+  std::sort (edges.begin (), edges.end ());
+}
+
+//
+// The SPF tree of a router only changes if a link on one of its shortest
+// paths went down (a removed link between vertices whose distances differ by
+// the cost of the link), or if a new link gives a path at least as short as
+// the current one.  The exit directions of the router also depend on the
+// LSAs of its neighbors.  The routers for which none of this happened keep
+// their tree: only the routes to the addresses and stub networks advertised
+// in the changed LSAs are replaced, using the kept distances and exit
+// directions of the advertising routers.  The other routers run their SPF
+// calculation again.
+//
+bool
+GlobalRouteManagerImpl::UpdateRoutes (GlobalRouteManagerLSDB* old)
+{
+  NS_LOG_FUNCTION (this << old);
+  typedef std::pair<uint32_t, uint32_t> Prefix_t;
+
+  std::vector<std::pair<Ipv4Address, Ptr<Node> > > roots;
+  FindRoots (roots);
+  bool sameRoots = roots.size () == m_states.size ();
+  for (uint32_t i = 0; sameRoots && i < roots.size (); ++i)
+    {
+      sameRoots = roots[i].first == m_states[i].routerId;
+    }
+  if (!sameRoots)
+    {
+      NS_LOG_LOGIC ("The set of routers changed");
+      return false;
+    }
+
+//
+// The databases must have the same LSAs; only their links may differ.
+//
+  if (old->GetNumLSAs () != m_lsdb->GetNumLSAs ()
+      || old->m_extdatabase.size () != m_lsdb->m_extdatabase.size ())
+    {
+      NS_LOG_LOGIC ("The set of LSAs changed");
+      return false;
+    }
+  for (uint32_t i = 0; i < old->m_extdatabase.size (); ++i)
+    {
+      if (!SameLSA (old->m_extdatabase[i], m_lsdb->m_extdatabase[i]))
+        {
+          NS_LOG_LOGIC ("The external LSAs changed");
+          return false;
+        }
+    }
+  std::vector<std::pair<GlobalRoutingLSA*, GlobalRoutingLSA*> > changed;
+  for (uint32_t i = 0; i < old->GetNumLSAs (); ++i)
+    {
+      GlobalRoutingLSA *before = old->GetLSAByIndex (i);
+      GlobalRoutingLSA *after = m_lsdb->GetLSA (before->GetLinkStateId ());
+      if (after == 0
+          || before->GetLSType () != after->GetLSType ()
+          || before->GetNetworkLSANetworkMask () != after->GetNetworkLSANetworkMask ())
+        {
+          NS_LOG_LOGIC ("The set of LSAs changed");
+          return false;
+        }
+      if (!SameLSA (before, after))
+        {
+          changed.push_back (std::make_pair (before, after));
+        }
+    }
+  NS_LOG_INFO (changed.size () << " LSAs changed");
+  if (changed.empty ())
+    {
+      return true;
+    }
+
+//
+// Links that went down or up
+//
+  std::vector<SPFEdge> oldEdges;
+  std::vector<SPFEdge> newEdges;
+  CollectEdges (old, oldEdges);
+  CollectEdges (m_lsdb, newEdges);
+  std::vector<SPFEdge> removed;
+  std::vector<SPFEdge> added;
+  std::set_difference (oldEdges.begin (), oldEdges.end (), newEdges.begin (), newEdges.end (),
+                       std::back_inserter (removed));
+  std::set_difference (newEdges.begin (), newEdges.end (), oldEdges.begin (), oldEdges.end (),
+                       std::back_inserter (added));
+
+//
+// Routers advertising or adjacent to the changed LSAs, and the host
+// addresses and stub networks advertised in them.
+//
+  std::unordered_set<Ipv4Address, Ipv4AddressHash> neighbors;
+  std::unordered_set<Ipv4Address, Ipv4AddressHash> networks;
+  std::vector<uint32_t> hosts;
+  std::vector<Prefix_t> stubs;
+  for (uint32_t i = 0; i < changed.size (); ++i)
+    {
+      GlobalRoutingLSA *lsas[2] = { changed[i].first, changed[i].second };
+      for (uint32_t k = 0; k < 2; ++k)
+        {
+          if (lsas[k]->GetLSType () == GlobalRoutingLSA::NetworkLSA)
+            {
+              networks.insert (lsas[k]->GetLinkStateId ());
+              continue;
+            }
+          neighbors.insert (lsas[k]->GetLinkStateId ());
+          for (uint32_t j = 0; j < lsas[k]->GetNLinkRecords (); ++j)
+            {
+              GlobalRoutingLinkRecord *l = lsas[k]->GetLinkRecord (j);
+              if (l->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
+                {
+                  neighbors.insert (l->GetLinkId ());
+                  hosts.push_back (l->GetLinkData ().Get ());
+                }
+              else if (l->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork)
+                {
+                  networks.insert (l->GetLinkId ());
+                }
+              else if (l->GetLinkType () == GlobalRoutingLinkRecord::StubNetwork)
+                {
+                  stubs.push_back (Prefix_t (l->GetLinkId ().Get () & l->GetLinkData ().Get (),
+                                             l->GetLinkData ().Get ()));
+                }
+            }
+        }
+    }
+  GlobalRouteManagerLSDB* lsdbs[2] = { old, m_lsdb };
+  for (uint32_t k = 0; k < 2; ++k)
+    {
+      for (uint32_t i = 0; i < lsdbs[k]->GetNumLSAs (); ++i)
+        {
+          GlobalRoutingLSA *lsa = lsdbs[k]->GetLSAByIndex (i);
+          for (uint32_t j = 0; j < lsa->GetNLinkRecords (); ++j)
+            {
+              GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+              if (l->GetLinkType () == GlobalRoutingLinkRecord::TransitNetwork
+                  && networks.count (l->GetLinkId ()))
+                {
+                  neighbors.insert (lsa->GetLinkStateId ());
+                }
+            }
+        }
+    }
+  std::sort (hosts.begin (), hosts.end ());
+  hosts.erase (std::unique (hosts.begin (), hosts.end ()), hosts.end ());
+  std::sort (stubs.begin (), stubs.end ());
+  stubs.erase (std::unique (stubs.begin (), stubs.end ()), stubs.end ());
+  std::vector<Ipv4Address> hostDests;
+  for (std::vector<uint32_t>::const_iterator i = hosts.begin (); i != hosts.end (); ++i)
+    {
+      hostDests.push_back (Ipv4Address (*i));
+    }
+  std::vector<std::pair<Ipv4Address, Ipv4Mask> > stubDests;
+  for (std::vector<Prefix_t>::const_iterator i = stubs.begin (); i != stubs.end (); ++i)
+    {
+      stubDests.push_back (std::make_pair (Ipv4Address (i->first), Ipv4Mask (i->second)));
+    }
+
+//
+// The routes to all the networks covering an address are looked up in
+// routing table order, and the replaced routes go to the end of the table:
+// if a changed stub network overlaps another network, the next hop could
+// differ from the one of a full calculation, so compute the routes again.
+//
+  std::vector<Prefix_t> prefixes;
+  for (uint32_t i = 0; i < m_lsdb->GetNumLSAs (); ++i)
+    {
+      GlobalRoutingLSA *lsa = m_lsdb->GetLSAByIndex (i);
+      if (lsa->GetLSType () == GlobalRoutingLSA::NetworkLSA)
+        {
+          uint32_t mask = lsa->GetNetworkLSANetworkMask ().Get ();
+          prefixes.push_back (Prefix_t (lsa->GetLinkStateId ().Get () & mask, mask));
+          continue;
+        }
+      for (uint32_t j = 0; j < lsa->GetNLinkRecords (); ++j)
+        {
+          GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+          if (l->GetLinkType () == GlobalRoutingLinkRecord::StubNetwork)
+            {
+              prefixes.push_back (Prefix_t (l->GetLinkId ().Get () & l->GetLinkData ().Get (),
+                                            l->GetLinkData ().Get ()));
+            }
+        }
+    }
+  std::sort (prefixes.begin (), prefixes.end ());
+  prefixes.erase (std::unique (prefixes.begin (), prefixes.end ()), prefixes.end ());
+  for (std::vector<Prefix_t>::const_iterator i = stubs.begin (); i != stubs.end (); ++i)
+    {
+      for (std::vector<Prefix_t>::const_iterator j = prefixes.begin (); j != prefixes.end (); ++j)
+        {
+          uint32_t mask = i->second & j->second;
+          if (*i != *j && (i->first & mask) == (j->first & mask))
+            {
+              NS_LOG_LOGIC ("Changed network " << Ipv4Address (i->first) << "/" << Ipv4Mask (i->second)
+                            << " overlaps " << Ipv4Address (j->first) << "/" << Ipv4Mask (j->second));
+              return false;
+            }
+        }
+    }
+
+//
+// Vertices of the new database advertising these destinations: the
+// point-to-point addresses of the changed router LSAs, and the transit or
+// stub networks with the prefix of a changed stub record.
+//
+  std::vector<std::pair<uint32_t, Ipv4Address> > hostSources;
+  for (uint32_t i = 0; i < changed.size (); ++i)
+    {
+      GlobalRoutingLSA *lsa = changed[i].second;
+      for (uint32_t j = 0; j < lsa->GetNLinkRecords (); ++j)
+        {
+          GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+          if (l->GetLinkType () == GlobalRoutingLinkRecord::PointToPoint)
+            {
+              hostSources.push_back (std::make_pair (m_vertexIndex[lsa->GetLinkStateId ()], l->GetLinkData ()));
+            }
+        }
+    }
+  std::vector<std::pair<uint32_t, Prefix_t> > networkSources[2]; // transit networks, stub networks
+  for (uint32_t i = 0; i < m_lsdb->GetNumLSAs (); ++i)
+    {
+      GlobalRoutingLSA *lsa = m_lsdb->GetLSAByIndex (i);
+      uint32_t index = m_vertexIndex[lsa->GetLinkStateId ()];
+      if (lsa->GetLSType () == GlobalRoutingLSA::NetworkLSA)
+        {
+          uint32_t mask = lsa->GetNetworkLSANetworkMask ().Get ();
+          Prefix_t prefix (lsa->GetLinkStateId ().Get () & mask, mask);
+          if (std::binary_search (stubs.begin (), stubs.end (), prefix))
+            {
+              networkSources[0].push_back (std::make_pair (index, prefix));
+            }
+          continue;
         }
+      for (uint32_t j = 0; j < lsa->GetNLinkRecords (); ++j)
+        {
+          GlobalRoutingLinkRecord *l = lsa->GetLinkRecord (j);
+          Prefix_t prefix (l->GetLinkId ().Get () & l->GetLinkData ().Get (), l->GetLinkData ().Get ());
+          if (l->GetLinkType () == GlobalRoutingLinkRecord::StubNetwork
+              && std::binary_search (stubs.begin (), stubs.end (), prefix))
+            {
+              networkSources[1].push_back (std::make_pair (index, prefix));
+            }
+        }
+    }
+
+  std::vector<SPFContext> contexts;
+  uint32_t patched = 0;
+  for (uint32_t r = 0; r < roots.size (); ++r)
+    {
+      SPFState &state = m_states[r];
+      bool recompute = neighbors.count (state.routerId) > 0;
+      if (state.stub && !recompute)
+        {
+          // The default route of a stub router only depends on its neighbor
+          continue;
+        }
+      std::vector<uint32_t> const &d = state.distance;
+      for (std::vector<SPFEdge>::const_iterator e = removed.begin (); !recompute && e != removed.end (); ++e)
+        {
+          recompute = d[e->from] != SPF_INFINITY && uint64_t (d[e->from]) + e->metric == d[e->to];
+        }
+      for (std::vector<SPFEdge>::const_iterator e = added.begin (); !recompute && e != added.end (); ++e)
+        {
+          recompute = d[e->from] != SPF_INFINITY && uint64_t (d[e->from]) + e->metric <= d[e->to];
+        }
+
+      SPFContext ctx;
+      PrepareSPF (ctx, roots[r].first, roots[r].second);
+      if (recompute)
+        {
+          if (ctx.routing)
+            {
+              while (ctx.routing->GetNRoutes () > 0)
+                {
+                  ctx.routing->RemoveRoute (0);
+                }
+            }
+          ctx.state = &state;
+          contexts.push_back (ctx);
+          continue;
+        }
+
+//
+// The SPF tree of this router did not change: replace the routes to the
+// destinations of the changed LSAs, in the order SPFCalculate () adds them.
+//
+      ++patched;
+      if (ctx.routing == 0)
+        {
+          continue;
+        }
+      ctx.routing->RemoveRoutesTo (hostDests, stubDests);
+      uint32_t self = m_vertexIndex[state.routerId];
+      for (std::vector<std::pair<uint32_t, Ipv4Address> >::const_iterator i = hostSources.begin ();
+           i != hostSources.end (); ++i)
+        {
+          if (i->first != self && d[i->first] != SPF_INFINITY)
+            {
+              ExitSet_t const &exits = state.exitSets[state.exits[i->first]];
+              for (ExitSet_t::const_iterator x = exits.begin (); x != exits.end (); ++x)
+                {
+                  AddRoute (ctx, *x, SPFRoute::HOST, i->second, Ipv4Mask::GetOnes ());
+                }
+            }
+        }
+      // Transit networks are added as they enter the tree, stub networks
+      // in the walk of the tree
+      for (uint32_t k = 0; k < 2; ++k)
+        {
+          std::vector<std::pair<uint64_t, uint32_t> > order;
+          for (uint32_t i = 0; i < networkSources[k].size (); ++i)
+            {
+              uint32_t v = networkSources[k][i].first;
+              if (v != self && d[v] != SPF_INFINITY)
+                {
+                  uint64_t key = k == 0 ? (uint64_t (d[v]) << 32) | state.rank[v] : state.rank[v];
+                  order.push_back (std::make_pair (key, i));
+                }
+            }
+          std::sort (order.begin (), order.end ());
+          for (uint32_t i = 0; i < order.size (); ++i)
+            {
+              std::pair<uint32_t, Prefix_t> const &source = networkSources[k][order[i].second];
+              ExitSet_t const &exits = state.exitSets[state.exits[source.first]];
+              for (ExitSet_t::const_iterator x = exits.begin (); x != exits.end (); ++x)
+                {
+                  AddRoute (ctx, *x, SPFRoute::NETWORK, Ipv4Address (source.second.first),
+                            Ipv4Mask (source.second.second));
+                }
+            }
+        }
+      InstallRoutes (ctx);
+    }
+
+  NS_LOG_INFO ("Computing the routes of " << contexts.size () << " routers again, updated "
+               << patched << " routers");
+  UintegerValue threads;
+  g_globalRoutingThreads.GetValue (threads);
+  SPFCalculateAll (contexts, threads.Get ());
+  return true;
+}
+
+void
+GlobalRouteManagerImpl::PrepareSPF (SPFContext &ctx, Ipv4Address routerId, Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << routerId << node);
+  ctx.routerId = routerId;
+  ctx.nodeId = 0;
+  ctx.checkStub = NodeList::GetNNodes () > 0;
+  ctx.routing = 0;
+  ctx.addresses.clear ();
+  ctx.root = 0;
+  ctx.arena = 0;
+  ctx.routes.clear ();
+  ctx.state = 0;
+  if (node == 0)
+    {
+      NS_LOG_LOGIC ("Can't find root node " << routerId);
+      return;
+    }
+  ctx.nodeId = node->GetId ();
+//
+// Routing information is updated using the Ipv4 interface.  If the node is
+// acting as an IP version 4 router, it should absolutely have an Ipv4 
+// interface.  The addresses are those searched by GetInterfaceForPrefix (),
+// in the same order.
+//
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  NS_ASSERT_MSG (ipv4, 
+                 "GlobalRouteManagerImpl::PrepareSPF (): "
+                 "GetObject for <Ipv4> interface failed");
+  for (uint32_t i = 0; i < ipv4->GetNInterfaces (); ++i)
+    {
+      for (uint32_t j = 0; j < ipv4->GetNAddresses (i); ++j)
+        {
+          ctx.addresses.push_back (std::make_pair (ipv4->GetAddress (i, j).GetLocal (), i));
+        }
+    }
+  Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
+  ctx.routing = router->GetRoutingProtocol ();
+  NS_ASSERT (ctx.routing);
+}
+
+void
+GlobalRouteManagerImpl::InstallRoutes (SPFContext &ctx)
+{
+  NS_LOG_FUNCTION (this << ctx.routerId << ctx.routes.size ());
+  if (ctx.routing)
+    {
+      for (std::vector<SPFRoute>::const_iterator i = ctx.routes.begin (); i != ctx.routes.end (); ++i)
+        {
+          switch (i->kind)
+            {
+            case SPFRoute::HOST:
+              ctx.routing->AddHostRouteTo (i->dest, i->nextHop, i->interface);
+              break;
+            case SPFRoute::NETWORK:
+              ctx.routing->AddNetworkRouteTo (i->dest, i->mask, i->nextHop, i->interface);
+              break;
+            case SPFRoute::EXTERNAL:
+              ctx.routing->AddASExternalRouteTo (i->dest, i->mask, i->nextHop, i->interface);
+              break;
+            }
+        }
+    }
+  std::vector<SPFRoute> ().swap (ctx.routes);
+}
+
+void
+GlobalRouteManagerImpl::SPFCalculateAll (std::vector<SPFContext> &contexts, uint32_t threads)
+{
+  NS_LOG_FUNCTION (this << contexts.size () << threads);
+#ifdef HAVE_PTHREAD_H
+  if (threads == 0)
+    {
+      threads = std::max (std::thread::hardware_concurrency (), 1u);
+    }
+  // Logging is not thread-safe
+  if (!g_log.IsNoneEnabled ())
+    {
+      threads = 1;
+    }
+  threads = std::min<uint32_t> (threads, contexts.size ());
+#else
+  threads = 1;
+#endif
+
+  if (threads <= 1)
+    {
+      SPFArena arena;
+      for (std::vector<SPFContext>::iterator i = contexts.begin (); i != contexts.end (); ++i)
+        {
+          i->arena = &arena;
+          SPFCalculate (*i);
+          InstallRoutes (*i);
+        }
+      return;
+    }
+
+#ifdef HAVE_PTHREAD_H
+//
+// The workers take the routers in order and the calling thread installs the
+// routes of each router as soon as its calculation is done, so that the
+// routing tables are built in the same order as with a single thread.  The
+// workers stay at most a few routers ahead of the installation, which
+// bounds the memory used by the routes not yet installed.
+//
+  uint32_t window = 4 * threads;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::vector<bool> done (contexts.size (), false);
+  uint32_t next = 0;
+  uint32_t installed = 0;
+
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; ++t)
+    {
+      workers.push_back (std::thread ([&] ()
+        {
+          // Each worker reuses its own vertices
+          SPFArena arena;
+          std::unique_lock<std::mutex> lock (mutex);
+          for (;;)
+            {
+              changed.wait (lock, [&] () { return next == contexts.size () || next < installed + window; });
+              if (next == contexts.size ())
+                {
+                  break;
+                }
+              uint32_t i = next++;
+              lock.unlock ();
+              contexts[i].arena = &arena;
+              SPFCalculate (contexts[i]);
+              lock.lock ();
+              done[i] = true;
+              changed.notify_all ();
+            }
+        }));
+    }
+
+  for (uint32_t i = 0; i < contexts.size (); ++i)
+    {
+      {
+        std::unique_lock<std::mutex> lock (mutex);
+        changed.wait (lock, [&] () { return done[i]; });
+      }
+      InstallRoutes (contexts[i]);
+      std::lock_guard<std::mutex> lock (mutex);
+      ++installed;
+      changed.notify_all ();
+    }
+  for (std::vector<std::thread>::iterator i = workers.begin (); i != workers.end (); ++i)
+    {
+      i->join ();
+    }
+#endif
+}
+
+GlobalRoutingLSA::SPFStatus
+GlobalRouteManagerImpl::GetStatus (SPFContext &ctx, uint32_t index) const
+{
+  return ctx.arena->status[index];
+}
+
+void
+GlobalRouteManagerImpl::SetStatus (SPFContext &ctx, uint32_t index, GlobalRoutingLSA::SPFStatus status)
+{
+  ctx.arena->status[index] = status;
+}
+
+SPFVertex*
+GlobalRouteManagerImpl::NewVertex (SPFContext &ctx, uint32_t index)
+{
+  SPFArena &arena = *ctx.arena;
+  NS_ASSERT (arena.status[index] == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED);
+  SPFVertex *v = &arena.vertices[index];
+  v->Reset (m_lsdb->GetLSAByIndex (index));
+  arena.used.push_back (index);
+  return v;
+}
+
+uint32_t
+GlobalRouteManagerImpl::GetVertexIndex (SPFContext &ctx, SPFVertex const* v) const
+{
+  NS_ASSERT (v >= &ctx.arena->vertices[0] && v < &ctx.arena->vertices[0] + ctx.arena->vertices.size ());
+  return v - &ctx.arena->vertices[0];
+}
+
+void
+GlobalRouteManagerImpl::ReleaseVertices (SPFContext &ctx)
+{
+  SPFArena &arena = *ctx.arena;
+  for (std::vector<uint32_t>::const_iterator i = arena.used.begin (); i != arena.used.end (); ++i)
+    {
+      arena.vertices[*i].Reset (0);
+      arena.status[*i] = GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED;
     }
-  NS_LOG_INFO ("Finished SPF calculation");
+  arena.used.clear ();
+  ctx.root = 0;
 }
 
 //
@@ -744,12 +1523,13 @@ GlobalRouteManagerImpl::InitializeRoutes ()
 // vertex already on the candidate list, store the new (lower) cost.
 //
 void
-GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
+GlobalRouteManagerImpl::SPFNext (SPFContext &ctx, SPFVertex* v, CandidateQueue& candidate)
 {
   NS_LOG_FUNCTION (this << v << &candidate);
 
   SPFVertex* w = 0;
   GlobalRoutingLSA* w_lsa = 0;
+  uint32_t w_index = 0;
   GlobalRoutingLinkRecord *l = 0;
   uint32_t distance = 0;
   uint32_t numRecordsInVertex = 0;
@@ -797,16 +1577,18 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // Lookup the link state advertisement of the new link -- we call it <w> in
 // the link state database.
 //
-              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-              NS_ASSERT (w_lsa);
+              w_index = m_lsdb->GetLSAIndex (l->GetLinkId ());
+              NS_ASSERT (w_index < m_lsdb->GetNumLSAs ());
+              w_lsa = m_lsdb->GetLSAByIndex (w_index);
               NS_LOG_LOGIC ("Found a P2P record from " << 
                             v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
             }
           else if (l->GetLinkType () == 
                    GlobalRoutingLinkRecord::TransitNetwork)
             {
-              w_lsa = m_lsdb->GetLSA (l->GetLinkId ());
-              NS_ASSERT (w_lsa);
+              w_index = m_lsdb->GetLSAIndex (l->GetLinkId ());
+              NS_ASSERT (w_index < m_lsdb->GetNumLSAs ());
+              w_lsa = m_lsdb->GetLSAByIndex (w_index);
               NS_LOG_LOGIC ("Found a Transit record from " << 
                             v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
             }
@@ -818,12 +1600,13 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // Get w_lsa:  In case of V is Network-LSA
       if (v->GetVertexType () == SPFVertex::VertexNetwork) 
         {
-          w_lsa = m_lsdb->GetLSAByLinkData 
+          w_index = m_lsdb->GetLSAIndexByLinkData 
               (v->GetLSA ()->GetAttachedRouter (i));
-          if (!w_lsa)
+          if (w_index == m_lsdb->GetNumLSAs ())
             {
               continue;
             }
+          w_lsa = m_lsdb->GetLSAByIndex (w_index);
           NS_LOG_LOGIC ("Found a Network LSA from " << 
                         v->GetVertexId () << " to " << w_lsa->GetLinkStateId ());
         }
@@ -836,7 +1619,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // If the link is to a router that is already in the shortest path first tree
 // then we have it covered -- ignore it.
 //
-      if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_IN_SPFTREE) 
+      if (GetStatus (ctx, w_index) == GlobalRoutingLSA::LSA_SPF_IN_SPFTREE) 
         {
           NS_LOG_LOGIC ("Skipping ->  LSA "<< 
                         w_lsa->GetLinkStateId () << " already in SPF tree");
@@ -861,7 +1644,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
       NS_LOG_LOGIC ("Considering w_lsa " << w_lsa->GetLinkStateId ());
 
 // Is there already vertex w in candidate list?
-      if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED)
+      if (GetStatus (ctx, w_index) == GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED)
         {
 // Calculate nexthop to w
 // We need to figure out how to actually get to the new router represented
@@ -870,10 +1653,10 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // used to forward the packets.
 
 // prepare vertex w
-          w = new SPFVertex (w_lsa);
-          if (SPFNexthopCalculation (v, w, l, distance))
+          w = NewVertex (ctx, w_index);
+          if (SPFNexthopCalculation (ctx, v, w, l, distance))
             {
-              w_lsa->SetStatus (GlobalRoutingLSA::LSA_SPF_CANDIDATE);
+              SetStatus (ctx, w_index, GlobalRoutingLSA::LSA_SPF_CANDIDATE);
 //
 // Push this new vertex onto the priority queue (ordered by distance from the
 // root node).
@@ -888,15 +1671,15 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
             NS_ASSERT_MSG (0, "SPFNexthopCalculation never " 
                            << "return false, but it does now!");
         }
-      else if (w_lsa->GetStatus () == GlobalRoutingLSA::LSA_SPF_CANDIDATE)
+      else if (GetStatus (ctx, w_index) == GlobalRoutingLSA::LSA_SPF_CANDIDATE)
         {
 //
 // We have already considered the link represented by <w>.  What wse have to
 // do now is to decide if this new router represents a route with a shorter
 // distance metric.
 //
-// So, locate the vertex in the candidate queue and take a look at the 
-// distance.
+// So, take a look at the distance of the vertex in the candidate queue, which
+// is the vertex of the LSA in the arena.
 
 /* (quagga-0.98.6) W is already on the candidate list; call it cw.
 * Compare the previously calculated cost (cw->distance)
@@ -904,7 +1687,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 * if we've found a shorter path.
 */
           SPFVertex* cw;
-          cw = candidate.Find (w_lsa->GetLinkStateId ());
+          cw = &ctx.arena->vertices[w_index];
           if (cw->GetDistanceFromRoot () < distance)
             {
 //
@@ -933,16 +1716,13 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // (ospf_spf.c::859), although the detail implementation
 // is very different from quagga (blame ns3::GlobalRouteManagerImpl)
 
-// prepare vertex w
-              w = new SPFVertex (w_lsa);
-              SPFNexthopCalculation (v, w, l, distance);
+// prepare vertex w, which is never added to the children of v
+              w = &ctx.arena->scratch;
+              w->Reset (w_lsa);
+              SPFNexthopCalculation (ctx, v, w, l, distance);
               cw->MergeRootExitDirections (w);
               cw->MergeParent (w);
-// SPFVertexAddParent (w) is necessary as the destructor of 
-// SPFVertex checks if the vertex and its parent is linked
-// bidirectionally
-              SPFVertexAddParent (w);
-              delete w;
+              w->Reset (0);
             }
           else // cw->GetDistanceFromRoot () > w->GetDistanceFromRoot ()
             {
@@ -954,13 +1734,13 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 // N.B. the nexthop_calculation is conditional, if it finds a valid nexthop
 // it will call spf_add_parents, which will flush the old parents
 //
-              if (SPFNexthopCalculation (v, cw, l, distance))
+              if (SPFNexthopCalculation (ctx, v, cw, l, distance))
                 {
 //
 // If we've changed the cost to get to the vertex represented by <w>, we 
 // must reorder the priority queue keyed to that cost.
 //
-                  candidate.Reorder ();
+                  candidate.Update (cw);
                 }
             } // new lower cost path found
         } // end W is already on the candidate list
@@ -979,6 +1759,7 @@ GlobalRouteManagerImpl::SPFNext (SPFVertex* v, CandidateQueue& candidate)
 //
 int
 GlobalRouteManagerImpl::SPFNexthopCalculation (
+  SPFContext &ctx,
   SPFVertex* v, 
   SPFVertex* w,
   GlobalRoutingLinkRecord* l,
@@ -995,7 +1776,7 @@ GlobalRouteManagerImpl::SPFNexthopCalculation (
 */
 
 //
-// The vertex m_spfroot is a distinguished vertex representing the node at
+// The vertex ctx.root is a distinguished vertex representing the node at
 // the root of the calculations.  That is, it is the node for which we are
 // calculating the routes.
 //
@@ -1017,7 +1798,7 @@ GlobalRouteManagerImpl::SPFNexthopCalculation (
 // The point-to-point link information is only useful in this calculation when
 // we are examining the root node. 
 //
-  if (v == m_spfroot)
+  if (v == ctx.root)
     {
 //
 // In this case <v> is the root node, which means it is the starting point
@@ -1062,7 +1843,7 @@ GlobalRouteManagerImpl::SPFNexthopCalculation (
 // from the perspective of <v> -- remember that <l> is the link "from"
 // <v> "to" <w>.
 //
-          uint32_t outIf = FindOutgoingInterfaceId (l->GetLinkData ());
+          uint32_t outIf = FindOutgoingInterfaceId (ctx, l->GetLinkData ());
 
           w->SetRootExitDirection (nextHop, outIf);
           w->SetDistanceFromRoot (distance);
@@ -1080,7 +1861,7 @@ GlobalRouteManagerImpl::SPFNexthopCalculation (
           GlobalRoutingLSA* w_lsa = w->GetLSA ();
           NS_ASSERT (w_lsa->GetLSType () == GlobalRoutingLSA::NetworkLSA);
 // Find outgoing interface ID for this network
-          uint32_t outIf = FindOutgoingInterfaceId (w_lsa->GetLinkStateId (), 
+          uint32_t outIf = FindOutgoingInterfaceId (ctx, w_lsa->GetLinkStateId (), 
                                                     w_lsa->GetNetworkLSANetworkMask () );
 // Set the next hop to 0.0.0.0 meaning "not exist"
           Ipv4Address nextHop = Ipv4Address::GetZero ();
@@ -1097,7 +1878,7 @@ GlobalRouteManagerImpl::SPFNexthopCalculation (
   else if (v->GetVertexType () == SPFVertex::VertexNetwork) 
     {
 // See if any of v's parents are the root
-      if (v->GetParent () == m_spfroot)
+      if (v->GetParent () == ctx.root)
         {
 // 16.1.1 para 5. ...the parent vertex is a network that
 // directly connects the calculating router to the destination
@@ -1257,7 +2038,7 @@ GlobalRouteManagerImpl::DebugSPFCalculate (Ipv4Address root)
 // to be run
 //
 bool
-GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
+GlobalRouteManagerImpl::CheckForStubNode (SPFContext &ctx, Ipv4Address root)
 {
   NS_LOG_FUNCTION (this << root);
   GlobalRoutingLSA *rlsa = m_lsdb->GetLSA (root);
@@ -1320,15 +2101,15 @@ GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
               if (lr->GetLinkId () == myRouterId)
                 {
                   // Next hop is stored in the LinkID field of lr
-                  Ptr<GlobalRouter> router = rlsa->GetNode ()->GetObject<GlobalRouter> ();
-                  NS_ASSERT (router);
-                  Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-                  NS_ASSERT (gr);
-                  gr->AddNetworkRouteTo (Ipv4Address ("0.0.0.0"), Ipv4Mask ("0.0.0.0"), lr->GetLinkData (), 
-                                         FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                  SPFRoute route;
+                  route.kind = SPFRoute::NETWORK;
+                  route.dest = Ipv4Address ("0.0.0.0");
+                  route.mask = Ipv4Mask ("0.0.0.0");
+                  route.nextHop = lr->GetLinkData ();
+                  route.interface = FindOutgoingInterfaceId (ctx, transitLink->GetLinkData ());
+                  ctx.routes.push_back (route);
                   NS_LOG_LOGIC ("Inserting default route for node " << myRouterId << " to next hop " << 
-                                lr->GetLinkData () << " via interface " << 
-                                FindOutgoingInterfaceId (transitLink->GetLinkData ()));
+                                lr->GetLinkData () << " via interface " << route.interface);
                   return true;
                 }
             }
@@ -1337,17 +2118,56 @@ GlobalRouteManagerImpl::CheckForStubNode (Ipv4Address root)
   return false;
 }
 
-// quagga ospf_spf_calculate
 void
 GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 {
   NS_LOG_FUNCTION (this << root);
+//
+// Walk the list of nodes looking for the one that has the router ID of
+// the root.  This is the one we're going to write the routing information
+// to.
+//
+  Ptr<Node> rootNode;
+  NodeList::Iterator listEnd = NodeList::End ();
+  for (NodeList::Iterator i = NodeList::Begin (); i != listEnd; i++)
+    {
+      Ptr<GlobalRouter> rtr = (*i)->GetObject<GlobalRouter> ();
+      if (rtr && rtr->GetRouterId () == root)
+        {
+          rootNode = *i;
+          break;
+        }
+    }
+
+  SPFContext ctx;
+  PrepareSPF (ctx, root, rootNode);
+  SPFArena arena;
+  ctx.arena = &arena;
+  SPFCalculate (ctx);
+  InstallRoutes (ctx);
+}
+
+// quagga ospf_spf_calculate
+void
+GlobalRouteManagerImpl::SPFCalculate (SPFContext &ctx)
+{
+  Ipv4Address root = ctx.routerId;
+  NS_LOG_FUNCTION (this << root);
 
   SPFVertex *v;
 //
-// Initialize the Link State Database.
+// The vertices and the status of the LSAs are kept in the arena of the
+// context rather than in the LSAs, which are shared by the calculations of
+// all the routers.  They are released at the end of each calculation, so
+// none has been explored yet.
 //
-  m_lsdb->Initialize ();
+  SPFArena &arena = *ctx.arena;
+  if (arena.vertices.size () != m_lsdb->GetNumLSAs ())
+    {
+      NS_ASSERT (arena.used.empty ());
+      std::vector<SPFVertex> (m_lsdb->GetNumLSAs ()).swap (arena.vertices);
+      arena.status.assign (m_lsdb->GetNumLSAs (), GlobalRoutingLSA::LSA_SPF_NOT_EXPLORED);
+    }
 //
 // The candidate queue is a priority queue of SPFVertex objects, with the top
 // of the queue being the closest vertex in terms of distance from the root
@@ -1360,16 +2180,30 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // calculation.  Each router (and corresponding network) is a vertex in the
 // shortest path first (SPF) tree.
 //
-  v = new SPFVertex (m_lsdb->GetLSA (root));
+  uint32_t rootIndex = m_lsdb->GetLSAIndex (root);
+  NS_ASSERT_MSG (rootIndex < m_lsdb->GetNumLSAs (), "No LSA for root " << root);
+  v = NewVertex (ctx, rootIndex);
 // 
 // This vertex is the root of the SPF tree and it is distance 0 from the root.
 // We also mark this vertex as being in the SPF tree.
 //
-  m_spfroot= v;
+  ctx.root = v;
   v->SetDistanceFromRoot (0);
-  v->GetLSA ()->SetStatus (GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+  SetStatus (ctx, rootIndex, GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
   NS_LOG_LOGIC ("Starting SPFCalculate for node " << root);
 
+  if (ctx.state)
+    {
+      SPFState &state = *ctx.state;
+      state.routerId = root;
+      state.stub = false;
+      state.distance.assign (m_vertexIndex.size (), SPF_INFINITY);
+      state.rank.assign (m_vertexIndex.size (), SPF_INFINITY);
+      state.exits.assign (m_vertexIndex.size (), 0);
+      state.exitSets.clear ();
+      state.nRanked = 0;
+    }
+
 //
 // Optimize SPF calculation, for ns-3.
 // We do not need to calculate SPF for every node in the network if this
@@ -1377,10 +2211,17 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // reached.  Instead, short-circuit this computation and just install
 // a default route in the CheckForStubNode() method.
 //
-  if (NodeList::GetNNodes () > 0 && CheckForStubNode (root))
+  if (ctx.checkStub && CheckForStubNode (ctx, root))
     {
       NS_LOG_LOGIC ("SPFCalculate truncated for stub node " << root);
-      delete m_spfroot;
+      if (ctx.state)
+        {
+          ctx.state->stub = true;
+          std::vector<uint32_t> ().swap (ctx.state->distance);
+          std::vector<uint32_t> ().swap (ctx.state->rank);
+          std::vector<uint32_t> ().swap (ctx.state->exits);
+        }
+      ReleaseVertices (ctx);
       return;
     }
 
@@ -1400,7 +2241,7 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // shortest path).  If the new vertices represent shorter paths, we use them
 // and update the path cost.
 //
-      SPFNext (v, candidate);
+      SPFNext (ctx, v, candidate);
 //
 // RFC2328 16.1. (3). 
 //
@@ -1428,7 +2269,7 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 // Update the status field of the vertex to indicate that it is in the SPF
 // tree.
 //
-      v->GetLSA ()->SetStatus (GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
+      SetStatus (ctx, GetVertexIndex (ctx, v), GlobalRoutingLSA::LSA_SPF_IN_SPFTREE);
 //
 // The current vertex has a parent pointer.  By calling this rather oddly 
 // named method (blame quagga) we add the current vertex to the list of 
@@ -1444,12 +2285,9 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 //
 // RFC2328 16.1. (4). 
 //
-// This is the method that actually adds the routes.  It'll walk the list
-// of nodes in the system, looking for the node corresponding to the router
-// ID of the root of the tree -- that is the router we're building the routes
-// for.  It looks for the Ipv4 interface of that node and remembers it.  So
-// we are only actually adding routes to that one node at the root of the SPF 
-// tree.
+// This is the method that actually adds the routes.  The routes are recorded
+// in the context, and only written to the node at the root of the SPF tree
+// by InstallRoutes ().
 //
 // We're going to pop of a pointer to every vertex in the tree except the 
 // root in order of distance from the root.  For each of the vertices, we call
@@ -1467,11 +2305,11 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
 //
       if (v->GetVertexType () == SPFVertex::VertexRouter)
         {
-          SPFIntraAddRouter (v);
+          SPFIntraAddRouter (ctx, v);
         }
       else if (v->GetVertexType () == SPFVertex::VertexNetwork)
         {
-          SPFIntraAddTransit (v);
+          SPFIntraAddTransit (ctx, v);
         }
       else
         {
@@ -1486,26 +2324,28 @@ GlobalRouteManagerImpl::SPFCalculate (Ipv4Address root)
     }  // end for loop
 
 // Second stage of SPF calculation procedure
-  SPFProcessStubs (m_spfroot);
+  SPFProcessStubs (ctx, ctx.root);
+  if (ctx.state)
+    {
+      ctx.state->exitSetIds.clear ();
+    }
   for (uint32_t i = 0; i < m_lsdb->GetNumExtLSAs (); i++)
     {
-      m_spfroot->ClearVertexProcessed ();
+      ctx.root->ClearVertexProcessed ();
       GlobalRoutingLSA *extlsa = m_lsdb->GetExtLSA (i);
       NS_LOG_LOGIC ("Processing External LSA with id " << extlsa->GetLinkStateId ());
-      ProcessASExternals (m_spfroot, extlsa);
+      ProcessASExternals (ctx, ctx.root, extlsa);
     }
 
 //
-// We're all done setting the routing information for the node at the root of
-// the SPF tree.  Delete all of the vertices and corresponding resources.  Go
-// possibly do it again for the next router.
+// We're all done computing the routing information for the node at the root
+// of the SPF tree.  Release all of the vertices for the next calculation.
 //
-  delete m_spfroot;
-  m_spfroot = 0;
+  ReleaseVertices (ctx);
 }
 
 void
-GlobalRouteManagerImpl::ProcessASExternals (SPFVertex* v, GlobalRoutingLSA* extlsa)
+GlobalRouteManagerImpl::ProcessASExternals (SPFContext &ctx, SPFVertex* v, GlobalRoutingLSA* extlsa)
 {
   NS_LOG_FUNCTION (this << v << extlsa);
   NS_LOG_LOGIC ("Processing external for destination " << 
@@ -1519,7 +2359,7 @@ GlobalRouteManagerImpl::ProcessASExternals (SPFVertex* v, GlobalRoutingLSA* extl
       if ((rlsa->GetLinkStateId ()) == (extlsa->GetAdvertisingRouter ()))
         {
           NS_LOG_LOGIC ("Found advertising router to destination");
-          SPFAddASExternal (extlsa,v);
+          SPFAddASExternal (ctx, extlsa, v);
         }
     }
   for (uint32_t i = 0; i < v->GetNChildren (); i++)
@@ -1527,7 +2367,7 @@ GlobalRouteManagerImpl::ProcessASExternals (SPFVertex* v, GlobalRoutingLSA* extl
       if (!v->GetChild (i)->IsVertexProcessed ())
         {
           NS_LOG_LOGIC ("Vertex's child " << i << " not yet processed, processing...");
-          ProcessASExternals (v->GetChild (i), extlsa);
+          ProcessASExternals (ctx, v->GetChild (i), extlsa);
           v->GetChild (i)->SetVertexProcessed (true);
         }
     }
@@ -1539,15 +2379,15 @@ GlobalRouteManagerImpl::ProcessASExternals (SPFVertex* v, GlobalRoutingLSA* extl
 //
 
 void
-GlobalRouteManagerImpl::SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v)
+GlobalRouteManagerImpl::SPFAddASExternal (SPFContext &ctx, GlobalRoutingLSA *extlsa, SPFVertex *v)
 {
   NS_LOG_FUNCTION (this << extlsa << v);
 
-  NS_ASSERT_MSG (m_spfroot, "GlobalRouteManagerImpl::SPFAddASExternal (): Root pointer not set");
+  NS_ASSERT_MSG (ctx.root, "GlobalRouteManagerImpl::SPFAddASExternal (): Root pointer not set");
 // Two cases to consider: We are advertising the external ourselves
 // => No need to add anything
 // OR find best path to the advertising router
-  if (v->GetVertexId () == m_spfroot->GetVertexId ())
+  if (v->GetVertexId () == ctx.root->GetVertexId ())
     {
       NS_LOG_LOGIC ("External is on local host: " 
                     << v->GetVertexId () << "; returning");
@@ -1555,110 +2395,18 @@ GlobalRouteManagerImpl::SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v
     }
   NS_LOG_LOGIC ("External is on remote host: " 
                 << extlsa->GetAdvertisingRouter () << "; installing");
-
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = extlsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddASExternalRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add external network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImpl::SPFAddASExternal (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = extlsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = extlsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+//
+// The vertex <v> has the next hops and outgoing interfaces (one per equal
+// cost path) precalculated for us, to reach the advertising router from
+// the root node.
+//
+  AddRoutesVia (ctx, v, SPFRoute::EXTERNAL, tempip, tempmask);
 }
 
 
@@ -1666,10 +2414,14 @@ GlobalRouteManagerImpl::SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v
 // stub link records will exist for point-to-point interfaces and for
 // broadcast interfaces for which no neighboring router can be found
 void
-GlobalRouteManagerImpl::SPFProcessStubs (SPFVertex* v)
+GlobalRouteManagerImpl::SPFProcessStubs (SPFContext &ctx, SPFVertex* v)
 {
   NS_LOG_FUNCTION (this << v);
   NS_LOG_LOGIC ("Processing stubs for " << v->GetVertexId ());
+  if (ctx.state)
+    {
+      KeepVertex (ctx, v);
+    }
   if (v->GetVertexType () == SPFVertex::VertexRouter)
     {
       GlobalRoutingLSA *rlsa = v->GetLSA ();
@@ -1683,7 +2435,7 @@ GlobalRouteManagerImpl::SPFProcessStubs (SPFVertex* v)
           if (l->GetLinkType () == GlobalRoutingLinkRecord::StubNetwork)
             {
               NS_LOG_LOGIC ("Found a Stub record to " << l->GetLinkId ());
-              SPFIntraAddStub (l, v);
+              SPFIntraAddStub (ctx, l, v);
               continue;
             }
         }
@@ -1692,7 +2444,7 @@ GlobalRouteManagerImpl::SPFProcessStubs (SPFVertex* v)
     {
       if (!v->GetChild (i)->IsVertexProcessed ())
         {
-          SPFProcessStubs (v->GetChild (i));
+          SPFProcessStubs (ctx, v->GetChild (i));
           v->GetChild (i)->SetVertexProcessed (true);
         }
     }
@@ -1700,11 +2452,11 @@ GlobalRouteManagerImpl::SPFProcessStubs (SPFVertex* v)
 
 // RFC2328 16.1. second stage. 
 void
-GlobalRouteManagerImpl::SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex* v)
+GlobalRouteManagerImpl::SPFIntraAddStub (SPFContext &ctx, GlobalRoutingLinkRecord *l, SPFVertex* v)
 {
   NS_LOG_FUNCTION (this << l << v);
 
-  NS_ASSERT_MSG (m_spfroot, 
+  NS_ASSERT_MSG (ctx.root, 
                  "GlobalRouteManagerImpl::SPFIntraAddStub (): Root pointer not set");
 
   // XXX simplifed logic for the moment.  There are two cases to consider:
@@ -1712,201 +2464,46 @@ GlobalRouteManagerImpl::SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex*
   //    (already handled above)
   // 2) the stub network is on a remote router, so I should use the
   // same next hop that I use to get to vertex v
-  if (v->GetVertexId () == m_spfroot->GetVertexId ())
+  if (v->GetVertexId () == ctx.root->GetVertexId ())
     {
       NS_LOG_LOGIC ("Stub is on local host: " << v->GetVertexId () << "; returning");
       return;
     }
   NS_LOG_LOGIC ("Stub is on remote host: " << v->GetVertexId () << "; installing");
-//
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to QI for that interface.  If there's no GlobalRouter interface, the node
-// in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to QI
-// for that interface.  If the node is acting as an IP version 4 router, it
-// should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "QI for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          NS_ASSERT_MSG (v->GetLSA (), 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask (l->GetLinkData ().Get ());
-          Ipv4Address tempip = l->GetLinkId ();
-          tempip = tempip.CombineMask (tempmask);
-//
-// Here's why we did all of that work.  We're going to add a host route to the
-// host address found in the m_linkData field of the point-to-point link
-// record.  In the case of a point-to-point link, this is the local IP address
-// of the node connected to the link.  Each of these point-to-point links
-// will correspond to a local interface that has an IP address to which
-// the node at the root of the SPF tree can send packets.  The vertex <v> 
-// (corresponding to the node that has these links and interfaces) has 
-// an m_nextHop address precalculated for us that is the address to which the
-// root node should send packets to be forwarded to these IP addresses.
-// Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
-// which the packets should be send for forwarding.
-//
-
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all next-hop-IPs and out-going-interfaces for reaching
-          // the stub network gateway 'v' from the root node
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative");
-                }
-            }
-          return;
-        } // if
-    } // for
+  NS_ASSERT_MSG (v->GetLSA (), 
+                 "GlobalRouteManagerImpl::SPFIntraAddStub (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask (l->GetLinkData ().Get ());
+  Ipv4Address tempip = l->GetLinkId ();
+  tempip = tempip.CombineMask (tempmask);
+//
+// The vertex <v> (corresponding to the node that has the stub network) has
+// the next hops and outgoing interfaces (one per equal cost path)
+// precalculated for us, to reach it from the root node.
+//
+  AddRoutesVia (ctx, v, SPFRoute::NETWORK, tempip, tempmask);
 }
 
 //
 // Return the interface number corresponding to a given IP address and mask
-// This is a wrapper around GetInterfaceForPrefix(), but we first
-// have to find the right node pointer to pass to that function.
+// This is the equivalent of GetInterfaceForPrefix() on the node at the root
+// of the SPF tree, whose addresses were gathered by PrepareSPF ().
 // If no such interface is found, return -1 (note:  unit test framework
 // for routing assumes -1 to be a legal return value)
 //
 int32_t
-GlobalRouteManagerImpl::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mask amask)
+GlobalRouteManagerImpl::FindOutgoingInterfaceId (SPFContext &ctx, Ipv4Address a, Ipv4Mask amask)
 {
   NS_LOG_FUNCTION (this << a << amask);
-//
-// We have an IP address <a> and a vertex ID of the root of the SPF tree.
-// The question is what interface index does this address correspond to.
-// The answer is a little complicated since we have to find a pointer to
-// the node corresponding to the vertex ID, find the Ipv4 interface on that
-// node in order to iterate the interfaces and find the one corresponding to
-// the address in question.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-//
-// Walk the list of nodes in the system looking for the one corresponding to
-// the node at the root of the SPF tree.  This is the node for which we are
-// building the routing table.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+  for (std::vector<std::pair<Ipv4Address, int32_t> >::const_iterator i = ctx.addresses.begin ();
+       i != ctx.addresses.end (); ++i)
     {
-      Ptr<Node> node = *i;
-
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-//
-// If the node doesn't have a GlobalRouter interface it can't be the one
-// we're interested in.
-//
-      if (rtr == 0)
-        {
-          continue;
-        }
-
-      if (rtr->GetRouterId () == routerId)
+      if (i->first.CombineMask (amask) == a.CombineMask (amask))
         {
-//
-// This is the node we're building the routing table for.  We're going to need
-// the Ipv4 interface to look for the ipv4 interface index.  Since this node
-// is participating in routing IP version 4 packets, it certainly must have 
-// an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::FindOutgoingInterfaceId (): "
-                         "GetObject for <Ipv4> interface failed");
-//
-// Look through the interfaces on this node for one that has the IP address
-// we're looking for.  If we find one, return the corresponding interface
-// index, or -1 if not found.
-//
-          int32_t interface = ipv4->GetInterfaceForPrefix (a, amask);
-
-#if 0
-          if (interface < 0)
-            {
-              NS_FATAL_ERROR ("GlobalRouteManagerImpl::FindOutgoingInterfaceId(): "
-                              "Expected an interface associated with address a:" << a);
-            }
-#endif 
-          return interface;
+          return i->second;
         }
     }
-//
-// Couldn't find it.
-//
-  NS_LOG_LOGIC ("FindOutgoingInterfaceId():Can't find root node " << routerId);
+  NS_LOG_LOGIC ("FindOutgoingInterfaceId(): no interface of " << ctx.routerId << " for " << a);
   return -1;
 }
 
@@ -1927,77 +2524,24 @@ GlobalRouteManagerImpl::FindOutgoingInterfaceId (Ipv4Address a, Ipv4Mask amask)
 // route.
 //
 void
-GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
+GlobalRouteManagerImpl::SPFIntraAddRouter (SPFContext &ctx, SPFVertex* v)
 {
   NS_LOG_FUNCTION (this << v);
 
-  NS_ASSERT_MSG (m_spfroot, 
+  NS_ASSERT_MSG (ctx.root, 
                  "GlobalRouteManagerImpl::SPFIntraAddRouter (): Root pointer not set");
 //
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
-
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
-    {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
-
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("Setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "GetObject for <Ipv4> interface failed");
-//
 // Get the Global Router Link State Advertisement from the vertex we're
 // adding the routes to.  The LSA will have a number of attached Global Router
 // Link Records corresponding to links off of that vertex / node.  We're going
 // to be interested in the records corresponding to point-to-point links.
 //
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
-                         "Expected valid LSA in SPFVertex* v");
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddRouter (): "
+                 "Expected valid LSA in SPFVertex* v");
 
-          uint32_t nLinkRecords = lsa->GetNLinkRecords ();
+  uint32_t nLinkRecords = lsa->GetNLinkRecords ();
 //
 // Iterate through the link records on the vertex to which we're going to add
 // routes.  To make sure we're being clear, we're going to add routing table
@@ -2006,18 +2550,18 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // the local side of the point-to-point links found on the node described by
 // the vertex <v>.
 //
-          NS_LOG_LOGIC (" Node " << node->GetId () <<
-                        " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
-          for (uint32_t j = 0; j < nLinkRecords; ++j)
-            {
+  NS_LOG_LOGIC (" Node " << ctx.nodeId <<
+                " found " << nLinkRecords << " link records in LSA " << lsa << "with LinkStateId "<< lsa->GetLinkStateId ());
+  for (uint32_t j = 0; j < nLinkRecords; ++j)
+    {
 //
 // We are only concerned about point-to-point links
 //
-              GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
-              if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
-                {
-                  continue;
-                }
+      GlobalRoutingLinkRecord *lr = lsa->GetLinkRecord (j);
+      if (lr->GetLinkType () != GlobalRoutingLinkRecord::PointToPoint)
+        {
+          continue;
+        }
 //
 // Here's why we did all of that work.  We're going to add a host route to the
 // host address found in the m_linkData field of the point-to-point link
@@ -2031,153 +2575,96 @@ GlobalRouteManagerImpl::SPFIntraAddRouter (SPFVertex* v)
 // Similarly, the vertex <v> has an m_rootOif (outbound interface index) to
 // which the packets should be send for forwarding.
 //
-              Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-              if (router == 0)
-                {
-                  continue;
-                }
-              Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-              NS_ASSERT (gr);
-              // walk through all available exit directions due to ECMP,
-              // and add host route for each of the exit direction toward
-              // the vertex 'v'
-              for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-                {
-                  SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-                  Ipv4Address nextHop = exit.first;
-                  int32_t outIf = exit.second;
-                  if (outIf >= 0)
-                    {
-                      gr->AddHostRouteTo (lr->GetLinkData (), nextHop,
-                                          outIf);
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " adding host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " and outgoing interface " << outIf);
-                    }
-                  else
-                    {
-                      NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                    " NOT able to add host route to " << lr->GetLinkData () <<
-                                    " using next hop " << nextHop <<
-                                    " since outgoing interface id is negative " << outIf);
-                    }
-                } // for all routes from the root the vertex 'v'
-            }
-//
-// Done adding the routes for the selected node.
-//
-          return;
-        }
+      AddRoutesVia (ctx, v, SPFRoute::HOST, lr->GetLinkData (), Ipv4Mask::GetOnes ());
     }
 }
+
 void
-GlobalRouteManagerImpl::SPFIntraAddTransit (SPFVertex* v)
+GlobalRouteManagerImpl::SPFIntraAddTransit (SPFContext &ctx, SPFVertex* v)
 {
   NS_LOG_FUNCTION (this << v);
 
-  NS_ASSERT_MSG (m_spfroot, 
+  NS_ASSERT_MSG (ctx.root, 
                  "GlobalRouteManagerImpl::SPFIntraAddTransit (): Root pointer not set");
 //
-// The root of the Shortest Path First tree is the router to which we are 
-// going to write the actual routing table entries.  The vertex corresponding
-// to this router has a vertex ID which is the router ID of that node.  We're
-// going to use this ID to discover which node it is that we're actually going
-// to update.
-//
-  Ipv4Address routerId = m_spfroot->GetVertexId ();
+// Get the Global Router Link State Advertisement from the vertex we're
+// adding the routes to.  The LSA of a transit network gives the network
+// address and mask.
+//
+  GlobalRoutingLSA *lsa = v->GetLSA ();
+  NS_ASSERT_MSG (lsa, 
+                 "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
+                 "Expected valid LSA in SPFVertex* v");
+  Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
+  Ipv4Address tempip = lsa->GetLinkStateId ();
+  tempip = tempip.CombineMask (tempmask);
+  AddRoutesVia (ctx, v, SPFRoute::NETWORK, tempip, tempmask);
+}
 
-  NS_LOG_LOGIC ("Vertex ID = " << routerId);
-//
-// We need to walk the list of nodes looking for the one that has the router
-// ID corresponding to the root vertex.  This is the one we're going to write
-// the routing information to.
-//
-  NodeList::Iterator i = NodeList::Begin (); 
-  NodeList::Iterator listEnd = NodeList::End ();
-  for (; i != listEnd; i++)
+void
+GlobalRouteManagerImpl::AddRoutesVia (SPFContext &ctx, SPFVertex* v, SPFRoute::Kind kind,
+                                      Ipv4Address dest, Ipv4Mask mask)
+{
+  // walk through all available exit directions due to ECMP,
+  // and add a route for each of the exit direction toward
+  // the vertex 'v'
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
     {
-      Ptr<Node> node = *i;
-//
-// The router ID is accessible through the GlobalRouter interface, so we need
-// to GetObject for that interface.  If there's no GlobalRouter interface, 
-// the node in question cannot be the router we want, so we continue.
-// 
-      Ptr<GlobalRouter> rtr = 
-        node->GetObject<GlobalRouter> ();
-
-      if (rtr == 0)
-        {
-          NS_LOG_LOGIC ("No GlobalRouter interface on node " << 
-                        node->GetId ());
-          continue;
-        }
-//
-// If the router ID of the current node is equal to the router ID of the 
-// root of the SPF tree, then this node is the one for which we need to 
-// write the routing tables.
-//
-      NS_LOG_LOGIC ("Considering router " << rtr->GetRouterId ());
+      AddRoute (ctx, v->GetRootExitDirection (i), kind, dest, mask);
+    }
+}
 
-      if (rtr->GetRouterId () == routerId)
-        {
-          NS_LOG_LOGIC ("setting routes for node " << node->GetId ());
-//
-// Routing information is updated using the Ipv4 interface.  We need to 
-// GetObject for that interface.  If the node is acting as an IP version 4 
-// router, it should absolutely have an Ipv4 interface.
-//
-          Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
-          NS_ASSERT_MSG (ipv4, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "GetObject for <Ipv4> interface failed");
-//
-// Get the Global Router Link State Advertisement from the vertex we're
-// adding the routes to.  The LSA will have a number of attached Global Router
-// Link Records corresponding to links off of that vertex / node.  We're going
-// to be interested in the records corresponding to point-to-point links.
-//
-          GlobalRoutingLSA *lsa = v->GetLSA ();
-          NS_ASSERT_MSG (lsa, 
-                         "GlobalRouteManagerImpl::SPFIntraAddTransit (): "
-                         "Expected valid LSA in SPFVertex* v");
-          Ipv4Mask tempmask = lsa->GetNetworkLSANetworkMask ();
-          Ipv4Address tempip = lsa->GetLinkStateId ();
-          tempip = tempip.CombineMask (tempmask);
-          Ptr<GlobalRouter> router = node->GetObject<GlobalRouter> ();
-          if (router == 0)
-            {
-              continue;
-            }
-          Ptr<Ipv4GlobalRouting> gr = router->GetRoutingProtocol ();
-          NS_ASSERT (gr);
-          // walk through all available exit directions due to ECMP,
-          // and add host route for each of the exit direction toward
-          // the vertex 'v'
-          for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
-            {
-              SPFVertex::NodeExit_t exit = v->GetRootExitDirection (i);
-              Ipv4Address nextHop = exit.first;
-              int32_t outIf = exit.second;
+void
+GlobalRouteManagerImpl::AddRoute (SPFContext &ctx, SPFVertex::NodeExit_t const &exit, SPFRoute::Kind kind,
+                                  Ipv4Address dest, Ipv4Mask mask)
+{
+  Ipv4Address nextHop = exit.first;
+  int32_t outIf = exit.second;
+  if (outIf >= 0)
+    {
+      SPFRoute route;
+      route.kind = kind;
+      route.dest = dest;
+      route.mask = mask;
+      route.nextHop = nextHop;
+      route.interface = outIf;
+      ctx.routes.push_back (route);
+      NS_LOG_LOGIC ("Node " << ctx.nodeId <<
+                    " add route to " << dest << "/" << mask <<
+                    " using next hop " << nextHop <<
+                    " via interface " << outIf);
+    }
+  else
+    {
+      NS_LOG_LOGIC ("Node " << ctx.nodeId <<
+                    " NOT able to add route to " << dest << "/" << mask <<
+                    " using next hop " << nextHop <<
+                    " since outgoing interface id is negative " << outIf);
+    }
+}
 
-              if (outIf >= 0)
-                {
-                  gr->AddNetworkRouteTo (tempip, tempmask, nextHop, outIf);
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " via interface " << outIf);
-                }
-              else
-                {
-                  NS_LOG_LOGIC ("(Route " << i << ") Node " << node->GetId () <<
-                                " NOT able to add network route to " << tempip <<
-                                " using next hop " << nextHop <<
-                                " since outgoing interface id is negative " << outIf);
-                }
-            }
-        }
-    } 
+void
+GlobalRouteManagerImpl::KeepVertex (SPFContext &ctx, SPFVertex* v)
+{
+  SPFState &state = *ctx.state;
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash>::const_iterator index =
+    m_vertexIndex.find (v->GetVertexId ());
+  NS_ASSERT (index != m_vertexIndex.end ());
+  state.distance[index->second] = v->GetDistanceFromRoot ();
+  state.rank[index->second] = state.nRanked++;
+
+  ExitSet_t exits;
+  for (uint32_t i = 0; i < v->GetNRootExitDirections (); i++)
+    {
+      exits.push_back (v->GetRootExitDirection (i));
+    }
+  std::map<ExitSet_t, uint32_t>::const_iterator id = state.exitSetIds.find (exits);
+  if (id == state.exitSetIds.end ())
+    {
+      id = state.exitSetIds.insert (std::make_pair (exits, state.exitSets.size ())).first;
+      state.exitSets.push_back (exits);
+    }
+  state.exits[index->second] = id->second;
 }
 
 // Derived from quagga ospf_vertex_add_parents ()
@@ -26,6 +26,7 @@
 #include <list>
 #include <queue>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include "ns3/object.h"
 #include "ns3/ptr.h"
@@ -122,6 +123,18 @@ public:
  */
   ~SPFVertex();
 
+/**
+ * @brief Reinitialize an SPFVertex as the constructor from an LSA does.
+ *
+ * Unlike the destructor, the parent and children vertices are forgotten
+ * but not deleted: this is how the vertices kept in a flat array by the
+ * Global Route Manager are reused from one SPF calculation to the next.
+ *
+ * @param lsa The Link State Advertisement used for finding initial values,
+ * or 0 for an uninitialized vertex.
+ */
+  void Reset (GlobalRoutingLSA* lsa);
+
 /**
  * @brief Get the Vertex Type field of a SPFVertex object.
  *
@@ -532,9 +545,9 @@ private:
   uint32_t m_distanceFromRoot; //!< Distance from root node
   int32_t m_rootOif; //!< root Output Interface
   Ipv4Address m_nextHop; //!< next hop
-  typedef std::list< NodeExit_t > ListOfNodeExit_t; //!< container of Exit nodes
+  typedef std::vector< NodeExit_t > ListOfNodeExit_t; //!< container of Exit nodes
   ListOfNodeExit_t m_ecmpRootExits; //!< store the multiple root's exits for supporting ECMP
-  typedef std::list<SPFVertex*> ListOfSPFVertex_t; //!< container of SPFVertexes
+  typedef std::vector<SPFVertex*> ListOfSPFVertex_t; //!< container of SPFVertexes
   ListOfSPFVertex_t m_parents; //!< parent list
   ListOfSPFVertex_t m_children; //!< Children list
   bool m_vertexProcessed; //!< Flag to note whether vertex has been processed in stage two of SPF computation
@@ -575,7 +588,9 @@ private:
  * also export their own LSAs.
  *
  * This class implements a searchable database of LSAs gathered from every
- * router in the simulation.
+ * router in the simulation.  The router and network LSAs are numbered in
+ * insertion order and found through hash tables, by link state ID or by the
+ * LinkData of the transit records of routers.
  */
 class GlobalRouteManagerLSDB
 {
@@ -616,8 +631,8 @@ public:
  * @brief Look up the Link State Advertisement associated with the given
  * link state ID (address).
  *
- * The database map is searched for the given IPV4 address and corresponding
- * GlobalRoutingLSA is returned.
+ * The database hash table is searched for the given IPV4 address and
+ * corresponding GlobalRoutingLSA is returned.
  *
  * @see GlobalRoutingLSA
  * @see Ipv4Address
@@ -641,6 +656,45 @@ public:
  */
   GlobalRoutingLSA* GetLSAByLinkData (Ipv4Address addr) const;
 
+/**
+ * @brief Get the number of router and network Link State Advertisements.
+ *
+ * @returns the number of LSAs, which are numbered from 0 in insertion order.
+ */
+  uint32_t GetNumLSAs () const;
+
+/**
+ * @brief Get a router or network Link State Advertisement by its number.
+ *
+ * @param index the number of the LSA, smaller than GetNumLSAs ()
+ * @returns A pointer to the Link State Advertisement.
+ */
+  GlobalRoutingLSA* GetLSAByIndex (uint32_t index) const;
+
+/**
+ * @brief Look up the number of the Link State Advertisement associated with
+ * the given link state ID (address).
+ *
+ * @see GetLSA
+ * @param addr The IP address associated with the LSA.  Typically the Router
+ * ID.
+ * @returns the number of the LSA, or GetNumLSAs () if there is none.
+ */
+  uint32_t GetLSAIndex (Ipv4Address addr) const;
+
+/**
+ * @brief Look up the number of the Link State Advertisement of the router
+ * with a TransitNetwork link record of the given LinkData.
+ *
+ * When several routers have such a record, the one of lowest link state ID
+ * is returned.
+ *
+ * @see GetLSAByLinkData
+ * @param addr The address of the interface of the router on the network.
+ * @returns the number of the LSA, or GetNumLSAs () if there is none.
+ */
+  uint32_t GetLSAIndexByLinkData (Ipv4Address addr) const;
+
 /**
  * @brief Set all LSA flags to an initialized state, for SPF computation
  *
@@ -676,10 +730,14 @@ public:
 
 
 private:
-  typedef std::map<Ipv4Address, GlobalRoutingLSA*> LSDBMap_t; //!< container of IPv4 addresses / Link State Advertisements
-  typedef std::pair<Ipv4Address, GlobalRoutingLSA*> LSDBPair_t; //!< pair of IPv4 addresses / Link State Advertisements
+  friend class GlobalRouteManagerImpl; //!< compares databases in UpdateGlobalRoutes ()
+
+  typedef std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash> LSDBMap_t; //!< container of IPv4 addresses / LSA numbers
+  typedef std::pair<Ipv4Address, uint32_t> LSDBPair_t; //!< pair of IPv4 addresses / LSA numbers
 
-  LSDBMap_t m_database; //!< database of IPv4 addresses / Link State Advertisements
+  std::vector<GlobalRoutingLSA*> m_lsas; //!< router and network Link State Advertisements, in insertion order
+  LSDBMap_t m_database; //!< number of the LSA of each link state ID
+  LSDBMap_t m_linkData; //!< number of the router LSA found by GetLSAByLinkData () for each LinkData
   std::vector<GlobalRoutingLSA*> m_extdatabase; //!< database of External Link State Advertisements
 
 /**
@@ -735,6 +793,31 @@ public:
  */
   virtual void InitializeRoutes ();
 
+/**
+ * @brief Rebuild the routing database and update the routes of the nodes
+ * after links went up or down.
+ *
+ * The first call deletes the routes and computes them again, like
+ * DeleteGlobalRoutes (), BuildGlobalRoutingDatabase () and
+ * InitializeRoutes (), but also keeps the SPF tree of each router
+ * (distances and exit directions).  The next calls compare the new
+ * database with the previous one and only change the routes that depend
+ * on the changed LSAs: routers for which a shortest path or an adjacency
+ * changed run their SPF calculation again, the others only update the
+ * routes to the addresses and stub networks of the changed LSAs.  When
+ * the set of LSAs itself changes (e.g., a designated router went down),
+ * or when a changed stub network overlaps another network (the routes to
+ * overlapping networks are looked up in routing table order), all the
+ * routes are computed again.
+ *
+ * Keeping the SPF trees takes about 12 bytes per router and per vertex
+ * (router or transit network); they are released by DeleteGlobalRoutes ()
+ * and InitializeRoutes ().  The routes to each destination are the same,
+ * and in the same order, as after a complete recomputation, but the
+ * destinations may be listed in a different order.
+ */
+  virtual void UpdateGlobalRoutes ();
+
 /**
  * @brief Debugging routine; allow client code to supply a pre-built LSDB
  */
@@ -766,8 +849,212 @@ private:
  */
   GlobalRouteManagerImpl& operator= (GlobalRouteManagerImpl& srmi);
 
-  SPFVertex* m_spfroot; //!< the root node
+  /// A route found by the SPF calculation of a router, to be installed
+  struct SPFRoute
+  {
+    /// Kind of route
+    enum Kind
+    {
+      HOST,     //!< host route (Ipv4GlobalRouting::AddHostRouteTo)
+      NETWORK,  //!< network route (Ipv4GlobalRouting::AddNetworkRouteTo)
+      EXTERNAL  //!< AS external route (Ipv4GlobalRouting::AddASExternalRouteTo)
+    };
+    Kind kind;            //!< kind of route
+    Ipv4Address dest;     //!< destination host or network
+    Ipv4Mask mask;        //!< network mask (unused by host routes)
+    Ipv4Address nextHop;  //!< next hop
+    uint32_t interface;   //!< outgoing interface
+  };
+
+  /**
+   * \brief The vertices of the SPF calculations run by one thread.
+   *
+   * There is one vertex and one status per router and network LSA, at the
+   * number of the LSA in the database, so that building a tree neither
+   * allocates vertices nor looks up their status in a hash table.  Only
+   * the vertices used by a calculation are reset after it.
+   */
+  struct SPFArena
+  {
+    std::vector<SPFVertex> vertices; //!< vertex of each LSA
+    std::vector<GlobalRoutingLSA::SPFStatus> status; //!< status of each LSA
+    std::vector<uint32_t> used; //!< numbers of the LSAs whose vertex is in use
+    SPFVertex scratch; //!< vertex of an equal-cost path being merged into a candidate
+  };
+
+  /// Exit directions of the root towards a vertex, in SPFVertex order
+  typedef std::vector<SPFVertex::NodeExit_t> ExitSet_t;
+
+  /**
+   * \brief SPF tree of a router, kept by UpdateGlobalRoutes ().
+   *
+   * The vectors are indexed by the vertex indices of m_vertexIndex.  Most
+   * vertices share their exit directions with many others, so the distinct
+   * sets of exit directions are stored once.
+   */
+  struct SPFState
+  {
+    Ipv4Address routerId;           //!< router ID of the root
+    bool stub;                      //!< whether the root only got a default route
+    std::vector<uint32_t> distance; //!< distance of each vertex, SPF_INFINITY if not in the tree
+    std::vector<uint32_t> rank;     //!< rank of each vertex in the walk of SPFProcessStubs ()
+    std::vector<uint32_t> exits;    //!< index in exitSets of the exit directions of each vertex
+    std::vector<ExitSet_t> exitSets; //!< distinct sets of exit directions
+    uint32_t nRanked;               //!< vertices ranked so far, during the calculation
+    std::map<ExitSet_t, uint32_t> exitSetIds; //!< indices of exitSets, during the calculation
+  };
+
+  /// A link of the graph of routers and transit networks, as seen by SPFNext ()
+  struct SPFEdge
+  {
+    uint32_t from;    //!< vertex index of the origin
+    uint32_t to;      //!< vertex index of the destination
+    uint32_t metric;  //!< cost of the link
+    /**
+     * \param other another link
+     * \returns true if this link sorts before the other one
+     */
+    bool operator< (SPFEdge const &other) const
+    {
+      return from != other.from ? from < other.from
+             : to != other.to ? to < other.to : metric < other.metric;
+    }
+  };
+
+  /**
+   * \brief State of the SPF calculation rooted at one router.
+   *
+   * The context is filled by PrepareSPF () from the node of the router;
+   * SPFCalculate () then only reads the LSDB and the context and records
+   * the routes in it, so that the calculations of several routers can run
+   * on different threads.  InstallRoutes () writes the routes to the
+   * routing protocol of the node.
+   */
+  struct SPFContext
+  {
+    Ipv4Address routerId;  //!< router ID of the root
+    uint32_t nodeId;       //!< ID of the node of the root (for logging)
+    bool checkStub;        //!< whether a stub router only gets a default route
+    Ptr<Ipv4GlobalRouting> routing; //!< routing protocol of the node, or 0 (only used by InstallRoutes ())
+    std::vector<std::pair<Ipv4Address, int32_t> > addresses; //!< addresses of the node and their interface, in interface order
+    SPFVertex* root;       //!< root of the SPF tree
+    SPFArena* arena;       //!< vertices and status of the LSAs
+    std::vector<SPFRoute> routes; //!< routes found, in installation order
+    SPFState* state;       //!< where to keep the SPF tree, or 0
+  };
+
   GlobalRouteManagerLSDB* m_lsdb; //!< the Link State DataBase (LSDB) of the Global Route Manager
+  std::vector<SPFState> m_states; //!< SPF trees of the routers, in NodeList order, kept by UpdateGlobalRoutes ()
+  bool m_statesValid;             //!< whether m_states match the routes and m_lsdb
+  std::unordered_map<Ipv4Address, uint32_t, Ipv4AddressHash> m_vertexIndex; //!< vertex index of each router and network LSA ID
+
+  /**
+   * \brief Find the routers running an SPF calculation.
+   * \param roots [out] the router ID of each router, in NodeList order, and
+   * the node on which its routes are installed (0 if there is none)
+   */
+  void FindRoots (std::vector<std::pair<Ipv4Address, Ptr<Node> > > &roots);
+
+  /**
+   * \brief Compute the routes of every router.
+   * \param keep whether to keep the SPF trees in m_states
+   */
+  void ComputeRoutes (bool keep);
+
+  /**
+   * \brief Update the routes after the database changed.
+   *
+   * \param old the database the kept SPF trees were computed on; m_lsdb is
+   * the new one
+   * \returns false if the routes can not be updated incrementally, in which
+   * case nothing was changed
+   */
+  bool UpdateRoutes (GlobalRouteManagerLSDB* old);
+
+  /**
+   * \brief List the links between the vertices of a database.
+   * \param lsdb the database
+   * \param edges [out] the links, sorted
+   */
+  void CollectEdges (GlobalRouteManagerLSDB* lsdb, std::vector<SPFEdge> &edges) const;
+
+  /**
+   * \brief Keep the distance, rank and exit directions of a vertex in the
+   * SPF tree of the context.
+   * \param ctx the context
+   * \param v the vertex
+   */
+  void KeepVertex (SPFContext &ctx, SPFVertex* v);
+
+  /**
+   * \brief Fill the context of the SPF calculation of a router.
+   *
+   * Must be called from the main thread.
+   *
+   * \param ctx the context
+   * \param routerId the router ID of the root
+   * \param node the node with that router ID, or 0 if there is none
+   */
+  void PrepareSPF (SPFContext &ctx, Ipv4Address routerId, Ptr<Node> node);
+
+  /**
+   * \brief Write the routes found by an SPF calculation to the routing
+   * protocol of the root's node, and release them.
+   *
+   * Must be called from the main thread.
+   *
+   * \param ctx the context
+   */
+  void InstallRoutes (SPFContext &ctx);
+
+  /**
+   * \brief Run the SPF calculations of several routers.
+   *
+   * The calculations are shared among \a threads threads; the routes are
+   * installed by the calling thread in the order of \a contexts, as soon
+   * as each calculation ends, so the routing tables are the same as with a
+   * single thread.
+   *
+   * \param contexts the prepared contexts
+   * \param threads the number of threads
+   */
+  void SPFCalculateAll (std::vector<SPFContext> &contexts, uint32_t threads);
+
+  /**
+   * \param ctx the context
+   * \param index the number of the LSA in the database
+   * \returns the status of the LSA in the calculation
+   */
+  GlobalRoutingLSA::SPFStatus GetStatus (SPFContext &ctx, uint32_t index) const;
+
+  /**
+   * \brief Set the status of an LSA in a calculation.
+   * \param ctx the context
+   * \param index the number of the LSA in the database
+   * \param status the status
+   */
+  void SetStatus (SPFContext &ctx, uint32_t index, GlobalRoutingLSA::SPFStatus status);
+
+  /**
+   * \brief Get the vertex of an LSA for a calculation.
+   * \param ctx the context
+   * \param index the number of the LSA in the database
+   * \returns the vertex of the arena, initialized from the LSA
+   */
+  SPFVertex* NewVertex (SPFContext &ctx, uint32_t index);
+
+  /**
+   * \param ctx the context
+   * \param v a vertex of the arena of the context
+   * \returns the number of the LSA of the vertex
+   */
+  uint32_t GetVertexIndex (SPFContext &ctx, SPFVertex const* v) const;
+
+  /**
+   * \brief Reset the vertices used by a calculation, for the next one.
+   * \param ctx the context
+   */
+  void ReleaseVertices (SPFContext &ctx);
 
   /**
    * \brief Test if a node is a stub, from an OSPF sense.
@@ -776,19 +1063,29 @@ private:
    * can safely be added to the next-hop router and SPF does not need
    * to be run
    *
+   * \param ctx the context
    * \param root the root node
    * \returns true if the node is a stub
    */
-  bool CheckForStubNode (Ipv4Address root);
+  bool CheckForStubNode (SPFContext &ctx, Ipv4Address root);
 
   /**
-   * \brief Calculate the shortest path first (SPF) tree
+   * \brief Calculate the shortest path first (SPF) tree and install the
+   * routes of a router
    *
-   * Equivalent to quagga ospf_spf_calculate
    * \param root the root node
    */
   void SPFCalculate (Ipv4Address root);
 
+  /**
+   * \brief Calculate the shortest path first (SPF) tree
+   *
+   * Equivalent to quagga ospf_spf_calculate.  The routes are recorded in
+   * the context.
+   * \param ctx the context
+   */
+  void SPFCalculate (SPFContext &ctx);
+
   /**
    * \brief Process Stub nodes
    *
@@ -796,17 +1093,19 @@ private:
    * stub link records will exist for point-to-point interfaces and for
    * broadcast interfaces for which no neighboring router can be found
    *
+   * \param ctx the context
    * \param v vertex to be processed
    */
-  void SPFProcessStubs (SPFVertex* v);
+  void SPFProcessStubs (SPFContext &ctx, SPFVertex* v);
 
   /**
    * \brief Process Autonomous Systems (AS) External LSA
    *
+   * \param ctx the context
    * \param v vertex to be processed
    * \param extlsa external LSA
    */
-  void ProcessASExternals (SPFVertex* v, GlobalRoutingLSA* extlsa);
+  void ProcessASExternals (SPFContext &ctx, SPFVertex* v, GlobalRoutingLSA* extlsa);
 
   /**
    * \brief Examine the links in v's LSA and update the list of candidates with any
@@ -826,10 +1125,11 @@ private:
    * vertices not already on the list.  If a lower-cost path is found to a
    * vertex already on the candidate list, store the new (lower) cost.
    *
+   * \param ctx the context
    * \param v the vertex
    * \param candidate the SPF candidate queue
    */
-  void SPFNext (SPFVertex* v, CandidateQueue& candidate);
+  void SPFNext (SPFContext &ctx, SPFVertex* v, CandidateQueue& candidate);
 
   /**
    * \brief Calculate nexthop from root through V (parent) to vertex W (destination)
@@ -838,13 +1138,14 @@ private:
    * This method is derived from quagga ospf_nexthop_calculation() 16.1.1.
    * For now, this is greatly simplified from the quagga code
    *
+   * \param ctx the context
    * \param v the parent
    * \param w the destination
    * \param l the link record
    * \param distance the target distance
    * \returns 1 on success
    */
-  int SPFNexthopCalculation (SPFVertex* v, SPFVertex* w, 
+  int SPFNexthopCalculation (SPFContext &ctx, SPFVertex* v, SPFVertex* w,
                              GlobalRoutingLinkRecord* l, uint32_t distance);
 
   /**
@@ -904,47 +1205,78 @@ private:
    * a destination IP address, reachable from the root, to which we add a host
    * route.
    *
+   * \param ctx the context
    * \param v the vertex
    *
    */
-  void SPFIntraAddRouter (SPFVertex* v);
+  void SPFIntraAddRouter (SPFContext &ctx, SPFVertex* v);
 
   /**
    * \brief Add a transit to the routing tables
    *
+   * \param ctx the context
    * \param v the vertex
    */
-  void SPFIntraAddTransit (SPFVertex* v);
+  void SPFIntraAddTransit (SPFContext &ctx, SPFVertex* v);
 
   /**
    * \brief Add a stub to the routing tables
    *
+   * \param ctx the context
    * \param l the global routing link record
    * \param v the vertex
    */
-  void SPFIntraAddStub (GlobalRoutingLinkRecord *l, SPFVertex* v);
+  void SPFIntraAddStub (SPFContext &ctx, GlobalRoutingLinkRecord *l, SPFVertex* v);
 
   /**
    * \brief Add an external route to the routing tables
    *
+   * \param ctx the context
    * \param extlsa the external LSA
    * \param v the vertex
    */
-  void SPFAddASExternal (GlobalRoutingLSA *extlsa, SPFVertex *v);
+  void SPFAddASExternal (SPFContext &ctx, GlobalRoutingLSA *extlsa, SPFVertex *v);
+
+  /**
+   * \brief Record a route to a destination through each of the root's
+   * exit directions towards a vertex.
+   *
+   * \param ctx the context
+   * \param v the vertex
+   * \param kind the kind of route
+   * \param dest the destination
+   * \param mask the destination mask
+   */
+  void AddRoutesVia (SPFContext &ctx, SPFVertex* v, SPFRoute::Kind kind,
+                     Ipv4Address dest, Ipv4Mask mask);
+
+  /**
+   * \brief Record a route to a destination through one exit direction of
+   * the root, unless its outgoing interface is unknown.
+   *
+   * \param ctx the context
+   * \param exit the exit direction
+   * \param kind the kind of route
+   * \param dest the destination
+   * \param mask the destination mask
+   */
+  void AddRoute (SPFContext &ctx, SPFVertex::NodeExit_t const &exit, SPFRoute::Kind kind,
+                 Ipv4Address dest, Ipv4Mask mask);
 
   /**
    * \brief Return the interface number corresponding to a given IP address and mask
    *
-   * This is a wrapper around GetInterfaceForPrefix(), but we first
-   * have to find the right node pointer to pass to that function.
+   * This is the equivalent of Ipv4::GetInterfaceForPrefix() on the node
+   * of the root, using the addresses gathered by PrepareSPF ().
    * If no such interface is found, return -1 (note:  unit test framework
    * for routing assumes -1 to be a legal return value)
    *
+   * \param ctx the context
    * \param a the target IP address
    * \param amask the target subnet mask
    * \return the outgoing interface number
    */
-  int32_t FindOutgoingInterfaceId (Ipv4Address a, 
+  int32_t FindOutgoingInterfaceId (SPFContext &ctx, Ipv4Address a, 
                                    Ipv4Mask amask = Ipv4Mask ("255.255.255.255"));
 };
 
@@ -65,6 +65,14 @@ public:
  */
   static void InitializeRoutes ();
 
+/**
+ * @brief Rebuild the routing database and update the routes after links
+ * went up or down, recomputing only the routes that changed.
+ *
+ * @see GlobalRouteManagerImpl::UpdateGlobalRoutes
+ */
+  static void UpdateGlobalRoutes ();
+
 private:
 /**
  * @brief Global Route Manager copy construction is disallowed.  There's no 
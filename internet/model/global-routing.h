@@ -55,9 +55,11 @@
  * ns3::GlobalRouteManager::PopulateRoutingTables (), prior to the 
  * ns3::Simulator::Run() call.
  *
- * There are two attributes of Ipv4GlobalRouting that govern behavior.
+ * These attributes of Ipv4GlobalRouting govern behavior.
  * - Ipv4GlobalRouting::RandomEcmpRouting
  * - Ipv4GlobalRouting::RespondToInterfaceEvents
+ * - Ipv4GlobalRouting::EcmpHashRouting, with EcmpHashFields,
+ *   EcmpHashFunction, EcmpHashSeed and FlowletTimeout
  *
  * \section impl Implementation
  *
@@ -18,6 +18,7 @@
  * Author: Mathieu Lacage <mathieu.lacage@sophia.inria.fr>
  */
 
+#include <algorithm>
 #include "ipv4-end-point-demux.h"
 #include "ipv4-end-point.h"
 #include "ipv4-interface-address.h"
@@ -40,30 +41,108 @@ Ipv4EndPointDemux::~Ipv4EndPointDemux ()
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
     {
       Ipv4EndPoint *endPoint = *i;
+      endPoint->m_demux = 0;
       delete endPoint;
     }
   m_endPoints.clear ();
 }
 
-bool
-Ipv4EndPointDemux::LookupPortLocal (uint16_t port)
+size_t
+Ipv4EndPointDemux::PeerKeyHash::operator() (PeerKey const &key) const
 {
-  NS_LOG_FUNCTION (this << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  uint32_t hash = key.peerAddress.Get () ^ ((uint32_t (key.peerPort) << 16) | key.localPort);
+  hash *= 0x9e3779b1;
+  return hash ^ (hash >> 16);
+}
+
+void
+Ipv4EndPointDemux::Insert (Ipv4EndPoint *endPoint)
+{
+  NS_LOG_FUNCTION (this << endPoint);
+  endPoint->m_demux = this;
+  endPoint->m_position = m_endPoints.insert (m_endPoints.end (), endPoint);
+  Port &port = m_ports[endPoint->GetLocalPort ()];
+  if (port.endPoints.empty ())
+    {
+      SetPortUsed (endPoint->GetLocalPort (), true);
+    }
+  endPoint->m_portPosition = port.endPoints.insert (port.endPoints.end (), endPoint);
+  AddPeer (endPoint);
+  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+}
+
+void
+Ipv4EndPointDemux::AddPeer (Ipv4EndPoint *endPoint)
+{
+  if (endPoint->GetPeerAddress () == Ipv4Address::GetAny () && endPoint->GetPeerPort () == 0)
+    {
+      m_ports[endPoint->GetLocalPort ()].unconnected.push_back (endPoint);
+    }
+  else
+    {
+      PeerKey key = { endPoint->GetPeerAddress (), endPoint->GetPeerPort (), endPoint->GetLocalPort () };
+      m_peers.insert (std::make_pair (key, endPoint));
+    }
+}
+
+void
+Ipv4EndPointDemux::RemovePeer (Ipv4EndPoint *endPoint)
+{
+  if (endPoint->GetPeerAddress () == Ipv4Address::GetAny () && endPoint->GetPeerPort () == 0)
     {
-      if ((*i)->GetLocalPort  () == port) 
+      std::vector<Ipv4EndPoint *> &unconnected = m_ports[endPoint->GetLocalPort ()].unconnected;
+      unconnected.erase (std::find (unconnected.begin (), unconnected.end (), endPoint));
+    }
+  else
+    {
+      PeerKey key = { endPoint->GetPeerAddress (), endPoint->GetPeerPort (), endPoint->GetLocalPort () };
+      std::pair<PeerEndPointsI, PeerEndPointsI> range = m_peers.equal_range (key);
+      for (PeerEndPointsI i = range.first; i != range.second; ++i)
         {
-          return true;
+          if (i->second == endPoint)
+            {
+              m_peers.erase (i);
+              break;
+            }
         }
     }
-  return false;
+}
+
+void
+Ipv4EndPointDemux::SetPortUsed (uint16_t port, bool used)
+{
+  if (m_ephemeralPorts.empty () || port < m_portFirst || port > m_portLast)
+    {
+      return;
+    }
+  uint32_t offset = port - m_portFirst;
+  if (used)
+    {
+      m_ephemeralPorts[offset / 64] |= uint64_t (1) << (offset % 64);
+    }
+  else
+    {
+      m_ephemeralPorts[offset / 64] &= ~(uint64_t (1) << (offset % 64));
+    }
+}
+
+bool
+Ipv4EndPointDemux::LookupPortLocal (uint16_t port)
+{
+  NS_LOG_FUNCTION (this << port);
+  return m_ports.find (port) != m_ports.end ();
 }
 
 bool
 Ipv4EndPointDemux::LookupLocal (Ptr<NetDevice> boundNetDevice, Ipv4Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION (this << addr << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (port);
+  if (p == m_ports.end ())
+    {
+      return false;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++) 
     {
       if ((*i)->GetLocalPort () == port &&
           (*i)->GetLocalAddress () == addr &&
@@ -86,8 +165,7 @@ Ipv4EndPointDemux::Allocate (void)
       return 0;
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (Ipv4Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -102,8 +180,7 @@ Ipv4EndPointDemux::Allocate (Ipv4Address address)
       return 0;
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -125,8 +202,7 @@ Ipv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, Ipv4Address address,
       return 0;
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -136,7 +212,26 @@ Ipv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
                              Ipv4Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << localAddress << localPort << peerAddress << peerPort << boundNetDevice);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  // A duplicate has the same peer, so it is indexed with the new end point
+  std::vector<Ipv4EndPoint *> candidates;
+  if (peerAddress == Ipv4Address::GetAny () && peerPort == 0)
+    {
+      std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (localPort);
+      if (p != m_ports.end ())
+        {
+          candidates = p->second.unconnected;
+        }
+    }
+  else
+    {
+      PeerKey key = { peerAddress, peerPort, localPort };
+      std::pair<PeerEndPointsI, PeerEndPointsI> range = m_peers.equal_range (key);
+      for (PeerEndPointsI i = range.first; i != range.second; ++i)
+        {
+          candidates.push_back (i->second);
+        }
+    }
+  for (std::vector<Ipv4EndPoint *>::iterator i = candidates.begin (); i != candidates.end (); i++) 
     {
       if ((*i)->GetLocalPort () == localPort &&
           (*i)->GetLocalAddress () == localAddress &&
@@ -150,9 +245,7 @@ Ipv4EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
     }
   Ipv4EndPoint *endPoint = new Ipv4EndPoint (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
-
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
 
   return endPoint;
 }
@@ -161,15 +254,22 @@ void
 Ipv4EndPointDemux::DeAllocate (Ipv4EndPoint *endPoint)
 {
   NS_LOG_FUNCTION (this << endPoint);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  if (endPoint->m_demux != this)
     {
-      if (*i == endPoint)
-        {
-          delete endPoint;
-          m_endPoints.erase (i);
-          break;
-        }
+      return;
+    }
+  RemovePeer (endPoint);
+  uint16_t localPort = endPoint->GetLocalPort ();
+  Port &port = m_ports[localPort];
+  port.endPoints.erase (endPoint->m_portPosition);
+  if (port.endPoints.empty ())
+    {
+      m_ports.erase (localPort);
+      SetPortUsed (localPort, false);
     }
+  m_endPoints.erase (endPoint->m_position);
+  endPoint->m_demux = 0;
+  delete endPoint;
 }
 
 /*
@@ -202,137 +302,151 @@ Ipv4EndPointDemux::Lookup (Ipv4Address daddr, uint16_t dport,
 {
   NS_LOG_FUNCTION (this << daddr << dport << saddr << sport << incomingInterface);
   
-  EndPoints retval1; // Matches exact on local port, wildcards on others
-  EndPoints retval2; // Matches exact on local port/adder, wildcards on others
-  EndPoints retval3; // Matches all but local address
-  EndPoints retval4; // Exact match on all 4
+  // [0]: Matches exact on local port, wildcards on others
+  // [1]: Matches exact on local port/adder, wildcards on others
+  // [2]: Matches all but local address
+  // [3]: Exact match on all 4
+  EndPoints matches[4];
 
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr << ":" << dport);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  // Only the end points with the source of the packet as peer can match
+  // it exactly, and those without a peer can match it with wildcards
+  PeerKey key = { saddr, sport, dport };
+  std::pair<PeerEndPointsI, PeerEndPointsI> range = m_peers.equal_range (key);
+  for (PeerEndPointsI i = range.first; i != range.second; ++i)
     {
-      Ipv4EndPoint* endP = *i;
-
-      NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
-                                                 << " daddr=" << endP->GetLocalAddress ()
-                                                 << " sport=" << endP->GetPeerPort ()
-                                                 << " saddr=" << endP->GetPeerAddress ());
-
-      if (!endP->IsRxEnabled ())
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                        << " because endpoint can not receive packets");
-          continue;
-        }
-
-      if (endP->GetLocalPort () != dport) 
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
-      if (endP->GetBoundNetDevice ())
+      Match (i->second, daddr, saddr, sport, incomingInterface, matches);
+    }
+  if (matches[3].empty () && matches[2].empty ())
+    {
+      std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (dport);
+      if (p != m_ports.end ())
         {
-          if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+          std::vector<Ipv4EndPoint *> const &unconnected = p->second.unconnected;
+          for (std::vector<Ipv4EndPoint *>::const_iterator i = unconnected.begin (); i != unconnected.end (); ++i)
             {
-              NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                                 << " because endpoint is bound to specific device and"
-                                                 << endP->GetBoundNetDevice ()
-                                                 << " does not match packet device " << incomingInterface->GetDevice ());
-              continue;
+              Match (*i, daddr, saddr, sport, incomingInterface, matches);
             }
         }
+    }
+
+  // Here we find the most exact match
+  EndPoints retval;
+  if (!matches[3].empty ()) retval = matches[3];
+  else if (!matches[2].empty ()) retval = matches[2];
+  else if (!matches[1].empty ()) retval = matches[1];
+  else retval = matches[0];
+
+  NS_ABORT_MSG_IF (retval.size () > 1, "Too many endpoints - perhaps you created too many sockets without binding them to different NetDevices.");
+  return retval;  // might be empty if no matches
+}
 
-      bool localAddressMatchesExact = false;
-      bool localAddressIsAny = false;
-      bool localAddressIsSubnetAny = false;
+void
+Ipv4EndPointDemux::Match (Ipv4EndPoint *endP, Ipv4Address daddr, Ipv4Address saddr, uint16_t sport,
+                          Ptr<Ipv4Interface> incomingInterface, EndPoints matches[4])
+{
+  NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
+                                             << " daddr=" << endP->GetLocalAddress ()
+                                             << " sport=" << endP->GetPeerPort ()
+                                             << " saddr=" << endP->GetPeerAddress ());
 
-      // We have 3 cases:
-      // 1) Exact local / destination address match
-      // 2) Local endpoint bound to Any -> matches anything
-      // 3) Local endpoint bound to x.y.z.0 -> matches Subnet-directed broadcast packet (e.g., x.y.z.255 in a /24 net) and direct destination match.
+  if (!endP->IsRxEnabled ())
+    {
+      NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                    << " because endpoint can not receive packets");
+      return;
+    }
 
-      if (endP->GetLocalAddress () == daddr)
-        {
-          // Case 1:
-          localAddressMatchesExact = true;
-        }
-      else if (endP->GetLocalAddress () == Ipv4Address::GetAny ())
+  if (endP->GetBoundNetDevice ())
+    {
+      if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
         {
-          // Case 2:
-          localAddressIsAny = true;
+          NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                             << " because endpoint is bound to specific device and"
+                                             << endP->GetBoundNetDevice ()
+                                             << " does not match packet device " << incomingInterface->GetDevice ());
+          return;
         }
-      else
+    }
+
+  bool localAddressMatchesExact = false;
+  bool localAddressIsAny = false;
+  bool localAddressIsSubnetAny = false;
+
+  // We have 3 cases:
+  // 1) Exact local / destination address match
+  // 2) Local endpoint bound to Any -> matches anything
+  // 3) Local endpoint bound to x.y.z.0 -> matches Subnet-directed broadcast packet (e.g., x.y.z.255 in a /24 net) and direct destination match.
+
+  if (endP->GetLocalAddress () == daddr)
+    {
+      // Case 1:
+      localAddressMatchesExact = true;
+    }
+  else if (endP->GetLocalAddress () == Ipv4Address::GetAny ())
+    {
+      // Case 2:
+      localAddressIsAny = true;
+    }
+  else
+    {
+      // Case 3:
+      for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
         {
-          // Case 3:
-          for (uint32_t i = 0; i < incomingInterface->GetNAddresses (); i++)
+          Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
+
+          Ipv4Address addrNetpart = addr.GetLocal ().CombineMask (addr.GetMask ());
+          if (endP->GetLocalAddress () == addrNetpart)
             {
-              Ipv4InterfaceAddress addr = incomingInterface->GetAddress (i);
+              NS_LOG_LOGIC ("Endpoint is SubnetDirectedAny " << endP->GetLocalAddress () << "/" << addr.GetMask ().GetPrefixLength ());
 
-              Ipv4Address addrNetpart = addr.GetLocal ().CombineMask (addr.GetMask ());
-              if (endP->GetLocalAddress () == addrNetpart)
+              Ipv4Address daddrNetPart = daddr.CombineMask (addr.GetMask ());
+              if (addrNetpart == daddrNetPart)
                 {
-                  NS_LOG_LOGIC ("Endpoint is SubnetDirectedAny " << endP->GetLocalAddress () << "/" << addr.GetMask ().GetPrefixLength ());
-
-                  Ipv4Address daddrNetPart = daddr.CombineMask (addr.GetMask ());
-                  if (addrNetpart == daddrNetPart)
-                    {
-                      localAddressIsSubnetAny = true;
-                    }
+                  localAddressIsSubnetAny = true;
                 }
             }
-
-          // if no match here, keep looking
-          if (!localAddressIsSubnetAny)
-            continue;
         }
 
-      bool remotePortMatchesExact = endP->GetPeerPort () == sport;
-      bool remotePortMatchesWildCard = endP->GetPeerPort () == 0;
-      bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
-      bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv4Address::GetAny ();
+      // if no match here, keep looking
+      if (!localAddressIsSubnetAny)
+        return;
+    }
 
-      // If remote does not match either with exact or wildcard,
-      // skip this one
-      if (!(remotePortMatchesExact || remotePortMatchesWildCard))
-        continue;
-      if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
-        continue;
+  bool remotePortMatchesExact = endP->GetPeerPort () == sport;
+  bool remotePortMatchesWildCard = endP->GetPeerPort () == 0;
+  bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+  bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv4Address::GetAny ();
 
-      bool localAddressMatchesWildCard = localAddressIsAny || localAddressIsSubnetAny;
+  // If remote does not match either with exact or wildcard,
+  // skip this one
+  if (!(remotePortMatchesExact || remotePortMatchesWildCard))
+    return;
+  if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+    return;
 
-      if (localAddressMatchesExact && remoteAddressMatchesExact && remotePortMatchesExact)
-        { // All 4 match - this is the case of an open TCP connection, for example.
-          NS_LOG_LOGIC ("Found an endpoint for case 4, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval4.push_back (endP);
-        }
-      if (localAddressMatchesWildCard && remoteAddressMatchesExact && remotePortMatchesExact)
-        { // All but local address - no idea what this case could be.
-          NS_LOG_LOGIC ("Found an endpoint for case 3, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval3.push_back (endP);
-        }
-      if (localAddressMatchesExact && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
-        { // Only local port and local address matches exactly - Not yet opened connection
-          NS_LOG_LOGIC ("Found an endpoint for case 2, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval2.push_back (endP);
-        }
-      if (localAddressMatchesWildCard && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
-        { // Only local port matches exactly - Endpoint open to "any" connection
-          NS_LOG_LOGIC ("Found an endpoint for case 1, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
-          retval1.push_back (endP);
-        }
-    }
-
-  // Here we find the most exact match
-  EndPoints retval;
-  if (!retval4.empty ()) retval = retval4;
-  else if (!retval3.empty ()) retval = retval3;
-  else if (!retval2.empty ()) retval = retval2;
-  else retval = retval1;
+  bool localAddressMatchesWildCard = localAddressIsAny || localAddressIsSubnetAny;
 
-  NS_ABORT_MSG_IF (retval.size () > 1, "Too many endpoints - perhaps you created too many sockets without binding them to different NetDevices.");
-  return retval;  // might be empty if no matches
+  if (localAddressMatchesExact && remoteAddressMatchesExact && remotePortMatchesExact)
+    { // All 4 match - this is the case of an open TCP connection, for example.
+      NS_LOG_LOGIC ("Found an endpoint for case 4, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+      matches[3].push_back (endP);
+    }
+  if (localAddressMatchesWildCard && remoteAddressMatchesExact && remotePortMatchesExact)
+    { // All but local address - no idea what this case could be.
+      NS_LOG_LOGIC ("Found an endpoint for case 3, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+      matches[2].push_back (endP);
+    }
+  if (localAddressMatchesExact && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
+    { // Only local port and local address matches exactly - Not yet opened connection
+      NS_LOG_LOGIC ("Found an endpoint for case 2, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+      matches[1].push_back (endP);
+    }
+  if (localAddressMatchesWildCard && remoteAddressMatchesWildCard && remotePortMatchesWildCard)
+    { // Only local port matches exactly - Endpoint open to "any" connection
+      NS_LOG_LOGIC ("Found an endpoint for case 1, adding " << endP->GetLocalAddress () << ":" << endP->GetLocalPort ());
+      matches[0].push_back (endP);
+    }
 }
 
 Ipv4EndPoint *
@@ -347,12 +461,13 @@ Ipv4EndPointDemux::SimpleLookup (Ipv4Address daddr,
   // function.
   uint32_t genericity = 3;
   Ipv4EndPoint *generic = 0;
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++) 
+  std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      return 0;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++) 
     {
-      if ((*i)->GetLocalPort () != dport) 
-        {
-          continue;
-        }
       if ((*i)->GetLocalAddress () == daddr &&
           (*i)->GetPeerPort () == sport &&
           (*i)->GetPeerAddress () == saddr) 
@@ -380,24 +495,37 @@ Ipv4EndPointDemux::SimpleLookup (Ipv4Address daddr,
 uint16_t
 Ipv4EndPointDemux::AllocateEphemeralPort (void)
 {
-  // Similar to counting up logic in netinet/in_pcb.c
+  // Similar to counting up logic in netinet/in_pcb.c, on a bitmap of
+  // the ports in use
   NS_LOG_FUNCTION (this);
-  uint16_t port = m_ephemeral;
-  int count = m_portLast - m_portFirst;
-  do 
+  uint32_t range = m_portLast - m_portFirst + 1;
+  if (m_ephemeralPorts.empty ())
     {
-      if (count-- < 0)
+      m_ephemeralPorts.assign ((range + 63) / 64, 0);
+      for (std::unordered_map<uint16_t, Port>::const_iterator i = m_ports.begin (); i != m_ports.end (); ++i)
         {
-          return 0;
+          SetPortUsed (i->first, true);
+        }
+    }
+  uint32_t offset = m_ephemeral - m_portFirst;
+  for (uint32_t count = 0; count < range; ++count)
+    {
+      offset = offset + 1 < range ? offset + 1 : 0;
+      uint64_t word = m_ephemeralPorts[offset / 64];
+      if (offset % 64 == 0 && word == ~uint64_t (0))
+        {
+          // Skip 64 ports in use at once
+          offset += 63;
+          count += 63;
+          continue;
         }
-      ++port;
-      if (port < m_portFirst || port > m_portLast)
+      if (!((word >> (offset % 64)) & 1))
         {
-          port = m_portFirst;
+          m_ephemeral = m_portFirst + offset;
+          return m_ephemeral;
         }
-    } while (LookupPortLocal (port));
-  m_ephemeral = port;
-  return port;
+    }
+  return 0;
 }
 
 } // namespace ns3
@@ -19,6 +19,7 @@
  */
 
 #include "ipv4-end-point.h"
+#include "ipv4-end-point-demux.h"
 #include "ns3/packet.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
@@ -32,7 +33,9 @@ Ipv4EndPoint::Ipv4EndPoint (Ipv4Address address, uint16_t port)
     m_localPort (port),
     m_peerAddr (Ipv4Address::GetAny ()),
     m_peerPort (0),
-    m_rxEnabled (true)
+    m_rxEnabled (true),
+    m_routeGeneration (0),
+    m_demux (0)
 {
   NS_LOG_FUNCTION (this << address << port);
 }
@@ -61,6 +64,7 @@ Ipv4EndPoint::SetLocalAddress (Ipv4Address address)
 {
   NS_LOG_FUNCTION (this << address);
   m_localAddr = address;
+  m_route = 0;
 }
 
 uint16_t 
@@ -88,8 +92,17 @@ void
 Ipv4EndPoint::SetPeer (Ipv4Address address, uint16_t port)
 {
   NS_LOG_FUNCTION (this << address << port);
+  if (m_demux != 0)
+    {
+      m_demux->RemovePeer (this);
+    }
   m_peerAddr = address;
   m_peerPort = port;
+  m_route = 0;
+  if (m_demux != 0)
+    {
+      m_demux->AddPeer (this);
+    }
 }
 
 void
@@ -97,6 +110,7 @@ Ipv4EndPoint::BindToNetDevice (Ptr<NetDevice> netdevice)
 {
   NS_LOG_FUNCTION (this << netdevice);
   m_boundnetdevice = netdevice;
+  m_route = 0;
   return;
 }
 
@@ -165,4 +179,24 @@ Ipv4EndPoint::IsRxEnabled ()
   return m_rxEnabled;
 }
 
+void
+Ipv4EndPoint::SetCachedRoute (Ptr<Ipv4Route> route, uint64_t generation, Ptr<NetDevice> oif)
+{
+  NS_LOG_FUNCTION (this << route << generation << oif);
+  m_route = route;
+  m_routeGeneration = generation;
+  m_routeOif = oif;
+}
+
+Ptr<Ipv4Route>
+Ipv4EndPoint::GetCachedRoute (uint64_t generation, Ptr<NetDevice> oif) const
+{
+  NS_LOG_FUNCTION (this << generation << oif);
+  if (m_route == 0 || m_routeGeneration != generation || m_routeOif != oif)
+    {
+      return 0;
+    }
+  return m_route;
+}
+
 } // namespace ns3
@@ -22,16 +22,19 @@
 #define IPV4_END_POINT_H
 
 #include <stdint.h>
+#include <list>
 #include "ns3/ipv4-address.h"
 #include "ns3/callback.h"
 #include "ns3/net-device.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/ipv4-interface.h"
+#include "ns3/ipv4-route.h"
 
 namespace ns3 {
 
 class Header;
 class Packet;
+class Ipv4EndPointDemux;
 
 /**
  * \ingroup ipv4
@@ -182,6 +185,28 @@ public:
    */
   bool IsRxEnabled (void);
 
+  /**
+   * \brief Cache the route to the peer.
+   *
+   * The cache is cleared when the addresses or the bound device of the
+   * endpoint change.
+   *
+   * \param route the route to the peer
+   * \param generation the route generation of the routing protocol
+   *        that returned the route
+   * \param oif the output interface the route was looked up for
+   */
+  void SetCachedRoute (Ptr<Ipv4Route> route, uint64_t generation, Ptr<NetDevice> oif);
+
+  /**
+   * \brief Get the cached route to the peer.
+   * \param generation the current route generation of the routing protocol
+   * \param oif the output interface the route is looked up for
+   * \returns the cached route, or 0 if there is none for this generation
+   *          and output interface
+   */
+  Ptr<Ipv4Route> GetCachedRoute (uint64_t generation, Ptr<NetDevice> oif) const;
+
 private:
   /**
    * \brief The local address.
@@ -227,6 +252,38 @@ private:
    * \brief true if the endpoint can receive packets.
    */
   bool m_rxEnabled;
+
+  /**
+   * \brief The cached route to the peer (if any).
+   */
+  Ptr<Ipv4Route> m_route;
+
+  /**
+   * \brief The route generation of the cached route.
+   */
+  uint64_t m_routeGeneration;
+
+  /**
+   * \brief The output interface the cached route was looked up for.
+   */
+  Ptr<NetDevice> m_routeOif;
+
+  friend class Ipv4EndPointDemux;
+
+  /**
+   * \brief The demux indexing the endpoint (if any), told when its peer changes.
+   */
+  Ipv4EndPointDemux *m_demux;
+
+  /**
+   * \brief The position of the endpoint among all the endpoints of its demux.
+   */
+  std::list<Ipv4EndPoint *>::iterator m_position;
+
+  /**
+   * \brief The position of the endpoint among the endpoints of its local port.
+   */
+  std::list<Ipv4EndPoint *>::iterator m_portPosition;
 };
 
 } // namespace ns3
@@ -0,0 +1,187 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <iterator>
+#include "ns3/assert.h"
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ipv4-fib.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("Ipv4Fib");
+
+Ipv4Fib::Ipv4Fib ()
+{
+  NS_LOG_FUNCTION (this);
+  Clear ();
+  Build ();
+}
+
+void
+Ipv4Fib::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_prefixes.clear ();
+}
+
+void
+Ipv4Fib::Add (Ipv4Address network, Ipv4Mask mask, uint32_t value)
+{
+  NS_LOG_FUNCTION (this << network << mask << value);
+  Prefix prefix;
+  prefix.network = network.CombineMask (mask).Get ();
+  prefix.mask = mask.Get ();
+  // Up to the lowest bit of the mask, even if it is not contiguous
+  prefix.length = mask.GetPrefixLength ();
+  prefix.value = value;
+  m_prefixes.push_back (prefix);
+}
+
+void
+Ipv4Fib::Build (void)
+{
+  NS_LOG_FUNCTION (this << m_prefixes.size ());
+
+  m_nodes.assign (256, 0);
+  // Set 0 is the empty set
+  m_setOffsets.assign (2, 0);
+  m_values.clear ();
+  m_setIds.clear ();
+  m_setIds[std::vector<uint32_t> ()] = 0;
+
+  std::vector<uint32_t> covering;
+  std::vector<uint32_t> inside;
+  for (uint32_t i = 0; i < m_prefixes.size (); ++i)
+    {
+      if (m_prefixes[i].length == 0)
+        {
+          covering.push_back (i);
+        }
+      else
+        {
+          inside.push_back (i);
+        }
+    }
+  BuildNode (0, 0, covering, inside);
+  m_setIds.clear ();
+
+  NS_LOG_LOGIC ("Compiled " << m_prefixes.size () << " prefixes into " << GetNNodes ()
+                << " nodes and " << GetNSets () << " sets");
+}
+
+void
+Ipv4Fib::BuildNode (uint32_t node, uint32_t depth,
+                    std::vector<uint32_t> const &covering,
+                    std::vector<uint32_t> const &inside)
+{
+  // Bits of the address selecting the slot in this node
+  uint32_t shift = 24 - 8 * depth;
+  uint32_t slotLength = 8 * (depth + 1);
+
+  std::vector<std::vector<uint32_t> > slotCovering (256);
+  std::vector<std::vector<uint32_t> > slotInside (256);
+  for (std::vector<uint32_t>::const_iterator i = inside.begin (); i != inside.end (); ++i)
+    {
+      Prefix const &prefix = m_prefixes[*i];
+      uint32_t slot = (prefix.network >> shift) & 0xff;
+      uint32_t slotMask = (prefix.mask >> shift) & 0xff;
+      std::vector<std::vector<uint32_t> > &slots = prefix.length <= slotLength ? slotCovering : slotInside;
+      uint32_t span = (~slotMask & 0xff) + 1;
+      if ((span & (span - 1)) == 0)
+        {
+          // The slots matched are a range
+          for (uint32_t s = slot; s < slot + span; ++s)
+            {
+              slots[s].push_back (*i);
+            }
+        }
+      else
+        {
+          // A non-contiguous mask: the slots matching it bit by bit
+          for (uint32_t s = slot; s < 256; ++s)
+            {
+              if ((s & slotMask) == slot)
+                {
+                  slots[s].push_back (*i);
+                }
+            }
+        }
+    }
+
+  for (uint32_t s = 0; s < 256; ++s)
+    {
+      std::vector<uint32_t> set;
+      if (slotCovering[s].empty ())
+        {
+          set = covering;
+        }
+      else
+        {
+          set.reserve (covering.size () + slotCovering[s].size ());
+          std::merge (covering.begin (), covering.end (),
+                      slotCovering[s].begin (), slotCovering[s].end (),
+                      std::back_inserter (set));
+        }
+
+      if (slotInside[s].empty ())
+        {
+          m_nodes[(node << 8) + s] = InternSet (set);
+        }
+      else
+        {
+          NS_ASSERT (depth < 3);
+          uint32_t child = m_nodes.size () >> 8;
+          NS_ABORT_MSG_IF (child & CHILD, "Ipv4Fib: too many nodes");
+          m_nodes.resize (m_nodes.size () + 256, 0);
+          m_nodes[(node << 8) + s] = CHILD | child;
+          BuildNode (child, depth + 1, set, slotInside[s]);
+        }
+    }
+}
+
+uint32_t
+Ipv4Fib::InternSet (std::vector<uint32_t> const &prefixes)
+{
+  std::map<std::vector<uint32_t>, uint32_t>::const_iterator i = m_setIds.find (prefixes);
+  if (i != m_setIds.end ())
+    {
+      return i->second;
+    }
+  uint32_t id = m_setOffsets.size () - 1;
+  for (std::vector<uint32_t>::const_iterator j = prefixes.begin (); j != prefixes.end (); ++j)
+    {
+      m_values.push_back (m_prefixes[*j].value);
+    }
+  m_setOffsets.push_back (m_values.size ());
+  m_setIds[prefixes] = id;
+  return id;
+}
+
+uint32_t
+Ipv4Fib::GetNNodes (void) const
+{
+  return m_nodes.size () >> 8;
+}
+
+uint32_t
+Ipv4Fib::GetNSets (void) const
+{
+  return m_setOffsets.size () - 1;
+}
+
+} // namespace ns3
@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef IPV4_FIB_H
+#define IPV4_FIB_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include "ns3/ipv4-address.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup ipv4Routing
+ *
+ * \brief A compiled IPv4 forwarding table.
+ *
+ * Prefixes, each carrying a 32-bit value (typically the index of a routing
+ * table entry), are added with Add () and compiled by Build () into a
+ * multibit trie of 8-bit strides with leaf pushing: every slot of a trie
+ * node either points to a child node or holds the set of values of all the
+ * prefixes covering the addresses of the slot.  Lookup () then takes at
+ * most four memory accesses, whatever the number of prefixes, and returns
+ * the whole set (e.g., the ECMP routes to a destination) without
+ * allocating.
+ *
+ * Sets list the values in the order the prefixes were added, whatever
+ * their length; callers wanting longest-prefix semantics add the prefixes
+ * by increasing length and use the last values of the set.  Identical sets
+ * are stored once.  Nodes are only created below slots covering more
+ * specific prefixes, so memory grows with the number of prefixes (about
+ * 1 KiB per populated /8, /16 or /24 block).
+ *
+ * The table is not updated incrementally: after routes change, the owner
+ * calls Clear (), adds the prefixes again and calls Build ().
+ */
+class Ipv4Fib
+{
+public:
+  Ipv4Fib ();
+
+  /**
+   * \brief Remove every prefix.
+   */
+  void Clear (void);
+
+  /**
+   * \brief Add a prefix; it is looked up only after Build ().
+   * \param network the network address
+   * \param mask the network mask; a non-contiguous one is matched bit by
+   * bit, as Ipv4Mask::IsMatch does, in more nodes
+   * \param value the value returned for addresses of the network
+   */
+  void Add (Ipv4Address network, Ipv4Mask mask, uint32_t value);
+
+  /**
+   * \brief Compile the prefixes added since Clear ().
+   */
+  void Build (void);
+
+  /**
+   * \brief Look up the values of the prefixes covering an address.
+   * \param dest the address
+   * \param values [out] the values, in the order the prefixes were added;
+   * valid until the next Build ()
+   * \return the number of values
+   */
+  uint32_t Lookup (Ipv4Address dest, uint32_t const * &values) const
+  {
+    uint32_t a = dest.Get ();
+    uint32_t entry = m_nodes[a >> 24];
+    for (uint32_t shift = 16; entry & CHILD; shift -= 8)
+      {
+        entry = m_nodes[((entry & ~CHILD) << 8) + ((a >> shift) & 0xff)];
+      }
+    values = m_values.data () + m_setOffsets[entry];
+    return m_setOffsets[entry + 1] - m_setOffsets[entry];
+  }
+
+  /**
+   * \return the number of trie nodes
+   */
+  uint32_t GetNNodes (void) const;
+
+  /**
+   * \return the number of distinct value sets (including the empty one)
+   */
+  uint32_t GetNSets (void) const;
+
+private:
+  /// A prefix added to the table
+  struct Prefix
+  {
+    uint32_t network; //!< network address
+    uint32_t mask;    //!< network mask
+    uint8_t length;   //!< prefix length, up to the lowest bit of the mask
+    uint32_t value;   //!< value of the prefix
+  };
+
+  /// Slot flag: the rest of the slot is a child node index, not a set
+  static const uint32_t CHILD = 0x80000000;
+
+  /**
+   * \brief Fill a node and, recursively, its children.
+   * \param node index of the node
+   * \param depth depth of the node (0 for the root)
+   * \param covering indices of the prefixes covering the whole node
+   * \param inside indices of the longer prefixes within the node
+   */
+  void BuildNode (uint32_t node, uint32_t depth,
+                  std::vector<uint32_t> const &covering,
+                  std::vector<uint32_t> const &inside);
+
+  /**
+   * \brief Get the id of a set of prefixes, storing the set if new.
+   * \param prefixes indices of the prefixes, sorted
+   * \return the set id
+   */
+  uint32_t InternSet (std::vector<uint32_t> const &prefixes);
+
+  std::vector<Prefix> m_prefixes;      //!< prefixes added since Clear ()
+  std::vector<uint32_t> m_nodes;       //!< trie nodes, 256 slots each, root first
+  std::vector<uint32_t> m_setOffsets;  //!< start of each set in m_values, plus the end
+  std::vector<uint32_t> m_values;      //!< values of all the sets
+  std::map<std::vector<uint32_t>, uint32_t> m_setIds; //!< ids of the sets, during Build ()
+};
+
+} // namespace ns3
+
+#endif /* IPV4_FIB_H */
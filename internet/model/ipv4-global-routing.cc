@@ -16,6 +16,7 @@
 // Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 //
 
+#include <algorithm>
 #include <vector>
 #include <iomanip>
 #include "ns3/names.h"
@@ -27,6 +28,8 @@
 #include "ns3/ipv4-route.h"
 #include "ns3/ipv4-routing-table-entry.h"
 #include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
 #include "ns3/node.h"
 #include "ipv4-global-routing.h"
 #include "global-route-manager.h"
@@ -37,6 +40,77 @@ NS_LOG_COMPONENT_DEFINE ("Ipv4GlobalRouting");
 
 NS_OBJECT_ENSURE_REGISTERED (Ipv4GlobalRouting);
 
+/// Number of flowlets of a router; flows whose hashes collide share one
+static const uint32_t FLOWLET_TABLE_SIZE = 4096;
+
+/// Toeplitz key of receive side scaling, used with a seed of 0
+static const uint8_t RSS_KEY[40] = {
+  0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+  0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+  0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+  0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa
+};
+
+/**
+ * \brief Compute the CRC-32C (Castagnoli) of some bytes.
+ * \param seed the initial value of the CRC
+ * \param data the bytes
+ * \param size the number of bytes
+ * \return the CRC
+ */
+static uint32_t
+Crc32c (uint32_t seed, uint8_t const *data, uint32_t size)
+{
+  static uint32_t table[256];
+  static bool built = false;
+  if (!built)
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+        {
+          uint32_t c = i;
+          for (uint32_t k = 0; k < 8; ++k)
+            {
+              c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+            }
+          table[i] = c;
+        }
+      built = true;
+    }
+  uint32_t crc = ~seed;
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+  return ~crc;
+}
+
+/**
+ * \brief Compute the Toeplitz hash of some bytes.
+ * \param key the key, at least 4 bytes longer than the data
+ * \param data the bytes
+ * \param size the number of bytes
+ * \return the hash
+ */
+static uint32_t
+ToeplitzHash (uint8_t const *key, uint8_t const *data, uint32_t size)
+{
+  uint32_t hash = 0;
+  // The 32 bits of the key aligned with the current bit of the data
+  uint32_t window = (uint32_t (key[0]) << 24) | (key[1] << 16) | (key[2] << 8) | key[3];
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      for (int32_t bit = 7; bit >= 0; --bit)
+        {
+          if (data[i] & (1 << bit))
+            {
+              hash ^= window;
+            }
+          window = (window << 1) | ((key[i + 4] >> bit) & 1);
+        }
+    }
+  return hash;
+}
+
 TypeId 
 Ipv4GlobalRouting::GetTypeId (void)
 { 
@@ -48,6 +122,37 @@ Ipv4GlobalRouting::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&Ipv4GlobalRouting::m_randomEcmpRouting),
                    MakeBooleanChecker ())
+    .AddAttribute ("EcmpHashRouting",
+                   "Set to true if packets are routed among ECMP by a hash of their flow, "
+                   "so that the packets of a flow take the same route; takes precedence over RandomEcmpRouting",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&Ipv4GlobalRouting::m_ecmpHashRouting),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EcmpHashFields",
+                   "The fields hashed by EcmpHashRouting: a combination of 1 (source address), "
+                   "2 (destination address), 4 (protocol), 8 (source port) and 16 (destination port)",
+                   UintegerValue (HASH_5_TUPLE),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::m_ecmpHashFields),
+                   MakeUintegerChecker<uint32_t> (0, HASH_5_TUPLE))
+    .AddAttribute ("EcmpHashFunction",
+                   "The hash function of EcmpHashRouting",
+                   EnumValue (HASH_CRC32C),
+                   MakeEnumAccessor (&Ipv4GlobalRouting::m_ecmpHashFunction),
+                   MakeEnumChecker (HASH_CRC32C, "Crc32c",
+                                    HASH_TOEPLITZ, "Toeplitz"))
+    .AddAttribute ("EcmpHashSeed",
+                   "The seed of the hash function of EcmpHashRouting; routers with different seeds "
+                   "split the same flows differently",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&Ipv4GlobalRouting::SetEcmpHashSeed,
+                                         &Ipv4GlobalRouting::GetEcmpHashSeed),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FlowletTimeout",
+                   "With EcmpHashRouting, a flow idle for longer than this moves to a route "
+                   "picked at random (flowlet switching); 0 disables flowlets",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&Ipv4GlobalRouting::m_flowletTimeout),
+                   MakeTimeChecker ())
     .AddAttribute ("RespondToInterfaceEvents",
                    "Set to true if you want to dynamically recompute the global routes upon Interface notification events (up/down, or add/remove address)",
                    BooleanValue (false),
@@ -59,11 +164,18 @@ Ipv4GlobalRouting::GetTypeId (void)
 
 Ipv4GlobalRouting::Ipv4GlobalRouting () 
   : m_randomEcmpRouting (false),
-    m_respondToInterfaceEvents (false)
+    m_respondToInterfaceEvents (false),
+    m_ecmpHashRouting (false),
+    m_ecmpHashFields (HASH_5_TUPLE),
+    m_ecmpHashFunction (HASH_CRC32C),
+    m_flowletTimeout (Seconds (0)),
+    m_fibValid (false),
+    m_routeGeneration (NewRouteGeneration ())
 {
   NS_LOG_FUNCTION (this);
 
   m_rand = CreateObject<UniformRandomVariable> ();
+  SetEcmpHashSeed (0);
 }
 
 Ipv4GlobalRouting::~Ipv4GlobalRouting ()
@@ -80,6 +192,8 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, nextHop, interface);
   m_hostRoutes.push_back (route);
+  m_fibValid = false;
+  m_routeGeneration = NewRouteGeneration ();
 }
 
 void 
@@ -90,6 +204,8 @@ Ipv4GlobalRouting::AddHostRouteTo (Ipv4Address dest,
   Ipv4RoutingTableEntry *route = new Ipv4RoutingTableEntry ();
   *route = Ipv4RoutingTableEntry::CreateHostRouteTo (dest, interface);
   m_hostRoutes.push_back (route);
+  m_fibValid = false;
+  m_routeGeneration = NewRouteGeneration ();
 }
 
 void 
@@ -105,6 +221,8 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_networkRoutes.push_back (route);
+  m_fibValid = false;
+  m_routeGeneration = NewRouteGeneration ();
 }
 
 void 
@@ -118,6 +236,8 @@ Ipv4GlobalRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         interface);
   m_networkRoutes.push_back (route);
+  m_fibValid = false;
+  m_routeGeneration = NewRouteGeneration ();
 }
 
 void 
@@ -133,116 +253,243 @@ Ipv4GlobalRouting::AddASExternalRouteTo (Ipv4Address network,
                                                         nextHop,
                                                         interface);
   m_ASexternalRoutes.push_back (route);
+  m_fibValid = false;
+  m_routeGeneration = NewRouteGeneration ();
+}
+
+
+void
+Ipv4GlobalRouting::SetEcmpHashSeed (uint32_t seed)
+{
+  NS_LOG_FUNCTION (this << seed);
+  m_ecmpHashSeed = seed;
+  if (seed == 0)
+    {
+      std::copy (RSS_KEY, RSS_KEY + sizeof (RSS_KEY), m_toeplitzKey);
+      return;
+    }
+  // xorshift32, which never returns 0 from a seed that is not 0
+  uint32_t x = seed;
+  for (uint32_t i = 0; i < sizeof (m_toeplitzKey); ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      m_toeplitzKey[i] = x >> 24;
+    }
 }
 
+uint32_t
+Ipv4GlobalRouting::GetEcmpHashSeed (void) const
+{
+  return m_ecmpHashSeed;
+}
+
+uint32_t
+Ipv4GlobalRouting::GetFlowHash (const Ipv4Header &header, Ptr<const Packet> p) const
+{
+  // Source and destination addresses, source and destination ports and
+  // protocol, in network byte order; the fields not hashed are left to 0
+  uint8_t data[13] = { 0 };
+  if (m_ecmpHashFields & HASH_SRC_ADDRESS)
+    {
+      header.GetSource ().Serialize (data);
+    }
+  if (m_ecmpHashFields & HASH_DST_ADDRESS)
+    {
+      header.GetDestination ().Serialize (data + 4);
+    }
+  uint8_t protocol = header.GetProtocol ();
+  bool tcpOrUdp = protocol == 6 || protocol == 17;
+  if ((m_ecmpHashFields & (HASH_SRC_PORT | HASH_DST_PORT)) && tcpOrUdp && p != 0
+      && header.IsLastFragment () && header.GetFragmentOffset () == 0 && p->GetSize () >= 4)
+    {
+      uint8_t ports[4];
+      p->CopyData (ports, 4);
+      if (m_ecmpHashFields & HASH_SRC_PORT)
+        {
+          data[8] = ports[0];
+          data[9] = ports[1];
+        }
+      if (m_ecmpHashFields & HASH_DST_PORT)
+        {
+          data[10] = ports[2];
+          data[11] = ports[3];
+        }
+    }
+  if (m_ecmpHashFields & HASH_PROTOCOL)
+    {
+      data[12] = protocol;
+    }
+
+  if (m_ecmpHashFunction == HASH_TOEPLITZ)
+    {
+      return ToeplitzHash (m_toeplitzKey, data, sizeof (data));
+    }
+  return Crc32c (m_ecmpHashSeed, data, sizeof (data));
+}
 
 Ptr<Ipv4Route>
-Ipv4GlobalRouting::LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif)
+Ipv4GlobalRouting::LookupGlobal (const Ipv4Header &header, Ptr<const Packet> p, Ptr<NetDevice> oif)
 {
+  Ipv4Address dest = header.GetDestination ();
   NS_LOG_FUNCTION (this << dest << oif);
   NS_LOG_LOGIC ("Looking for route for destination " << dest);
-  Ptr<Ipv4Route> rtentry = 0;
-  // store all available routes that bring packets to their destination
-  typedef std::vector<Ipv4RoutingTableEntry*> RouteVec_t;
-  RouteVec_t allRoutes;
+  if (!m_fibValid)
+    {
+      BuildFib ();
+    }
 
-  NS_LOG_LOGIC ("Number of m_hostRoutes = " << m_hostRoutes.size ());
-  for (HostRoutesCI i = m_hostRoutes.begin (); 
-       i != m_hostRoutes.end (); 
-       i++) 
+  uint32_t const *indices;
+  uint32_t n = m_hostFib.Lookup (dest, indices);
+  NS_LOG_LOGIC ("Found " << n << " global host routes");
+  Ipv4RoutingTableEntry *route = SelectRoute (m_hostTable, indices, n, header, p, oif, false);
+  if (route == 0) // if no host route is found
     {
-      NS_ASSERT ((*i)->IsHost ());
-      if ((*i)->GetDest ().IsEqual (dest)) 
-        {
-          if (oif != 0)
-            {
-              if (oif != m_ipv4->GetNetDevice ((*i)->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
-            }
-          allRoutes.push_back (*i);
-          NS_LOG_LOGIC (allRoutes.size () << "Found global host route" << *i); 
-        }
+      n = m_networkFib.Lookup (dest, indices);
+      NS_LOG_LOGIC ("Found " << n << " global network routes");
+      route = SelectRoute (m_networkTable, indices, n, header, p, oif, false);
+    }
+  if (route == 0) // consider external if no host/network found
+    {
+      n = m_externalFib.Lookup (dest, indices);
+      NS_LOG_LOGIC ("Found " << n << " external routes");
+      route = SelectRoute (m_externalTable, indices, n, header, p, oif, true);
+    }
+  if (route != 0) // if route(s) is found
+    {
+      // create a Ipv4Route object from the selected routing table entry
+      Ptr<Ipv4Route> rtentry = Create<Ipv4Route> ();
+      rtentry->SetDestination (route->GetDest ());
+      /// \todo handle multi-address case
+      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
+      rtentry->SetGateway (route->GetGateway ());
+      uint32_t interfaceIdx = route->GetInterface ();
+      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+      return rtentry;
     }
-  if (allRoutes.size () == 0) // if no host route is found
+  else 
     {
-      NS_LOG_LOGIC ("Number of m_networkRoutes" << m_networkRoutes.size ());
-      for (NetworkRoutesI j = m_networkRoutes.begin (); 
-           j != m_networkRoutes.end (); 
-           j++) 
+      return 0;
+    }
+}
+
+Ipv4RoutingTableEntry *
+Ipv4GlobalRouting::SelectRoute (std::vector<Ipv4RoutingTableEntry *> const &table,
+                                uint32_t const *indices, uint32_t n,
+                                const Ipv4Header &header, Ptr<const Packet> p,
+                                Ptr<NetDevice> oif, bool firstOnly)
+{
+  // count the routes on the requested interface, without building a list
+  uint32_t usable = n;
+  if (oif != 0)
+    {
+      usable = 0;
+      for (uint32_t i = 0; i < n; ++i)
         {
-          Ipv4Mask mask = (*j)->GetDestNetworkMask ();
-          Ipv4Address entry = (*j)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry)) 
+          if (oif == m_ipv4->GetNetDevice (table[indices[i]]->GetInterface ()))
             {
-              if (oif != 0)
-                {
-                  if (oif != m_ipv4->GetNetDevice ((*j)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
-                }
-              allRoutes.push_back (*j);
-              NS_LOG_LOGIC (allRoutes.size () << "Found global network route" << *j);
+              ++usable;
+            }
+          else
+            {
+              NS_LOG_LOGIC ("Not on requested interface, skipping");
             }
         }
     }
-  if (allRoutes.size () == 0)  // consider external if no host/network found
+  if (usable == 0)
+    {
+      return 0;
+    }
+
+  // pick up one of the routes by the hash of the flow (or the route
+  // of its flowlet) if hashed ECMP routing is enabled, uniformly at
+  // random if random ECMP routing is enabled, or always select the
+  // first route consistently if both are disabled
+  uint32_t selectIndex = 0;
+  if (m_ecmpHashRouting && !firstOnly)
     {
-      for (ASExternalRoutesI k = m_ASexternalRoutes.begin ();
-           k != m_ASexternalRoutes.end ();
-           k++)
+      if (usable > 1)
         {
-          Ipv4Mask mask = (*k)->GetDestNetworkMask ();
-          Ipv4Address entry = (*k)->GetDestNetwork ();
-          if (mask.IsMatch (dest, entry))
+          uint32_t hash = GetFlowHash (header, p);
+          if (m_flowletTimeout.IsStrictlyPositive ())
             {
-              NS_LOG_LOGIC ("Found external route" << *k);
-              if (oif != 0)
+              if (m_flowlets.empty ())
                 {
-                  if (oif != m_ipv4->GetNetDevice ((*k)->GetInterface ()))
-                    {
-                      NS_LOG_LOGIC ("Not on requested interface, skipping");
-                      continue;
-                    }
+                  Flowlet unused = { Seconds (0), UINT32_MAX };
+                  m_flowlets.assign (FLOWLET_TABLE_SIZE, unused);
                 }
-              allRoutes.push_back (*k);
-              break;
+              Flowlet &flowlet = m_flowlets[hash % FLOWLET_TABLE_SIZE];
+              Time now = Simulator::Now ();
+              if (flowlet.route == UINT32_MAX || now - flowlet.lastSeen > m_flowletTimeout)
+                {
+                  flowlet.route = m_rand->GetInteger (0, usable - 1);
+                  NS_LOG_LOGIC ("New flowlet on route " << flowlet.route);
+                }
+              flowlet.lastSeen = now;
+              selectIndex = flowlet.route % usable;
+            }
+          else
+            {
+              selectIndex = hash % usable;
             }
         }
     }
-  if (allRoutes.size () > 0 ) // if route(s) is found
+  else if (m_randomEcmpRouting && !firstOnly)
     {
-      // pick up one of the routes uniformly at random if random
-      // ECMP routing is enabled, or always select the first route
-      // consistently if random ECMP routing is disabled
-      uint32_t selectIndex;
-      if (m_randomEcmpRouting)
+      selectIndex = m_rand->GetInteger (0, usable - 1);
+    }
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      Ipv4RoutingTableEntry *route = table[indices[i]];
+      if (oif != 0 && oif != m_ipv4->GetNetDevice (route->GetInterface ()))
         {
-          selectIndex = m_rand->GetInteger (0, allRoutes.size ()-1);
+          continue;
         }
-      else 
+      if (selectIndex-- == 0)
         {
-          selectIndex = 0;
+          NS_LOG_LOGIC ("Selected route " << *route);
+          return route;
         }
-      Ipv4RoutingTableEntry* route = allRoutes.at (selectIndex); 
-      // create a Ipv4Route object from the selected routing table entry
-      rtentry = Create<Ipv4Route> ();
-      rtentry->SetDestination (route->GetDest ());
-      /// \todo handle multi-address case
-      rtentry->SetSource (m_ipv4->GetAddress (route->GetInterface (), 0).GetLocal ());
-      rtentry->SetGateway (route->GetGateway ());
-      uint32_t interfaceIdx = route->GetInterface ();
-      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
-      return rtentry;
     }
-  else 
+  NS_ASSERT (false);
+  return 0;
+}
+
+void
+Ipv4GlobalRouting::BuildFib (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_hostFib.Clear ();
+  m_hostTable.clear ();
+  for (HostRoutesCI i = m_hostRoutes.begin (); i != m_hostRoutes.end (); i++)
     {
-      return 0;
+      NS_ASSERT ((*i)->IsHost ());
+      m_hostFib.Add ((*i)->GetDest (), Ipv4Mask::GetOnes (), m_hostTable.size ());
+      m_hostTable.push_back (*i);
     }
+  m_hostFib.Build ();
+
+  m_networkFib.Clear ();
+  m_networkTable.clear ();
+  for (NetworkRoutesCI j = m_networkRoutes.begin (); j != m_networkRoutes.end (); j++)
+    {
+      m_networkFib.Add ((*j)->GetDestNetwork (), (*j)->GetDestNetworkMask (), m_networkTable.size ());
+      m_networkTable.push_back (*j);
+    }
+  m_networkFib.Build ();
+
+  m_externalFib.Clear ();
+  m_externalTable.clear ();
+  for (ASExternalRoutesCI k = m_ASexternalRoutes.begin (); k != m_ASexternalRoutes.end (); k++)
+    {
+      m_externalFib.Add ((*k)->GetDestNetwork (), (*k)->GetDestNetworkMask (), m_externalTable.size ());
+      m_externalTable.push_back (*k);
+    }
+  m_externalFib.Build ();
+
+  m_fibValid = true;
 }
 
 uint32_t 
@@ -309,6 +556,8 @@ void
 Ipv4GlobalRouting::RemoveRoute (uint32_t index)
 {
   NS_LOG_FUNCTION (this << index);
+  m_fibValid = false;
+  m_routeGeneration = NewRouteGeneration ();
   if (index < m_hostRoutes.size ())
     {
       uint32_t tmp = 0;
@@ -362,6 +611,56 @@ Ipv4GlobalRouting::RemoveRoute (uint32_t index)
   NS_ASSERT (false);
 }
 
+void
+Ipv4GlobalRouting::RemoveRoutesTo (std::vector<Ipv4Address> const &hosts,
+                                   std::vector<std::pair<Ipv4Address, Ipv4Mask> > const &networks)
+{
+  NS_LOG_FUNCTION (this << hosts.size () << networks.size ());
+  std::vector<uint32_t> hostKeys;
+  for (std::vector<Ipv4Address>::const_iterator i = hosts.begin (); i != hosts.end (); ++i)
+    {
+      hostKeys.push_back (i->Get ());
+    }
+  std::sort (hostKeys.begin (), hostKeys.end ());
+  std::vector<uint64_t> networkKeys;
+  for (std::vector<std::pair<Ipv4Address, Ipv4Mask> >::const_iterator i = networks.begin ();
+       i != networks.end (); ++i)
+    {
+      networkKeys.push_back ((uint64_t (i->first.Get ()) << 32) | i->second.Get ());
+    }
+  std::sort (networkKeys.begin (), networkKeys.end ());
+
+  for (HostRoutesI i = m_hostRoutes.begin (); i != m_hostRoutes.end (); )
+    {
+      if (std::binary_search (hostKeys.begin (), hostKeys.end (), (*i)->GetDest ().Get ()))
+        {
+          delete *i;
+          i = m_hostRoutes.erase (i);
+          m_fibValid = false;
+          m_routeGeneration = NewRouteGeneration ();
+        }
+      else
+        {
+          ++i;
+        }
+    }
+  for (NetworkRoutesI j = m_networkRoutes.begin (); j != m_networkRoutes.end (); )
+    {
+      uint64_t key = (uint64_t ((*j)->GetDestNetwork ().Get ()) << 32) | (*j)->GetDestNetworkMask ().Get ();
+      if (std::binary_search (networkKeys.begin (), networkKeys.end (), key))
+        {
+          delete *j;
+          j = m_networkRoutes.erase (j);
+          m_fibValid = false;
+          m_routeGeneration = NewRouteGeneration ();
+        }
+      else
+        {
+          ++j;
+        }
+    }
+}
+
 int64_t
 Ipv4GlobalRouting::AssignStreams (int64_t stream)
 {
@@ -392,6 +691,10 @@ Ipv4GlobalRouting::DoDispose (void)
     {
       delete (*l);
     }
+  m_fibValid = false;
+  m_hostTable.clear ();
+  m_networkTable.clear ();
+  m_externalTable.clear ();
 
   Ipv4RoutingProtocol::DoDispose ();
 }
@@ -468,7 +771,8 @@ Ipv4GlobalRouting::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<Net
 // See if this is a unicast packet we have a route for.
 //
   NS_LOG_LOGIC ("Unicast destination- looking up");
-  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination (), oif);
+  // Only TCP packets are routed with their transport header
+  Ptr<Ipv4Route> rtentry = LookupGlobal (header, header.GetProtocol () == 6 ? p : 0, oif);
   if (rtentry)
     {
       sockerr = Socket::ERROR_NOTERROR;
@@ -517,7 +821,7 @@ Ipv4GlobalRouting::RouteInput  (Ptr<const Packet> p, const Ipv4Header &header, P
     }
   // Next, try to find a route
   NS_LOG_LOGIC ("Unicast destination- looking up global route");
-  Ptr<Ipv4Route> rtentry = LookupGlobal (header.GetDestination ());
+  Ptr<Ipv4Route> rtentry = LookupGlobal (header, p);
   if (rtentry != 0)
     {
       NS_LOG_LOGIC ("Found unicast destination- calling unicast callback");
@@ -535,11 +839,10 @@ void
 Ipv4GlobalRouting::NotifyInterfaceUp (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
+  m_routeGeneration = NewRouteGeneration ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateGlobalRoutes ();
     }
 }
 
@@ -547,11 +850,10 @@ void
 Ipv4GlobalRouting::NotifyInterfaceDown (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
+  m_routeGeneration = NewRouteGeneration ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
-      GlobalRouteManager::DeleteGlobalRoutes ();
-      GlobalRouteManager::BuildGlobalRoutingDatabase ();
-      GlobalRouteManager::InitializeRoutes ();
+      GlobalRouteManager::UpdateGlobalRoutes ();
     }
 }
 
@@ -559,6 +861,7 @@ void
 Ipv4GlobalRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << address);
+  m_routeGeneration = NewRouteGeneration ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
       GlobalRouteManager::DeleteGlobalRoutes ();
@@ -571,6 +874,7 @@ void
 Ipv4GlobalRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << address);
+  m_routeGeneration = NewRouteGeneration ();
   if (m_respondToInterfaceEvents && Simulator::Now ().GetSeconds () > 0)  // avoid startup events
     {
       GlobalRouteManager::DeleteGlobalRoutes ();
@@ -585,6 +889,19 @@ Ipv4GlobalRouting::SetIpv4 (Ptr<Ipv4> ipv4)
   NS_LOG_FUNCTION (this << ipv4);
   NS_ASSERT (m_ipv4 == 0 && ipv4 != 0);
   m_ipv4 = ipv4;
+  m_routeGeneration = NewRouteGeneration ();
+}
+
+uint64_t
+Ipv4GlobalRouting::GetRouteGeneration (void) const
+{
+  // Random and flowlet routes change from one packet to the next; flow
+  // hashed routes stay the same for the packets of a connection
+  if (m_randomEcmpRouting || (m_ecmpHashRouting && m_flowletTimeout.IsStrictlyPositive ()))
+    {
+      return 0;
+    }
+  return m_routeGeneration;
 }
 
 
@@ -21,13 +21,17 @@
 #define IPV4_GLOBAL_ROUTING_H
 
 #include <list>
+#include <utility>
+#include <vector>
 #include <stdint.h>
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/ptr.h"
+#include "ns3/nstime.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/random-variable-stream.h"
+#include "ipv4-fib.h"
 
 namespace ns3 {
 
@@ -65,12 +69,37 @@ class Node;
  *
  * This class deals with Ipv4 unicast routes only.
  *
+ * When there are several equal-cost routes to a destination, the first one
+ * is used, unless RandomEcmpRouting picks one at random for each packet, or
+ * EcmpHashRouting picks one from a hash of the flow of the packet (its
+ * addresses, protocol and ports, as selected by EcmpHashFields), so that
+ * the packets of a flow are not reordered.  With a FlowletTimeout, a flow
+ * that paused longer than the timeout moves to a route picked at random.
+ *
  * \see Ipv4RoutingProtocol
  * \see GlobalRouteManager
  */
 class Ipv4GlobalRouting : public Ipv4RoutingProtocol
 {
 public:
+  /// Fields of the packets hashed by EcmpHashRouting
+  enum EcmpHashField
+  {
+    HASH_SRC_ADDRESS = 0x01, //!< source address
+    HASH_DST_ADDRESS = 0x02, //!< destination address
+    HASH_PROTOCOL = 0x04,    //!< protocol number
+    HASH_SRC_PORT = 0x08,    //!< TCP or UDP source port
+    HASH_DST_PORT = 0x10,    //!< TCP or UDP destination port
+    HASH_5_TUPLE = 0x1f      //!< all of the above
+  };
+
+  /// Hash functions of EcmpHashRouting
+  enum EcmpHashFunction
+  {
+    HASH_CRC32C,  //!< CRC-32C, starting from the seed
+    HASH_TOEPLITZ //!< Toeplitz hash of receive side scaling, with a key derived from the seed
+  };
+
   /**
    * \brief Get the type ID.
    * \return the object TypeId
@@ -99,6 +128,7 @@ public:
   virtual void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address);
   virtual void SetIpv4 (Ptr<Ipv4> ipv4);
   virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
+  virtual uint64_t GetRouteGeneration (void) const;
 
   /**
    * \brief Add a host route to the global routing table.
@@ -218,6 +248,18 @@ public:
    */
   void RemoveRoute (uint32_t i);
 
+  /**
+   * \brief Remove all the host and network routes to some destinations.
+   *
+   * The routing table is walked once, whatever the number of destinations.
+   * External routes are kept.
+   *
+   * \param hosts the destinations of the host routes to remove
+   * \param networks the destinations of the network routes to remove
+   */
+  void RemoveRoutesTo (std::vector<Ipv4Address> const &hosts,
+                       std::vector<std::pair<Ipv4Address, Ipv4Mask> > const &networks);
+
   /**
    * Assign a fixed random variable stream number to the random variables
    * used by this model.  Return the number of streams (possibly zero) that
@@ -228,6 +270,18 @@ public:
    */
   int64_t AssignStreams (int64_t stream);
 
+  /**
+   * \brief Hash the flow of a packet, as EcmpHashRouting does.
+   *
+   * The ports are only hashed if the packet starts with them, and not for
+   * fragments, so that all the fragments of a datagram get the same hash.
+   *
+   * \param header the IPv4 header of the packet
+   * \param p the packet, starting with its TCP or UDP header, or 0
+   * \return the hash of the fields selected by EcmpHashFields
+   */
+  uint32_t GetFlowHash (const Ipv4Header &header, Ptr<const Packet> p) const;
+
 protected:
   void DoDispose (void);
 
@@ -238,6 +292,38 @@ private:
   bool m_respondToInterfaceEvents;
   /// A uniform random number generator for randomly routing packets among ECMP 
   Ptr<UniformRandomVariable> m_rand;
+  /// Set to true if packets are routed among ECMP by a hash of their flow
+  bool m_ecmpHashRouting;
+  /// EcmpHashField flags of the fields hashed
+  uint32_t m_ecmpHashFields;
+  /// Hash function of the flows
+  EcmpHashFunction m_ecmpHashFunction;
+  /// Seed of the hash function
+  uint32_t m_ecmpHashSeed;
+  /// Key of the Toeplitz hash, derived from m_ecmpHashSeed
+  uint8_t m_toeplitzKey[40];
+  /// Idle time after which a flow moves to another route, or 0 to disable flowlets
+  Time m_flowletTimeout;
+
+  /// The route of a flow while it does not pause
+  struct Flowlet
+  {
+    Time lastSeen;  //!< time of the last packet
+    uint32_t route; //!< index of the route among the usable ones, or UINT32_MAX if unused
+  };
+  /// Flowlets by flow hash, allocated when first needed
+  std::vector<Flowlet> m_flowlets;
+
+  /**
+   * \brief Set the seed of the flow hash, and derive the Toeplitz key from it.
+   * \param seed the seed
+   */
+  void SetEcmpHashSeed (uint32_t seed);
+
+  /**
+   * \return the seed of the flow hash
+   */
+  uint32_t GetEcmpHashSeed (void) const;
 
   /// container of Ipv4RoutingTableEntry (routes to hosts)
   typedef std::list<Ipv4RoutingTableEntry *> HostRoutes;
@@ -262,16 +348,58 @@ private:
 
   /**
    * \brief Lookup in the forwarding table for destination.
-   * \param dest destination address
+   * \param header the header of the packet, giving the destination address
+   * \param p the packet, starting with its TCP or UDP header, or 0 (only
+   * used to hash the flow)
    * \param oif output interface if any (put 0 otherwise)
    * \return Ipv4Route to route the packet to reach dest address
    */
-  Ptr<Ipv4Route> LookupGlobal (Ipv4Address dest, Ptr<NetDevice> oif = 0);
+  Ptr<Ipv4Route> LookupGlobal (const Ipv4Header &header, Ptr<const Packet> p, Ptr<NetDevice> oif = 0);
+
+  /**
+   * \brief Recompile the forwarding tables from the route lists.
+   *
+   * There is one table per list, so that host routes still take precedence
+   * over network routes, and network routes over external ones.  Called on
+   * the first lookup after the routes change.
+   */
+  void BuildFib (void);
+
+  /**
+   * \brief Pick one of the routes found in a forwarding table.
+   *
+   * Routes not on oif (if not 0) are ignored.  Among the others, the first
+   * one is picked if firstOnly is true; otherwise one is picked by the hash
+   * of the flow (or of its flowlet) if hashed ECMP routing is enabled, at
+   * random if random ECMP routing is enabled, or the first one if neither is.
+   *
+   * \param table the routes indexed by the forwarding table
+   * \param indices the indices of the matching routes
+   * \param n the number of matching routes
+   * \param header the header of the packet
+   * \param p the packet, starting with its TCP or UDP header, or 0
+   * \param oif output interface if any (put 0 otherwise)
+   * \param firstOnly never pick a route at random
+   * \return the route, or 0 if none is usable
+   */
+  Ipv4RoutingTableEntry *SelectRoute (std::vector<Ipv4RoutingTableEntry *> const &table,
+                                      uint32_t const *indices, uint32_t n,
+                                      const Ipv4Header &header, Ptr<const Packet> p,
+                                      Ptr<NetDevice> oif, bool firstOnly);
 
   HostRoutes m_hostRoutes;             //!< Routes to hosts
   NetworkRoutes m_networkRoutes;       //!< Routes to networks
   ASExternalRoutes m_ASexternalRoutes; //!< External routes imported
 
+  bool m_fibValid;                                       //!< the compiled tables match the route lists
+  uint64_t m_routeGeneration;                            //!< renewed whenever the routes change
+  Ipv4Fib m_hostFib;                                     //!< compiled host routes
+  Ipv4Fib m_networkFib;                                  //!< compiled network routes
+  Ipv4Fib m_externalFib;                                 //!< compiled external routes
+  std::vector<Ipv4RoutingTableEntry *> m_hostTable;      //!< host routes by m_hostFib value
+  std::vector<Ipv4RoutingTableEntry *> m_networkTable;   //!< network routes by m_networkFib value
+  std::vector<Ipv4RoutingTableEntry *> m_externalTable;  //!< external routes by m_externalFib value
+
   Ptr<Ipv4> m_ipv4; //!< associated IPv4 instance
 };
 
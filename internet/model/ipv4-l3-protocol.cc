@@ -41,6 +41,8 @@
 #include "icmpv4-l4-protocol.h"
 #include "ipv4-interface.h"
 #include "ipv4-raw-socket-impl.h"
+#include "tcp-gso.h"
+#include "tcp-header.h"
 
 namespace ns3 {
 
@@ -925,12 +927,37 @@ Ipv4L3Protocol::SendRealOut (Ptr<Ipv4Route> route,
   Ptr<Ipv4Interface> outInterface = GetInterface (interface);
   NS_LOG_LOGIC ("Send via NetDevice ifIndex " << outDev->GetIfIndex () << " ipv4InterfaceIndex " << interface);
 
+  // A TCP super-segment is cut by the device if it can, and if the segments
+  // fit in its MTU; it is never fragmented, as its fragments but the first
+  // one would have no TCP header to cut
+  bool superSegment = false;
+  TcpGsoTag gsoTag;
+  if (packet->PeekPacketTag (gsoTag))
+    {
+      TcpHeader tcpHeader;
+      packet->PeekHeader (tcpHeader);
+      uint32_t segmentSize = ipHeader.GetSerializedSize () + tcpHeader.GetSerializedSize ()
+        + gsoTag.GetSegmentSize ();
+      superSegment = outDev->SupportsGso () && segmentSize <= outDev->GetMtu ();
+    }
+  if (!superSegment && packet->RemovePacketTag (gsoTag))
+    {
+      std::list<Ipv4PayloadHeaderPair> listSegments;
+      TcpGso::Cut (packet, ipHeader, gsoTag.GetSegmentSize (), listSegments);
+      NS_LOG_LOGIC ("Cut TCP super-segment in " << listSegments.size () << " segments");
+      for (std::list<Ipv4PayloadHeaderPair>::iterator it = listSegments.begin (); it != listSegments.end (); it++)
+        {
+          SendRealOut (route, it->first, it->second);
+        }
+      return;
+    }
+
   if (!route->GetGateway ().IsEqual (Ipv4Address ("0.0.0.0")))
     {
       if (outInterface->IsUp ())
         {
           NS_LOG_LOGIC ("Send to gateway " << route->GetGateway ());
-          if ( packet->GetSize () + ipHeader.GetSerializedSize () > outInterface->GetDevice ()->GetMtu () )
+          if (!superSegment && packet->GetSize () + ipHeader.GetSerializedSize () > outInterface->GetDevice ()->GetMtu ())
             {
               std::list<Ipv4PayloadHeaderPair> listFragments;
               DoFragmentation (packet, ipHeader, outInterface->GetDevice ()->GetMtu (), listFragments);
@@ -957,7 +984,7 @@ Ipv4L3Protocol::SendRealOut (Ptr<Ipv4Route> route,
       if (outInterface->IsUp ())
         {
           NS_LOG_LOGIC ("Send to destination " << ipHeader.GetDestination ());
-          if ( packet->GetSize () + ipHeader.GetSerializedSize () > outInterface->GetDevice ()->GetMtu () )
+          if (!superSegment && packet->GetSize () + ipHeader.GetSerializedSize () > outInterface->GetDevice ()->GetMtu ())
             {
               std::list<Ipv4PayloadHeaderPair> listFragments;
               DoFragmentation (packet, ipHeader, outInterface->GetDevice ()->GetMtu (), listFragments);
@@ -17,6 +17,7 @@
  *
  */
 
+#include <algorithm>
 #include "ns3/log.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-route.h"
@@ -43,7 +44,8 @@ Ipv4ListRouting::GetTypeId (void)
 
 
 Ipv4ListRouting::Ipv4ListRouting () 
-  : m_ipv4 (0)
+  : m_ipv4 (0),
+    m_routeGeneration (NewRouteGeneration ())
 {
   NS_LOG_FUNCTION (this);
 }
@@ -255,12 +257,32 @@ Ipv4ListRouting::AddRoutingProtocol (Ptr<Ipv4RoutingProtocol> routingProtocol, i
   NS_LOG_FUNCTION (this << routingProtocol->GetInstanceTypeId () << priority);
   m_routingProtocols.push_back (std::make_pair (priority, routingProtocol));
   m_routingProtocols.sort ( Compare );
+  m_routeGeneration = NewRouteGeneration ();
   if (m_ipv4 != 0)
     {
       routingProtocol->SetIpv4 (m_ipv4);
     }
 }
 
+uint64_t
+Ipv4ListRouting::GetRouteGeneration (void) const
+{
+  // Generations only grow, so the largest one changes whenever the routes
+  // of any protocol do
+  uint64_t generation = m_routeGeneration;
+  for (Ipv4RoutingProtocolList::const_iterator i = m_routingProtocols.begin ();
+       i != m_routingProtocols.end (); i++)
+    {
+      uint64_t protocolGeneration = i->second->GetRouteGeneration ();
+      if (protocolGeneration == 0)
+        {
+          return 0;
+        }
+      generation = std::max (generation, protocolGeneration);
+    }
+  return generation;
+}
+
 uint32_t 
 Ipv4ListRouting::GetNRoutingProtocols (void) const
 {
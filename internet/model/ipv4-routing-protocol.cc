@@ -36,4 +36,17 @@ TypeId Ipv4RoutingProtocol::GetTypeId (void)
   return tid;
 }
 
+uint64_t
+Ipv4RoutingProtocol::GetRouteGeneration (void) const
+{
+  return 0;
+}
+
+uint64_t
+Ipv4RoutingProtocol::NewRouteGeneration (void)
+{
+  static uint64_t generation = 0;
+  return ++generation;
+}
+
 } // namespace ns3
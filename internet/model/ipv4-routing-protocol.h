@@ -171,6 +171,30 @@ public:
    */
   virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const = 0;
 
+  /**
+   * \brief Get the generation of the routes returned by RouteOutput.
+   *
+   * A route returned by RouteOutput can be reused by its caller for the
+   * same destination and output interface as long as the generation does
+   * not change.  Protocols that can tell when their routes change return
+   * a value drawn from NewRouteGeneration () every time they do.
+   *
+   * \returns the generation of the routes, or 0 if they cannot be reused
+   *          (the default)
+   */
+  virtual uint64_t GetRouteGeneration (void) const;
+
+protected:
+  /**
+   * \brief Draw a new route generation.
+   *
+   * The generations are shared by all the routing protocols, so that a
+   * generation is never returned twice, even by different protocols.
+   *
+   * \returns a new, non-zero, route generation
+   */
+  static uint64_t NewRouteGeneration (void);
+
 };
 
 } // namespace ns3
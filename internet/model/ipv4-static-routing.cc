@@ -42,6 +42,18 @@ NS_LOG_COMPONENT_DEFINE ("Ipv4StaticRouting");
 
 NS_OBJECT_ENSURE_REGISTERED (Ipv4StaticRouting);
 
+/**
+ * \brief Check that the ones of a mask are all before its zeros.
+ * \param mask the mask
+ * \return true if the mask is contiguous
+ */
+static bool
+IsContiguous (Ipv4Mask mask)
+{
+  uint16_t length = mask.GetPrefixLength ();
+  return mask.Get () == (length ? 0xffffffffu << (32 - length) : 0u);
+}
+
 TypeId
 Ipv4StaticRouting::GetTypeId (void)
 {
@@ -54,7 +66,9 @@ Ipv4StaticRouting::GetTypeId (void)
 }
 
 Ipv4StaticRouting::Ipv4StaticRouting () 
-  : m_ipv4 (0)
+  : m_nonContiguousRoutes (0),
+    m_ipv4 (0),
+    m_routeGeneration (NewRouteGeneration ())
 {
   NS_LOG_FUNCTION (this);
 }
@@ -72,7 +86,7 @@ Ipv4StaticRouting::AddNetworkRouteTo (Ipv4Address network,
                                                         networkMask,
                                                         nextHop,
                                                         interface);
-  m_networkRoutes.push_back (make_pair (route,metric));
+  InsertNetworkRoute (route, metric);
 }
 
 void 
@@ -86,7 +100,7 @@ Ipv4StaticRouting::AddNetworkRouteTo (Ipv4Address network,
   *route = Ipv4RoutingTableEntry::CreateNetworkRouteTo (network,
                                                         networkMask,
                                                         interface);
-  m_networkRoutes.push_back (make_pair (route,metric));
+  InsertNetworkRoute (route, metric);
 }
 
 void 
@@ -143,7 +157,7 @@ Ipv4StaticRouting::SetDefaultMulticastRoute (uint32_t outputInterface)
   *route = Ipv4RoutingTableEntry::CreateNetworkRouteTo (network,
                                                         networkMask,
                                                         outputInterface);
-  m_networkRoutes.push_back (make_pair (route,0));
+  InsertNetworkRoute (route, 0);
 }
 
 uint32_t 
@@ -224,8 +238,6 @@ Ipv4StaticRouting::LookupStatic (Ipv4Address dest, Ptr<NetDevice> oif)
 {
   NS_LOG_FUNCTION (this << dest << " " << oif);
   Ptr<Ipv4Route> rtentry = 0;
-  uint16_t longest_mask = 0;
-  uint32_t shortest_metric = 0xffffffff;
   /* when sending on local multicast, there have to be interface specified */
   if (dest.IsLocalMulticast ())
     {
@@ -239,57 +251,57 @@ Ipv4StaticRouting::LookupStatic (Ipv4Address dest, Ptr<NetDevice> oif)
       return rtentry;
     }
 
+  // The routes of the networks covering dest, shortest prefix first
+  uint8_t key[4];
+  dest.Serialize (key);
+  std::vector<NetworkRoutesI> const *matches[33];
+  uint32_t nMatches = m_nonContiguousRoutes > 0 ? 0 : m_networkIndex.Lookup (key, 32, matches);
 
-  for (NetworkRoutesI i = m_networkRoutes.begin (); 
-       i != m_networkRoutes.end (); 
-       i++) 
+  // Take the longest prefix with a route on the requested interface, and
+  // among its routes the one with the smallest metric (the last one added
+  // if several have it; the first one for host routes)
+  Ipv4RoutingTableEntry *route = 0;
+  if (m_nonContiguousRoutes > 0)
     {
-      Ipv4RoutingTableEntry *j=i->first;
-      uint32_t metric =i->second;
-      Ipv4Mask mask = (j)->GetDestNetworkMask ();
-      uint16_t masklen = mask.GetPrefixLength ();
-      Ipv4Address entry = (j)->GetDestNetwork ();
-      NS_LOG_LOGIC ("Searching for route to " << dest << ", checking against route to " << entry << "/" << masklen);
-      if (mask.IsMatch (dest, entry)) 
+      route = ScanNetworkRoutes (dest, oif);
+    }
+  for (uint32_t m = nMatches; m-- > 0 && route == 0; )
+    {
+      uint32_t shortest_metric = 0xffffffff;
+      for (std::vector<NetworkRoutesI>::const_iterator i = matches[m]->begin ();
+           i != matches[m]->end (); ++i)
         {
-          NS_LOG_LOGIC ("Found global network route " << j << ", mask length " << masklen << ", metric " << metric);
-          if (oif != 0)
+          Ipv4RoutingTableEntry *j = (*i)->first;
+          uint32_t metric = (*i)->second;
+          NS_LOG_LOGIC ("Found global network route " << j << ", mask length "
+                        << j->GetDestNetworkMask ().GetPrefixLength () << ", metric " << metric);
+          if (oif != 0 && oif != m_ipv4->GetNetDevice (j->GetInterface ()))
             {
-              if (oif != m_ipv4->GetNetDevice (j->GetInterface ()))
-                {
-                  NS_LOG_LOGIC ("Not on requested interface, skipping");
-                  continue;
-                }
-            }
-          if (masklen < longest_mask) // Not interested if got shorter mask
-            {
-              NS_LOG_LOGIC ("Previous match longer, skipping");
+              NS_LOG_LOGIC ("Not on requested interface, skipping");
               continue;
             }
-          if (masklen > longest_mask) // Reset metric if longer masklen
-            {
-              shortest_metric = 0xffffffff;
-            }
-          longest_mask = masklen;
           if (metric > shortest_metric)
             {
               NS_LOG_LOGIC ("Equal mask length, but previous metric shorter, skipping");
               continue;
             }
           shortest_metric = metric;
-          Ipv4RoutingTableEntry* route = (j);
-          uint32_t interfaceIdx = route->GetInterface ();
-          rtentry = Create<Ipv4Route> ();
-          rtentry->SetDestination (route->GetDest ());
-          rtentry->SetSource (m_ipv4->SourceAddressSelection (interfaceIdx, route->GetDest ()));
-          rtentry->SetGateway (route->GetGateway ());
-          rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
-          if (masklen == 32)
+          route = j;
+          if (j->IsHost ())
             {
               break;
             }
         }
     }
+  if (route != 0)
+    {
+      uint32_t interfaceIdx = route->GetInterface ();
+      rtentry = Create<Ipv4Route> ();
+      rtentry->SetDestination (route->GetDest ());
+      rtentry->SetSource (m_ipv4->SourceAddressSelection (interfaceIdx, route->GetDest ()));
+      rtentry->SetGateway (route->GetGateway ());
+      rtentry->SetOutputDevice (m_ipv4->GetNetDevice (interfaceIdx));
+    }
   if (rtentry != 0)
     {
       NS_LOG_LOGIC ("Matching route via " << rtentry->GetGateway () << " at the end");
@@ -365,27 +377,19 @@ Ipv4StaticRouting::GetDefaultRoute ()
 {
   NS_LOG_FUNCTION (this);
   // Basically a repeat of LookupStatic, retained for backward compatibility
-  Ipv4Address dest ("0.0.0.0");
   uint32_t shortest_metric = 0xffffffff;
   Ipv4RoutingTableEntry *result = 0;
-  for (NetworkRoutesI i = m_networkRoutes.begin (); 
-       i != m_networkRoutes.end (); 
-       i++) 
+  uint8_t key[4] = { 0, 0, 0, 0 };
+  std::vector<NetworkRoutesI> const *defaults = m_networkIndex.Find (key, 0);
+  for (uint32_t i = 0; defaults != 0 && i < defaults->size (); i++)
     {
-      Ipv4RoutingTableEntry *j = i->first;
-      uint32_t metric = i->second;
-      Ipv4Mask mask = (j)->GetDestNetworkMask ();
-      uint16_t masklen = mask.GetPrefixLength ();
-      if (masklen != 0)
-        {
-          continue;
-        }
+      uint32_t metric = (*defaults)[i]->second;
       if (metric > shortest_metric)
         {
           continue;
         }
       shortest_metric = metric;
-      result = j;
+      result = (*defaults)[i]->first;
     }
   if (result)
     {
@@ -447,8 +451,7 @@ Ipv4StaticRouting::RemoveRoute (uint32_t index)
     {
       if (tmp == index)
         {
-          delete j->first;
-          m_networkRoutes.erase (j);
+          EraseNetworkRoute (j);
           return;
         }
       tmp++;
@@ -456,6 +459,101 @@ Ipv4StaticRouting::RemoveRoute (uint32_t index)
   NS_ASSERT (false);
 }
 
+Ipv4RoutingTableEntry *
+Ipv4StaticRouting::ScanNetworkRoutes (Ipv4Address dest, Ptr<NetDevice> oif) const
+{
+  NS_LOG_FUNCTION (this << dest << oif);
+  Ipv4RoutingTableEntry *route = 0;
+  uint16_t longest_mask = 0;
+  uint32_t shortest_metric = 0xffffffff;
+  for (NetworkRoutesCI i = m_networkRoutes.begin (); i != m_networkRoutes.end (); i++)
+    {
+      Ipv4RoutingTableEntry *j = i->first;
+      uint32_t metric = i->second;
+      Ipv4Mask mask = j->GetDestNetworkMask ();
+      uint16_t masklen = mask.GetPrefixLength ();
+      if (!mask.IsMatch (dest, j->GetDestNetwork ()))
+        {
+          continue;
+        }
+      NS_LOG_LOGIC ("Found global network route " << j << ", mask length " << masklen << ", metric " << metric);
+      if (oif != 0 && oif != m_ipv4->GetNetDevice (j->GetInterface ()))
+        {
+          NS_LOG_LOGIC ("Not on requested interface, skipping");
+          continue;
+        }
+      if (masklen < longest_mask) // Not interested if got shorter mask
+        {
+          NS_LOG_LOGIC ("Previous match longer, skipping");
+          continue;
+        }
+      if (masklen > longest_mask) // Reset metric if longer masklen
+        {
+          shortest_metric = 0xffffffff;
+        }
+      longest_mask = masklen;
+      if (metric > shortest_metric)
+        {
+          NS_LOG_LOGIC ("Equal mask length, but previous metric shorter, skipping");
+          continue;
+        }
+      shortest_metric = metric;
+      route = j;
+      if (masklen == 32)
+        {
+          break;
+        }
+    }
+  return route;
+}
+
+void
+Ipv4StaticRouting::InsertNetworkRoute (Ipv4RoutingTableEntry *route, uint32_t metric)
+{
+  NS_LOG_FUNCTION (this << route << metric);
+  NetworkRoutesI i = m_networkRoutes.insert (m_networkRoutes.end (), make_pair (route, metric));
+  m_routeGeneration = NewRouteGeneration ();
+  if (!IsContiguous (route->GetDestNetworkMask ()))
+    {
+      NS_LOG_LOGIC ("Route " << *route << " has a non-contiguous mask, not indexed");
+      ++m_nonContiguousRoutes;
+      return;
+    }
+  uint8_t key[4];
+  route->GetDestNetwork ().CombineMask (route->GetDestNetworkMask ()).Serialize (key);
+  m_networkIndex.Insert (key, route->GetDestNetworkMask ().GetPrefixLength (), i);
+}
+
+Ipv4StaticRouting::NetworkRoutesI
+Ipv4StaticRouting::EraseNetworkRoute (NetworkRoutesI i)
+{
+  NS_LOG_FUNCTION (this << i->first);
+  Ipv4RoutingTableEntry *route = i->first;
+  if (!IsContiguous (route->GetDestNetworkMask ()))
+    {
+      NS_ASSERT (m_nonContiguousRoutes > 0);
+      --m_nonContiguousRoutes;
+    }
+  else
+    {
+      uint8_t key[4];
+      route->GetDestNetwork ().CombineMask (route->GetDestNetworkMask ()).Serialize (key);
+      if (!m_networkIndex.Remove (key, route->GetDestNetworkMask ().GetPrefixLength (), i))
+        {
+          NS_ASSERT_MSG (false, "Route " << *route << " missing from the index");
+        }
+    }
+  delete route;
+  m_routeGeneration = NewRouteGeneration ();
+  return m_networkRoutes.erase (i);
+}
+
+uint64_t
+Ipv4StaticRouting::GetRouteGeneration (void) const
+{
+  return m_routeGeneration;
+}
+
 Ptr<Ipv4Route> 
 Ipv4StaticRouting::RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
 {
@@ -575,6 +673,8 @@ Ipv4StaticRouting::DoDispose (void)
     {
       delete (j->first);
     }
+  m_networkIndex.Clear ();
+  m_nonContiguousRoutes = 0;
   for (MulticastRoutesI i = m_multicastRoutes.begin (); 
        i != m_multicastRoutes.end (); 
        i = m_multicastRoutes.erase (i)) 
@@ -589,6 +689,7 @@ void
 Ipv4StaticRouting::NotifyInterfaceUp (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
+  m_routeGeneration = NewRouteGeneration ();
   // If interface address and network mask have been set, add a route
   // to the network of the interface (like e.g. ifconfig does on a
   // Linux box)
@@ -608,13 +709,13 @@ void
 Ipv4StaticRouting::NotifyInterfaceDown (uint32_t i)
 {
   NS_LOG_FUNCTION (this << i);
+  m_routeGeneration = NewRouteGeneration ();
   // Remove all static routes that are going through this interface
   for (NetworkRoutesI it = m_networkRoutes.begin (); it != m_networkRoutes.end (); )
     {
       if (it->first->GetInterface () == i)
         {
-          delete it->first;
-          it = m_networkRoutes.erase (it);
+          it = EraseNetworkRoute (it);
         }
       else
         {
@@ -627,6 +728,7 @@ void
 Ipv4StaticRouting::NotifyAddAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << " " << address.GetLocal ());
+  m_routeGeneration = NewRouteGeneration ();
   if (!m_ipv4->IsUp (interface))
     {
       return;
@@ -645,6 +747,7 @@ void
 Ipv4StaticRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address)
 {
   NS_LOG_FUNCTION (this << interface << " " << address.GetLocal ());
+  m_routeGeneration = NewRouteGeneration ();
   if (!m_ipv4->IsUp (interface))
     {
       return;
@@ -660,8 +763,7 @@ Ipv4StaticRouting::NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress
           && it->first->GetDestNetwork () == networkAddress
           && it->first->GetDestNetworkMask () == networkMask)
         {
-          delete it->first;
-          it = m_networkRoutes.erase (it);
+          it = EraseNetworkRoute (it);
         }
       else
         {
@@ -676,6 +778,7 @@ Ipv4StaticRouting::SetIpv4 (Ptr<Ipv4> ipv4)
   NS_LOG_FUNCTION (this << ipv4);
   NS_ASSERT (m_ipv4 == 0 && ipv4 != 0);
   m_ipv4 = ipv4;
+  m_routeGeneration = NewRouteGeneration ();
   for (uint32_t i = 0; i < m_ipv4->GetNInterfaces (); i++)
     {
       if (m_ipv4->IsUp (i))
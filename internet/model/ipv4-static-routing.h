@@ -31,6 +31,7 @@
 #include "ns3/ptr.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-routing-protocol.h"
+#include "prefix-trie.h"
 
 namespace ns3 {
 
@@ -86,6 +87,7 @@ public:
   virtual void NotifyRemoveAddress (uint32_t interface, Ipv4InterfaceAddress address);
   virtual void SetIpv4 (Ptr<Ipv4> ipv4);
   virtual void PrintRoutingTable (Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const;
+  virtual uint64_t GetRouteGeneration (void) const;
 
 /**
  * \brief Add a network route to the static routing table.
@@ -413,11 +415,48 @@ private:
   Ptr<Ipv4MulticastRoute> LookupStatic (Ipv4Address origin, Ipv4Address group,
                                         uint32_t interface);
 
+  /**
+   * \brief Find the network route to a destination by scanning all the
+   * network routes, as needed when some have a non-contiguous mask.
+   * \param dest destination address
+   * \param oif output interface if any (put 0 otherwise)
+   * \return the route with the longest mask length, then the smallest
+   * metric, or 0 if none
+   */
+  Ipv4RoutingTableEntry *ScanNetworkRoutes (Ipv4Address dest, Ptr<NetDevice> oif) const;
+
+  /**
+   * \brief Add a route to the network routes and, if its mask is
+   * contiguous, to their index.
+   * \param route the route, now owned by this object
+   * \param metric metric of the route
+   */
+  void InsertNetworkRoute (Ipv4RoutingTableEntry *route, uint32_t metric);
+
+  /**
+   * \brief Remove a route from the network routes and their index, and
+   * delete it.
+   * \param route the route
+   * \return the route following it
+   */
+  NetworkRoutesI EraseNetworkRoute (NetworkRoutesI route);
+
   /**
    * \brief the forwarding table for network.
    */
   NetworkRoutes m_networkRoutes;
 
+  /**
+   * \brief the network routes, indexed by prefix.
+   */
+  PrefixTrie<NetworkRoutesI> m_networkIndex;
+
+  /**
+   * \brief the number of network routes with a non-contiguous mask, which
+   * are not in the index: lookups scan all the routes while there are any.
+   */
+  uint32_t m_nonContiguousRoutes;
+
   /**
    * \brief the forwarding table for multicast.
    */
@@ -427,6 +466,11 @@ private:
    * \brief Ipv4 reference.
    */
   Ptr<Ipv4> m_ipv4;
+
+  /**
+   * \brief Generation of the unicast routes, renewed whenever they change.
+   */
+  uint64_t m_routeGeneration;
 };
 
 } // Namespace ns3
@@ -18,6 +18,7 @@
  * Author: Sebastien Vincent <vincent@clarinet.u-strasbg.fr>
  */
 
+#include <algorithm>
 #include "ipv6-end-point-demux.h"
 #include "ipv6-end-point.h"
 #include "ns3/log.h"
@@ -40,28 +41,101 @@ Ipv6EndPointDemux::~Ipv6EndPointDemux ()
   for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
     {
       Ipv6EndPoint *endPoint = *i;
+      endPoint->m_demux = 0;
       delete endPoint;
     }
   m_endPoints.clear ();
 }
 
-bool Ipv6EndPointDemux::LookupPortLocal (uint16_t port)
+size_t Ipv6EndPointDemux::PeerKeyHash::operator() (PeerKey const &key) const
 {
-  NS_LOG_FUNCTION (this << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  size_t hash = Ipv6AddressHash () (key.peerAddress) ^ ((uint32_t (key.peerPort) << 16) | key.localPort);
+  hash *= 0x9e3779b1;
+  return hash ^ (hash >> 16);
+}
+
+void Ipv6EndPointDemux::Insert (Ipv6EndPoint *endPoint)
+{
+  NS_LOG_FUNCTION (this << endPoint);
+  endPoint->m_demux = this;
+  endPoint->m_position = m_endPoints.insert (m_endPoints.end (), endPoint);
+  Port &port = m_ports[endPoint->GetLocalPort ()];
+  if (port.endPoints.empty ())
     {
-      if ((*i)->GetLocalPort  () == port)
+      SetPortUsed (endPoint->GetLocalPort (), true);
+    }
+  endPoint->m_portPosition = port.endPoints.insert (port.endPoints.end (), endPoint);
+  AddPeer (endPoint);
+  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+}
+
+void Ipv6EndPointDemux::AddPeer (Ipv6EndPoint *endPoint)
+{
+  if (endPoint->GetPeerAddress () == Ipv6Address::GetAny () && endPoint->GetPeerPort () == 0)
+    {
+      m_ports[endPoint->GetLocalPort ()].unconnected.push_back (endPoint);
+    }
+  else
+    {
+      PeerKey key = { endPoint->GetPeerAddress (), endPoint->GetPeerPort (), endPoint->GetLocalPort () };
+      m_peers.insert (std::make_pair (key, endPoint));
+    }
+}
+
+void Ipv6EndPointDemux::RemovePeer (Ipv6EndPoint *endPoint)
+{
+  if (endPoint->GetPeerAddress () == Ipv6Address::GetAny () && endPoint->GetPeerPort () == 0)
+    {
+      std::vector<Ipv6EndPoint *> &unconnected = m_ports[endPoint->GetLocalPort ()].unconnected;
+      unconnected.erase (std::find (unconnected.begin (), unconnected.end (), endPoint));
+    }
+  else
+    {
+      PeerKey key = { endPoint->GetPeerAddress (), endPoint->GetPeerPort (), endPoint->GetLocalPort () };
+      std::pair<PeerEndPointsI, PeerEndPointsI> range = m_peers.equal_range (key);
+      for (PeerEndPointsI i = range.first; i != range.second; ++i)
         {
-          return true;
+          if (i->second == endPoint)
+            {
+              m_peers.erase (i);
+              break;
+            }
         }
     }
-  return false;
+}
+
+void Ipv6EndPointDemux::SetPortUsed (uint16_t port, bool used)
+{
+  if (m_ephemeralPorts.empty () || port < m_portFirst || port > m_portLast)
+    {
+      return;
+    }
+  uint32_t offset = port - m_portFirst;
+  if (used)
+    {
+      m_ephemeralPorts[offset / 64] |= uint64_t (1) << (offset % 64);
+    }
+  else
+    {
+      m_ephemeralPorts[offset / 64] &= ~(uint64_t (1) << (offset % 64));
+    }
+}
+
+bool Ipv6EndPointDemux::LookupPortLocal (uint16_t port)
+{
+  NS_LOG_FUNCTION (this << port);
+  return m_ports.find (port) != m_ports.end ();
 }
 
 bool Ipv6EndPointDemux::LookupLocal (Ptr<NetDevice> boundNetDevice, Ipv6Address addr, uint16_t port)
 {
   NS_LOG_FUNCTION (this << addr << port);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (port);
+  if (p == m_ports.end ())
+    {
+      return false;
+    }
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++)
     {
       if ((*i)->GetLocalPort () == port &&
           (*i)->GetLocalAddress () == addr &&
@@ -83,8 +157,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate ()
       return 0;
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (Ipv6Address::GetAny (), port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -98,8 +171,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ipv6Address address)
       return 0;
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -119,8 +191,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice, Ipv6Ad
       return 0;
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (address, port);
-  m_endPoints.push_back (endPoint);
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
   return endPoint;
 }
 
@@ -129,7 +200,26 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
                                            Ipv6Address peerAddress, uint16_t peerPort)
 {
   NS_LOG_FUNCTION (this << boundNetDevice << localAddress << localPort << peerAddress << peerPort);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  // A duplicate has the same peer, so it is indexed with the new end point
+  std::vector<Ipv6EndPoint *> candidates;
+  if (peerAddress == Ipv6Address::GetAny () && peerPort == 0)
+    {
+      std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (localPort);
+      if (p != m_ports.end ())
+        {
+          candidates = p->second.unconnected;
+        }
+    }
+  else
+    {
+      PeerKey key = { peerAddress, peerPort, localPort };
+      std::pair<PeerEndPointsI, PeerEndPointsI> range = m_peers.equal_range (key);
+      for (PeerEndPointsI i = range.first; i != range.second; ++i)
+        {
+          candidates.push_back (i->second);
+        }
+    }
+  for (std::vector<Ipv6EndPoint *>::iterator i = candidates.begin (); i != candidates.end (); i++)
     {
       if ((*i)->GetLocalPort () == localPort &&
           (*i)->GetLocalAddress () == localAddress &&
@@ -143,9 +233,7 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
     }
   Ipv6EndPoint *endPoint = new Ipv6EndPoint (localAddress, localPort);
   endPoint->SetPeer (peerAddress, peerPort);
-  m_endPoints.push_back (endPoint);
-
-  NS_LOG_DEBUG ("Now have >>" << m_endPoints.size () << "<< endpoints.");
+  Insert (endPoint);
 
   return endPoint;
 }
@@ -153,15 +241,22 @@ Ipv6EndPoint* Ipv6EndPointDemux::Allocate (Ptr<NetDevice> boundNetDevice,
 void Ipv6EndPointDemux::DeAllocate (Ipv6EndPoint *endPoint)
 {
   NS_LOG_FUNCTION (this);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  if (endPoint->m_demux != this)
     {
-      if (*i == endPoint)
-        {
-          delete endPoint;
-          m_endPoints.erase (i);
-          break;
-        }
+      return;
+    }
+  RemovePeer (endPoint);
+  uint16_t localPort = endPoint->GetLocalPort ();
+  Port &port = m_ports[localPort];
+  port.endPoints.erase (endPoint->m_portPosition);
+  if (port.endPoints.empty ())
+    {
+      m_ports.erase (localPort);
+      SetPortUsed (localPort, false);
     }
+  m_endPoints.erase (endPoint->m_position);
+  endPoint->m_demux = 0;
+  delete endPoint;
 }
 
 /*
@@ -175,133 +270,145 @@ Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::Lookup (Ipv6Address daddr, uint1
 {
   NS_LOG_FUNCTION (this << daddr << dport << saddr << sport << incomingInterface);
 
-  EndPoints retval1; /* Matches exact on local port, wildcards on others */
-  EndPoints retval2; /* Matches exact on local port/adder, wildcards on others */
-  EndPoints retval3; /* Matches all but local address */
-  EndPoints retval4; /* Exact match on all 4 */
+  /* [0]: Matches exact on local port, wildcards on others
+     [1]: Matches exact on local port/adder, wildcards on others
+     [2]: Matches all but local address
+     [3]: Exact match on all 4 */
+  EndPoints matches[4];
 
   NS_LOG_DEBUG ("Looking up endpoint for destination address " << daddr);
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  /* Only the end points with the source of the packet as peer can match
+     it exactly, and those without a peer can match it with wildcards */
+  PeerKey key = { saddr, sport, dport };
+  std::pair<PeerEndPointsI, PeerEndPointsI> range = m_peers.equal_range (key);
+  for (PeerEndPointsI i = range.first; i != range.second; ++i)
     {
-      Ipv6EndPoint* endP = *i;
-
-      NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
-                                                 << " daddr=" << endP->GetLocalAddress ()
-                                                 << " sport=" << endP->GetPeerPort ()
-                                                 << " saddr=" << endP->GetPeerAddress ());
-
-      if (!endP->IsRxEnabled ())
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                        << " because endpoint can not receive packets");
-          continue;
-        }
-
-      if (endP->GetLocalPort () != dport)
-        {
-          NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                             << " because endpoint dport "
-                                             << endP->GetLocalPort ()
-                                             << " does not match packet dport " << dport);
-          continue;
-        }
-
-      if (endP->GetBoundNetDevice ())
+      Match (i->second, daddr, saddr, sport, incomingInterface, matches);
+    }
+  if (matches[3].empty () && matches[2].empty ())
+    {
+      std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (dport);
+      if (p != m_ports.end ())
         {
-          if (!incomingInterface)
-            {
-              continue;
-            }
-          if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
+          std::vector<Ipv6EndPoint *> const &unconnected = p->second.unconnected;
+          for (std::vector<Ipv6EndPoint *>::const_iterator i = unconnected.begin (); i != unconnected.end (); ++i)
             {
-              NS_LOG_LOGIC ("Skipping endpoint " << &endP
-                                                 << " because endpoint is bound to specific device and"
-                                                 << endP->GetBoundNetDevice ()
-                                                 << " does not match packet device " << incomingInterface->GetDevice ());
-              continue;
+              Match (*i, daddr, saddr, sport, incomingInterface, matches);
             }
         }
+    }
 
-      /*    Ipv6Address incomingInterfaceAddr = incomingInterface->GetAddress (); */
-      NS_LOG_DEBUG ("dest addr " << daddr);
+  // Here we find the most exact match
+  EndPoints retval;
+  if (!matches[3].empty ()) retval = matches[3];
+  else if (!matches[2].empty ()) retval = matches[2];
+  else if (!matches[1].empty ()) retval = matches[1];
+  else retval = matches[0];
 
-      bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv6Address::GetAny ();
-      bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
-      bool localAddressMatchesAllRouters = endP->GetLocalAddress () == Ipv6Address::GetAllRoutersMulticast ();
+  NS_ABORT_MSG_IF (retval.size () > 1, "Too many endpoints - perhaps you created too many sockets without binding them to different NetDevices.");
+  return retval;  // might be empty if no matches
+}
 
-      /* if no match here, keep looking */
-      if (!(localAddressMatchesExact || localAddressMatchesWildCard))
-        {
-          continue;
-        }
-      bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
-      bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
-      bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
-      bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv6Address::GetAny ();
-
-      /* If remote does not match either with exact or wildcard,i
-         skip this one */
-      if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
+void Ipv6EndPointDemux::Match (Ipv6EndPoint *endP, Ipv6Address daddr, Ipv6Address saddr, uint16_t sport,
+                               Ptr<Ipv6Interface> incomingInterface, EndPoints matches[4])
+{
+  NS_LOG_DEBUG ("Looking at endpoint dport=" << endP->GetLocalPort ()
+                                             << " daddr=" << endP->GetLocalAddress ()
+                                             << " sport=" << endP->GetPeerPort ()
+                                             << " saddr=" << endP->GetPeerAddress ());
+
+  if (!endP->IsRxEnabled ())
+    {
+      NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                    << " because endpoint can not receive packets");
+      return;
+    }
+
+  if (endP->GetBoundNetDevice ())
+    {
+      if (!incomingInterface)
         {
-          continue;
+          return;
         }
-      if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+      if (endP->GetBoundNetDevice () != incomingInterface->GetDevice ())
         {
-          continue;
-        }
-
-      /* Now figure out which return list to add this one to */
-      if (localAddressMatchesWildCard
-          && remotePeerMatchesWildCard
-          && remoteAddressMatchesWildCard)
-        { /* Only local port matches exactly */
-          retval1.push_back (endP);
-        }
-      if ((localAddressMatchesExact || (localAddressMatchesAllRouters))
-          && remotePeerMatchesWildCard
-          && remoteAddressMatchesWildCard)
-        { /* Only local port and local address matches exactly */
-          retval2.push_back (endP);
-        }
-      if (localAddressMatchesWildCard
-          && remotePeerMatchesExact
-          && remoteAddressMatchesExact)
-        { /* All but local address */
-          retval3.push_back (endP);
-        }
-      if (localAddressMatchesExact
-          && remotePeerMatchesExact
-          && remoteAddressMatchesExact)
-        { /* All 4 match */
-          retval4.push_back (endP);
+          NS_LOG_LOGIC ("Skipping endpoint " << &endP
+                                             << " because endpoint is bound to specific device and"
+                                             << endP->GetBoundNetDevice ()
+                                             << " does not match packet device " << incomingInterface->GetDevice ());
+          return;
         }
     }
 
-  // Here we find the most exact match
-  EndPoints retval;
-  if (!retval4.empty ()) retval = retval4;
-  else if (!retval3.empty ()) retval = retval3;
-  else if (!retval2.empty ()) retval = retval2;
-  else retval = retval1;
+  /*    Ipv6Address incomingInterfaceAddr = incomingInterface->GetAddress (); */
+  NS_LOG_DEBUG ("dest addr " << daddr);
 
-  NS_ABORT_MSG_IF (retval.size () > 1, "Too many endpoints - perhaps you created too many sockets without binding them to different NetDevices.");
-  return retval;  // might be empty if no matches
+  bool localAddressMatchesWildCard = endP->GetLocalAddress () == Ipv6Address::GetAny ();
+  bool localAddressMatchesExact = endP->GetLocalAddress () == daddr;
+  bool localAddressMatchesAllRouters = endP->GetLocalAddress () == Ipv6Address::GetAllRoutersMulticast ();
+
+  /* if no match here, keep looking */
+  if (!(localAddressMatchesExact || localAddressMatchesWildCard))
+    {
+      return;
+    }
+  bool remotePeerMatchesExact = endP->GetPeerPort () == sport;
+  bool remotePeerMatchesWildCard = endP->GetPeerPort () == 0;
+  bool remoteAddressMatchesExact = endP->GetPeerAddress () == saddr;
+  bool remoteAddressMatchesWildCard = endP->GetPeerAddress () == Ipv6Address::GetAny ();
+
+  /* If remote does not match either with exact or wildcard,i
+     skip this one */
+  if (!(remotePeerMatchesExact || remotePeerMatchesWildCard))
+    {
+      return;
+    }
+  if (!(remoteAddressMatchesExact || remoteAddressMatchesWildCard))
+    {
+      return;
+    }
+
+  /* Now figure out which return list to add this one to */
+  if (localAddressMatchesWildCard
+      && remotePeerMatchesWildCard
+      && remoteAddressMatchesWildCard)
+    { /* Only local port matches exactly */
+      matches[0].push_back (endP);
+    }
+  if ((localAddressMatchesExact || (localAddressMatchesAllRouters))
+      && remotePeerMatchesWildCard
+      && remoteAddressMatchesWildCard)
+    { /* Only local port and local address matches exactly */
+      matches[1].push_back (endP);
+    }
+  if (localAddressMatchesWildCard
+      && remotePeerMatchesExact
+      && remoteAddressMatchesExact)
+    { /* All but local address */
+      matches[2].push_back (endP);
+    }
+  if (localAddressMatchesExact
+      && remotePeerMatchesExact
+      && remoteAddressMatchesExact)
+    { /* All 4 match */
+      matches[3].push_back (endP);
+    }
 }
 
 Ipv6EndPoint* Ipv6EndPointDemux::SimpleLookup (Ipv6Address dst, uint16_t dport, Ipv6Address src, uint16_t sport)
 {
   uint32_t genericity = 3;
   Ipv6EndPoint *generic = 0;
+  std::unordered_map<uint16_t, Port>::iterator p = m_ports.find (dport);
+  if (p == m_ports.end ())
+    {
+      return 0;
+    }
 
-  for (EndPointsI i = m_endPoints.begin (); i != m_endPoints.end (); i++)
+  for (EndPointsI i = p->second.endPoints.begin (); i != p->second.endPoints.end (); i++)
     {
       uint32_t tmp = 0;
 
-      if ((*i)->GetLocalPort () != dport)
-        {
-          continue;
-        }
-
       if ((*i)->GetLocalAddress () == dst && (*i)->GetPeerPort () == sport
           && (*i)->GetPeerAddress () == src)
         {
@@ -331,23 +438,34 @@ Ipv6EndPoint* Ipv6EndPointDemux::SimpleLookup (Ipv6Address dst, uint16_t dport,
 uint16_t Ipv6EndPointDemux::AllocateEphemeralPort ()
 {
   NS_LOG_FUNCTION (this);
-  uint16_t port = m_ephemeral;
-  int count = m_portLast - m_portFirst;
-  do
+  uint32_t range = m_portLast - m_portFirst + 1;
+  if (m_ephemeralPorts.empty ())
     {
-      if (count-- < 0)
+      m_ephemeralPorts.assign ((range + 63) / 64, 0);
+      for (std::unordered_map<uint16_t, Port>::const_iterator i = m_ports.begin (); i != m_ports.end (); ++i)
         {
-          return 0;
+          SetPortUsed (i->first, true);
+        }
+    }
+  uint32_t offset = m_ephemeral - m_portFirst;
+  for (uint32_t count = 0; count < range; ++count)
+    {
+      offset = offset + 1 < range ? offset + 1 : 0;
+      uint64_t word = m_ephemeralPorts[offset / 64];
+      if (offset % 64 == 0 && word == ~uint64_t (0))
+        {
+          /* Skip 64 ports in use at once */
+          offset += 63;
+          count += 63;
+          continue;
         }
-      ++port;
-      if (port < m_portFirst || port > m_portLast)
+      if (!((word >> (offset % 64)) & 1))
         {
-          port = m_portFirst;
+          m_ephemeral = m_portFirst + offset;
+          return m_ephemeral;
         }
     }
-  while (LookupPortLocal (port));
-  m_ephemeral = port;
-  return port;
+  return 0;
 }
 
 Ipv6EndPointDemux::EndPoints Ipv6EndPointDemux::GetEndPoints () const
@@ -23,6 +23,8 @@
 
 #include <stdint.h>
 #include <list>
+#include <unordered_map>
+#include <vector>
 #include "ns3/ipv6-address.h"
 #include "ipv6-interface.h"
 
@@ -34,6 +36,10 @@ class Ipv6EndPoint;
  * \ingroup ipv6
  *
  * \brief Demultiplexer for end points.
+ *
+ * The end points with a peer are hashed by their peer and local port, the
+ * others are indexed by local port, and a bitmap of the ephemeral ports in
+ * use speeds up their allocation.
  */
 class Ipv6EndPointDemux
 {
@@ -175,9 +181,118 @@ private:
   uint16_t m_portLast;
 
   /**
-   * \brief A list of IPv6 end points.
+   * \brief A list of IPv6 end points, in allocation order.
    */
   EndPoints m_endPoints;
+
+  friend class Ipv6EndPoint;
+
+  /**
+   * \brief Key of the end points with a peer.
+   */
+  struct PeerKey
+  {
+    Ipv6Address peerAddress; //!< peer address
+    uint16_t peerPort;       //!< peer port
+    uint16_t localPort;      //!< local port
+
+    /**
+     * \brief Equality operator.
+     * \param other the other key
+     * \return true if the keys are equal
+     */
+    bool operator== (PeerKey const &other) const
+    {
+      return peerAddress == other.peerAddress && peerPort == other.peerPort && localPort == other.localPort;
+    }
+  };
+
+  /**
+   * \brief Hash function of PeerKey.
+   */
+  struct PeerKeyHash
+  {
+    /**
+     * \param key the key
+     * \return the hash of the key
+     */
+    size_t operator() (PeerKey const &key) const;
+  };
+
+  /**
+   * \brief Container of the end points with a peer.
+   */
+  typedef std::unordered_multimap<PeerKey, Ipv6EndPoint *, PeerKeyHash> PeerEndPoints;
+
+  /**
+   * \brief Iterator to the container of the end points with a peer.
+   */
+  typedef PeerEndPoints::iterator PeerEndPointsI;
+
+  /**
+   * \brief The end points of a local port.
+   */
+  struct Port
+  {
+    EndPoints endPoints;                     //!< all the end points, in allocation order
+    std::vector<Ipv6EndPoint *> unconnected; //!< the end points without a peer, in allocation order
+  };
+
+  /**
+   * \brief Add an end point to the demux.
+   * \param endPoint the end point
+   */
+  void Insert (Ipv6EndPoint *endPoint);
+
+  /**
+   * \brief Index an end point by its peer, or as without a peer.
+   * \param endPoint the end point
+   */
+  void AddPeer (Ipv6EndPoint *endPoint);
+
+  /**
+   * \brief Remove an end point from the index of its peer.
+   * \param endPoint the end point
+   */
+  void RemovePeer (Ipv6EndPoint *endPoint);
+
+  /**
+   * \brief Mark a port as used or free in the ephemeral port bitmap.
+   * \param port the port
+   * \param used whether the port is used
+   */
+  void SetPortUsed (uint16_t port, bool used);
+
+  /**
+   * \brief Add an end point to the matches of a packet, by how many of the
+   * four fields it matches exactly.
+   * \param endP the end point, bound to the destination port
+   * \param daddr destination address of the packet
+   * \param saddr source address of the packet
+   * \param sport source port of the packet
+   * \param incomingInterface the incoming interface
+   * \param matches the end points matching only the local port ([0]), the
+   * local port and address ([1]), all but the local address ([2]) and all
+   * four fields ([3])
+   */
+  void Match (Ipv6EndPoint *endP, Ipv6Address daddr, Ipv6Address saddr, uint16_t sport,
+              Ptr<Ipv6Interface> incomingInterface, EndPoints matches[4]);
+
+  /**
+   * \brief The end points by local port.
+   */
+  std::unordered_map<uint16_t, Port> m_ports;
+
+  /**
+   * \brief The end points with a peer, by peer and local port.
+   */
+  PeerEndPoints m_peers;
+
+  /**
+   * \brief Bitmap of the ephemeral ports in use, allocated with the first
+   * ephemeral port.
+   */
+  std::vector<uint64_t> m_ephemeralPorts;
 };
 
 } /* namespace ns3 */
@@ -22,6 +22,7 @@
 #define IPV6_END_POINT_H
 
 #include <stdint.h>
+#include <list>
 
 #include "ns3/ipv6-address.h"
 #include "ns3/callback.h"
@@ -34,6 +35,7 @@ namespace ns3
 
 class Header;
 class Packet;
+class Ipv6EndPointDemux;
 
 /**
  * \ingroup ipv6
@@ -236,6 +238,23 @@ private:
    * \brief true if the endpoint can receive packets.
    */
   bool m_rxEnabled;
+
+  friend class Ipv6EndPointDemux;
+
+  /**
+   * \brief The demux indexing the endpoint (if any), told when its peer changes.
+   */
+  Ipv6EndPointDemux *m_demux;
+
+  /**
+   * \brief The position of the endpoint among all the endpoints of its demux.
+   */
+  std::list<Ipv6EndPoint *>::iterator m_position;
+
+  /**
+   * \brief The position of the endpoint among the endpoints of its local port.
+   */
+  std::list<Ipv6EndPoint *>::iterator m_portPosition;
 };
 
 } /* namespace ns3 */
@@ -36,6 +36,16 @@ NS_LOG_COMPONENT_DEFINE ("Ipv6StaticRouting");
 
 NS_OBJECT_ENSURE_REGISTERED (Ipv6StaticRouting);
 
+/**
+ * \brief Check that the ones of a prefix are all before its zeros.
+ * \param prefix the prefix
+ * \return true if the prefix is contiguous
+ */
+static bool IsContiguous (Ipv6Prefix prefix)
+{
+  return prefix.IsEqual (Ipv6Prefix (prefix.GetPrefixLength ()));
+}
+
 TypeId Ipv6StaticRouting::GetTypeId ()
 {
   static TypeId tid = TypeId ("ns3::Ipv6StaticRouting")
@@ -47,7 +57,8 @@ TypeId Ipv6StaticRouting::GetTypeId ()
 }
 
 Ipv6StaticRouting::Ipv6StaticRouting ()
-  : m_ipv6 (0)
+  : m_nonContiguousRoutes (0),
+    m_ipv6 (0)
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -151,7 +162,7 @@ void Ipv6StaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix netwo
   NS_LOG_FUNCTION (this << network << networkPrefix << nextHop << interface << metric);
   Ipv6RoutingTableEntry* route = new Ipv6RoutingTableEntry ();
   *route = Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkPrefix, nextHop, interface);
-  m_networkRoutes.push_back (std::make_pair (route, metric));
+  InsertNetworkRoute (route, metric);
 }
 
 void Ipv6StaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, Ipv6Address nextHop, uint32_t interface, Ipv6Address prefixToUse, uint32_t metric)
@@ -164,7 +175,7 @@ void Ipv6StaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix netwo
 
   Ipv6RoutingTableEntry* route = new Ipv6RoutingTableEntry ();
   *route = Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkPrefix, nextHop, interface, prefixToUse);
-  m_networkRoutes.push_back (std::make_pair (route, metric));
+  InsertNetworkRoute (route, metric);
 }
 
 void Ipv6StaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix networkPrefix, uint32_t interface, uint32_t metric)
@@ -172,7 +183,7 @@ void Ipv6StaticRouting::AddNetworkRouteTo (Ipv6Address network, Ipv6Prefix netwo
   NS_LOG_FUNCTION (this << network << networkPrefix << interface);
   Ipv6RoutingTableEntry* route = new Ipv6RoutingTableEntry ();
   *route = Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkPrefix, interface);
-  m_networkRoutes.push_back (std::make_pair (route, metric));
+  InsertNetworkRoute (route, metric);
 }
 
 void Ipv6StaticRouting::SetDefaultRoute (Ipv6Address nextHop, uint32_t interface, Ipv6Address prefixToUse, uint32_t metric)
@@ -196,7 +207,7 @@ void Ipv6StaticRouting::SetDefaultMulticastRoute (uint32_t outputInterface)
   Ipv6Address network = Ipv6Address ("ff00::"); /* RFC 3513 */
   Ipv6Prefix networkMask = Ipv6Prefix (8);
   *route = Ipv6RoutingTableEntry::CreateNetworkRouteTo (network, networkMask, outputInterface);
-  m_networkRoutes.push_back (std::make_pair (route, 0));
+  InsertNetworkRoute (route, 0);
 }
 
 uint32_t Ipv6StaticRouting::GetNMulticastRoutes () const
@@ -285,8 +296,6 @@ Ptr<Ipv6Route> Ipv6StaticRouting::LookupStatic (Ipv6Address dst, Ptr<NetDevice>
 {
   NS_LOG_FUNCTION (this << dst << interface);
   Ptr<Ipv6Route> rtentry = 0;
-  uint16_t longestMask = 0;
-  uint32_t shortestMetric = 0xffffffff;
 
   /* when sending on link-local multicast, there have to be interface specified */
   if (dst.IsLinkLocalMulticast ())
@@ -300,68 +309,72 @@ Ptr<Ipv6Route> Ipv6StaticRouting::LookupStatic (Ipv6Address dst, Ptr<NetDevice>
       return rtentry;
     }
 
-  for (NetworkRoutesI it = m_networkRoutes.begin (); it != m_networkRoutes.end (); it++)
-    {
-      Ipv6RoutingTableEntry* j = it->first;
-      uint32_t metric = it->second;
-      Ipv6Prefix mask = j->GetDestNetworkPrefix ();
-      uint16_t maskLen = mask.GetPrefixLength ();
-      Ipv6Address entry = j->GetDestNetwork ();
+  /* the routes of the networks covering dst, shortest prefix first */
+  uint8_t key[16];
+  dst.GetBytes (key);
+  std::vector<NetworkRoutesI> const *matches[129];
+  uint32_t nMatches = m_nonContiguousRoutes > 0 ? 0 : m_networkIndex.Lookup (key, 128, matches);
 
-      NS_LOG_LOGIC ("Searching for route to " << dst << ", mask length " << maskLen << ", metric " << metric);
-
-      if (mask.IsMatch (dst, entry))
+  /* longest prefix with a route on the given interface, then smallest
+   * metric (the last route added among equals, the first for host routes)
+   */
+  Ipv6RoutingTableEntry* route = 0;
+  if (m_nonContiguousRoutes > 0)
+    {
+      route = ScanNetworkRoutes (dst, interface);
+    }
+  for (uint32_t m = nMatches; m-- > 0 && route == 0; )
+    {
+      uint32_t shortestMetric = 0xffffffff;
+      for (std::vector<NetworkRoutesI>::const_iterator it = matches[m]->begin (); it != matches[m]->end (); it++)
         {
-          NS_LOG_LOGIC ("Found global network route " << *j << ", mask length " << maskLen << ", metric " << metric);
+          Ipv6RoutingTableEntry* j = (*it)->first;
+          uint32_t metric = (*it)->second;
+
+          NS_LOG_LOGIC ("Found global network route " << *j << ", mask length " << j->GetDestNetworkPrefix ().GetPrefixLength () << ", metric " << metric);
 
           /* if interface is given, check the route will output on this interface */
-          if (!interface || interface == m_ipv6->GetNetDevice (j->GetInterface ()))
+          if (interface && interface != m_ipv6->GetNetDevice (j->GetInterface ()))
             {
-              if (maskLen < longestMask)
-                {
-                  NS_LOG_LOGIC ("Previous match longer, skipping");
-                  continue;
-                }
-
-              if (maskLen > longestMask)
-                {
-                  shortestMetric = 0xffffffff;
-                }
+              continue;
+            }
 
-              longestMask = maskLen;
-              if (metric > shortestMetric)
-                {
-                  NS_LOG_LOGIC ("Equal mask length, but previous metric shorter, skipping");
-                  continue;
-                }
+          if (metric > shortestMetric)
+            {
+              NS_LOG_LOGIC ("Equal mask length, but previous metric shorter, skipping");
+              continue;
+            }
 
-              shortestMetric = metric;
-              Ipv6RoutingTableEntry* route = j;
-              uint32_t interfaceIdx = route->GetInterface ();
-              rtentry = Create<Ipv6Route> ();
+          shortestMetric = metric;
+          route = j;
+          if (j->IsHost ())
+            {
+              break;
+            }
+        }
+    }
 
-              if (route->GetGateway ().IsAny ())
-                {
-                  rtentry->SetSource (m_ipv6->SourceAddressSelection (interfaceIdx, route->GetDest ()));
-                }
-              else if (route->GetDest ().IsAny ()) /* default route */
-                {
-                  rtentry->SetSource (m_ipv6->SourceAddressSelection (interfaceIdx, route->GetPrefixToUse ().IsAny () ? dst : route->GetPrefixToUse ()));
-                }
-              else
-                {
-                  rtentry->SetSource (m_ipv6->SourceAddressSelection (interfaceIdx, route->GetGateway ()));
-                }
+  if (route)
+    {
+      uint32_t interfaceIdx = route->GetInterface ();
+      rtentry = Create<Ipv6Route> ();
 
-              rtentry->SetDestination (route->GetDest ());
-              rtentry->SetGateway (route->GetGateway ());
-              rtentry->SetOutputDevice (m_ipv6->GetNetDevice (interfaceIdx));
-              if (maskLen == 128)
-                {
-                  break;
-                }
-            }
+      if (route->GetGateway ().IsAny ())
+        {
+          rtentry->SetSource (m_ipv6->SourceAddressSelection (interfaceIdx, route->GetDest ()));
         }
+      else if (route->GetDest ().IsAny ()) /* default route */
+        {
+          rtentry->SetSource (m_ipv6->SourceAddressSelection (interfaceIdx, route->GetPrefixToUse ().IsAny () ? dst : route->GetPrefixToUse ()));
+        }
+      else
+        {
+          rtentry->SetSource (m_ipv6->SourceAddressSelection (interfaceIdx, route->GetGateway ()));
+        }
+
+      rtentry->SetDestination (route->GetDest ());
+      rtentry->SetGateway (route->GetGateway ());
+      rtentry->SetOutputDevice (m_ipv6->GetNetDevice (interfaceIdx));
     }
 
   if (rtentry)
@@ -380,6 +393,8 @@ void Ipv6StaticRouting::DoDispose ()
       delete j->first;
     }
   m_networkRoutes.clear ();
+  m_networkIndex.Clear ();
+  m_nonContiguousRoutes = 0;
 
   for (MulticastRoutesI i = m_multicastRoutes.begin (); i != m_multicastRoutes.end (); i = m_multicastRoutes.erase (i))
     {
@@ -448,29 +463,20 @@ uint32_t Ipv6StaticRouting::GetNRoutes () const
 Ipv6RoutingTableEntry Ipv6StaticRouting::GetDefaultRoute ()
 {
   NS_LOG_FUNCTION_NOARGS ();
-  Ipv6Address dst ("::");
   uint32_t shortestMetric = 0xffffffff;
   Ipv6RoutingTableEntry* result = 0;
+  uint8_t key[16] = { 0 };
+  std::vector<NetworkRoutesI> const *defaults = m_networkIndex.Find (key, 0);
 
-  for (NetworkRoutesI it = m_networkRoutes.begin (); it != m_networkRoutes.end (); it++)
+  for (uint32_t i = 0; defaults != 0 && i < defaults->size (); i++)
     {
-      Ipv6RoutingTableEntry* j = it->first;
-      uint32_t metric = it->second;
-      Ipv6Prefix mask = j->GetDestNetworkPrefix ();
-      uint16_t maskLen = mask.GetPrefixLength ();
-      Ipv6Address entry = j->GetDestNetwork ();
-
-      if (maskLen)
-        {
-          continue;
-        }
-
+      uint32_t metric = (*defaults)[i]->second;
       if (metric > shortestMetric)
         {
           continue;
         }
       shortestMetric = metric;
-      result = j;
+      result = (*defaults)[i]->first;
     }
 
   if (result)
@@ -528,8 +534,7 @@ void Ipv6StaticRouting::RemoveRoute (uint32_t index)
     {
       if (tmp == index)
         {
-          delete it->first;
-          m_networkRoutes.erase (it);
+          EraseNetworkRoute (it);
           return;
         }
       tmp++;
@@ -547,13 +552,103 @@ void Ipv6StaticRouting::RemoveRoute (Ipv6Address network, Ipv6Prefix prefix, uin
       if (network == rtentry->GetDest () && rtentry->GetInterface () == ifIndex
           && rtentry->GetPrefixToUse () == prefixToUse)
         {
-          delete it->first;
-          m_networkRoutes.erase (it);
+          EraseNetworkRoute (it);
           return;
         }
     }
 }
 
+Ipv6RoutingTableEntry* Ipv6StaticRouting::ScanNetworkRoutes (Ipv6Address dst, Ptr<NetDevice> interface) const
+{
+  NS_LOG_FUNCTION (this << dst << interface);
+  Ipv6RoutingTableEntry* route = 0;
+  uint16_t longestMask = 0;
+  uint32_t shortestMetric = 0xffffffff;
+
+  for (NetworkRoutesCI it = m_networkRoutes.begin (); it != m_networkRoutes.end (); it++)
+    {
+      Ipv6RoutingTableEntry* j = it->first;
+      uint32_t metric = it->second;
+      Ipv6Prefix mask = j->GetDestNetworkPrefix ();
+      uint16_t maskLen = mask.GetPrefixLength ();
+
+      if (!mask.IsMatch (dst, j->GetDestNetwork ()))
+        {
+          continue;
+        }
+      NS_LOG_LOGIC ("Found global network route " << *j << ", mask length " << maskLen << ", metric " << metric);
+
+      /* if interface is given, check the route will output on this interface */
+      if (interface && interface != m_ipv6->GetNetDevice (j->GetInterface ()))
+        {
+          continue;
+        }
+
+      if (maskLen < longestMask)
+        {
+          NS_LOG_LOGIC ("Previous match longer, skipping");
+          continue;
+        }
+
+      if (maskLen > longestMask)
+        {
+          shortestMetric = 0xffffffff;
+        }
+
+      longestMask = maskLen;
+      if (metric > shortestMetric)
+        {
+          NS_LOG_LOGIC ("Equal mask length, but previous metric shorter, skipping");
+          continue;
+        }
+
+      shortestMetric = metric;
+      route = j;
+      if (maskLen == 128)
+        {
+          break;
+        }
+    }
+  return route;
+}
+
+void Ipv6StaticRouting::InsertNetworkRoute (Ipv6RoutingTableEntry *route, uint32_t metric)
+{
+  NS_LOG_FUNCTION (this << route << metric);
+  NetworkRoutesI it = m_networkRoutes.insert (m_networkRoutes.end (), std::make_pair (route, metric));
+  if (!IsContiguous (route->GetDestNetworkPrefix ()))
+    {
+      NS_LOG_LOGIC ("Route " << *route << " has a non-contiguous prefix, not indexed");
+      ++m_nonContiguousRoutes;
+      return;
+    }
+  uint8_t key[16];
+  route->GetDestNetwork ().CombinePrefix (route->GetDestNetworkPrefix ()).GetBytes (key);
+  m_networkIndex.Insert (key, route->GetDestNetworkPrefix ().GetPrefixLength (), it);
+}
+
+Ipv6StaticRouting::NetworkRoutesI Ipv6StaticRouting::EraseNetworkRoute (NetworkRoutesI it)
+{
+  NS_LOG_FUNCTION (this << it->first);
+  Ipv6RoutingTableEntry *route = it->first;
+  if (!IsContiguous (route->GetDestNetworkPrefix ()))
+    {
+      NS_ASSERT (m_nonContiguousRoutes > 0);
+      --m_nonContiguousRoutes;
+    }
+  else
+    {
+      uint8_t key[16];
+      route->GetDestNetwork ().CombinePrefix (route->GetDestNetworkPrefix ()).GetBytes (key);
+      if (!m_networkIndex.Remove (key, route->GetDestNetworkPrefix ().GetPrefixLength (), it))
+        {
+          NS_ASSERT_MSG (false, "Route " << *route << " missing from the index");
+        }
+    }
+  delete route;
+  return m_networkRoutes.erase (it);
+}
+
 Ptr<Ipv6Route> Ipv6StaticRouting::RouteOutput (Ptr<Packet> p, const Ipv6Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr)
 {
   NS_LOG_FUNCTION (this << header << oif);
@@ -672,8 +767,7 @@ void Ipv6StaticRouting::NotifyInterfaceDown (uint32_t i)
     {
       if (it->first->GetInterface () == i)
         {
-          delete it->first;
-          it = m_networkRoutes.erase (it);
+          it = EraseNetworkRoute (it);
         }
       else
         {
@@ -717,8 +811,7 @@ void Ipv6StaticRouting::NotifyRemoveAddress (uint32_t interface, Ipv6InterfaceAd
           && it->first->GetDestNetwork () == networkAddress
           && it->first->GetDestNetworkPrefix () == networkMask)
         {
-          delete it->first;
-          it = m_networkRoutes.erase (it);
+          it = EraseNetworkRoute (it);
         }
       else
         {
@@ -761,8 +854,7 @@ void Ipv6StaticRouting::NotifyRemoveRoute (Ipv6Address dst, Ipv6Prefix mask, Ipv
 
           if (dst == entry && prefix == mask && rtentry->GetInterface () == interface)
             {
-              delete j->first;
-              j = m_networkRoutes.erase (j);
+              j = EraseNetworkRoute (j);
             }
           else
             {
@@ -30,6 +30,7 @@
 #include "ns3/ipv6.h"
 #include "ns3/ipv6-header.h"
 #include "ns3/ipv6-routing-protocol.h"
+#include "prefix-trie.h"
 
 namespace ns3 {
 
@@ -281,11 +282,49 @@ private:
    */
   Ptr<Ipv6MulticastRoute> LookupStatic (Ipv6Address origin, Ipv6Address group, uint32_t ifIndex);
 
+  /**
+   * \brief Find the network route to a destination by scanning all the
+   * network routes, as needed when some have a non-contiguous prefix.
+   * \param dst destination address
+   * \param interface output interface if any (put 0 otherwise)
+   * \return the route with the longest prefix length, then the smallest
+   * metric, or 0 if none
+   */
+  Ipv6RoutingTableEntry* ScanNetworkRoutes (Ipv6Address dst, Ptr<NetDevice> interface) const;
+
+  /**
+   * \brief Add a route to the network routes and, if its prefix is
+   * contiguous, to their index.
+   * \param route the route, now owned by this object
+   * \param metric metric of the route
+   */
+  void InsertNetworkRoute (Ipv6RoutingTableEntry *route, uint32_t metric);
+
+  /**
+   * \brief Remove a route from the network routes and their index, and
+   * delete it.
+   * \param route the route
+   * \return the route following it
+   */
+  NetworkRoutesI EraseNetworkRoute (NetworkRoutesI route);
+
   /**
    * \brief the forwarding table for network.
    */
   NetworkRoutes m_networkRoutes;
 
+  /**
+   * \brief the network routes, indexed by prefix.
+   */
+  PrefixTrie<NetworkRoutesI> m_networkIndex;
+
+  /**
+   * \brief the number of network routes with a non-contiguous prefix,
+   * which are not in the index: lookups scan all the routes while there
+   * are any.
+   */
+  uint32_t m_nonContiguousRoutes;
+
   /**
    * \brief the forwarding table for multicast.
    */
@@ -94,12 +94,7 @@ NdiscCache::Entry* NdiscCache::Lookup (Ipv6Address dst)
 {
   NS_LOG_FUNCTION (this << dst);
 
-  if (m_ndCache.find (dst) != m_ndCache.end ())
-    {
-      NdiscCache::Entry* entry = m_ndCache[dst];
-      return entry;
-    }
-  return 0;
+  return m_ndCache.Find (dst);
 }
 
 std::list<NdiscCache::Entry*> NdiscCache::LookupInverse (Address dst)
@@ -107,10 +102,10 @@ std::list<NdiscCache::Entry*> NdiscCache::LookupInverse (Address dst)
   NS_LOG_FUNCTION (this << dst);
 
   std::list<NdiscCache::Entry *> entryList;
-  for (CacheI i = m_ndCache.begin (); i != m_ndCache.end (); i++)
+  for (uint32_t i = 0; i < m_ndCache.GetNSlots (); i++)
     {
-      NdiscCache::Entry *entry = (*i).second;
-      if (entry->GetMacAddress () == dst)
+      NdiscCache::Entry *entry = m_ndCache.GetSlot (i);
+      if (entry != 0 && entry->GetMacAddress () == dst)
         {
           entryList.push_back (entry);
         }
@@ -122,11 +117,10 @@ std::list<NdiscCache::Entry*> NdiscCache::LookupInverse (Address dst)
 NdiscCache::Entry* NdiscCache::Add (Ipv6Address to)
 {
   NS_LOG_FUNCTION (this << to);
-  NS_ASSERT (m_ndCache.find (to) == m_ndCache.end ());
+  NS_ASSERT (m_ndCache.Find (to) == 0);
 
-  NdiscCache::Entry* entry = new NdiscCache::Entry (this);
+  NdiscCache::Entry* entry = m_ndCache.Add (to, this);
   entry->SetIpv6Address (to);
-  m_ndCache[to] = entry;
   return entry;
 }
 
@@ -134,15 +128,10 @@ void NdiscCache::Remove (NdiscCache::Entry* entry)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  for (CacheI i = m_ndCache.begin (); i != m_ndCache.end (); i++)
+  if (m_ndCache.Find (entry->GetIpv6Address ()) == entry)
     {
-      if ((*i).second == entry)
-        {
-          m_ndCache.erase (i);
-          entry->ClearWaitingPacket ();
-          delete entry;
-          return;
-        }
+      entry->ClearWaitingPacket ();
+      m_ndCache.Remove (entry->GetIpv6Address ());
     }
 }
 
@@ -150,12 +139,7 @@ void NdiscCache::Flush ()
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  for (CacheI i = m_ndCache.begin (); i != m_ndCache.end (); i++)
-    {
-      delete (*i).second; /* delete the pointer NdiscCache::Entry */
-    }
-
-  m_ndCache.erase (m_ndCache.begin (), m_ndCache.end ());
+  m_ndCache.Clear ();
 }
 
 void NdiscCache::SetUnresQlen (uint32_t unresQlen)
@@ -175,9 +159,14 @@ void NdiscCache::PrintNdiscCache (Ptr<OutputStreamWrapper> stream)
   NS_LOG_FUNCTION (this << stream);
   std::ostream* os = stream->GetStream ();
 
-  for (CacheI i = m_ndCache.begin (); i != m_ndCache.end (); i++)
+  for (uint32_t i = 0; i < m_ndCache.GetNSlots (); i++)
     {
-      *os << i->first << " dev ";
+      NdiscCache::Entry *entry = m_ndCache.GetSlot (i);
+      if (entry == 0)
+        {
+          continue;
+        }
+      *os << entry->GetIpv6Address () << " dev ";
       std::string found = Names::FindName (m_device);
       if (Names::FindName (m_device) != "")
         {
@@ -188,29 +177,29 @@ void NdiscCache::PrintNdiscCache (Ptr<OutputStreamWrapper> stream)
           *os << static_cast<int> (m_device->GetIfIndex ());
         }
 
-      *os << " lladdr " << i->second->GetMacAddress ();
+      *os << " lladdr " << entry->GetMacAddress ();
 
-      if (i->second->IsReachable ())
+      if (entry->IsReachable ())
         {
           *os << " REACHABLE\n";
         }
-      else if (i->second->IsDelay ())
+      else if (entry->IsDelay ())
         {
           *os << " DELAY\n";
         }
-      else if (i->second->IsIncomplete ())
+      else if (entry->IsIncomplete ())
         {
           *os << " INCOMPLETE\n";
         }
-      else if (i->second->IsProbe ())
+      else if (entry->IsProbe ())
         {
           *os << " PROBE\n";
         }
-      else if (i->second->IsStale ())
+      else if (entry->IsStale ())
         {
           *os << " STALE\n";
         }
-      else if (i->second->IsPermanent ())
+      else if (entry->IsPermanent ())
 	{
 	  *os << " PERMANENT\n";
 	}
@@ -223,7 +212,6 @@ void NdiscCache::PrintNdiscCache (Ptr<OutputStreamWrapper> stream)
 
 NdiscCache::Entry::Entry (NdiscCache* nd)
   : m_ndCache (nd),
-    m_waiting (),
     m_router (false),
     m_nudTimer (Timer::CANCEL_ON_DESTROY),
     m_lastReachabilityConfirmation (Seconds (0.0)),
@@ -248,20 +236,20 @@ void NdiscCache::Entry::AddWaitingPacket (Ipv6PayloadHeaderPair p)
 {
   NS_LOG_FUNCTION (this << p.second << p.first);
 
-  if (m_waiting.size () >= m_ndCache->GetUnresQlen ())
+  if (m_waiting.GetSize () >= m_ndCache->GetUnresQlen ())
     {
       /* we store only m_unresQlen packet => first packet in first packet remove */
       /** \todo report packet as 'dropped' */
-      m_waiting.pop_front ();
+      m_waiting.Pop ();
     }
-  m_waiting.push_back (p);
+  m_waiting.Push (p);
 }
 
 void NdiscCache::Entry::ClearWaitingPacket ()
 {
   NS_LOG_FUNCTION_NOARGS ();
   /** \todo report packets as 'dropped' */
-  m_waiting.clear ();
+  m_waiting.Clear ();
 }
 
 void NdiscCache::Entry::FunctionReachableTimeout ()
@@ -302,7 +290,11 @@ void NdiscCache::Entry::FunctionRetransmitTimeout ()
     }
   else
     {
-      Ipv6PayloadHeaderPair malformedPacket = m_waiting.front ();
+      Ipv6PayloadHeaderPair malformedPacket;
+      if (!m_waiting.IsEmpty ())
+        {
+          malformedPacket = m_waiting.Get (0);
+        }
       if (malformedPacket.first == 0)
         {
           malformedPacket.first = Create<Packet> ();
@@ -405,6 +397,12 @@ void NdiscCache::Entry::SetIpv6Address (Ipv6Address ipv6Address)
   m_ipv6Address = ipv6Address;
 }
 
+Ipv6Address NdiscCache::Entry::GetIpv6Address () const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  return m_ipv6Address;
+}
+
 Time NdiscCache::Entry::GetLastReachabilityConfirmation () const
 {
   NS_LOG_FUNCTION_NOARGS ();
@@ -493,7 +491,7 @@ void NdiscCache::Entry::MarkIncomplete (Ipv6PayloadHeaderPair p)
 
   if (p.first)
     {
-      m_waiting.push_back (p);
+      m_waiting.Push (p);
     }
 }
 
@@ -502,7 +500,18 @@ std::list<NdiscCache::Ipv6PayloadHeaderPair> NdiscCache::Entry::MarkReachable (A
   NS_LOG_FUNCTION (this << mac);
   m_state = REACHABLE;
   m_macAddress = mac;
-  return m_waiting;
+  return GetWaitingPackets ();
+}
+
+std::list<NdiscCache::Ipv6PayloadHeaderPair> NdiscCache::Entry::GetWaitingPackets () const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  std::list<Ipv6PayloadHeaderPair> waiting;
+  for (uint32_t i = 0; i < m_waiting.GetSize (); i++)
+    {
+      waiting.push_back (m_waiting.Get (i));
+    }
+  return waiting;
 }
 
 void NdiscCache::Entry::MarkProbe ()
@@ -528,7 +537,7 @@ std::list<NdiscCache::Ipv6PayloadHeaderPair> NdiscCache::Entry::MarkStale (Addre
   NS_LOG_FUNCTION (this << mac);
   m_state = STALE;
   m_macAddress = mac;
-  return m_waiting;
+  return GetWaitingPackets ();
 }
 
 void NdiscCache::Entry::MarkDelay ()
@@ -30,15 +30,15 @@
 #include "ns3/ipv6-address.h"
 #include "ns3/ptr.h"
 #include "ns3/timer.h"
-#include "ns3/sgi-hashmap.h"
 #include "ns3/output-stream-wrapper.h"
+#include "ipv6-header.h"
+#include "neighbor-table.h"
 
 namespace ns3
 {
 
 class NetDevice;
 class Ipv6Interface;
-class Ipv6Header;
 class Icmpv6L4Protocol;
 
 /**
@@ -107,6 +107,10 @@ public:
 
   /**
    * \brief Delete an entry.
+   *
+   * The entry is found by its address, so this does not depend on the
+   * size of the cache.
+   *
    * \param entry pointer to delete from the list.
    */
   void Remove (NdiscCache::Entry* entry);
@@ -342,7 +346,19 @@ public:
      */
     void SetIpv6Address (Ipv6Address ipv6Address);
 
+    /**
+     * \brief Get the IPv6 address.
+     * \return the IPv6 address
+     */
+    Ipv6Address GetIpv6Address () const;
+
 private:
+    /**
+     * \brief Copy the waiting packets.
+     * \return the waiting packets, first in first
+     */
+    std::list<Ipv6PayloadHeaderPair> GetWaitingPackets () const;
+
     /**
      * \brief The IPv6 address.
      */
@@ -377,9 +393,10 @@ private:
     Address m_macAddress;
 
     /**
-     * \brief The list of packet waiting.
+     * \brief The packets waiting; the first ones (as many as the default
+     * UnresolvedQueueSize) are kept in the entry itself.
      */
-    std::list<Ipv6PayloadHeaderPair> m_waiting;
+    InlineQueue<Ipv6PayloadHeaderPair, DEFAULT_UNRES_QLEN> m_waiting;
 
     /**
      * \brief Type of node (router or host).
@@ -406,11 +423,7 @@ private:
   /**
    * \brief Neighbor Discovery Cache container
    */
-  typedef sgi::hash_map<Ipv6Address, NdiscCache::Entry *, Ipv6AddressHash> Cache;
-  /**
-   * \brief Neighbor Discovery Cache container iterator
-   */
-  typedef sgi::hash_map<Ipv6Address, NdiscCache::Entry *, Ipv6AddressHash>::iterator CacheI;
+  typedef NeighborTable<Ipv6Address, NdiscCache::Entry, Ipv6AddressHash> Cache;
 
   /**
    * \brief Copy constructor.
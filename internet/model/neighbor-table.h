@@ -0,0 +1,395 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef NEIGHBOR_TABLE_H
+#define NEIGHBOR_TABLE_H
+
+#include <stdint.h>
+#include <deque>
+#include <new>
+#include <vector>
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup internet
+ *
+ * \brief The entries of a neighbor cache (ArpCache, NdiscCache), indexed
+ * by their IP address.
+ *
+ * The index is a flat open-addressing table with linear probing, holding
+ * the address and a pointer to the entry in each slot, so a lookup reads
+ * one or two adjacent slots.  The entries themselves are built in place
+ * in blocks of storage and recycled when removed: they never move, so
+ * the pointers given to callers stay valid until the entry is removed.
+ *
+ * \tparam A the address type
+ * \tparam E the entry type, built from a pointer to its cache
+ * \tparam H the address hash
+ */
+template <typename A, typename E, typename H>
+class NeighborTable
+{
+public:
+  NeighborTable ()
+    : m_size (0)
+  {
+  }
+
+  ~NeighborTable ()
+  {
+    Clear ();
+  }
+
+  /**
+   * \brief Find the entry of an address.
+   * \param address the address
+   * \return the entry, or 0 if there is none
+   */
+  E *Find (A const &address) const
+  {
+    if (m_slots.empty ())
+      {
+        return 0;
+      }
+    uint32_t mask = m_slots.size () - 1;
+    for (uint32_t i = Home (address); ; i = (i + 1) & mask)
+      {
+        if (m_slots[i].entry == 0)
+          {
+            return 0;
+          }
+        if (m_slots[i].address == address)
+          {
+            return m_slots[i].entry;
+          }
+      }
+  }
+
+  /**
+   * \brief Build the entry of a new address.
+   * \param address the address, which must not have an entry
+   * \param cache the cache, given to the constructor of the entry
+   * \return the entry
+   */
+  template <typename C>
+  E *Add (A const &address, C *cache)
+  {
+    NS_ASSERT (Find (address) == 0);
+    if (2 * (m_size + 1) > m_slots.size ())
+      {
+        Resize (m_slots.empty () ? 16 : 2 * m_slots.size ());
+      }
+    Storage *storage;
+    if (!m_free.empty ())
+      {
+        storage = m_free.back ();
+        m_free.pop_back ();
+      }
+    else
+      {
+        m_storage.push_back (Storage ());
+        storage = &m_storage.back ();
+      }
+    E *entry = new (storage) E (cache);
+    Insert (address, entry);
+    m_size++;
+    return entry;
+  }
+
+  /**
+   * \brief Destroy the entry of an address.
+   * \param address the address
+   * \return true if the address had an entry
+   */
+  bool Remove (A const &address)
+  {
+    if (m_slots.empty ())
+      {
+        return false;
+      }
+    uint32_t mask = m_slots.size () - 1;
+    uint32_t i = Home (address);
+    while (m_slots[i].entry != 0 && !(m_slots[i].address == address))
+      {
+        i = (i + 1) & mask;
+      }
+    E *entry = m_slots[i].entry;
+    if (entry == 0)
+      {
+        return false;
+      }
+    // Shift the following slots of the cluster back, so that no lookup
+    // stops early at the freed slot
+    for (uint32_t j = (i + 1) & mask; m_slots[j].entry != 0; j = (j + 1) & mask)
+      {
+        uint32_t home = Home (m_slots[j].address);
+        if (((j - home) & mask) >= ((j - i) & mask))
+          {
+            m_slots[i] = m_slots[j];
+            i = j;
+          }
+      }
+    m_slots[i] = Slot ();
+    m_size--;
+    entry->~E ();
+    m_free.push_back (reinterpret_cast<Storage *> (entry));
+    return true;
+  }
+
+  /**
+   * \brief Destroy every entry.
+   */
+  void Clear (void)
+  {
+    for (uint32_t i = 0; i < m_slots.size (); i++)
+      {
+        if (m_slots[i].entry != 0)
+          {
+            m_slots[i].entry->~E ();
+          }
+      }
+    m_slots.clear ();
+    m_storage.clear ();
+    m_free.clear ();
+    m_size = 0;
+  }
+
+  /**
+   * \return the number of entries
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /**
+   * \return the number of slots, for GetSlot ()
+   */
+  uint32_t GetNSlots (void) const
+  {
+    return m_slots.size ();
+  }
+
+  /**
+   * \brief Walk the entries, in no particular order.
+   * \param slot the slot, below GetNSlots ()
+   * \return the entry in the slot, or 0 if the slot is free
+   */
+  E *GetSlot (uint32_t slot) const
+  {
+    return m_slots[slot].entry;
+  }
+
+private:
+  /// A slot of the index
+  struct Slot
+  {
+    Slot ()
+      : entry (0)
+    {
+    }
+    A address; //!< the address
+    E *entry;  //!< its entry, or 0 if the slot is free
+  };
+
+  /// Room for one entry
+  struct Storage
+  {
+    union
+    {
+      char bytes[sizeof (E)]; //!< the entry
+      double alignDouble;     //!< alignment
+      void *alignPointer;     //!< alignment
+      uint64_t alignInteger;  //!< alignment
+    };
+  };
+
+  /**
+   * \param address an address
+   * \return the first slot to probe for the address
+   */
+  uint32_t Home (A const &address) const
+  {
+    // Fibonacci hashing spreads consecutive addresses, whose hash may be
+    // the address itself, over the table
+    uint64_t hash = static_cast<uint64_t> (H () (address)) * 0x9e3779b97f4a7c15ULL;
+    return static_cast<uint32_t> (hash >> 32) & (m_slots.size () - 1);
+  }
+
+  /**
+   * \brief Put an entry in the first free slot from its home slot.
+   * \param address the address of the entry
+   * \param entry the entry
+   */
+  void Insert (A const &address, E *entry)
+  {
+    uint32_t mask = m_slots.size () - 1;
+    uint32_t i = Home (address);
+    while (m_slots[i].entry != 0)
+      {
+        i = (i + 1) & mask;
+      }
+    m_slots[i].address = address;
+    m_slots[i].entry = entry;
+  }
+
+  /**
+   * \brief Move the entries to a table of another size.
+   * \param size the new number of slots, a power of two
+   */
+  void Resize (uint32_t size)
+  {
+    std::vector<Slot> slots (size);
+    m_slots.swap (slots);
+    for (uint32_t i = 0; i < slots.size (); i++)
+      {
+        if (slots[i].entry != 0)
+          {
+            Insert (slots[i].address, slots[i].entry);
+          }
+      }
+  }
+
+  std::vector<Slot> m_slots;      //!< the index, a power of two slots long
+  std::deque<Storage> m_storage;  //!< the entries, which never move
+  std::vector<Storage *> m_free;  //!< storage of the removed entries
+  uint32_t m_size;                //!< number of entries
+};
+
+/**
+ * \ingroup internet
+ *
+ * \brief A FIFO queue keeping its first N items inline.
+ *
+ * Neighbor cache entries queue a few packets while their address is being
+ * resolved (3 by default).  Up to N of them are kept in the entry itself;
+ * longer queues overflow to a deque.
+ *
+ * \tparam T the item type
+ * \tparam N the number of inline items
+ */
+template <typename T, uint32_t N>
+class InlineQueue
+{
+public:
+  InlineQueue ()
+    : m_head (0),
+      m_size (0)
+  {
+  }
+
+  /**
+   * \return true if the queue is empty
+   */
+  bool IsEmpty (void) const
+  {
+    return GetSize () == 0;
+  }
+
+  /**
+   * \return the number of items
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size + m_overflow.size ();
+  }
+
+  /**
+   * \param i the position of the item, from the front
+   * \return the item
+   */
+  T const &Get (uint32_t i) const
+  {
+    NS_ASSERT (i < GetSize ());
+    return i < m_size ? m_items[(m_head + i) % N] : m_overflow[i - m_size];
+  }
+
+  /**
+   * \brief Add an item at the back.
+   * \param item the item
+   */
+  void Push (T const &item)
+  {
+    // Inline items come first: once the queue overflows, new items go to
+    // the overflow until it is drained
+    if (m_size < N && m_overflow.empty ())
+      {
+        m_items[(m_head + m_size) % N] = item;
+        m_size++;
+      }
+    else
+      {
+        m_overflow.push_back (item);
+      }
+  }
+
+  /**
+   * \brief Remove the item at the front.
+   * \return the item
+   */
+  T Pop (void)
+  {
+    NS_ASSERT (GetSize () > 0);
+    T item;
+    if (m_size == 0)
+      {
+        item = m_overflow.front ();
+        m_overflow.pop_front ();
+        return item;
+      }
+    item = m_items[m_head];
+    m_items[m_head] = T ();
+    m_head = (m_head + 1) % N;
+    m_size--;
+    if (m_size == 0)
+      {
+        // Refill from the overflow, so that the inline items stay first
+        while (m_size < N && !m_overflow.empty ())
+          {
+            m_items[(m_head + m_size) % N] = m_overflow.front ();
+            m_overflow.pop_front ();
+            m_size++;
+          }
+      }
+    return item;
+  }
+
+  /**
+   * \brief Remove every item.
+   */
+  void Clear (void)
+  {
+    while (m_size > 0)
+      {
+        m_items[m_head] = T ();
+        m_head = (m_head + 1) % N;
+        m_size--;
+      }
+    m_overflow.clear ();
+  }
+
+private:
+  T m_items[N];            //!< the first items, a ring starting at m_head
+  uint32_t m_head;         //!< position of the front item in m_items
+  uint32_t m_size;         //!< number of items in m_items
+  std::deque<T> m_overflow; //!< the items after the first N
+};
+
+} // namespace ns3
+
+#endif /* NEIGHBOR_TABLE_H */
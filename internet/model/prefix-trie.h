@@ -0,0 +1,239 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PREFIX_TRIE_H
+#define PREFIX_TRIE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup ipv4Routing
+ *
+ * \brief A binary trie of address prefixes, updated incrementally.
+ *
+ * Each prefix carries a list of values (typically the routes to the
+ * prefix), kept in the order they were inserted.  Prefixes are given as
+ * bytes in network order (Ipv4Address::Serialize, Ipv6Address::GetBytes)
+ * and a length in bits, so the same trie serves IPv4 and IPv6.
+ *
+ * Insert () and Remove () take O(length) steps, and Lookup () returns the
+ * values of every prefix covering an address in at most one step per bit
+ * of the address, whatever the number of prefixes.  Nodes are only kept
+ * on the paths to the prefixes, and are recycled when they become unused.
+ *
+ * Unlike Ipv4Fib, the trie does not need to be rebuilt after a change,
+ * which suits tables changed one route at a time.
+ */
+template <typename T>
+class PrefixTrie
+{
+public:
+  PrefixTrie ()
+  {
+    Clear ();
+  }
+
+  /**
+   * \brief Remove every prefix.
+   */
+  void Clear (void)
+  {
+    m_nodes.assign (1, Node ());
+    m_free.clear ();
+  }
+
+  /**
+   * \brief Add a value to a prefix, after its other values.
+   * \param key the prefix, in network order; bits beyond length are ignored
+   * \param length the prefix length in bits
+   * \param value the value
+   */
+  void Insert (uint8_t const *key, uint32_t length, T const &value)
+  {
+    uint32_t node = 0;
+    for (uint32_t bit = 0; bit < length; ++bit)
+      {
+        uint32_t side = GetBit (key, bit);
+        uint32_t child = m_nodes[node].child[side];
+        if (child == 0)
+          {
+            child = NewNode ();
+            m_nodes[node].child[side] = child;
+          }
+        node = child;
+      }
+    m_nodes[node].values.push_back (value);
+  }
+
+  /**
+   * \brief Remove a value from a prefix.
+   * \param key the prefix, in network order
+   * \param length the prefix length in bits
+   * \param value the value
+   * \return true if the value was found and removed
+   */
+  bool Remove (uint8_t const *key, uint32_t length, T const &value)
+  {
+    // The nodes on the path, to free the unused ones from the bottom up
+    std::vector<uint32_t> &path = m_path;
+    path.resize (length + 1);
+    path[0] = 0;
+    for (uint32_t bit = 0; bit < length; ++bit)
+      {
+        path[bit + 1] = m_nodes[path[bit]].child[GetBit (key, bit)];
+        if (path[bit + 1] == 0)
+          {
+            return false;
+          }
+      }
+    std::vector<T> &values = m_nodes[path[length]].values;
+    typename std::vector<T>::iterator i = std::find (values.begin (), values.end (), value);
+    if (i == values.end ())
+      {
+        return false;
+      }
+    values.erase (i);
+    for (uint32_t bit = length; bit > 0; --bit)
+      {
+        Node &node = m_nodes[path[bit]];
+        if (!node.values.empty () || node.child[0] != 0 || node.child[1] != 0)
+          {
+            break;
+          }
+        m_nodes[path[bit - 1]].child[GetBit (key, bit - 1)] = 0;
+        m_free.push_back (path[bit]);
+      }
+    return true;
+  }
+
+  /**
+   * \brief Get the values of a prefix.
+   * \param key the prefix, in network order
+   * \param length the prefix length in bits
+   * \return the values, or 0 if the prefix has none
+   */
+  std::vector<T> const *Find (uint8_t const *key, uint32_t length) const
+  {
+    uint32_t node = 0;
+    for (uint32_t bit = 0; bit < length; ++bit)
+      {
+        node = m_nodes[node].child[GetBit (key, bit)];
+        if (node == 0)
+          {
+            return 0;
+          }
+      }
+    if (m_nodes[node].values.empty ())
+      {
+        return 0;
+      }
+    return &m_nodes[node].values;
+  }
+
+  /**
+   * \brief Look up the values of the prefixes covering an address.
+   * \param key the address, in network order
+   * \param bits the address length in bits
+   * \param matches [out] the values of each covering prefix, shortest
+   * prefix first; must have room for bits + 1 entries, and stays valid
+   * until the trie changes
+   * \return the number of covering prefixes
+   */
+  uint32_t Lookup (uint8_t const *key, uint32_t bits, std::vector<T> const **matches) const
+  {
+    uint32_t n = 0;
+    uint32_t node = 0;
+    for (uint32_t bit = 0; ; ++bit)
+      {
+        if (!m_nodes[node].values.empty ())
+          {
+            matches[n++] = &m_nodes[node].values;
+          }
+        if (bit == bits)
+          {
+            break;
+          }
+        node = m_nodes[node].child[GetBit (key, bit)];
+        if (node == 0)
+          {
+            break;
+          }
+      }
+    return n;
+  }
+
+  /**
+   * \return the number of trie nodes in use
+   */
+  uint32_t GetNNodes (void) const
+  {
+    return m_nodes.size () - m_free.size ();
+  }
+
+private:
+  /// A trie node
+  struct Node
+  {
+    Node ()
+    {
+      child[0] = 0;
+      child[1] = 0;
+    }
+    uint32_t child[2];     //!< children for a 0 and a 1 bit (0 if none; the root is nobody's child)
+    std::vector<T> values; //!< values of the prefix ending at this node
+  };
+
+  /**
+   * \param key bytes in network order
+   * \param bit index of the bit, from the most significant one
+   * \return the bit
+   */
+  static uint32_t GetBit (uint8_t const *key, uint32_t bit)
+  {
+    return (key[bit >> 3] >> (7 - (bit & 7))) & 1;
+  }
+
+  /**
+   * \return the index of an empty node, recycled if possible
+   */
+  uint32_t NewNode (void)
+  {
+    if (!m_free.empty ())
+      {
+        uint32_t node = m_free.back ();
+        m_free.pop_back ();
+        NS_ASSERT (m_nodes[node].values.empty ());
+        m_nodes[node].child[0] = 0;
+        m_nodes[node].child[1] = 0;
+        return node;
+      }
+    m_nodes.push_back (Node ());
+    return m_nodes.size () - 1;
+  }
+
+  std::vector<Node> m_nodes;   //!< the nodes, root first
+  std::vector<uint32_t> m_free; //!< unused nodes
+  std::vector<uint32_t> m_path; //!< scratch path of Remove ()
+};
+
+} // namespace ns3
+
+#endif /* PREFIX_TRIE_H */
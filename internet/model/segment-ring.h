@@ -0,0 +1,224 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SEGMENT_RING_H
+#define SEGMENT_RING_H
+
+#include <stdint.h>
+#include <vector>
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief A double-ended queue of segment descriptors, in one array.
+ *
+ * The items are kept by value in a circular array, which only grows (by
+ * doubling) when full: once a connection has reached its window, pushing
+ * at one end and popping at the other does not allocate.  Items are
+ * addressed by their position from the front, so that a sorted ring can be
+ * searched by bisection.  Inserting or erasing in the middle moves the
+ * items after the position, and is meant for the rare splits and merges.
+ *
+ * Removed items are overwritten with a default item, so that they release
+ * what they hold (e.g. a packet) at once.
+ *
+ * \tparam T the item type
+ */
+template <typename T>
+class SegmentRing
+{
+public:
+  SegmentRing ()
+    : m_head (0),
+      m_size (0)
+  {
+  }
+
+  /**
+   * \return true if the ring is empty
+   */
+  bool IsEmpty (void) const
+  {
+    return m_size == 0;
+  }
+
+  /**
+   * \return the number of items
+   */
+  uint32_t GetSize (void) const
+  {
+    return m_size;
+  }
+
+  /**
+   * \param i the position of the item, from the front
+   * \return the item
+   */
+  T &operator[] (uint32_t i)
+  {
+    NS_ASSERT (i < m_size);
+    return m_items[(m_head + i) & (m_items.size () - 1)];
+  }
+
+  /**
+   * \param i the position of the item, from the front
+   * \return the item
+   */
+  T const &operator[] (uint32_t i) const
+  {
+    NS_ASSERT (i < m_size);
+    return m_items[(m_head + i) & (m_items.size () - 1)];
+  }
+
+  /**
+   * \return the first item
+   */
+  T &Front (void)
+  {
+    return (*this)[0];
+  }
+
+  /**
+   * \return the last item
+   */
+  T &Back (void)
+  {
+    return (*this)[m_size - 1];
+  }
+
+  /**
+   * \brief Add an item at the back.
+   * \param item the item
+   */
+  void PushBack (T const &item)
+  {
+    Reserve (m_size + 1);
+    m_size++;
+    Back () = item;
+  }
+
+  /**
+   * \brief Add an item at the front.
+   * \param item the item
+   */
+  void PushFront (T const &item)
+  {
+    Reserve (m_size + 1);
+    m_head = (m_head - 1) & (m_items.size () - 1);
+    m_size++;
+    Front () = item;
+  }
+
+  /**
+   * \brief Remove the first item.
+   */
+  void PopFront (void)
+  {
+    NS_ASSERT (m_size > 0);
+    Front () = T ();
+    m_head = (m_head + 1) & (m_items.size () - 1);
+    m_size--;
+  }
+
+  /**
+   * \brief Remove the last item.
+   */
+  void PopBack (void)
+  {
+    NS_ASSERT (m_size > 0);
+    Back () = T ();
+    m_size--;
+  }
+
+  /**
+   * \brief Insert an item before a position.
+   * \param i the position, up to GetSize ()
+   * \param item the item
+   */
+  void Insert (uint32_t i, T const &item)
+  {
+    NS_ASSERT (i <= m_size);
+    Reserve (m_size + 1);
+    m_size++;
+    for (uint32_t j = m_size - 1; j > i; --j)
+      {
+        (*this)[j] = (*this)[j - 1];
+      }
+    (*this)[i] = item;
+  }
+
+  /**
+   * \brief Remove the item at a position.
+   * \param i the position
+   */
+  void Erase (uint32_t i)
+  {
+    NS_ASSERT (i < m_size);
+    for (uint32_t j = i; j + 1 < m_size; ++j)
+      {
+        (*this)[j] = (*this)[j + 1];
+      }
+    PopBack ();
+  }
+
+  /**
+   * \brief Remove every item.
+   */
+  void Clear (void)
+  {
+    while (m_size > 0)
+      {
+        PopBack ();
+      }
+    m_head = 0;
+  }
+
+private:
+  /**
+   * \brief Make room for a number of items.
+   * \param size the number of items
+   */
+  void Reserve (uint32_t size)
+  {
+    if (size <= m_items.size ())
+      {
+        return;
+      }
+    uint32_t capacity = m_items.empty () ? 16 : m_items.size ();
+    while (capacity < size)
+      {
+        capacity *= 2;
+      }
+    std::vector<T> items (capacity);
+    for (uint32_t i = 0; i < m_size; ++i)
+      {
+        items[i] = (*this)[i];
+      }
+    m_items.swap (items);
+    m_head = 0;
+  }
+
+  std::vector<T> m_items; //!< the items, a power of two long, m_size of them from m_head
+  uint32_t m_head;        //!< position of the first item in m_items
+  uint32_t m_size;        //!< number of items
+};
+
+} // namespace ns3
+
+#endif /* SEGMENT_RING_H */
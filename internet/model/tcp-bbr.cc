@@ -0,0 +1,552 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <algorithm>
+#include "tcp-bbr.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/tcp-socket-base.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpBbr");
+NS_OBJECT_ENSURE_REGISTERED (TcpBbr);
+
+/// Length of the bandwidth filter, in round trips (as in Linux)
+static const uint32_t BW_WINDOW_LENGTH = 10;
+/// Length of the minimum RTT filter, in seconds (as in Linux)
+static const uint32_t MIN_RTT_WINDOW_LENGTH = 10;
+/// Number of phases of PROBE_BW
+static const uint32_t GAIN_CYCLE_LENGTH = 8;
+/// Pacing gain of the phases of PROBE_BW
+static const double PACING_GAIN_CYCLE[GAIN_CYCLE_LENGTH] = { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+/// Gain of cWnd in PROBE_BW
+static const double CWND_GAIN = 2;
+/// Round trips without 25% growth of the bandwidth for the pipe to be full
+static const uint32_t FULL_BW_COUNT = 3;
+
+TypeId
+TcpBbr::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpBbr")
+    .SetParent<TcpCongestionOps> ()
+    .AddConstructor<TcpBbr> ()
+    .SetGroupName ("Internet")
+    .AddAttribute ("HighGain", "Gain of STARTUP, at least 2/ln(2) to double "
+                   "the sending rate every round trip",
+                   DoubleValue (2.89),
+                   MakeDoubleAccessor (&TcpBbr::m_highGain),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("ProbeRttDuration", "Time spent in PROBE_RTT (0 to never enter it)",
+                   TimeValue (MilliSeconds (200)),
+                   MakeTimeAccessor (&TcpBbr::m_probeRttDuration),
+                   MakeTimeChecker ())
+    .AddAttribute ("MinPipeCwnd", "Minimum cWnd, in segments, as in PROBE_RTT",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&TcpBbr::m_minPipeCwnd),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+TcpBbr::TcpBbr ()
+  : TcpCongestionOps (),
+    m_state (BBR_STARTUP),
+    m_maxBwFilter (BW_WINDOW_LENGTH, 0, 0),
+    m_minRttFilter (Seconds (MIN_RTT_WINDOW_LENGTH), Time::Max (), Time (0)),
+    m_minRttStamp (0),
+    m_hasSeenRtt (false),
+    m_roundCount (0),
+    m_nextRoundDelivered (0),
+    m_roundStart (false),
+    m_pacingGain (0),
+    m_cWndGain (0),
+    m_fullBw (0),
+    m_fullBwCount (0),
+    m_fullBwReached (false),
+    m_cycleIndex (0),
+    m_cycleStamp (0),
+    m_probeRttDoneStamp (0),
+    m_probeRttRoundDone (false),
+    m_priorCwnd (0),
+    m_packetConservation (false),
+    m_prevCaState (TcpSocketState::CA_OPEN)
+{
+  NS_LOG_FUNCTION (this);
+  m_uv = CreateObject<UniformRandomVariable> ();
+}
+
+TcpBbr::TcpBbr (const TcpBbr &sock)
+  : TcpCongestionOps (sock),
+    m_highGain (sock.m_highGain),
+    m_probeRttDuration (sock.m_probeRttDuration),
+    m_minPipeCwnd (sock.m_minPipeCwnd),
+    m_state (sock.m_state),
+    m_maxBwFilter (sock.m_maxBwFilter),
+    m_minRttFilter (sock.m_minRttFilter),
+    m_minRttStamp (sock.m_minRttStamp),
+    m_hasSeenRtt (sock.m_hasSeenRtt),
+    m_roundCount (sock.m_roundCount),
+    m_nextRoundDelivered (sock.m_nextRoundDelivered),
+    m_roundStart (sock.m_roundStart),
+    m_pacingGain (sock.m_pacingGain),
+    m_cWndGain (sock.m_cWndGain),
+    m_fullBw (sock.m_fullBw),
+    m_fullBwCount (sock.m_fullBwCount),
+    m_fullBwReached (sock.m_fullBwReached),
+    m_cycleIndex (sock.m_cycleIndex),
+    m_cycleStamp (sock.m_cycleStamp),
+    m_probeRttDoneStamp (sock.m_probeRttDoneStamp),
+    m_probeRttRoundDone (sock.m_probeRttRoundDone),
+    m_priorCwnd (sock.m_priorCwnd),
+    m_packetConservation (sock.m_packetConservation),
+    m_prevCaState (sock.m_prevCaState)
+{
+  NS_LOG_FUNCTION (this);
+  m_uv = CreateObject<UniformRandomVariable> ();
+}
+
+void
+TcpBbr::SetStream (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_uv->SetStream (stream);
+}
+
+TcpBbr::BbrMode_t
+TcpBbr::GetBbrState (void) const
+{
+  return m_state;
+}
+
+std::string
+TcpBbr::GetName () const
+{
+  return "TcpBbr";
+}
+
+bool
+TcpBbr::SetsPacingRate (void) const
+{
+  return true;
+}
+
+bool
+TcpBbr::HasCongControl (void) const
+{
+  return true;
+}
+
+void
+TcpBbr::IncreaseWindow (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
+{
+  NS_LOG_FUNCTION (this << tcb << segmentsAcked);
+  // cWnd is set by CongControl
+}
+
+uint32_t
+TcpBbr::GetSsThresh (Ptr<const TcpSocketState> tcb, uint32_t bytesInFlight)
+{
+  NS_LOG_FUNCTION (this << tcb << bytesInFlight);
+  // BBR does not use ssThresh; it only remembers cWnd, to restore it
+  // after the recovery
+  SaveCwnd (tcb);
+  return tcb->m_ssThresh;
+}
+
+void
+TcpBbr::CongestionStateSet (Ptr<TcpSocketState> tcb,
+                            const TcpSocketState::TcpCongState_t newState)
+{
+  NS_LOG_FUNCTION (this << tcb << newState);
+  if (newState == TcpSocketState::CA_LOSS)
+    {
+      // After an RTO, look again for a full pipe, from the next ACK
+      m_prevCaState = TcpSocketState::CA_LOSS;
+      m_fullBw = 0;
+      m_roundStart = true;
+    }
+}
+
+void
+TcpBbr::CongControl (Ptr<TcpSocketState> tcb,
+                     const TcpRateOps::TcpRateConnection &rc,
+                     const TcpRateOps::TcpRateSample &rs)
+{
+  NS_LOG_FUNCTION (this << tcb);
+
+  if (m_pacingGain == 0)
+    {
+      // First ACK: the attributes are set after the constructor
+      EnterStartup ();
+    }
+
+  UpdateBw (rc, rs);
+  UpdateCyclePhase (tcb, rs);
+  CheckFullBwReached (rs);
+  CheckDrain (tcb, rs);
+  UpdateMinRtt (tcb, rc, rs);
+
+  SetPacingRate (tcb, m_pacingGain);
+  SetCwnd (tcb, rc, rs);
+
+  NS_LOG_LOGIC ("State " << m_state << " bw " << GetMaxBw () << " min RTT " << GetMinRtt () <<
+                " pacing rate " << tcb->m_pacingRate << " cWnd " << tcb->m_cWnd);
+}
+
+uint64_t
+TcpBbr::GetMaxBw (void) const
+{
+  return m_maxBwFilter.GetBest ();
+}
+
+Time
+TcpBbr::GetMinRtt (void) const
+{
+  return m_minRttFilter.GetBest ();
+}
+
+uint32_t
+TcpBbr::GetInflight (Ptr<const TcpSocketState> tcb, uint64_t bw, double gain) const
+{
+  uint32_t segmentSize = tcb->m_segmentSize;
+  if (!m_hasSeenRtt)
+    {
+      // No idea of the bandwidth-delay product yet
+      return tcb->m_initialCWnd * segmentSize;
+    }
+
+  double bdp = bw * GetMinRtt ().GetSeconds () / 8;
+  uint32_t inflight = static_cast<uint32_t> (gain * bdp);
+
+  // Leave room for the segments held back by the sender and the delayed
+  // ACKs of the receiver: 3 more segments, rounded up to an even number
+  uint32_t segments = (inflight + segmentSize - 1) / segmentSize + 3;
+  segments += segments % 2;
+  if (m_state == BBR_PROBE_BW && m_cycleIndex == 0)
+    {
+      // Probe for more bandwidth
+      segments += 2;
+    }
+  return segments * segmentSize;
+}
+
+void
+TcpBbr::UpdateBw (const TcpRateOps::TcpRateConnection &rc,
+                  const TcpRateOps::TcpRateSample &rs)
+{
+  m_roundStart = false;
+  if (rs.m_delivered < 0 || rs.m_interval.IsZero ())
+    {
+      return;
+    }
+
+  // A round trip ends when the segment sent at its start is delivered
+  if (rs.m_priorDelivered >= m_nextRoundDelivered)
+    {
+      m_nextRoundDelivered = rc.m_delivered;
+      ++m_roundCount;
+      m_roundStart = true;
+      m_packetConservation = false;
+    }
+
+  // An application limited sample only tells the bandwidth is at least
+  // as high
+  uint64_t bw = rs.m_deliveryRate.GetBitRate ();
+  if (!rs.m_isAppLimited || bw >= GetMaxBw ())
+    {
+      m_maxBwFilter.Update (bw, m_roundCount);
+    }
+}
+
+void
+TcpBbr::UpdateCyclePhase (Ptr<TcpSocketState> tcb, const TcpRateOps::TcpRateSample &rs)
+{
+  if (m_state != BBR_PROBE_BW)
+    {
+      return;
+    }
+
+  bool isFullLength = Simulator::Now () - m_cycleStamp > GetMinRtt ();
+  bool next;
+  if (m_pacingGain > 1)
+    {
+      // Probe until the pipe holds the gain times the BDP
+      next = isFullLength && rs.m_priorInFlight >= GetInflight (tcb, GetMaxBw (), m_pacingGain);
+    }
+  else if (m_pacingGain < 1)
+    {
+      // Drain until the queue made by the probing phase is gone
+      next = isFullLength || rs.m_priorInFlight <= GetInflight (tcb, GetMaxBw (), 1);
+    }
+  else
+    {
+      next = isFullLength;
+    }
+
+  if (next)
+    {
+      AdvanceCyclePhase ();
+    }
+}
+
+void
+TcpBbr::AdvanceCyclePhase (void)
+{
+  m_cycleIndex = (m_cycleIndex + 1) % GAIN_CYCLE_LENGTH;
+  m_cycleStamp = Simulator::Now ();
+  m_pacingGain = PACING_GAIN_CYCLE[m_cycleIndex];
+  NS_LOG_LOGIC ("PROBE_BW phase " << m_cycleIndex << ", pacing gain " << m_pacingGain);
+}
+
+void
+TcpBbr::CheckFullBwReached (const TcpRateOps::TcpRateSample &rs)
+{
+  if (m_fullBwReached || !m_roundStart || rs.m_isAppLimited)
+    {
+      return;
+    }
+
+  uint64_t bw = GetMaxBw ();
+  if (bw * 4 >= m_fullBw * 5)
+    {
+      // Still growing by 25% a round trip
+      m_fullBw = bw;
+      m_fullBwCount = 0;
+      return;
+    }
+  if (++m_fullBwCount >= FULL_BW_COUNT)
+    {
+      NS_LOG_DEBUG ("Pipe full at " << bw << " bit/s");
+      m_fullBwReached = true;
+    }
+}
+
+void
+TcpBbr::CheckDrain (Ptr<TcpSocketState> tcb, const TcpRateOps::TcpRateSample &rs)
+{
+  if (m_state == BBR_STARTUP && m_fullBwReached)
+    {
+      NS_LOG_DEBUG ("STARTUP -> DRAIN");
+      m_state = BBR_DRAIN;
+      m_pacingGain = 1 / m_highGain;
+      m_cWndGain = m_highGain;
+    }
+  if (m_state == BBR_DRAIN && rs.m_bytesInFlight <= GetInflight (tcb, GetMaxBw (), 1))
+    {
+      NS_LOG_DEBUG ("DRAIN -> PROBE_BW");
+      EnterProbeBw ();
+    }
+}
+
+void
+TcpBbr::UpdateMinRtt (Ptr<TcpSocketState> tcb,
+                      const TcpRateOps::TcpRateConnection &rc,
+                      const TcpRateOps::TcpRateSample &rs)
+{
+  Time now = Simulator::Now ();
+  bool expired = m_hasSeenRtt
+    && now > m_minRttStamp + Seconds (MIN_RTT_WINDOW_LENGTH);
+
+  // Only the ACKs giving a new sample count: an old one seen again would
+  // keep the minimum from expiring
+  Time rtt = tcb->m_lastRttSample;
+  if (rtt.IsStrictlyPositive ())
+    {
+      if (!m_hasSeenRtt || rtt <= GetMinRtt () || expired)
+        {
+          m_minRttStamp = now;
+        }
+      m_minRttFilter.Update (rtt, now);
+      m_hasSeenRtt = true;
+    }
+
+  if (m_probeRttDuration.IsStrictlyPositive () && expired && m_state != BBR_PROBE_RTT)
+    {
+      NS_LOG_DEBUG ("Minimum RTT not seen for " << MIN_RTT_WINDOW_LENGTH << "s, enter PROBE_RTT");
+      SaveCwnd (tcb);
+      m_state = BBR_PROBE_RTT;
+      m_pacingGain = 1;
+      m_cWndGain = 1;
+      m_probeRttDoneStamp = Time (0);
+    }
+
+  if (m_state != BBR_PROBE_RTT)
+    {
+      return;
+    }
+
+  if (m_probeRttDoneStamp.IsZero ()
+      && rs.m_bytesInFlight <= m_minPipeCwnd * tcb->m_segmentSize)
+    {
+      // The pipe is drained: stay for the duration, and a round trip
+      m_probeRttDoneStamp = now + m_probeRttDuration;
+      m_probeRttRoundDone = false;
+      m_nextRoundDelivered = rc.m_delivered;
+    }
+  else if (!m_probeRttDoneStamp.IsZero ())
+    {
+      if (m_roundStart)
+        {
+          m_probeRttRoundDone = true;
+        }
+      if (m_probeRttRoundDone && now > m_probeRttDoneStamp)
+        {
+          m_minRttStamp = now;
+          tcb->m_cWnd = std::max (tcb->m_cWnd.Get (), m_priorCwnd);
+          if (m_fullBwReached)
+            {
+              NS_LOG_DEBUG ("PROBE_RTT -> PROBE_BW");
+              EnterProbeBw ();
+            }
+          else
+            {
+              NS_LOG_DEBUG ("PROBE_RTT -> STARTUP");
+              EnterStartup ();
+            }
+        }
+    }
+}
+
+void
+TcpBbr::EnterStartup (void)
+{
+  m_state = BBR_STARTUP;
+  m_pacingGain = m_highGain;
+  m_cWndGain = m_highGain;
+}
+
+void
+TcpBbr::EnterProbeBw (void)
+{
+  m_state = BBR_PROBE_BW;
+  m_pacingGain = 1;
+  m_cWndGain = CWND_GAIN;
+  // Start at a random phase, but not at the draining one
+  m_cycleIndex = GAIN_CYCLE_LENGTH - 1 - m_uv->GetInteger (0, GAIN_CYCLE_LENGTH - 2);
+  AdvanceCyclePhase ();
+}
+
+void
+TcpBbr::SetPacingRate (Ptr<TcpSocketState> tcb, double gain)
+{
+  uint64_t bw = GetMaxBw ();
+  if (bw == 0)
+    {
+      // No sample of the bandwidth yet: pace the initial window over the
+      // RTT, or over 1ms if there is none
+      Time rtt = m_hasSeenRtt ? GetMinRtt () : MilliSeconds (1);
+      tcb->m_pacingRate = DataRate (static_cast<uint64_t> (m_highGain * tcb->m_cWnd * 8
+                                                           / rtt.GetSeconds ()));
+      return;
+    }
+
+  // Pace 1% below the rate, for the queue at the bottleneck to drain
+  DataRate rate (static_cast<uint64_t> (gain * bw * 0.99));
+  if (m_fullBwReached || rate > tcb->m_pacingRate)
+    {
+      tcb->m_pacingRate = rate;
+    }
+}
+
+void
+TcpBbr::SetCwnd (Ptr<TcpSocketState> tcb, const TcpRateOps::TcpRateConnection &rc,
+                 const TcpRateOps::TcpRateSample &rs)
+{
+  uint32_t segmentSize = tcb->m_segmentSize;
+  uint32_t cWnd = tcb->m_cWnd;
+  uint32_t acked = rs.m_ackedSacked;
+
+  if (acked > 0 && !ModulateCwndForRecovery (tcb, rc, rs, &cWnd))
+    {
+      uint32_t target = GetInflight (tcb, GetMaxBw (), m_cWndGain);
+      if (m_fullBwReached)
+        {
+          cWnd = std::min (cWnd + acked, target);
+        }
+      else if (cWnd < target || rc.m_delivered < tcb->m_initialCWnd * segmentSize)
+        {
+          // Grow as slow start does until the pipe is full
+          cWnd += acked;
+        }
+      cWnd = std::max (cWnd, m_minPipeCwnd * segmentSize);
+    }
+
+  if (m_state == BBR_PROBE_RTT)
+    {
+      cWnd = std::min (cWnd, m_minPipeCwnd * segmentSize);
+    }
+
+  tcb->m_cWnd = cWnd;
+}
+
+bool
+TcpBbr::ModulateCwndForRecovery (Ptr<TcpSocketState> tcb,
+                                 const TcpRateOps::TcpRateConnection &rc,
+                                 const TcpRateOps::TcpRateSample &rs,
+                                 uint32_t *newCwnd)
+{
+  TcpSocketState::TcpCongState_t state = tcb->m_congState;
+  uint32_t cWnd = tcb->m_cWnd;
+
+  if (state == TcpSocketState::CA_RECOVERY && m_prevCaState != TcpSocketState::CA_RECOVERY)
+    {
+      // Entering fast recovery: send one segment per segment delivered,
+      // for a round trip
+      m_packetConservation = true;
+      m_nextRoundDelivered = rc.m_delivered;
+      cWnd = rs.m_bytesInFlight + rs.m_ackedSacked;
+    }
+  else if (m_prevCaState >= TcpSocketState::CA_RECOVERY && state < TcpSocketState::CA_RECOVERY)
+    {
+      // Exiting fast recovery or RTO recovery: restore cWnd
+      cWnd = std::max (cWnd, m_priorCwnd);
+      m_packetConservation = false;
+    }
+  m_prevCaState = state;
+
+  if (m_packetConservation)
+    {
+      *newCwnd = std::max (cWnd, rs.m_bytesInFlight + rs.m_ackedSacked);
+      return true;
+    }
+  *newCwnd = cWnd;
+  return false;
+}
+
+void
+TcpBbr::SaveCwnd (Ptr<const TcpSocketState> tcb)
+{
+  if (m_prevCaState < TcpSocketState::CA_RECOVERY && m_state != BBR_PROBE_RTT)
+    {
+      m_priorCwnd = tcb->m_cWnd;
+    }
+  else
+    {
+      // Already reduced: keep the cWnd of before
+      m_priorCwnd = std::max (m_priorCwnd, tcb->m_cWnd.Get ());
+    }
+}
+
+Ptr<TcpCongestionOps>
+TcpBbr::Fork (void)
+{
+  return CopyObject<TcpBbr> (this);
+}
+
+} // namespace ns3
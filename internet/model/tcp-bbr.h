@@ -0,0 +1,283 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCPBBR_H
+#define TCPBBR_H
+
+#include <functional>
+#include "ns3/tcp-congestion-ops.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/windowed-filter.h"
+
+class TcpBbrStateTest;
+
+namespace ns3 {
+
+/**
+ * \ingroup congestionOps
+ *
+ * \brief BBR congestion control algorithm
+ *
+ * BBR (Bottleneck Bandwidth and Round-trip propagation time) does not
+ * react to losses or delay: it builds a model of the path, with the
+ * maximum delivery rate seen over the last round trips (the bottleneck
+ * bandwidth) and the minimum RTT seen over the last seconds (the
+ * propagation delay), and sends at the bandwidth, with about a
+ * bandwidth-delay product in flight.  The model is refreshed in four
+ * states:
+ *
+ * - STARTUP, which doubles the sending rate every round trip, as slow start
+ *   does, until the bandwidth stops growing by 25% for 3 round trips;
+ * - DRAIN, which sends slower for the queue made in STARTUP to drain;
+ * - PROBE_BW, which cycles through 8 phases of a round trip: one sending
+ *   faster, to probe for more bandwidth, one sending slower, to drain the
+ *   queue made, and six at the bandwidth;
+ * - PROBE_RTT, entered if the minimum RTT has not been seen again for 10
+ *   seconds, which keeps 4 segments in flight for 200ms, to measure the
+ *   propagation delay again.
+ *
+ * This follows the version 1 of Linux (net/ipv4/tcp_bbr.c), described in
+ * draft-cardwell-iccrg-bbr-congestion-control.  The delivery rate comes
+ * from the samples of TcpRateOps, given to CongControl, and the maximum
+ * bandwidth and minimum RTT are kept by WindowedFilter, in constant time.
+ * BBR sets the pacing rate, so it turns the pacing of its socket on.
+ */
+class TcpBbr : public TcpCongestionOps
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief States of BBR
+   */
+  typedef enum
+  {
+    BBR_STARTUP,    //!< Ramp up the sending rate rapidly to fill the pipe
+    BBR_DRAIN,      //!< Drain any queue created during startup
+    BBR_PROBE_BW,   //!< Discover, share bandwidth: pace around estimated bandwidth
+    BBR_PROBE_RTT   //!< Cut inflight to min to probe min_rtt
+  } BbrMode_t;
+
+  /**
+   * \brief Constructor
+   */
+  TcpBbr ();
+
+  /**
+   * Copy constructor.
+   * \param sock The socket to copy from.
+   */
+  TcpBbr (const TcpBbr &sock);
+
+  /**
+   * \brief Assign a fixed random variable stream number to the random
+   * variables used by this model
+   *
+   * \param stream first stream index to use
+   */
+  void SetStream (int64_t stream);
+
+  /**
+   * \brief Get the state of BBR
+   * \return the state
+   */
+  BbrMode_t GetBbrState (void) const;
+
+  virtual std::string GetName () const;
+  virtual void IncreaseWindow (Ptr<TcpSocketState> tcb,
+                               uint32_t segmentsAcked);
+  virtual uint32_t GetSsThresh (Ptr<const TcpSocketState> tcb,
+                                uint32_t bytesInFlight);
+  virtual void CongestionStateSet (Ptr<TcpSocketState> tcb,
+                                   const TcpSocketState::TcpCongState_t newState);
+  virtual bool SetsPacingRate (void) const;
+  virtual bool HasCongControl (void) const;
+  virtual void CongControl (Ptr<TcpSocketState> tcb,
+                            const TcpRateOps::TcpRateConnection &rc,
+                            const TcpRateOps::TcpRateSample &rs);
+
+  virtual Ptr<TcpCongestionOps> Fork ();
+
+  /// Maximum filter of the bandwidth, in bit/s, over round trips
+  typedef WindowedFilter<uint64_t, uint32_t, std::greater_equal<uint64_t> > MaxBandwidthFilter_t;
+  /// Minimum filter of the RTT, over time
+  typedef WindowedFilter<Time, Time, std::less_equal<Time> > MinRttFilter_t;
+
+private:
+  /**
+   * \brief TcpBbrStateTest friend class (for tests).
+   * \relates TcpBbrStateTest
+   */
+  friend class ::TcpBbrStateTest;
+
+  /**
+   * \brief Get the bottleneck bandwidth estimate
+   * \return the maximum bandwidth of the window, in bit/s
+   */
+  uint64_t GetMaxBw (void) const;
+
+  /**
+   * \brief Get the propagation delay estimate
+   * \return the minimum RTT of the window, or Time::Max if none yet
+   */
+  Time GetMinRtt (void) const;
+
+  /**
+   * \brief Get the bytes in flight for a rate, given the propagation delay
+   * \param tcb internal congestion state
+   * \param bw the rate, in bit/s
+   * \param gain the gain over the bandwidth-delay product
+   * \return the bytes in flight
+   */
+  uint32_t GetInflight (Ptr<const TcpSocketState> tcb, uint64_t bw, double gain) const;
+
+  /**
+   * \brief Update the bandwidth estimate, and count the round trips
+   * \param rc delivery state of the connection
+   * \param rs delivery rate sample
+   */
+  void UpdateBw (const TcpRateOps::TcpRateConnection &rc,
+                 const TcpRateOps::TcpRateSample &rs);
+
+  /**
+   * \brief Move to the next phase of PROBE_BW, when the time has come
+   * \param tcb internal congestion state
+   * \param rs delivery rate sample
+   */
+  void UpdateCyclePhase (Ptr<TcpSocketState> tcb, const TcpRateOps::TcpRateSample &rs);
+
+  /**
+   * \brief Move to the next phase of PROBE_BW
+   */
+  void AdvanceCyclePhase (void);
+
+  /**
+   * \brief Tell if the bandwidth stopped growing in STARTUP
+   * \param rs delivery rate sample
+   */
+  void CheckFullBwReached (const TcpRateOps::TcpRateSample &rs);
+
+  /**
+   * \brief Move from STARTUP to DRAIN, and from DRAIN to PROBE_BW
+   * \param tcb internal congestion state
+   * \param rs delivery rate sample
+   */
+  void CheckDrain (Ptr<TcpSocketState> tcb, const TcpRateOps::TcpRateSample &rs);
+
+  /**
+   * \brief Update the propagation delay estimate, and go in and out of PROBE_RTT
+   * \param tcb internal congestion state
+   * \param rc delivery state of the connection
+   * \param rs delivery rate sample
+   */
+  void UpdateMinRtt (Ptr<TcpSocketState> tcb,
+                     const TcpRateOps::TcpRateConnection &rc,
+                     const TcpRateOps::TcpRateSample &rs);
+
+  /**
+   * \brief Enter STARTUP
+   */
+  void EnterStartup (void);
+
+  /**
+   * \brief Enter PROBE_BW, at a random phase but the draining one
+   */
+  void EnterProbeBw (void);
+
+  /**
+   * \brief Set the pacing rate, from the bandwidth estimate and a gain
+   * \param tcb internal congestion state
+   * \param gain the gain
+   */
+  void SetPacingRate (Ptr<TcpSocketState> tcb, double gain);
+
+  /**
+   * \brief Set cWnd, from the bandwidth-delay product and the cWnd gain
+   * \param tcb internal congestion state
+   * \param rc delivery state of the connection
+   * \param rs delivery rate sample
+   */
+  void SetCwnd (Ptr<TcpSocketState> tcb, const TcpRateOps::TcpRateConnection &rc,
+                const TcpRateOps::TcpRateSample &rs);
+
+  /**
+   * \brief Keep cWnd to the bytes in flight in fast recovery, and restore
+   * it after
+   * \param tcb internal congestion state
+   * \param rc delivery state of the connection
+   * \param rs delivery rate sample
+   * \param newCwnd the cWnd to set
+   * \return true if the packet conservation of fast recovery sets cWnd
+   */
+  bool ModulateCwndForRecovery (Ptr<TcpSocketState> tcb,
+                                const TcpRateOps::TcpRateConnection &rc,
+                                const TcpRateOps::TcpRateSample &rs,
+                                uint32_t *newCwnd);
+
+  /**
+   * \brief Remember cWnd before fast recovery, RTO or PROBE_RTT
+   * \param tcb internal congestion state
+   */
+  void SaveCwnd (Ptr<const TcpSocketState> tcb);
+
+  // User parameters
+  double   m_highGain;              //!< Gain of STARTUP
+  Time     m_probeRttDuration;      //!< Time spent in PROBE_RTT
+  uint32_t m_minPipeCwnd;           //!< Minimum cWnd, in segments
+  Ptr<UniformRandomVariable> m_uv;  //!< Random phase of PROBE_BW
+
+  // Model
+  BbrMode_t m_state;                //!< State of BBR
+  MaxBandwidthFilter_t m_maxBwFilter; //!< Bottleneck bandwidth estimate
+  MinRttFilter_t m_minRttFilter;    //!< Propagation delay estimate
+  Time     m_minRttStamp;           //!< Last time the minimum RTT was seen again
+  bool     m_hasSeenRtt;            //!< An RTT sample was taken
+
+  // Round trips
+  uint32_t m_roundCount;            //!< Round trips so far
+  uint64_t m_nextRoundDelivered;    //!< Delivered count ending the round trip
+  bool     m_roundStart;            //!< The sample starts a round trip
+
+  // Gains
+  double   m_pacingGain;            //!< Gain of the pacing rate
+  double   m_cWndGain;              //!< Gain of cWnd
+
+  // STARTUP
+  uint64_t m_fullBw;                //!< Bandwidth of the last growth
+  uint32_t m_fullBwCount;           //!< Round trips without growth
+  bool     m_fullBwReached;         //!< The pipe is full
+
+  // PROBE_BW
+  uint32_t m_cycleIndex;            //!< Phase of PROBE_BW
+  Time     m_cycleStamp;            //!< Start of the phase
+
+  // PROBE_RTT
+  Time     m_probeRttDoneStamp;     //!< End of PROBE_RTT, 0 until set
+  bool     m_probeRttRoundDone;     //!< A round trip was done in PROBE_RTT
+
+  // Recovery
+  uint32_t m_priorCwnd;             //!< cWnd before fast recovery, RTO or PROBE_RTT
+  bool     m_packetConservation;    //!< cWnd follows the bytes in flight
+  TcpSocketState::TcpCongState_t m_prevCaState; //!< Congestion state of the last ACK
+};
+
+} // namespace ns3
+#endif // TCPBBR_H
@@ -22,6 +22,7 @@
 #include "ns3/object.h"
 #include "ns3/timer.h"
 #include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-rate-ops.h"
 
 namespace ns3 {
 
@@ -136,11 +137,84 @@ public:
   {
   }
 
+  /**
+   * \brief Tell if the algorithm sets the pacing rate itself
+   *
+   * When it does, a paced socket sends at the rate the algorithm keeps in
+   * TcpSocketState::m_pacingRate, instead of deriving it from cWnd and
+   * the RTT. The default implementation returns false.
+   *
+   * \return true if the algorithm sets tcb->m_pacingRate
+   */
+  virtual bool SetsPacingRate (void) const
+  {
+    return false;
+  }
+
+  /**
+   * \brief Tell if the algorithm controls cWnd with CongControl
+   *
+   * When it does, the socket samples the delivery rate (see TcpRateOps),
+   * calls CongControl after each ACK, and leaves cWnd alone when it enters
+   * fast recovery. The default implementation returns false.
+   *
+   * \return true if the algorithm implements CongControl
+   */
+  virtual bool HasCongControl (void) const
+  {
+    return false;
+  }
+
+  /**
+   * \brief Control cWnd and the pacing rate from a delivery rate sample
+   *
+   * This function mimics the function cong_control in Linux. It is
+   * called once per ACK, after IncreaseWindow and PktsAcked, if
+   * HasCongControl returns true. The default implementation does nothing.
+   *
+   * \param tcb internal congestion state
+   * \param rc delivery state of the connection
+   * \param rs delivery rate sample of the ACK
+   */
+  virtual void CongControl (Ptr<TcpSocketState> tcb,
+                            const TcpRateOps::TcpRateConnection &rc,
+                            const TcpRateOps::TcpRateSample &rs)
+  {
+  }
+
+  /**
+   * \brief Tell if the algorithm relies on ECN
+   *
+   * When it does, the socket negotiates ECN even if its attribute UseEcn
+   * is false, and, as a receiver, echoes the CE mark of each segment with
+   * ECE on its ACK, instead of setting ECE until the sender sends CWR
+   * (RFC 3168). The default implementation returns false.
+   *
+   * \return true if the algorithm needs ECN, with an accurate echo
+   */
+  virtual bool NeedsEcn (void) const
+  {
+    return false;
+  }
+
+  /**
+   * \brief Process an ACK
+   *
+   * This function mimics the function in_ack_event in Linux. It is called
+   * once per ACK, after the ACK was processed (tcb->m_lastAckedSeq is the
+   * new cumulative ACK), and before the reaction to ECE. The default
+   * implementation does nothing.
+   *
+   * \param tcb internal congestion state
+   * \param ece true if the ACK carries an ECN echo, with ECN negotiated
+   */
+  virtual void InAckEvent (Ptr<TcpSocketState> tcb, bool ece)
+  {
+  }
+
   // Present in Linux but not in ns-3 yet:
   /* call when cwnd event occurs (optional) */
   // void (*cwnd_event)(struct sock *sk, enum tcp_ca_event ev);
-  /* call when ack arrives (optional) */
-  // void (*in_ack_event)(struct sock *sk, u32 flags);
   /* new value of cwnd after loss (optional) */
   // u32  (*undo_cwnd)(struct sock *sk);
   /* hook for packet ack accounting (optional) */
@@ -0,0 +1,509 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <algorithm>
+#include "tcp-cubic.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/tcp-socket-base.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpCubic");
+NS_OBJECT_ENSURE_REGISTERED (TcpCubic);
+
+/// Scale of Beta (as in Linux)
+static const uint32_t BICTCP_BETA_SCALE = 1024;
+/// The time of the cubic function is counted in 2^BICTCP_HZ of a second
+static const uint32_t BICTCP_HZ = 10;
+/// Shortest interval, in microseconds, between two evaluations of the cubic
+/// function with the same cWnd (1/32 seconds, as in Linux)
+static const int64_t UPDATE_INTERVAL_US = 31250;
+
+TypeId
+TcpCubic::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpCubic")
+    .SetParent<TcpCongestionOps> ()
+    .AddConstructor<TcpCubic> ()
+    .SetGroupName ("Internet")
+    .AddAttribute ("FastConvergence", "Turn on/off fast convergence.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&TcpCubic::m_fastConvergence),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TcpFriendliness", "Turn on/off the TCP friendly region.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&TcpCubic::m_tcpFriendliness),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Beta", "Beta for multiplicative decrease",
+                   DoubleValue (0.7),
+                   MakeDoubleAccessor (&TcpCubic::m_beta),
+                   MakeDoubleChecker <double> (0.0, 0.99))
+    .AddAttribute ("C", "Cubic scaling factor",
+                   DoubleValue (0.4),
+                   MakeDoubleAccessor (&TcpCubic::m_c),
+                   MakeDoubleChecker <double> (0.001))
+    .AddAttribute ("HyStart", "Enable (true) or disable (false) hybrid slow start",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&TcpCubic::m_hystart),
+                   MakeBooleanChecker ())
+    .AddAttribute ("HyStartDetect", "Hybrid slow start detection mechanisms",
+                   EnumValue (BOTH),
+                   MakeEnumAccessor (&TcpCubic::m_hystartDetect),
+                   MakeEnumChecker (PACKET_TRAIN, "PacketTrain",
+                                    DELAY, "Delay",
+                                    BOTH, "Both"))
+    .AddAttribute ("HyStartLowWindow", "Lowest cWnd, in segments, for hybrid slow start",
+                   UintegerValue (16),
+                   MakeUintegerAccessor (&TcpCubic::m_hystartLowWindow),
+                   MakeUintegerChecker <uint32_t> ())
+    .AddAttribute ("HyStartMinSamples", "RTT samples of a round for the delay detection",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&TcpCubic::m_hystartMinSamples),
+                   MakeUintegerChecker <uint32_t> (1))
+    .AddAttribute ("HyStartAckDelta", "Largest spacing of the ACKs of a train",
+                   TimeValue (MilliSeconds (2)),
+                   MakeTimeAccessor (&TcpCubic::m_hystartAckDelta),
+                   MakeTimeChecker ())
+    .AddAttribute ("HyStartDelayMin", "Minimum RTT increase for the delay detection",
+                   TimeValue (MilliSeconds (4)),
+                   MakeTimeAccessor (&TcpCubic::m_hystartDelayMin),
+                   MakeTimeChecker ())
+    .AddAttribute ("HyStartDelayMax", "Maximum RTT increase for the delay detection",
+                   TimeValue (MilliSeconds (16)),
+                   MakeTimeAccessor (&TcpCubic::m_hystartDelayMax),
+                   MakeTimeChecker ())
+    .AddAttribute ("CntClamp", "ACKs for an increase of cWnd while the last "
+                   "maximum is unknown (20 for 5% per RTT)",
+                   UintegerValue (20),
+                   MakeUintegerAccessor (&TcpCubic::m_cntClamp),
+                   MakeUintegerChecker <uint8_t> (2))
+  ;
+  return tid;
+}
+
+TcpCubic::TcpCubic ()
+  : TcpCongestionOps (),
+    m_cnt (0),
+    m_cWndCnt (0),
+    m_lastMaxCwnd (0),
+    m_lastCwnd (0),
+    m_lastTime (Time (0)),
+    m_bicOriginPoint (0),
+    m_bicK (0),
+    m_delayMin (Time (0)),
+    m_epochStart (Time::Min ()),
+    m_ackCnt (0),
+    m_tcpCwnd (0),
+    m_cubeFactor (0),
+    m_cubeRttScale (0),
+    m_betaScale (0),
+    m_found (0),
+    m_roundStart (Time (0)),
+    m_lastAck (Time (0)),
+    m_endSeq (0),
+    m_currRtt (Time (0)),
+    m_sampleCnt (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpCubic::TcpCubic (const TcpCubic &sock)
+  : TcpCongestionOps (sock),
+    m_fastConvergence (sock.m_fastConvergence),
+    m_tcpFriendliness (sock.m_tcpFriendliness),
+    m_beta (sock.m_beta),
+    m_c (sock.m_c),
+    m_hystart (sock.m_hystart),
+    m_hystartDetect (sock.m_hystartDetect),
+    m_hystartLowWindow (sock.m_hystartLowWindow),
+    m_hystartMinSamples (sock.m_hystartMinSamples),
+    m_hystartAckDelta (sock.m_hystartAckDelta),
+    m_hystartDelayMin (sock.m_hystartDelayMin),
+    m_hystartDelayMax (sock.m_hystartDelayMax),
+    m_cntClamp (sock.m_cntClamp),
+    m_cnt (sock.m_cnt),
+    m_cWndCnt (sock.m_cWndCnt),
+    m_lastMaxCwnd (sock.m_lastMaxCwnd),
+    m_lastCwnd (sock.m_lastCwnd),
+    m_lastTime (sock.m_lastTime),
+    m_bicOriginPoint (sock.m_bicOriginPoint),
+    m_bicK (sock.m_bicK),
+    m_delayMin (sock.m_delayMin),
+    m_epochStart (sock.m_epochStart),
+    m_ackCnt (sock.m_ackCnt),
+    m_tcpCwnd (sock.m_tcpCwnd),
+    m_cubeFactor (sock.m_cubeFactor),
+    m_cubeRttScale (sock.m_cubeRttScale),
+    m_betaScale (sock.m_betaScale),
+    m_found (sock.m_found),
+    m_roundStart (sock.m_roundStart),
+    m_lastAck (sock.m_lastAck),
+    m_endSeq (sock.m_endSeq),
+    m_currRtt (sock.m_currRtt),
+    m_sampleCnt (sock.m_sampleCnt)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+std::string
+TcpCubic::GetName () const
+{
+  return "TcpCubic";
+}
+
+uint32_t
+TcpCubic::CubicRoot (uint64_t a)
+{
+  // Cube roots of the 6 most significant bits, times 64 (from Linux)
+  static const uint8_t v[] = {
+    /* 0x00 */    0,   54,   54,   54,  118,  118,  118,  118,
+    /* 0x08 */  123,  129,  134,  138,  143,  147,  151,  156,
+    /* 0x10 */  157,  161,  164,  168,  170,  173,  176,  179,
+    /* 0x18 */  181,  185,  187,  190,  192,  194,  197,  199,
+    /* 0x20 */  200,  202,  204,  206,  209,  211,  213,  215,
+    /* 0x28 */  217,  219,  221,  222,  224,  225,  227,  229,
+    /* 0x30 */  231,  232,  234,  236,  237,  239,  240,  242,
+    /* 0x38 */  244,  245,  246,  248,  250,  251,  252,  254,
+  };
+
+  // Position of the most significant bit, from 1
+  uint32_t b = 0;
+  for (uint64_t x = a; x != 0; x >>= 1)
+    {
+      ++b;
+    }
+
+  if (b < 7)
+    {
+      // a in [0..63]
+      return (static_cast<uint32_t> (v[a]) + 35) >> 6;
+    }
+
+  // Keep the 6 most significant bits, at a multiple of 3 bits
+  b = ((b * 84) >> 8) - 1;
+  uint32_t shift = static_cast<uint32_t> (a >> (b * 3));
+  uint32_t x = ((static_cast<uint32_t> (v[shift]) + 10) << b) >> 6;
+
+  // One Newton-Raphson iteration: x = (2 x + a / x^2) / 3
+  x = 2 * x + static_cast<uint32_t> (a / (static_cast<uint64_t> (x) * (x - 1)));
+  x = (x * 341) >> 10;
+  return x;
+}
+
+void
+TcpCubic::PktsAcked (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked,
+                     const Time &rtt)
+{
+  NS_LOG_FUNCTION (this << tcb << segmentsAcked << rtt);
+
+  if (rtt.IsZero ())
+    {
+      return;
+    }
+
+  // Discard the delay samples right after a congestion event
+  if (m_epochStart != Time::Min ()
+      && Simulator::Now () - m_epochStart < Seconds (1))
+    {
+      return;
+    }
+
+  if (m_delayMin.IsZero () || m_delayMin > rtt)
+    {
+      m_delayMin = rtt;
+    }
+
+  if (m_hystart && tcb->m_cWnd < tcb->m_ssThresh
+      && tcb->GetCwndInSegments () >= m_hystartLowWindow)
+    {
+      HystartUpdate (tcb, rtt);
+    }
+}
+
+void
+TcpCubic::IncreaseWindow (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
+{
+  NS_LOG_FUNCTION (this << tcb << segmentsAcked);
+
+  if (tcb->m_cWnd < tcb->m_ssThresh)
+    {
+      if (m_hystart && tcb->m_lastAckedSeq > m_endSeq)
+        {
+          HystartReset (tcb);
+        }
+
+      // Grow by the segments ACKed, up to ssThresh; the rest goes to
+      // congestion avoidance
+      uint32_t increase = std::min (segmentsAcked,
+                                    tcb->GetSsThreshInSegments () - tcb->GetCwndInSegments ());
+      tcb->m_cWnd += increase * tcb->m_segmentSize;
+      segmentsAcked -= increase;
+
+      NS_LOG_INFO ("In SlowStart, updated to cwnd " << tcb->m_cWnd <<
+                   " ssthresh " << tcb->m_ssThresh);
+    }
+
+  if (segmentsAcked > 0)
+    {
+      Update (tcb, segmentsAcked);
+
+      // One segment every m_cnt segments ACKed
+      if (m_cWndCnt >= m_cnt)
+        {
+          m_cWndCnt = 0;
+          tcb->m_cWnd += tcb->m_segmentSize;
+        }
+      m_cWndCnt += segmentsAcked;
+      if (m_cWndCnt >= m_cnt)
+        {
+          uint32_t delta = m_cWndCnt / m_cnt;
+          m_cWndCnt -= delta * m_cnt;
+          tcb->m_cWnd += delta * tcb->m_segmentSize;
+        }
+
+      NS_LOG_INFO ("In CongAvoid, cnt " << m_cnt << ", updated to cwnd " << tcb->m_cWnd);
+    }
+}
+
+void
+TcpCubic::Update (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked)
+{
+  NS_LOG_FUNCTION (this << tcb << segmentsAcked);
+
+  uint32_t segCwnd = std::max (tcb->GetCwndInSegments (), 1U);
+  Time now = Simulator::Now ();
+
+  m_ackCnt += segmentsAcked;
+
+  if (m_lastCwnd == segCwnd && (now - m_lastTime).GetMicroSeconds () <= UPDATE_INTERVAL_US)
+    {
+      return;
+    }
+
+  m_lastCwnd = segCwnd;
+  m_lastTime = now;
+
+  if (m_epochStart == Time::Min ())
+    {
+      // Start of an epoch: the only place where the parameters are scaled,
+      // and where a cube root is taken
+      m_epochStart = now;
+      m_ackCnt = segmentsAcked;
+      m_tcpCwnd = segCwnd;
+
+      m_cubeRttScale = std::max<uint32_t> (m_c * 1024 + 0.5, 1);
+      m_cubeFactor = (1ULL << (10 + 3 * BICTCP_HZ)) / m_cubeRttScale;
+      uint32_t beta = m_beta * BICTCP_BETA_SCALE;
+      m_betaScale = 8 * (BICTCP_BETA_SCALE + beta) / 3 / (BICTCP_BETA_SCALE - beta);
+
+      if (m_lastMaxCwnd <= segCwnd)
+        {
+          m_bicK = 0;
+          m_bicOriginPoint = segCwnd;
+        }
+      else
+        {
+          // K = cbrt ((W_max - cWnd) / C), in 1/1024 seconds
+          m_bicK = CubicRoot (m_cubeFactor * (m_lastMaxCwnd - segCwnd));
+          m_bicOriginPoint = m_lastMaxCwnd;
+        }
+      NS_LOG_DEBUG ("Epoch start, K " << m_bicK << " origin " << m_bicOriginPoint);
+    }
+
+  // The window of the cubic function one RTT ahead, with t in 1/1024 seconds
+  uint64_t t = static_cast<uint64_t> ((now - m_epochStart + m_delayMin).GetMicroSeconds ());
+  t = (t << BICTCP_HZ) / 1000000;
+
+  uint64_t offs = (t < m_bicK) ? m_bicK - t : t - m_bicK;
+  uint32_t delta = static_cast<uint32_t> ((m_cubeRttScale * offs * offs * offs)
+                                          >> (10 + 3 * BICTCP_HZ));
+  uint32_t bicTarget = (t < m_bicK) ? m_bicOriginPoint - delta : m_bicOriginPoint + delta;
+
+  if (bicTarget > segCwnd)
+    {
+      m_cnt = segCwnd / (bicTarget - segCwnd);
+    }
+  else
+    {
+      // Very small increment
+      m_cnt = 100 * segCwnd;
+    }
+
+  // The growth of the cubic function may be too conservative when the
+  // bandwidth is still unknown
+  if (m_lastMaxCwnd == 0 && m_cnt > m_cntClamp)
+    {
+      m_cnt = m_cntClamp;
+    }
+
+  if (m_tcpFriendliness)
+    {
+      // Reno grows by 3 (1 - Beta) / (1 + Beta) segments per RTT, to have
+      // the same average window with the reduction of CUBIC
+      uint32_t renoDelta = std::max ((segCwnd * m_betaScale) >> 3, 1U);
+      while (m_ackCnt > renoDelta)
+        {
+          m_ackCnt -= renoDelta;
+          ++m_tcpCwnd;
+        }
+
+      if (m_tcpCwnd > segCwnd)
+        {
+          // CUBIC is slower than Reno
+          uint32_t maxCnt = segCwnd / (m_tcpCwnd - segCwnd);
+          m_cnt = std::min (m_cnt, maxCnt);
+        }
+    }
+
+  // At most 1 segment every 2 segments ACKed, 1.5x per RTT
+  m_cnt = std::max (m_cnt, 2U);
+  NS_LOG_LOGIC ("t " << t << " target " << bicTarget << " cnt " << m_cnt);
+}
+
+void
+TcpCubic::HystartReset (Ptr<const TcpSocketState> tcb)
+{
+  NS_LOG_FUNCTION (this << tcb);
+
+  m_roundStart = m_lastAck = Simulator::Now ();
+  m_endSeq = tcb->m_highTxMark;
+  m_currRtt = Time (0);
+  m_sampleCnt = 0;
+}
+
+void
+TcpCubic::HystartUpdate (Ptr<TcpSocketState> tcb, const Time &delay)
+{
+  NS_LOG_FUNCTION (this << tcb << delay);
+
+  if (m_found & m_hystartDetect)
+    {
+      return;
+    }
+
+  if (m_hystartDetect & PACKET_TRAIN)
+    {
+      // The ACKs of a train arrive at the bottleneck rate: once the train
+      // lasts half of the minimum RTT, the pipe is full
+      Time now = Simulator::Now ();
+      if (now - m_lastAck <= m_hystartAckDelta)
+        {
+          m_lastAck = now;
+          if ((now - m_roundStart) * 2 > m_delayMin)
+            {
+              NS_LOG_DEBUG ("HyStart: ACK train of " << now - m_roundStart <<
+                            ", exit slow start at cwnd " << tcb->m_cWnd);
+              m_found |= PACKET_TRAIN;
+              tcb->m_ssThresh = tcb->m_cWnd;
+            }
+        }
+    }
+
+  if (m_hystartDetect & DELAY)
+    {
+      // The minimum delay of the first samples of the round
+      if (m_sampleCnt < m_hystartMinSamples)
+        {
+          if (m_currRtt.IsZero () || m_currRtt > delay)
+            {
+              m_currRtt = delay;
+            }
+          ++m_sampleCnt;
+        }
+      else
+        {
+          Time thresh = TimeStep (m_delayMin.GetTimeStep () / 8);
+          thresh = std::min (std::max (thresh, m_hystartDelayMin), m_hystartDelayMax);
+          if (m_currRtt > m_delayMin + thresh)
+            {
+              NS_LOG_DEBUG ("HyStart: RTT " << m_currRtt << " over " << m_delayMin <<
+                            ", exit slow start at cwnd " << tcb->m_cWnd);
+              m_found |= DELAY;
+              tcb->m_ssThresh = tcb->m_cWnd;
+            }
+        }
+    }
+}
+
+void
+TcpCubic::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_cnt = 0;
+  m_lastMaxCwnd = 0;
+  m_lastCwnd = 0;
+  m_lastTime = Time (0);
+  m_bicOriginPoint = 0;
+  m_bicK = 0;
+  m_delayMin = Time (0);
+  m_epochStart = Time::Min ();
+  m_ackCnt = 0;
+  m_tcpCwnd = 0;
+  m_found = 0;
+}
+
+uint32_t
+TcpCubic::GetSsThresh (Ptr<const TcpSocketState> tcb, uint32_t bytesInFlight)
+{
+  NS_LOG_FUNCTION (this << tcb << bytesInFlight);
+
+  uint32_t segCwnd = tcb->GetCwndInSegments ();
+  uint32_t beta = m_beta * BICTCP_BETA_SCALE;
+
+  m_epochStart = Time::Min ();
+
+  // W_max and fast convergence
+  if (segCwnd < m_lastMaxCwnd && m_fastConvergence)
+    {
+      m_lastMaxCwnd = (segCwnd * (BICTCP_BETA_SCALE + beta)) / (2 * BICTCP_BETA_SCALE);
+      NS_LOG_INFO ("Fast Convergence. Last max cwnd updated to " << m_lastMaxCwnd);
+    }
+  else
+    {
+      m_lastMaxCwnd = segCwnd;
+      NS_LOG_INFO ("Last max cwnd updated to " << m_lastMaxCwnd);
+    }
+
+  return std::max ((segCwnd * beta) / BICTCP_BETA_SCALE, 2U) * tcb->m_segmentSize;
+}
+
+void
+TcpCubic::CongestionStateSet (Ptr<TcpSocketState> tcb,
+                              const TcpSocketState::TcpCongState_t newState)
+{
+  NS_LOG_FUNCTION (this << tcb << newState);
+
+  if (newState == TcpSocketState::CA_LOSS)
+    {
+      // After an RTO, start again from scratch
+      Reset ();
+      HystartReset (tcb);
+    }
+}
+
+Ptr<TcpCongestionOps>
+TcpCubic::Fork (void)
+{
+  return CopyObject<TcpCubic> (this);
+}
+
+} // namespace ns3
@@ -0,0 +1,202 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCPCUBIC_H
+#define TCPCUBIC_H
+
+#include "ns3/tcp-congestion-ops.h"
+
+class TcpCubicIncrementTest;
+class TcpCubicDecrementTest;
+class TcpCubicHyStartTest;
+
+namespace ns3 {
+
+/**
+ * \ingroup congestionOps
+ *
+ * \brief CUBIC congestion control algorithm
+ *
+ * CUBIC grows the window as a cubic function of the time since the last
+ * congestion event, W(t) = C (t - K)^3 + W_max, where W_max is the window
+ * before the event and K the time the function takes to get back to it.
+ * The window grows fast when far from W_max, flattens around it, and
+ * probes for more bandwidth beyond it; the growth does not depend on the
+ * RTT.  Below the window that Reno would have, CUBIC follows Reno (the TCP
+ * friendly region).  After a congestion event, the window is reduced by the
+ * Beta factor; with fast convergence, a flow whose W_max shrinks releases
+ * bandwidth to the new flows by remembering a lower W_max.
+ *
+ * As in Linux (net/ipv4/tcp_cubic.c), the window is computed with integer
+ * arithmetic only: the time is counted in 1/1024 seconds, and K, the cube
+ * root of (W_max - cWnd) / C, is taken once per congestion event from a
+ * table of 64 entries refined by one Newton-Raphson iteration (less than
+ * 0.2% of error), instead of pow or cbrt.  The cubic function itself is
+ * evaluated at most once every 1/32 seconds when cWnd does not change.
+ *
+ * Slow start is left early by HyStart (hybrid slow start), which sets
+ * ssThresh to cWnd when it detects, once cWnd reaches HyStartLowWindow
+ * segments:
+ *
+ * - an ACK train: ACKs spaced by less than HyStartAckDelta arrived for half
+ *   of the minimum RTT since the start of the round, so the pipe is full;
+ * - a delay increase: the minimum of the first HyStartMinSamples RTT samples
+ *   of the round exceeds the minimum RTT of the connection by a threshold
+ *   (1/8 of it, between HyStartDelayMin and HyStartDelayMax), so a queue
+ *   builds up.
+ *
+ * References: RFC 8312, and S. Ha, I. Rhee, "Taming the elephants: New TCP
+ * slow start", Computer Networks 55(9), 2011.
+ */
+class TcpCubic : public TcpCongestionOps
+{
+public:
+  /**
+   * \brief Values to detect the exit of slow start of HyStart
+   */
+  enum HybridSSDetectionMode
+  {
+    PACKET_TRAIN = 1, //!< Detection by ACK train
+    DELAY        = 2, //!< Detection by delay increase
+    BOTH         = 3  //!< Both
+  };
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  TcpCubic ();
+
+  /**
+   * Copy constructor.
+   * \param sock The socket to copy from.
+   */
+  TcpCubic (const TcpCubic &sock);
+
+  virtual std::string GetName () const;
+  virtual void PktsAcked (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked,
+                          const Time &rtt);
+  virtual void IncreaseWindow (Ptr<TcpSocketState> tcb,
+                               uint32_t segmentsAcked);
+  virtual uint32_t GetSsThresh (Ptr<const TcpSocketState> tcb,
+                                uint32_t bytesInFlight);
+  virtual void CongestionStateSet (Ptr<TcpSocketState> tcb,
+                                   const TcpSocketState::TcpCongState_t newState);
+
+  virtual Ptr<TcpCongestionOps> Fork ();
+
+  /**
+   * \brief Integer cube root, as in Linux
+   *
+   * A table gives the 6 most significant bits of the root, and a
+   * Newton-Raphson iteration refines them.
+   *
+   * \param a the value
+   * \return the cube root of a, rounded
+   */
+  static uint32_t CubicRoot (uint64_t a);
+
+private:
+  /**
+   * \brief TcpCubicIncrementTest friend class (for tests).
+   * \relates TcpCubicIncrementTest
+   */
+  friend class ::TcpCubicIncrementTest;
+  /**
+   * \brief TcpCubicDecrementTest friend class (for tests).
+   * \relates TcpCubicDecrementTest
+   */
+  friend class ::TcpCubicDecrementTest;
+  /**
+   * \brief TcpCubicHyStartTest friend class (for tests).
+   * \relates TcpCubicHyStartTest
+   */
+  friend class ::TcpCubicHyStartTest;
+
+  /**
+   * \brief Compute the number of segments to ACK before increasing cWnd
+   * by one segment
+   * \param tcb internal congestion state
+   * \param segmentsAcked segments ACKed
+   */
+  void Update (Ptr<TcpSocketState> tcb, uint32_t segmentsAcked);
+
+  /**
+   * \brief Forget the congestion epoch and the minimum delay
+   */
+  void Reset (void);
+
+  /**
+   * \brief Start a new round of HyStart
+   * \param tcb internal congestion state
+   */
+  void HystartReset (Ptr<const TcpSocketState> tcb);
+
+  /**
+   * \brief Look for the exit of slow start
+   * \param tcb internal congestion state
+   * \param delay the RTT sample
+   */
+  void HystartUpdate (Ptr<TcpSocketState> tcb, const Time &delay);
+
+  // User parameters
+  bool     m_fastConvergence;     //!< Enable or disable fast convergence
+  bool     m_tcpFriendliness;     //!< Enable or disable the TCP friendly region
+  double   m_beta;                //!< Multiplicative decrease factor
+  double   m_c;                   //!< Cubic scaling factor
+
+  bool     m_hystart;             //!< Enable or disable HyStart
+  HybridSSDetectionMode m_hystartDetect; //!< Detection modes of HyStart
+  uint32_t m_hystartLowWindow;    //!< Lowest cWnd, in segments, for HyStart
+  uint32_t m_hystartMinSamples;   //!< RTT samples of a round for the delay detection
+  Time     m_hystartAckDelta;     //!< Spacing of the ACKs of a train
+  Time     m_hystartDelayMin;     //!< Minimum delay increase
+  Time     m_hystartDelayMax;     //!< Maximum delay increase
+  uint8_t  m_cntClamp;            //!< ACKs per increase while W_max is unknown
+
+  // Cubic parameters
+  uint32_t m_cnt;                 //!< Segments to ACK before increasing cWnd by one
+  uint32_t m_cWndCnt;             //!< Segments ACKed since the last increase
+  uint32_t m_lastMaxCwnd;         //!< W_max, in segments
+  uint32_t m_lastCwnd;            //!< cWnd, in segments, of the last update
+  Time     m_lastTime;            //!< Time of the last update
+  uint32_t m_bicOriginPoint;      //!< Origin point of the cubic function, in segments
+  uint32_t m_bicK;                //!< K, in 1/1024 seconds
+  Time     m_delayMin;            //!< Minimum RTT, 0 if unknown
+  Time     m_epochStart;          //!< Start of the epoch, Time::Min if none
+  uint32_t m_ackCnt;              //!< Segments ACKed in the epoch, for the TCP friendly window
+  uint32_t m_tcpCwnd;             //!< Window of Reno, in segments
+  uint64_t m_cubeFactor;          //!< 2^40 / (C * 1024), for K
+  uint32_t m_cubeRttScale;        //!< C * 1024
+  uint32_t m_betaScale;           //!< 8 (1 + Beta) / 3 / (1 - Beta), for the Reno window
+
+  // HyStart
+  uint8_t  m_found;               //!< Detection modes of HyStart that triggered
+  Time     m_roundStart;          //!< Start of the round
+  Time     m_lastAck;             //!< Time of the last ACK of the train
+  SequenceNumber32 m_endSeq;      //!< Sequence number ending the round
+  Time     m_currRtt;             //!< Minimum RTT sample of the round
+  uint32_t m_sampleCnt;           //!< RTT samples of the round
+};
+
+} // namespace ns3
+#endif // TCPCUBIC_H
@@ -0,0 +1,180 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#include <algorithm>
+#include "tcp-dctcp.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/tcp-socket-base.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpDctcp");
+NS_OBJECT_ENSURE_REGISTERED (TcpDctcp);
+
+TypeId
+TcpDctcp::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpDctcp")
+    .SetParent<TcpNewReno> ()
+    .AddConstructor<TcpDctcp> ()
+    .SetGroupName ("Internet")
+    .AddAttribute ("DctcpShiftG",
+                   "Weight of the fraction of marked bytes of a window in alpha",
+                   DoubleValue (0.0625),
+                   MakeDoubleAccessor (&TcpDctcp::m_g),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("DctcpAlphaOnInit",
+                   "Initial value of alpha",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&TcpDctcp::m_alphaOnInit),
+                   MakeDoubleChecker<double> (0, 1))
+  ;
+  return tid;
+}
+
+TcpDctcp::TcpDctcp ()
+  : TcpNewReno (),
+    m_g (0.0625),
+    m_alphaOnInit (1.0),
+    m_alpha (1.0),
+    m_initialized (false),
+    m_ackedBytesEcn (0),
+    m_ackedBytesTotal (0),
+    m_priorSndUna (0),
+    m_nextSeq (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpDctcp::TcpDctcp (const TcpDctcp &sock)
+  : TcpNewReno (sock),
+    m_g (sock.m_g),
+    m_alphaOnInit (sock.m_alphaOnInit),
+    m_alpha (sock.m_alpha),
+    m_initialized (sock.m_initialized),
+    m_ackedBytesEcn (sock.m_ackedBytesEcn),
+    m_ackedBytesTotal (sock.m_ackedBytesTotal),
+    m_priorSndUna (sock.m_priorSndUna),
+    m_nextSeq (sock.m_nextSeq)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpDctcp::~TcpDctcp ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+std::string
+TcpDctcp::GetName () const
+{
+  return "TcpDctcp";
+}
+
+Ptr<TcpCongestionOps>
+TcpDctcp::Fork (void)
+{
+  return CopyObject<TcpDctcp> (this);
+}
+
+bool
+TcpDctcp::NeedsEcn (void) const
+{
+  return true;
+}
+
+void
+TcpDctcp::Init (Ptr<const TcpSocketState> tcb)
+{
+  NS_LOG_FUNCTION (this << tcb);
+
+  // The attributes are set after the constructor
+  m_alpha = m_alphaOnInit;
+  m_priorSndUna = tcb->m_lastAckedSeq;
+  m_nextSeq = tcb->m_highTxMark;
+  m_initialized = true;
+}
+
+void
+TcpDctcp::InAckEvent (Ptr<TcpSocketState> tcb, bool ece)
+{
+  NS_LOG_FUNCTION (this << tcb << ece);
+
+  if (!m_initialized)
+    {
+      Init (tcb);
+      return;
+    }
+
+  uint32_t ackedBytes = 0;
+  if (tcb->m_lastAckedSeq > m_priorSndUna)
+    {
+      ackedBytes = tcb->m_lastAckedSeq - m_priorSndUna;
+      m_priorSndUna = tcb->m_lastAckedSeq;
+    }
+  else
+    { // A duplicate ACK stands for a segment received, as in Linux
+      ackedBytes = tcb->m_segmentSize;
+    }
+
+  m_ackedBytesTotal += ackedBytes;
+  if (ece)
+    {
+      m_ackedBytesEcn += ackedBytes;
+    }
+
+  // The data sent when the observation window started is ACKed: the
+  // window ends, and a new one starts with the data sent since then
+  if (tcb->m_lastAckedSeq >= m_nextSeq)
+    {
+      double fraction = 0.0;
+      if (m_ackedBytesTotal > 0)
+        {
+          fraction = static_cast<double> (m_ackedBytesEcn) / m_ackedBytesTotal;
+        }
+      m_alpha = (1.0 - m_g) * m_alpha + m_g * fraction;
+
+      NS_LOG_INFO (m_ackedBytesEcn << " of " << m_ackedBytesTotal <<
+                   " bytes marked, alpha " << m_alpha);
+
+      m_ackedBytesEcn = 0;
+      m_ackedBytesTotal = 0;
+      m_nextSeq = tcb->m_highTxMark;
+    }
+}
+
+uint32_t
+TcpDctcp::GetSsThresh (Ptr<const TcpSocketState> tcb,
+                       uint32_t bytesInFlight)
+{
+  NS_LOG_FUNCTION (this << tcb << bytesInFlight);
+
+  if (tcb->m_congState != TcpSocketState::CA_CWR)
+    { // A loss (RFC 8257, Section 3.5)
+      return TcpNewReno::GetSsThresh (tcb, bytesInFlight);
+    }
+
+  if (!m_initialized)
+    {
+      Init (tcb);
+    }
+
+  uint32_t ssThresh = static_cast<uint32_t> (tcb->m_cWnd.Get () * (1.0 - m_alpha / 2.0));
+  return std::max (ssThresh, 2 * tcb->m_segmentSize);
+}
+
+} // namespace ns3
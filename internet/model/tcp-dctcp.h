@@ -0,0 +1,115 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef TCPDCTCP_H
+#define TCPDCTCP_H
+
+#include "ns3/tcp-congestion-ops.h"
+
+class TcpDctcpAlphaTest;
+class TcpDctcpSsThreshTest;
+
+namespace ns3 {
+
+/**
+ * \ingroup congestionOps
+ *
+ * \brief DCTCP (Data Center TCP) congestion control algorithm
+ *
+ * DCTCP relies on ECN, with switches that mark CE the packets that find
+ * more than K packets in their queue.  The receiver echoes the mark of each
+ * segment on its ACK (see TcpCongestionOps::NeedsEcn), and the sender
+ * estimates the fraction F of the bytes marked in each window of data, the
+ * observation window, which lasts about one RTT.  The estimate is smoothed
+ * as
+ *
+ *     alpha = (1 - g) * alpha + g * F
+ *
+ * and, at most once per window, an ECN echo reduces the window in
+ * proportion to the extent of the congestion:
+ *
+ *     cWnd = cWnd * (1 - alpha / 2)
+ *
+ * instead of halving it. With a small K, the queues stay short and the
+ * throughput high. The window grows, and a loss is handled, as in NewReno.
+ *
+ * DCTCP must run at both ends of the connection, and only in a network
+ * where the routers mark the packets this way.
+ *
+ * References: RFC 8257, and M. Alizadeh et al., "Data Center TCP (DCTCP)",
+ * SIGCOMM 2010; net/ipv4/tcp_dctcp.c in Linux.
+ */
+class TcpDctcp : public TcpNewReno
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   */
+  TcpDctcp ();
+
+  /**
+   * Copy constructor.
+   * \param sock The socket to copy from.
+   */
+  TcpDctcp (const TcpDctcp &sock);
+
+  virtual ~TcpDctcp ();
+
+  virtual std::string GetName () const;
+  virtual uint32_t GetSsThresh (Ptr<const TcpSocketState> tcb,
+                                uint32_t bytesInFlight);
+  virtual bool NeedsEcn (void) const;
+  virtual void InAckEvent (Ptr<TcpSocketState> tcb, bool ece);
+
+  virtual Ptr<TcpCongestionOps> Fork ();
+
+private:
+  /**
+   * \brief TcpDctcpAlphaTest friend class (for tests).
+   * \relates TcpDctcpAlphaTest
+   */
+  friend class ::TcpDctcpAlphaTest;
+  /**
+   * \brief TcpDctcpSsThreshTest friend class (for tests).
+   * \relates TcpDctcpSsThreshTest
+   */
+  friend class ::TcpDctcpSsThreshTest;
+
+  /**
+   * \brief Start the first observation window, with alpha at its initial value
+   * \param tcb internal congestion state
+   */
+  void Init (Ptr<const TcpSocketState> tcb);
+
+  double   m_g;               //!< Weight of a new fraction of marked bytes in alpha
+  double   m_alphaOnInit;     //!< Initial value of alpha
+  double   m_alpha;           //!< Estimate of the fraction of marked bytes
+  bool     m_initialized;     //!< The first observation window started
+  uint32_t m_ackedBytesEcn;   //!< Bytes ACKed with ECE in the observation window
+  uint32_t m_ackedBytesTotal; //!< Bytes ACKed in the observation window
+  SequenceNumber32 m_priorSndUna; //!< Cumulative ACK of the last ACK
+  SequenceNumber32 m_nextSeq;     //!< Sequence number ending the observation window
+};
+
+} // namespace ns3
+#endif // TCPDCTCP_H
@@ -0,0 +1,148 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "tcp-header.h"
+#include "tcp-gso.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpGso");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpGsoTag);
+
+TcpGsoTag::TcpGsoTag ()
+  : m_segmentSize (0)
+{
+}
+
+TcpGsoTag::TcpGsoTag (uint16_t segmentSize)
+  : m_segmentSize (segmentSize)
+{
+}
+
+void
+TcpGsoTag::SetSegmentSize (uint16_t segmentSize)
+{
+  m_segmentSize = segmentSize;
+}
+
+uint16_t
+TcpGsoTag::GetSegmentSize (void) const
+{
+  return m_segmentSize;
+}
+
+TypeId
+TcpGsoTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpGsoTag")
+    .SetParent<Tag> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpGsoTag> ()
+  ;
+  return tid;
+}
+
+TypeId
+TcpGsoTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+TcpGsoTag::GetSerializedSize (void) const
+{
+  return sizeof (uint16_t);
+}
+
+void
+TcpGsoTag::Serialize (TagBuffer i) const
+{
+  i.WriteU16 (m_segmentSize);
+}
+
+void
+TcpGsoTag::Deserialize (TagBuffer i)
+{
+  m_segmentSize = i.ReadU16 ();
+}
+
+void
+TcpGsoTag::Print (std::ostream &os) const
+{
+  os << "SegmentSize=" << m_segmentSize;
+}
+
+void
+TcpGso::Cut (Ptr<const Packet> packet, const Ipv4Header &ipHeader,
+             uint32_t size, std::list<Ipv4PayloadHeaderPair> &pieces)
+{
+  NS_LOG_FUNCTION (packet << &ipHeader << size);
+  NS_ASSERT (size > 0);
+
+  Ptr<Packet> p = packet->Copy ();
+  TcpHeader tcpHeader;
+  p->RemoveHeader (tcpHeader);
+  TcpGsoTag tag;
+  bool tagged = p->RemovePacketTag (tag);
+
+  uint32_t payloadSize = p->GetSize ();
+  uint16_t identification = ipHeader.GetIdentification ();
+  for (uint32_t offset = 0; offset < payloadSize; offset += size)
+    {
+      uint32_t length = std::min (size, payloadSize - offset);
+      Ptr<Packet> piece = p->CreateFragment (offset, length);
+
+      TcpHeader header = tcpHeader;
+      header.SetSequenceNumber (tcpHeader.GetSequenceNumber () + SequenceNumber32 (offset));
+      uint8_t flags = tcpHeader.GetFlags ();
+      if (offset + length < payloadSize)
+        {
+          flags &= ~(TcpHeader::FIN | TcpHeader::PSH);
+        }
+      if (offset > 0)
+        {
+          flags &= ~TcpHeader::CWR;
+        }
+      header.SetFlags (flags);
+      if (Node::ChecksumEnabled ())
+        {
+          header.EnableChecksums ();
+          header.InitializeChecksum (ipHeader.GetSource (), ipHeader.GetDestination (),
+                                     ipHeader.GetProtocol ());
+        }
+      piece->AddHeader (header);
+      if (tagged && length > tag.GetSegmentSize ())
+        {
+          piece->AddPacketTag (tag);
+        }
+
+      Ipv4Header pieceHeader = ipHeader;
+      if (Node::ChecksumEnabled ())
+        {
+          pieceHeader.EnableChecksum ();
+        }
+      pieceHeader.SetPayloadSize (piece->GetSize ());
+      pieceHeader.SetIdentification (identification++);
+      pieces.push_back (Ipv4PayloadHeaderPair (piece, pieceHeader));
+    }
+  NS_LOG_LOGIC ("Cut " << payloadSize << " bytes in " << (payloadSize + size - 1) / size << " pieces");
+}
+
+} // namespace ns3
@@ -0,0 +1,114 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TCP_GSO_H
+#define TCP_GSO_H
+
+#include <list>
+#include <utility>
+#include "ns3/tag.h"
+#include "ns3/ptr.h"
+#include "ns3/packet.h"
+#include "ns3/ipv4-header.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Marks a TCP super-segment, and the size of the segments it stands for.
+ *
+ * With generic segmentation offload (see the GsoMaxSize attribute of
+ * TcpSocketBase), a connection hands several segments to the IP layer as
+ * one packet, with one TCP header.  The packet is cut in segments by the
+ * device when it transmits it, if the device supports it
+ * (NetDevice::SupportsGso), or by the IP layer before the device otherwise.
+ * The segments on the wire do not carry the tag.
+ *
+ * A device that merges the segments it receives (e.g., PointToPointNetDevice
+ * with its Gro attribute) puts the tag on the merged packets, too, so
+ * that TCP still knows how many segments it got.
+ */
+class TcpGsoTag : public Tag
+{
+public:
+  TcpGsoTag ();
+
+  /**
+   * \brief Constructor
+   * \param segmentSize the payload size of the segments
+   */
+  TcpGsoTag (uint16_t segmentSize);
+
+  /**
+   * \brief Set the payload size of the segments.
+   * \param segmentSize the payload size of the segments
+   */
+  void SetSegmentSize (uint16_t segmentSize);
+
+  /**
+   * \brief Get the payload size of the segments.
+   * \returns the payload size of the segments
+   */
+  uint16_t GetSegmentSize (void) const;
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint16_t m_segmentSize; //!< Payload size of the segments
+};
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Cuts TCP super-segments (see TcpGsoTag).
+ */
+class TcpGso
+{
+public:
+  /// A TCP segment and its IPv4 header
+  typedef std::pair<Ptr<Packet>, Ipv4Header> Ipv4PayloadHeaderPair;
+
+  /**
+   * \brief Cut a TCP super-segment in smaller ones.
+   *
+   * Each piece gets a copy of the IPv4 and TCP headers, with its payload
+   * length and sequence number.  The IPv4 identification grows by one per
+   * piece.  FIN and PSH are only set on the last piece, and CWR on the
+   * first one.  The pieces still larger than the segment size of the tag
+   * keep it, the others lose it.
+   *
+   * \param packet the super-segment, starting with its TCP header
+   * \param ipHeader the IPv4 header of the super-segment
+   * \param size the payload size of the pieces, but the last one
+   * \param pieces the list the pieces are appended to
+   */
+  static void Cut (Ptr<const Packet> packet, const Ipv4Header &ipHeader,
+                   uint32_t size, std::list<Ipv4PayloadHeaderPair> &pieces);
+};
+
+} // namespace ns3
+
+#endif /* TCP_GSO_H */
@@ -38,10 +38,12 @@
 #include "ipv6-end-point.h"
 #include "ipv4-l3-protocol.h"
 #include "ipv6-l3-protocol.h"
+#include "ipv4-routing-protocol.h"
 #include "ipv6-routing-protocol.h"
 #include "tcp-socket-factory-impl.h"
 #include "tcp-socket-base.h"
 #include "tcp-congestion-ops.h"
+#include "tcp-pacing-wheel.h"
 #include "rtt-estimator.h"
 
 #include <vector>
@@ -154,7 +156,17 @@ void
 TcpL4Protocol::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  for (std::vector<Ptr<TcpSocketBase> >::iterator it = m_sockets.begin (); it != m_sockets.end (); ++it)
+    {
+      (*it)->m_socketIndex = TcpSocketBase::NOT_LISTED;
+    }
   m_sockets.clear ();
+  m_eventTrace = 0;
+  if (m_pacingWheel != 0)
+    {
+      m_pacingWheel->Dispose ();
+      m_pacingWheel = 0;
+    }
 
   if (m_endPoints != 0)
     {
@@ -191,8 +203,9 @@ TcpL4Protocol::CreateSocket (TypeId congestionTypeId)
   socket->SetTcp (this);
   socket->SetRtt (rtt);
   socket->SetCongestionControlAlgorithm (algo);
+  socket->SetEventTrace (m_eventTrace);
 
-  m_sockets.push_back (socket);
+  AddSocket (socket);
   return socket;
 }
 
@@ -202,6 +215,23 @@ TcpL4Protocol::CreateSocket (void)
   return CreateSocket (m_congestionTypeId);
 }
 
+void
+TcpL4Protocol::SetEventTrace (Ptr<EventTraceRing> ring)
+{
+  NS_LOG_FUNCTION (this << ring);
+  m_eventTrace = ring;
+}
+
+Ptr<TcpPacingWheel>
+TcpL4Protocol::GetPacingWheel (void)
+{
+  if (m_pacingWheel == 0)
+    {
+      m_pacingWheel = CreateObject<TcpPacingWheel> ();
+    }
+  return m_pacingWheel;
+}
+
 Ipv4EndPoint *
 TcpL4Protocol::Allocate (void)
 {
@@ -538,9 +568,9 @@ TcpL4Protocol::Receive (Ptr<Packet> packet,
 void
 TcpL4Protocol::SendPacketV4 (Ptr<Packet> packet, const TcpHeader &outgoing,
                              const Ipv4Address &saddr, const Ipv4Address &daddr,
-                             Ptr<NetDevice> oif) const
+                             Ptr<NetDevice> oif, Ipv4EndPoint *endPoint) const
 {
-  NS_LOG_FUNCTION (this << packet << saddr << daddr << oif);
+  NS_LOG_FUNCTION (this << packet << saddr << daddr << oif << endPoint);
   NS_LOG_LOGIC ("TcpL4Protocol " << this
                                  << " sending seq " << outgoing.GetSequenceNumber ()
                                  << " ack " << outgoing.GetAckNumber ()
@@ -569,9 +599,23 @@ TcpL4Protocol::SendPacketV4 (Ptr<Packet> packet, const TcpHeader &outgoing,
       header.SetProtocol (PROT_NUMBER);
       Socket::SocketErrno errno_;
       Ptr<Ipv4Route> route;
-      if (ipv4->GetRoutingProtocol () != 0)
+      Ptr<Ipv4RoutingProtocol> routing = ipv4->GetRoutingProtocol ();
+      if (routing != 0)
         {
-          route = ipv4->GetRoutingProtocol ()->RouteOutput (packet, header, oif, errno_);
+          // A connection reuses its route until the routes of the node change
+          uint64_t generation = endPoint != 0 ? routing->GetRouteGeneration () : 0;
+          if (generation != 0)
+            {
+              route = endPoint->GetCachedRoute (generation, oif);
+            }
+          if (route == 0)
+            {
+              route = routing->RouteOutput (packet, header, oif, errno_);
+              if (generation != 0 && route != 0)
+                {
+                  endPoint->SetCachedRoute (route, generation, oif);
+                }
+            }
         }
       else
         {
@@ -686,22 +730,26 @@ TcpL4Protocol::SendPacket (Ptr<Packet> pkt, const TcpHeader &outgoing,
   NS_FATAL_ERROR ("Trying to send a packet without IP addresses");
 }
 
+void
+TcpL4Protocol::SendPacket (Ptr<Packet> pkt, const TcpHeader &outgoing,
+                           Ipv4EndPoint *endPoint, Ptr<NetDevice> oif) const
+{
+  NS_LOG_FUNCTION (this << pkt << outgoing << endPoint << oif);
+  SendPacketV4 (pkt, outgoing, endPoint->GetLocalAddress (),
+                endPoint->GetPeerAddress (), oif, endPoint);
+}
+
 void
 TcpL4Protocol::AddSocket (Ptr<TcpSocketBase> socket)
 {
   NS_LOG_FUNCTION (this << socket);
-  std::vector<Ptr<TcpSocketBase> >::iterator it = m_sockets.begin ();
-
-  while (it != m_sockets.end ())
+  if (socket->m_socketIndex < m_sockets.size ()
+      && m_sockets[socket->m_socketIndex] == socket)
     {
-      if (*it == socket)
-        {
-          return;
-        }
-
-      ++it;
+      return;
     }
 
+  socket->m_socketIndex = m_sockets.size ();
   m_sockets.push_back (socket);
 }
 
@@ -709,20 +757,18 @@ bool
 TcpL4Protocol::RemoveSocket (Ptr<TcpSocketBase> socket)
 {
   NS_LOG_FUNCTION (this << socket);
-  std::vector<Ptr<TcpSocketBase> >::iterator it = m_sockets.begin ();
-
-  while (it != m_sockets.end ())
+  uint32_t index = socket->m_socketIndex;
+  if (index >= m_sockets.size () || m_sockets[index] != socket)
     {
-      if (*it == socket)
-        {
-          m_sockets.erase (it);
-          return true;
-        }
-
-      ++it;
+      return false;
     }
 
-  return false;
+  // Move the last socket in the hole, rather than shifting the tail
+  m_sockets[index] = m_sockets.back ();
+  m_sockets[index]->m_socketIndex = index;
+  m_sockets.pop_back ();
+  socket->m_socketIndex = TcpSocketBase::NOT_LISTED;
+  return true;
 }
 
 void
@@ -26,6 +26,7 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/ipv6-address.h"
 #include "ns3/sequence-number.h"
+#include "ns3/event-trace.h"
 #include "ip-l4-protocol.h"
 
 
@@ -38,6 +39,7 @@ class Ipv4EndPointDemux;
 class Ipv6EndPointDemux;
 class Ipv4Interface;
 class TcpSocketBase;
+class TcpPacingWheel;
 class Ipv4EndPoint;
 class Ipv6EndPoint;
 class NetDevice;
@@ -115,6 +117,24 @@ public:
    */
   Ptr<Socket> CreateSocket (TypeId congestionTypeId);
 
+  /**
+   * \brief Record the events of this stack's TCP sockets to a ring
+   *
+   * The ring is handed to every socket created afterwards.
+   *
+   * \param ring the ring, or 0 to stop recording for new sockets
+   */
+  void SetEventTrace (Ptr<EventTraceRing> ring);
+
+  /**
+   * \brief Get the timer wheel of the paced sockets of this stack
+   *
+   * The wheel is created on first use.
+   *
+   * \return the pacing wheel
+   */
+  Ptr<TcpPacingWheel> GetPacingWheel (void);
+
   /**
    * \brief Allocate an IPv4 Endpoint
    * \return the Endpoint
@@ -205,10 +225,27 @@ public:
                    const Address &saddr, const Address &daddr,
                    Ptr<NetDevice> oif = 0) const;
 
+  /**
+   * \brief Send a packet via TCP (IPv4) from a connected endpoint
+   *
+   * The route of the endpoint is looked up once, and reused as long as
+   * the routes of the node do not change (see
+   * Ipv4RoutingProtocol::GetRouteGeneration).
+   *
+   * \param pkt The packet to send
+   * \param outgoing The packet header
+   * \param endPoint The endpoint giving the source and destination addresses
+   * \param oif The output interface bound. Defaults to null (unspecified).
+   */
+  void SendPacket (Ptr<Packet> pkt, const TcpHeader &outgoing,
+                   Ipv4EndPoint *endPoint, Ptr<NetDevice> oif = 0) const;
+
   /**
    * \brief Make a socket fully operational
    *
    * Called after a socket has been bound, it is inserted in an internal vector.
+   * The socket keeps its position in the vector, so that adding and removing
+   * it take constant time.
    *
    * \param socket Socket to be added
    */
@@ -217,6 +254,8 @@ public:
   /**
    * \brief Remove a socket from the internal list
    *
+   * The last socket of the list takes its place.
+   *
    * \param socket socket to Remove
    * \return true if the socket has been removed
    */
@@ -307,6 +346,8 @@ private:
   TypeId m_rttTypeId;              //!< The RTT Estimator TypeId
   TypeId m_congestionTypeId;       //!< The socket TypeId
   std::vector<Ptr<TcpSocketBase> > m_sockets;      //!< list of sockets
+  Ptr<EventTraceRing> m_eventTrace;                //!< ring handed to new sockets
+  Ptr<TcpPacingWheel> m_pacingWheel;               //!< timer wheel of the paced sockets
   IpL4Protocol::DownTargetCallback m_downTarget;   //!< Callback to send packets over IPv4
   IpL4Protocol::DownTargetCallback6 m_downTarget6; //!< Callback to send packets over IPv6
 
@@ -332,10 +373,11 @@ private:
    * \param saddr The source Ipv4Address
    * \param daddr The destination Ipv4Address
    * \param oif The output interface bound. Defaults to null (unspecified).
+   * \param endPoint The endpoint caching the route, if any
    */
   void SendPacketV4 (Ptr<Packet> pkt, const TcpHeader &outgoing,
                      const Ipv4Address &saddr, const Ipv4Address &daddr,
-                     Ptr<NetDevice> oif = 0) const;
+                     Ptr<NetDevice> oif = 0, Ipv4EndPoint *endPoint = 0) const;
 
   /**
    * \brief Send a packet via TCP (IPv6)
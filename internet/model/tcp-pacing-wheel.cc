@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "tcp-pacing-wheel.h"
+#include "tcp-socket-base.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpPacingWheel");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpPacingWheel);
+
+TypeId
+TcpPacingWheel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpPacingWheel")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpPacingWheel> ()
+    .AddAttribute ("Granularity",
+                   "Duration of a slot of the wheel",
+                   TimeValue (MicroSeconds (10)),
+                   MakeTimeAccessor (&TcpPacingWheel::m_granularity),
+                   MakeTimeChecker ())
+    .AddAttribute ("Slots",
+                   "Number of slots of the wheel",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&TcpPacingWheel::m_nSlots),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+TcpPacingWheel::TcpPacingWheel ()
+  : m_nSlots (0),
+    m_base (0),
+    m_pending (0),
+    m_eventTick (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpPacingWheel::~TcpPacingWheel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TcpPacingWheel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  m_slots.clear ();
+  m_firing.clear ();
+  m_pending = 0;
+  Object::DoDispose ();
+}
+
+void
+TcpPacingWheel::Schedule (Ptr<TcpSocketBase> socket, Time when)
+{
+  NS_LOG_FUNCTION (this << socket << when);
+  NS_ASSERT (m_granularity.IsStrictlyPositive ());
+  if (m_slots.empty ())
+    {
+      m_slots.resize (m_nSlots);
+    }
+
+  int64_t granularity = m_granularity.GetTimeStep ();
+  if (m_pending == 0)
+    {
+      // Nothing is waiting: start the wheel again from now
+      m_base = Simulator::Now ().GetTimeStep () / granularity;
+    }
+  uint64_t tick = (when.GetTimeStep () + granularity - 1) / granularity;
+  tick = std::max (tick, m_base);
+  tick = std::min (tick, m_base + m_nSlots - 1);
+
+  m_slots[tick % m_nSlots].push_back (socket);
+  ++m_pending;
+  if (!m_event.IsRunning () || tick < m_eventTick)
+    {
+      ScheduleTick (tick);
+    }
+}
+
+uint32_t
+TcpPacingWheel::GetNPending (void) const
+{
+  return m_pending;
+}
+
+void
+TcpPacingWheel::ScheduleTick (uint64_t tick)
+{
+  NS_LOG_FUNCTION (this << tick);
+  m_event.Cancel ();
+  m_eventTick = tick;
+  Time delay = TimeStep (tick * m_granularity.GetTimeStep ()) - Simulator::Now ();
+  m_event = Simulator::Schedule (Max (delay, Time (0)), &TcpPacingWheel::Fire, this);
+}
+
+void
+TcpPacingWheel::Fire (void)
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t tick = m_eventTick;
+  m_firing.swap (m_slots[tick % m_nSlots]);
+  m_pending -= m_firing.size ();
+  m_base = tick + 1;
+  NS_LOG_LOGIC ("Releasing " << m_firing.size () << " sockets, " << m_pending << " left");
+
+  for (std::vector<Ptr<TcpSocketBase> >::iterator it = m_firing.begin (); it != m_firing.end (); ++it)
+    {
+      (*it)->PacingRelease ();
+    }
+  m_firing.clear ();
+
+  if (m_pending > 0 && !m_event.IsRunning ())
+    {
+      uint64_t next = m_base;
+      while (m_slots[next % m_nSlots].empty ())
+        {
+          ++next;
+        }
+      ScheduleTick (next);
+    }
+}
+
+} // namespace ns3
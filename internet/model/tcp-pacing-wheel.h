@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TCP_PACING_WHEEL_H
+#define TCP_PACING_WHEEL_H
+
+#include <vector>
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/ptr.h"
+
+namespace ns3 {
+
+class TcpSocketBase;
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Timer wheel releasing the paced TCP sockets of a node
+ *
+ * A paced socket that has to wait before sending its next segment
+ * registers with the wheel of its TcpL4Protocol, and the wheel calls it
+ * back when the time comes.  The wheel has a slot per tick of its
+ * granularity, and a single simulator event, for the earliest slot that
+ * is not empty, so that pacing many sockets does not cost a simulator
+ * event per segment and per socket.
+ *
+ * The release times are rounded up to the granularity.  A time further
+ * than the wheel covers goes in its last slot: the socket is called back
+ * early, and registers again.
+ */
+class TcpPacingWheel : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  TcpPacingWheel ();
+  virtual ~TcpPacingWheel ();
+
+  /**
+   * \brief Call a socket back, once a time has come
+   *
+   * The socket is called back with TcpSocketBase::PacingRelease.
+   *
+   * \param socket the socket
+   * \param when the time the socket can send again
+   */
+  void Schedule (Ptr<TcpSocketBase> socket, Time when);
+
+  /**
+   * \brief Get the number of sockets waiting
+   * \return the number of sockets waiting
+   */
+  uint32_t GetNPending (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * \brief Call back the sockets of the slot of m_eventTick
+   */
+  void Fire (void);
+
+  /**
+   * \brief Schedule the simulator event for a tick
+   * \param tick the tick
+   */
+  void ScheduleTick (uint64_t tick);
+
+  Time m_granularity;    //!< Duration of a slot
+  uint32_t m_nSlots;     //!< Number of slots
+
+  std::vector<std::vector<Ptr<TcpSocketBase> > > m_slots; //!< Sockets waiting, per slot
+  std::vector<Ptr<TcpSocketBase> > m_firing;              //!< Sockets being called back
+  uint64_t m_base;       //!< First tick not processed yet
+  uint32_t m_pending;    //!< Number of sockets waiting
+  EventId m_event;       //!< Event for the earliest slot not empty
+  uint64_t m_eventTick;  //!< Tick of m_event
+};
+
+} // namespace ns3
+
+#endif /* TCP_PACING_WHEEL_H */
@@ -0,0 +1,194 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "tcp-rate-ops.h"
+#include "tcp-tx-buffer.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("TcpRateOps");
+
+NS_OBJECT_ENSURE_REGISTERED (TcpRateOps);
+
+TypeId
+TcpRateOps::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::TcpRateOps")
+    .SetParent<Object> ()
+    .SetGroupName ("Internet")
+    .AddConstructor<TcpRateOps> ()
+  ;
+  return tid;
+}
+
+TcpRateOps::TcpRateConnection::TcpRateConnection ()
+  : m_delivered (0),
+    m_deliveredTime (0),
+    m_firstSentTime (0),
+    m_appLimited (0),
+    m_rateDelivered (0),
+    m_rateInterval (0),
+    m_rateAppLimited (false)
+{
+}
+
+TcpRateOps::TcpRateSample::TcpRateSample ()
+  : m_deliveryRate (0),
+    m_isAppLimited (false),
+    m_interval (0),
+    m_delivered (-1),
+    m_priorDelivered (0),
+    m_priorTime (0),
+    m_sendElapsed (0),
+    m_ackElapsed (0),
+    m_ackedSacked (0),
+    m_priorInFlight (0),
+    m_bytesInFlight (0)
+{
+}
+
+TcpRateOps::TcpRateOps ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TcpRateOps::~TcpRateOps ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+TcpRateOps::SkbSent (TcpTxItem *item, bool isStartOfTransmission)
+{
+  NS_LOG_FUNCTION (this << isStartOfTransmission);
+
+  if (isStartOfTransmission)
+    {
+      // Nothing in flight: the intervals start now, not when the last
+      // segment was delivered
+      m_rate.m_firstSentTime = Simulator::Now ();
+      m_rate.m_deliveredTime = Simulator::Now ();
+    }
+
+  item->m_rateInfo.m_firstSent = m_rate.m_firstSentTime;
+  item->m_rateInfo.m_deliveredTime = m_rate.m_deliveredTime;
+  item->m_rateInfo.m_delivered = m_rate.m_delivered;
+  item->m_rateInfo.m_isAppLimited = (m_rate.m_appLimited != 0);
+}
+
+void
+TcpRateOps::SkbDelivered (const TcpTxItem *item, uint32_t bytes)
+{
+  NS_LOG_FUNCTION (this << bytes);
+
+  m_rate.m_delivered += bytes;
+  m_rate.m_deliveredTime = Simulator::Now ();
+  m_sample.m_ackedSacked += bytes;
+
+  // The sample is taken from the last segment sent
+  if (m_sample.m_delivered < 0
+      || item->m_rateInfo.m_delivered > m_sample.m_priorDelivered)
+    {
+      m_sample.m_delivered = 0;
+      m_sample.m_priorDelivered = item->m_rateInfo.m_delivered;
+      m_sample.m_priorTime = item->m_rateInfo.m_deliveredTime;
+      m_sample.m_isAppLimited = item->m_rateInfo.m_isAppLimited;
+      m_sample.m_sendElapsed = item->m_lastSent - item->m_rateInfo.m_firstSent;
+
+      // The next interval starts with this segment
+      m_rate.m_firstSentTime = item->m_lastSent;
+    }
+}
+
+void
+TcpRateOps::CalculateAppLimited (uint32_t cWnd, uint32_t inFlight, uint32_t segmentSize,
+                                 const SequenceNumber32 &tailSeq,
+                                 const SequenceNumber32 &nextTx)
+{
+  NS_LOG_FUNCTION (this << cWnd << inFlight << segmentSize << tailSeq << nextTx);
+
+  if (tailSeq - nextTx < static_cast<int32_t> (segmentSize) && inFlight < cWnd)
+    {
+      // The samples are application limited until the data in flight now
+      // is delivered; 1 stands for 0
+      m_rate.m_appLimited = std::max<uint64_t> (m_rate.m_delivered + inFlight, 1);
+    }
+}
+
+TcpRateOps::TcpRateSample
+TcpRateOps::GenerateSample (uint32_t priorInFlight, uint32_t bytesInFlight,
+                            const Time &minRtt)
+{
+  NS_LOG_FUNCTION (this << priorInFlight << bytesInFlight << minRtt);
+
+  TcpRateSample sample = m_sample;
+  m_sample = TcpRateSample ();
+
+  if (m_rate.m_appLimited != 0 && m_rate.m_delivered > m_rate.m_appLimited)
+    {
+      // The data in flight when the application ran out is delivered
+      m_rate.m_appLimited = 0;
+    }
+
+  sample.m_priorInFlight = priorInFlight;
+  sample.m_bytesInFlight = bytesInFlight;
+  if (sample.m_delivered < 0)
+    {
+      NS_LOG_LOGIC ("Nothing delivered");
+      return sample;
+    }
+
+  sample.m_delivered = m_rate.m_delivered - sample.m_priorDelivered;
+  sample.m_ackElapsed = m_rate.m_deliveredTime - sample.m_priorTime;
+  sample.m_interval = Max (sample.m_sendElapsed, sample.m_ackElapsed);
+
+  // A sample shorter than the minimum RTT comes from ACKs or segments
+  // compressed by the network, and overestimates the rate
+  if (!sample.m_interval.IsStrictlyPositive () || sample.m_interval < minRtt)
+    {
+      NS_LOG_LOGIC ("Interval " << sample.m_interval << " shorter than the minimum RTT");
+      sample.m_interval = Time (0);
+      return sample;
+    }
+
+  // Keep the sample, unless it is application limited and slower than
+  // the last one kept
+  if (!sample.m_isAppLimited
+      || (sample.m_delivered * m_rate.m_rateInterval.GetTimeStep ()
+          >= static_cast<int64_t> (m_rate.m_rateDelivered) * sample.m_interval.GetTimeStep ()))
+    {
+      m_rate.m_rateDelivered = sample.m_delivered;
+      m_rate.m_rateInterval = sample.m_interval;
+      m_rate.m_rateAppLimited = sample.m_isAppLimited;
+    }
+
+  sample.m_deliveryRate = DataRate (static_cast<uint64_t> (sample.m_delivered * 8
+                                                           / sample.m_interval.GetSeconds ()));
+  NS_LOG_LOGIC ("Delivered " << sample.m_delivered << " bytes in " << sample.m_interval <<
+                ", rate " << sample.m_deliveryRate);
+  return sample;
+}
+
+const TcpRateOps::TcpRateConnection &
+TcpRateOps::GetConnectionRate (void) const
+{
+  return m_rate;
+}
+
+} // namespace ns3
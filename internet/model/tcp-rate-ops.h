@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TCP_RATE_OPS_H
+#define TCP_RATE_OPS_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+#include "ns3/sequence-number.h"
+
+namespace ns3 {
+
+class TcpTxItem;
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Delivery rate sampling of a TCP connection
+ *
+ * This is the estimator of Linux (net/ipv4/tcp_rate.c), described in
+ * draft-cheng-iccrg-delivery-rate-estimation.  The connection counts the
+ * bytes delivered (cumulatively ACKed or SACKed) so far, and each segment
+ * sent is stamped with that count and its time (TcpTxItem::m_rateInfo).
+ * When a segment is delivered, the bytes delivered since it was sent, over
+ * the time elapsed, is a sample of the delivery rate.  Of the segments
+ * delivered by an ACK, the last one sent gives the sample of the ACK.
+ *
+ * The interval of a sample is the longest of the sending and the ACKing
+ * intervals, so that a sample does not exceed the rate of the bottleneck
+ * because of ACK compression.  A sample taken while the application did
+ * not give enough data to fill the window is marked as application limited.
+ *
+ * TcpTxBuffer calls SkbSent and SkbDelivered as it sends and frees its
+ * segments, TcpSocketBase calls CalculateAppLimited when it runs out of
+ * data, and GenerateSample once an ACK is processed.
+ */
+class TcpRateOps : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Delivery state of the connection
+   */
+  struct TcpRateConnection
+  {
+    TcpRateConnection ();
+
+    uint64_t m_delivered;       //!< Bytes delivered so far
+    Time     m_deliveredTime;   //!< Time m_delivered was last updated
+    Time     m_firstSentTime;   //!< Send time of the segment starting the current interval
+    uint64_t m_appLimited;      //!< Delivered count ending the application limited period, 0 if none
+    uint64_t m_rateDelivered;   //!< Bytes delivered of the last sample not application limited
+    Time     m_rateInterval;    //!< Interval of the last sample not application limited
+    bool     m_rateAppLimited;  //!< Whether the last sample kept was application limited
+  };
+
+  /**
+   * \brief Delivery rate sample of an ACK
+   */
+  struct TcpRateSample
+  {
+    TcpRateSample ();
+
+    DataRate m_deliveryRate;    //!< Delivery rate, 0 if the sample is not valid
+    bool     m_isAppLimited;    //!< Sample taken while application limited
+    Time     m_interval;        //!< Interval of the sample, 0 if the sample is not valid
+    int64_t  m_delivered;       //!< Bytes delivered over m_interval, -1 if nothing delivered
+    uint64_t m_priorDelivered;  //!< Delivered count when the segment of the sample was sent
+    Time     m_priorTime;       //!< Delivered time when the segment of the sample was sent
+    Time     m_sendElapsed;     //!< Sending interval of the sample
+    Time     m_ackElapsed;      //!< ACKing interval of the sample
+    uint32_t m_ackedSacked;     //!< Bytes delivered by the ACK
+    uint32_t m_priorInFlight;   //!< Bytes in flight before the ACK
+    uint32_t m_bytesInFlight;   //!< Bytes in flight after the ACK
+  };
+
+  TcpRateOps ();
+  virtual ~TcpRateOps ();
+
+  /**
+   * \brief Stamp a segment being sent with the delivery state
+   * \param item the segment
+   * \param isStartOfTransmission true if no other segment is in flight
+   */
+  void SkbSent (TcpTxItem *item, bool isStartOfTransmission);
+
+  /**
+   * \brief Account for the delivery of (a part of) a segment
+   * \param item the segment
+   * \param bytes the bytes of the segment delivered
+   */
+  void SkbDelivered (const TcpTxItem *item, uint32_t bytes);
+
+  /**
+   * \brief Mark the connection as application limited, if it is
+   *
+   * The connection is application limited when it has less than a segment
+   * to send, and the window is not full.
+   *
+   * \param cWnd the congestion window
+   * \param inFlight the bytes in flight
+   * \param segmentSize the segment size
+   * \param tailSeq the sequence number after the last byte of the buffer
+   * \param nextTx the next sequence number to send
+   */
+  void CalculateAppLimited (uint32_t cWnd, uint32_t inFlight, uint32_t segmentSize,
+                            const SequenceNumber32 &tailSeq, const SequenceNumber32 &nextTx);
+
+  /**
+   * \brief Get the sample of the ACK just processed
+   *
+   * The segments delivered afterwards go in the sample of the next ACK.
+   *
+   * \param priorInFlight the bytes in flight before the ACK
+   * \param bytesInFlight the bytes in flight after the ACK
+   * \param minRtt the minimum RTT of the connection; shorter samples are
+   * not valid
+   * \return the sample
+   */
+  TcpRateSample GenerateSample (uint32_t priorInFlight, uint32_t bytesInFlight,
+                                const Time &minRtt);
+
+  /**
+   * \brief Get the delivery state of the connection
+   * \return the delivery state
+   */
+  const TcpRateConnection & GetConnectionRate (void) const;
+
+private:
+  TcpRateConnection m_rate;   //!< Delivery state of the connection
+  TcpRateSample m_sample;     //!< Sample of the ACK being processed
+};
+
+} // namespace ns3
+
+#endif /* TCP_RATE_OPS_H */
@@ -18,6 +18,7 @@
  * Author: Adrian Sai-wah Tam <adrian.sw.tam@gmail.com>
  */
 
+#include <algorithm>
 #include "ns3/packet.h"
 #include "ns3/fatal-error.h"
 #include "ns3/log.h"
@@ -114,9 +115,9 @@ TcpRxBuffer::MaxRxSequence (void) const
     { // No data allowed beyond FIN
       return m_finSeq;
     }
-  else if (m_data.size () && m_nextRxSeq > m_data.begin ()->first)
+  else if (!m_blocks.empty () && m_nextRxSeq > m_blocks.front ().head)
     { // No data allowed beyond Rx window allowed
-      return m_data.begin ()->first + SequenceNumber32 (m_maxBuffer);
+      return m_blocks.front ().head + SequenceNumber32 (m_maxBuffer);
     }
   return m_nextRxSeq + SequenceNumber32 (m_maxBuffer);
 }
@@ -150,33 +151,31 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
 
   // Trim packet to fit Rx window specification
   if (headSeq < m_nextRxSeq) headSeq = m_nextRxSeq;
-  if (m_data.size ())
+  if (!m_blocks.empty ())
     {
-      SequenceNumber32 maxSeq = m_data.begin ()->first + SequenceNumber32 (m_maxBuffer);
+      SequenceNumber32 maxSeq = m_blocks.front ().head + SequenceNumber32 (m_maxBuffer);
       if (maxSeq < tailSeq) tailSeq = maxSeq;
       if (tailSeq < headSeq) headSeq = tailSeq;
     }
-  // Remove overlapped bytes from packet
-  BufIterator i = m_data.begin ();
-  while (i != m_data.end () && i->first <= tailSeq)
+  // Remove overlapped bytes from packet; the blocks ending before the
+  // head cannot overlap it
+  uint32_t i = FindBlock (headSeq);
+  while (i < m_blocks.size () && m_blocks[i].head <= tailSeq)
     {
-      SequenceNumber32 lastByteSeq = i->first + SequenceNumber32 (i->second->GetSize ());
-      if (lastByteSeq > headSeq)
-        {
-          if (i->first > headSeq && lastByteSeq < tailSeq)
-            { // Rare case: Existing packet is embedded fully in the new packet
-              m_size -= i->second->GetSize ();
-              m_data.erase (i++);
-              continue;
-            }
-          if (i->first <= headSeq)
-            { // Incoming head is overlapped
-              headSeq = lastByteSeq;
-            }
-          if (lastByteSeq >= tailSeq)
-            { // Incoming tail is overlapped
-              tailSeq = i->first;
-            }
+      Block &block = m_blocks[i];
+      if (block.head > headSeq && block.tail < tailSeq)
+        { // Rare case: Existing block is embedded fully in the new packet
+          m_size -= block.tail - block.head;
+          RemoveBlock (i);
+          continue;
+        }
+      if (block.head <= headSeq)
+        { // Incoming head is overlapped
+          headSeq = block.tail;
+        }
+      if (block.tail >= tailSeq)
+        { // Incoming tail is overlapped
+          tailSeq = block.head;
         }
       ++i;
     }
@@ -192,32 +191,47 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
       uint32_t length = tailSeq - headSeq;
       p = p->CreateFragment (start, length);
       NS_ASSERT (length == p->GetSize ());
+      // Only the bytes are delivered, as when Extract built a new packet
+      p->RemoveAllPacketTags ();
+    }
+  // Insert packet into buffer, at the end of the block before it or at the
+  // beginning of the block after it when they are contiguous
+  i = FindBlock (headSeq);
+  NS_ASSERT (i == m_blocks.size () || m_blocks[i].head >= tailSeq); // Shouldn't be there yet
+  if (i > 0 && m_blocks[i - 1].tail == headSeq)
+    {
+      --i;
+      m_blocks[i].packets.PushBack (p);
+      m_blocks[i].tail = tailSeq;
+      if (i + 1 < m_blocks.size () && m_blocks[i + 1].head == tailSeq)
+        {
+          MergeBlocks (i);
+        }
+    }
+  else if (i < m_blocks.size () && m_blocks[i].head == tailSeq)
+    {
+      m_blocks[i].packets.PushFront (p);
+      m_blocks[i].head = headSeq;
+    }
+  else
+    {
+      InsertBlock (i, headSeq, p);
     }
-  // Insert packet into buffer
-  NS_ASSERT (m_data.find (headSeq) == m_data.end ()); // Shouldn't be there yet
-  m_data [ headSeq ] = p;
 
-  if (headSeq > m_nextRxSeq)
+  if (m_blocks[i].head > m_nextRxSeq)
     {
-      // Generate a new SACK block
-      UpdateSackList (headSeq, tailSeq);
+      // Generate a new SACK block, with the whole block holding the packet
+      UpdateSackList (m_blocks[i].head, m_blocks[i].tail);
     }
 
   NS_LOG_LOGIC ("Buffered packet of seqno=" << headSeq << " len=" << p->GetSize ());
   // Update variables
   m_size += p->GetSize ();      // Occupancy
-  for (i = m_data.begin (); i != m_data.end (); ++i)
-    {
-      if (i->first < m_nextRxSeq)
-        {
-          continue;
-        }
-      else if (i->first > m_nextRxSeq)
-        {
-          break;
-        };
-      m_nextRxSeq = i->first + SequenceNumber32 (i->second->GetSize ());
-      m_availBytes += i->second->GetSize ();
+  const Block &first = m_blocks.front ();
+  if (first.head <= m_nextRxSeq && first.tail > m_nextRxSeq)
+    { // The packet extended the in-order block
+      m_availBytes += first.tail - m_nextRxSeq.Get ();
+      m_nextRxSeq = first.tail;
       ClearSackList (m_nextRxSeq);
     }
   NS_LOG_LOGIC ("Updated buffer occupancy=" << m_size << " nextRxSeq=" << m_nextRxSeq);
@@ -228,6 +242,70 @@ TcpRxBuffer::Add (Ptr<Packet> p, TcpHeader const& tcph)
   return true;
 }
 
+uint32_t
+TcpRxBuffer::FindBlock (const SequenceNumber32 &seq) const
+{
+  uint32_t lo = 0;
+  uint32_t hi = m_blocks.size ();
+  while (lo < hi)
+    {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (m_blocks[mid].tail > seq)
+        {
+          hi = mid;
+        }
+      else
+        {
+          lo = mid + 1;
+        }
+    }
+  return lo;
+}
+
+void
+TcpRxBuffer::InsertBlock (uint32_t i, const SequenceNumber32 &head, Ptr<Packet> p)
+{
+  m_blocks.insert (m_blocks.begin () + i, Block ());
+  Block &block = m_blocks[i];
+  std::swap (block.packets, m_spareRing);
+  block.head = head;
+  block.tail = head + SequenceNumber32 (p->GetSize ());
+  block.packets.PushBack (p);
+}
+
+void
+TcpRxBuffer::RemoveBlock (uint32_t i)
+{
+  m_blocks[i].packets.Clear ();
+  std::swap (m_blocks[i].packets, m_spareRing);
+  m_blocks.erase (m_blocks.begin () + i);
+}
+
+void
+TcpRxBuffer::MergeBlocks (uint32_t i)
+{
+  Block &block = m_blocks[i];
+  Block &next = m_blocks[i + 1];
+  NS_ASSERT (block.tail == next.head);
+  if (block.packets.GetSize () >= next.packets.GetSize ())
+    {
+      for (uint32_t j = 0; j < next.packets.GetSize (); ++j)
+        {
+          block.packets.PushBack (next.packets[j]);
+        }
+    }
+  else
+    {
+      for (uint32_t j = block.packets.GetSize (); j > 0; --j)
+        {
+          next.packets.PushFront (block.packets[j - 1]);
+        }
+      std::swap (block.packets, next.packets);
+    }
+  block.tail = next.tail;
+  RemoveBlock (i + 1);
+}
+
 uint32_t
 TcpRxBuffer::GetSackListSize () const
 {
@@ -275,9 +353,22 @@ TcpRxBuffer::UpdateSackList (const SequenceNumber32 &head, const SequenceNumber3
   m_sackList.push_front (current);
 
   // We have inserted the block at the beginning of the list. Now, we should
-  // check if any existing blocks overlap with that.
+  // check if any existing blocks overlap with that: the ones inside it are
+  // no longer distinct, and the adjacent ones are merged.
   bool updated = false;
   TcpOptionSack::SackList::iterator it = m_sackList.begin ();
+  for (++it; it != m_sackList.end (); )
+    {
+      if (it->first >= head && it->second <= tail)
+        {
+          it = m_sackList.erase (it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+  it = m_sackList.begin ();
   TcpOptionSack::SackBlock begin = *it;
   TcpOptionSack::SackBlock merged;
   ++it;
@@ -328,9 +419,8 @@ TcpRxBuffer::UpdateSackList (const SequenceNumber32 &head, const SequenceNumber3
     }
 
   // Please note that, if a block b is discarded and then a block contiguos
-  // to b is received, only that new block (without the b part) is reported.
-  // This is perfectly fine for the RFC point (a), given that we do not report any
-  // overlapping blocks shortly after.
+  // to b is received, b is reported again as part of the new block, given
+  // that the first block covers all the contiguous data around the segment.
 }
 
 void
@@ -369,41 +459,61 @@ TcpRxBuffer::Extract (uint32_t maxSize)
   uint32_t extractSize = std::min (maxSize, m_availBytes);
   NS_LOG_LOGIC ("Requested to extract " << extractSize << " bytes from TcpRxBuffer of size=" << m_size);
   if (extractSize == 0) return 0;  // No contiguous block to return
-  NS_ASSERT (m_data.size ()); // At least we have something to extract
-  Ptr<Packet> outPkt = Create<Packet> (); // The packet that contains all the data to return
-  BufIterator i;
-  while (extractSize)
-    { // Check the buffered data for delivery
-      i = m_data.begin ();
-      NS_ASSERT (i->first <= m_nextRxSeq); // in-sequence data expected
-      // Check if we send the whole pkt or just a partial
-      uint32_t pktSize = i->second->GetSize ();
-      if (pktSize <= extractSize)
-        { // Whole packet is extracted
-          outPkt->AddAtEnd (i->second);
-          m_data.erase (i);
-          m_size -= pktSize;
-          m_availBytes -= pktSize;
-          extractSize -= pktSize;
-        }
-      else
-        { // Partial is extracted and done
-          outPkt->AddAtEnd (i->second->CreateFragment (0, extractSize));
-          m_data[i->first + SequenceNumber32 (extractSize)] = i->second->CreateFragment (extractSize, pktSize - extractSize);
-          m_data.erase (i);
-          m_size -= extractSize;
-          m_availBytes -= extractSize;
-          extractSize = 0;
-        }
-    }
-  if (outPkt->GetSize () == 0)
+  // The first packet is returned as it is, when it holds all the data
+  Ptr<Packet> outPkt = ExtractPacket (extractSize);
+  while (outPkt->GetSize () < extractSize)
     {
-      NS_LOG_LOGIC ("Nothing extracted.");
-      return 0;
+      outPkt->AddAtEnd (ExtractPacket (extractSize - outPkt->GetSize ()));
     }
   NS_LOG_LOGIC ("Extracted " << outPkt->GetSize ( ) << " bytes, bufsize=" << m_size
-                             << ", num pkts in buffer=" << m_data.size ());
+                             << ", num blocks in buffer=" << m_blocks.size ());
   return outPkt;
 }
 
+uint32_t
+TcpRxBuffer::ExtractChain (uint32_t maxSize, PacketChain &chain)
+{
+  NS_LOG_FUNCTION (this << maxSize);
+
+  uint32_t extractSize = std::min (maxSize, m_availBytes);
+  NS_LOG_LOGIC ("Requested to extract " << extractSize << " bytes from TcpRxBuffer of size=" << m_size);
+  uint32_t extracted = 0;
+  while (extracted < extractSize)
+    {
+      chain.push_back (ExtractPacket (extractSize - extracted));
+      extracted += chain.back ()->GetSize ();
+    }
+  NS_LOG_LOGIC ("Extracted " << extracted << " bytes, bufsize=" << m_size
+                             << ", num blocks in buffer=" << m_blocks.size ());
+  return extracted;
+}
+
+Ptr<Packet>
+TcpRxBuffer::ExtractPacket (uint32_t maxSize)
+{
+  NS_ASSERT (m_blocks.size ()); // At least we have something to extract
+  Block &block = m_blocks.front ();
+  NS_ASSERT (block.head <= m_nextRxSeq); // in-sequence data expected
+  Ptr<Packet> p = block.packets.Front ();
+  uint32_t pktSize = p->GetSize ();
+  if (pktSize <= maxSize)
+    { // Whole packet is extracted
+      block.packets.PopFront ();
+    }
+  else
+    { // Partial is extracted, the rest stays in the buffer
+      block.packets.Front () = p->CreateFragment (maxSize, pktSize - maxSize);
+      p = p->CreateFragment (0, maxSize);
+      pktSize = maxSize;
+    }
+  block.head += pktSize;
+  m_size -= pktSize;
+  m_availBytes -= pktSize;
+  if (block.packets.IsEmpty ())
+    {
+      RemoveBlock (0);
+    }
+  return p;
+}
+
 } //namepsace ns3
@@ -21,13 +21,14 @@
 #ifndef TCP_RX_BUFFER_H
 #define TCP_RX_BUFFER_H
 
-#include <map>
+#include <vector>
 #include "ns3/traced-value.h"
 #include "ns3/trace-source-accessor.h"
 #include "ns3/sequence-number.h"
 #include "ns3/ptr.h"
 #include "ns3/tcp-header.h"
 #include "ns3/tcp-option-sack.h"
+#include "segment-ring.h"
 
 namespace ns3 {
 class Packet;
@@ -51,7 +52,12 @@ class Packet;
  * by the method Available.
  *
  * To store data, use Add; for retrieving a certain amount of ordered data, use
- * the method Extract.
+ * the method Extract, or ExtractChain to get the packets as they were stored.
+ *
+ * The data is kept as a sorted vector of disjoint blocks of contiguous bytes,
+ * each holding its packets in a ring: a segment that fills a hole is appended
+ * or prepended to its neighbours, which are merged, so that the cost of Add
+ * depends on the number of holes and not on the number of segments buffered.
  *
  * SACK list
  * ---------
@@ -158,6 +164,24 @@ public:
    */
   Ptr<Packet> Extract (uint32_t maxSize);
 
+  /**
+   * \brief A chain of packets, in sequence order.
+   */
+  typedef std::vector<Ptr<Packet> > PacketChain;
+
+  /**
+   * Extract data from the head of the buffer, as the packets it is stored in.
+   *
+   * Unlike Extract, the packets are not copied into a single one: they are
+   * appended to the chain as they are, and only the last one is fragmented
+   * if it does not fit in maxSize.
+   *
+   * \param maxSize maximum number of bytes to extract
+   * \param chain the chain to append the packets to
+   * \returns the number of bytes extracted
+   */
+  uint32_t ExtractChain (uint32_t maxSize, PacketChain &chain);
+
   /**
    * \brief Get the sack list
    *
@@ -209,17 +233,63 @@ private:
    */
   void ClearSackList (const SequenceNumber32 &seq);
 
+  /**
+   * \brief A block of contiguous data.
+   */
+  struct Block
+  {
+    SequenceNumber32 head;             //!< Sequence number of the first byte
+    SequenceNumber32 tail;             //!< Sequence number after the last byte
+    SegmentRing<Ptr<Packet> > packets; //!< The packets, in sequence order
+  };
+
+  /**
+   * \brief Find the first block that ends after a sequence number.
+   * \param seq the sequence number
+   * \return the position of the block, or the number of blocks if none
+   */
+  uint32_t FindBlock (const SequenceNumber32 &seq) const;
+
+  /**
+   * \brief Insert a block, keeping the packet ring of the last removed one.
+   * \param i the position of the block
+   * \param head sequence number of the first byte
+   * \param p the packet
+   */
+  void InsertBlock (uint32_t i, const SequenceNumber32 &head, Ptr<Packet> p);
+
+  /**
+   * \brief Remove a block, keeping its packet ring for the next one.
+   * \param i the position of the block
+   */
+  void RemoveBlock (uint32_t i);
+
+  /**
+   * \brief Merge a block with the next one, which starts where it ends.
+   *
+   * The packets of the smaller block are moved to the larger one.
+   *
+   * \param i the position of the block
+   */
+  void MergeBlocks (uint32_t i);
+
+  /**
+   * \brief Remove the next in-order packet, or its head.
+   * \param maxSize maximum number of bytes to remove
+   * \return the packet, of at most maxSize bytes
+   */
+  Ptr<Packet> ExtractPacket (uint32_t maxSize);
+
   TcpOptionSack::SackList m_sackList; //!< Sack list (updated constantly)
 
-  /// container for data stored in the buffer
-  typedef std::map<SequenceNumber32, Ptr<Packet> >::iterator BufIterator;
   TracedValue<SequenceNumber32> m_nextRxSeq; //!< Seqnum of the first missing byte in data (RCV.NXT)
   SequenceNumber32 m_finSeq;                 //!< Seqnum of the FIN packet
   bool m_gotFin;                             //!< Did I received FIN packet?
   uint32_t m_size;                           //!< Number of total data bytes in the buffer, not necessarily contiguous
   uint32_t m_maxBuffer;                      //!< Upper bound of the number of data bytes in buffer (RCV.WND)
   uint32_t m_availBytes;                     //!< Number of bytes available to read, i.e. contiguous block at head
-  std::map<SequenceNumber32, Ptr<Packet> > m_data; //!< Corresponding data (may be null)
+  std::vector<Block> m_blocks;               //!< Corresponding data, as disjoint blocks in sequence order
+  SegmentRing<Ptr<Packet> > m_spareRing;     //!< Packet ring of the last removed block, to reuse
 };
 
 } //namepsace ns3
@@ -27,6 +27,7 @@
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/log.h"
+#include "ns3/log-event.h"
 #include "ns3/ipv4.h"
 #include "ns3/ipv6.h"
 #include "ns3/ipv4-interface-address.h"
@@ -53,6 +54,8 @@
 #include "tcp-option-sack.h"
 #include "rtt-estimator.h"
 #include "tcp-congestion-ops.h"
+#include "tcp-rate-ops.h"
+#include "tcp-gso.h"
 
 #include <math.h>
 #include <algorithm>
@@ -63,6 +66,9 @@ NS_LOG_COMPONENT_DEFINE ("TcpSocketBase");
 
 NS_OBJECT_ENSURE_REGISTERED (TcpSocketBase);
 
+/// Largest super-segment payload that fits in an IPv4 packet with the longest headers
+static const uint32_t GSO_MAX_PAYLOAD = 65535 - 60 - 60;
+
 TypeId
 TcpSocketBase::GetTypeId (void)
 {
@@ -135,6 +141,37 @@ TcpSocketBase::GetTypeId (void)
                    BooleanValue (true),
                    MakeBooleanAccessor (&TcpSocketBase::m_limitedTx),
                    MakeBooleanChecker ())
+    .AddAttribute ("UseEcn", "Ask for Explicit Congestion Notification (RFC 3168)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_useEcn),
+                   MakeBooleanChecker ())
+    .AddAttribute ("GsoMaxSize",
+                   "Largest payload handed to IPv4 in one TCP super-segment, "
+                   "cut in segments by the device or by IPv4 (0 to disable)",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&TcpSocketBase::m_gsoMaxSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Pacing", "Spread the segments of new data sent over the RTT "
+                   "(retransmissions are not paced)",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&TcpSocketBase::m_pacing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PacingRate",
+                   "Fixed pacing rate (0 to derive it from cWnd and RTT, "
+                   "or to let the congestion control set it)",
+                   DataRateValue (DataRate (0)),
+                   MakeDataRateAccessor (&TcpSocketBase::m_pacingRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("PacingSsRatio",
+                   "Pacing rate in slow start, in percent of cWnd per RTT",
+                   UintegerValue (200),
+                   MakeUintegerAccessor (&TcpSocketBase::m_pacingSsRatio),
+                   MakeUintegerChecker<uint16_t> (1))
+    .AddAttribute ("PacingCaRatio",
+                   "Pacing rate in congestion avoidance, in percent of cWnd per RTT",
+                   UintegerValue (120),
+                   MakeUintegerAccessor (&TcpSocketBase::m_pacingCaRatio),
+                   MakeUintegerChecker<uint16_t> (1))
     .AddTraceSource ("RTO",
                      "Retransmission timeout",
                      MakeTraceSourceAccessor (&TcpSocketBase::m_rto),
@@ -233,6 +270,10 @@ TcpSocketState::GetTypeId (void)
                      "Next sequence number to send (SND.NXT)",
                      MakeTraceSourceAccessor (&TcpSocketState::m_nextTxSequence),
                      "ns3::SequenceNumber32TracedValueCallback")
+    .AddTraceSource ("EcnState",
+                     "ECN state of the sender",
+                     MakeTraceSourceAccessor (&TcpSocketState::m_ecnState),
+                     "ns3::TcpSocketState::EcnStatesTracedValueCallback")
   ;
   return tid;
 }
@@ -250,7 +291,11 @@ TcpSocketState::TcpSocketState (void)
     // Change m_nextTxSequence for non-zero initial sequence number
     m_nextTxSequence (0),
     m_rcvTimestampValue (0),
-    m_rcvTimestampEchoReply (0)
+    m_rcvTimestampEchoReply (0),
+    m_pacingRate (0),
+    m_minRtt (Time::Max ()),
+    m_lastRttSample (0),
+    m_ecnState (ECN_DISABLED)
 {
 }
 
@@ -266,7 +311,11 @@ TcpSocketState::TcpSocketState (const TcpSocketState &other)
     m_highTxMark (other.m_highTxMark),
     m_nextTxSequence (other.m_nextTxSequence),
     m_rcvTimestampValue (other.m_rcvTimestampValue),
-    m_rcvTimestampEchoReply (other.m_rcvTimestampEchoReply)
+    m_rcvTimestampEchoReply (other.m_rcvTimestampEchoReply),
+    m_pacingRate (other.m_pacingRate),
+    m_minRtt (other.m_minRtt),
+    m_lastRttSample (other.m_lastRttSample),
+    m_ecnState (other.m_ecnState)
 {
 }
 
@@ -276,6 +325,12 @@ TcpSocketState::TcpCongStateName[TcpSocketState::CA_LAST_STATE] =
   "CA_OPEN", "CA_DISORDER", "CA_CWR", "CA_RECOVERY", "CA_LOSS"
 };
 
+const char* const
+TcpSocketState::EcnStateName[TcpSocketState::ECN_LAST_STATE] =
+{
+  "ECN_DISABLED", "ECN_IDLE", "ECN_ECE_RCVD", "ECN_CWR_SENT"
+};
+
 TcpSocketBase::TcpSocketBase (void)
   : TcpSocket (),
     m_retxEvent (),
@@ -302,6 +357,7 @@ TcpSocketBase::TcpSocketBase (void)
     m_endPoint6 (0),
     m_node (0),
     m_tcp (0),
+    m_socketIndex (NOT_LISTED),
     m_rtt (0),
     m_rxBuffer (0),
     m_txBuffer (0),
@@ -331,6 +387,17 @@ TcpSocketBase::TcpSocketBase (void)
     m_recover (0),
     m_retxThresh (3),
     m_limitedTx (false),
+    m_useEcn (false),
+    m_ecnEcho (false),
+    m_ceReceived (false),
+    m_ecnRecover (0),
+    m_gsoMaxSize (0),
+    m_pacing (false),
+    m_pacingRate (0),
+    m_pacingSsRatio (200),
+    m_pacingCaRatio (120),
+    m_pacingNextTime (0),
+    m_pacingPending (false),
     m_congestionControl (0),
     m_isFirstPartialAck (true)
 {
@@ -384,6 +451,7 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
     m_endPoint6 (0),
     m_node (sock.m_node),
     m_tcp (sock.m_tcp),
+    m_socketIndex (NOT_LISTED),
     m_state (sock.m_state),
     m_errno (sock.m_errno),
     m_closeNotified (sock.m_closeNotified),
@@ -407,9 +475,21 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
     m_recover (sock.m_recover),
     m_retxThresh (sock.m_retxThresh),
     m_limitedTx (sock.m_limitedTx),
+    m_useEcn (sock.m_useEcn),
+    m_ecnEcho (false),
+    m_ceReceived (false),
+    m_ecnRecover (sock.m_ecnRecover),
+    m_gsoMaxSize (sock.m_gsoMaxSize),
+    m_pacing (sock.m_pacing),
+    m_pacingRate (sock.m_pacingRate),
+    m_pacingSsRatio (sock.m_pacingSsRatio),
+    m_pacingCaRatio (sock.m_pacingCaRatio),
+    m_pacingNextTime (0),
+    m_pacingPending (false),
     m_isFirstPartialAck (sock.m_isFirstPartialAck),
     m_txTrace (sock.m_txTrace),
-    m_rxTrace (sock.m_rxTrace)
+    m_rxTrace (sock.m_rxTrace),
+    m_eventTrace (sock.m_eventTrace)
 {
   NS_LOG_FUNCTION (this);
   NS_LOG_LOGIC ("Invoked the copy constructor");
@@ -432,7 +512,12 @@ TcpSocketBase::TcpSocketBase (const TcpSocketBase& sock)
   if (sock.m_congestionControl)
     {
       m_congestionControl = sock.m_congestionControl->Fork ();
+      if (m_congestionControl->HasCongControl ())
+        {
+          m_rateOps = CreateObject<TcpRateOps> ();
+        }
     }
+  m_txBuffer->SetRateOps (m_rateOps);
 
   bool ok;
 
@@ -1149,6 +1234,7 @@ TcpSocketBase::ForwardUp (Ptr<Packet> packet, Ipv4Header header, uint16_t port,
   Address toAddress = InetSocketAddress (header.GetDestination (),
                                          m_endPoint->GetLocalPort ());
 
+  m_ceReceived = header.GetEcn () == Ipv4Header::ECN_CE;
   DoForwardUp (packet, fromAddress, toAddress);
 }
 
@@ -1166,6 +1252,7 @@ TcpSocketBase::ForwardUp6 (Ptr<Packet> packet, Ipv6Header header, uint16_t port,
   Address toAddress = Inet6SocketAddress (header.GetDestinationAddress (),
                                           m_endPoint6->GetLocalPort ());
 
+  m_ceReceived = header.GetEcn () == Ipv6Header::ECN_CE;
   DoForwardUp (packet, fromAddress, toAddress);
 }
 
@@ -1331,7 +1418,8 @@ TcpSocketBase::DoForwardUp (Ptr<Packet> packet, const Address &fromAddress,
       break;
     case CLOSED:
       // Send RST if the incoming packet is not a RST
-      if ((tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG)) != TcpHeader::RST)
+      if ((tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                     | TcpHeader::ECE | TcpHeader::CWR)) != TcpHeader::RST)
         { // Since m_endPoint is not configured yet, we cannot use SendRST here
           TcpHeader h;
           Ptr<Packet> p = Create<Packet> ();
@@ -1384,8 +1472,10 @@ TcpSocketBase::ProcessEstablished (Ptr<Packet> packet, const TcpHeader& tcpHeade
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   // Different flags are different events
   if (tcpflags == TcpHeader::ACK)
@@ -1537,7 +1627,11 @@ TcpSocketBase::EnterRecovery ()
   // (4.2) ssthresh = cwnd = (FlightSize / 2)
   m_tcb->m_ssThresh = m_congestionControl->GetSsThresh (m_tcb,
                                                         BytesInFlight ());
-  if (m_sackEnabled)
+  if (m_congestionControl->HasCongControl ())
+    {
+      // cWnd is set by CongControl, once the ACK is processed
+    }
+  else if (m_sackEnabled)
     {
       m_tcb->m_cWnd = m_tcb->m_ssThresh;
     }
@@ -1557,6 +1651,40 @@ TcpSocketBase::EnterRecovery ()
   // the step C is done after the ProcessAck function (SendPendingData)
 }
 
+void
+TcpSocketBase::EnterCwr ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT (m_tcb->m_congState == TcpSocketState::CA_OPEN);
+
+  NS_LOG_DEBUG ("CA_OPEN -> CA_CWR");
+
+  // RFC 3168, Section 6.1.2: the echoes of the data sent so far are
+  // answered by this reduction
+  m_ecnRecover = m_tcb->m_highTxMark;
+
+  m_congestionControl->CongestionStateSet (m_tcb, TcpSocketState::CA_CWR);
+  m_tcb->m_congState = TcpSocketState::CA_CWR;
+
+  m_tcb->m_ssThresh = m_congestionControl->GetSsThresh (m_tcb, BytesInFlight ());
+  if (!m_congestionControl->HasCongControl ())
+    {
+      m_tcb->m_cWnd = m_tcb->m_ssThresh;
+    }
+
+  NS_LOG_DEBUG (TcpSocketState::EcnStateName[m_tcb->m_ecnState] << " -> ECN_ECE_RCVD");
+  m_tcb->m_ecnState = TcpSocketState::ECN_ECE_RCVD;
+
+  NS_LOG_INFO ("ECN echo. Reset cwnd to " << m_tcb->m_cWnd << ", ssthresh to " <<
+               m_tcb->m_ssThresh << " until seqnum " << m_ecnRecover);
+}
+
+bool
+TcpSocketBase::EcnRequested (void) const
+{
+  return m_useEcn || (m_congestionControl && m_congestionControl->NeedsEcn ());
+}
+
 void
 TcpSocketBase::DupAck ()
 {
@@ -1566,16 +1694,19 @@ TcpSocketBase::DupAck ()
   // NOTE: We count also the dupAcks received in CA_RECOVERY
   ++m_dupAckCount;
 
-  if (m_tcb->m_congState == TcpSocketState::CA_OPEN)
+  if (m_tcb->m_congState == TcpSocketState::CA_OPEN
+      || m_tcb->m_congState == TcpSocketState::CA_CWR)
     {
-      // From Open we go Disorder
-      NS_ASSERT_MSG (m_dupAckCount == 1, "From OPEN->DISORDER but with " <<
-                     m_dupAckCount << " dup ACKs");
+      // From Open (or CWR, as the window is already reduced) we go Disorder
+      NS_ASSERT_MSG (m_dupAckCount == 1, "From " <<
+                     TcpSocketState::TcpCongStateName[m_tcb->m_congState] <<
+                     "->DISORDER but with " << m_dupAckCount << " dup ACKs");
+
+      NS_LOG_DEBUG (TcpSocketState::TcpCongStateName[m_tcb->m_congState] <<
+                    " -> DISORDER");
 
       m_congestionControl->CongestionStateSet (m_tcb, TcpSocketState::CA_DISORDER);
       m_tcb->m_congState = TcpSocketState::CA_DISORDER;
-
-      NS_LOG_DEBUG ("OPEN -> DISORDER");
     }
 
   if (!m_sackEnabled && m_tcb->m_congState == TcpSocketState::CA_RECOVERY)
@@ -1642,6 +1773,12 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
   // RFC 6675, Section 5, 1st paragraph:
   // Upon the receipt of any ACK containing SACK information, the
   // scoreboard MUST be updated via the Update () routine (done in ReadOptions)
+  uint32_t priorInFlight = 0;
+  if (m_rateOps)
+    {
+      priorInFlight = BytesInFlight ();
+    }
+
   bool scoreboardUpdated = false;
   ReadOptions (tcpHeader, scoreboardUpdated);
 
@@ -1651,6 +1788,38 @@ TcpSocketBase::ReceivedAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
   // are inside the function ProcessAck
   ProcessAck (ackNumber, scoreboardUpdated);
 
+  bool ece = m_tcb->m_ecnState != TcpSocketState::ECN_DISABLED
+    && (tcpHeader.GetFlags () & TcpHeader::ECE);
+  m_congestionControl->InAckEvent (m_tcb, ece);
+  if (ece)
+    {
+      // RFC 3168, Section 6.1.2: react at most once per window of data, and
+      // not in loss recovery, which reduces the window already
+      if (m_tcb->m_congState == TcpSocketState::CA_OPEN && ackNumber > m_ecnRecover)
+        {
+          EnterCwr ();
+        }
+    }
+  else if (m_tcb->m_ecnState == TcpSocketState::ECN_CWR_SENT)
+    { // The receiver stopped echoing
+      NS_LOG_DEBUG ("ECN_CWR_SENT -> ECN_IDLE");
+      m_tcb->m_ecnState = TcpSocketState::ECN_IDLE;
+    }
+
+  // The segments delivered by the ACK are accounted for by the rate
+  // estimator, in the Tx buffer
+  if (m_rateOps)
+    {
+      TcpRateOps::TcpRateSample rs = m_rateOps->GenerateSample (priorInFlight, BytesInFlight (),
+                                                                m_tcb->m_minRtt);
+      m_congestionControl->CongControl (m_tcb, m_rateOps->GetConnectionRate (), rs);
+    }
+
+  if (m_eventTrace)
+    {
+      RecordEvent (EventTraceRecord::ACK, tcpHeader.GetSequenceNumber (), ackNumber);
+    }
+
   // RFC 6675, Section 5, point (C), try to send more data. NB: (C) is implemented
   // inside SendPendingData
   SendPendingData (m_connected);
@@ -1702,10 +1871,9 @@ TcpSocketBase::ProcessAck (const SequenceNumber32 &ackNumber, bool scoreboardUpd
       (!m_sackEnabled && ackNumber == m_txBuffer->HeadSequence ()
        && ackNumber < m_tcb->m_nextTxSequence))
     {
-      NS_LOG_DEBUG ("ACK of " << ackNumber <<
-                    " SND.UNA=" << m_txBuffer->HeadSequence () <<
-                    " SND.NXT=" << m_tcb->m_nextTxSequence <<
-                    " we are ready to process the dupAck");
+      NS_LOG_EVENT (LOG_DEBUG, "DUPACK", "ack", ackNumber,
+                    "SND.UNA", m_txBuffer->HeadSequence (),
+                    "SND.NXT", m_tcb->m_nextTxSequence.Get ());
       // loss recovery check is done inside this function thanks to
       // the congestion state machine
       DupAck ();
@@ -1835,6 +2003,19 @@ TcpSocketBase::ProcessAck (const SequenceNumber32 &ackNumber, bool scoreboardUpd
               NS_LOG_DEBUG (segsAcked << " segments acked in CA_DISORDER, ack of " <<
                             ackNumber << " exiting CA_DISORDER -> CA_OPEN");
             }
+          else if (m_tcb->m_congState == TcpSocketState::CA_CWR)
+            {
+              m_congestionControl->PktsAcked (m_tcb, segsAcked, m_lastRtt);
+
+              // The window sent before the reduction is acknowledged
+              if (ackNumber >= m_ecnRecover)
+                {
+                  m_congestionControl->CongestionStateSet (m_tcb, TcpSocketState::CA_OPEN);
+                  m_tcb->m_congState = TcpSocketState::CA_OPEN;
+                  NS_LOG_DEBUG (segsAcked << " segments acked in CA_CWR, ack of " <<
+                                ackNumber << ", exiting CA_CWR -> CA_OPEN");
+                }
+            }
           // RFC 6675, Section 5:
           // Once a TCP is in the loss recovery phase, the following procedure
           // MUST be used for each arriving ACK:
@@ -1910,8 +2091,10 @@ TcpSocketBase::ProcessListen (Ptr<Packet> packet, const TcpHeader& tcpHeader,
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   // Fork a socket if received a SYN. Do nothing otherwise.
   // C.f.: the LISTEN part in tcp_v4_do_rcv() in tcp_ipv4.c in Linux kernel
@@ -1939,8 +2122,10 @@ TcpSocketBase::ProcessSynSent (Ptr<Packet> packet, const TcpHeader& tcpHeader)
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   if (tcpflags == 0)
     { // Bare data, accept it and move to ESTABLISHED state. This is not a normal behaviour. Remove this?
@@ -1962,6 +2147,12 @@ TcpSocketBase::ProcessSynSent (Ptr<Packet> packet, const TcpHeader& tcpHeader)
       m_state = SYN_RCVD;
       m_synCount = m_synRetries;
       m_rxBuffer->SetNextRxSequence (tcpHeader.GetSequenceNumber () + SequenceNumber32 (1));
+      if (EcnRequested ()
+          && (tcpHeader.GetFlags () & (TcpHeader::ECE | TcpHeader::CWR)) == (TcpHeader::ECE | TcpHeader::CWR))
+        { // ECN-setup SYN, RFC 3168 Section 6.1.1
+          NS_LOG_DEBUG ("ECN_DISABLED -> ECN_IDLE");
+          m_tcb->m_ecnState = TcpSocketState::ECN_IDLE;
+        }
       SendEmptyPacket (TcpHeader::SYN | TcpHeader::ACK);
     }
   else if (tcpflags == (TcpHeader::SYN | TcpHeader::ACK)
@@ -1975,6 +2166,12 @@ TcpSocketBase::ProcessSynSent (Ptr<Packet> packet, const TcpHeader& tcpHeader)
       m_rxBuffer->SetNextRxSequence (tcpHeader.GetSequenceNumber () + SequenceNumber32 (1));
       m_tcb->m_highTxMark = ++m_tcb->m_nextTxSequence;
       m_txBuffer->SetHeadSequence (m_tcb->m_nextTxSequence);
+      if (EcnRequested ()
+          && (tcpHeader.GetFlags () & (TcpHeader::ECE | TcpHeader::CWR)) == TcpHeader::ECE)
+        { // ECN-setup SYN+ACK, RFC 3168 Section 6.1.1
+          NS_LOG_DEBUG ("ECN_DISABLED -> ECN_IDLE");
+          m_tcb->m_ecnState = TcpSocketState::ECN_IDLE;
+        }
       SendEmptyPacket (TcpHeader::ACK);
       SendPendingData (m_connected);
       Simulator::ScheduleNow (&TcpSocketBase::ConnectionSucceeded, this);
@@ -2001,8 +2198,10 @@ TcpSocketBase::ProcessSynRcvd (Ptr<Packet> packet, const TcpHeader& tcpHeader,
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   if (tcpflags == 0
       || (tcpflags == TcpHeader::ACK
@@ -2093,8 +2292,10 @@ TcpSocketBase::ProcessWait (Ptr<Packet> packet, const TcpHeader& tcpHeader)
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   if (packet->GetSize () > 0 && !(tcpflags & TcpHeader::ACK))
     { // Bare data, accept it
@@ -2165,8 +2366,10 @@ TcpSocketBase::ProcessClosing (Ptr<Packet> packet, const TcpHeader& tcpHeader)
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   if (tcpflags == TcpHeader::ACK)
     {
@@ -2197,8 +2400,10 @@ TcpSocketBase::ProcessLastAck (Ptr<Packet> packet, const TcpHeader& tcpHeader)
 {
   NS_LOG_FUNCTION (this << tcpHeader);
 
-  // Extract the flags. PSH and URG are not honoured.
-  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG);
+  // Extract the flags. PSH and URG are not honoured, ECE and CWR are
+  // handled apart from the state machine.
+  uint8_t tcpflags = tcpHeader.GetFlags () & ~(TcpHeader::PSH | TcpHeader::URG
+                                               | TcpHeader::ECE | TcpHeader::CWR);
 
   if (tcpflags == 0)
     {
@@ -2400,7 +2605,26 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
       ++s;
     }
 
-  header.SetFlags (flags);
+  // RFC 3168, Section 6.1.1: an ECN-setup SYN carries ECE and CWR, an
+  // ECN-setup SYN+ACK carries ECE only. Then ECE echoes the CE marks.
+  uint8_t ecnFlags = 0;
+  if ((flags & TcpHeader::SYN) && EcnRequested ())
+    {
+      if ((flags & TcpHeader::ACK) == 0)
+        {
+          ecnFlags = TcpHeader::ECE | TcpHeader::CWR;
+        }
+      else if (m_tcb->m_ecnState != TcpSocketState::ECN_DISABLED)
+        {
+          ecnFlags = TcpHeader::ECE;
+        }
+    }
+  else if ((flags & TcpHeader::ACK) && m_ecnEcho)
+    {
+      ecnFlags = TcpHeader::ECE;
+    }
+
+  header.SetFlags (flags | ecnFlags);
   header.SetSequenceNumber (s);
   header.SetAckNumber (m_rxBuffer->NextRxSequence ());
   if (m_endPoint != 0)
@@ -2479,8 +2703,7 @@ TcpSocketBase::SendEmptyPacket (uint8_t flags)
 
   if (m_endPoint != 0)
     {
-      m_tcp->SendPacket (p, header, m_endPoint->GetLocalAddress (),
-                         m_endPoint->GetPeerAddress (), m_boundnetdevice);
+      m_tcp->SendPacket (p, header, m_endPoint, m_boundnetdevice);
     }
   else
     {
@@ -2628,6 +2851,13 @@ TcpSocketBase::CompleteFork (Ptr<Packet> p, const TcpHeader& h,
   // Set the sequence number and send SYN+ACK
   m_rxBuffer->SetNextRxSequence (h.GetSequenceNumber () + SequenceNumber32 (1));
 
+  if (EcnRequested ()
+      && (h.GetFlags () & (TcpHeader::ECE | TcpHeader::CWR)) == (TcpHeader::ECE | TcpHeader::CWR))
+    { // ECN-setup SYN, RFC 3168 Section 6.1.1
+      NS_LOG_DEBUG ("ECN_DISABLED -> ECN_IDLE");
+      m_tcb->m_ecnState = TcpSocketState::ECN_IDLE;
+    }
+
   SendEmptyPacket (TcpHeader::SYN | TcpHeader::ACK);
 }
 
@@ -2658,8 +2888,25 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       isRetransmission = true;
     }
 
-  Ptr<Packet> p = m_txBuffer->CopyFromSequence (maxSize, seq);
+  Ptr<Packet> p = m_txBuffer->CopyFromSequence (std::min (maxSize, m_tcb->m_segmentSize), seq);
   uint32_t sz = p->GetSize (); // Size of packet
+  while (sz < maxSize && sz % m_tcb->m_segmentSize == 0 && sz > 0)
+    {
+      // A super-segment: copy it one segment at a time, so that the
+      // buffer keeps track of each segment (e.g., for SACK)
+      Ptr<Packet> segment = m_txBuffer->CopyFromSequence (std::min (maxSize - sz, m_tcb->m_segmentSize),
+                                                          seq + SequenceNumber32 (sz));
+      if (segment->GetSize () == 0)
+        {
+          break;
+        }
+      p->AddAtEnd (segment);
+      sz += segment->GetSize ();
+    }
+  if (sz > m_tcb->m_segmentSize)
+    {
+      p->AddPacketTag (TcpGsoTag (m_tcb->m_segmentSize));
+    }
   uint8_t flags = withAck ? TcpHeader::ACK : 0;
   uint32_t remainingData = m_txBuffer->SizeFromSequence (seq + SequenceNumber32 (sz));
 
@@ -2669,23 +2916,37 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
       m_delAckCount = 0;
     }
 
+  // With ECN, new data is sent ECN-capable; retransmissions are not
+  // (RFC 3168, Section 6.1.5)
+  bool isEct = m_tcb->m_ecnState != TcpSocketState::ECN_DISABLED && !isRetransmission;
+
   /*
    * Add tags for each socket option.
    * Note that currently the socket adds both IPv4 tag and IPv6 tag
    * if both options are set. Once the packet got to layer three, only
    * the corresponding tags will be read.
    */
-  if (GetIpTos ())
+  uint8_t tos = GetIpTos ();
+  if (isEct)
+    {
+      tos = (tos & ~0x3) | Ipv4Header::ECN_ECT0;
+    }
+  if (tos)
     {
       SocketIpTosTag ipTosTag;
-      ipTosTag.SetTos (GetIpTos ());
+      ipTosTag.SetTos (tos);
       p->AddPacketTag (ipTosTag);
     }
 
-  if (IsManualIpv6Tclass ())
+  if (IsManualIpv6Tclass () || isEct)
     {
+      uint8_t tclass = GetIpv6Tclass ();
+      if (isEct)
+        {
+          tclass = (tclass & ~0x3) | Ipv6Header::ECN_ECT0;
+        }
       SocketIpv6TclassTag ipTclassTag;
-      ipTclassTag.SetTclass (GetIpv6Tclass ());
+      ipTclassTag.SetTclass (tclass);
       p->AddPacketTag (ipTclassTag);
     }
 
@@ -2725,6 +2986,16 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
           m_state = LAST_ACK;
         }
     }
+  if (m_tcb->m_ecnState == TcpSocketState::ECN_ECE_RCVD && !isRetransmission)
+    { // Tell the receiver that the window was reduced
+      NS_LOG_DEBUG ("ECN_ECE_RCVD -> ECN_CWR_SENT");
+      flags |= TcpHeader::CWR;
+      m_tcb->m_ecnState = TcpSocketState::ECN_CWR_SENT;
+    }
+  if (withAck && m_ecnEcho)
+    {
+      flags |= TcpHeader::ECE;
+    }
   TcpHeader header;
   header.SetFlags (flags);
   header.SetSequenceNumber (seq);
@@ -2754,24 +3025,34 @@ TcpSocketBase::SendDataPacket (SequenceNumber32 seq, uint32_t maxSize, bool with
 
   m_txTrace (p, header, this);
 
+  if (m_eventTrace)
+    {
+      RecordEvent (EventTraceRecord::SENT, seq, header.GetAckNumber ());
+    }
+
   if (m_endPoint)
     {
-      m_tcp->SendPacket (p, header, m_endPoint->GetLocalAddress (),
-                         m_endPoint->GetPeerAddress (), m_boundnetdevice);
-      NS_LOG_DEBUG ("Send segment of size " << sz << " with remaining data " <<
-                    remainingData << " via TcpL4Protocol to " <<  m_endPoint->GetPeerAddress () <<
-                    ". Header " << header);
+      m_tcp->SendPacket (p, header, m_endPoint, m_boundnetdevice);
+      NS_LOG_EVENT (LOG_DEBUG, "SEND SEGMENT", "size", sz, "remaining", remainingData,
+                    "to", m_endPoint->GetPeerAddress (), "header", header);
     }
   else
     {
       m_tcp->SendPacket (p, header, m_endPoint6->GetLocalAddress (),
                          m_endPoint6->GetPeerAddress (), m_boundnetdevice);
-      NS_LOG_DEBUG ("Send segment of size " << sz << " with remaining data " <<
-                    remainingData << " via TcpL4Protocol to " <<  m_endPoint6->GetPeerAddress () <<
-                    ". Header " << header);
+      NS_LOG_EVENT (LOG_DEBUG, "SEND SEGMENT", "size", sz, "remaining", remainingData,
+                    "to", m_endPoint6->GetPeerAddress (), "header", header);
     }
 
-  UpdateRttHistory (seq, sz, isRetransmission);
+  // Keep one entry per segment, as if a super-segment was sent segment by segment
+  uint32_t offset = 0;
+  do
+    {
+      uint32_t count = std::min (sz - offset, m_tcb->m_segmentSize);
+      UpdateRttHistory (seq + SequenceNumber32 (offset), count, isRetransmission);
+      offset += count;
+    }
+  while (offset < sz);
 
   // Notify the application of the data being sent unless this is a retransmit
   if (seq + sz > m_tcb->m_highTxMark)
@@ -2824,6 +3105,11 @@ TcpSocketBase::SendPendingData (bool withAck)
       return false; // Is this the right way to handle this condition?
     }
 
+  if (m_pacing)
+    {
+      UpdatePacingRate ();
+    }
+
   uint32_t nPacketsSent = 0;
   uint32_t availableWindow = AvailableWindow ();
 
@@ -2854,6 +3140,18 @@ TcpSocketBase::SendPendingData (bool withAck)
         }
       else
         {
+          // Only new data is paced: retransmissions go out right away
+          if (m_pacing && next >= m_tcb->m_highTxMark.Get () && Simulator::Now () < m_pacingNextTime)
+            {
+              NS_LOG_LOGIC ("Paced: wait until " << m_pacingNextTime.GetSeconds ());
+              if (!m_pacingPending)
+                {
+                  m_pacingPending = true;
+                  m_tcp->GetPacingWheel ()->Schedule (this, m_pacingNextTime);
+                }
+              break;
+            }
+
           // It's time to transmit, but before do silly window and Nagle's check
           uint32_t availableData = m_txBuffer->SizeFromSequence (next);
 
@@ -2875,6 +3173,30 @@ TcpSocketBase::SendPendingData (bool withAck)
 
           uint32_t s = std::min (availableWindow, m_tcb->m_segmentSize);
 
+          // With segmentation offload, send as many whole segments of new
+          // data as possible in one super-segment (IPv4 only)
+          if (m_gsoMaxSize > 0 && m_endPoint != 0 && next == m_tcb->m_highTxMark)
+            {
+              uint32_t gsoSize = std::min (std::min (m_gsoMaxSize, GSO_MAX_PAYLOAD),
+                                           std::min (availableWindow, availableData));
+              if (gsoSize >= 2 * m_tcb->m_segmentSize)
+                {
+                  s = gsoSize - gsoSize % m_tcb->m_segmentSize;
+                }
+            }
+
+          // A paced super-segment does not carry more than a millisecond
+          // of data, so that pacing does not turn into bursts
+          if (m_pacing && s > m_tcb->m_segmentSize && m_tcb->m_pacingRate.GetBitRate () > 0)
+            {
+              uint64_t pacedSize = m_tcb->m_pacingRate.GetBitRate () / 8 / 1000;
+              if (pacedSize < s)
+                {
+                  s = std::max (m_tcb->m_segmentSize,
+                                static_cast<uint32_t> (pacedSize - pacedSize % m_tcb->m_segmentSize));
+                }
+            }
+
           // (C.2) If any of the data octets sent in (C.1) are below HighData,
           //       HighRxt MUST be set to the highest sequence number of the
           //       retransmitted segment unless NextSeg () rule (4) was
@@ -2892,6 +3214,12 @@ TcpSocketBase::SendPendingData (bool withAck)
           uint32_t sz = SendDataPacket (m_tcb->m_nextTxSequence, s, withAck);
           m_tcb->m_nextTxSequence += sz;
 
+          if (m_pacing && m_tcb->m_pacingRate.GetBitRate () > 0)
+            {
+              m_pacingNextTime = Simulator::Now ()
+                + m_tcb->m_pacingRate.CalculateBytesTxTime (sz);
+            }
+
           NS_LOG_LOGIC (" rxwin " << m_rWnd <<
                         " segsize " << m_tcb->m_segmentSize <<
                         " highestRxAck " << m_txBuffer->HeadSequence () <<
@@ -2917,6 +3245,12 @@ TcpSocketBase::SendPendingData (bool withAck)
       // loop again!
     }
 
+  if (m_rateOps)
+    {
+      m_rateOps->CalculateAppLimited (m_tcb->m_cWnd, BytesInFlight (), m_tcb->m_segmentSize,
+                                      m_txBuffer->TailSequence (), m_tcb->m_nextTxSequence);
+    }
+
   if (nPacketsSent > 0)
     {
       NS_LOG_DEBUG ("SendPendingData sent " << nPacketsSent << " segments");
@@ -2928,6 +3262,38 @@ TcpSocketBase::SendPendingData (bool withAck)
   return nPacketsSent;
 }
 
+void
+TcpSocketBase::UpdatePacingRate (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_pacingRate.GetBitRate () > 0)
+    {
+      m_tcb->m_pacingRate = m_pacingRate;
+      return;
+    }
+  if (m_congestionControl->SetsPacingRate () || m_rtt->GetNSamples () == 0)
+    {
+      return;
+    }
+  Time srtt = m_rtt->GetEstimate ();
+  if (!srtt.IsStrictlyPositive ())
+    {
+      return;
+    }
+  uint16_t ratio = m_tcb->m_cWnd < m_tcb->m_ssThresh ? m_pacingSsRatio : m_pacingCaRatio;
+  double rate = 8.0 * m_tcb->m_cWnd * ratio / 100 / srtt.GetSeconds ();
+  m_tcb->m_pacingRate = DataRate (static_cast<uint64_t> (rate));
+  NS_LOG_LOGIC ("Pacing rate " << m_tcb->m_pacingRate);
+}
+
+void
+TcpSocketBase::PacingRelease (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_pacingPending = false;
+  SendPendingData (m_connected);
+}
+
 uint32_t
 TcpSocketBase::UnAckDataCount () const
 {
@@ -3057,6 +3423,28 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
   NS_LOG_DEBUG ("Data segment, seq=" << tcpHeader.GetSequenceNumber () <<
                 " pkt size=" << p->GetSize () );
 
+  if (m_tcb->m_ecnState != TcpSocketState::ECN_DISABLED)
+    {
+      if (m_congestionControl->NeedsEcn ())
+        {
+          // Echo the mark of each segment: when it changes, the delayed
+          // ACK, if any, goes with the previous one
+          if (m_ceReceived != m_ecnEcho && m_delAckCount > 0)
+            {
+              SendEmptyPacket (TcpHeader::ACK);
+            }
+          m_ecnEcho = m_ceReceived;
+        }
+      else if (m_ceReceived)
+        { // RFC 3168, Section 6.1.3: echo until the sender reduced its window
+          m_ecnEcho = true;
+        }
+      else if (tcpHeader.GetFlags () & TcpHeader::CWR)
+        {
+          m_ecnEcho = false;
+        }
+    }
+
   // Put into Rx buffer
   SequenceNumber32 expectedSeq = m_rxBuffer->NextRxSequence ();
   if (!m_rxBuffer->Add (p, tcpHeader))
@@ -3091,6 +3479,11 @@ TcpSocketBase::ReceivedData (Ptr<Packet> p, const TcpHeader& tcpHeader)
     }
   else
     { // In-sequence packet: ACK if delayed ack count allows
+      TcpGsoTag gsoTag;
+      if (p->PeekPacketTag (gsoTag) && gsoTag.GetSegmentSize () > 0)
+        { // Segments merged by the device count one by one
+          m_delAckCount += (p->GetSize () - 1) / gsoTag.GetSegmentSize ();
+        }
       if (++m_delAckCount >= m_delAckMaxCount)
         {
           m_delAckEvent.Cancel ();
@@ -3152,9 +3545,13 @@ TcpSocketBase::EstimateRtt (const TcpHeader& tcpHeader)
       m_history.pop_front (); // Remove
     }
 
+  // Zero when the ACK gives no sample: duplicate ACKs, and ACKs of
+  // retransmitted data only (Karn's rule)
+  m_tcb->m_lastRttSample = m;
   if (!m.IsZero ())
     {
       m_rtt->Measurement (m);                // Log the measurement
+      m_tcb->m_minRtt = Min (m_tcb->m_minRtt, m);
       // RFC 6298, clause 2.4
       m_rto = Max (m_rtt->GetEstimate () + Max (m_clockGranularity, m_rtt->GetVariation () * 4), m_minRto);
       m_lastRtt = m_rtt->GetEstimate ();
@@ -3288,6 +3685,12 @@ TcpSocketBase::ReTxTimeout ()
   m_congestionControl->CongestionStateSet (m_tcb, TcpSocketState::CA_LOSS);
   m_tcb->m_congState = TcpSocketState::CA_LOSS;
 
+  if (m_eventTrace)
+    {
+      RecordEvent (EventTraceRecord::TIMEOUT, m_txBuffer->HeadSequence (),
+                   m_rxBuffer->NextRxSequence ());
+    }
+
   NS_LOG_DEBUG ("RTO. Reset cwnd to " <<  m_tcb->m_cWnd << ", ssthresh to " <<
                 m_tcb->m_ssThresh << ", restart from seqnum " <<
                 m_txBuffer->HeadSequence () << " doubled rto to " <<
@@ -3356,8 +3759,7 @@ TcpSocketBase::PersistTimeout ()
 
   if (m_endPoint != 0)
     {
-      m_tcp->SendPacket (p, tcpHeader, m_endPoint->GetLocalAddress (),
-                         m_endPoint->GetPeerAddress (), m_boundnetdevice);
+      m_tcp->SendPacket (p, tcpHeader, m_endPoint, m_boundnetdevice);
     }
   else
     {
@@ -3912,6 +4314,48 @@ TcpSocketBase::SetCongestionControlAlgorithm (Ptr<TcpCongestionOps> algo)
 {
   NS_LOG_FUNCTION (this << algo);
   m_congestionControl = algo;
+
+  // Sample the delivery rate only for the algorithms using it
+  m_rateOps = 0;
+  if (algo->HasCongControl ())
+    {
+      m_rateOps = CreateObject<TcpRateOps> ();
+    }
+  m_txBuffer->SetRateOps (m_rateOps);
+
+  // As in Linux, an algorithm setting the pacing rate turns pacing on
+  if (algo->SetsPacingRate ())
+    {
+      m_pacing = true;
+    }
+}
+
+void
+TcpSocketBase::SetEventTrace (Ptr<EventTraceRing> ring)
+{
+  NS_LOG_FUNCTION (this << ring);
+  m_eventTrace = ring;
+}
+
+void
+TcpSocketBase::RecordEvent (EventTraceRecord::Event event, SequenceNumber32 seq,
+                            SequenceNumber32 ack)
+{
+  uint32_t flowId = 0;
+  if (m_endPoint != 0)
+    {
+      flowId = EventTraceRecord::FlowId (m_endPoint->GetLocalAddress (), m_endPoint->GetLocalPort (),
+                                         m_endPoint->GetPeerAddress (), m_endPoint->GetPeerPort (),
+                                         TcpL4Protocol::PROT_NUMBER);
+    }
+  else if (m_endPoint6 != 0)
+    {
+      flowId = EventTraceRecord::FlowId (m_endPoint6->GetLocalAddress (), m_endPoint6->GetLocalPort (),
+                                         m_endPoint6->GetPeerAddress (), m_endPoint6->GetPeerPort (),
+                                         TcpL4Protocol::PROT_NUMBER);
+    }
+  m_eventTrace->Record (EventTraceRecord::TCP, event, flowId, m_tcb->m_congState,
+                        m_tcb->m_cWnd, seq.GetValue (), ack.GetValue ());
 }
 
 Ptr<TcpSocketBase>
@@ -33,6 +33,8 @@
 #include "ns3/ipv6-header.h"
 #include "ns3/ipv6-interface.h"
 #include "ns3/event-id.h"
+#include "ns3/event-trace.h"
+#include "ns3/data-rate.h"
 #include "tcp-tx-buffer.h"
 #include "tcp-rx-buffer.h"
 #include "rtt-estimator.h"
@@ -46,6 +48,7 @@ class Packet;
 class TcpL4Protocol;
 class TcpHeader;
 class TcpCongestionOps;
+class TcpRateOps;
 
 /**
  * \ingroup tcp
@@ -129,7 +132,7 @@ public:
                     *  we see some SACKs or dupacks. It is split of "Open" */
     CA_CWR,       /**< cWnd was reduced due to some Congestion Notification event.
                     *  It can be ECN, ICMP source quench, local device congestion.
-                    *  Not used in NS-3 right now. */
+                    *  In NS-3, it is entered on an ECN echo. */
     CA_RECOVERY,  /**< CWND was reduced, we are fast-retransmitting. */
     CA_LOSS,      /**< CWND was reduced due to RTO timeout or SACK reneging. */
     CA_LAST_STATE /**< Used only in debug messages */
@@ -150,6 +153,39 @@ public:
    */
   static const char* const TcpCongStateName[TcpSocketState::CA_LAST_STATE];
 
+  /**
+   * \brief Definition of the ECN state of the sender (RFC 3168)
+   *
+   * ECN is negotiated in the three-way handshake: a SYN with ECE and CWR
+   * asks for it, a SYN+ACK with ECE (and not CWR) accepts it. Then the data
+   * segments are sent ECN-capable (ECT), a router marks them (CE) instead
+   * of dropping them, the receiver echoes the mark back with ECE, and the
+   * sender confirms its reaction with CWR.
+   */
+  typedef enum
+  {
+    ECN_DISABLED = 0, /**< ECN was not negotiated */
+    ECN_IDLE,         /**< ECN was negotiated, no ECE to react to */
+    ECN_ECE_RCVD,     /**< The window was reduced for an ECE, CWR still to send */
+    ECN_CWR_SENT,     /**< CWR sent, ECE ignored until the receiver stops echoing */
+    ECN_LAST_STATE    /**< Used only in debug messages */
+  } EcnState_t;
+
+  /**
+   * \ingroup tcp
+   * TracedValue Callback signature for EcnState_t
+   *
+   * \param [in] oldValue original value of the traced variable
+   * \param [in] newValue new value of the traced variable
+   */
+  typedef void (* EcnStatesTracedValueCallback)(const EcnState_t oldValue,
+                                                const EcnState_t newValue);
+
+  /**
+   * \brief Literal names of ECN states for use in log messages
+   */
+  static const char* const EcnStateName[TcpSocketState::ECN_LAST_STATE];
+
   // Congestion control
   TracedValue<uint32_t>  m_cWnd;            //!< Congestion window
   TracedValue<uint32_t>  m_ssThresh;        //!< Slow start threshold
@@ -167,6 +203,13 @@ public:
   uint32_t               m_rcvTimestampValue;     //!< Receiver Timestamp value 
   uint32_t               m_rcvTimestampEchoReply; //!< Sender Timestamp echoed by the receiver
 
+  DataRate               m_pacingRate;      //!< Pacing rate, when the socket paces its segments
+
+  Time                   m_minRtt;          //!< Minimum RTT sample of the connection
+  Time                   m_lastRttSample;   //!< RTT sample of the last ACK, not smoothed, 0 if none
+
+  TracedValue<EcnState_t> m_ecnState;       //!< ECN state of the sender
+
   /**
    * \brief Get cwnd in segments rather than bytes
    *
@@ -219,10 +262,11 @@ public:
  *
  * - CA_OPEN
  * - CA_DISORDER
+ * - CA_CWR
  * - CA_RECOVERY
  * - CA_LOSS
  *
- * Another one (CA_CWR) is present but not used. For more information, see
+ * CA_CWR is entered only with ECN (see below). For more information, see
  * the TcpCongState_t documentation.
  *
  * Congestion control interface
@@ -274,6 +318,22 @@ public:
  *
  * The algorithm is implemented in the ProcessAck method.
  *
+ * Explicit Congestion Notification
+ * --------------------------------
+ *
+ * With the attribute "UseEcn" (or a congestion control that needs ECN, see
+ * TcpCongestionOps::NeedsEcn), the socket negotiates ECN (RFC 3168) in the
+ * three-way handshake, and then sends its new data segments with the ECT(0)
+ * codepoint in the IP header. The receiver sets ECE on its ACKs when the
+ * segments arrive with the CE codepoint: from the first CE mark until a
+ * segment with CWR arrives, as in RFC 3168, or, for a congestion control
+ * that needs ECN, exactly on the ACKs of the marked segments, sending an
+ * ACK at once when the mark changes with a delayed ACK pending (as DCTCP
+ * does in Linux). The sender reacts to ECE at most once per window of data:
+ * it enters CA_CWR, reduces ssThresh and cWnd through GetSsThresh, and sets
+ * CWR on its next new segment. Every ACK is reported to the congestion
+ * control, with its ECE flag, through TcpCongestionOps::InAckEvent.
+ *
  * RTO expiration
  * --------------
  *
@@ -321,6 +381,18 @@ public:
    */
   friend class TcpGeneralTest;
 
+  /**
+   * \brief TcpL4Protocol friend class (for its socket list).
+   * \relates TcpL4Protocol
+   */
+  friend class TcpL4Protocol;
+
+  /**
+   * \brief TcpPacingWheel friend class (to release paced sockets).
+   * \relates TcpPacingWheel
+   */
+  friend class TcpPacingWheel;
+
   /**
    * Create an unbound TCP socket
    */
@@ -458,6 +530,16 @@ public:
    */
   void SetCongestionControlAlgorithm (Ptr<TcpCongestionOps> algo);
 
+  /**
+   * \brief Record transmissions, acknowledgments and timeouts to a ring
+   *
+   * Each record carries the congestion state and window after the event;
+   * see EventTraceSink for how the rings are collected.
+   *
+   * \param ring the ring, or 0 to stop recording
+   */
+  void SetEventTrace (Ptr<EventTraceRing> ring);
+
   // Necessary implementations of null functions from ns3::Socket
   virtual enum SocketErrno GetErrno (void) const;    // returns m_errno
   virtual enum SocketType GetSocketType (void) const; // returns socket type
@@ -644,6 +726,22 @@ protected:
    */
   uint32_t SendPendingData (bool withAck = false);
 
+  /**
+   * \brief Update the pacing rate of the connection
+   *
+   * The rate is the PacingRate attribute, if set; otherwise, unless the
+   * congestion control sets it itself, it is cWnd per smoothed RTT, times
+   * PacingSsRatio in slow start and PacingCaRatio in congestion avoidance.
+   */
+  void UpdatePacingRate (void);
+
+  /**
+   * \brief Send the segments held back by pacing
+   *
+   * Called by the pacing wheel of m_tcp, once the time has come.
+   */
+  void PacingRelease (void);
+
   /**
    * \brief Extract at most maxSize bytes from the TxBuffer at sequence seq, add the
    *        TCP header, and send to TcpL4Protocol
@@ -925,6 +1023,17 @@ protected:
    */
   void EnterRecovery ();
 
+  /**
+   * \brief Enter the CA_CWR, and reduce the window for an ECN echo
+   */
+  void EnterCwr ();
+
+  /**
+   * \brief Tell if the socket asks for ECN, or accepts it, in the handshake
+   * \return true if UseEcn is set, or if the congestion control needs ECN
+   */
+  bool EcnRequested (void) const;
+
   /**
    * \brief An RTO event happened
    */
@@ -1100,6 +1209,8 @@ protected:
   Ipv6EndPoint*       m_endPoint6;  //!< the IPv6 endpoint
   Ptr<Node>           m_node;       //!< the associated node
   Ptr<TcpL4Protocol>  m_tcp;        //!< the associated TCP L4 protocol
+  uint32_t            m_socketIndex; //!< Position in the socket list of m_tcp, or NOT_LISTED
+  static const uint32_t NOT_LISTED = 0xffffffff; //!< m_socketIndex of a socket not in the list
   Callback<void, Ipv4Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback;  //!< ICMP callback
   Callback<void, Ipv6Address,uint8_t,uint8_t,uint8_t,uint32_t> m_icmpCallback6; //!< ICMPv6 callback
 
@@ -1145,9 +1256,27 @@ protected:
   uint32_t               m_retxThresh;   //!< Fast Retransmit threshold
   bool                   m_limitedTx;    //!< perform limited transmit
 
+  // Explicit Congestion Notification
+  bool                   m_useEcn;       //!< Ask for ECN in the three-way handshake
+  bool                   m_ecnEcho;      //!< Set ECE on the ACKs sent
+  bool                   m_ceReceived;   //!< The segment being processed was marked CE
+  SequenceNumber32       m_ecnRecover;   //!< Highest Tx seqnum at the last ECN reduction
+
+  // Segmentation offload
+  uint32_t               m_gsoMaxSize;   //!< Largest payload of a super-segment, 0 if disabled
+
+  // Pacing
+  bool                   m_pacing;          //!< Pace the segments of new data sent
+  DataRate               m_pacingRate;      //!< Fixed pacing rate, 0 to derive it from cWnd and RTT
+  uint16_t               m_pacingSsRatio;   //!< Pacing rate in slow start, in percent of cWnd per RTT
+  uint16_t               m_pacingCaRatio;   //!< Pacing rate in congestion avoidance, in percent of cWnd per RTT
+  Time                   m_pacingNextTime;  //!< Earliest time of the next segment of new data
+  bool                   m_pacingPending;   //!< Waiting on the pacing wheel
+
   // Transmission Control Block
   Ptr<TcpSocketState>    m_tcb;               //!< Congestion control informations
   Ptr<TcpCongestionOps>  m_congestionControl; //!< Congestion control
+  Ptr<TcpRateOps>        m_rateOps;           //!< Delivery rate estimator, for CongControl
 
   // Guesses over the other connection end
   bool m_isFirstPartialAck; //!< First partial ACK during RECOVERY
@@ -1158,6 +1287,16 @@ protected:
 
   TracedCallback<Ptr<const Packet>, const TcpHeader&,
                  Ptr<const TcpSocketBase> > m_rxTrace; //!< Trace of received packets
+
+  /**
+   * \brief Append an event of this connection to m_eventTrace
+   * \param event the kind of event
+   * \param seq sequence number the event refers to
+   * \param ack acknowledgment number the event refers to
+   */
+  void RecordEvent (EventTraceRecord::Event event, SequenceNumber32 seq, SequenceNumber32 ack);
+
+  Ptr<EventTraceRing> m_eventTrace; //!< Binary event records, if enabled
 };
 
 /**
@@ -28,6 +28,7 @@
 #include "ns3/tcp-option-ts.h"
 
 #include "tcp-tx-buffer.h"
+#include "tcp-rate-ops.h"
 
 namespace ns3 {
 
@@ -38,8 +39,13 @@ TcpTxItem::TcpTxItem ()
     m_lost (false),
     m_retrans (false),
     m_lastSent (Time::Min ()),
-    m_sacked (false)
+    m_sacked (false),
+    m_startSeq (0)
 {
+  m_rateInfo.m_delivered = 0;
+  m_rateInfo.m_deliveredTime = Time (0);
+  m_rateInfo.m_firstSent = Time (0);
+  m_rateInfo.m_isAppLimited = false;
 }
 
 TcpTxItem::TcpTxItem (const TcpTxItem &other)
@@ -47,7 +53,9 @@ TcpTxItem::TcpTxItem (const TcpTxItem &other)
     m_lost (other.m_lost),
     m_retrans (other.m_retrans),
     m_lastSent (other.m_lastSent),
-    m_sacked (other.m_sacked)
+    m_sacked (other.m_sacked),
+    m_startSeq (other.m_startSeq),
+    m_rateInfo (other.m_rateInfo)
 {
 }
 
@@ -112,27 +120,14 @@ TcpTxBuffer::GetTypeId (void)
  * initialized below is insignificant.
  */
 TcpTxBuffer::TcpTxBuffer (uint32_t n)
-  : m_maxBuffer (32768), m_size (0), m_sentSize (0), m_firstByteSeq (n)
+  : m_appOffset (0), m_maxBuffer (32768), m_size (0), m_sentSize (0), m_firstByteSeq (n),
+    m_outBytes (0), m_retransCount (0), m_pipeBoundary (n), m_pipeLostBytes (0),
+    m_holeCursor (n), m_lostHoleCursor (n)
 {
 }
 
 TcpTxBuffer::~TcpTxBuffer (void)
 {
-  PacketList::iterator it;
-
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
-    {
-      TcpTxItem *item = *it;
-      m_sentSize -= item->m_packet->GetSize ();
-      delete item;
-    }
-
-  for (it = m_appList.begin (); it != m_appList.end (); ++it)
-    {
-      TcpTxItem *item = *it;
-      m_size -= item->m_packet->GetSize ();
-      delete item;
-    }
 }
 
 SequenceNumber32
@@ -178,8 +173,8 @@ TcpTxBuffer::SetHeadSequence (const SequenceNumber32& seq)
   m_firstByteSeq = seq;
 
   // if you change the head with data already sent, something bad will happen
-  NS_ASSERT (m_sentList.size () == 0);
-  m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+  NS_ASSERT (m_sentList.GetSize () == 0);
+  RebuildScoreboard ();
 }
 
 bool
@@ -192,9 +187,9 @@ TcpTxBuffer::Add (Ptr<Packet> p)
     {
       if (p->GetSize () > 0)
         {
-          TcpTxItem *item = new TcpTxItem ();
-          item->m_packet = p->Copy ();
-          m_appList.insert (m_appList.end (), item);
+          TcpTxItem item;
+          item.m_packet = p->Copy ();
+          m_appList.PushBack (item);
           m_size += p->GetSize ();
 
           NS_LOG_INFO ("Updated size=" << m_size << ", lastSeq=" <<
@@ -242,14 +237,14 @@ TcpTxBuffer::CopyFromSequence (uint32_t numBytes, const SequenceNumber32& seq)
       return Create<Packet> ();
     }
 
-  TcpTxItem *outItem = 0;
+  uint32_t index;
+  bool retrans = false;
 
   if (m_firstByteSeq + m_sentSize >= seq + s)
     {
       // already sent this block completely
-      outItem = GetTransmittedSegment (s, seq);
-      NS_ASSERT (outItem != 0);
-      outItem->m_retrans = true;
+      index = GetTransmittedSegment (s, seq);
+      retrans = true;
 
       NS_LOG_DEBUG ("Retransmitting [" << seq << ";" << seq + s << "|" << s <<
                     "] from " << *this);
@@ -260,14 +255,13 @@ TcpTxBuffer::CopyFromSequence (uint32_t numBytes, const SequenceNumber32& seq)
                            "Requesting a piece of new data with an hole");
 
       // this is the first time we transmit this block
-      outItem = GetNewSegment (s);
-      NS_ASSERT (outItem != 0);
-      NS_ASSERT (outItem->m_retrans == false);
+      index = GetNewSegment (s);
+      NS_ASSERT (m_sentList[index].m_retrans == false);
 
       NS_LOG_DEBUG ("New segment [" << seq << ";" << seq + s << "|" << s <<
                     "] from " << *this);
     }
-  else if (m_firstByteSeq + m_sentSize > seq && m_firstByteSeq + m_sentSize < seq + s)
+  else
     {
       // Partial: a part is retransmission, the remaining data is new
 
@@ -277,89 +271,166 @@ TcpTxBuffer::CopyFromSequence (uint32_t numBytes, const SequenceNumber32& seq)
                     m_firstByteSeq + m_sentSize + amount <<"|" << amount <<
                     "] from " << *this);
 
-      outItem = GetNewSegment (amount);
-      NS_ASSERT (outItem != 0);
+      GetNewSegment (amount);
 
-      // Now get outItem from the sent list (there will be a merge)
+      // Now get the block from the sent list (there will be a merge)
       return CopyFromSequence (numBytes, seq);
     }
 
-  outItem->m_lost = false;
-  outItem->m_lastSent = Simulator::Now ();
-  Ptr<Packet> toRet = outItem->m_packet->Copy ();
+  TcpTxItem &outItem = m_sentList[index];
+  NS_ASSERT (outItem.m_startSeq == seq);
+  ScoreboardRemove (outItem);
+  if (retrans)
+    {
+      outItem.m_retrans = true;
+    }
+  outItem.m_lost = false;
+  outItem.m_lastSent = Simulator::Now ();
+  if (m_rateOps)
+    {
+      m_rateOps->SkbSent (&outItem, m_outBytes == 0);
+    }
+  ScoreboardAdd (outItem);
+  Ptr<Packet> toRet = outItem.m_packet->Copy ();
 
   NS_ASSERT (toRet->GetSize () == s);
 
   return toRet;
 }
 
-TcpTxItem*
+uint32_t
 TcpTxBuffer::GetNewSegment (uint32_t numBytes)
 {
   NS_LOG_FUNCTION (this << numBytes);
 
-  SequenceNumber32 startOfAppList = m_firstByteSeq + m_sentSize;
-
-  bool listEdited = false;
-  TcpTxItem *item = GetPacketFromList (m_appList, startOfAppList,
-                                       numBytes, startOfAppList, &listEdited);
+  // Slice the segment from the head of the AppList: the application
+  // packets are cut at m_appOffset, and appended if the segment spans them
+  TcpTxItem item;
+  uint32_t size = 0;
+  while (size < numBytes)
+    {
+      NS_ASSERT (!m_appList.IsEmpty ());
+      TcpTxItem part = m_appList.Front ();
+      uint32_t packetSize = part.m_packet->GetSize ();
+      uint32_t partSize = std::min (packetSize - m_appOffset, numBytes - size);
+      if (partSize < packetSize)
+        {
+          // PacketTags are preserved when fragmenting
+          part.m_packet = part.m_packet->CreateFragment (m_appOffset, partSize);
+        }
 
-  (void) listEdited;
+      m_appOffset += partSize;
+      if (m_appOffset == packetSize)
+        {
+          m_appList.PopFront ();
+          m_appOffset = 0;
+        }
 
-  // Move item from AppList to SentList (should be the first, not too complex)
-  PacketList::iterator it = std::find (m_appList.begin (), m_appList.end (), item);
-  NS_ASSERT (it != m_appList.end ());
+      if (size == 0)
+        {
+          item = part;
+        }
+      else
+        {
+          MergeItems (item, part);
+        }
+      size += partSize;
+    }
 
-  m_appList.erase (it);
-  m_sentList.insert (m_sentList.end (), item);
-  m_sentSize += item->m_packet->GetSize ();
+  item.m_startSeq = m_firstByteSeq + m_sentSize;
+  m_sentList.PushBack (item);
+  m_sentSize += size;
+  ScoreboardAdd (m_sentList.Back ());
 
-  return item;
+  return m_sentList.GetSize () - 1;
 }
 
-TcpTxItem*
+uint32_t
 TcpTxBuffer::GetTransmittedSegment (uint32_t numBytes, const SequenceNumber32 &seq)
 {
   NS_LOG_FUNCTION (this << numBytes << seq);
   NS_ASSERT (seq >= m_firstByteSeq);
   NS_ASSERT (numBytes <= m_sentSize);
 
-  bool listEdited = false;
+  // The segment holding seq
+  uint32_t i = LowerBound (seq + 1) - 1;
+
+  if (m_sentList[i].m_startSeq < seq)
+    {
+      // seq is in the middle of the segment: split the beginning in its own
+      NS_LOG_INFO ("Segment starts at " << m_sentList[i].m_startSeq <<
+                   ", fragmenting at " << seq);
+      TcpTxItem firstPart;
+      ScoreboardRemove (m_sentList[i]);
+      SplitItems (firstPart, m_sentList[i], seq - m_sentList[i].m_startSeq);
+      ScoreboardAdd (m_sentList[i]);
+      m_sentList.Insert (i, firstPart);
+      ScoreboardAdd (m_sentList[i]);
+      ++i;
+    }
 
-  TcpTxItem *item = GetPacketFromList (m_sentList, m_firstByteSeq, numBytes, seq, &listEdited);
+  // The block spans the following segments: merge them in this one
+  while (m_sentList[i].m_packet->GetSize () < numBytes)
+    {
+      if (i + 1 == m_sentList.GetSize ())
+        {
+          NS_LOG_WARN ("Cannot reach the end, but this case is covered "
+                       "with conditional statements inside CopyFromSequence."
+                       "Something has gone wrong, report a bug");
+          return i;
+        }
+      ScoreboardRemove (m_sentList[i]);
+      ScoreboardRemove (m_sentList[i + 1]);
+      MergeItems (m_sentList[i], m_sentList[i + 1]);
+      m_sentList.Erase (i + 1);
+      ScoreboardAdd (m_sentList[i]);
+    }
 
-  if (listEdited && m_highestSack.second >= m_firstByteSeq)
+  if (m_sentList[i].m_packet->GetSize () > numBytes)
     {
-      m_highestSack = GetHighestSacked ();
+      // The block ends in the middle of the segment: split the block
+      TcpTxItem firstPart;
+      ScoreboardRemove (m_sentList[i]);
+      SplitItems (firstPart, m_sentList[i], numBytes);
+      ScoreboardAdd (m_sentList[i]);
+      m_sentList.Insert (i, firstPart);
+      ScoreboardAdd (m_sentList[i]);
     }
 
-  return item;
+  return i;
 }
 
-std::pair <TcpTxBuffer::PacketList::const_iterator, SequenceNumber32>
-TcpTxBuffer::GetHighestSacked () const
+uint32_t
+TcpTxBuffer::LowerBound (const SequenceNumber32 &seq) const
 {
-  NS_LOG_FUNCTION (this);
-
-  PacketList::const_iterator it;
-  std::pair <TcpTxBuffer::PacketList::const_iterator, SequenceNumber32> ret;
-  SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
-
-  ret = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
-
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  uint32_t begin = 0;
+  uint32_t end = m_sentList.GetSize ();
+  while (begin < end)
     {
-      const TcpTxItem *item = *it;
-      if (item->m_sacked)
+      uint32_t middle = begin + (end - begin) / 2;
+      if (m_sentList[middle].m_startSeq < seq)
+        {
+          begin = middle + 1;
+        }
+      else
         {
-          ret = std::make_pair (it, beginOfCurrentPacket);
+          end = middle;
         }
-      beginOfCurrentPacket += item->m_packet->GetSize ();
     }
-
-  return ret;
+  return begin;
 }
 
+void
+TcpTxBuffer::TrimAppHead (void)
+{
+  if (m_appOffset > 0)
+    {
+      TcpTxItem &head = m_appList.Front ();
+      head.m_packet = head.m_packet->CreateFragment (m_appOffset,
+                                                     head.m_packet->GetSize () - m_appOffset);
+      m_appOffset = 0;
+    }
+}
 
 void
 TcpTxBuffer::SplitItems (TcpTxItem &t1, TcpTxItem &t2, uint32_t size) const
@@ -369,182 +440,16 @@ TcpTxBuffer::SplitItems (TcpTxItem &t1, TcpTxItem &t2, uint32_t size) const
   t1.m_packet = t2.m_packet->CreateFragment (0, size);
   t2.m_packet->RemoveAtStart (size);
 
+  t1.m_startSeq = t2.m_startSeq;
+  t2.m_startSeq += size;
+
   t1.m_sacked = t2.m_sacked;
   t1.m_lastSent = t2.m_lastSent;
+  t1.m_rateInfo = t2.m_rateInfo;
   t1.m_retrans = t2.m_retrans;
   t1.m_lost = t2.m_lost;
 }
 
-TcpTxItem*
-TcpTxBuffer::GetPacketFromList (PacketList &list, const SequenceNumber32 &listStartFrom,
-                                uint32_t numBytes, const SequenceNumber32 &seq,
-                                bool *listEdited) const
-{
-  NS_LOG_FUNCTION (this << numBytes << seq);
-
-  /*
-   * Our possibilites are sketched out in the following:
-   *
-   *                    |------|     |----|     |----|
-   * GetList (m_data) = |      | --> |    | --> |    |
-   *                    |------|     |----|     |----|
-   *
-   *                    ^ ^ ^  ^
-   *                    | | |  |         (1)
-   *                  seq | |  numBytes
-   *                      | |
-   *                      | |
-   *                    seq numBytes     (2)
-   *
-   * (1) seq and numBytes are the boundary of some packet
-   * (2) seq and numBytes are not the boundary of some packet
-   *
-   * We can have mixed case (e.g. seq over the boundary while numBytes not).
-   *
-   * If we discover that we are in (2) or in a mixed case, we split
-   * packets accordingly to the requested bounds and re-run the function.
-   *
-   * In (1), things are pretty easy, it's just a matter of walking the list and
-   * defragment packets, if needed (e.g. seq is the beginning of the first packet
-   * while maxBytes is the end of some packet next in the list).
-   */
-
-  Ptr<Packet> currentPacket = 0;
-  TcpTxItem *currentItem = 0;
-  TcpTxItem *outItem = 0;
-  PacketList::iterator it = list.begin ();
-  SequenceNumber32 beginOfCurrentPacket = listStartFrom;
-
-  while (it != list.end ())
-    {
-      currentItem = *it;
-      currentPacket = currentItem->m_packet;
-
-      // The objective of this snippet is to find (or to create) the packet
-      // that begin with the sequence seq
-
-      if (seq < beginOfCurrentPacket + currentPacket->GetSize ())
-        {
-          // seq is inside the current packet
-          if (seq == beginOfCurrentPacket)
-            {
-              // seq is the beginning of the current packet. Hurray!
-              outItem = currentItem;
-              NS_LOG_INFO ("Current packet starts at seq " << seq <<
-                           " ends at " << seq + currentPacket->GetSize ());
-            }
-          else if (seq > beginOfCurrentPacket)
-            {
-              // seq is inside the current packet but seq is not the beginning,
-              // it's somewhere in the middle. Just fragment the beginning and
-              // start again.
-              NS_LOG_INFO ("we are at " << beginOfCurrentPacket <<
-                           " searching for " << seq <<
-                           " and now we recurse because packet ends at "
-                                        << beginOfCurrentPacket + currentPacket->GetSize ());
-              TcpTxItem *firstPart = new TcpTxItem ();
-              SplitItems (*firstPart, *currentItem, seq - beginOfCurrentPacket);
-
-              // insert firstPart before currentItem
-              list.insert (it, firstPart);
-              *listEdited = true;
-
-              return GetPacketFromList (list, listStartFrom, numBytes, seq, listEdited);
-            }
-          else
-            {
-              NS_FATAL_ERROR ("seq < beginOfCurrentPacket: our data is before");
-            }
-        }
-      else
-        {
-          // Walk the list, the current packet does not contain seq
-          beginOfCurrentPacket += currentPacket->GetSize ();
-          it++;
-          continue;
-        }
-
-      NS_ASSERT (outItem != 0);
-
-      // The objective of this snippet is to find (or to create) the packet
-      // that ends after numBytes bytes. We are sure that outPacket starts
-      // at seq.
-
-      if (seq + numBytes <= beginOfCurrentPacket + currentPacket->GetSize ())
-        {
-          // the end boundary is inside the current packet
-          if (numBytes == currentPacket->GetSize ())
-            {
-              // the end boundary is exactly the end of the current packet. Hurray!
-              if (currentItem->m_packet == outItem->m_packet)
-                {
-                  // A perfect match!
-                  return outItem;
-                }
-              else
-                {
-                  // the end is exactly the end of current packet, but
-                  // current > outPacket in the list. Merge current with the
-                  // previous, and recurse.
-                  NS_ASSERT (it != list.begin ());
-                  TcpTxItem *previous = *(--it);
-
-                  list.erase (it);
-
-                  MergeItems (*previous, *currentItem);
-                  delete currentItem;
-                  *listEdited = true;
-
-                  return GetPacketFromList (list, listStartFrom, numBytes, seq, listEdited);
-                }
-            }
-          else if (numBytes < currentPacket->GetSize ())
-            {
-              // the end is inside the current packet, but it isn't exactly
-              // the packet end. Just fragment, fix the list, and return.
-              TcpTxItem *firstPart = new TcpTxItem ();
-              SplitItems (*firstPart, *currentItem, numBytes);
-
-              // insert firstPart before currentItem
-              list.insert (it, firstPart);
-              *listEdited = true;
-
-              return firstPart;
-            }
-        }
-      else
-        {
-          // The end isn't inside current packet, but there is an exception for
-          // the merge and recurse strategy...
-          if (++it == list.end ())
-            {
-              // ...current is the last packet we sent. We have not more data;
-              // Go for this one.
-              NS_LOG_WARN ("Cannot reach the end, but this case is covered "
-                           "with conditional statements inside CopyFromSequence."
-                           "Something has gone wrong, report a bug");
-              return outItem;
-            }
-
-          // The current packet does not contain the requested end. Merge current
-          // with the packet that follows, and recurse
-          TcpTxItem *next = (*it); // Please remember we have incremented it
-                                   // in the previous if
-
-          MergeItems (*currentItem, *next);
-          list.erase (it);
-
-          delete next;
-
-          *listEdited = true;
-
-          return GetPacketFromList (list, listStartFrom, numBytes, seq, listEdited);
-        }
-    }
-
-  NS_FATAL_ERROR ("This point is not reachable");
-}
-
 void
 TcpTxBuffer::MergeItems (TcpTxItem &t1, TcpTxItem &t2) const
 {
@@ -565,6 +470,7 @@ TcpTxBuffer::MergeItems (TcpTxItem &t1, TcpTxItem &t2) const
   if (t1.m_lastSent < t2.m_lastSent)
     {
       t1.m_lastSent = t2.m_lastSent;
+      t1.m_rateInfo = t2.m_rateInfo;
     }
   if (t2.m_lost)
     {
@@ -586,31 +492,32 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq)
       return;
     }
 
-  // Scan the buffer and discard packets
+  // Pop the segments from the head of the buffer
   uint32_t offset = seq - m_firstByteSeq.Get ();  // Number of bytes to remove
   uint32_t pktSize;
-  PacketList::iterator i = m_sentList.begin ();
   while (m_size > 0 && offset > 0)
     {
-      if (i == m_sentList.end ())
+      if (m_sentList.IsEmpty ())
         {
           Ptr<Packet> p = CopyFromSequence (offset, m_firstByteSeq);
           NS_ASSERT (p != 0);
-          i = m_sentList.begin ();
-          NS_ASSERT (i != m_sentList.end ());
+          NS_ASSERT (!m_sentList.IsEmpty ());
         }
-      TcpTxItem *item = *i;
-      Ptr<Packet> p = item->m_packet;
-      pktSize = p->GetSize ();
+      TcpTxItem &item = m_sentList.Front ();
+      pktSize = item.m_packet->GetSize ();
 
+      ScoreboardRemove (item);
+      if (m_rateOps && !item.m_sacked)
+        {
+          m_rateOps->SkbDelivered (&item, std::min (offset, pktSize));
+        }
       if (offset >= pktSize)
         { // This packet is behind the seqnum. Remove this packet from the buffer
           m_size -= pktSize;
           m_sentSize -= pktSize;
           offset -= pktSize;
           m_firstByteSeq += pktSize;
-          i = m_sentList.erase (i);
-          delete item;
+          m_sentList.PopFront ();
           NS_LOG_INFO ("While removing up to " << seq <<
                        ".Removed one packet of size " << pktSize <<
                        " starting from " << m_firstByteSeq - pktSize <<
@@ -620,10 +527,12 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq)
         { // Part of the packet is behind the seqnum. Fragment
           pktSize -= offset;
           // PacketTags are preserved when fragmenting
-          item->m_packet = item->m_packet->CreateFragment (offset, pktSize);
+          item.m_packet = item.m_packet->CreateFragment (offset, pktSize);
           m_size -= offset;
           m_sentSize -= offset;
           m_firstByteSeq += offset;
+          item.m_startSeq = m_firstByteSeq;
+          ScoreboardAdd (item);
           NS_LOG_INFO ("Fragmented one packet by size " << offset <<
                        ", new size=" << pktSize);
           break;
@@ -635,21 +544,33 @@ TcpTxBuffer::DiscardUpTo (const SequenceNumber32& seq)
       m_firstByteSeq = seq;
     }
 
-  if (!m_sentList.empty ())
+  if (!m_sentList.IsEmpty ())
     {
-      TcpTxItem *head = m_sentList.front ();
-      if (head->m_sacked)
+      TcpTxItem &head = m_sentList.Front ();
+      if (head.m_sacked)
         {
           // It is not possible to have the UNA sacked; otherwise, it would
           // have been ACKed. This is, most likely, our wrong guessing
           // when crafting the SACK option for a non-SACK receiver.
-          head->m_sacked = false;
+          ScoreboardRemove (head);
+          head.m_sacked = false;
+          ScoreboardAdd (head);
         }
     }
 
-  if (m_highestSack.second <= m_firstByteSeq)
+  if (m_pipeBoundary < m_firstByteSeq)
+    {
+      // No hole is left below the boundary; keep it in the window
+      NS_ASSERT (m_pipeLostBytes == 0);
+      m_pipeBoundary = m_firstByteSeq;
+    }
+  if (m_holeCursor < m_firstByteSeq)
     {
-      m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+      m_holeCursor = m_firstByteSeq;
+    }
+  if (m_lostHoleCursor < m_firstByteSeq)
+    {
+      m_lostHoleCursor = m_firstByteSeq;
     }
 
   NS_LOG_DEBUG ("Discarded up to " << seq);
@@ -667,126 +588,86 @@ TcpTxBuffer::Update (const TcpOptionSack::SackList &list)
   NS_LOG_INFO ("Updating scoreboard, got " << list.size () << " blocks to analyze");
   for (option_it = list.begin (); option_it != list.end (); ++option_it)
     {
-      Ptr<Packet> current;
-      TcpTxItem *item;
       const TcpOptionSack::SackBlock b = (*option_it);
 
-      PacketList::iterator item_it = m_sentList.begin ();
-      SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
-
-      while (item_it != m_sentList.end ())
+      // Start from the first segment not below the block
+      for (uint32_t i = LowerBound (b.first); i < m_sentList.GetSize (); ++i)
         {
-          item = *item_it;
-          current = item->m_packet;
+          TcpTxItem &item = m_sentList[i];
+          SequenceNumber32 beginOfCurrentPacket = item.m_startSeq;
+          uint32_t size = item.m_packet->GetSize ();
 
           // Check the boundary of this packet ... only mark as sacked if
           // it is precisely mapped over the option
           if (beginOfCurrentPacket >= b.first
-              && beginOfCurrentPacket + current->GetSize () <= b.second)
+              && beginOfCurrentPacket + size <= b.second)
             {
-              if (item->m_sacked)
+              if (item.m_sacked)
                 {
                   NS_LOG_INFO ("Received block [" << b.first << ";" << b.second <<
                                ", checking sentList for block " << beginOfCurrentPacket <<
-                               ";" << beginOfCurrentPacket + current->GetSize () <<
+                               ";" << beginOfCurrentPacket + size <<
                                "], found in the sackboard already sacked");
                 }
               else
                 {
-                  item->m_sacked = true;
+                  ScoreboardRemove (item);
+                  item.m_sacked = true;
+                  ScoreboardAdd (item);
+                  if (m_rateOps)
+                    {
+                      m_rateOps->SkbDelivered (&item, size);
+                    }
                   NS_LOG_INFO ("Received block [" << b.first << ";" << b.second <<
                                ", checking sentList for block " << beginOfCurrentPacket <<
-                               ";" << beginOfCurrentPacket + current->GetSize () <<
+                               ";" << beginOfCurrentPacket + size <<
                                "], found in the sackboard, sacking");
-                  if (m_highestSack.second <= beginOfCurrentPacket + current->GetSize ())
-                    {
-                      PacketList::iterator new_it = item_it;
-                      m_highestSack = std::make_pair (++new_it, beginOfCurrentPacket+current->GetSize ());
-                    }
                 }
               modified = true;
             }
-          else if (beginOfCurrentPacket + current->GetSize () > b.second)
+          else if (beginOfCurrentPacket + size > b.second)
             {
               // we missed the block. It's useless to iterate again; Say "ciao"
               // to the loop for optimization purposes
               NS_LOG_INFO ("Received block [" << b.first << ";" << b.second <<
                            ", checking sentList for block " << beginOfCurrentPacket <<
-                           ";" << beginOfCurrentPacket + current->GetSize () <<
+                           ";" << beginOfCurrentPacket + size <<
                            "], not found, breaking loop");
               break;
             }
-
-          beginOfCurrentPacket += current->GetSize ();
-          ++item_it;
         }
     }
 
-  NS_ASSERT ((*(m_sentList.begin ()))->m_sacked == false);
+  NS_ASSERT (m_sentList.IsEmpty () || m_sentList.Front ().m_sacked == false);
 
   return modified;
 }
 
-bool
-TcpTxBuffer::IsLost (const SequenceNumber32 &seq, const PacketList::const_iterator &segment,
-                     uint32_t dupThresh, uint32_t segmentSize) const
+SequenceNumber32
+TcpTxBuffer::GetLostBoundary (uint32_t dupThresh, uint32_t segmentSize) const
 {
-  NS_LOG_FUNCTION (this << seq << dupThresh << segmentSize);
+  NS_LOG_FUNCTION (this << dupThresh << segmentSize);
   uint32_t count = 0;
   uint32_t bytes = 0;
-  PacketList::const_iterator it;
-  TcpTxItem *item;
-  Ptr<const Packet> current;
-  SequenceNumber32 beginOfCurrentPacket = seq;
-
-  NS_LOG_INFO ("Checking if seq=" << seq << " is lost from the buffer ");
-
-  if ((*segment)->m_lost == true)
-    {
-      NS_LOG_INFO ("seq=" << seq << " is lost because of lost flag");
-      return true;
-    }
-
-  if ((*segment)->m_sacked == true)
-    {
-      NS_LOG_INFO ("seq=" << seq << " is not lost because of sacked flag");
-      return false;
-    }
 
   // From RFC 6675:
   // > The routine returns true when either dupThresh discontiguous SACKed
   // > sequences have arrived above 'seq' or more than (dupThresh - 1) * SMSS bytes
   // > with sequence numbers greater than 'SeqNum' have been SACKed.  Otherwise, the
   // > routine returns false.
-  for (it = segment; it != m_highestSack.first; ++it)
+  // Both conditions hold below the highest SACKed segment making them true
+  std::map<SequenceNumber32, uint32_t>::const_reverse_iterator it;
+  for (it = m_sacked.rbegin (); it != m_sacked.rend (); ++it)
     {
-      if (beginOfCurrentPacket >= m_highestSack.second)
+      ++count;
+      bytes += it->second;
+      if ((count >= dupThresh) || (bytes > (dupThresh-1) * segmentSize))
         {
-          NS_LOG_INFO ("seq=" << seq << " is not lost because there are no sacked segment ahead");
-          return false;
+          return it->first;
         }
-
-      item = *it;
-      current = item->m_packet;
-
-      if (item->m_sacked)
-        {
-          NS_LOG_INFO ("Segment [" << beginOfCurrentPacket << ", " <<
-                       beginOfCurrentPacket+item->m_packet->GetSize () <<
-                       "] found to be SACKed");
-          ++count;
-          bytes += current->GetSize ();
-          if ((count >= dupThresh) || (bytes > (dupThresh-1) * segmentSize))
-            {
-              NS_LOG_INFO ("seq=" << seq << " is lost because of 3 sacked blocks ahead");
-              return true;
-            }
-        }
-
-      beginOfCurrentPacket += current->GetSize ();
     }
 
-  return false;
+  return m_firstByteSeq;
 }
 
 bool
@@ -795,28 +676,51 @@ TcpTxBuffer::IsLost (const SequenceNumber32 &seq, uint32_t dupThresh,
 {
   NS_LOG_FUNCTION (this << seq << dupThresh);
 
-  SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
-  PacketList::const_iterator it;
+  if (m_sacked.empty () || seq >= m_sacked.rbegin ()->first + m_sacked.rbegin ()->second)
+    {
+      return false;
+    }
+
+  // Check the first segment starting at or after seq
+  uint32_t i = LowerBound (seq);
+  if (i == m_sentList.GetSize ())
+    {
+      return false;
+    }
 
-  if (seq >= m_highestSack.second)
+  const TcpTxItem &item = m_sentList[i];
+  if (item.m_lost)
+    {
+      NS_LOG_INFO ("seq=" << item.m_startSeq << " is lost because of lost flag");
+      return true;
+    }
+  if (item.m_sacked)
     {
+      NS_LOG_INFO ("seq=" << item.m_startSeq << " is not lost because of sacked flag");
       return false;
     }
 
-  // This O(n) method is called only once, and outside this class.
-  // It should not harm the performance
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  return item.m_startSeq < GetLostBoundary (dupThresh, segmentSize);
+}
+
+uint32_t
+TcpTxBuffer::FirstHole (bool lost) const
+{
+  // No hole starts below the cursor: move it up to the first one
+  SequenceNumber32 &cursor = lost ? m_lostHoleCursor : m_holeCursor;
+  uint32_t i = LowerBound (cursor);
+  while (i < m_sentList.GetSize ())
     {
-      // Search for the right iterator before calling IsLost()
-      if (beginOfCurrentPacket >= seq)
+      const TcpTxItem &item = m_sentList[i];
+      if (!item.m_sacked && !item.m_retrans && (item.m_lost || !lost))
         {
-          return IsLost (beginOfCurrentPacket, it, dupThresh, segmentSize);
+          cursor = item.m_startSeq;
+          return i;
         }
-
-      beginOfCurrentPacket += (*it)->m_packet->GetSize ();
+      ++i;
     }
-
-  return false;
+  cursor = m_firstByteSeq + m_sentSize;
+  return i;
 }
 
 bool
@@ -838,34 +742,27 @@ TcpTxBuffer::NextSeg (SequenceNumber32 *seq, uint32_t dupThresh,
    *           received SACK.
    *
    *     (1.c) IsLost (S2) returns true.
+   *
+   * The candidates are the holes (neither SACKed nor retransmitted). The
+   * lowest one is lost if it is marked so or below the lost boundary;
+   * otherwise no hole is below the boundary, and only the holes marked
+   * lost are.
    */
-  PacketList::const_iterator it;
-  TcpTxItem *item;
-  SequenceNumber32 seqPerRule3;
-  bool isSeqPerRule3Valid = false;
-  SequenceNumber32 beginOfCurrentPkt = m_firstByteSeq;
-
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  uint32_t hole = FirstHole (false);
+  if (hole < m_sentList.GetSize ())
     {
-      item = *it;
-
-      // Condition 1.a , 1.b , and 1.c
-      if (item->m_retrans == false && item->m_sacked == false)
+      const TcpTxItem &item = m_sentList[hole];
+      if (item.m_lost || item.m_startSeq < GetLostBoundary (dupThresh, segmentSize))
         {
-          if (IsLost (beginOfCurrentPkt, it, dupThresh, segmentSize))
-            {
-              *seq = beginOfCurrentPkt;
-              return true;
-            }
-          else if (seqPerRule3.GetValue () == 0 && isRecovery)
-            {
-              isSeqPerRule3Valid = true;
-              seqPerRule3 = beginOfCurrentPkt;
-            }
+          *seq = item.m_startSeq;
+          return true;
+        }
+      uint32_t lostHole = FirstHole (true);
+      if (lostHole < m_sentList.GetSize ())
+        {
+          *seq = m_sentList[lostHole].m_startSeq;
+          return true;
         }
-
-      // Nothing found, iterate
-      beginOfCurrentPkt += item->m_packet->GetSize ();
     }
 
   /* (2) If no sequence number 'S2' per rule (1) exists but there
@@ -886,9 +783,9 @@ TcpTxBuffer::NextSeg (SequenceNumber32 *seq, uint32_t dupThresh,
    *     (specifically excluding step (1.c)), then one segment of up to
    *     SMSS octets starting with S3 SHOULD be returned.
    */
-  if (isSeqPerRule3Valid)
+  if (isRecovery && hole < m_sentList.GetSize ())
     {
-      *seq = seqPerRule3;
+      *seq = m_sentList[hole].m_startSeq;
       return true;
     }
 
@@ -911,53 +808,46 @@ uint32_t
 TcpTxBuffer::GetRetransmitsCount (void) const
 {
   NS_LOG_FUNCTION (this);
-  PacketList::const_iterator it;
-  TcpTxItem *item;
-  uint32_t count = 0;
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
-    {
-      item = *it;
-      if (item->m_retrans)
-        {
-          count++;
-        }
-    }
-  return count;
+  return m_retransCount;
 }
 
 uint32_t
 TcpTxBuffer::BytesInFlight (uint32_t dupThresh, uint32_t segmentSize) const
 {
-  PacketList::const_iterator it;
-  TcpTxItem *item;
-  uint32_t size = 0; // "pipe" in RFC
-  SequenceNumber32 beginOfCurrentPkt = m_firstByteSeq;
-
   // After initializing pipe to zero, the following steps are taken for each
   // octet 'S1' in the sequence space between HighACK and HighData that has not
   // been SACKed:
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  // (a) If IsLost (S1) returns false: Pipe is incremented by 1 octet.
+  // (b) If S1 <= HighRxt: Pipe is incremented by 1 octet.
+  // (NOTE: we use the m_retrans flag instead of keeping and updating
+  // another variable). Only if the item is not marked as lost
+  //
+  // So the pipe counts the octets neither SACKed nor marked lost, but the
+  // ones of the holes (not retransmitted) below the lost boundary. Move the
+  // boundary of the holes counted so far to the current one.
+  SequenceNumber32 boundary = GetLostBoundary (dupThresh, segmentSize);
+  bool up = m_pipeBoundary < boundary;
+  SequenceNumber32 low = up ? m_pipeBoundary : boundary;
+  SequenceNumber32 high = up ? boundary : m_pipeBoundary;
+  for (uint32_t i = LowerBound (low);
+       i < m_sentList.GetSize () && m_sentList[i].m_startSeq < high; ++i)
     {
-      item = *it;
-      if (!item->m_sacked)
+      const TcpTxItem &item = m_sentList[i];
+      if (!item.m_sacked && !item.m_retrans && !item.m_lost)
         {
-          // (a) If IsLost (S1) returns false: Pipe is incremented by 1 octet.
-          if (!IsLost (beginOfCurrentPkt, it, dupThresh, segmentSize))
+          if (up)
             {
-              size += item->m_packet->GetSize ();
+              m_pipeLostBytes += item.m_packet->GetSize ();
             }
-          // (b) If S1 <= HighRxt: Pipe is incremented by 1 octet.
-          // (NOTE: we use the m_retrans flag instead of keeping and updating
-          // another variable). Only if the item is not marked as lost
-          else if (item->m_retrans && !item->m_lost)
+          else
             {
-              size += item->m_packet->GetSize ();
+              m_pipeLostBytes -= item.m_packet->GetSize ();
             }
         }
-      beginOfCurrentPkt += item->m_packet->GetSize ();
     }
+  m_pipeBoundary = boundary;
 
-  return size;
+  return m_outBytes - m_pipeLostBytes;
 }
 
 void
@@ -965,60 +855,141 @@ TcpTxBuffer::ResetScoreboard ()
 {
   NS_LOG_FUNCTION (this);
 
-  PacketList::iterator it;
-  SequenceNumber32 beginOfCurrentPkt = m_firstByteSeq;
+  for (uint32_t i = 0; i < m_sentList.GetSize (); ++i)
+    {
+      m_sentList[i].m_sacked = false;
+    }
+
+  RebuildScoreboard ();
+}
 
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+void
+TcpTxBuffer::ScoreboardAdd (const TcpTxItem &item)
+{
+  uint32_t size = item.m_packet->GetSize ();
+
+  if (item.m_retrans)
     {
-      (*it)->m_sacked = false;
-      beginOfCurrentPkt += (*it)->m_packet->GetSize ();
+      ++m_retransCount;
     }
+  if (item.m_sacked)
+    {
+      m_sacked[item.m_startSeq] = size;
+      return;
+    }
+  if (!item.m_lost)
+    {
+      m_outBytes += size;
+    }
+  if (!item.m_retrans)
+    {
+      if (item.m_startSeq < m_holeCursor)
+        {
+          m_holeCursor = item.m_startSeq;
+        }
+      if (item.m_lost)
+        {
+          if (item.m_startSeq < m_lostHoleCursor)
+            {
+              m_lostHoleCursor = item.m_startSeq;
+            }
+        }
+      else if (item.m_startSeq < m_pipeBoundary)
+        {
+          m_pipeLostBytes += size;
+        }
+    }
+}
+
+void
+TcpTxBuffer::ScoreboardRemove (const TcpTxItem &item)
+{
+  uint32_t size = item.m_packet->GetSize ();
 
-  m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+  if (item.m_retrans)
+    {
+      --m_retransCount;
+    }
+  if (item.m_sacked)
+    {
+      NS_ASSERT (m_sacked.count (item.m_startSeq) == 1);
+      m_sacked.erase (item.m_startSeq);
+      return;
+    }
+  if (!item.m_lost)
+    {
+      m_outBytes -= size;
+    }
+  if (!item.m_retrans && !item.m_lost && item.m_startSeq < m_pipeBoundary)
+    {
+      m_pipeLostBytes -= size;
+    }
+}
+
+void
+TcpTxBuffer::RebuildScoreboard (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_sacked.clear ();
+  m_outBytes = 0;
+  m_retransCount = 0;
+  m_pipeBoundary = m_firstByteSeq;
+  m_pipeLostBytes = 0;
+  m_holeCursor = m_firstByteSeq;
+  m_lostHoleCursor = m_firstByteSeq;
+
+  for (uint32_t i = 0; i < m_sentList.GetSize (); ++i)
+    {
+      NS_ASSERT (i > 0 || m_sentList[i].m_startSeq == m_firstByteSeq);
+      ScoreboardAdd (m_sentList[i]);
+    }
 }
 
 void
 TcpTxBuffer::ResetSentList (uint32_t keepItems)
 {
   NS_LOG_FUNCTION (this);
-  TcpTxItem *item;
 
   // Keep the head items; they will then marked as lost
-  while (m_sentList.size () > keepItems)
+  TrimAppHead ();
+  while (m_sentList.GetSize () > keepItems)
     {
-      item = m_sentList.back ();
-      item->m_retrans = item->m_sacked = false;
-      m_appList.push_front (item);
-      m_sentList.pop_back ();
+      TcpTxItem item = m_sentList.Back ();
+      item.m_retrans = item.m_sacked = false;
+      m_appList.PushFront (item);
+      m_sentList.PopBack ();
     }
 
-  if (m_sentList.size () > 0)
+  if (m_sentList.GetSize () > 0)
     {
-      item = m_sentList.back ();
-      item->m_lost = true;
-      item->m_sacked = false;
-      item->m_retrans = false;
-      m_sentSize = item->m_packet->GetSize ();
+      TcpTxItem &item = m_sentList.Back ();
+      item.m_lost = true;
+      item.m_sacked = false;
+      item.m_retrans = false;
+      m_sentSize = item.m_packet->GetSize ();
     }
   else
     {
       m_sentSize = 0;
     }
 
-  m_highestSack = std::make_pair (m_sentList.end (), SequenceNumber32 (0));
+  RebuildScoreboard ();
 }
 
 void
 TcpTxBuffer::ResetLastSegmentSent ()
 {
   NS_LOG_FUNCTION (this);
-  if (!m_sentList.empty ())
+  if (!m_sentList.IsEmpty ())
     {
-      TcpTxItem *item = m_sentList.back ();
+      TcpTxItem &item = m_sentList.Back ();
 
-      m_sentList.pop_back ();
-      m_sentSize -= item->m_packet->GetSize ();
-      m_appList.insert (m_appList.begin (), item);
+      m_sentSize -= item.m_packet->GetSize ();
+      ScoreboardRemove (item);
+      TrimAppHead ();
+      m_appList.PushFront (item);
+      m_sentList.PopBack ();
     }
 }
 
@@ -1027,12 +998,12 @@ TcpTxBuffer::SetSentListLost ()
 {
   NS_LOG_FUNCTION (this);
 
-  PacketList::iterator it;
-
-  for (it = m_sentList.begin (); it != m_sentList.end (); ++it)
+  for (uint32_t i = 0; i < m_sentList.GetSize (); ++i)
     {
-      (*it)->m_lost = true;
+      m_sentList[i].m_lost = true;
     }
+
+  RebuildScoreboard ();
 }
 
 bool
@@ -1045,8 +1016,15 @@ TcpTxBuffer::IsHeadRetransmitted () const
       return false;
     }
 
-  NS_ASSERT (m_sentList.size () > 0);
-  return m_sentList.front ()->m_retrans;
+  NS_ASSERT (m_sentList.GetSize () > 0);
+  return m_sentList[0].m_retrans;
+}
+
+void
+TcpTxBuffer::SetRateOps (Ptr<TcpRateOps> rateOps)
+{
+  NS_LOG_FUNCTION (this << rateOps);
+  m_rateOps = rateOps;
 }
 
 Ptr<const TcpOptionSack>
@@ -1054,46 +1032,41 @@ TcpTxBuffer::CraftSackOption (const SequenceNumber32 &seq, uint8_t available) co
 {
   NS_LOG_FUNCTION (this);
   Ptr<TcpOptionSack> sackBlock = 0;
-  SequenceNumber32 beginOfCurrentPacket = m_firstByteSeq;
-  Ptr<Packet> current;
-  TcpTxItem *item;
 
   NS_LOG_INFO ("Crafting a SACK block, available bytes: " << (uint32_t) available <<
                " from seq: " << seq << " buffer starts at seq " << m_firstByteSeq);
 
-  PacketList::const_iterator it;
-  if (m_highestSack.first == m_sentList.end ())
+  // Start after the highest SACKed segment, or from the beginning if
+  // there is none after it
+  uint32_t i = 0;
+  if (!m_sacked.empty ())
     {
-      it = m_sentList.begin ();
-    }
-  else
-    {
-      it = m_highestSack.first;
-      beginOfCurrentPacket = m_highestSack.second;
+      uint32_t after = LowerBound (m_sacked.rbegin ()->first) + 1;
+      if (after < m_sentList.GetSize ())
+        {
+          i = after;
+        }
     }
 
-  while (it != m_sentList.end ())
+  for (; i < m_sentList.GetSize (); ++i)
     {
-      item = *it;
-      current = item->m_packet;
-
-      SequenceNumber32 endOfCurrentPacket = beginOfCurrentPacket + current->GetSize ();
+      const TcpTxItem *item = &m_sentList[i];
+      SequenceNumber32 beginOfCurrentPacket = item->m_startSeq;
+      SequenceNumber32 endOfCurrentPacket = beginOfCurrentPacket + item->m_packet->GetSize ();
 
       // The first segment could not be sacked.. otherwise would be a
       // cumulative ACK :)
-      if (item->m_sacked || it == m_sentList.begin ())
+      if (item->m_sacked || i == 0)
         {
           NS_LOG_DEBUG ("Analyzing segment: [" << beginOfCurrentPacket <<
                         ";" << endOfCurrentPacket << "], not usable, sacked=" <<
                         item->m_sacked);
-          beginOfCurrentPacket += current->GetSize ();
         }
       else if (seq > beginOfCurrentPacket)
         {
           NS_LOG_DEBUG ("Analyzing segment: [" << beginOfCurrentPacket <<
                         ";" << endOfCurrentPacket << "], not usable, sacked=" <<
                         item->m_sacked);
-          beginOfCurrentPacket += current->GetSize ();
         }
       else
         {
@@ -1114,17 +1087,16 @@ TcpTxBuffer::CraftSackOption (const SequenceNumber32 &seq, uint8_t available) co
           // This means go backward until we finish space and include already SACKed block
           while (sackBlock->GetSerializedSize () + 8 < available)
             {
-              --it;
+              --i;
 
-              if (it == m_sentList.begin ())
+              if (i == 0)
                 {
                   return sackBlock;
                 }
 
-              item = *it;
-              current = item->m_packet;
-              endOfCurrentPacket = beginOfCurrentPacket;
-              beginOfCurrentPacket -= current->GetSize ();
+              item = &m_sentList[i];
+              beginOfCurrentPacket = item->m_startSeq;
+              endOfCurrentPacket = beginOfCurrentPacket + item->m_packet->GetSize ();
               sackBlock->AddSackBlock (TcpOptionSack::SackBlock (beginOfCurrentPacket,
                                                                  endOfCurrentPacket));
               NS_LOG_DEBUG ("Filling the option: Adding [" << beginOfCurrentPacket <<
@@ -1135,8 +1107,6 @@ TcpTxBuffer::CraftSackOption (const SequenceNumber32 &seq, uint8_t available) co
 
           return sackBlock;
         }
-
-      ++it;
     }
 
   return sackBlock;
@@ -1145,29 +1115,30 @@ TcpTxBuffer::CraftSackOption (const SequenceNumber32 &seq, uint8_t available) co
 std::ostream &
 operator<< (std::ostream & os, TcpTxBuffer const & tcpTxBuf)
 {
-  TcpTxBuffer::PacketList::const_iterator it;
   std::stringstream ss;
   SequenceNumber32 beginOfCurrentPacket = tcpTxBuf.m_firstByteSeq;
   uint32_t sentSize = 0, appSize = 0;
 
   Ptr<Packet> p;
-  for (it = tcpTxBuf.m_sentList.begin (); it != tcpTxBuf.m_sentList.end (); ++it)
+  for (uint32_t i = 0; i < tcpTxBuf.m_sentList.GetSize (); ++i)
     {
-      p = (*it)->m_packet;
+      const TcpTxItem &item = tcpTxBuf.m_sentList[i];
+      p = item.m_packet;
       ss << "[" << beginOfCurrentPacket << ";"
          << beginOfCurrentPacket + p->GetSize () << "|" << p->GetSize () << "|";
-      (*it)->Print (ss);
+      item.Print (ss);
       ss << "]";
       sentSize += p->GetSize ();
       beginOfCurrentPacket += p->GetSize ();
     }
 
-  for (it = tcpTxBuf.m_appList.begin (); it != tcpTxBuf.m_appList.end (); ++it)
+  for (uint32_t i = 0; i < tcpTxBuf.m_appList.GetSize (); ++i)
     {
-      appSize += (*it)->m_packet->GetSize ();
+      appSize += tcpTxBuf.m_appList[i].m_packet->GetSize ();
     }
+  appSize -= tcpTxBuf.m_appOffset;
 
-  os << "Sent list: " << ss.str () << ", size = " << tcpTxBuf.m_sentList.size () <<
+  os << "Sent list: " << ss.str () << ", size = " << tcpTxBuf.m_sentList.GetSize () <<
     " Total size: " << tcpTxBuf.m_size <<
     " m_firstByteSeq = " << tcpTxBuf.m_firstByteSeq <<
     " m_sentSize = " << tcpTxBuf.m_sentSize;
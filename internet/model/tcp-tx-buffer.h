@@ -22,14 +22,17 @@
 #ifndef TCP_TX_BUFFER_H
 #define TCP_TX_BUFFER_H
 
+#include <map>
 #include "ns3/object.h"
 #include "ns3/traced-value.h"
 #include "ns3/sequence-number.h"
 #include "ns3/nstime.h"
 #include "ns3/tcp-option-sack.h"
+#include "segment-ring.h"
 
 namespace ns3 {
 class Packet;
+class TcpRateOps;
 
 /**
  * \ingroup tcp
@@ -62,6 +65,21 @@ public:
   Time m_lastSent;      //!< Timestamp of the time at which the segment has
                         //   been sent last time
   bool m_sacked;        //!< Indicates if the segment has been SACKed
+  SequenceNumber32 m_startSeq; //!< Sequence number of the first byte (in the SentList)
+
+  /**
+   * \brief Delivery state of the connection when the segment was last sent
+   * (see TcpRateOps)
+   */
+  struct RateInformation
+  {
+    uint64_t m_delivered;     //!< Bytes delivered by the connection
+    Time     m_deliveredTime; //!< Time the delivered count was last updated
+    Time     m_firstSent;     //!< Send time of the segment starting the interval
+    bool     m_isAppLimited;  //!< Connection application limited
+  };
+
+  RateInformation m_rateInfo; //!< Delivery state when the segment was last sent
 };
 
 /**
@@ -81,12 +99,19 @@ public:
  * class is allowed to return only ordered (using "<" as operator) subsets
  * (e.g. 1,2 or 2,3 or 1,2,3).
  *
- * The data structure underlying this is composed by two distinct packet lists.
- * The first (SentList) is initially empty, and it contains the packets
- * returned by the method CopyFromSequence. The second (AppList) is initially
- * empty, and it contains the packets coming from the applications, but that
- * are not transmitted yet as segments. To discover how the chunks are managed
- * and retrieved from these lists, check CopyFromSequence documentation.
+ * The data structure underlying this is composed by two distinct rings of
+ * TcpTxItem (SegmentRing), kept by value in arrays. The first (SentList) is
+ * initially empty, and it contains the segments returned by the method
+ * CopyFromSequence, in sequence order; each knows the sequence number of its
+ * first byte, so a segment is found by bisection. The second (AppList) is
+ * initially empty, and it contains the packets coming from the applications,
+ * but that are not transmitted yet as segments. New segments are sliced from
+ * the head of the AppList (CreateFragment shares the bytes of the packet)
+ * and pushed at the back of the SentList, and acknowledged segments are
+ * popped from its front, so that a bulk transfer neither allocates nor
+ * moves segment descriptors once the rings have grown to the window. To
+ * discover how the chunks are managed and retrieved from these lists, check
+ * CopyFromSequence documentation.
  *
  * The head of the data is represented by m_firstByteSeq, and it is returned by
  * HeadSequence(). The last byte is returned by TailSequence(). In this class,
@@ -106,18 +131,27 @@ public:
  * documentation) and maintaining the scoreboard is a matter of travelling the
  * list and set the SACK flag on the corresponding segment sent.
  *
- * Inefficiencies
- * --------------
+ * Scoreboard indexes
+ * ------------------
  *
- * The algorithms outlined in RFC 6675 are full of inefficiencies. In
- * particular, traveling all the sent list each time it is needed to compute
- * the bytes in flight is expensive. We try to overcome the issue by
- * maintaining a pointer to the highest sequence SACKed; in this way, we can
- * avoid traveling all the list in some cases. Another option could be keeping
- * a count of each critical value (e.g., the number of packets sacked).
- * However, this would be different from the algorithms in RFC. There are some
- * other possible improvements; if you wish, take a look and try  to add some
- * earlier exit conditions in the loops.
+ * The algorithms outlined in RFC 6675 are written as walks over the whole
+ * sent list (IsLost even walks the list above each segment), which costs
+ * O(n^2) per ACK for a window of n segments. Instead, the scoreboard keeps,
+ * as the flags of the sent segments change:
+ *
+ * - the SACKed segments with their size, keyed by sequence;
+ * - the count of the bytes neither SACKed nor marked lost, and of the
+ *   retransmitted segments;
+ * - a cursor below which there is no "hole" (segment neither SACKed nor
+ *   retransmitted), and one below which there is no hole marked as lost,
+ *   from which NextSeg looks for its candidates.
+ *
+ * Since a segment is lost (per IsLost) when enough SACKed segments are
+ * above it, the un-SACKed segments lost are the ones below a boundary,
+ * found by visiting only the dupThresh highest SACKed segments. The bytes
+ * in flight are then the bytes neither SACKed nor marked lost, less the
+ * holes below the boundary; the latter are kept up to date as the boundary
+ * moves, which it does mostly upwards, one SACK at a time.
  *
  * \see Size
  * \see SizeFromSequence
@@ -332,88 +366,92 @@ public:
    */
   Ptr<const TcpOptionSack> CraftSackOption (const SequenceNumber32 &seq, uint8_t available) const;
 
+  /**
+   * \brief Set the delivery rate estimator of the segments
+   *
+   * The estimator is told about the segments sent, cumulatively ACKed and
+   * SACKed.
+   *
+   * \param rateOps the estimator, or 0 for none
+   */
+  void SetRateOps (Ptr<TcpRateOps> rateOps);
+
 private:
   friend std::ostream & operator<< (std::ostream & os, TcpTxBuffer const & tcpTxBuf);
 
-  typedef std::list<TcpTxItem*> PacketList; //!< container for data stored in the buffer
+  typedef SegmentRing<TcpTxItem> PacketList; //!< container for data stored in the buffer
 
   /**
-   * \brief Check if a segment is lost per RFC 6675
-   * \param seq sequence to check
-   * \param segment Iterator pointing at seq
+   * \brief Get the sequence below which the un-SACKed segments are lost
+   *
+   * Per RFC 6675, a segment is lost when dupThresh discontiguous SACKed
+   * segments, or more than (dupThresh - 1) * segmentSize SACKed bytes, are
+   * above it, so only the highest SACKed segments are visited.
+   *
    * \param dupThresh dupAck threshold
    * \param segmentSize segment size
-   * \return true if the sequence is supposed to be lost, false otherwise
+   * \return the start of the highest SACKed segment reaching the threshold,
+   * or the head of the buffer if the threshold is not reached
    */
-  bool IsLost (const SequenceNumber32 &seq, const PacketList::const_iterator &segment, uint32_t dupThresh,
-               uint32_t segmentSize) const;
+  SequenceNumber32 GetLostBoundary (uint32_t dupThresh, uint32_t segmentSize) const;
 
   /**
-   * \brief Get a block of data not transmitted yet and move it into SentList
-   *
-   * If the block is not yet transmitted, hopefully, seq is exactly the sequence
-   * number of the first byte of the first packet inside AppList. We extract
-   * the block from AppList and move it into the SentList, before returning the
-   * block itself. We manage possible fragmentation (or merges) inside AppList
-   * through GetPacketFromList.
-   *
-   * \see GetPacketFromList
-   * \param numBytes number of bytes to copy
-   *
-   * \return the item that contains the right packet
+   * \brief Find the first hole of the SentList, from the hole cursors
+   * \param lost true to find the first hole marked as lost
+   * \return its position in the SentList, or the size of the SentList if
+   * there is none
    */
-  TcpTxItem* GetNewSegment (uint32_t numBytes);
+  uint32_t FirstHole (bool lost) const;
 
   /**
-   * \brief Get a block of data previously transmitted
-   *
-   * This is clearly a retransmission, and if everything is going well,
-   * the block requested is matching perfectly with another one requested
-   * in the past. If not, fragmentation or merge are required. We manage
-   * both inside GetPacketFromList.
-   *
-   * \see GetPacketFromList
-   *
-   * \param numBytes number of bytes to copy
-   * \param seq sequence requested
-   * \returns the item that contains the right packet
+   * \brief Find a sequence number in the SentList
+   * \param seq the sequence number
+   * \return the position of the first segment starting at or after seq
    */
-  TcpTxItem* GetTransmittedSegment (uint32_t numBytes, const SequenceNumber32 &seq);
+  uint32_t LowerBound (const SequenceNumber32 &seq) const;
 
   /**
-   * \brief Get a block (which is returned as Packet) from a list
-   *
-   * This function extract a block [requestedSeq,numBytes) from the list, which
-   * starts at startingSeq.
+   * \brief Add a segment of the SentList to the scoreboard
+   * \param item the segment
+   */
+  void ScoreboardAdd (const TcpTxItem &item);
+
+  /**
+   * \brief Remove a segment of the SentList from the scoreboard
    *
-   * The cases we need to manage are two, and they are depicted in the following
-   * image:
+   * It must be called before changing the flags, the size or the position
+   * of the segment, and ScoreboardAdd after.
    *
-   *\verbatim
-                       |------|     |----|     |----|
-                list = |      | --> |    | --> |    |
-                       |------|     |----|     |----|
-
-                       ^      ^
-                       | ^ ^  |         (1)
-                     seq | |  seq + numBytes
-                         | |
-                         | |
-                      seq   seq + numBytes     (2)
-   \endverbatim
+   * \param item the segment
+   */
+  void ScoreboardRemove (const TcpTxItem &item);
+
+  /**
+   * \brief Rebuild the scoreboard from the SentList
+   */
+  void RebuildScoreboard (void);
+
+  /**
+   * \brief Get a block of data not transmitted yet and move it into SentList
    *
-   * The case 1 is easy to manage: the requested block is exactly a packet
-   * already stored. If one value (seq or seq + numBytes) does not align
-   * to a packet boundary, or when both values does not align (case 2), it is
-   * a bit more complex.
+   * The block is sliced from the head of the AppList, starting at
+   * m_appOffset: a packet longer than the block is fragmented, and the
+   * packets following the first one are appended to it if the block spans
+   * them. The block is then pushed at the back of the SentList.
    *
-   * Basically, we have two possible operations:
+   * \param numBytes number of bytes to copy
    *
-   *  - fragment : split an existing packet in two
-   *  - merge    : merge two existing packets in one
+   * \return the position of the segment in the SentList
+   */
+  uint32_t GetNewSegment (uint32_t numBytes);
+
+  /**
+   * \brief Get a block of data previously transmitted
    *
-   * and we reduce case (2) to case (1) through sequentially applying fragment
-   * or merge. For instance:
+   * This is clearly a retransmission, and if everything is going well,
+   * the block requested is matching perfectly with another one requested
+   * in the past. If not, the segments of the SentList are changed so that
+   * one is exactly the block:
    *
    *\verbatim
       |------|
@@ -428,31 +466,29 @@ private:
            seq + numBytes
    \endverbatim
    *
-   * To reduce to case (1), we need to perform two fragment operations:
+   * - if seq is inside a segment, the segment is split at seq (fragment
+   *   (start, seq));
+   * - if the block spans several segments, they are merged;
+   * - if seq + numBytes is inside the resulting segment, it is split there
+   *   (fragment (seq + numBytes, end)).
    *
-   * - fragment (start, seq)
-   * - fragment (seq + numBytes, end)
-   *
-   * After these operations, the requested block is exactly the resulting packet.
-   * Merge operation is required when the requested block span over two (or more)
-   * existing packets.
-   *
-   * While this could be extremely slow in the worst possible scenario (one big
+   * While this could be slow in the worst possible scenario (one big
    * packet which is split in small packets for transmission, and merged for
    * re-transmission) that scenario is unlikely during a TCP transmission (since
    * MSS can change, but it is stable, and retransmissions do not happen for
    * each segment).
    *
-   * \param list List to extract block from
-   * \param startingSeq Starting sequence of the list
-   * \param numBytes Bytes to extract, starting from requestedSeq
-   * \param requestedSeq Requested sequence
-   * \param listEdited output parameter which indicates if the list has been edited
-   * \return the item that contains the right packet
+   * \param numBytes number of bytes to copy
+   * \param seq sequence requested
+   * \returns the position of the segment in the SentList
    */
-  TcpTxItem* GetPacketFromList (PacketList &list, const SequenceNumber32 &startingSeq,
-                                uint32_t numBytes, const SequenceNumber32 &requestedSeq,
-                                bool *listEdited) const;
+  uint32_t GetTransmittedSegment (uint32_t numBytes, const SequenceNumber32 &seq);
+
+  /**
+   * \brief Drop the bytes of the first AppList packet already moved into
+   * the SentList, before putting segments back in front of it
+   */
+  void TrimAppHead (void);
 
   /**
    * \brief Merge two TcpTxItem
@@ -477,14 +513,8 @@ private:
    */
   void SplitItems (TcpTxItem &t1, TcpTxItem &t2, uint32_t size) const;
 
-  /**
-   * \brief Find the highest SACK byte
-   * \return a pair with the highest byte and an iterator inside m_sentList
-   */
-  std::pair <TcpTxBuffer::PacketList::const_iterator, SequenceNumber32>
-  GetHighestSacked () const;
-
   PacketList m_appList;  //!< Buffer for application data
+  uint32_t m_appOffset;  //!< Bytes of the first AppList packet already in the SentList
   PacketList m_sentList; //!< Buffer for sent (but not acked) data
   uint32_t m_maxBuffer;  //!< Max number of data bytes in buffer (SND.WND)
   uint32_t m_size;       //!< Size of all data in this buffer
@@ -492,7 +522,15 @@ private:
 
   TracedValue<SequenceNumber32> m_firstByteSeq; //!< Sequence number of the first byte in data (SND.UNA)
 
-  std::pair <PacketList::const_iterator, SequenceNumber32> m_highestSack; //!< Highest SACK byte
+  std::map<SequenceNumber32, uint32_t> m_sacked;  //!< Size of the SACKed segments, by first sequence
+  uint32_t m_outBytes;                            //!< Bytes sent, neither SACKed nor marked lost
+  uint32_t m_retransCount;                        //!< Segments retransmitted
+  mutable SequenceNumber32 m_pipeBoundary;        //!< Lost boundary of the last BytesInFlight
+  mutable uint32_t m_pipeLostBytes;               //!< Bytes of the holes not marked lost below m_pipeBoundary
+  mutable SequenceNumber32 m_holeCursor;          //!< No hole starts below this sequence
+  mutable SequenceNumber32 m_lostHoleCursor;      //!< No hole marked as lost starts below this sequence
+
+  Ptr<TcpRateOps> m_rateOps;                      //!< Delivery rate estimator, if any
 
 };
 
@@ -0,0 +1,173 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef WINDOWED_FILTER_H
+#define WINDOWED_FILTER_H
+
+namespace ns3 {
+
+/**
+ * \ingroup tcp
+ *
+ * \brief Best value of the samples of a sliding window, in constant time
+ *
+ * This is the min/max filter of Kathleen Nichols, as in Linux
+ * (lib/minmax.c): instead of all the samples of the window, the filter
+ * keeps the best, second best and third best samples of its three
+ * sub-windows, so that an update costs a few comparisons, and the best
+ * sample is at hand.  When the best sample leaves the window, the second
+ * best takes its place; the estimate is then off by at most the spread of
+ * the samples of a sub-window.
+ *
+ * Compare tells if a sample is at least as good as another one:
+ * std::greater_equal gives the maximum, std::less_equal the minimum.  The
+ * time is anything that can be subtracted and compared with the window
+ * length, e.g., a Time, or a count of round trips.
+ *
+ * \tparam V the type of the samples
+ * \tparam T the type of the time of the samples
+ * \tparam Compare the comparison of the samples
+ */
+template <class V, class T, class Compare>
+class WindowedFilter
+{
+public:
+  /**
+   * \brief Constructor
+   * \param window the length of the window
+   * \param zero the value of the filter before any sample
+   * \param start the time of the filter before any sample
+   */
+  WindowedFilter (T window, V zero, T start)
+    : m_window (window)
+  {
+    Reset (zero, start);
+  }
+
+  /**
+   * \brief Set the length of the window
+   * \param window the length of the window
+   */
+  void SetWindowLength (T window)
+  {
+    m_window = window;
+  }
+
+  /**
+   * \brief Forget all the samples, but one
+   * \param value the value of the sample
+   * \param time the time of the sample
+   */
+  void Reset (V value, T time)
+  {
+    m_samples[0].m_value = m_samples[1].m_value = m_samples[2].m_value = value;
+    m_samples[0].m_time = m_samples[1].m_time = m_samples[2].m_time = time;
+  }
+
+  /**
+   * \brief Add a sample
+   *
+   * The times of the samples must not decrease.
+   *
+   * \param value the value of the sample
+   * \param time the time of the sample
+   */
+  void Update (V value, T time)
+  {
+    Compare better;
+    if (better (value, m_samples[0].m_value) || time - m_samples[2].m_time > m_window)
+      {
+        // A new best, or nothing left in the window
+        Reset (value, time);
+        return;
+      }
+
+    if (better (value, m_samples[1].m_value))
+      {
+        m_samples[2].m_value = m_samples[1].m_value = value;
+        m_samples[2].m_time = m_samples[1].m_time = time;
+      }
+    else if (better (value, m_samples[2].m_value))
+      {
+        m_samples[2].m_value = value;
+        m_samples[2].m_time = time;
+      }
+
+    // Age the sub-windows
+    T dt = time - m_samples[0].m_time;
+    if (dt > m_window)
+      {
+        // The best sample left the window: the second best takes its place,
+        // and so on, and the new sample is the third best
+        m_samples[0] = m_samples[1];
+        m_samples[1] = m_samples[2];
+        m_samples[2].m_value = value;
+        m_samples[2].m_time = time;
+        if (time - m_samples[0].m_time > m_window)
+          {
+            m_samples[0] = m_samples[1];
+            m_samples[1] = m_samples[2];
+            m_samples[2].m_value = value;
+            m_samples[2].m_time = time;
+          }
+      }
+    else if (m_samples[1].m_time == m_samples[0].m_time && dt > m_window / 4)
+      {
+        // A quarter of the window went by without a second best
+        m_samples[2].m_value = m_samples[1].m_value = value;
+        m_samples[2].m_time = m_samples[1].m_time = time;
+      }
+    else if (m_samples[2].m_time == m_samples[1].m_time && dt > m_window / 2)
+      {
+        // Half of the window went by without a third best
+        m_samples[2].m_value = value;
+        m_samples[2].m_time = time;
+      }
+  }
+
+  /**
+   * \brief Get the best sample of the window
+   * \return the value of the best sample
+   */
+  V GetBest (void) const
+  {
+    return m_samples[0].m_value;
+  }
+
+  /**
+   * \brief Get the time of the best sample of the window
+   * \return the time of the best sample
+   */
+  T GetBestTime (void) const
+  {
+    return m_samples[0].m_time;
+  }
+
+private:
+  /// A sample
+  struct Sample
+  {
+    V m_value;  //!< Value of the sample
+    T m_time;   //!< Time of the sample
+  };
+
+  T m_window;            //!< Length of the window
+  Sample m_samples[3];   //!< Best, second best and third best samples
+};
+
+} // namespace ns3
+
+#endif /* WINDOWED_FILTER_H */
@@ -0,0 +1,213 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <set>
+#include "ns3/test.h"
+#include "ns3/object.h"
+#include "ns3/ipv4-end-point.h"
+#include "ns3/ipv4-end-point-demux.h"
+#include "ns3/ipv4-interface.h"
+#include "ns3/ipv6-end-point.h"
+#include "ns3/ipv6-end-point-demux.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that Ipv4EndPointDemux finds connections, listeners and
+ * free ephemeral ports as the endpoints come, change peer and go.
+ */
+class Ipv4EndPointDemuxTestCase : public TestCase
+{
+public:
+  Ipv4EndPointDemuxTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Look up the endpoint of a packet.
+   * \param demux the demux
+   * \param daddr destination address of the packet
+   * \param dport destination port of the packet
+   * \param saddr source address of the packet
+   * \param sport source port of the packet
+   * \return the endpoint, or 0 if none matches
+   */
+  Ipv4EndPoint *Lookup (Ipv4EndPointDemux &demux, const char *daddr, uint16_t dport,
+                        const char *saddr, uint16_t sport);
+
+  Ptr<Ipv4Interface> m_interface; //!< the incoming interface of the packets
+};
+
+Ipv4EndPointDemuxTestCase::Ipv4EndPointDemuxTestCase ()
+  : TestCase ("Ipv4EndPointDemux lookups and ephemeral ports")
+{
+}
+
+Ipv4EndPoint *
+Ipv4EndPointDemuxTestCase::Lookup (Ipv4EndPointDemux &demux, const char *daddr, uint16_t dport,
+                                   const char *saddr, uint16_t sport)
+{
+  Ipv4EndPointDemux::EndPoints endPoints = demux.Lookup (Ipv4Address (daddr), dport,
+                                                         Ipv4Address (saddr), sport, m_interface);
+  return endPoints.empty () ? 0 : endPoints.front ();
+}
+
+void
+Ipv4EndPointDemuxTestCase::DoRun (void)
+{
+  m_interface = CreateObject<Ipv4Interface> ();
+  Ipv4EndPointDemux demux;
+
+  // A listener and two of its connections
+  Ipv4EndPoint *listener = demux.Allocate (0, Ipv4Address::GetAny (), 80);
+  Ipv4EndPoint *first = demux.Allocate (0, Ipv4Address ("10.0.0.1"), 80, Ipv4Address ("10.0.0.2"), 1000);
+  Ipv4EndPoint *second = demux.Allocate (0, Ipv4Address ("10.0.0.1"), 80, Ipv4Address ("10.0.0.3"), 1000);
+  NS_TEST_EXPECT_MSG_EQ ((demux.Allocate (0, Ipv4Address ("10.0.0.1"), 80, Ipv4Address ("10.0.0.2"), 1000) == 0),
+                         true, "Duplicated connection allocated");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", 80, "10.0.0.2", 1000), first, "Wrong connection");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", 80, "10.0.0.3", 1000), second, "Wrong connection");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", 80, "10.0.0.2", 1001), listener, "Not the listener");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", 81, "10.0.0.2", 1000), 0, "Unbound port matched");
+  NS_TEST_EXPECT_MSG_EQ (demux.SimpleLookup (Ipv4Address ("10.0.0.1"), 80, Ipv4Address ("10.0.0.3"), 1000),
+                         second, "Wrong connection");
+
+  // A connection is found by its new peer once it changes
+  Ipv4EndPoint *client = demux.Allocate (Ipv4Address ("10.0.0.1"));
+  uint16_t clientPort = client->GetLocalPort ();
+  client->SetPeer (Ipv4Address ("10.0.0.4"), 443);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", clientPort, "10.0.0.4", 443), client, "Connection not found");
+  client->SetPeer (Ipv4Address ("10.0.0.5"), 443);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", clientPort, "10.0.0.4", 443), 0, "Old peer still found");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", clientPort, "10.0.0.5", 443), client, "Connection not found");
+
+  // Closed connections fall back to the listener
+  demux.DeAllocate (first);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", 80, "10.0.0.2", 1000), listener, "Not the listener");
+  NS_TEST_EXPECT_MSG_EQ (demux.LookupPortLocal (80), true, "Port 80 is bound");
+  demux.DeAllocate (second);
+  demux.DeAllocate (listener);
+  NS_TEST_EXPECT_MSG_EQ (demux.LookupPortLocal (80), false, "Port 80 is free");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "10.0.0.1", 80, "10.0.0.2", 1000), 0, "Closed port matched");
+
+  // Every ephemeral port is allocated once, and a freed one is reused
+  std::set<uint16_t> ports;
+  ports.insert (clientPort);
+  Ipv4EndPoint *endPoint = 0;
+  for (uint32_t i = 1; i < 16384; ++i)
+    {
+      endPoint = demux.Allocate ();
+      NS_TEST_ASSERT_MSG_NE (endPoint, 0, "Ephemeral port " << i << " not allocated");
+      ports.insert (endPoint->GetLocalPort ());
+    }
+  NS_TEST_EXPECT_MSG_EQ (ports.size (), 16384, "An ephemeral port was allocated twice");
+  NS_TEST_EXPECT_MSG_EQ (demux.Allocate (), 0, "Allocated more ephemeral ports than exist");
+  uint16_t freed = endPoint->GetLocalPort ();
+  demux.DeAllocate (endPoint);
+  endPoint = demux.Allocate ();
+  NS_TEST_ASSERT_MSG_NE (endPoint, 0, "Freed ephemeral port not reused");
+  NS_TEST_EXPECT_MSG_EQ (endPoint->GetLocalPort (), freed, "Freed ephemeral port not reused");
+
+  m_interface = 0;
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that Ipv6EndPointDemux finds connections and listeners as
+ * the endpoints come, change peer and go.
+ */
+class Ipv6EndPointDemuxTestCase : public TestCase
+{
+public:
+  Ipv6EndPointDemuxTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Look up the endpoint of a packet.
+   * \param demux the demux
+   * \param daddr destination address of the packet
+   * \param dport destination port of the packet
+   * \param saddr source address of the packet
+   * \param sport source port of the packet
+   * \return the endpoint, or 0 if none matches
+   */
+  Ipv6EndPoint *Lookup (Ipv6EndPointDemux &demux, const char *daddr, uint16_t dport,
+                        const char *saddr, uint16_t sport);
+};
+
+Ipv6EndPointDemuxTestCase::Ipv6EndPointDemuxTestCase ()
+  : TestCase ("Ipv6EndPointDemux lookups")
+{
+}
+
+Ipv6EndPoint *
+Ipv6EndPointDemuxTestCase::Lookup (Ipv6EndPointDemux &demux, const char *daddr, uint16_t dport,
+                                   const char *saddr, uint16_t sport)
+{
+  Ipv6EndPointDemux::EndPoints endPoints = demux.Lookup (Ipv6Address (daddr), dport,
+                                                         Ipv6Address (saddr), sport, 0);
+  return endPoints.empty () ? 0 : endPoints.front ();
+}
+
+void
+Ipv6EndPointDemuxTestCase::DoRun (void)
+{
+  Ipv6EndPointDemux demux;
+
+  Ipv6EndPoint *listener = demux.Allocate (0, Ipv6Address::GetAny (), 80);
+  Ipv6EndPoint *first = demux.Allocate (0, Ipv6Address ("2001::1"), 80, Ipv6Address ("2001::2"), 1000);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "2001::1", 80, "2001::2", 1000), first, "Wrong connection");
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "2001::1", 80, "2001::3", 1000), listener, "Not the listener");
+
+  Ipv6EndPoint *client = demux.Allocate (Ipv6Address ("2001::1"));
+  uint16_t clientPort = client->GetLocalPort ();
+  client->SetPeer (Ipv6Address ("2001::4"), 443);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "2001::1", clientPort, "2001::4", 443), client, "Connection not found");
+  NS_TEST_EXPECT_MSG_EQ (demux.SimpleLookup (Ipv6Address ("2001::1"), clientPort, Ipv6Address ("2001::4"), 443),
+                         client, "Connection not found");
+
+  demux.DeAllocate (first);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "2001::1", 80, "2001::2", 1000), listener, "Not the listener");
+  demux.DeAllocate (listener);
+  NS_TEST_EXPECT_MSG_EQ (Lookup (demux, "2001::1", 80, "2001::2", 1000), 0, "Closed port matched");
+  NS_TEST_EXPECT_MSG_EQ (demux.GetEndPoints ().size (), 1, "Wrong number of endpoints");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Endpoint demultiplexing TestSuite
+ */
+class EndPointDemuxTestSuite : public TestSuite
+{
+public:
+  EndPointDemuxTestSuite ()
+    : TestSuite ("end-point-demux", UNIT)
+  {
+    AddTestCase (new Ipv4EndPointDemuxTestCase, TestCase::QUICK);
+    AddTestCase (new Ipv6EndPointDemuxTestCase, TestCase::QUICK);
+  }
+};
+
+static EndPointDemuxTestSuite g_endPointDemuxTestSuite; //!< Static variable for test initialization
@@ -27,6 +27,7 @@
 #include "ns3/candidate-queue.h"
 #include "ns3/simulator.h"
 #include <cstdlib> // for rand()
+#include <vector>
 
 using namespace ns3;
 
@@ -226,6 +227,145 @@ GlobalRouteManagerImplTestCase::DoRun (void)
 }
 
 
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief CandidateQueue ordering, Find () and Update () test
+ */
+class CandidateQueueTestCase : public TestCase
+{
+public:
+  CandidateQueueTestCase ();
+  virtual void DoRun (void);
+};
+
+CandidateQueueTestCase::CandidateQueueTestCase ()
+  : TestCase ("CandidateQueue priority order and decrease-key")
+{
+}
+
+void
+CandidateQueueTestCase::DoRun (void)
+{
+  CandidateQueue candidate;
+  std::vector<SPFVertex *> vertices;
+
+  // distance, type: 5 routers and 2 networks
+  uint32_t distances[] = { 7, 3, 3, 9, 3, 5, 7 };
+  SPFVertex::VertexType types[] = { SPFVertex::VertexRouter, SPFVertex::VertexRouter,
+                                    SPFVertex::VertexNetwork, SPFVertex::VertexRouter,
+                                    SPFVertex::VertexRouter, SPFVertex::VertexNetwork,
+                                    SPFVertex::VertexRouter };
+  for (uint32_t i = 0; i < 7; ++i)
+    {
+      SPFVertex *v = new SPFVertex;
+      v->SetVertexId (Ipv4Address (i + 1));
+      v->SetVertexType (types[i]);
+      v->SetDistanceFromRoot (distances[i]);
+      vertices.push_back (v);
+      candidate.Push (v);
+    }
+  NS_TEST_ASSERT_MSG_EQ (candidate.Size (), 7, "Wrong queue size");
+  NS_TEST_ASSERT_MSG_EQ (candidate.Find (Ipv4Address (4)), vertices[3], "Find () returned the wrong vertex");
+  NS_TEST_ASSERT_MSG_EQ (candidate.Find (Ipv4Address (42)), 0, "Find () found a vertex not in the queue");
+
+  // The last vertex moves ahead of the network at distance 5, but stays
+  // after the routers already queued at distance 3
+  vertices[6]->SetDistanceFromRoot (3);
+  candidate.Update (vertices[6]);
+
+  // Networks first at equal distance, then routers in queuing order
+  uint32_t expected[] = { 2, 1, 4, 6, 5, 0, 3 };
+  for (uint32_t i = 0; i < 7; ++i)
+    {
+      SPFVertex *v = candidate.Pop ();
+      NS_TEST_ASSERT_MSG_EQ (v, vertices[expected[i]], "Vertex " << i << " popped out of order");
+      NS_TEST_EXPECT_MSG_EQ (candidate.Find (v->GetVertexId ()), 0, "Popped vertex still found");
+      delete v;
+    }
+  NS_TEST_ASSERT_MSG_EQ (candidate.Empty (), true, "Queue should be empty");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief GlobalRouteManagerLSDB lookups by link state ID, number and LinkData
+ */
+class GlobalRouteManagerLSDBTestCase : public TestCase
+{
+public:
+  GlobalRouteManagerLSDBTestCase ();
+  virtual void DoRun (void);
+};
+
+GlobalRouteManagerLSDBTestCase::GlobalRouteManagerLSDBTestCase ()
+  : TestCase ("GlobalRouteManagerLSDB lookups")
+{
+}
+
+void
+GlobalRouteManagerLSDBTestCase::DoRun (void)
+{
+  // Routers 0.0.0.3 and 0.0.0.1 both claim 10.1.0.1 on the LAN 10.1.0.0/24,
+  // and are inserted in that order
+  GlobalRoutingLSA* lsa3 = new GlobalRoutingLSA ();
+  lsa3->SetLSType (GlobalRoutingLSA::RouterLSA);
+  lsa3->SetLinkStateId ("0.0.0.3");
+  lsa3->SetAdvertisingRouter ("0.0.0.3");
+  lsa3->AddLinkRecord (new GlobalRoutingLinkRecord (GlobalRoutingLinkRecord::TransitNetwork,
+                                                    "10.1.0.1", "10.1.0.1", 1));
+  lsa3->AddLinkRecord (new GlobalRoutingLinkRecord (GlobalRoutingLinkRecord::TransitNetwork,
+                                                    "10.2.0.1", "10.2.0.3", 1));
+
+  GlobalRoutingLSA* lsa1 = new GlobalRoutingLSA ();
+  lsa1->SetLSType (GlobalRoutingLSA::RouterLSA);
+  lsa1->SetLinkStateId ("0.0.0.1");
+  lsa1->SetAdvertisingRouter ("0.0.0.1");
+  lsa1->AddLinkRecord (new GlobalRoutingLinkRecord (GlobalRoutingLinkRecord::TransitNetwork,
+                                                    "10.1.0.1", "10.1.0.1", 1));
+  lsa1->AddLinkRecord (new GlobalRoutingLinkRecord (GlobalRoutingLinkRecord::StubNetwork,
+                                                    "10.3.0.0", "255.255.255.0", 1));
+
+  GlobalRoutingLSA* network = new GlobalRoutingLSA ();
+  network->SetLSType (GlobalRoutingLSA::NetworkLSA);
+  network->SetLinkStateId ("10.1.0.1");
+  network->SetAdvertisingRouter ("0.0.0.1");
+  network->SetNetworkLSANetworkMask ("255.255.255.0");
+  network->AddAttachedRouter ("10.1.0.1");
+
+  GlobalRoutingLSA* external = new GlobalRoutingLSA ();
+  external->SetLSType (GlobalRoutingLSA::ASExternalLSAs);
+  external->SetLinkStateId ("192.168.0.0");
+  external->SetAdvertisingRouter ("0.0.0.3");
+
+  GlobalRouteManagerLSDB lsdb;
+  lsdb.Insert (lsa3->GetLinkStateId (), lsa3);
+  lsdb.Insert (lsa1->GetLinkStateId (), lsa1);
+  lsdb.Insert (network->GetLinkStateId (), network);
+  lsdb.Insert (external->GetLinkStateId (), external);
+
+  NS_TEST_ASSERT_MSG_EQ (lsdb.GetNumLSAs (), 3, "External LSAs are kept apart");
+  NS_TEST_ASSERT_MSG_EQ (lsdb.GetNumExtLSAs (), 1, "External LSA not found");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetExtLSA (0), external, "Wrong external LSA");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAByIndex (0), lsa3, "LSAs are numbered in insertion order");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAByIndex (2), network, "LSAs are numbered in insertion order");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAIndex ("0.0.0.1"), 1, "Wrong number for 0.0.0.1");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSA ("0.0.0.1"), lsa1, "Wrong LSA for 0.0.0.1");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSA ("10.1.0.1"), network, "Wrong LSA for the network");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAIndex ("0.0.0.2"), lsdb.GetNumLSAs (), "Unknown router found");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSA ("0.0.0.2"), 0, "Unknown router found");
+
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAByLinkData ("10.1.0.1"), lsa1, "The lowest link state ID wins");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAIndexByLinkData ("10.1.0.1"), 1, "The lowest link state ID wins");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAByLinkData ("10.2.0.3"), lsa3, "Wrong router for 10.2.0.3");
+  // Only the LinkData of transit records is indexed
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAByLinkData ("10.2.0.1"), 0, "Link ID found as LinkData");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAByLinkData ("255.255.255.0"), 0, "Stub record indexed");
+  NS_TEST_EXPECT_MSG_EQ (lsdb.GetLSAIndexByLinkData ("10.9.0.1"), lsdb.GetNumLSAs (), "Unknown address found");
+}
+
 /**
  * \ingroup internet-test
  * \ingroup tests
@@ -243,6 +383,8 @@ GlobalRouteManagerImplTestSuite::GlobalRouteManagerImplTestSuite ()
   : TestSuite ("global-route-manager-impl", UNIT)
 {
   AddTestCase (new GlobalRouteManagerImplTestCase (), TestCase::QUICK);
+  AddTestCase (new CandidateQueueTestCase (), TestCase::QUICK);
+  AddTestCase (new GlobalRouteManagerLSDBTestCase (), TestCase::QUICK);
 }
 
 static GlobalRouteManagerImplTestSuite g_globalRoutingManagerImplTestSuite; //!< Static variable for test initialization
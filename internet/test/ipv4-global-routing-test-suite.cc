@@ -14,9 +14,13 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <map>
+#include <sstream>
 #include <vector>
 #include "ns3/boolean.h"
 #include "ns3/config.h"
+#include "ns3/enum.h"
+#include "ns3/global-value.h"
 #include "ns3/inet-socket-address.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
@@ -41,6 +45,7 @@
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-routing-table-entry.h"
 #include "ns3/ipv4-global-routing.h"
+#include "ns3/ipv4-fib.h"
 #include "ns3/bridge-helper.h"
 
 using namespace ns3;
@@ -1244,6 +1249,705 @@ Ipv4GlobalRoutingSlash32TestCase::DoRun (void)
   Simulator::Destroy ();
 }
 
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check the compiled forwarding table returns, for any address,
+ * the values of all the prefixes covering it, in the order they were added.
+ */
+class Ipv4FibTestCase : public TestCase
+{
+public:
+  Ipv4FibTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Check the values found for an address.
+   * \param fib the forwarding table
+   * \param dest the address
+   * \param expected the expected values, in order
+   */
+  void CheckLookup (Ipv4Fib const &fib, std::string dest, std::vector<uint32_t> expected);
+};
+
+Ipv4FibTestCase::Ipv4FibTestCase ()
+  : TestCase ("Ipv4Fib lookups")
+{
+}
+
+void
+Ipv4FibTestCase::CheckLookup (Ipv4Fib const &fib, std::string dest, std::vector<uint32_t> expected)
+{
+  uint32_t const *values;
+  uint32_t n = fib.Lookup (Ipv4Address (dest.c_str ()), values);
+  NS_TEST_ASSERT_MSG_EQ (n, expected.size (), "Wrong number of routes to " << dest);
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (values[i], expected[i], "Wrong route " << i << " to " << dest);
+    }
+}
+
+void
+Ipv4FibTestCase::DoRun (void)
+{
+  Ipv4Fib fib;
+  CheckLookup (fib, "10.0.0.1", std::vector<uint32_t> ());
+
+  fib.Add (Ipv4Address ("10.1.2.0"), Ipv4Mask ("/24"), 0);
+  fib.Add (Ipv4Address ("10.0.0.0"), Ipv4Mask ("/8"), 1);
+  fib.Add (Ipv4Address ("10.1.2.3"), Ipv4Mask ("/32"), 2);
+  fib.Add (Ipv4Address ("10.1.2.0"), Ipv4Mask ("/24"), 3);
+  fib.Add (Ipv4Address ("10.1.0.0"), Ipv4Mask ("/20"), 4);
+  fib.Add (Ipv4Address ("172.16.0.0"), Ipv4Mask ("/12"), 5);
+  fib.Build ();
+
+  uint32_t all[] = { 0, 1, 2, 3, 4 };
+  CheckLookup (fib, "10.1.2.3", std::vector<uint32_t> (all, all + 5));
+  uint32_t subnet[] = { 0, 1, 3, 4 };
+  CheckLookup (fib, "10.1.2.4", std::vector<uint32_t> (subnet, subnet + 4));
+  uint32_t block[] = { 1, 4 };
+  CheckLookup (fib, "10.1.15.255", std::vector<uint32_t> (block, block + 2));
+  CheckLookup (fib, "10.1.16.0", std::vector<uint32_t> (1, 1));
+  CheckLookup (fib, "172.31.255.255", std::vector<uint32_t> (1, 5));
+  CheckLookup (fib, "172.32.0.0", std::vector<uint32_t> ());
+  CheckLookup (fib, "11.0.0.0", std::vector<uint32_t> ());
+
+  // A default route covers every address, after a rebuild
+  fib.Add (Ipv4Address ("0.0.0.0"), Ipv4Mask::GetZero (), 6);
+  fib.Build ();
+  uint32_t withDefault[] = { 1, 4, 6 };
+  CheckLookup (fib, "10.1.8.1", std::vector<uint32_t> (withDefault, withDefault + 3));
+  CheckLookup (fib, "192.168.0.1", std::vector<uint32_t> (1, 6));
+
+  // A non-contiguous mask is matched bit by bit, as Ipv4Mask::IsMatch does
+  fib.Add (Ipv4Address ("10.0.2.0"), Ipv4Mask ("255.0.255.0"), 7);
+  fib.Build ();
+  uint32_t holes[] = { 0, 1, 3, 4, 6, 7 };
+  CheckLookup (fib, "10.1.2.4", std::vector<uint32_t> (holes, holes + 6));
+  uint32_t otherBlock[] = { 1, 6, 7 };
+  CheckLookup (fib, "10.200.2.1", std::vector<uint32_t> (otherBlock, otherBlock + 3));
+  uint32_t notMatched[] = { 1, 6 };
+  CheckLookup (fib, "10.200.3.1", std::vector<uint32_t> (notMatched, notMatched + 2));
+  CheckLookup (fib, "11.200.2.1", std::vector<uint32_t> (1, 6));
+
+  fib.Clear ();
+  fib.Build ();
+  CheckLookup (fib, "10.1.2.3", std::vector<uint32_t> ());
+  NS_TEST_EXPECT_MSG_EQ (fib.GetNNodes (), 1, "An empty table has only the root node");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that the routing tables built by several threads are the
+ * same, route by route, as the ones built by a single thread.
+ */
+class Ipv4GlobalRoutingThreadsTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingThreadsTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Get the routes of every node.
+   * \param nodes the nodes
+   * \return the routes of each node, in routing table order
+   */
+  std::vector<std::vector<std::string> > GetRoutes (NodeContainer const &nodes);
+};
+
+Ipv4GlobalRoutingThreadsTestCase::Ipv4GlobalRoutingThreadsTestCase ()
+  : TestCase ("Global routes built by several threads")
+{
+}
+
+std::vector<std::vector<std::string> >
+Ipv4GlobalRoutingThreadsTestCase::GetRoutes (NodeContainer const &nodes)
+{
+  std::vector<std::vector<std::string> > routes (nodes.GetN ());
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<Ipv4RoutingProtocol> protocol = nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ();
+      Ptr<Ipv4GlobalRouting> routing = protocol->GetObject<Ipv4GlobalRouting> ();
+      for (uint32_t j = 0; j < routing->GetNRoutes (); ++j)
+        {
+          std::ostringstream route;
+          route << *routing->GetRoute (j);
+          routes[i].push_back (route.str ());
+        }
+    }
+  return routes;
+}
+
+void
+Ipv4GlobalRoutingThreadsTestCase::DoRun (void)
+{
+  // A ring of 16 routers with chords (so with equal-cost paths), one of
+  // them a stub, and a LAN shared by three of them
+  NodeContainer nodes;
+  nodes.Create (17);
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (Ipv4GlobalRoutingHelper ());
+  internet.Install (nodes);
+
+  SimpleNetDeviceHelper p2p;
+  p2p.SetNetDevicePointToPointMode (true);
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+  for (uint32_t i = 0; i < 16; ++i)
+    {
+      address.Assign (p2p.Install (NodeContainer (nodes.Get (i), nodes.Get ((i + 1) % 16))));
+      address.NewNetwork ();
+      if (i % 4 == 0)
+        {
+          address.Assign (p2p.Install (NodeContainer (nodes.Get (i), nodes.Get ((i + 8) % 16))));
+          address.NewNetwork ();
+        }
+    }
+  address.Assign (p2p.Install (NodeContainer (nodes.Get (5), nodes.Get (16))));
+
+  SimpleNetDeviceHelper lan;
+  NodeContainer lanNodes (nodes.Get (2), nodes.Get (7), nodes.Get (11));
+  address.SetBase ("10.1.0.0", "255.255.255.0");
+  address.Assign (lan.Install (lanNodes));
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  std::vector<std::vector<std::string> > serial = GetRoutes (nodes);
+  NS_TEST_ASSERT_MSG_EQ (serial[0].empty (), false, "No route was built");
+
+  GlobalValue::Bind ("GlobalRoutingThreads", UintegerValue (4));
+  Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+  std::vector<std::vector<std::string> > parallel = GetRoutes (nodes);
+  GlobalValue::Bind ("GlobalRoutingThreads", UintegerValue (1));
+
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (parallel[i].size (), serial[i].size (), "Wrong number of routes on node " << i);
+      for (uint32_t j = 0; j < serial[i].size (); ++j)
+        {
+          NS_TEST_EXPECT_MSG_EQ (parallel[i][j], serial[i][j], "Route " << j << " of node " << i << " differs");
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that the routes updated incrementally after links went down
+ * or up are the same, destination by destination, as the ones computed
+ * again from scratch.
+ */
+class Ipv4GlobalRoutingUpdateTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingUpdateTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /// Routes of a node: the routes to each destination, in routing table order
+  typedef std::map<std::string, std::vector<std::string> > Routes_t;
+
+  /**
+   * \brief Get the routes of every node, by destination.
+   * \param nodes the nodes
+   * \return the routes of each node
+   */
+  std::vector<Routes_t> GetRoutes (NodeContainer const &nodes);
+
+  /**
+   * \brief Take an interface down or up.
+   * \param device the device of the interface
+   * \param up whether to take the interface up
+   */
+  void SetUp (Ptr<NetDevice> device, bool up);
+};
+
+Ipv4GlobalRoutingUpdateTestCase::Ipv4GlobalRoutingUpdateTestCase ()
+  : TestCase ("Global routes updated after links go down or up")
+{
+}
+
+std::vector<Ipv4GlobalRoutingUpdateTestCase::Routes_t>
+Ipv4GlobalRoutingUpdateTestCase::GetRoutes (NodeContainer const &nodes)
+{
+  std::vector<Routes_t> routes (nodes.GetN ());
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<Ipv4RoutingProtocol> protocol = nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ();
+      Ptr<Ipv4GlobalRouting> routing = protocol->GetObject<Ipv4GlobalRouting> ();
+      for (uint32_t j = 0; j < routing->GetNRoutes (); ++j)
+        {
+          Ipv4RoutingTableEntry *entry = routing->GetRoute (j);
+          std::ostringstream dest;
+          dest << entry->GetDestNetwork () << "/" << entry->GetDestNetworkMask ().GetPrefixLength ();
+          std::ostringstream route;
+          route << *entry;
+          routes[i][dest.str ()].push_back (route.str ());
+        }
+    }
+  return routes;
+}
+
+void
+Ipv4GlobalRoutingUpdateTestCase::SetUp (Ptr<NetDevice> device, bool up)
+{
+  Ptr<Ipv4> ipv4 = device->GetNode ()->GetObject<Ipv4> ();
+  int32_t interface = ipv4->GetInterfaceForDevice (device);
+  if (up)
+    {
+      ipv4->SetUp (interface);
+    }
+  else
+    {
+      ipv4->SetDown (interface);
+    }
+}
+
+void
+Ipv4GlobalRoutingUpdateTestCase::DoRun (void)
+{
+  // The topology of Ipv4GlobalRoutingThreadsTestCase
+  NodeContainer nodes;
+  nodes.Create (17);
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (Ipv4GlobalRoutingHelper ());
+  internet.Install (nodes);
+
+  SimpleNetDeviceHelper p2p;
+  p2p.SetNetDevicePointToPointMode (true);
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+  std::vector<NetDeviceContainer> ring;
+  std::vector<NetDeviceContainer> chords;
+  for (uint32_t i = 0; i < 16; ++i)
+    {
+      ring.push_back (p2p.Install (NodeContainer (nodes.Get (i), nodes.Get ((i + 1) % 16))));
+      address.Assign (ring.back ());
+      address.NewNetwork ();
+      if (i % 4 == 0)
+        {
+          chords.push_back (p2p.Install (NodeContainer (nodes.Get (i), nodes.Get ((i + 8) % 16))));
+          address.Assign (chords.back ());
+          address.NewNetwork ();
+        }
+    }
+  NetDeviceContainer stub = p2p.Install (NodeContainer (nodes.Get (5), nodes.Get (16)));
+  address.Assign (stub);
+
+  SimpleNetDeviceHelper lan;
+  NodeContainer lanNodes (nodes.Get (2), nodes.Get (7), nodes.Get (11));
+  address.SetBase ("10.1.0.0", "255.255.255.0");
+  NetDeviceContainer lanDevices = lan.Install (lanNodes);
+  address.Assign (lanDevices);
+
+  // Interfaces taken down (false) or up (true), one event at a time
+  std::vector<std::pair<Ptr<NetDevice>, bool> > events;
+  events.push_back (std::make_pair (ring[0].Get (1), false));
+  events.push_back (std::make_pair (ring[0].Get (0), false));
+  events.push_back (std::make_pair (chords[1].Get (0), false));
+  events.push_back (std::make_pair (ring[9].Get (1), false));
+  events.push_back (std::make_pair (ring[0].Get (0), true));
+  events.push_back (std::make_pair (ring[0].Get (1), true));
+  events.push_back (std::make_pair (stub.Get (0), false));
+  events.push_back (std::make_pair (lanDevices.Get (2), false));
+  events.push_back (std::make_pair (chords[1].Get (0), true));
+  events.push_back (std::make_pair (stub.Get (0), true));
+  events.push_back (std::make_pair (lanDevices.Get (2), true));
+  events.push_back (std::make_pair (ring[9].Get (1), true));
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+  std::vector<std::vector<Routes_t> > updated;
+  for (uint32_t i = 0; i < events.size (); ++i)
+    {
+      SetUp (events[i].first, events[i].second);
+      Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+      updated.push_back (GetRoutes (nodes));
+    }
+
+  // Every interface is up again: replay the events, recomputing the routes
+  Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+  for (uint32_t i = 0; i < events.size (); ++i)
+    {
+      SetUp (events[i].first, events[i].second);
+      Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+      std::vector<Routes_t> recomputed = GetRoutes (nodes);
+      for (uint32_t n = 0; n < nodes.GetN (); ++n)
+        {
+          NS_TEST_ASSERT_MSG_EQ (updated[i][n].size (), recomputed[n].size (),
+                                 "Wrong number of destinations on node " << n << " after event " << i);
+          for (Routes_t::const_iterator r = recomputed[n].begin (); r != recomputed[n].end (); ++r)
+            {
+              Routes_t::const_iterator u = updated[i][n].find (r->first);
+              NS_TEST_ASSERT_MSG_EQ ((u != updated[i][n].end ()), true,
+                                     "No route to " << r->first << " on node " << n << " after event " << i);
+              NS_TEST_EXPECT_MSG_EQ ((u->second == r->second), true,
+                                     "Routes to " << r->first << " on node " << n << " differ after event " << i);
+            }
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that the routes updated incrementally give the same next
+ * hops as the ones computed again from scratch, when the networks of the
+ * links going down or up overlap other networks.
+ */
+class Ipv4GlobalRoutingOverlapTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingOverlapTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Get the next hop of every node to each destination.
+   * \param nodes the nodes
+   * \param destinations the destinations
+   * \return the gateway and interface, or "none", of each node to each
+   * destination
+   */
+  std::vector<std::string> GetNextHops (NodeContainer const &nodes,
+                                        std::vector<Ipv4Address> const &destinations);
+
+  /**
+   * \brief Take an interface down or up.
+   * \param device the device of the interface
+   * \param up whether to take the interface up
+   */
+  void SetUp (Ptr<NetDevice> device, bool up);
+};
+
+Ipv4GlobalRoutingOverlapTestCase::Ipv4GlobalRoutingOverlapTestCase ()
+  : TestCase ("Global routes updated after links to overlapping networks go down or up")
+{
+}
+
+std::vector<std::string>
+Ipv4GlobalRoutingOverlapTestCase::GetNextHops (NodeContainer const &nodes,
+                                               std::vector<Ipv4Address> const &destinations)
+{
+  std::vector<std::string> nextHops;
+  for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+      Ptr<Ipv4> ipv4 = nodes.Get (i)->GetObject<Ipv4> ();
+      Ptr<Ipv4GlobalRouting> routing = ipv4->GetRoutingProtocol ()->GetObject<Ipv4GlobalRouting> ();
+      for (uint32_t j = 0; j < destinations.size (); ++j)
+        {
+          Ipv4Header header;
+          header.SetDestination (destinations[j]);
+          Socket::SocketErrno err;
+          Ptr<Ipv4Route> route = routing->RouteOutput (Create<Packet> (), header, 0, err);
+          std::ostringstream oss;
+          if (route)
+            {
+              oss << route->GetGateway () << " if " << ipv4->GetInterfaceForDevice (route->GetOutputDevice ());
+            }
+          else
+            {
+              oss << "none";
+            }
+          nextHops.push_back (oss.str ());
+        }
+    }
+  return nextHops;
+}
+
+void
+Ipv4GlobalRoutingOverlapTestCase::SetUp (Ptr<NetDevice> device, bool up)
+{
+  Ptr<Ipv4> ipv4 = device->GetNode ()->GetObject<Ipv4> ();
+  int32_t interface = ipv4->GetInterfaceForDevice (device);
+  if (up)
+    {
+      ipv4->SetUp (interface);
+    }
+  else
+    {
+      ipv4->SetDown (interface);
+    }
+}
+
+void
+Ipv4GlobalRoutingOverlapTestCase::DoRun (void)
+{
+  // A ring of six routers; node 1 has a stub /24 inside the stub /16 of
+  // node 4, so that node 0 reaches the /24 through node 1 and the rest of
+  // the /16 through node 5
+  NodeContainer nodes;
+  nodes.Create (6);
+  InternetStackHelper internet;
+  internet.SetRoutingHelper (Ipv4GlobalRoutingHelper ());
+  internet.Install (nodes);
+
+  SimpleNetDeviceHelper p2p;
+  p2p.SetNetDevicePointToPointMode (true);
+  Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+  std::vector<NetDeviceContainer> ring;
+  for (uint32_t i = 0; i < 6; ++i)
+    {
+      ring.push_back (p2p.Install (NodeContainer (nodes.Get (i), nodes.Get ((i + 1) % 6))));
+      address.Assign (ring.back ());
+      address.NewNetwork ();
+    }
+
+  SimpleNetDeviceHelper lan;
+  NetDeviceContainer narrow = lan.Install (nodes.Get (1));
+  address.SetBase ("10.2.1.0", "255.255.255.0");
+  address.Assign (narrow);
+  NetDeviceContainer wide = lan.Install (nodes.Get (4));
+  address.SetBase ("10.2.0.0", "255.255.0.0", "0.0.200.1");
+  address.Assign (wide);
+
+  std::vector<Ipv4Address> destinations;
+  destinations.push_back (Ipv4Address ("10.2.1.5"));
+  destinations.push_back (Ipv4Address ("10.2.3.5"));
+
+  // Interfaces taken down (false) or up (true), one event at a time
+  std::vector<std::pair<Ptr<NetDevice>, bool> > events;
+  events.push_back (std::make_pair (narrow.Get (0), false));
+  events.push_back (std::make_pair (narrow.Get (0), true));
+  events.push_back (std::make_pair (ring[2].Get (0), false));
+  events.push_back (std::make_pair (ring[2].Get (0), true));
+  events.push_back (std::make_pair (wide.Get (0), false));
+  events.push_back (std::make_pair (wide.Get (0), true));
+
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+  Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+  std::vector<std::vector<std::string> > updated;
+  for (uint32_t i = 0; i < events.size (); ++i)
+    {
+      SetUp (events[i].first, events[i].second);
+      Ipv4GlobalRoutingHelper::UpdateRoutingTables ();
+      updated.push_back (GetNextHops (nodes, destinations));
+    }
+
+  // Every interface is up again: replay the events, recomputing the routes
+  Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+  for (uint32_t i = 0; i < events.size (); ++i)
+    {
+      SetUp (events[i].first, events[i].second);
+      Ipv4GlobalRoutingHelper::RecomputeRoutingTables ();
+      std::vector<std::string> recomputed = GetNextHops (nodes, destinations);
+      for (uint32_t j = 0; j < recomputed.size (); ++j)
+        {
+          NS_TEST_EXPECT_MSG_EQ (updated[i][j], recomputed[j],
+                                 "Next hop of node " << j / destinations.size () << " to "
+                                 << destinations[j % destinations.size ()] << " differs after event " << i);
+        }
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that hashed ECMP routing keeps the packets of a flow on one
+ * route, spreads the flows over the routes, and moves flowlets.
+ */
+class Ipv4GlobalRoutingEcmpHashTestCase : public TestCase
+{
+public:
+  Ipv4GlobalRoutingEcmpHashTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Make the header of a TCP packet.
+   * \param source the source address
+   * \param destination the destination address
+   * \return the header
+   */
+  Ipv4Header MakeHeader (Ipv4Address source, Ipv4Address destination);
+
+  /**
+   * \brief Make a TCP packet, starting with its ports.
+   * \param sourcePort the source port
+   * \param destinationPort the destination port
+   * \return the packet
+   */
+  Ptr<Packet> MakePacket (uint16_t sourcePort, uint16_t destinationPort);
+
+  /**
+   * \brief Route a TCP packet to 10.2.0.1.
+   * \param sourcePort the source port
+   * \param destinationPort the destination port
+   * \return the gateway of the route
+   */
+  Ipv4Address Route (uint16_t sourcePort, uint16_t destinationPort);
+
+  /**
+   * \brief Route a packet of a flow, and record its gateway.
+   * \param sourcePort the source port of the flow
+   */
+  void RouteFlowlet (uint16_t sourcePort);
+
+  Ptr<Ipv4GlobalRouting> m_routing;     //!< the routing protocol tested
+  std::vector<Ipv4Address> m_gateways;  //!< gateways recorded by RouteFlowlet
+};
+
+Ipv4GlobalRoutingEcmpHashTestCase::Ipv4GlobalRoutingEcmpHashTestCase ()
+  : TestCase ("Flow-hashed ECMP routing and flowlets")
+{
+}
+
+Ipv4Header
+Ipv4GlobalRoutingEcmpHashTestCase::MakeHeader (Ipv4Address source, Ipv4Address destination)
+{
+  Ipv4Header header;
+  header.SetSource (source);
+  header.SetDestination (destination);
+  header.SetProtocol (6);
+  return header;
+}
+
+Ptr<Packet>
+Ipv4GlobalRoutingEcmpHashTestCase::MakePacket (uint16_t sourcePort, uint16_t destinationPort)
+{
+  uint8_t buffer[20] = { 0 };
+  buffer[0] = sourcePort >> 8;
+  buffer[1] = sourcePort & 0xff;
+  buffer[2] = destinationPort >> 8;
+  buffer[3] = destinationPort & 0xff;
+  return Create<Packet> (buffer, sizeof (buffer));
+}
+
+Ipv4Address
+Ipv4GlobalRoutingEcmpHashTestCase::Route (uint16_t sourcePort, uint16_t destinationPort)
+{
+  Ipv4Header header = MakeHeader (Ipv4Address ("192.168.0.1"), Ipv4Address ("10.2.0.1"));
+  Socket::SocketErrno err;
+  Ptr<Ipv4Route> route = m_routing->RouteOutput (MakePacket (sourcePort, destinationPort), header, 0, err);
+  NS_ASSERT (route != 0);
+  return route->GetGateway ();
+}
+
+void
+Ipv4GlobalRoutingEcmpHashTestCase::RouteFlowlet (uint16_t sourcePort)
+{
+  m_gateways.push_back (Route (sourcePort, 80));
+}
+
+void
+Ipv4GlobalRoutingEcmpHashTestCase::DoRun (void)
+{
+  // A switch with four equal-cost uplinks to 10.2.0.1
+  Ptr<Node> node = CreateObject<Node> ();
+  InternetStackHelper stack;
+  stack.SetRoutingHelper (Ipv4StaticRoutingHelper ());
+  stack.Install (node);
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  for (uint32_t i = 0; i < 5; ++i)
+    {
+      Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice> ();
+      device->SetAddress (Mac48Address::Allocate ());
+      node->AddDevice (device);
+      uint32_t interface = ipv4->AddInterface (device);
+      ipv4->AddAddress (interface, Ipv4InterfaceAddress (Ipv4Address (0xc0a80001 + (i << 8)), Ipv4Mask ("/24")));
+      ipv4->SetUp (interface);
+    }
+  m_routing = CreateObject<Ipv4GlobalRouting> ();
+  m_routing->SetIpv4 (ipv4);
+  for (uint32_t i = 1; i < 5; ++i)
+    {
+      m_routing->AddHostRouteTo (Ipv4Address ("10.2.0.1"), Ipv4Address (0xc0a80002 + (i << 8)), i);
+    }
+  m_routing->SetAttribute ("EcmpHashRouting", BooleanValue (true));
+
+  // The packets of a flow take one route, and the flows take them all
+  std::map<Ipv4Address, uint32_t> flows;
+  for (uint16_t port = 1000; port < 1064; ++port)
+    {
+      Ipv4Address gateway = Route (port, 80);
+      for (uint32_t i = 0; i < 4; ++i)
+        {
+          NS_TEST_EXPECT_MSG_EQ (Route (port, 80), gateway, "Packets of flow " << port << " took several routes");
+        }
+      ++flows[gateway];
+    }
+  NS_TEST_EXPECT_MSG_EQ (flows.size (), 4, "The flows do not use every route");
+
+  // The ports are ignored when they are not hashed
+  m_routing->SetAttribute ("EcmpHashFields", UintegerValue (Ipv4GlobalRouting::HASH_DST_ADDRESS));
+  Ipv4Address gateway = Route (1000, 80);
+  for (uint16_t port = 1001; port < 1064; ++port)
+    {
+      NS_TEST_EXPECT_MSG_EQ (Route (port, 443), gateway, "Ports hashed although not selected");
+    }
+
+  // The seed changes the hash
+  m_routing->SetAttribute ("EcmpHashFields", UintegerValue (Ipv4GlobalRouting::HASH_5_TUPLE));
+  Ipv4Header header = MakeHeader (Ipv4Address ("192.168.0.1"), Ipv4Address ("10.2.0.1"));
+  Ptr<Packet> packet = MakePacket (1000, 80);
+  uint32_t hash = m_routing->GetFlowHash (header, packet);
+  m_routing->SetAttribute ("EcmpHashSeed", UintegerValue (1));
+  NS_TEST_EXPECT_MSG_NE (m_routing->GetFlowHash (header, packet), hash, "The seed does not change the hash");
+
+  // Fragments are hashed without their ports
+  Ipv4Header fragment = header;
+  fragment.SetMoreFragments ();
+  NS_TEST_EXPECT_MSG_EQ (m_routing->GetFlowHash (fragment, packet), m_routing->GetFlowHash (header, 0),
+                         "The ports of a fragment are hashed");
+
+  // The Toeplitz hash with the default key gives the results of the
+  // verification suite of receive side scaling
+  m_routing->SetAttribute ("EcmpHashSeed", UintegerValue (0));
+  m_routing->SetAttribute ("EcmpHashFunction", EnumValue (Ipv4GlobalRouting::HASH_TOEPLITZ));
+  m_routing->SetAttribute ("EcmpHashFields", UintegerValue (Ipv4GlobalRouting::HASH_SRC_ADDRESS
+                                                            | Ipv4GlobalRouting::HASH_DST_ADDRESS
+                                                            | Ipv4GlobalRouting::HASH_SRC_PORT
+                                                            | Ipv4GlobalRouting::HASH_DST_PORT));
+  header = MakeHeader (Ipv4Address ("66.9.149.187"), Ipv4Address ("161.142.100.80"));
+  packet = MakePacket (2794, 1766);
+  NS_TEST_EXPECT_MSG_EQ (m_routing->GetFlowHash (header, packet), 0x51ccc178, "Wrong Toeplitz hash");
+  NS_TEST_EXPECT_MSG_EQ (m_routing->GetFlowHash (header, 0), 0x323e8fc2, "Wrong Toeplitz hash");
+
+  // A flowlet keeps its route; a flow idle for longer than the timeout
+  // starts a flowlet on a random route
+  m_routing->SetAttribute ("FlowletTimeout", TimeValue (MilliSeconds (1)));
+  for (uint32_t burst = 0; burst < 20; ++burst)
+    {
+      for (uint32_t i = 0; i < 10; ++i)
+        {
+          Simulator::Schedule (MilliSeconds (10 * burst) + MicroSeconds (100 * i),
+                               &Ipv4GlobalRoutingEcmpHashTestCase::RouteFlowlet, this, 1000);
+        }
+    }
+  Simulator::Run ();
+  std::map<Ipv4Address, uint32_t> flowlets;
+  for (uint32_t burst = 0; burst < 20; ++burst)
+    {
+      for (uint32_t i = 1; i < 10; ++i)
+        {
+          NS_TEST_EXPECT_MSG_EQ (m_gateways[10 * burst + i], m_gateways[10 * burst],
+                                 "Flowlet " << burst << " took several routes");
+        }
+      ++flowlets[m_gateways[10 * burst]];
+    }
+  NS_TEST_EXPECT_MSG_GT (flowlets.size (), 1, "Flowlets never moved");
+
+  m_routing->Dispose ();
+  m_routing = 0;
+  Simulator::Destroy ();
+}
+
 /**
  * \ingroup internet-test
  * \ingroup tests
@@ -1267,6 +1971,11 @@ Ipv4GlobalRoutingTestSuite::Ipv4GlobalRoutingTestSuite ()
     AddTestCase (new TwoBridgeTest, TestCase::QUICK);
     AddTestCase (new Ipv4DynamicGlobalRoutingTestCase, TestCase::QUICK);
     AddTestCase (new Ipv4GlobalRoutingSlash32TestCase, TestCase::QUICK);
+    AddTestCase (new Ipv4FibTestCase, TestCase::QUICK);
+    AddTestCase (new Ipv4GlobalRoutingThreadsTestCase, TestCase::QUICK);
+    AddTestCase (new Ipv4GlobalRoutingUpdateTestCase, TestCase::QUICK);
+    AddTestCase (new Ipv4GlobalRoutingOverlapTestCase, TestCase::QUICK);
+    AddTestCase (new Ipv4GlobalRoutingEcmpHashTestCase, TestCase::QUICK);
   }
 
 static Ipv4GlobalRoutingTestSuite g_globalRoutingTestSuite; //!< Static variable for test initialization
@@ -18,8 +18,11 @@
  */
 
 #include "ns3/test.h"
+#include "ns3/boolean.h"
 #include "ns3/ipv4-list-routing.h"
 #include "ns3/ipv4-routing-protocol.h"
+#include "ns3/ipv4-static-routing.h"
+#include "ns3/ipv4-global-routing.h"
 
 using namespace ns3;
 
@@ -136,6 +139,57 @@ Ipv4ListRoutingPositiveTestCase::DoRun (void)
   NS_TEST_ASSERT_MSG_EQ (secondRp, bRouting, "204");
 }
 
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief IPv4 ListRouting route generation test.
+ *
+ * Checks that the route generation changes whenever the routes of any
+ * protocol change, and is 0 when a protocol cannot tell.
+ */
+class Ipv4ListRoutingGenerationTestCase : public TestCase
+{
+public:
+  Ipv4ListRoutingGenerationTestCase ();
+  virtual void DoRun (void);
+};
+
+Ipv4ListRoutingGenerationTestCase::Ipv4ListRoutingGenerationTestCase ()
+  : TestCase ("Check route generations")
+{
+}
+void
+Ipv4ListRoutingGenerationTestCase::DoRun (void)
+{
+  Ptr<Ipv4ListRouting> lr = CreateObject<Ipv4ListRouting> ();
+  Ptr<Ipv4StaticRouting> staticRouting = CreateObject<Ipv4StaticRouting> ();
+  Ptr<Ipv4GlobalRouting> globalRouting = CreateObject<Ipv4GlobalRouting> ();
+  lr->AddRoutingProtocol (staticRouting, 0);
+  lr->AddRoutingProtocol (globalRouting, -10);
+
+  uint64_t generation = lr->GetRouteGeneration ();
+  NS_TEST_ASSERT_MSG_NE (generation, 0, "Routes of static and global routing can be reused");
+  NS_TEST_ASSERT_MSG_EQ (lr->GetRouteGeneration (), generation, "Generation changed without route changes");
+
+  staticRouting->AddHostRouteTo (Ipv4Address ("10.0.0.1"), 1);
+  NS_TEST_ASSERT_MSG_NE (lr->GetRouteGeneration (), generation, "Static route added");
+  generation = lr->GetRouteGeneration ();
+  staticRouting->RemoveRoute (0);
+  NS_TEST_ASSERT_MSG_NE (lr->GetRouteGeneration (), generation, "Static route removed");
+  generation = lr->GetRouteGeneration ();
+  globalRouting->AddNetworkRouteTo (Ipv4Address ("10.1.0.0"), Ipv4Mask ("/16"), 1);
+  NS_TEST_ASSERT_MSG_NE (lr->GetRouteGeneration (), generation, "Global route added");
+
+  globalRouting->SetAttribute ("RandomEcmpRouting", BooleanValue (true));
+  NS_TEST_ASSERT_MSG_EQ (lr->GetRouteGeneration (), 0, "Random routes cannot be reused");
+  globalRouting->SetAttribute ("RandomEcmpRouting", BooleanValue (false));
+  NS_TEST_ASSERT_MSG_NE (lr->GetRouteGeneration (), 0, "Routes can be reused again");
+
+  lr->AddRoutingProtocol (CreateObject<Ipv4ARouting> (), 10);
+  NS_TEST_ASSERT_MSG_EQ (lr->GetRouteGeneration (), 0, "Routes of a protocol without generations cannot be reused");
+}
+
 /**
  * \ingroup internet-test
  * \ingroup tests
@@ -150,6 +204,7 @@ public:
   {
     AddTestCase (new Ipv4ListRoutingPositiveTestCase (), TestCase::QUICK);
     AddTestCase (new Ipv4ListRoutingNegativeTestCase (), TestCase::QUICK);
+    AddTestCase (new Ipv4ListRoutingGenerationTestCase (), TestCase::QUICK);
   }
 };
 
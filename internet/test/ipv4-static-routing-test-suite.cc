@@ -19,6 +19,7 @@
 #include "ns3/boolean.h"
 #include "ns3/config.h"
 #include "ns3/inet-socket-address.h"
+#include "ns3/ipv4-route.h"
 #include "ns3/internet-stack-helper.h"
 #include "ns3/ipv4-address-helper.h"
 #include "ns3/ipv4-static-routing-helper.h"
@@ -201,6 +202,121 @@ Ipv4StaticRoutingSlash32TestCase::DoRun (void)
   Simulator::Destroy ();
 }
 
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief IPv4 StaticRouting longest prefix match Test
+ *
+ * Checks that RouteOutput picks the longest prefix, then the smallest
+ * metric, as routes and interfaces come and go.
+ */
+class Ipv4StaticRoutingLongestPrefixTestCase : public TestCase
+{
+public:
+  Ipv4StaticRoutingLongestPrefixTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Get the gateway of the route to a destination.
+   * \param dest the destination
+   * \param oif the output device, or 0 for any
+   * \return the gateway, or 255.255.255.255 if there is no route
+   */
+  Ipv4Address Gateway (const char *dest, Ptr<NetDevice> oif = 0);
+
+  Ptr<Ipv4StaticRouting> m_routing; //!< the routing protocol under test
+};
+
+Ipv4StaticRoutingLongestPrefixTestCase::Ipv4StaticRoutingLongestPrefixTestCase ()
+  : TestCase ("Longest prefix match of static routes")
+{
+}
+
+Ipv4Address
+Ipv4StaticRoutingLongestPrefixTestCase::Gateway (const char *dest, Ptr<NetDevice> oif)
+{
+  Ipv4Header header;
+  header.SetDestination (Ipv4Address (dest));
+  Socket::SocketErrno sockerr;
+  Ptr<Ipv4Route> route = m_routing->RouteOutput (Create<Packet> (), header, oif, sockerr);
+  return route != 0 ? route->GetGateway () : Ipv4Address::GetBroadcast ();
+}
+
+void
+Ipv4StaticRoutingLongestPrefixTestCase::DoRun (void)
+{
+  Ptr<Node> node = CreateObject<Node> ();
+  InternetStackHelper internet;
+  internet.Install (node);
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4> ();
+  Ptr<SimpleNetDevice> devices[3];
+  for (uint32_t i = 1; i <= 2; ++i)
+    {
+      devices[i] = CreateObject<SimpleNetDevice> ();
+      devices[i]->SetAddress (Mac48Address::Allocate ());
+      node->AddDevice (devices[i]);
+      uint32_t interface = ipv4->AddInterface (devices[i]);
+      ipv4->AddAddress (interface, Ipv4InterfaceAddress (Ipv4Address (0x0a000001 + (i << 8)), Ipv4Mask ("/24")));
+      ipv4->SetUp (interface);
+    }
+
+  Ipv4StaticRoutingHelper ipv4RoutingHelper;
+  m_routing = ipv4RoutingHelper.GetStaticRouting (ipv4);
+  m_routing->SetDefaultRoute (Ipv4Address ("10.0.1.2"), 1);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.2.0.0"), Ipv4Mask ("/16"), Ipv4Address ("10.0.2.2"), 2);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.2.3.0"), Ipv4Mask ("/24"), Ipv4Address ("10.0.1.3"), 1, 5);
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.2.3.0"), Ipv4Mask ("/24"), Ipv4Address ("10.0.2.3"), 2, 1);
+  m_routing->AddHostRouteTo (Ipv4Address ("10.2.3.4"), Ipv4Address ("10.0.1.4"), 1);
+
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.9.9.9"), Ipv4Address ("10.0.1.2"), "Default route not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.9.9"), Ipv4Address ("10.0.2.2"), "/16 route not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.9"), Ipv4Address ("10.0.2.3"), "Smallest metric of the /24 routes not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.4"), Ipv4Address ("10.0.1.4"), "Host route not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.0.2.9"), Ipv4Address ("0.0.0.0"), "Route to the attached network not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.4", devices[2]), Ipv4Address ("10.0.2.3"), "Route on the output device not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.9.9", devices[1]), Ipv4Address ("10.0.1.2"), "Route on the output device not used");
+  NS_TEST_EXPECT_MSG_EQ (m_routing->GetDefaultRoute ().GetGateway (), Ipv4Address ("10.0.1.2"), "Wrong default route");
+
+  for (uint32_t i = 0; i < m_routing->GetNRoutes (); ++i)
+    {
+      if (m_routing->GetRoute (i).GetGateway () == Ipv4Address ("10.0.2.3"))
+        {
+          m_routing->RemoveRoute (i);
+          break;
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.9"), Ipv4Address ("10.0.1.3"), "Remaining /24 route not used");
+
+  // A non-contiguous mask is matched bit by bit, and ranked by the length
+  // up to its lowest bit, here 24
+  m_routing->AddNetworkRouteTo (Ipv4Address ("10.0.3.0"), Ipv4Mask ("255.0.255.0"), Ipv4Address ("10.0.1.5"), 1, 0);
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.9"), Ipv4Address ("10.0.1.5"), "Non-contiguous mask of smaller metric not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.7.3.9"), Ipv4Address ("10.0.1.5"), "Non-contiguous mask not matched");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.4.9"), Ipv4Address ("10.0.2.2"), "/16 route not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.4"), Ipv4Address ("10.0.1.4"), "Host route not used");
+  for (uint32_t i = 0; i < m_routing->GetNRoutes (); ++i)
+    {
+      if (m_routing->GetRoute (i).GetGateway () == Ipv4Address ("10.0.1.5"))
+        {
+          m_routing->RemoveRoute (i);
+          break;
+        }
+    }
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.9"), Ipv4Address ("10.0.1.3"), "Remaining /24 route not used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.7.3.9"), Ipv4Address ("10.0.1.2"), "Removed route still used");
+
+  // The routes through interface 2 go away with it
+  ipv4->SetDown (2);
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.9.9"), Ipv4Address ("10.0.1.2"), "Route through a down interface used");
+  NS_TEST_EXPECT_MSG_EQ (Gateway ("10.2.3.9"), Ipv4Address ("10.0.1.3"), "Remaining /24 route not used");
+
+  m_routing = 0;
+  Simulator::Destroy ();
+}
+
 /**
  * \ingroup internet-test
  * \ingroup tests
@@ -217,6 +333,7 @@ Ipv4StaticRoutingTestSuite::Ipv4StaticRoutingTestSuite ()
   : TestSuite ("ipv4-static-routing", UNIT)
 {
   AddTestCase (new Ipv4StaticRoutingSlash32TestCase, TestCase::QUICK);
+  AddTestCase (new Ipv4StaticRoutingLongestPrefixTestCase, TestCase::QUICK);
 }
 
 static Ipv4StaticRoutingTestSuite ipv4StaticRoutingTestSuite; //!< Static variable for test initialization
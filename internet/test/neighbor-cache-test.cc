@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <vector>
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/mac48-address.h"
+#include "ns3/arp-cache.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ndisc-cache.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that ArpCache finds its entries as they come and go, and
+ * retries only the entries waiting for a reply.
+ */
+class ArpCacheTestCase : public TestCase
+{
+public:
+  ArpCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Record an ARP request.
+   * \param arp the cache
+   * \param address the address to resolve
+   */
+  void ArpRequest (Ptr<const ArpCache> arp, Ipv4Address address);
+
+  std::vector<Ipv4Address> m_requests; //!< the requested addresses
+};
+
+ArpCacheTestCase::ArpCacheTestCase ()
+  : TestCase ("ArpCache lookups, removals and WaitReply retries")
+{
+}
+
+void
+ArpCacheTestCase::ArpRequest (Ptr<const ArpCache> arp, Ipv4Address address)
+{
+  m_requests.push_back (address);
+}
+
+void
+ArpCacheTestCase::DoRun (void)
+{
+  Ptr<ArpCache> arp = CreateObject<ArpCache> ();
+  arp->SetArpRequestCallback (MakeCallback (&ArpCacheTestCase::ArpRequest, this));
+
+  // Enough entries to grow the table several times, and to keep pointers
+  // to entries across the growth
+  std::vector<ArpCache::Entry *> entries;
+  for (uint32_t i = 0; i < 1000; ++i)
+    {
+      entries.push_back (arp->Add (Ipv4Address (0x0a000000 + i)));
+    }
+  for (uint32_t i = 0; i < 1000; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (arp->Lookup (Ipv4Address (0x0a000000 + i)), entries[i], "Entry " << i << " not found");
+      NS_TEST_ASSERT_MSG_EQ (entries[i]->GetIpv4Address (), Ipv4Address (0x0a000000 + i), "Entry " << i << " moved");
+    }
+  for (uint32_t i = 0; i < 1000; i += 2)
+    {
+      arp->Remove (entries[i]);
+    }
+  for (uint32_t i = 0; i < 1000; ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ (arp->Lookup (Ipv4Address (0x0a000000 + i)), (i % 2 ? entries[i] : 0),
+                             "Wrong lookup of entry " << i << " after removals");
+    }
+  Mac48Address mac ("00:00:00:00:00:01");
+  entries[1]->SetMacAddress (mac);
+  entries[3]->SetMacAddress (mac);
+  NS_TEST_EXPECT_MSG_EQ (arp->LookupInverse (mac).size (), 2, "Wrong inverse lookup");
+  arp->Flush ();
+  NS_TEST_EXPECT_MSG_EQ (arp->Lookup (Ipv4Address (0x0a000001)), 0, "Entry found after a flush");
+
+  // Three entries wait for a reply: one gets it and one is removed, so
+  // only the last one is retried
+  ArpCache::Entry *answered = arp->Add (Ipv4Address ("10.0.0.1"));
+  ArpCache::Entry *removed = arp->Add (Ipv4Address ("10.0.0.2"));
+  ArpCache::Entry *retried = arp->Add (Ipv4Address ("10.0.0.3"));
+  Ipv4Header header;
+  answered->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (Create<Packet> (), header));
+  removed->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (Create<Packet> (), header));
+  retried->MarkWaitReply (ArpCache::Ipv4PayloadHeaderPair (Create<Packet> (), header));
+  NS_TEST_EXPECT_MSG_EQ (retried->UpdateWaitReply (ArpCache::Ipv4PayloadHeaderPair (Create<Packet> (), header)),
+                         true, "Pending packet not queued");
+  answered->MarkAlive (mac);
+  arp->Remove (removed);
+  Simulator::Stop (arp->GetWaitReplyTimeout () + MilliSeconds (1));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (m_requests.size (), 1, "Wrong number of retries");
+  NS_TEST_EXPECT_MSG_EQ (m_requests[0], Ipv4Address ("10.0.0.3"), "Wrong entry retried");
+  NS_TEST_EXPECT_MSG_EQ (retried->DequeuePending ().first != 0, true, "Pending packet lost");
+  NS_TEST_EXPECT_MSG_EQ (retried->DequeuePending ().first != 0, true, "Pending packet lost");
+  NS_TEST_EXPECT_MSG_EQ (retried->DequeuePending ().first == 0, true, "Too many pending packets");
+
+  arp->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check that NdiscCache finds its entries as they come and go.
+ */
+class NdiscCacheTestCase : public TestCase
+{
+public:
+  NdiscCacheTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+NdiscCacheTestCase::NdiscCacheTestCase ()
+  : TestCase ("NdiscCache lookups and removals")
+{
+}
+
+void
+NdiscCacheTestCase::DoRun (void)
+{
+  Ptr<NdiscCache> ndisc = CreateObject<NdiscCache> ();
+
+  std::vector<NdiscCache::Entry *> entries;
+  uint8_t bytes[16] = { 0x20, 0x01 };
+  for (uint32_t i = 0; i < 1000; ++i)
+    {
+      bytes[14] = i >> 8;
+      bytes[15] = i & 0xff;
+      entries.push_back (ndisc->Add (Ipv6Address (bytes)));
+    }
+  for (uint32_t i = 0; i < 1000; i += 2)
+    {
+      ndisc->Remove (entries[i]);
+    }
+  for (uint32_t i = 0; i < 1000; ++i)
+    {
+      bytes[14] = i >> 8;
+      bytes[15] = i & 0xff;
+      NS_TEST_ASSERT_MSG_EQ (ndisc->Lookup (Ipv6Address (bytes)), (i % 2 ? entries[i] : 0),
+                             "Wrong lookup of entry " << i << " after removals");
+    }
+
+  // The waiting packets are kept in order, the oldest being dropped first
+  Ipv6Header header;
+  std::vector<Ptr<Packet> > packets;
+  for (uint32_t i = 0; i < ndisc->GetUnresQlen () + 1; ++i)
+    {
+      packets.push_back (Create<Packet> (i + 1));
+      entries[1]->AddWaitingPacket (NdiscCache::Ipv6PayloadHeaderPair (packets.back (), header));
+    }
+  std::list<NdiscCache::Ipv6PayloadHeaderPair> waiting = entries[1]->MarkReachable (Mac48Address ("00:00:00:00:00:01"));
+  NS_TEST_ASSERT_MSG_EQ (waiting.size (), ndisc->GetUnresQlen (), "Wrong number of waiting packets");
+  NS_TEST_EXPECT_MSG_EQ (waiting.front ().first, packets[1], "Oldest waiting packet not dropped");
+  NS_TEST_EXPECT_MSG_EQ (waiting.back ().first, packets.back (), "Newest waiting packet lost");
+
+  ndisc->Dispose ();
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Neighbor caches TestSuite
+ */
+class NeighborCacheTestSuite : public TestSuite
+{
+public:
+  NeighborCacheTestSuite ()
+    : TestSuite ("neighbor-cache", UNIT)
+  {
+    AddTestCase (new ArpCacheTestCase, TestCase::QUICK);
+    AddTestCase (new NdiscCacheTestCase, TestCase::QUICK);
+  }
+};
+
+static NeighborCacheTestSuite g_neighborCacheTestSuite; //!< Static variable for test initialization
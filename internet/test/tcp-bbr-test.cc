@@ -0,0 +1,243 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/tcp-congestion-ops.h"
+#include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-bbr.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpBbrTestSuite");
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the windowed filter of the BBR bandwidth
+ */
+class TcpBbrWindowedFilterTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   */
+  TcpBbrWindowedFilterTest ();
+
+private:
+  virtual void DoRun (void);
+};
+
+TcpBbrWindowedFilterTest::TcpBbrWindowedFilterTest ()
+  : TestCase ("Windowed maximum over round trips")
+{
+}
+
+void
+TcpBbrWindowedFilterTest::DoRun ()
+{
+  TcpBbr::MaxBandwidthFilter_t filter (10, 0, 0);
+
+  filter.Update (100, 0);
+  filter.Update (50, 1);
+  filter.Update (80, 4);
+  NS_TEST_ASSERT_MSG_EQ (filter.GetBest (), 100, "Not the maximum of the window");
+
+  filter.Update (120, 5);
+  NS_TEST_ASSERT_MSG_EQ (filter.GetBest (), 120, "A new maximum is not the best");
+  NS_TEST_ASSERT_MSG_EQ (filter.GetBestTime (), 5, "Wrong time of the best");
+
+  // The maximum leaves the window: a later sample takes its place
+  filter.Update (60, 8);
+  filter.Update (70, 12);
+  NS_TEST_ASSERT_MSG_EQ (filter.GetBest (), 120, "Maximum left the window too early");
+  filter.Update (40, 16);
+  NS_TEST_ASSERT_MSG_LT (filter.GetBest (), 120, "Maximum did not leave the window");
+  NS_TEST_ASSERT_MSG_GT (filter.GetBest (), 40, "Later samples of the window forgotten");
+
+  // Nothing left in the window
+  filter.Update (10, 40);
+  NS_TEST_ASSERT_MSG_EQ (filter.GetBest (), 10, "Filter not reset");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the states of TcpBbr, with delivery rate samples
+ *
+ * The path has a constant bandwidth and RTT. BBR stays in STARTUP while
+ * the bandwidth grows, leaves it for DRAIN once it stopped growing for
+ * three round trips, and goes to PROBE_BW once the queue is drained. If
+ * the minimum RTT is not seen again for 10 seconds, it enters PROBE_RTT
+ * with at most 4 segments in flight.
+ */
+class TcpBbrStateTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param bw Bandwidth of the path.
+   * \param rtt RTT of the path.
+   * \param name Test description.
+   */
+  TcpBbrStateTest (DataRate bw, Time rtt, const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Give BBR the sample of a round trip.
+   * \param bw the delivery rate
+   * \param rtt the RTT
+   * \param inFlight the bytes in flight
+   */
+  void RoundTrip (DataRate bw, Time rtt, uint32_t inFlight);
+
+  /**
+   * \brief Execute the test.
+   */
+  void ExecuteTest (void);
+
+  /**
+   * \brief Check the state of BBR after the minimum RTT expired.
+   */
+  void CheckProbeRtt (void);
+
+  DataRate m_bw;                //!< Bandwidth of the path.
+  Time m_rtt;                   //!< RTT of the path.
+  uint32_t m_segmentSize;       //!< Segment size.
+  Ptr<TcpSocketState> m_state;  //!< TCP socket state.
+  Ptr<TcpBbr> m_cong;           //!< BBR.
+  TcpRateOps::TcpRateConnection m_rc; //!< Delivery state of the connection.
+};
+
+TcpBbrStateTest::TcpBbrStateTest (DataRate bw, Time rtt, const std::string &name)
+  : TestCase (name),
+    m_bw (bw),
+    m_rtt (rtt),
+    m_segmentSize (1000)
+{
+}
+
+void
+TcpBbrStateTest::DoRun ()
+{
+  m_state = CreateObject<TcpSocketState> ();
+  m_state->m_segmentSize = m_segmentSize;
+  m_state->m_initialCWnd = 10;
+  m_state->m_cWnd = 10 * m_segmentSize;
+  m_state->m_ssThresh = UINT32_MAX;
+  m_cong = CreateObject<TcpBbr> ();
+  m_cong->SetStream (1);
+
+  Simulator::Schedule (Seconds (0.0), &TcpBbrStateTest::ExecuteTest, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+TcpBbrStateTest::RoundTrip (DataRate bw, Time rtt, uint32_t inFlight)
+{
+  // One ACK per round trip, delivering the data of the round trip: the
+  // segment of the sample was sent when the last round trip ended
+  TcpRateOps::TcpRateSample rs;
+  rs.m_priorDelivered = m_rc.m_delivered;
+  rs.m_delivered = bw.GetBitRate () * rtt.GetSeconds () / 8;
+  rs.m_interval = rtt;
+  rs.m_deliveryRate = bw;
+  rs.m_ackedSacked = rs.m_delivered;
+  rs.m_priorInFlight = inFlight;
+  rs.m_bytesInFlight = inFlight;
+  m_rc.m_delivered += rs.m_delivered;
+  m_rc.m_deliveredTime = Simulator::Now ();
+
+  m_state->m_lastRttSample = rtt;
+  m_cong->CongControl (m_state, m_rc, rs);
+}
+
+void
+TcpBbrStateTest::ExecuteTest ()
+{
+  double highGain = m_cong->m_highGain;
+
+  // The bandwidth grows by more than 25% a round trip
+  RoundTrip (DataRate (m_bw.GetBitRate () / 4), m_rtt, 0);
+  RoundTrip (DataRate (m_bw.GetBitRate () / 2), m_rtt, 0);
+  RoundTrip (m_bw, m_rtt, 0);
+  NS_TEST_ASSERT_MSG_EQ (m_cong->GetBbrState (), TcpBbr::BBR_STARTUP, "Not in STARTUP");
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_state->m_pacingRate.GetBitRate (),
+                             highGain * m_bw.GetBitRate () * 0.99, 1000,
+                             "STARTUP does not pace at the high gain");
+
+  // It stops growing: the pipe is full after three round trips; the
+  // queue made is still in flight
+  uint32_t bdp = m_bw.GetBitRate () * m_rtt.GetSeconds () / 8;
+  RoundTrip (m_bw, m_rtt, 3 * bdp);
+  RoundTrip (m_bw, m_rtt, 3 * bdp);
+  NS_TEST_ASSERT_MSG_EQ (m_cong->GetBbrState (), TcpBbr::BBR_STARTUP, "Left STARTUP too early");
+  RoundTrip (m_bw, m_rtt, 3 * bdp);
+  NS_TEST_ASSERT_MSG_EQ (m_cong->GetBbrState (), TcpBbr::BBR_DRAIN, "Not in DRAIN");
+  NS_TEST_ASSERT_MSG_LT (m_state->m_pacingRate.GetBitRate (), m_bw.GetBitRate (),
+                         "DRAIN does not pace below the bandwidth");
+
+  // The queue is drained
+  RoundTrip (m_bw, m_rtt, bdp);
+  NS_TEST_ASSERT_MSG_EQ (m_cong->GetBbrState (), TcpBbr::BBR_PROBE_BW, "Not in PROBE_BW");
+  NS_TEST_ASSERT_MSG_GT_OR_EQ (m_state->m_cWnd.Get (), 2 * bdp, "cWnd below twice the BDP");
+
+  // The RTT grows, as a queue would make it: the minimum is not seen again
+  for (uint32_t i = 1; i <= 12; ++i)
+    {
+      Simulator::Schedule (Seconds (i), &TcpBbrStateTest::RoundTrip, this,
+                           m_bw, m_rtt + m_rtt, bdp);
+    }
+  Simulator::Schedule (Seconds (12.5), &TcpBbrStateTest::CheckProbeRtt, this);
+}
+
+void
+TcpBbrStateTest::CheckProbeRtt ()
+{
+  NS_TEST_ASSERT_MSG_EQ (m_cong->GetBbrState (), TcpBbr::BBR_PROBE_RTT, "Not in PROBE_RTT");
+  NS_TEST_ASSERT_MSG_EQ (m_state->m_cWnd.Get (), 4 * m_segmentSize,
+                         "cWnd not at its minimum in PROBE_RTT");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief TCP BBR TestSuite
+ */
+class TcpBbrTestSuite : public TestSuite
+{
+public:
+  TcpBbrTestSuite () : TestSuite ("tcp-bbr-test", UNIT)
+  {
+    AddTestCase (new TcpBbrWindowedFilterTest (), TestCase::QUICK);
+    AddTestCase (new TcpBbrStateTest (DataRate ("10Mbps"), MilliSeconds (100),
+                                      "BBR states at 10Mbps, 100ms"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpBbrStateTest (DataRate ("1Gbps"), MilliSeconds (1),
+                                      "BBR states at 1Gbps, 1ms"),
+                 TestCase::QUICK);
+  }
+};
+
+static TcpBbrTestSuite g_tcpBbrTest; //!< Static variable for test initialization
@@ -0,0 +1,485 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/tcp-congestion-ops.h"
+#include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-cubic.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpCubicTestSuite");
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the integer cube root of TcpCubic
+ */
+class TcpCubicCubicRootTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   */
+  TcpCubicCubicRootTest ();
+
+private:
+  virtual void DoRun (void);
+};
+
+TcpCubicCubicRootTest::TcpCubicCubicRootTest ()
+  : TestCase ("Cubic root from the table and a Newton-Raphson iteration")
+{
+}
+
+void
+TcpCubicCubicRootTest::DoRun ()
+{
+  // Exact on the small cubes of the table
+  NS_TEST_ASSERT_MSG_EQ (TcpCubic::CubicRoot (0), 0, "Wrong cube root of 0");
+  NS_TEST_ASSERT_MSG_EQ (TcpCubic::CubicRoot (1), 1, "Wrong cube root of 1");
+  NS_TEST_ASSERT_MSG_EQ (TcpCubic::CubicRoot (8), 2, "Wrong cube root of 8");
+  NS_TEST_ASSERT_MSG_EQ (TcpCubic::CubicRoot (27), 3, "Wrong cube root of 27");
+
+  // Within 0.2% over the range of K
+  for (uint64_t root = 100; root < 2000000; root = root * 3 / 2 + 7)
+    {
+      for (uint64_t a = root * root * root; a < (root + 1) * (root + 1) * (root + 1); a += root * root)
+        {
+          double x = TcpCubic::CubicRoot (a);
+          NS_TEST_ASSERT_MSG_EQ_TOL (x, static_cast<double> (root), root * 0.002 + 1,
+                                     "Cube root of " << a << " too far from " << root);
+        }
+    }
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the congestion avoidance increment on TcpCubic
+ */
+class TcpCubicIncrementTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param cWnd Congestion window.
+   * \param segmentSize Segment size.
+   * \param ssThresh Slow Start Threshold.
+   * \param segmentsAcked Number of segments acked.
+   * \param lastMaxCwnd Last max Cwnd, in segments.
+   * \param name Test description.
+   */
+  TcpCubicIncrementTest (uint32_t cWnd,
+                         uint32_t segmentSize,
+                         uint32_t ssThresh,
+                         uint32_t segmentsAcked,
+                         uint32_t lastMaxCwnd,
+                         const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Execute the test.
+   */
+  void ExecuteTest (void);
+
+  /**
+   * \brief Check the ACKs per increase, at a time of the epoch.
+   * \param cnt the expected ACKs per increase
+   */
+  void CheckCnt (uint32_t cnt);
+
+  uint32_t m_cWnd;          //!< Congestion window.
+  uint32_t m_segmentSize;   //!< Segment size.
+  uint32_t m_ssThresh;      //!< Slow Start Threshold.
+  uint32_t m_segmentsAcked; //!< Number of segments acked.
+  uint32_t m_lastMaxCwnd;   //!< Last max Cwnd.
+  Ptr<TcpSocketState> m_state;  //!< TCP socket state.
+  Ptr<TcpCubic> m_cong;         //!< Cubic.
+};
+
+TcpCubicIncrementTest::TcpCubicIncrementTest (uint32_t cWnd,
+                                              uint32_t segmentSize,
+                                              uint32_t ssThresh,
+                                              uint32_t segmentsAcked,
+                                              uint32_t lastMaxCwnd,
+                                              const std::string &name)
+  : TestCase (name),
+    m_cWnd (cWnd),
+    m_segmentSize (segmentSize),
+    m_ssThresh (ssThresh),
+    m_segmentsAcked (segmentsAcked),
+    m_lastMaxCwnd (lastMaxCwnd)
+{
+}
+
+void
+TcpCubicIncrementTest::DoRun ()
+{
+  m_state = CreateObject<TcpSocketState> ();
+
+  m_state->m_cWnd = m_cWnd;
+  m_state->m_segmentSize = m_segmentSize;
+  m_state->m_ssThresh = m_ssThresh;
+
+  m_cong = CreateObject <TcpCubic> ();
+  m_cong->SetAttribute ("HyStart", BooleanValue (false));
+  m_cong->m_lastMaxCwnd = m_lastMaxCwnd;
+
+  Simulator::Schedule (Seconds (0.0), &TcpCubicIncrementTest::ExecuteTest, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+TcpCubicIncrementTest::ExecuteTest ()
+{
+  uint32_t segCwnd = m_cWnd / m_segmentSize;
+  uint32_t segSsThresh = m_ssThresh / m_segmentSize;
+
+  m_cong->IncreaseWindow (m_state, m_segmentsAcked);
+
+  // Slow start up to ssThresh, the rest in congestion avoidance
+  uint32_t slowStart = 0;
+  if (m_cWnd < m_ssThresh)
+    {
+      slowStart = std::min (m_segmentsAcked, segSsThresh - segCwnd);
+    }
+  uint32_t congAvoid = m_segmentsAcked - slowStart;
+
+  if (congAvoid == 0)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_state->m_cWnd.Get (), (segCwnd + slowStart) * m_segmentSize,
+                             "Cubic has not increased cWnd in slow start");
+      return;
+    }
+
+  uint32_t cnt = m_cong->m_cnt;
+  NS_TEST_ASSERT_MSG_GT_OR_EQ (cnt, 2, "Cubic grows by more than 1.5x per RTT");
+  if (m_lastMaxCwnd == 0)
+    {
+      NS_TEST_ASSERT_MSG_LT (cnt, 21, "Cubic has not clamped the ACKs per increase");
+    }
+  NS_TEST_ASSERT_MSG_EQ (m_state->m_cWnd.Get (),
+                         (segCwnd + slowStart + congAvoid / cnt) * m_segmentSize,
+                         "Cubic has not increased cWnd by one segment every cnt ACKs");
+
+  if (m_lastMaxCwnd == 100 && segCwnd == 80)
+    {
+      // W_max is 20 segments away: K = cbrt (20 / 0.4) = 3.68 seconds; the
+      // window is on the plateau around K, and probes beyond it after
+      Simulator::Schedule (Seconds (3.68), &TcpCubicIncrementTest::CheckCnt, this, 4);
+      Simulator::Schedule (Seconds (6), &TcpCubicIncrementTest::CheckCnt, this, 3);
+    }
+}
+
+void
+TcpCubicIncrementTest::CheckCnt (uint32_t cnt)
+{
+  m_state->m_cWnd = m_cWnd;
+  m_cong->Update (m_state, 1);
+  NS_TEST_ASSERT_MSG_EQ (m_cong->m_cnt, cnt, "Cubic has not followed the cubic function");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the congestion avoidance decrement on TcpCubic
+ */
+class TcpCubicDecrementTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param cWnd Congestion window.
+   * \param segmentSize Segment size.
+   * \param fastConvergence Fast convergence.
+   * \param lastMaxCwnd Last max Cwnd.
+   * \param name Test description.
+   */
+  TcpCubicDecrementTest (uint32_t cWnd,
+                         uint32_t segmentSize,
+                         BooleanValue fastConvergence,
+                         uint32_t lastMaxCwnd,
+                         const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Execute the test.
+   */
+  void ExecuteTest (void);
+
+  uint32_t m_cWnd;        //!< Congestion window.
+  uint32_t m_segmentSize; //!< Segment size.
+  BooleanValue m_fastConvergence;   //!< Fast convergence.
+  uint32_t m_lastMaxCwnd;   //!< Last max Cwnd.
+  Ptr<TcpSocketState> m_state;  //!< TCP socket state.
+};
+
+TcpCubicDecrementTest::TcpCubicDecrementTest (uint32_t cWnd,
+                                              uint32_t segmentSize,
+                                              BooleanValue fastConvergence,
+                                              uint32_t lastMaxCwnd,
+                                              const std::string &name)
+  : TestCase (name),
+    m_cWnd (cWnd),
+    m_segmentSize (segmentSize),
+    m_fastConvergence (fastConvergence),
+    m_lastMaxCwnd (lastMaxCwnd)
+{
+}
+
+void
+TcpCubicDecrementTest::DoRun ()
+{
+  m_state = CreateObject<TcpSocketState> ();
+
+  m_state->m_cWnd = m_cWnd;
+  m_state->m_segmentSize = m_segmentSize;
+
+  Simulator::Schedule (Seconds (0.0), &TcpCubicDecrementTest::ExecuteTest, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+TcpCubicDecrementTest::ExecuteTest ()
+{
+  Ptr<TcpCubic> cong = CreateObject <TcpCubic> ();
+  cong->m_lastMaxCwnd = m_lastMaxCwnd;
+  cong->m_epochStart = Seconds (0);
+  cong->SetAttribute ("FastConvergence", m_fastConvergence);
+
+  uint32_t segCwnd = m_cWnd / m_segmentSize;
+  uint32_t retSsThresh = cong->GetSsThresh (m_state, m_state->m_cWnd);
+
+  DoubleValue beta;
+  cong->GetAttribute ("Beta", beta);
+  uint32_t scaledBeta = beta.Get () * 1024;
+
+  if (segCwnd < m_lastMaxCwnd && m_fastConvergence.Get ())
+    {
+      NS_TEST_ASSERT_MSG_EQ (cong->m_lastMaxCwnd, segCwnd * (1024 + scaledBeta) / 2048,
+                             "Cubic has not updated lastMaxCwnd during fast convergence");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ (cong->m_lastMaxCwnd, segCwnd,
+                             "Cubic has not reset lastMaxCwnd to current cwnd (in segments)");
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (retSsThresh, std::max (segCwnd * scaledBeta / 1024, 2U) * m_segmentSize,
+                         "Cubic has not reduced ssThresh by beta");
+  NS_TEST_ASSERT_MSG_EQ (cong->m_epochStart, Time::Min (), "Cubic has not ended the epoch");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the exit of slow start of HyStart
+ *
+ * A round of ACKs is fed to TcpCubic, after a first RTT sample which sets
+ * the minimum delay.  ssThresh must be set to cWnd if the delay of the
+ * round increases by more than the threshold, or if the ACKs of the round
+ * come as a train lasting half of the minimum delay.
+ */
+class TcpCubicHyStartTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param detect Detection mode of HyStart.
+   * \param cWnd Congestion window, in segments.
+   * \param minRtt The first RTT sample.
+   * \param rtt The RTT samples of the round.
+   * \param spacing The spacing of the ACKs of the round.
+   * \param exit Whether slow start must be left.
+   * \param name Test description.
+   */
+  TcpCubicHyStartTest (TcpCubic::HybridSSDetectionMode detect, uint32_t cWnd,
+                       Time minRtt, Time rtt, Time spacing, bool exit,
+                       const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief Feed an ACK to TcpCubic
+   * \param rtt the RTT sample of the ACK
+   */
+  void Ack (Time rtt);
+
+  /**
+   * \brief Check ssThresh after the round
+   */
+  void Check (void);
+
+  TcpCubic::HybridSSDetectionMode m_detect;  //!< Detection mode.
+  uint32_t m_cWnd;              //!< Congestion window, in segments.
+  Time m_minRtt;                //!< The first RTT sample.
+  Time m_rtt;                   //!< The RTT samples of the round.
+  Time m_spacing;               //!< The spacing of the ACKs.
+  bool m_exit;                  //!< Whether slow start must be left.
+  Ptr<TcpSocketState> m_state;  //!< TCP socket state.
+  Ptr<TcpCubic> m_cong;         //!< Cubic.
+};
+
+TcpCubicHyStartTest::TcpCubicHyStartTest (TcpCubic::HybridSSDetectionMode detect,
+                                          uint32_t cWnd, Time minRtt, Time rtt,
+                                          Time spacing, bool exit,
+                                          const std::string &name)
+  : TestCase (name),
+    m_detect (detect),
+    m_cWnd (cWnd),
+    m_minRtt (minRtt),
+    m_rtt (rtt),
+    m_spacing (spacing),
+    m_exit (exit)
+{
+}
+
+void
+TcpCubicHyStartTest::DoRun ()
+{
+  m_state = CreateObject<TcpSocketState> ();
+  m_state->m_segmentSize = 1000;
+  m_state->m_cWnd = m_cWnd * 1000;
+  m_state->m_ssThresh = UINT32_MAX;
+  m_state->m_highTxMark = SequenceNumber32 (1 + 2 * m_cWnd * 1000);
+
+  m_cong = CreateObject <TcpCubic> ();
+  m_cong->SetAttribute ("HyStartDetect", EnumValue (m_detect));
+
+  // The first sample sets the minimum delay; the ACK after starts the round
+  m_cong->PktsAcked (m_state, 1, m_minRtt);
+  m_state->m_lastAckedSeq = SequenceNumber32 (1);
+  m_cong->IncreaseWindow (m_state, 0);
+
+  for (uint32_t i = 1; i <= m_cWnd; ++i)
+    {
+      Simulator::Schedule (m_spacing * i, &TcpCubicHyStartTest::Ack, this, m_rtt);
+    }
+  Simulator::Schedule (m_spacing * (m_cWnd + 1), &TcpCubicHyStartTest::Check, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+TcpCubicHyStartTest::Ack (Time rtt)
+{
+  // The window does not grow, to look at the first round only
+  m_cong->PktsAcked (m_state, 1, rtt);
+}
+
+void
+TcpCubicHyStartTest::Check ()
+{
+  if (m_exit)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_state->m_ssThresh.Get (), m_cWnd * 1000,
+                             "HyStart has not left slow start");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_state->m_ssThresh.Get (), UINT32_MAX,
+                             "HyStart has left slow start");
+    }
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief TCP Cubic TestSuite
+ */
+class TcpCubicTestSuite : public TestSuite
+{
+public:
+  TcpCubicTestSuite () : TestSuite ("tcp-cubic-test", UNIT)
+  {
+    AddTestCase (new TcpCubicCubicRootTest (), TestCase::QUICK);
+
+    AddTestCase (new TcpCubicIncrementTest (10 * 1000, 1000, 20 * 1000, 5, 0,
+                                            "Cubic increment test: slow start"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicIncrementTest (18 * 1000, 1000, 20 * 1000, 5, 0,
+                                            "Cubic increment test: slow start up to ssThresh"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicIncrementTest (100 * 1446, 1446, 20 * 1446, 25, 0,
+                                            "Cubic increment test: unknown last maximum"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicIncrementTest (80 * 1000, 1000, 20 * 1000, 1, 100,
+                                            "Cubic increment test: concave region"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicIncrementTest (10 * 536, 536, 9 * 536, 40, 9,
+                                            "Cubic increment test: TCP friendly region"),
+                 TestCase::QUICK);
+
+    AddTestCase (new TcpCubicDecrementTest (80 * 1446, 1446, true, 100,
+                                            "Cubic decrement test: fast convergence"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicDecrementTest (80 * 1446, 1446, false, 100,
+                                            "Cubic decrement test: not in fast convergence"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicDecrementTest (120 * 1446, 1446, true, 100,
+                                            "Cubic decrement test: fast convergence & cwnd over last max"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicDecrementTest (2 * 1446, 1446, true, 0,
+                                            "Cubic decrement test: ssThresh of 2 segments at least"),
+                 TestCase::QUICK);
+
+    AddTestCase (new TcpCubicHyStartTest (TcpCubic::DELAY, 20, MilliSeconds (100),
+                                          MilliSeconds (120), MilliSeconds (3), true,
+                                          "HyStart test: delay increase"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicHyStartTest (TcpCubic::DELAY, 20, MilliSeconds (100),
+                                          MilliSeconds (110), MilliSeconds (3), false,
+                                          "HyStart test: delay increase under the threshold"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicHyStartTest (TcpCubic::DELAY, 15, MilliSeconds (100),
+                                          MilliSeconds (120), MilliSeconds (3), false,
+                                          "HyStart test: delay increase under the low window"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicHyStartTest (TcpCubic::PACKET_TRAIN, 20, MilliSeconds (10),
+                                          MilliSeconds (10), MilliSeconds (1), true,
+                                          "HyStart test: ACK train"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicHyStartTest (TcpCubic::PACKET_TRAIN, 20, MilliSeconds (10),
+                                          MilliSeconds (10), MilliSeconds (3), false,
+                                          "HyStart test: ACKs spaced too much for a train"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpCubicHyStartTest (TcpCubic::PACKET_TRAIN, 20, MilliSeconds (100),
+                                          MilliSeconds (100), MilliSeconds (1), false,
+                                          "HyStart test: ACK train shorter than half the RTT"),
+                 TestCase::QUICK);
+  }
+};
+
+static TcpCubicTestSuite g_tcpCubicTest; //!< Static variable for test initialization
@@ -0,0 +1,229 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/test.h"
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/tcp-congestion-ops.h"
+#include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-dctcp.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpDctcpTestSuite");
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the estimate of the fraction of marked bytes of TcpDctcp
+ *
+ * Windows of ten segments are ACKed one segment at a time, with ECE on
+ * the ACKs of some of them; alpha follows the EWMA of the fraction of the
+ * bytes ACKed with ECE, updated once per window.
+ */
+class TcpDctcpAlphaTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param alphaOnInit Initial value of alpha.
+   * \param g Weight of the fraction of a window.
+   * \param name Test description.
+   */
+  TcpDctcpAlphaTest (double alphaOnInit, double g, const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * \brief ACK a window of ten segments, and send the next one.
+   * \param marked Number of segments, the first ones, ACKed with ECE.
+   */
+  void AckWindow (uint32_t marked);
+
+  double m_alphaOnInit;         //!< Initial value of alpha.
+  double m_g;                   //!< Weight of the fraction of a window.
+  uint32_t m_segmentSize;       //!< Segment size.
+  Ptr<TcpSocketState> m_state;  //!< TCP socket state.
+  Ptr<TcpDctcp> m_cong;         //!< DCTCP.
+};
+
+TcpDctcpAlphaTest::TcpDctcpAlphaTest (double alphaOnInit, double g, const std::string &name)
+  : TestCase (name),
+    m_alphaOnInit (alphaOnInit),
+    m_g (g),
+    m_segmentSize (1000)
+{
+}
+
+void
+TcpDctcpAlphaTest::AckWindow (uint32_t marked)
+{
+  for (uint32_t i = 0; i < 10; ++i)
+    {
+      if (i == 9)
+        { // The next window is sent before the end of this one is ACKed
+          m_state->m_highTxMark = m_state->m_highTxMark.Get () + 10 * m_segmentSize;
+        }
+      m_state->m_lastAckedSeq += m_segmentSize;
+      m_cong->InAckEvent (m_state, i < marked);
+    }
+}
+
+void
+TcpDctcpAlphaTest::DoRun ()
+{
+  m_state = CreateObject<TcpSocketState> ();
+  m_state->m_segmentSize = m_segmentSize;
+  m_state->m_cWnd = 10 * m_segmentSize;
+  m_state->m_lastAckedSeq = SequenceNumber32 (1);
+  m_state->m_highTxMark = SequenceNumber32 (1 + 10 * m_segmentSize);
+
+  m_cong = CreateObject<TcpDctcp> ();
+  m_cong->SetAttribute ("DctcpAlphaOnInit", DoubleValue (m_alphaOnInit));
+  m_cong->SetAttribute ("DctcpShiftG", DoubleValue (m_g));
+
+  NS_TEST_ASSERT_MSG_EQ (m_cong->NeedsEcn (), true, "DCTCP must ask for ECN");
+
+  // The first ACK starts the first observation window
+  m_cong->InAckEvent (m_state, false);
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_cong->m_alpha, m_alphaOnInit, 1e-9, "Wrong initial alpha");
+
+  double alpha = m_alphaOnInit;
+
+  AckWindow (5);
+  alpha = (1 - m_g) * alpha + m_g * 0.5;
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_cong->m_alpha, alpha, 1e-9, "Half of the window marked");
+
+  AckWindow (10);
+  alpha = (1 - m_g) * alpha + m_g;
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_cong->m_alpha, alpha, 1e-9, "The whole window marked");
+
+  for (uint32_t i = 0; i < 5; ++i)
+    {
+      AckWindow (0);
+      alpha = (1 - m_g) * alpha;
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_cong->m_alpha, alpha, 1e-9, "Alpha does not decay without marks");
+
+  // Alpha is updated only once the window is ACKed
+  m_state->m_lastAckedSeq += 5 * m_segmentSize;
+  m_cong->InAckEvent (m_state, true);
+  NS_TEST_ASSERT_MSG_EQ_TOL (m_cong->m_alpha, alpha, 1e-9, "Alpha updated in the window");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Testing the window reduction of TcpDctcp
+ *
+ * An ECN echo (CA_CWR) reduces cWnd by alpha / 2, to at least two
+ * segments; a loss halves the bytes in flight, as NewReno does.
+ */
+class TcpDctcpSsThreshTest : public TestCase
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param cWnd Congestion window.
+   * \param alpha Estimate of the fraction of marked bytes.
+   * \param congState Congestion state.
+   * \param bytesInFlight Bytes in flight.
+   * \param expectedSsThresh Expected slow start threshold.
+   * \param name Test description.
+   */
+  TcpDctcpSsThreshTest (uint32_t cWnd, double alpha, TcpSocketState::TcpCongState_t congState,
+                        uint32_t bytesInFlight, uint32_t expectedSsThresh,
+                        const std::string &name);
+
+private:
+  virtual void DoRun (void);
+
+  uint32_t m_cWnd;              //!< Congestion window.
+  double m_alpha;               //!< Estimate of the fraction of marked bytes.
+  TcpSocketState::TcpCongState_t m_congState; //!< Congestion state.
+  uint32_t m_bytesInFlight;     //!< Bytes in flight.
+  uint32_t m_expectedSsThresh;  //!< Expected slow start threshold.
+};
+
+TcpDctcpSsThreshTest::TcpDctcpSsThreshTest (uint32_t cWnd, double alpha,
+                                            TcpSocketState::TcpCongState_t congState,
+                                            uint32_t bytesInFlight, uint32_t expectedSsThresh,
+                                            const std::string &name)
+  : TestCase (name),
+    m_cWnd (cWnd),
+    m_alpha (alpha),
+    m_congState (congState),
+    m_bytesInFlight (bytesInFlight),
+    m_expectedSsThresh (expectedSsThresh)
+{
+}
+
+void
+TcpDctcpSsThreshTest::DoRun ()
+{
+  Ptr<TcpSocketState> state = CreateObject<TcpSocketState> ();
+  state->m_segmentSize = 1000;
+  state->m_cWnd = m_cWnd;
+  state->m_congState = m_congState;
+
+  Ptr<TcpDctcp> cong = CreateObject<TcpDctcp> ();
+  cong->InAckEvent (state, false);
+  cong->m_alpha = m_alpha;
+
+  NS_TEST_ASSERT_MSG_EQ (cong->GetSsThresh (state, m_bytesInFlight), m_expectedSsThresh,
+                         "Wrong slow start threshold");
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief TCP DCTCP TestSuite
+ */
+class TcpDctcpTestSuite : public TestSuite
+{
+public:
+  TcpDctcpTestSuite () : TestSuite ("tcp-dctcp-test", UNIT)
+  {
+    AddTestCase (new TcpDctcpAlphaTest (1.0, 0.0625, "Alpha EWMA, from 1, g = 1/16"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpAlphaTest (0.0, 0.0625, "Alpha EWMA, from 0, g = 1/16"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpAlphaTest (0.5, 0.25, "Alpha EWMA, from 0.5, g = 1/4"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpSsThreshTest (20000, 0.0, TcpSocketState::CA_CWR, 20000, 20000,
+                                           "ECN echo without congestion"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpSsThreshTest (20000, 0.5, TcpSocketState::CA_CWR, 20000, 15000,
+                                           "ECN echo, half of the bytes marked"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpSsThreshTest (20000, 1.0, TcpSocketState::CA_CWR, 20000, 10000,
+                                           "ECN echo, all the bytes marked"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpSsThreshTest (3000, 1.0, TcpSocketState::CA_CWR, 3000, 2000,
+                                           "ECN echo, at least two segments"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpDctcpSsThreshTest (20000, 0.0, TcpSocketState::CA_RECOVERY, 16000, 8000,
+                                           "Loss, as NewReno"),
+                 TestCase::QUICK);
+  }
+};
+
+static TcpDctcpTestSuite g_tcpDctcpTest; //!< Static variable for test initialization
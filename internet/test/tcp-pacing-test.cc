@@ -0,0 +1,148 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "tcp-general-test.h"
+#include "ns3/node.h"
+#include "ns3/log.h"
+#include "ns3/boolean.h"
+#include "ns3/data-rate.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TcpPacingTestSuite");
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief Check the spacing of the segments of a paced sender
+ *
+ * With a fixed pacing rate, two data segments are sent at least the
+ * transmission time of the first one, at the pacing rate, apart.  Without
+ * a fixed rate, the rate is derived from cWnd and the RTT once the first
+ * RTT sample is taken.
+ */
+class TcpPacingTest : public TcpGeneralTest
+{
+public:
+  /**
+   * \brief Constructor.
+   * \param rate the fixed pacing rate, or 0 to derive it
+   * \param desc Test description.
+   */
+  TcpPacingTest (DataRate rate, const std::string &desc);
+
+protected:
+  virtual Ptr<TcpSocketMsgBase> CreateSenderSocket (Ptr<Node> node);
+  virtual void Tx (const Ptr<const Packet> p, const TcpHeader&h, SocketWho who);
+  virtual void ConfigureEnvironment ();
+  virtual void FinalChecks ();
+
+private:
+  DataRate m_rate;         //!< Fixed pacing rate, 0 to derive it
+  Time m_lastTx;           //!< Time of the last data segment sent
+  uint32_t m_lastSize;     //!< Size of the last data segment sent
+  DataRate m_lastRate;     //!< Pacing rate when the last data segment was sent
+  uint32_t m_dataSent;     //!< Number of data segments sent
+  uint32_t m_pacedSent;    //!< Number of data segments sent with a pacing rate
+};
+
+TcpPacingTest::TcpPacingTest (DataRate rate, const std::string &desc)
+  : TcpGeneralTest (desc),
+    m_rate (rate),
+    m_lastTx (0),
+    m_lastSize (0),
+    m_lastRate (0),
+    m_dataSent (0),
+    m_pacedSent (0)
+{
+}
+
+void
+TcpPacingTest::ConfigureEnvironment ()
+{
+  TcpGeneralTest::ConfigureEnvironment ();
+  SetAppPktCount (40);
+  SetMTU (500);
+}
+
+Ptr<TcpSocketMsgBase>
+TcpPacingTest::CreateSenderSocket (Ptr<Node> node)
+{
+  Ptr<TcpSocketMsgBase> s = TcpGeneralTest::CreateSenderSocket (node);
+  s->SetAttribute ("Pacing", BooleanValue (true));
+  s->SetAttribute ("PacingRate", DataRateValue (m_rate));
+  return s;
+}
+
+void
+TcpPacingTest::Tx (const Ptr<const Packet> p, const TcpHeader &h, SocketWho who)
+{
+  if (who != SENDER || p->GetSize () == 0)
+    {
+      return;
+    }
+
+  if (m_lastRate.GetBitRate () > 0)
+    {
+      NS_TEST_ASSERT_MSG_GT_OR_EQ (Simulator::Now (),
+                                   m_lastTx + m_lastRate.CalculateBytesTxTime (m_lastSize),
+                                   "Segment sent before the pacing time");
+      ++m_pacedSent;
+    }
+
+  m_lastTx = Simulator::Now ();
+  m_lastSize = p->GetSize ();
+  m_lastRate = GetTcb (SENDER)->m_pacingRate;
+  ++m_dataSent;
+
+  if (m_rate.GetBitRate () > 0)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_lastRate, m_rate, "Pacing rate is not the fixed one");
+    }
+}
+
+void
+TcpPacingTest::FinalChecks ()
+{
+  NS_TEST_ASSERT_MSG_GT (m_dataSent, 0, "No data sent");
+  NS_TEST_ASSERT_MSG_GT (m_pacedSent, 0, "No segment paced");
+  if (m_rate.GetBitRate () > 0)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_pacedSent + 1, m_dataSent, "Not all segments paced");
+    }
+}
+
+/**
+ * \ingroup internet-test
+ * \ingroup tests
+ *
+ * \brief TCP pacing TestSuite
+ */
+class TcpPacingTestSuite : public TestSuite
+{
+public:
+  TcpPacingTestSuite () : TestSuite ("tcp-pacing-test", UNIT)
+  {
+    AddTestCase (new TcpPacingTest (DataRate ("1Mbps"), "Pacing at a fixed rate"),
+                 TestCase::QUICK);
+    AddTestCase (new TcpPacingTest (DataRate (0), "Pacing at a rate derived from cWnd and RTT"),
+                 TestCase::QUICK);
+  }
+};
+
+static TcpPacingTestSuite g_tcpPacingTestSuite; //!< Static variable for test initialization
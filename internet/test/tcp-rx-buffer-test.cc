@@ -44,6 +44,11 @@ private:
    * \brief Test the SACK list update.
    */
   void TestUpdateSACKList ();
+
+  /**
+   * \brief Test the reassembly of sprayed segments, and ExtractChain.
+   */
+  void TestExtractChain ();
 };
 
 TcpRxBufferTestCase::TcpRxBufferTestCase ()
@@ -55,6 +60,7 @@ void
 TcpRxBufferTestCase::DoRun ()
 {
   TestUpdateSACKList ();
+  TestExtractChain ();
 }
 
 void
@@ -338,6 +344,68 @@ TcpRxBufferTestCase::TestUpdateSACKList ()
                          "SACK list should contain no element");
 }
 
+void
+TcpRxBufferTestCase::TestExtractChain ()
+{
+  TcpRxBuffer rxBuf;
+  TcpOptionSack::SackList sackList;
+  TcpRxBuffer::PacketChain chain;
+  TcpHeader h;
+
+  // Segments of 100 bytes sprayed over two paths: 1, 201, 401 and 601 first
+  rxBuf.SetNextRxSequence (SequenceNumber32 (1));
+  for (uint32_t i = 0; i < 4; ++i)
+    {
+      h.SetSequenceNumber (SequenceNumber32 (1 + 200 * i));
+      rxBuf.Add (Create<Packet> (100), h);
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.NextRxSequence (), SequenceNumber32 (101),
+                         "Sequence number differs from expected");
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.GetSackListSize (), 3,
+                         "SACK list should contain three elements");
+
+  // Filling a hole between two blocks reports both in the first SACK block
+  h.SetSequenceNumber (SequenceNumber32 (301));
+  rxBuf.Add (Create<Packet> (100), h);
+
+  sackList = rxBuf.GetSackList ();
+  NS_TEST_ASSERT_MSG_EQ (sackList.size (), 2,
+                         "SACK list should contain two elements");
+  NS_TEST_ASSERT_MSG_EQ (sackList.begin ()->first, SequenceNumber32 (201),
+                         "SACK block different than expected");
+  NS_TEST_ASSERT_MSG_EQ (sackList.begin ()->second, SequenceNumber32 (501),
+                         "SACK block different than expected");
+
+  // Then the other path, in order
+  h.SetSequenceNumber (SequenceNumber32 (101));
+  rxBuf.Add (Create<Packet> (100), h);
+  h.SetSequenceNumber (SequenceNumber32 (501));
+  rxBuf.Add (Create<Packet> (100), h);
+
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.NextRxSequence (), SequenceNumber32 (701),
+                         "Sequence number differs from expected");
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.Available (), 700,
+                         "Available bytes differ from expected");
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.GetSackListSize (), 0,
+                         "SACK list should contain no element");
+
+  // The segments are extracted as they are, but for the last one
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.ExtractChain (250, chain), 250,
+                         "Extracted bytes differ from expected");
+  NS_TEST_ASSERT_MSG_EQ (chain.size (), 3, "Chain length differs from expected");
+  NS_TEST_ASSERT_MSG_EQ (chain[0]->GetSize (), 100, "Packet size differs from expected");
+  NS_TEST_ASSERT_MSG_EQ (chain[2]->GetSize (), 50, "Packet size differs from expected");
+
+  chain.clear ();
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.ExtractChain (1000, chain), 450,
+                         "Extracted bytes differ from expected");
+  NS_TEST_ASSERT_MSG_EQ (chain.size (), 5, "Chain length differs from expected");
+  NS_TEST_ASSERT_MSG_EQ (chain[0]->GetSize (), 50, "Packet size differs from expected");
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.Size (), 0, "Buffer should be empty");
+  NS_TEST_ASSERT_MSG_EQ (rxBuf.Available (), 0, "Nothing should be left to extract");
+}
+
 void
 TcpRxBufferTestCase::DoTeardown ()
 {
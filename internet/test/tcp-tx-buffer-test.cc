@@ -15,6 +15,7 @@
  *
  */
 
+#include <vector>
 #include "ns3/test.h"
 #include "ns3/tcp-tx-buffer.h"
 #include "ns3/packet.h"
@@ -49,6 +50,15 @@ private:
   void TestNextSeg ();
   /** \brief Test the scoreboard with emulated SACK */
   void TestUpdateScoreboardWithCraftedSACK ();
+  /** \brief Test the pipe and retransmission counts of the scoreboard */
+  void TestBytesInFlight ();
+  /**
+   * \brief Check that a packet holds the bytes of a block
+   * \param p the packet
+   * \param seq the first sequence of the block
+   * \param size the size of the block
+   */
+  void CheckBlock (Ptr<Packet> p, SequenceNumber32 seq, uint32_t size);
 };
 
 TcpTxBufferTestCase::TcpTxBufferTestCase ()
@@ -82,6 +92,8 @@ TcpTxBufferTestCase::DoRun ()
                        &TcpTxBufferTestCase::TestNextSeg, this);
   Simulator::Schedule (Seconds (0.0),
                        &TcpTxBufferTestCase::TestUpdateScoreboardWithCraftedSACK, this);
+  Simulator::Schedule (Seconds (0.0),
+                       &TcpTxBufferTestCase::TestBytesInFlight, this);
 
   Simulator::Run ();
   Simulator::Destroy ();
@@ -390,9 +402,115 @@ TcpTxBufferTestCase::TestUpdateScoreboardWithCraftedSACK ()
                          "Data inside the buffer");
 }
 
+void
+TcpTxBufferTestCase::TestBytesInFlight ()
+{
+  TcpTxBuffer txBuf;
+  SequenceNumber32 head (1);
+  uint32_t dupThresh = 3;
+  uint32_t segmentSize = 150;
+  Ptr<TcpOptionSack> sack = CreateObject<TcpOptionSack> ();
+  txBuf.SetHeadSequence (head);
+  txBuf.Add (Create<Packet> (30000));
+
+  // Send 10 segments
+  for (uint32_t i=0; i<10; ++i)
+    {
+      txBuf.CopyFromSequence (segmentSize, head + (segmentSize * i));
+    }
+  NS_TEST_ASSERT_MSG_EQ (txBuf.BytesInFlight (dupThresh, segmentSize), 1500,
+                         "All the sent segments should be in flight");
+
+  // SACK the 3rd, 4th and 5th segments: they leave the pipe, and the 1st
+  // and 2nd ones are lost
+  sack->AddSackBlock (TcpOptionSack::SackBlock (head + (segmentSize * 2),
+                                                head + (segmentSize * 5)));
+  txBuf.Update (sack->GetSackList ());
+  NS_TEST_ASSERT_MSG_EQ (txBuf.IsLost (head, dupThresh, segmentSize), true,
+                         "The first segment should be lost");
+  NS_TEST_ASSERT_MSG_EQ (txBuf.IsLost (head + segmentSize, dupThresh, segmentSize), true,
+                         "The second segment should be lost");
+  NS_TEST_ASSERT_MSG_EQ (txBuf.BytesInFlight (dupThresh, segmentSize), 750,
+                         "SACKed and lost segments should not be in flight");
+
+  // The retransmission of the first one is in flight again
+  txBuf.CopyFromSequence (segmentSize, head);
+  NS_TEST_ASSERT_MSG_EQ (txBuf.GetRetransmitsCount (), 1,
+                         "The retransmission should be counted");
+  NS_TEST_ASSERT_MSG_EQ (txBuf.BytesInFlight (dupThresh, segmentSize), 900,
+                         "The retransmission should be in flight");
+
+  // Its ACK removes it; the second one is still lost
+  txBuf.DiscardUpTo (head + segmentSize);
+  NS_TEST_ASSERT_MSG_EQ (txBuf.GetRetransmitsCount (), 0,
+                         "The acknowledged retransmission should not be counted");
+  NS_TEST_ASSERT_MSG_EQ (txBuf.BytesInFlight (dupThresh, segmentSize), 750,
+                         "Only the segments after the SACKed ones should be in flight");
+
+  // A cumulative ACK of everything empties the pipe
+  txBuf.DiscardUpTo (head + (segmentSize * 10));
+  NS_TEST_ASSERT_MSG_EQ (txBuf.BytesInFlight (dupThresh, segmentSize), 0,
+                         "Nothing should be in flight");
+}
+
+void
+TcpTxBufferTestCase::CheckBlock (Ptr<Packet> p, SequenceNumber32 seq, uint32_t size)
+{
+  NS_TEST_ASSERT_MSG_EQ (p->GetSize (), size, "Block of " << seq << " has a wrong size");
+  std::vector<uint8_t> data (size);
+  p->CopyData (&data[0], size);
+  for (uint32_t i = 0; i < size; ++i)
+    {
+      // The byte of sequence n is (n - 1) % 251, see TestTransmittedBlock
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) data[i], (seq.GetValue () - 1 + i) % 251,
+                             "Block of " << seq << " has a wrong byte " << i);
+    }
+}
+
 void
 TcpTxBufferTestCase::TestTransmittedBlock ()
 {
+  TcpTxBuffer txBuf;
+  txBuf.SetHeadSequence (SequenceNumber32 (1));
+
+  // Two application writes of 300 bytes, numbered so that the content of
+  // every block can be checked
+  uint8_t data[600];
+  for (uint32_t i = 0; i < 600; ++i)
+    {
+      data[i] = i % 251;
+    }
+  txBuf.Add (Create<Packet> (data, 300));
+  txBuf.Add (Create<Packet> (data + 300, 300));
+
+  // Three segments; the second spans the two writes
+  CheckBlock (txBuf.CopyFromSequence (250, SequenceNumber32 (1)), SequenceNumber32 (1), 250);
+  CheckBlock (txBuf.CopyFromSequence (250, SequenceNumber32 (251)), SequenceNumber32 (251), 250);
+  CheckBlock (txBuf.CopyFromSequence (50, SequenceNumber32 (501)), SequenceNumber32 (501), 50);
+  NS_TEST_ASSERT_MSG_EQ (txBuf.GetRetransmitsCount (), 0, "Nothing was retransmitted");
+
+  // Exactly the same as previous
+  CheckBlock (txBuf.CopyFromSequence (250, SequenceNumber32 (251)), SequenceNumber32 (251), 250);
+  NS_TEST_ASSERT_MSG_EQ (txBuf.GetRetransmitsCount (), 1, "One segment was retransmitted");
+
+  // Starts inside a packet, ends in another
+  CheckBlock (txBuf.CopyFromSequence (300, SequenceNumber32 (101)), SequenceNumber32 (101), 300);
+
+  // Starts inside a packet, ends earlier in the same packet
+  CheckBlock (txBuf.CopyFromSequence (30, SequenceNumber32 (420)), SequenceNumber32 (420), 30);
+
+  // Starts over the boundary, but ends after: the new data is sent too
+  CheckBlock (txBuf.CopyFromSequence (150, SequenceNumber32 (451)), SequenceNumber32 (451), 150);
+  NS_TEST_ASSERT_MSG_EQ (txBuf.SizeFromSequence (SequenceNumber32 (601)), 0,
+                         "All the data should be sent");
+
+  // The buffer still holds every byte, in order
+  CheckBlock (txBuf.CopyFromSequence (600, SequenceNumber32 (1)), SequenceNumber32 (1), 600);
+
+  txBuf.DiscardUpTo (SequenceNumber32 (351));
+  CheckBlock (txBuf.CopyFromSequence (250, SequenceNumber32 (351)), SequenceNumber32 (351), 250);
+  txBuf.DiscardUpTo (SequenceNumber32 (601));
+  NS_TEST_ASSERT_MSG_EQ (txBuf.Size (), 0, "Data inside the buffer");
 }
 
 void
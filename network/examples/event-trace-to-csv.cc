@@ -0,0 +1,191 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Converts a binary event trace written by EventTraceSink into either
+//
+// - a CSV file with one line per record (--format=csv, the default), or
+// - one raw array per field (--format=columns), named <output>.<field>.bin,
+//   plus <output>.schema listing the byte order, the fields, their types
+//   and the number of rows.  Traces are written in host byte order, and
+//   converted on a host of the same byte order, so the columns keep it.
+//   The columns can be loaded directly with numpy.fromfile or converted
+//   to Parquet with any dataframe library.
+//
+// Records are sorted by time (stably, so the order within a ring is kept)
+// unless --sort=false is given.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+using namespace ns3;
+
+static const char *g_eventNames[] = { "ENQ", "DEQ", "SENT", "ACK", "TIMEOUT" };
+static const char *g_cocoaStateNames[] = { "START", "SLOW_START", "AI", "MD", "FR", "IDLE" };
+static const char *g_tcpStateNames[] = { "CA_OPEN", "CA_DISORDER", "CA_CWR", "CA_RECOVERY", "CA_LOSS" };
+
+/**
+ * \param table array of names
+ * \param n number of names in the array
+ * \param value index to look up
+ * \return the name, or "?" if value is out of range
+ */
+static const char *
+Name (const char **table, uint32_t n, uint32_t value)
+{
+  return value < n ? table[value] : "?";
+}
+
+/**
+ * \param a a record
+ * \param b another record
+ * \return true if a happened before b
+ */
+static bool
+EarlierThan (EventTraceRecord const &a, EventTraceRecord const &b)
+{
+  return a.time < b.time;
+}
+
+/**
+ * \brief Write one field of every record to its own file.
+ * \param records the records
+ * \param filename file to create
+ * \param field pointer to the field in a record
+ * \return false if the file could not be written
+ */
+template <typename T>
+static bool
+WriteColumn (std::vector<EventTraceRecord> const &records, std::string const &filename,
+             T EventTraceRecord::*field)
+{
+  std::vector<T> column;
+  column.reserve (records.size ());
+  for (std::vector<EventTraceRecord>::const_iterator i = records.begin (); i != records.end (); ++i)
+    {
+      column.push_back ((*i).*field);
+    }
+  std::ofstream out (filename.c_str (), std::ios::out | std::ios::binary);
+  out.write ((char const *) column.data (), column.size () * sizeof (T));
+  return !out.fail ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string input;
+  std::string output;
+  std::string format = "csv";
+  bool sort = true;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Binary event trace to read", input);
+  cmd.AddValue ("output", "CSV file to write, or prefix of the column files", output);
+  cmd.AddValue ("format", "Output format: csv or columns", format);
+  cmd.AddValue ("sort", "Sort the records by time", sort);
+  cmd.Parse (argc, argv);
+
+  if (input.empty () || output.empty () || (format != "csv" && format != "columns"))
+    {
+      std::cerr << "usage: event-trace-to-csv --input=<trace> --output=<file> [--format=csv|columns] [--sort=0|1]" << std::endl;
+      return 1;
+    }
+
+  std::ifstream in (input.c_str (), std::ios::in | std::ios::binary);
+  EventTraceFileHeader header;
+  in.read ((char *) &header, sizeof (header));
+  if (in.fail () || header.magic != EventTraceFileHeader::MAGIC)
+    {
+      std::cerr << input << ": not an event trace, or written on a host of another byte order" << std::endl;
+      return 1;
+    }
+  if (header.version != EventTraceFileHeader::VERSION || header.recordSize != sizeof (EventTraceRecord))
+    {
+      std::cerr << input << ": unsupported version " << header.version
+                << " (record size " << header.recordSize << ")" << std::endl;
+      return 1;
+    }
+
+  std::vector<EventTraceRecord> records;
+  EventTraceRecord r;
+  while (in.read ((char *) &r, sizeof (r)))
+    {
+      records.push_back (r);
+    }
+  if (sort)
+    {
+      std::stable_sort (records.begin (), records.end (), EarlierThan);
+    }
+
+  if (format == "csv")
+    {
+      std::ofstream out (output.c_str ());
+      out << "time_ns,source,flow_id,event,origin,cc_state,window,seq,ack\n";
+      for (std::vector<EventTraceRecord>::const_iterator i = records.begin (); i != records.end (); ++i)
+        {
+          bool tcp = i->origin == EventTraceRecord::TCP;
+          out << i->time << ',' << i->source << ',' << i->flowId << ','
+              << Name (g_eventNames, 5, i->event) << ','
+              << (tcp ? "TCP" : "COCOA") << ','
+              << (tcp ? Name (g_tcpStateNames, 5, i->ccState) : Name (g_cocoaStateNames, 6, i->ccState)) << ','
+              << i->window << ',' << i->seq << ',' << i->ack << '\n';
+        }
+      if (out.fail ())
+        {
+          std::cerr << output << ": write failed" << std::endl;
+          return 1;
+        }
+    }
+  else
+    {
+      bool ok = WriteColumn (records, output + ".time_ns.bin", &EventTraceRecord::time)
+        && WriteColumn (records, output + ".source.bin", &EventTraceRecord::source)
+        && WriteColumn (records, output + ".flow_id.bin", &EventTraceRecord::flowId)
+        && WriteColumn (records, output + ".event.bin", &EventTraceRecord::event)
+        && WriteColumn (records, output + ".origin.bin", &EventTraceRecord::origin)
+        && WriteColumn (records, output + ".cc_state.bin", &EventTraceRecord::ccState)
+        && WriteColumn (records, output + ".window.bin", &EventTraceRecord::window)
+        && WriteColumn (records, output + ".seq.bin", &EventTraceRecord::seq)
+        && WriteColumn (records, output + ".ack.bin", &EventTraceRecord::ack);
+
+      uint16_t one = 1;
+      bool littleEndian = *reinterpret_cast<uint8_t *> (&one) == 1;
+      std::ofstream schema ((output + ".schema").c_str ());
+      schema << "byte_order " << (littleEndian ? "little" : "big") << "\n"
+             << "rows " << records.size () << "\n"
+             << "time_ns int64\n"
+             << "source uint32\n"
+             << "flow_id uint32\n"
+             << "event uint8 ENQ DEQ SENT ACK TIMEOUT\n"
+             << "origin uint8 COCOA TCP\n"
+             << "cc_state uint8\n"
+             << "window uint32\n"
+             << "seq uint32\n"
+             << "ack uint32\n";
+      if (!ok || schema.fail ())
+        {
+          std::cerr << output << ": write failed" << std::endl;
+          return 1;
+        }
+    }
+
+  std::cout << records.size () << " records" << std::endl;
+  return 0;
+}
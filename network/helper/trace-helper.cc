@@ -28,6 +28,11 @@
 #include "ns3/names.h"
 #include "ns3/net-device.h"
 #include "ns3/pcap-file-wrapper.h"
+#include "ns3/buffered-file-writer.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/global-value.h"
 
 #include "trace-helper.h"
 
@@ -35,6 +40,37 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("TraceHelper");
 
+/**
+ * \ingroup network
+ * Compression of ascii trace files made by AsciiTraceHelper::CreateFileStream.
+ */
+static GlobalValue g_asciiTraceCompression = GlobalValue ("AsciiTraceCompression",
+                                                          "Compression applied to ascii trace files",
+                                                          EnumValue (BufferedFileWriter::NONE),
+                                                          MakeEnumChecker (BufferedFileWriter::NONE, "None",
+                                                                           BufferedFileWriter::GZIP, "Gzip",
+                                                                           BufferedFileWriter::ZSTD, "Zstd"));
+
+/**
+ * \ingroup network
+ * Size limit of ascii trace files made by AsciiTraceHelper::CreateFileStream.
+ */
+static GlobalValue g_asciiTraceRotateSize = GlobalValue ("AsciiTraceRotateSize",
+                                                         "Start a new ascii trace file once the current one "
+                                                         "holds this many bytes (before compression), 0 to disable",
+                                                         UintegerValue (0),
+                                                         MakeUintegerChecker<uint64_t> ());
+
+/**
+ * \ingroup network
+ * Time span of ascii trace files made by AsciiTraceHelper::CreateFileStream.
+ */
+static GlobalValue g_asciiTraceRotateInterval = GlobalValue ("AsciiTraceRotateInterval",
+                                                             "Start a new ascii trace file once the current one "
+                                                             "spans this much simulation time, 0 to disable",
+                                                             TimeValue (Seconds (0)),
+                                                             MakeTimeChecker ());
+
 PcapHelper::PcapHelper ()
 {
   NS_LOG_FUNCTION_NOARGS ();
@@ -51,11 +87,32 @@ PcapHelper::CreateFile (
   std::ios::openmode filemode,
   DataLinkType dataLinkType,
   uint32_t    snapLen, 
-  int32_t     tzCorrection)
+  int32_t     tzCorrection,
+  WriterBackend backend)
 {
-  NS_LOG_FUNCTION (filename << filemode << dataLinkType << snapLen << tzCorrection);
+  NS_LOG_FUNCTION (filename << filemode << dataLinkType << snapLen << tzCorrection << backend);
 
   Ptr<PcapFileWrapper> file = CreateObject<PcapFileWrapper> ();
+  switch (backend)
+    {
+    case WRITER_FSTREAM:
+      file->SetAttribute ("WriteBufferSize", UintegerValue (0));
+      break;
+    case WRITER_BUFFERED:
+    case WRITER_ASYNC:
+      {
+        UintegerValue size;
+        file->GetAttribute ("WriteBufferSize", size);
+        if (size.Get () == 0)
+          {
+            file->SetAttribute ("WriteBufferSize", UintegerValue (BufferedFileWriter::BUFFER_SIZE_DEFAULT));
+          }
+        file->SetAttribute ("AsyncFlush", BooleanValue (backend == WRITER_ASYNC));
+        break;
+      }
+    default:
+      break;
+    }
   file->Open (filename, filemode);
   NS_ABORT_MSG_IF (file->Fail (), "Unable to Open " << filename << " for mode " << filemode);
 
@@ -76,6 +133,35 @@ PcapHelper::CreateFile (
   return file;
 }
 
+Ptr<PcapFileWrapper>
+PcapHelper::CreateFile (
+  std::string filename,
+  std::ios::openmode filemode,
+  DataLinkType dataLinkType,
+  BufferedFileWriter::Compression compression,
+  uint64_t    rotateSize,
+  Time        rotateInterval,
+  uint32_t    snapLen,
+  int32_t     tzCorrection)
+{
+  NS_LOG_FUNCTION (filename << filemode << dataLinkType << compression << rotateSize << rotateInterval);
+  NS_ABORT_MSG_UNLESS (BufferedFileWriter::IsCompressionSupported (compression),
+                       "Compression method " << compression << " is not supported by this build");
+
+  Ptr<PcapFileWrapper> file = CreateObject<PcapFileWrapper> ();
+  file->SetAttribute ("AsyncFlush", BooleanValue (true));
+  file->SetAttribute ("Compression", EnumValue (compression));
+  file->SetAttribute ("RotateSize", UintegerValue (rotateSize));
+  file->SetAttribute ("RotateInterval", TimeValue (rotateInterval));
+  file->Open (filename, filemode);
+  NS_ABORT_MSG_IF (file->Fail (), "Unable to Open " << filename << " for mode " << filemode);
+
+  file->Init (dataLinkType, snapLen, tzCorrection);
+  NS_ABORT_MSG_IF (file->Fail (), "Unable to Init " << filename);
+
+  return file;
+}
+
 std::string
 PcapHelper::GetFilenameFromDevice (std::string prefix, Ptr<NetDevice> device, bool useObjectNames)
 {
@@ -192,6 +278,20 @@ AsciiTraceHelper::CreateFileStream (std::string filename, std::ios::openmode fil
 {
   NS_LOG_FUNCTION (filename << filemode);
 
+  EnumValue compression;
+  g_asciiTraceCompression.GetValue (compression);
+  UintegerValue rotateSize;
+  g_asciiTraceRotateSize.GetValue (rotateSize);
+  TimeValue rotateInterval;
+  g_asciiTraceRotateInterval.GetValue (rotateInterval);
+  if (compression.Get () != BufferedFileWriter::NONE
+      || rotateSize.Get () > 0 || !rotateInterval.Get ().IsZero ())
+    {
+      return CreateFileStream (filename, filemode,
+                               static_cast<BufferedFileWriter::Compression> (compression.Get ()),
+                               rotateSize.Get (), rotateInterval.Get ());
+    }
+
   Ptr<OutputStreamWrapper> StreamWrapper = Create<OutputStreamWrapper> (filename, filemode);
 
   //
@@ -208,6 +308,32 @@ AsciiTraceHelper::CreateFileStream (std::string filename, std::ios::openmode fil
   return StreamWrapper;
 }
 
+Ptr<OutputStreamWrapper>
+AsciiTraceHelper::CreateFileStream (std::string filename,
+                                    std::ios::openmode filemode,
+                                    BufferedFileWriter::Compression compression,
+                                    uint64_t rotateSize,
+                                    Time rotateInterval)
+{
+  NS_LOG_FUNCTION (filename << filemode << compression << rotateSize << rotateInterval);
+  NS_ABORT_MSG_UNLESS (BufferedFileWriter::IsCompressionSupported (compression),
+                       "Compression method " << compression << " is not supported by this build");
+
+  BufferedFileWriter *writer = new BufferedFileWriter (filename, filemode,
+                                                       BufferedFileWriter::BUFFER_SIZE_DEFAULT,
+                                                       true, compression);
+  NS_ABORT_MSG_IF (writer->Fail (), "AsciiTraceHelper::CreateFileStream():  " <<
+                   "Unable to Open " << filename << " for mode " << filemode);
+  writer->SetRotation (rotateSize, rotateInterval.GetNanoSeconds ());
+
+  //
+  // Same lifetime rules as the plain file stream above: the wrapper owns the
+  // writer and closes it (flushing the background thread) when the last
+  // reference goes away.
+  //
+  return Create<OutputStreamWrapper> (writer);
+}
+
 std::string
 AsciiTraceHelper::GetFilenameFromDevice (std::string prefix, Ptr<NetDevice> device, bool useObjectNames)
 {
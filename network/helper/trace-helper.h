@@ -25,6 +25,8 @@
 #include "ns3/simulator.h"
 #include "ns3/pcap-file-wrapper.h"
 #include "ns3/output-stream-wrapper.h"
+#include "ns3/buffered-file-writer.h"
+#include "ns3/nstime.h"
 
 namespace ns3 {
 
@@ -60,6 +62,16 @@ public:
     DLT_NETLINK = 253
   };
 
+  /**
+   * This enumeration selects how records are written to a pcap file.
+   */
+  enum WriterBackend {
+    WRITER_DEFAULT,    /**< Use the PcapFileWrapper attribute values */
+    WRITER_FSTREAM,    /**< Write every record through std::fstream */
+    WRITER_BUFFERED,   /**< Batch records into large buffers */
+    WRITER_ASYNC       /**< Batch records and write full buffers on a background thread */
+  };
+
   /**
    * @brief Create a pcap helper.
    */
@@ -102,12 +114,47 @@ public:
    * @param dataLinkType data link type of packet data
    * @param snapLen maximum length of packet data stored in records
    * @param tzCorrection time zone correction to be applied to timestamps of packets
+   * @param backend how records are written to the file.  With WRITER_DEFAULT
+   * the "WriteBufferSize" and "AsyncFlush" attributes of PcapFileWrapper
+   * decide, so the buffered writers can also be selected with
+   * Config::SetDefault for files created by the device helpers.
    * @returns a smart pointer to the Pcap file
    */
   Ptr<PcapFileWrapper> CreateFile (std::string filename,
                                    std::ios::openmode filemode,
                                    DataLinkType dataLinkType,
                                    uint32_t snapLen = std::numeric_limits<uint32_t>::max (),
+                                   int32_t tzCorrection = 0,
+                                   WriterBackend backend = WRITER_DEFAULT);
+
+  /**
+   * @brief Create and initialize a compressed and/or rotated pcap file.
+   *
+   * Records are written through the asynchronous buffered writer, so
+   * compression and file rotation happen on a background thread.  The
+   * same can be had for files created by the device helpers by setting
+   * the "Compression", "RotateSize" and "RotateInterval" attributes of
+   * PcapFileWrapper with Config::SetDefault.
+   *
+   * @param filename file name (of the first file of a rotated sequence)
+   * @param filemode file mode
+   * @param dataLinkType data link type of packet data
+   * @param compression compression applied to the file
+   * @param rotateSize start a new file once the current one holds this
+   * many bytes (before compression), 0 to disable
+   * @param rotateInterval start a new file once the packet timestamps in
+   * the current one span this interval, 0 to disable
+   * @param snapLen maximum length of packet data stored in records
+   * @param tzCorrection time zone correction to be applied to timestamps of packets
+   * @returns a smart pointer to the Pcap file
+   */
+  Ptr<PcapFileWrapper> CreateFile (std::string filename,
+                                   std::ios::openmode filemode,
+                                   DataLinkType dataLinkType,
+                                   BufferedFileWriter::Compression compression,
+                                   uint64_t rotateSize = 0,
+                                   Time rotateInterval = Seconds (0),
+                                   uint32_t snapLen = std::numeric_limits<uint32_t>::max (),
                                    int32_t tzCorrection = 0);
   /**
    * @brief Hook a trace source to the default trace sink
@@ -222,6 +269,34 @@ public:
   Ptr<OutputStreamWrapper> CreateFileStream (std::string filename, 
                                              std::ios::openmode filemode = std::ios::out);
 
+  /**
+   * @brief Create an output stream that compresses and/or rotates the
+   * traced bits.
+   *
+   * The stream formats into a small local buffer which is copied into the
+   * staging buffers of an asynchronous BufferedFileWriter; compression and
+   * file I/O happen on its background thread.  Files are only split at the
+   * end of a line (more precisely, on std::endl or flush).
+   *
+   * The single-argument CreateFileStream () used by the device helpers
+   * picks these options up from the "AsciiTraceCompression",
+   * "AsciiTraceRotateSize" and "AsciiTraceRotateInterval" global values.
+   *
+   * @param filename file name (of the first file of a rotated sequence)
+   * @param filemode file mode
+   * @param compression compression applied to the file
+   * @param rotateSize start a new file once the current one holds this
+   * many bytes (before compression), 0 to disable
+   * @param rotateInterval start a new file once the current one spans this
+   * much simulation time, 0 to disable
+   * @returns a smart pointer to the output stream
+   */
+  Ptr<OutputStreamWrapper> CreateFileStream (std::string filename,
+                                             std::ios::openmode filemode,
+                                             BufferedFileWriter::Compression compression,
+                                             uint64_t rotateSize = 0,
+                                             Time rotateInterval = Seconds (0));
+
   /**
    * @brief Hook a trace source to the default enqueue operation trace sink that
    * does not accept nor log a trace context.
@@ -359,6 +359,18 @@ public:
    */
   virtual bool SupportsSendFrom (void) const = 0;
 
+  /**
+   * \brief Whether the device cuts TCP super-segments itself.
+   *
+   * A TCP super-segment carries several segments behind one TCP header
+   * (see TcpGsoTag), and may be larger than the MTU.  If the device does
+   * not support it, or if the segments do not fit in its MTU, the IP layer
+   * cuts the super-segments before Send; it never fragments them.
+   *
+   * \return true if this interface accepts TCP super-segments, false otherwise.
+   */
+  virtual bool SupportsGso (void) const;
+
 };
 
 } // namespace ns3
@@ -0,0 +1,151 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdio>
+#include <fstream>
+
+#include "ns3/test.h"
+#include "ns3/event-trace.h"
+
+using namespace ns3;
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Check the ring keeps records in order and drops them when full.
+ */
+class EventTraceRingTestCase : public TestCase
+{
+public:
+  EventTraceRingTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+EventTraceRingTestCase::EventTraceRingTestCase ()
+  : TestCase ("Check EventTraceRing ordering and overflow")
+{
+}
+
+void
+EventTraceRingTestCase::DoRun (void)
+{
+  Ptr<EventTraceRing> ring = Create<EventTraceRing> (7, 10);
+  // Capacity is rounded up to 16
+  for (uint32_t i = 0; i < 20; ++i)
+    {
+      ring->Record (EventTraceRecord::TCP, EventTraceRecord::SENT, 1, 0, 1000, i, 0);
+    }
+  NS_TEST_ASSERT_MSG_EQ (ring->GetDropped (), 4, "Records beyond the capacity must be dropped");
+
+  EventTraceRecord out[32];
+  uint32_t n = ring->Pop (out, 10);
+  NS_TEST_ASSERT_MSG_EQ (n, 10, "Pop must honor the maximum");
+  n += ring->Pop (out + n, 32 - n);
+  NS_TEST_ASSERT_MSG_EQ (n, 16, "Pop must return every stored record");
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (out[i].seq, i, "Records must come out in order");
+      NS_TEST_EXPECT_MSG_EQ (out[i].source, 7, "Records must carry the ring id");
+    }
+  NS_TEST_ASSERT_MSG_EQ (ring->Pop (out, 32), 0, "Ring must be empty");
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Check the sink writes every record of every ring to the file.
+ */
+class EventTraceSinkTestCase : public TestCase
+{
+public:
+  EventTraceSinkTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+EventTraceSinkTestCase::EventTraceSinkTestCase ()
+  : TestCase ("Check EventTraceSink file contents")
+{
+}
+
+void
+EventTraceSinkTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("events.bin");
+  const uint32_t nRecords = 1000;
+
+  Ptr<EventTraceSink> sink = Create<EventTraceSink> ();
+  NS_TEST_ASSERT_MSG_EQ (sink->Open (filename), true, "Cannot create " << filename);
+  Ptr<EventTraceRing> a = sink->CreateRing (1, nRecords);
+  Ptr<EventTraceRing> b = sink->CreateRing (2, nRecords);
+  for (uint32_t i = 0; i < nRecords; ++i)
+    {
+      a->Record (EventTraceRecord::COCOA, EventTraceRecord::ENQ, 10, 1, 536, i, 0);
+      b->Record (EventTraceRecord::TCP, EventTraceRecord::ACK, 20, 0, 1072, 0, i);
+    }
+  sink->Close ();
+  NS_TEST_ASSERT_MSG_EQ (sink->GetDropped (), 0, "No record should be dropped");
+
+  std::ifstream in (filename.c_str (), std::ios::binary);
+  EventTraceFileHeader header;
+  in.read ((char *) &header, sizeof (header));
+  NS_TEST_ASSERT_MSG_EQ (header.magic, EventTraceFileHeader::MAGIC, "Bad magic");
+  NS_TEST_ASSERT_MSG_EQ (header.recordSize, sizeof (EventTraceRecord), "Bad record size");
+
+  uint32_t next[3] = { 0, 0, 0 };
+  EventTraceRecord r;
+  while (in.read ((char *) &r, sizeof (r)))
+    {
+      NS_TEST_ASSERT_MSG_EQ ((r.source == 1 || r.source == 2), true, "Unknown source " << r.source);
+      uint32_t value = r.source == 1 ? r.seq : r.ack;
+      NS_TEST_ASSERT_MSG_EQ (value, next[r.source], "Records of a ring out of order");
+      ++next[r.source];
+    }
+  NS_TEST_EXPECT_MSG_EQ (next[1], nRecords, "Records of ring 1 missing");
+  NS_TEST_EXPECT_MSG_EQ (next[2], nRecords, "Records of ring 2 missing");
+  in.close ();
+  remove (filename.c_str ());
+
+  NS_TEST_EXPECT_MSG_EQ (EventTraceRecord::FlowId (Ipv4Address ("10.0.0.1"), 1000, Ipv4Address ("10.0.0.2"), 80, 6),
+                         EventTraceRecord::FlowId (Ipv4Address ("10.0.0.2"), 80, Ipv4Address ("10.0.0.1"), 1000, 6),
+                         "Flow id must not depend on the direction");
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Binary event trace TestSuite
+ */
+class EventTraceTestSuite : public TestSuite
+{
+public:
+  EventTraceTestSuite ();
+};
+
+EventTraceTestSuite::EventTraceTestSuite ()
+  : TestSuite ("event-trace", UNIT)
+{
+  AddTestCase (new EventTraceRingTestCase, TestCase::QUICK);
+  AddTestCase (new EventTraceSinkTestCase, TestCase::QUICK);
+}
+
+static EventTraceTestSuite eventTraceTestSuite; //!< Static variable for test initialization
@@ -25,6 +25,13 @@
 #include "ns3/log.h"
 #include "ns3/test.h"
 #include "ns3/pcap-file.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <vector>
 
 using namespace ns3;
 
@@ -1144,6 +1151,428 @@ DiffTestCase::DoRun (void)
   NS_TEST_EXPECT_MSG_EQ (usec, 3696, "Files are different from 2.3696 seconds");
 }
 
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Test case to make sure that buffered (and asynchronously flushed)
+ * writes produce the same file as the std::fstream writer.
+ */
+class BufferedWriteTestCase : public TestCase
+{
+public:
+  BufferedWriteTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Copy known.pcap to a new file
+   * \param filename the file to create
+   * \param bufferSize write buffer size, 0 for unbuffered
+   * \param async flush the write buffers from a background thread
+   */
+  void CopyKnownFile (std::string filename, uint32_t bufferSize, bool async);
+};
+
+BufferedWriteTestCase::BufferedWriteTestCase ()
+  : TestCase ("Check that buffered PcapFile writes match unbuffered writes")
+{
+}
+
+void
+BufferedWriteTestCase::CopyKnownFile (std::string filename, uint32_t bufferSize, bool async)
+{
+  PcapFile in;
+  in.Open (CreateDataDirFilename ("known.pcap"), std::ios::in);
+  NS_TEST_ASSERT_MSG_EQ (in.Fail (), false, "Open (known.pcap) returns error");
+
+  PcapFile out;
+  out.SetWriteBuffer (bufferSize, async);
+  out.Open (filename, std::ios::out);
+  NS_TEST_ASSERT_MSG_EQ (out.Fail (), false, "Open (" << filename << ", \"std::ios::out\") returns error");
+  out.Init (in.GetDataLinkType (), in.GetSnapLen ());
+
+  uint8_t data[2048];
+  uint32_t tsSec, tsUsec, inclLen, origLen, readLen;
+  //
+  // Write every record several times so that small buffers wrap around
+  // more than once.
+  //
+  for (uint32_t round = 0; round < 4; ++round)
+    {
+      in.Clear ();
+      in.Close ();
+      in.Open (CreateDataDirFilename ("known.pcap"), std::ios::in);
+      for (uint32_t i = 0; i < N_KNOWN_PACKETS; ++i)
+        {
+          in.Read (data, sizeof(data), tsSec, tsUsec, inclLen, origLen, readLen);
+          NS_TEST_ASSERT_MSG_EQ (in.Fail (), false, "Read() of known good pcap file returns error");
+          out.Write (tsSec + round, tsUsec, data, readLen);
+          NS_TEST_ASSERT_MSG_EQ (out.Fail (), false, "Write must not fail");
+        }
+    }
+  out.Close ();
+  in.Close ();
+}
+
+void
+BufferedWriteTestCase::DoRun (void)
+{
+  std::string reference = CreateTempDirFilename ("buffered-reference.pcap");
+  CopyKnownFile (reference, 0, false);
+
+  //
+  // A buffer smaller than a record exercises the spill path, a buffer of a
+  // few records exercises flushing on full buffers.
+  //
+  uint32_t sizes[] = { 64, 1500, 1 << 20 };
+  for (uint32_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i)
+    {
+      for (uint32_t async = 0; async < 2; ++async)
+        {
+          std::ostringstream oss;
+          oss << "buffered-" << sizes[i] << "-" << async << ".pcap";
+          std::string filename = CreateTempDirFilename (oss.str ());
+          CopyKnownFile (filename, sizes[i], async);
+
+          uint32_t sec (0), usec (0), packets (0);
+          bool diff = PcapFile::Diff (reference, filename, sec, usec, packets);
+          NS_TEST_EXPECT_MSG_EQ (diff, false, "Buffered write (" << sizes[i] << ", " << async << ") differs from reference");
+          NS_TEST_EXPECT_MSG_EQ (packets, 4 * N_KNOWN_PACKETS, "Buffered write lost packets");
+
+          FILE * p = std::fopen (reference.c_str (), "rb");
+          std::fseek (p, 0, SEEK_END);
+          uint64_t size = std::ftell (p);
+          std::fclose (p);
+          NS_TEST_EXPECT_MSG_EQ (CheckFileLength (filename, size), true, "Buffered write has the wrong file length");
+
+          remove (filename.c_str ());
+        }
+    }
+  remove (reference.c_str ());
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Test case to make sure that rotated pcap files each start with a
+ * file header and together hold every record.
+ */
+class RotationTestCase : public TestCase
+{
+public:
+  RotationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+RotationTestCase::RotationTestCase ()
+  : TestCase ("Check that PcapFile rotation splits records into valid files")
+{
+}
+
+void
+RotationTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("rotated.pcap");
+  const uint32_t nPackets = 100;
+  uint8_t data[100];
+  std::memset (data, 0xab, sizeof (data));
+
+  for (uint32_t bySize = 0; bySize < 2; ++bySize)
+    {
+      PcapFile f;
+      if (bySize)
+        {
+          // Room for the file header and ten 116-byte records
+          f.SetRotation (24 + 10 * (16 + sizeof (data)), 0);
+        }
+      else
+        {
+          // One file per simulated second
+          f.SetRotation (0, 1000000000);
+        }
+      f.SetWriteBuffer (512, bySize);
+      f.Open (filename, std::ios::out);
+      NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Open (" << filename << ", \"std::ios::out\") returns error");
+      f.Init (1);
+      for (uint32_t i = 0; i < nPackets; ++i)
+        {
+          // Ten records per second
+          f.Write (i / 10, (i % 10) * 100000, data, sizeof (data));
+        }
+      f.Close ();
+      NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Rotated writes must not fail");
+
+      uint32_t total = 0;
+      for (uint32_t index = 0; index < 10; ++index)
+        {
+          std::string name = BufferedFileWriter::GetRotatedFilename (filename, index);
+          PcapFile in;
+          in.Open (name, std::ios::in);
+          NS_TEST_ASSERT_MSG_EQ (in.Fail (), false, "Rotated file " << name << " is not a valid pcap file");
+          uint8_t buf[128];
+          uint32_t tsSec, tsUsec, inclLen, origLen, readLen;
+          uint32_t count = 0;
+          while (true)
+            {
+              in.Read (buf, sizeof (buf), tsSec, tsUsec, inclLen, origLen, readLen);
+              if (in.Fail ())
+                {
+                  break;
+                }
+              NS_TEST_EXPECT_MSG_EQ (tsSec, total / 10, "Record in the wrong file");
+              ++count;
+              ++total;
+            }
+          NS_TEST_EXPECT_MSG_EQ (count, 10, "Rotated file " << name << " has the wrong number of records");
+          in.Close ();
+          remove (name.c_str ());
+        }
+      NS_TEST_EXPECT_MSG_EQ (total, nPackets, "Rotated files lost records");
+    }
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Test case to make sure that compressed pcap files decompress to
+ * the records written, for each compression method of this build.
+ */
+class CompressionTestCase : public TestCase
+{
+public:
+  CompressionTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Decompress a file written by PcapFile
+   * \param compression the compression method of the file
+   * \param from the compressed file
+   * \param to the file to create with the decompressed data
+   * \return true if the whole compressed stream was read
+   */
+  bool Decompress (BufferedFileWriter::Compression compression,
+                   std::string const &from, std::string const &to);
+};
+
+CompressionTestCase::CompressionTestCase ()
+  : TestCase ("Check that compressed PcapFile writes decompress to the records written")
+{
+}
+
+bool
+CompressionTestCase::Decompress (BufferedFileWriter::Compression compression,
+                                 std::string const &from, std::string const &to)
+{
+  bool ok = false;
+  switch (compression)
+    {
+#ifdef HAVE_ZLIB
+    case BufferedFileWriter::GZIP:
+      {
+        gzFile in = gzopen (from.c_str (), "rb");
+        FILE *out = std::fopen (to.c_str (), "wb");
+        if (in == 0 || out == 0)
+          {
+            break;
+          }
+        char buf[4096];
+        int n;
+        while ((n = gzread (in, buf, sizeof (buf))) > 0)
+          {
+            std::fwrite (buf, 1, n, out);
+          }
+        ok = n == 0;
+        gzclose (in);
+        std::fclose (out);
+        break;
+      }
+#endif
+#ifdef HAVE_ZSTD
+    case BufferedFileWriter::ZSTD:
+      {
+        FILE *in = std::fopen (from.c_str (), "rb");
+        FILE *out = std::fopen (to.c_str (), "wb");
+        if (in == 0 || out == 0)
+          {
+            break;
+          }
+        ZSTD_DStream *zds = ZSTD_createDStream ();
+        ZSTD_initDStream (zds);
+        std::vector<char> inBuf (ZSTD_DStreamInSize ());
+        std::vector<char> outBuf (ZSTD_DStreamOutSize ());
+        size_t ret = 1;
+        size_t n;
+        while ((n = std::fread (&inBuf[0], 1, inBuf.size (), in)) > 0)
+          {
+            ZSTD_inBuffer input = { &inBuf[0], n, 0 };
+            while (input.pos < input.size)
+              {
+                ZSTD_outBuffer output = { &outBuf[0], outBuf.size (), 0 };
+                ret = ZSTD_decompressStream (zds, &output, &input);
+                if (ZSTD_isError (ret))
+                  {
+                    break;
+                  }
+                std::fwrite (&outBuf[0], 1, output.pos, out);
+              }
+            if (ZSTD_isError (ret))
+              {
+                break;
+              }
+          }
+        // 0 once a frame is complete
+        ok = ret == 0;
+        ZSTD_freeDStream (zds);
+        std::fclose (in);
+        std::fclose (out);
+        break;
+      }
+#endif
+    default:
+      break;
+    }
+  return ok;
+}
+
+void
+CompressionTestCase::DoRun (void)
+{
+  BufferedFileWriter::Compression methods[] = { BufferedFileWriter::GZIP, BufferedFileWriter::ZSTD };
+  const uint32_t nPackets = 1000;
+
+  for (uint32_t m = 0; m < sizeof (methods) / sizeof (methods[0]); ++m)
+    {
+      if (!BufferedFileWriter::IsCompressionSupported (methods[m]))
+        {
+          continue;
+        }
+      std::ostringstream oss;
+      oss << "compressed-" << methods[m] << ".pcap";
+      std::string filename = CreateTempDirFilename (oss.str ());
+      std::string decompressed = CreateTempDirFilename (oss.str () + ".out");
+
+      PcapFile f;
+      // Buffers of a few records, flushed many times
+      f.SetWriteBuffer (4096);
+      f.SetCompression (methods[m]);
+      f.Open (filename, std::ios::out);
+      NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Open (" << filename << ", \"std::ios::out\") returns error");
+      f.Init (1);
+      uint8_t data[1500];
+      for (uint32_t i = 0; i < nPackets; ++i)
+        {
+          std::memset (data, i & 0xff, sizeof (data));
+          f.Write (i / 100, (i % 100) * 10000, data, 64 + i % 1000);
+        }
+      f.Close ();
+      NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Compressed writes must not fail");
+
+      NS_TEST_ASSERT_MSG_EQ (Decompress (methods[m], filename, decompressed), true,
+                             "Compressed file " << filename << " does not decompress");
+
+      PcapFile in;
+      in.Open (decompressed, std::ios::in);
+      NS_TEST_ASSERT_MSG_EQ (in.Fail (), false, "Decompressed file is not a valid pcap file");
+      uint32_t tsSec, tsUsec, inclLen, origLen, readLen;
+      for (uint32_t i = 0; i < nPackets; ++i)
+        {
+          in.Read (data, sizeof (data), tsSec, tsUsec, inclLen, origLen, readLen);
+          NS_TEST_ASSERT_MSG_EQ (in.Fail (), false, "Decompressed file lost record " << i);
+          NS_TEST_EXPECT_MSG_EQ (tsSec, i / 100, "Wrong seconds timestamp in record " << i);
+          NS_TEST_EXPECT_MSG_EQ (tsUsec, (i % 100) * 10000, "Wrong microseconds timestamp in record " << i);
+          NS_TEST_ASSERT_MSG_EQ (readLen, 64 + i % 1000, "Wrong length of record " << i);
+          NS_TEST_EXPECT_MSG_EQ (data[0] == (i & 0xff) && data[readLen - 1] == (i & 0xff), true,
+                                 "Wrong data in record " << i);
+        }
+      in.Read (data, sizeof (data), tsSec, tsUsec, inclLen, origLen, readLen);
+      NS_TEST_EXPECT_MSG_EQ (in.Eof (), true, "Decompressed file has extra records");
+      in.Close ();
+
+      remove (filename.c_str ());
+      remove (decompressed.c_str ());
+    }
+}
+
+/**
+ * \ingroup network-test
+ * \ingroup tests
+ *
+ * \brief Test case to make sure that a memory-mapped PcapFile reads the
+ * same records as a std::fstream one, through Read () and ReadNext ().
+ */
+class MappedReadTestCase : public TestCase
+{
+public:
+  MappedReadTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MappedReadTestCase::MappedReadTestCase ()
+  : TestCase ("Check to see that a mapped PcapFile can read out a known good pcap file")
+{
+}
+
+void
+MappedReadTestCase::DoRun (void)
+{
+  std::string filename = CreateDataDirFilename ("known.pcap");
+
+  for (uint32_t pass = 0; pass < 2; ++pass)
+    {
+      PcapFile f;
+      // A window smaller than a page still maps the whole file
+      f.SetReadMapping (64);
+      f.Open (filename, std::ios::in);
+      NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Open (" << filename << 
+                             ", \"std::ios::in\") returns error");
+
+      uint8_t data[N_PACKET_BYTES];
+      uint8_t const *record;
+      uint32_t tsSec, tsUsec, inclLen, origLen, readLen;
+
+      for (uint32_t i = 0; i < N_KNOWN_PACKETS; ++i)
+        {
+          PacketEntry const & p = knownPackets[i];
+
+          if (pass == 0)
+            {
+              f.Read (data, sizeof(data), tsSec, tsUsec, inclLen, origLen, readLen);
+              NS_TEST_ASSERT_MSG_EQ (readLen, N_PACKET_BYTES, "Incorrect actual read length from mapped file");
+              record = data;
+            }
+          else
+            {
+              f.ReadNext (record, tsSec, tsUsec, inclLen, origLen);
+            }
+          NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Read of mapped known good pcap file returns error");
+          NS_TEST_ASSERT_MSG_EQ (tsSec, p.tsSec, "Incorrectly read seconds timestap from mapped file");
+          NS_TEST_ASSERT_MSG_EQ (tsUsec, p.tsUsec, "Incorrectly read microseconds timestap from mapped file");
+          NS_TEST_ASSERT_MSG_EQ (inclLen, p.inclLen, "Incorrectly read included length from mapped file");
+          NS_TEST_ASSERT_MSG_EQ (origLen, p.origLen, "Incorrectly read original length from mapped file");
+          for (uint32_t j = 0; j < N_PACKET_BYTES / 2; ++j)
+            {
+              uint16_t word = (record[2 * j] << 8) | record[2 * j + 1];
+              NS_TEST_ASSERT_MSG_EQ (word, p.data[j], "Incorrect data read from mapped file");
+            }
+        }
+
+      NS_TEST_ASSERT_MSG_EQ (f.ReadNext (record, tsSec, tsUsec, inclLen, origLen), false,
+                             "ReadNext () past the last record succeeds");
+      NS_TEST_ASSERT_MSG_EQ (f.Eof (), true, "Read of mapped file at EOF does not return error");
+      f.Close ();
+    }
+}
+
 /**
  * \ingroup network-test
  * \ingroup tests
@@ -1167,6 +1596,10 @@ PcapFileTestSuite::PcapFileTestSuite ()
   AddTestCase (new RecordHeaderTestCase, TestCase::QUICK);
   AddTestCase (new ReadFileTestCase, TestCase::QUICK);
   AddTestCase (new DiffTestCase, TestCase::QUICK);
+  AddTestCase (new BufferedWriteTestCase, TestCase::QUICK);
+  AddTestCase (new RotationTestCase, TestCase::QUICK);
+  AddTestCase (new CompressionTestCase, TestCase::QUICK);
+  AddTestCase (new MappedReadTestCase, TestCase::QUICK);
 }
 
 static PcapFileTestSuite pcapFileTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,558 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/fatal-error.h"
+#include "buffered-file-writer.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BufferedFileWriter");
+
+/**
+ * Alignment of the staging buffers.  Page alignment lets the kernel copy
+ * whole pages out of them.
+ */
+static const size_t BUFFER_ALIGNMENT = 4096;
+
+bool
+BufferedFileWriter::IsCompressionSupported (Compression compression)
+{
+  switch (compression)
+    {
+    case NONE:
+      return true;
+#ifdef HAVE_ZLIB
+    case GZIP:
+      return true;
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      return true;
+#endif
+    default:
+      return false;
+    }
+}
+
+std::string
+BufferedFileWriter::GetRotatedFilename (std::string const &filename, uint32_t index)
+{
+  if (index == 0)
+    {
+      return filename;
+    }
+
+  std::string::size_type slash = filename.find_last_of ('/');
+  std::string::size_type base = (slash == std::string::npos) ? 0 : slash + 1;
+  std::string::size_type end = filename.size ();
+
+  //
+  // Skip a compression suffix, then insert the index before the extension
+  // left, if any.
+  //
+  static const char *suffixes[] = { ".gz", ".zst" };
+  for (uint32_t i = 0; i < sizeof (suffixes) / sizeof (suffixes[0]); ++i)
+    {
+      std::string suffix (suffixes[i]);
+      if (end - base > suffix.size ()
+          && filename.compare (end - suffix.size (), suffix.size (), suffix) == 0)
+        {
+          end -= suffix.size ();
+          break;
+        }
+    }
+  std::string::size_type dot = filename.find_last_of ('.', end - 1);
+  std::string::size_type at = (dot == std::string::npos || dot <= base) ? end : dot;
+
+  std::ostringstream oss;
+  oss << filename.substr (0, at) << "." << index << filename.substr (at);
+  return oss.str ();
+}
+
+BufferedFileWriter::BufferedFileWriter (std::string const &filename,
+                                        std::ios::openmode mode,
+                                        uint32_t bufferSize,
+                                        bool async,
+                                        Compression compression,
+                                        uint32_t nBuffers)
+  : m_filename (filename),
+    m_mode (mode | std::ios::out | std::ios::binary),
+    m_compression (compression),
+    m_compressor (0),
+    m_fileIndex (0),
+    m_rotateBytes (0),
+    m_rotateDuration (0),
+    m_bytesInFile (0),
+    m_fileStart (0),
+    m_fileStartSet (false),
+    m_bufferSize (bufferSize),
+    m_async (async),
+    m_closed (false),
+    m_failed (false),
+    m_writing (false),
+    m_stop (false)
+{
+  NS_LOG_FUNCTION (this << filename << mode << bufferSize << async << compression << nBuffers);
+  NS_ASSERT_MSG (bufferSize > 0, "BufferedFileWriter needs a non-empty buffer");
+  if (!IsCompressionSupported (compression))
+    {
+      NS_FATAL_ERROR ("BufferedFileWriter: compression method " << compression <<
+                      " is not supported by this build");
+    }
+
+  switch (m_compression)
+    {
+#ifdef HAVE_ZLIB
+    case GZIP:
+      {
+        z_stream *zs = new z_stream;
+        std::memset (zs, 0, sizeof (z_stream));
+        // 15 window bits, plus 16 to get a gzip rather than a zlib wrapper
+        if (deflateInit2 (zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+          {
+            NS_FATAL_ERROR ("BufferedFileWriter: deflateInit2 failed");
+          }
+        m_compressor = zs;
+        m_compressed.resize (m_bufferSize + m_bufferSize / 1000 + 64);
+        break;
+      }
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      {
+        ZSTD_CStream *zcs = ZSTD_createCStream ();
+        if (zcs == 0 || ZSTD_isError (ZSTD_initCStream (zcs, 3)))
+          {
+            NS_FATAL_ERROR ("BufferedFileWriter: unable to initialize zstd stream");
+          }
+        m_compressor = zcs;
+        m_compressed.resize (ZSTD_CStreamOutSize ());
+        break;
+      }
+#endif
+    default:
+      break;
+    }
+
+  m_failed = !OpenFile (m_filename);
+
+  uint32_t n = m_async ? std::max (nBuffers, 2u) : 1;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      void *p = 0;
+      if (posix_memalign (&p, BUFFER_ALIGNMENT, m_bufferSize) != 0)
+        {
+          NS_FATAL_ERROR ("BufferedFileWriter: unable to allocate " << m_bufferSize << " bytes");
+        }
+      m_storage.push_back (static_cast<uint8_t *> (p));
+      Block b = { static_cast<uint8_t *> (p), 0, false };
+      m_free.push_back (b);
+    }
+  m_current = m_free.front ();
+  m_free.pop_front ();
+
+  if (m_async)
+    {
+      m_thread = std::thread (&BufferedFileWriter::WriterLoop, this);
+    }
+}
+
+BufferedFileWriter::~BufferedFileWriter ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+  for (std::vector<uint8_t *>::iterator i = m_storage.begin (); i != m_storage.end (); ++i)
+    {
+      std::free (*i);
+    }
+  m_storage.clear ();
+
+  switch (m_compression)
+    {
+#ifdef HAVE_ZLIB
+    case GZIP:
+      deflateEnd (static_cast<z_stream *> (m_compressor));
+      delete static_cast<z_stream *> (m_compressor);
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      ZSTD_freeCStream (static_cast<ZSTD_CStream *> (m_compressor));
+      break;
+#endif
+    default:
+      break;
+    }
+  m_compressor = 0;
+}
+
+bool
+BufferedFileWriter::Fail (void) const
+{
+  std::lock_guard<std::mutex> lock (m_mutex);
+  return m_failed;
+}
+
+uint32_t
+BufferedFileWriter::GetBufferSize (void) const
+{
+  return m_bufferSize;
+}
+
+uint8_t *
+BufferedFileWriter::Reserve (uint32_t size)
+{
+  NS_ASSERT (!m_closed);
+  if (size > m_bufferSize)
+    {
+      return 0;
+    }
+  if (m_current.used + size > m_bufferSize)
+    {
+      Submit ();
+    }
+  return m_current.data + m_current.used;
+}
+
+void
+BufferedFileWriter::Commit (uint32_t size)
+{
+  NS_ASSERT (m_current.used + size <= m_bufferSize);
+  m_current.used += size;
+  m_bytesInFile += size;
+}
+
+void
+BufferedFileWriter::Write (uint8_t const *data, uint32_t size)
+{
+  NS_ASSERT (!m_closed);
+  m_bytesInFile += size;
+  while (size > 0)
+    {
+      if (m_current.used == m_bufferSize)
+        {
+          Submit ();
+        }
+      uint32_t n = std::min (size, m_bufferSize - m_current.used);
+      std::memcpy (m_current.data + m_current.used, data, n);
+      m_current.used += n;
+      data += n;
+      size -= n;
+    }
+}
+
+void
+BufferedFileWriter::SetRotation (uint64_t maxBytes, int64_t maxDuration)
+{
+  NS_LOG_FUNCTION (this << maxBytes << maxDuration);
+  m_rotateBytes = maxBytes;
+  m_rotateDuration = maxDuration;
+}
+
+void
+BufferedFileWriter::SetPreamble (uint8_t const *data, uint32_t size)
+{
+  NS_LOG_FUNCTION (this << size);
+  m_preamble.assign (data, data + size);
+  Write (data, size);
+}
+
+void
+BufferedFileWriter::Boundary (int64_t timestamp)
+{
+  if (!m_fileStartSet)
+    {
+      m_fileStart = timestamp;
+      m_fileStartSet = true;
+      return;
+    }
+  if (m_bytesInFile <= m_preamble.size ())
+    {
+      // Never rotate away from a file holding nothing but its preamble.
+      return;
+    }
+  if ((m_rotateBytes > 0 && m_bytesInFile >= m_rotateBytes)
+      || (m_rotateDuration > 0 && timestamp - m_fileStart >= m_rotateDuration))
+    {
+      NS_LOG_LOGIC ("Rotating after " << m_bytesInFile << " bytes");
+      m_current.rotate = true;
+      Submit ();
+      m_bytesInFile = m_preamble.size ();
+      m_fileStart = timestamp;
+    }
+}
+
+void
+BufferedFileWriter::Submit (void)
+{
+  if (m_current.used == 0 && !m_current.rotate)
+    {
+      return;
+    }
+
+  if (!m_async)
+    {
+      if (!Output (m_current))
+        {
+          std::lock_guard<std::mutex> lock (m_mutex);
+          m_failed = true;
+        }
+      m_current.used = 0;
+      m_current.rotate = false;
+      return;
+    }
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_pending.push_back (m_current);
+  m_cond.notify_all ();
+  while (m_free.empty ())
+    {
+      m_cond.wait (lock);
+    }
+  m_current = m_free.front ();
+  m_free.pop_front ();
+  m_current.used = 0;
+  m_current.rotate = false;
+}
+
+bool
+BufferedFileWriter::OpenFile (std::string const &filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  m_file.open (filename.c_str (), m_mode);
+  switch (m_compression)
+    {
+#ifdef HAVE_ZLIB
+    case GZIP:
+      deflateReset (static_cast<z_stream *> (m_compressor));
+      break;
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      ZSTD_initCStream (static_cast<ZSTD_CStream *> (m_compressor), 3);
+      break;
+#endif
+    default:
+      break;
+    }
+  return !m_file.fail ();
+}
+
+bool
+BufferedFileWriter::Emit (uint8_t const *data, uint32_t size)
+{
+  switch (m_compression)
+    {
+#ifdef HAVE_ZLIB
+    case GZIP:
+      {
+        z_stream *zs = static_cast<z_stream *> (m_compressor);
+        zs->next_in = const_cast<Bytef *> (data);
+        zs->avail_in = size;
+        while (zs->avail_in > 0)
+          {
+            zs->next_out = &m_compressed[0];
+            zs->avail_out = m_compressed.size ();
+            deflate (zs, Z_NO_FLUSH);
+            m_file.write (reinterpret_cast<const char *> (&m_compressed[0]),
+                          m_compressed.size () - zs->avail_out);
+          }
+        break;
+      }
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      {
+        ZSTD_CStream *zcs = static_cast<ZSTD_CStream *> (m_compressor);
+        ZSTD_inBuffer in = { data, size, 0 };
+        while (in.pos < in.size)
+          {
+            ZSTD_outBuffer out = { &m_compressed[0], m_compressed.size (), 0 };
+            if (ZSTD_isError (ZSTD_compressStream (zcs, &out, &in)))
+              {
+                return false;
+              }
+            m_file.write (reinterpret_cast<const char *> (&m_compressed[0]), out.pos);
+          }
+        break;
+      }
+#endif
+    default:
+      m_file.write (reinterpret_cast<const char *> (data), size);
+      break;
+    }
+  return !m_file.fail ();
+}
+
+bool
+BufferedFileWriter::FinishFile (void)
+{
+  NS_LOG_FUNCTION (this);
+  switch (m_compression)
+    {
+#ifdef HAVE_ZLIB
+    case GZIP:
+      {
+        z_stream *zs = static_cast<z_stream *> (m_compressor);
+        zs->next_in = 0;
+        zs->avail_in = 0;
+        int ret;
+        do
+          {
+            zs->next_out = &m_compressed[0];
+            zs->avail_out = m_compressed.size ();
+            ret = deflate (zs, Z_FINISH);
+            m_file.write (reinterpret_cast<const char *> (&m_compressed[0]),
+                          m_compressed.size () - zs->avail_out);
+          }
+        while (ret == Z_OK);
+        break;
+      }
+#endif
+#ifdef HAVE_ZSTD
+    case ZSTD:
+      {
+        ZSTD_CStream *zcs = static_cast<ZSTD_CStream *> (m_compressor);
+        size_t remaining;
+        do
+          {
+            ZSTD_outBuffer out = { &m_compressed[0], m_compressed.size (), 0 };
+            remaining = ZSTD_endStream (zcs, &out);
+            if (ZSTD_isError (remaining))
+              {
+                return false;
+              }
+            m_file.write (reinterpret_cast<const char *> (&m_compressed[0]), out.pos);
+          }
+        while (remaining > 0);
+        break;
+      }
+#endif
+    default:
+      break;
+    }
+  bool ok = !m_file.fail ();
+  m_file.close ();
+  return ok;
+}
+
+bool
+BufferedFileWriter::Output (Block const &b)
+{
+  bool ok = Emit (b.data, b.used);
+  if (b.rotate)
+    {
+      ok = FinishFile () && ok;
+      ++m_fileIndex;
+      ok = OpenFile (GetRotatedFilename (m_filename, m_fileIndex)) && ok;
+      if (!m_preamble.empty ())
+        {
+          ok = Emit (&m_preamble[0], m_preamble.size ()) && ok;
+        }
+    }
+  return ok;
+}
+
+void
+BufferedFileWriter::WriterLoop (void)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (true)
+    {
+      while (m_pending.empty () && !m_stop)
+        {
+          m_cond.wait (lock);
+        }
+      if (m_pending.empty ())
+        {
+          break;
+        }
+      Block b = m_pending.front ();
+      m_pending.pop_front ();
+      m_writing = true;
+      lock.unlock ();
+
+      bool ok = Output (b);
+
+      lock.lock ();
+      m_failed = m_failed || !ok;
+      m_writing = false;
+      b.used = 0;
+      b.rotate = false;
+      m_free.push_back (b);
+      m_cond.notify_all ();
+    }
+}
+
+void
+BufferedFileWriter::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_closed)
+    {
+      return;
+    }
+  Submit ();
+  if (m_async)
+    {
+      std::unique_lock<std::mutex> lock (m_mutex);
+      while (!m_pending.empty () || m_writing)
+        {
+          m_cond.wait (lock);
+        }
+    }
+  m_file.flush ();
+}
+
+void
+BufferedFileWriter::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_closed)
+    {
+      return;
+    }
+  Flush ();
+  if (m_async)
+    {
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_stop = true;
+        m_cond.notify_all ();
+      }
+      m_thread.join ();
+    }
+  if (!FinishFile ())
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_failed = true;
+    }
+  m_closed = true;
+}
+
+} // namespace ns3
@@ -0,0 +1,273 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BUFFERED_FILE_WRITER_H
+#define BUFFERED_FILE_WRITER_H
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+namespace ns3 {
+
+/**
+ * \brief A write-only file that batches small writes into large blocks.
+ *
+ * Trace writers (pcap in particular) produce a stream of small records,
+ * and pushing each of them through std::fstream costs far more than the
+ * bytes themselves.  A BufferedFileWriter hands out space in a large,
+ * page-aligned staging buffer; records are serialized directly into it
+ * with Reserve () / Commit (), and the buffer is written to disk in one
+ * piece when it fills up.
+ *
+ * In asynchronous mode, full buffers are queued to a background thread
+ * which performs the actual file I/O while the simulation thread keeps
+ * filling a spare buffer.  The simulation thread only blocks if all
+ * buffers are waiting to be written.
+ *
+ * The output can optionally be compressed (gzip or zstd, when the library
+ * was found at configure time) and rotated into a sequence of files once a
+ * file reaches a given size or spans a given time.  Both happen where the
+ * blocks are written, i.e. on the background thread in asynchronous mode.
+ * Rotation only happens at points the producer marks with Boundary (), so
+ * every file holds whole records; a preamble (such as a pcap file header)
+ * can be registered to start each file.
+ *
+ * The writer is a plain C++ object (no ns-3 Object machinery) so that it
+ * can be used from PcapFile, which is also used by the test framework.
+ */
+class BufferedFileWriter
+{
+public:
+  static const uint32_t BUFFER_SIZE_DEFAULT = 1 << 20; /**< Default size of each staging buffer */
+  static const uint32_t N_BUFFERS_DEFAULT = 4;         /**< Default number of buffers in async mode */
+
+  /**
+   * Compression applied to the data written to the file.
+   */
+  enum Compression
+  {
+    NONE,   /**< Data is written as is */
+    GZIP,   /**< A gzip stream (requires zlib) */
+    ZSTD    /**< A zstd frame (requires libzstd) */
+  };
+
+  /**
+   * \param compression a compression method
+   * \return true if this build can write the given compression method
+   */
+  static bool IsCompressionSupported (Compression compression);
+
+  /**
+   * \brief Get the name of a file in a rotated sequence.
+   *
+   * The first file keeps the given name; later files get the index inserted
+   * before the file extension (ignoring a .gz or .zst suffix), so that
+   * "trace.pcap.gz" is followed by "trace.1.pcap.gz", "trace.2.pcap.gz"...
+   *
+   * \param filename the name of the first file
+   * \param index position in the sequence, 0 for the first file
+   * \return the name of the file
+   */
+  static std::string GetRotatedFilename (std::string const &filename, uint32_t index);
+
+  /**
+   * \brief Open a file for buffered writing.
+   *
+   * \param filename name of the file to create
+   * \param mode the access mode for the file; binary is always added
+   * \param bufferSize size in bytes of each staging buffer
+   * \param async if true, full buffers are written by a background thread
+   * \param compression compression applied to the file contents
+   * \param nBuffers number of staging buffers used in async mode
+   */
+  BufferedFileWriter (std::string const &filename,
+                      std::ios::openmode mode,
+                      uint32_t bufferSize = BUFFER_SIZE_DEFAULT,
+                      bool async = false,
+                      Compression compression = NONE,
+                      uint32_t nBuffers = N_BUFFERS_DEFAULT);
+  ~BufferedFileWriter ();
+
+  /**
+   * \return true if opening the file or any write so far has failed.
+   */
+  bool Fail (void) const;
+
+  /**
+   * \return the size in bytes of each staging buffer.
+   */
+  uint32_t GetBufferSize (void) const;
+
+  /**
+   * \brief Get space for a record of the given size in the staging buffer.
+   *
+   * If the current buffer does not have room for the record it is flushed
+   * first.  The caller must call Commit () with the number of bytes actually
+   * written before any other call on this object.
+   *
+   * \param size number of bytes needed
+   * \return a pointer to size bytes of writable space, or 0 if size is
+   * larger than a whole staging buffer (use Write () instead).
+   */
+  uint8_t * Reserve (uint32_t size);
+
+  /**
+   * \brief Account for bytes written into space returned by Reserve ().
+   * \param size number of bytes written, at most the reserved size
+   */
+  void Commit (uint32_t size);
+
+  /**
+   * \brief Copy data into the staging buffer, flushing as needed.
+   * \param data the bytes to write
+   * \param size number of bytes to write
+   */
+  void Write (uint8_t const *data, uint32_t size);
+
+  /**
+   * \brief Start a new file once the current one is large or old enough.
+   *
+   * Rotation is checked in Boundary (), which the producer calls where the
+   * data may be split (between records).  Limits of 0 disable each check.
+   *
+   * \param maxBytes uncompressed size, preamble included, after which a
+   * new file is started
+   * \param maxDuration span of Boundary () timestamps after which a new
+   * file is started
+   */
+  void SetRotation (uint64_t maxBytes, int64_t maxDuration);
+
+  /**
+   * \brief Set data to be written at the start of every file.
+   *
+   * The preamble is written to the current file right away and repeated at
+   * the start of each rotated file.  Call before writing any record.
+   *
+   * \param data the preamble bytes
+   * \param size number of bytes
+   */
+  void SetPreamble (uint8_t const *data, uint32_t size);
+
+  /**
+   * \brief Mark a point where the output may be split into a new file.
+   *
+   * If rotation is enabled and a limit has been reached, the data written
+   * so far goes to the current file and subsequent data to the next one.
+   *
+   * \param timestamp time of the data that follows, in any unit consistent
+   * with the maxDuration given to SetRotation ()
+   */
+  void Boundary (int64_t timestamp);
+
+  /**
+   * \brief Push all buffered data to the file and wait until it is written.
+   */
+  void Flush (void);
+
+  /**
+   * \brief Flush, stop the background thread (if any) and close the file.
+   */
+  void Close (void);
+
+private:
+  /**
+   * \brief Hand the current buffer off to be written and get an empty one.
+   */
+  void Submit (void);
+  struct Block;
+  /**
+   * \brief Write a block to the current file, rotating after it if asked.
+   *
+   * Runs on the writer thread in async mode, on the caller's thread
+   * otherwise.
+   *
+   * \param b the block to write
+   * \return false if a write failed
+   */
+  bool Output (Block const &b);
+  /**
+   * \brief Compress (if needed) and write data to the current file.
+   * \param data the bytes to write
+   * \param size number of bytes to write
+   * \return false if a write failed
+   */
+  bool Emit (uint8_t const *data, uint32_t size);
+  /**
+   * \brief Open a file of the sequence and reset the compressor.
+   * \param filename the file to open
+   * \return false if the file could not be opened
+   */
+  bool OpenFile (std::string const &filename);
+  /**
+   * \brief Terminate the compressed stream and close the current file.
+   * \return false if a write failed
+   */
+  bool FinishFile (void);
+  /**
+   * \brief Body of the background writer thread.
+   */
+  void WriterLoop (void);
+
+  /**
+   * \brief A staging buffer and the number of bytes used in it.
+   */
+  struct Block
+  {
+    uint8_t *data;  //!< page-aligned storage
+    uint32_t used;  //!< bytes filled
+    bool rotate;    //!< start a new file after this block
+  };
+
+  std::string m_filename;       //!< name of the first file
+  std::ios::openmode m_mode;    //!< mode used to open every file
+  Compression m_compression;    //!< compression method
+  void *m_compressor;           //!< z_stream or ZSTD_CStream, when compressing
+  std::vector<uint8_t> m_compressed; //!< compressor output buffer
+  uint32_t m_fileIndex;         //!< index of the current file in the sequence
+  std::vector<uint8_t> m_preamble; //!< data starting every file
+
+  uint64_t m_rotateBytes;       //!< size limit per file, 0 for none
+  int64_t m_rotateDuration;     //!< time span limit per file, 0 for none
+  uint64_t m_bytesInFile;       //!< bytes handed over for the current file
+  int64_t m_fileStart;          //!< first Boundary () timestamp of the current file
+  bool m_fileStartSet;          //!< m_fileStart is valid
+
+  std::ofstream m_file;         //!< underlying file
+  uint32_t m_bufferSize;        //!< size of each staging buffer
+  bool m_async;                 //!< true if a writer thread is used
+  bool m_closed;                //!< true once Close () has run
+  bool m_failed;                //!< sticky error flag (guarded by m_mutex)
+  Block m_current;              //!< buffer being filled by the caller
+  std::vector<uint8_t *> m_storage; //!< every allocated buffer
+
+  std::deque<Block> m_pending;  //!< full buffers waiting for the writer thread
+  std::deque<Block> m_free;     //!< empty buffers ready to be filled
+  bool m_writing;               //!< the writer thread holds a block
+  bool m_stop;                  //!< ask the writer thread to exit
+  mutable std::mutex m_mutex;   //!< protects the queues and flags above
+  std::condition_variable m_cond; //!< signals queue changes in either direction
+  std::thread m_thread;         //!< background writer
+};
+
+} // namespace ns3
+
+#endif /* BUFFERED_FILE_WRITER_H */
@@ -0,0 +1,272 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/hash.h"
+#include "ns3/simulator.h"
+#include "buffered-file-writer.h"
+#include "event-trace.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EventTrace");
+
+const uint32_t EventTraceFileHeader::MAGIC;
+const uint16_t EventTraceFileHeader::VERSION;
+
+/// Records moved from a ring per Pop () call of the collecting thread
+static const uint32_t DRAIN_BATCH = 256;
+
+uint32_t
+EventTraceRecord::FlowId (Ipv4Address a, uint16_t aPort,
+                          Ipv4Address b, uint16_t bPort, uint8_t protocol)
+{
+  uint32_t aAddr = a.Get ();
+  uint32_t bAddr = b.Get ();
+  if (aAddr > bAddr || (aAddr == bAddr && aPort > bPort))
+    {
+      std::swap (aAddr, bAddr);
+      std::swap (aPort, bPort);
+    }
+
+  uint8_t buf[13];
+  std::memcpy (buf, &aAddr, 4);
+  std::memcpy (buf + 4, &bAddr, 4);
+  std::memcpy (buf + 8, &aPort, 2);
+  std::memcpy (buf + 10, &bPort, 2);
+  buf[12] = protocol;
+  return Hash32 ((char*) buf, 13);
+}
+
+uint32_t
+EventTraceRecord::FlowId (Ipv6Address a, uint16_t aPort,
+                          Ipv6Address b, uint16_t bPort, uint8_t protocol)
+{
+  uint8_t aAddr[16];
+  uint8_t bAddr[16];
+  a.GetBytes (aAddr);
+  b.GetBytes (bAddr);
+  int cmp = std::memcmp (aAddr, bAddr, 16);
+  if (cmp > 0 || (cmp == 0 && aPort > bPort))
+    {
+      std::swap (aAddr, bAddr);
+      std::swap (aPort, bPort);
+    }
+
+  uint8_t buf[37];
+  std::memcpy (buf, aAddr, 16);
+  std::memcpy (buf + 16, bAddr, 16);
+  std::memcpy (buf + 32, &aPort, 2);
+  std::memcpy (buf + 34, &bPort, 2);
+  buf[36] = protocol;
+  return Hash32 ((char*) buf, 37);
+}
+
+EventTraceRing::EventTraceRing (uint32_t source, uint32_t capacity)
+  : m_source (source),
+    m_head (0),
+    m_tail (0),
+    m_dropped (0)
+{
+  NS_LOG_FUNCTION (this << source << capacity);
+  uint32_t size = 1;
+  while (size < capacity && size < (1U << 31))
+    {
+      size <<= 1;
+    }
+  m_records = new EventTraceRecord[size];
+  m_mask = size - 1;
+}
+
+EventTraceRing::~EventTraceRing ()
+{
+  NS_LOG_FUNCTION (this);
+  delete [] m_records;
+}
+
+void
+EventTraceRing::Record (EventTraceRecord::Origin origin, EventTraceRecord::Event event,
+                        uint32_t flowId, uint8_t ccState, uint32_t window,
+                        uint32_t seq, uint32_t ack)
+{
+  uint64_t head = m_head.load (std::memory_order_relaxed);
+  if (head - m_tail.load (std::memory_order_acquire) > m_mask)
+    {
+      m_dropped.fetch_add (1, std::memory_order_relaxed);
+      return;
+    }
+
+  EventTraceRecord &r = m_records[head & m_mask];
+  r.time = Simulator::Now ().GetNanoSeconds ();
+  r.source = m_source;
+  r.flowId = flowId;
+  r.event = event;
+  r.ccState = ccState;
+  r.origin = origin;
+  r.reserved = 0;
+  r.window = window;
+  r.seq = seq;
+  r.ack = ack;
+  m_head.store (head + 1, std::memory_order_release);
+}
+
+uint32_t
+EventTraceRing::Pop (EventTraceRecord *out, uint32_t max)
+{
+  uint64_t tail = m_tail.load (std::memory_order_relaxed);
+  uint64_t available = m_head.load (std::memory_order_acquire) - tail;
+  uint32_t n = available < max ? available : max;
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      out[i] = m_records[(tail + i) & m_mask];
+    }
+  m_tail.store (tail + n, std::memory_order_release);
+  return n;
+}
+
+uint32_t
+EventTraceRing::GetSource (void) const
+{
+  return m_source;
+}
+
+uint64_t
+EventTraceRing::GetDropped (void) const
+{
+  return m_dropped.load (std::memory_order_relaxed);
+}
+
+EventTraceSink::EventTraceSink ()
+  : m_writer (0),
+    m_stop (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+EventTraceSink::~EventTraceSink ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+}
+
+bool
+EventTraceSink::Open (std::string const &filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+  NS_ASSERT_MSG (m_writer == 0, "EventTraceSink::Open(): already open");
+
+  m_writer = new BufferedFileWriter (filename, std::ios::out);
+  if (m_writer->Fail ())
+    {
+      delete m_writer;
+      m_writer = 0;
+      return false;
+    }
+
+  EventTraceFileHeader header;
+  header.magic = EventTraceFileHeader::MAGIC;
+  header.version = EventTraceFileHeader::VERSION;
+  header.recordSize = sizeof (EventTraceRecord);
+  header.reserved = 0;
+  m_writer->Write ((uint8_t const *) &header, sizeof (header));
+
+  m_stop = false;
+  m_thread = std::thread (&EventTraceSink::CollectLoop, this);
+  return true;
+}
+
+Ptr<EventTraceRing>
+EventTraceSink::CreateRing (uint32_t source, uint32_t capacity)
+{
+  NS_LOG_FUNCTION (this << source << capacity);
+  Ptr<EventTraceRing> ring = Create<EventTraceRing> (source, capacity);
+  std::lock_guard<std::mutex> lock (m_mutex);
+  m_rings.push_back (ring);
+  return ring;
+}
+
+uint32_t
+EventTraceSink::Drain (void)
+{
+  EventTraceRecord batch[DRAIN_BATCH];
+  uint32_t total = 0;
+  std::lock_guard<std::mutex> lock (m_mutex);
+  for (std::vector<Ptr<EventTraceRing> >::const_iterator i = m_rings.begin (); i != m_rings.end (); ++i)
+    {
+      uint32_t n;
+      while ((n = (*i)->Pop (batch, DRAIN_BATCH)) > 0)
+        {
+          m_writer->Write ((uint8_t const *) batch, n * sizeof (EventTraceRecord));
+          total += n;
+        }
+    }
+  return total;
+}
+
+void
+EventTraceSink::CollectLoop (void)
+{
+  while (!m_stop.load (std::memory_order_acquire))
+    {
+      if (Drain () == 0)
+        {
+          std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+    }
+}
+
+void
+EventTraceSink::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_writer == 0)
+    {
+      return;
+    }
+  m_stop.store (true, std::memory_order_release);
+  if (m_thread.joinable ())
+    {
+      m_thread.join ();
+    }
+  Drain ();
+  uint64_t dropped = GetDropped ();
+  if (dropped > 0)
+    {
+      NS_LOG_WARN ("EventTraceSink::Close(): " << dropped << " records dropped on full rings");
+    }
+  m_writer->Close ();
+  delete m_writer;
+  m_writer = 0;
+}
+
+uint64_t
+EventTraceSink::GetDropped (void) const
+{
+  uint64_t dropped = 0;
+  std::lock_guard<std::mutex> lock (m_mutex);
+  for (std::vector<Ptr<EventTraceRing> >::const_iterator i = m_rings.begin (); i != m_rings.end (); ++i)
+    {
+      dropped += (*i)->GetDropped ();
+    }
+  return dropped;
+}
+
+} // namespace ns3
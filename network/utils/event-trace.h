@@ -0,0 +1,249 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <stdint.h>
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/ptr.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/ipv6-address.h"
+
+namespace ns3 {
+
+class BufferedFileWriter;
+
+/**
+ * \ingroup network
+ * \brief One fixed-size record of a binary event trace.
+ *
+ * Records are written to the trace file as is, in host byte order; the
+ * file header lets a reader detect a byte order mismatch.
+ */
+struct EventTraceRecord
+{
+  /**
+   * Kind of event.
+   */
+  enum Event
+  {
+    ENQ = 0,      /**< Packet queued by the sender */
+    DEQ = 1,      /**< Packet released from the sender queue */
+    SENT = 2,     /**< Packet put on the wire */
+    ACK = 3,      /**< Acknowledgment processed */
+    TIMEOUT = 4   /**< Retransmission timer expired */
+  };
+
+  /**
+   * State machine that produced the record, which gives the meaning of
+   * the ccState field.
+   */
+  enum Origin
+  {
+    COCOA = 0,    /**< PointToPointNetDevice::CCState */
+    TCP = 1       /**< TcpSocketState::TcpCongState_t */
+  };
+
+  int64_t time;       //!< simulation time in nanoseconds
+  uint32_t source;    //!< id of the ring the record went through
+  uint32_t flowId;    //!< direction-independent hash of the 5-tuple
+  uint8_t event;      //!< an Event
+  uint8_t ccState;    //!< congestion control state after the event
+  uint8_t origin;     //!< an Origin
+  uint8_t reserved;   //!< zero
+  uint32_t window;    //!< congestion window in bytes
+  uint32_t seq;       //!< sequence number of the packet, if any
+  uint32_t ack;       //!< acknowledgment number of the packet, if any
+
+  /**
+   * \brief Compute the flow id of a connection.
+   *
+   * The two endpoints are put in a canonical order first, so both
+   * directions of a connection (and both of its ends) share the id.
+   *
+   * \param a address of one endpoint
+   * \param aPort port of that endpoint
+   * \param b address of the other endpoint
+   * \param bPort port of the other endpoint
+   * \param protocol IP protocol number
+   * \return the flow id
+   */
+  static uint32_t FlowId (Ipv4Address a, uint16_t aPort,
+                          Ipv4Address b, uint16_t bPort, uint8_t protocol);
+  /**
+   * \copydoc FlowId(Ipv4Address,uint16_t,Ipv4Address,uint16_t,uint8_t)
+   */
+  static uint32_t FlowId (Ipv6Address a, uint16_t aPort,
+                          Ipv6Address b, uint16_t bPort, uint8_t protocol);
+};
+
+/**
+ * \ingroup network
+ * \brief Header at the start of a binary event trace file.
+ */
+struct EventTraceFileHeader
+{
+  static const uint32_t MAGIC = 0x54564543;   /**< "CEVT" as bytes, on a little-endian host */
+  static const uint16_t VERSION = 1;          /**< Current format version */
+
+  uint32_t magic;       //!< MAGIC, in the byte order of the records
+  uint16_t version;     //!< format version
+  uint16_t recordSize;  //!< sizeof (EventTraceRecord)
+  uint64_t reserved;    //!< zero
+};
+
+/**
+ * \ingroup network
+ * \brief A lock-free single-producer, single-consumer ring of event records.
+ *
+ * The simulation thread appends records with Record (), which never blocks
+ * and never allocates; the EventTraceSink that created the ring drains it
+ * from its own thread.  When the ring is full, records are dropped and
+ * counted rather than stalling the simulation.
+ *
+ * Each traced object (a device, a TCP stack) gets its own ring so that
+ * producers never contend with each other.
+ */
+class EventTraceRing : public SimpleRefCount<EventTraceRing>
+{
+public:
+  /**
+   * \param source id written in the source field of every record
+   * \param capacity number of records the ring can hold, rounded up to a
+   * power of two
+   */
+  EventTraceRing (uint32_t source, uint32_t capacity);
+  ~EventTraceRing ();
+
+  /**
+   * \brief Append a record stamped with the current simulation time.
+   *
+   * \param origin the state machine producing the record
+   * \param event the kind of event
+   * \param flowId the flow the event belongs to
+   * \param ccState congestion control state after the event
+   * \param window congestion window in bytes
+   * \param seq sequence number, if any
+   * \param ack acknowledgment number, if any
+   */
+  void Record (EventTraceRecord::Origin origin, EventTraceRecord::Event event,
+               uint32_t flowId, uint8_t ccState, uint32_t window,
+               uint32_t seq, uint32_t ack);
+
+  /**
+   * \brief Remove records from the ring (consumer side).
+   * \param out where to copy the records
+   * \param max maximum number of records to copy
+   * \return the number of records copied
+   */
+  uint32_t Pop (EventTraceRecord *out, uint32_t max);
+
+  /**
+   * \return the id written in the source field of the records
+   */
+  uint32_t GetSource (void) const;
+
+  /**
+   * \return the number of records dropped because the ring was full
+   */
+  uint64_t GetDropped (void) const;
+
+private:
+  EventTraceRecord *m_records;      //!< storage, m_mask + 1 records
+  uint32_t m_mask;                  //!< capacity - 1
+  uint32_t m_source;                //!< source id
+  std::atomic<uint64_t> m_head;     //!< next slot to write (producer)
+  std::atomic<uint64_t> m_tail;     //!< next slot to read (consumer)
+  std::atomic<uint64_t> m_dropped;  //!< records lost to a full ring
+};
+
+/**
+ * \ingroup network
+ * \brief Collects event records from a set of rings into a binary file.
+ *
+ * A background thread polls the rings created by CreateRing () and writes
+ * their records, in batches, after an EventTraceFileHeader.  Records of one
+ * ring appear in order; records of different rings are interleaved by
+ * batch, so readers that need a global order sort on the time field.
+ *
+ * The file is in the byte order of the host that writes it (see
+ * EventTraceRecord).  The event-trace-to-csv example converts such a file
+ * to CSV or to one binary file per column.
+ */
+class EventTraceSink : public SimpleRefCount<EventTraceSink>
+{
+public:
+  static const uint32_t RING_CAPACITY_DEFAULT = 1 << 16; /**< Default records per ring */
+
+  EventTraceSink ();
+  ~EventTraceSink ();
+
+  /**
+   * \brief Create the trace file and start the collecting thread.
+   * \param filename name of the file to create
+   * \return false if the file could not be created
+   */
+  bool Open (std::string const &filename);
+
+  /**
+   * \brief Create a ring drained into this sink.
+   * \param source id written in the source field of the ring's records
+   * \param capacity number of records the ring can hold
+   * \return the ring
+   */
+  Ptr<EventTraceRing> CreateRing (uint32_t source, uint32_t capacity = RING_CAPACITY_DEFAULT);
+
+  /**
+   * \brief Drain every ring, stop the thread and close the file.
+   *
+   * Call once the simulation has run; records produced afterwards are
+   * discarded.
+   */
+  void Close (void);
+
+  /**
+   * \return the number of records dropped so far by all rings
+   */
+  uint64_t GetDropped (void) const;
+
+private:
+  /**
+   * \brief Move every record currently in the rings to the file.
+   * \return the number of records moved
+   */
+  uint32_t Drain (void);
+  /**
+   * \brief Body of the collecting thread.
+   */
+  void CollectLoop (void);
+
+  std::vector<Ptr<EventTraceRing> > m_rings;  //!< rings drained into the file
+  mutable std::mutex m_mutex;                 //!< protects m_rings
+  BufferedFileWriter *m_writer;               //!< output file
+  std::atomic<bool> m_stop;                   //!< ask the thread to exit
+  std::thread m_thread;                       //!< collecting thread
+};
+
+} // namespace ns3
+
+#endif /* EVENT_TRACE_H */
@@ -0,0 +1,166 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LOG_EVENT_H
+#define LOG_EVENT_H
+
+#include <cstddef>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+
+#include "ns3/log.h"
+
+/**
+ * \file
+ * \ingroup logging
+ * Structured log messages with deferred formatting.
+ *
+ * Per-packet log statements on the device and TCP paths used to build
+ * their text eagerly, typically by calling a helper that returned a
+ * std::string.  NS_LOG_EVENT () instead captures an event name and a list
+ * of name/value fields by value in a LogEvent, which is only formatted
+ * when it is streamed to the log; if the level is not enabled, neither the
+ * fields nor the LogEvent are evaluated, and nothing is allocated.
+ *
+ * Values are printed with their operator<<, so cheap value types with a
+ * custom operator<< (rather than functions returning strings) keep the
+ * enabled case allocation-free as well.
+ */
+
+/**
+ * \ingroup logging
+ * \brief Log an event with name/value fields at the given level.
+ *
+ * \code
+ *   NS_LOG_EVENT (LOG_DEBUG, "PKT ENQ", "node", GetNode ()->GetId (), "qlen", st.queue.size ());
+ * \endcode
+ * prints "PKT ENQ node=2 qlen=5".
+ *
+ * \param level the log level
+ * \param name the event name, a string literal
+ * \param ... alternating field names (string literals) and values
+ */
+#define NS_LOG_EVENT(level, name, ...) \
+  NS_LOG (level, ::ns3::MakeLogEvent (name, __VA_ARGS__))
+
+#ifdef NS3_LOG_ENABLE
+/**
+ * \ingroup logging
+ * \brief Check whether the current log component prints at a level.
+ *
+ * Use it to skip work done only to feed a log statement, such as parsing
+ * headers that the code path does not otherwise need.  Always false when
+ * logging is compiled out.
+ *
+ * \param level the log level
+ */
+#define NS_LOG_EVENT_ENABLED(level) (g_log.IsEnabled (level))
+#else
+#define NS_LOG_EVENT_ENABLED(level) (false)
+#endif
+
+namespace ns3 {
+
+/**
+ * \ingroup logging
+ * \brief A log message whose fields are formatted only when printed.
+ *
+ * \tparam Args the types of the alternating field names and values
+ */
+template <typename... Args>
+class LogEvent
+{
+  static_assert (sizeof... (Args) % 2 == 0, "LogEvent fields come in name/value pairs");
+
+public:
+  /**
+   * \param name the event name
+   * \param args alternating field names and values, copied
+   */
+  LogEvent (const char *name, Args const &... args)
+    : m_name (name),
+      m_fields (args...)
+  {
+  }
+
+  /**
+   * \brief Print "name field=value field=value..."
+   * \param os the output stream
+   */
+  void Print (std::ostream &os) const
+  {
+    os << m_name;
+    PrintFields<0> (os);
+  }
+
+private:
+  /**
+   * \brief Print the field at index I and the following ones.
+   * \param os the output stream
+   */
+  template <std::size_t I>
+  typename std::enable_if<(I < sizeof... (Args))>::type
+  PrintFields (std::ostream &os) const
+  {
+    os << ' ' << std::get<I> (m_fields) << '=' << std::get<I + 1> (m_fields);
+    PrintFields<I + 2> (os);
+  }
+  /**
+   * \brief End of the field list.
+   */
+  template <std::size_t I>
+  typename std::enable_if<(I >= sizeof... (Args))>::type
+  PrintFields (std::ostream &) const
+  {
+  }
+
+  const char *m_name;          //!< event name
+  std::tuple<Args...> m_fields; //!< field names and values
+};
+
+/**
+ * \ingroup logging
+ * \brief Create a LogEvent, deducing the field types.
+ * \param name the event name
+ * \param args alternating field names and values
+ * \return the LogEvent
+ */
+template <typename... Args>
+LogEvent<typename std::decay<Args const>::type...>
+MakeLogEvent (const char *name, Args const &... args)
+{
+  return LogEvent<typename std::decay<Args const>::type...> (name, args...);
+}
+
+/**
+ * \ingroup logging
+ * \brief Stream a LogEvent.
+ * \param os the output stream
+ * \param event the event
+ * \return the output stream
+ */
+template <typename... Args>
+std::ostream &
+operator << (std::ostream &os, LogEvent<Args...> const &event)
+{
+  event.Print (os);
+  return os;
+}
+
+} // namespace ns3
+
+#endif /* LOG_EVENT_H */
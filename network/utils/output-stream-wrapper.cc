@@ -17,17 +17,77 @@
  */
 
 #include "output-stream-wrapper.h"
+#include "buffered-file-writer.h"
 #include "ns3/log.h"
 #include "ns3/fatal-impl.h"
 #include "ns3/abort.h"
+#include "ns3/simulator.h"
 #include <fstream>
+#include <streambuf>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("OutputStreamWrapper");
 
+/**
+ * \ingroup network
+ *
+ * A std::streambuf formatting into a small local area which is copied
+ * into a BufferedFileWriter when full or when the stream is flushed.
+ */
+class WriterStreamBuf : public std::streambuf
+{
+public:
+  /**
+   * Constructor
+   * \param writer the writer to send the output to
+   */
+  WriterStreamBuf (BufferedFileWriter *writer)
+    : m_writer (writer)
+  {
+    setp (m_area, m_area + sizeof (m_area));
+  }
+  virtual ~WriterStreamBuf ()
+  {
+    Drain ();
+  }
+
+protected:
+  virtual int_type overflow (int_type c)
+  {
+    Drain ();
+    if (!traits_type::eq_int_type (c, traits_type::eof ()))
+      {
+        *pptr () = traits_type::to_char_type (c);
+        pbump (1);
+      }
+    return traits_type::not_eof (c);
+  }
+  virtual int sync (void)
+  {
+    Drain ();
+    m_writer->Boundary (Simulator::Now ().GetNanoSeconds ());
+    return 0;
+  }
+
+private:
+  /**
+   * Copy the formatted characters to the writer.
+   */
+  void Drain (void)
+  {
+    m_writer->Write (reinterpret_cast<uint8_t const *> (pbase ()), pptr () - pbase ());
+    setp (m_area, m_area + sizeof (m_area));
+  }
+
+  BufferedFileWriter *m_writer; //!< where the output goes
+  char m_area[4096];            //!< formatting area
+};
+
 OutputStreamWrapper::OutputStreamWrapper (std::string filename, std::ios::openmode filemode)
-  : m_destroyable (true)
+  : m_streambuf (0),
+    m_writer (0),
+    m_destroyable (true)
 {
   NS_LOG_FUNCTION (this << filename << filemode);
   std::ofstream* os = new std::ofstream ();
@@ -39,19 +99,33 @@ OutputStreamWrapper::OutputStreamWrapper (std::string filename, std::ios::openmo
 }
 
 OutputStreamWrapper::OutputStreamWrapper (std::ostream* os)
-  : m_ostream (os), m_destroyable (false)
+  : m_ostream (os), m_streambuf (0), m_writer (0), m_destroyable (false)
 {
   NS_LOG_FUNCTION (this << os);
   FatalImpl::RegisterStream (m_ostream);
   NS_ABORT_MSG_UNLESS (m_ostream->good (), "Output stream is not vaild for writing.");
 }
 
+OutputStreamWrapper::OutputStreamWrapper (BufferedFileWriter *writer)
+  : m_writer (writer), m_destroyable (true)
+{
+  NS_LOG_FUNCTION (this << writer);
+  m_streambuf = new WriterStreamBuf (writer);
+  m_ostream = new std::ostream (m_streambuf);
+  FatalImpl::RegisterStream (m_ostream);
+}
+
 OutputStreamWrapper::~OutputStreamWrapper ()
 {
   NS_LOG_FUNCTION (this);
   FatalImpl::UnregisterStream (m_ostream);
   if (m_destroyable) delete m_ostream;
   m_ostream = 0;
+  // The stream buffer drains into the writer, so it goes first.
+  delete m_streambuf;
+  m_streambuf = 0;
+  delete m_writer;
+  m_writer = 0;
 }
 
 std::ostream *
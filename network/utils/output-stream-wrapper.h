@@ -26,6 +26,8 @@
 
 namespace ns3 {
 
+class BufferedFileWriter;
+
 /**
  * @brief A class encapsulating an output stream.
  *
@@ -81,6 +83,17 @@ public:
    * \param os output stream
    */
   OutputStreamWrapper (std::ostream* os);
+  /**
+   * Constructor
+   *
+   * The stream writes through the given BufferedFileWriter, which the
+   * wrapper takes ownership of.  Every flush of the stream (std::endl)
+   * marks a point where the writer may rotate to a new file, stamped with
+   * the current simulation time.
+   *
+   * \param writer the writer to send the output to
+   */
+  OutputStreamWrapper (BufferedFileWriter *writer);
   ~OutputStreamWrapper ();
 
   /**
@@ -94,6 +107,8 @@ public:
 
 private:
   std::ostream *m_ostream; //!< The output stream
+  std::streambuf *m_streambuf; //!< The stream buffer writing to m_writer
+  BufferedFileWriter *m_writer; //!< The buffered writer, if any
   bool m_destroyable; //!< Can be destroyed
 };
 
@@ -19,6 +19,7 @@
 #include "ns3/log.h"
 #include "ns3/boolean.h"
 #include "ns3/uinteger.h"
+#include "ns3/enum.h"
 #include "ns3/buffer.h"
 #include "ns3/header.h"
 #include "pcap-file-wrapper.h"
@@ -46,6 +47,38 @@ PcapFileWrapper::GetTypeId (void)
                    BooleanValue (false),
                    MakeBooleanAccessor (&PcapFileWrapper::m_nanosecMode),
                    MakeBooleanChecker())
+    .AddAttribute ("WriteBufferSize",
+                   "Size in bytes of the buffers used to batch records before "
+                   "writing them to disk, 0 to write every record through std::fstream.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PcapFileWrapper::m_writeBufferSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("AsyncFlush",
+                   "Whether full write buffers are written to disk by a background thread. "
+                   "Only used with buffered writes; always on with compression.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PcapFileWrapper::m_asyncFlush),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Compression",
+                   "Compression applied to the file; implies buffered writes, "
+                   "flushed by a background thread.",
+                   EnumValue (BufferedFileWriter::NONE),
+                   MakeEnumAccessor (&PcapFileWrapper::m_compression),
+                   MakeEnumChecker (BufferedFileWriter::NONE, "None",
+                                    BufferedFileWriter::GZIP, "Gzip",
+                                    BufferedFileWriter::ZSTD, "Zstd"))
+    .AddAttribute ("RotateSize",
+                   "Start a new file once the current one holds this many bytes "
+                   "(before compression), 0 to disable; implies buffered writes.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PcapFileWrapper::m_rotateSize),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("RotateInterval",
+                   "Start a new file once the packet timestamps in the current one "
+                   "span this interval, 0 to disable; implies buffered writes.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&PcapFileWrapper::m_rotateInterval),
+                   MakeTimeChecker ())
   ;
   return tid;
 }
@@ -89,10 +122,20 @@ PcapFileWrapper::Close (void)
   m_file.Close ();
 }
 
+void
+PcapFileWrapper::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_file.Flush ();
+}
+
 void
 PcapFileWrapper::Open (std::string const &filename, std::ios::openmode mode)
 {
   NS_LOG_FUNCTION (this << filename << mode);
+  m_file.SetWriteBuffer (m_writeBufferSize, m_asyncFlush);
+  m_file.SetCompression (m_compression);
+  m_file.SetRotation (m_rotateSize, m_rotateInterval.GetNanoSeconds ());
   m_file.Open (filename, mode);
 }
 
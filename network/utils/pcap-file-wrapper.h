@@ -82,6 +82,11 @@ public:
    */
   void Close (void);
 
+  /**
+   * Push any records still held in the write buffers to the file.
+   */
+  void Flush (void);
+
   /**
    * Initialize the pcap file associated with this wrapper.  This file must have
    * been previously opened with write permissions.
@@ -224,6 +229,11 @@ private:
   PcapFile m_file; //!< Pcap file
   uint32_t m_snapLen; //!< max length of saved packets
   bool     m_nanosecMode; //!< Timestamps in nanosecond mode
+  uint32_t m_writeBufferSize; //!< size of the write buffers, 0 if unbuffered
+  bool     m_asyncFlush; //!< write buffers from a background thread
+  BufferedFileWriter::Compression m_compression; //!< compression of the file
+  uint64_t m_rotateSize; //!< size limit of each file in a rotated sequence
+  Time     m_rotateInterval; //!< time span of each file in a rotated sequence
 };
 
 } // namespace ns3
@@ -20,6 +20,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 #include "ns3/assert.h"
 #include "ns3/packet.h"
 #include "ns3/fatal-error.h"
@@ -29,6 +30,12 @@
 #include "pcap-file.h"
 #include "ns3/log.h"
 #include "ns3/build-profile.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 //
 // This file is used as part of the ns-3 test framework, so please refrain from 
 // adding any ns-3 specific constructs such as Packet to this file.
@@ -50,16 +57,33 @@ const uint16_t VERSION_MINOR = 4;             /**< Minor version of supported pc
 PcapFile::PcapFile ()
   : m_file (),
     m_swapMode (false),
-    m_nanosecMode (false)
+    m_nanosecMode (false),
+    m_writeBufferSize (0),
+    m_asyncFlush (false),
+    m_compression (BufferedFileWriter::NONE),
+    m_rotateBytes (0),
+    m_rotateDuration (0),
+    m_writer (0),
+    m_spilling (false),
+    m_writerSync (this),
+    m_writerStream (&m_writerSync),
+    m_readAhead (0),
+    m_map (0),
+    m_mapSize (0),
+    m_mapPos (0),
+    m_adviseEnd (0),
+    m_releasedTo (0)
 {
   NS_LOG_FUNCTION (this);
   FatalImpl::RegisterStream (&m_file); 
+  FatalImpl::RegisterStream (&m_writerStream);
 }
 
 PcapFile::~PcapFile ()
 {
   NS_LOG_FUNCTION (this);
   FatalImpl::UnregisterStream (&m_file);
+  FatalImpl::UnregisterStream (&m_writerStream);
   Close ();
 }
 
@@ -68,12 +92,20 @@ bool
 PcapFile::Fail (void) const
 {
   NS_LOG_FUNCTION (this);
+  if (m_writer)
+    {
+      return m_writer->Fail ();
+    }
   return m_file.fail ();
 }
 bool 
 PcapFile::Eof (void) const
 {
   NS_LOG_FUNCTION (this);
+  if (m_writer)
+    {
+      return false;
+    }
   return m_file.eof ();
 }
 void 
@@ -88,9 +120,79 @@ void
 PcapFile::Close (void)
 {
   NS_LOG_FUNCTION (this);
+  UnmapFile ();
+  if (m_writer)
+    {
+      m_writer->Close ();
+      delete m_writer;
+      m_writer = 0;
+    }
   m_file.close ();
 }
 
+void
+PcapFile::SetWriteBuffer (uint32_t bufferSize, bool asyncFlush)
+{
+  NS_LOG_FUNCTION (this << bufferSize << asyncFlush);
+  NS_ASSERT_MSG (m_writer == 0, "PcapFile::SetWriteBuffer(): must be called before Open()");
+  m_writeBufferSize = bufferSize;
+  m_asyncFlush = asyncFlush;
+}
+
+void
+PcapFile::SetCompression (BufferedFileWriter::Compression compression)
+{
+  NS_LOG_FUNCTION (this << compression);
+  NS_ASSERT_MSG (m_writer == 0, "PcapFile::SetCompression(): must be called before Open()");
+  m_compression = compression;
+}
+
+void
+PcapFile::SetRotation (uint64_t maxBytes, int64_t maxDuration)
+{
+  NS_LOG_FUNCTION (this << maxBytes << maxDuration);
+  NS_ASSERT_MSG (m_writer == 0, "PcapFile::SetRotation(): must be called before Open()");
+  m_rotateBytes = maxBytes;
+  m_rotateDuration = maxDuration;
+}
+
+void
+PcapFile::SetReadMapping (uint64_t readAhead)
+{
+  NS_LOG_FUNCTION (this << readAhead);
+  NS_ASSERT_MSG (m_map == 0, "PcapFile::SetReadMapping(): must be called before Open()");
+  m_readAhead = readAhead;
+}
+
+PcapFile::WriterSync::WriterSync (PcapFile *pcap)
+  : m_pcap (pcap)
+{
+}
+
+int
+PcapFile::WriterSync::sync (void)
+{
+  if (m_pcap->m_writer)
+    {
+      m_pcap->m_writer->Flush ();
+    }
+  return 0;
+}
+
+void
+PcapFile::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_writer)
+    {
+      m_writer->Flush ();
+    }
+  else
+    {
+      m_file.flush ();
+    }
+}
+
 uint32_t
 PcapFile::GetMagic (void)
 {
@@ -206,7 +308,10 @@ PcapFile::WriteFileHeader (void)
   // If we're initializing the file, we need to write the pcap file header
   // at the start of the file.
   //
-  m_file.seekp (0, std::ios::beg);
+  if (m_writer == 0)
+    {
+      m_file.seekp (0, std::ios::beg);
+    }
  
   //
   // We have the ability to write out the pcap file header in a foreign endian
@@ -230,6 +335,25 @@ PcapFile::WriteFileHeader (void)
       headerOut = &header;
     }
 
+  if (m_writer)
+    {
+      //
+      // The buffered writer is only ever positioned at the end of a freshly
+      // created file, which is where the header goes.  It is registered as
+      // the preamble so that every rotated file starts with it too.
+      //
+      uint8_t buf[24];
+      std::memcpy (buf, &headerOut->m_magicNumber, 4);
+      std::memcpy (buf + 4, &headerOut->m_versionMajor, 2);
+      std::memcpy (buf + 6, &headerOut->m_versionMinor, 2);
+      std::memcpy (buf + 8, &headerOut->m_zone, 4);
+      std::memcpy (buf + 12, &headerOut->m_sigFigs, 4);
+      std::memcpy (buf + 16, &headerOut->m_snapLen, 4);
+      std::memcpy (buf + 20, &headerOut->m_type, 4);
+      m_writer->SetPreamble (buf, sizeof (buf));
+      return;
+    }
+
   //
   // Watch out for memory alignment differences between machines, so write
   // them all individually.
@@ -333,11 +457,26 @@ PcapFile::Open (std::string const &filename, std::ios::openmode mode)
   mode |= std::ios::binary;
 
   m_filename=filename;
+  bool buffered = m_writeBufferSize > 0 || m_compression != BufferedFileWriter::NONE
+    || m_rotateBytes > 0 || m_rotateDuration > 0;
+  if (buffered && (mode & std::ios::in) == 0)
+    {
+      uint32_t bufferSize = m_writeBufferSize > 0 ? m_writeBufferSize : BufferedFileWriter::BUFFER_SIZE_DEFAULT;
+      // Compression always runs on the writer thread, off the event loop
+      bool async = m_asyncFlush || m_compression != BufferedFileWriter::NONE;
+      m_writer = new BufferedFileWriter (filename, mode, bufferSize, async, m_compression);
+      m_writer->SetRotation (m_rotateBytes, m_rotateDuration);
+      return;
+    }
   m_file.open (filename.c_str (), mode);
   if (mode & std::ios::in)
     {
       // will set the fail bit if file header is invalid.
       ReadAndVerifyFileHeader ();
+      if (m_readAhead > 0 && !m_file.fail ())
+        {
+          MapFile ();
+        }
     }
 }
 
@@ -430,10 +569,82 @@ PcapFile::WritePacketHeader (uint32_t tsSec, uint32_t tsUsec, uint32_t totalLen)
   return inclLen;
 }
 
+uint8_t *
+PcapFile::ReserveRecord (uint32_t tsSec, uint32_t tsUsec, uint32_t totalLen, uint32_t &inclLen)
+{
+  NS_LOG_FUNCTION (this << tsSec << tsUsec << totalLen);
+  NS_ASSERT (m_writer != 0);
+
+  inclLen = totalLen > m_fileHeader.m_snapLen ? m_fileHeader.m_snapLen : totalLen;
+
+  PcapRecordHeader header;
+  header.m_tsSec = tsSec;
+  header.m_tsUsec = tsUsec;
+  header.m_inclLen = inclLen;
+  header.m_origLen = totalLen;
+
+  if (m_swapMode)
+    {
+      Swap (&header, &header);
+    }
+
+  //
+  // Records are the points where a rotated file may be split.
+  //
+  int64_t ns = int64_t (tsSec) * 1000000000 + (m_nanosecMode ? tsUsec : int64_t (tsUsec) * 1000);
+  m_writer->Boundary (ns);
+
+  const uint32_t headerSize = 4 * sizeof (uint32_t);
+  uint8_t *buf = m_writer->Reserve (headerSize + inclLen);
+  m_spilling = (buf == 0);
+  if (m_spilling)
+    {
+      //
+      // Record larger than a whole write buffer; build it on the side and
+      // let the writer copy it through.
+      //
+      m_spill.resize (headerSize + inclLen);
+      buf = &m_spill[0];
+    }
+
+  //
+  // Same field-by-field layout as WritePacketHeader, without assuming
+  // anything about the alignment of the buffer.
+  //
+  std::memcpy (buf, &header.m_tsSec, sizeof(header.m_tsSec));
+  std::memcpy (buf + 4, &header.m_tsUsec, sizeof(header.m_tsUsec));
+  std::memcpy (buf + 8, &header.m_inclLen, sizeof(header.m_inclLen));
+  std::memcpy (buf + 12, &header.m_origLen, sizeof(header.m_origLen));
+  return buf + headerSize;
+}
+
+void
+PcapFile::CommitRecord (uint32_t inclLen)
+{
+  const uint32_t headerSize = 4 * sizeof (uint32_t);
+  if (m_spilling)
+    {
+      m_writer->Write (&m_spill[0], headerSize + inclLen);
+      m_spilling = false;
+    }
+  else
+    {
+      m_writer->Commit (headerSize + inclLen);
+    }
+}
+
 void
 PcapFile::Write (uint32_t tsSec, uint32_t tsUsec, uint8_t const * const data, uint32_t totalLen)
 {
   NS_LOG_FUNCTION (this << tsSec << tsUsec << &data << totalLen);
+  if (m_writer)
+    {
+      uint32_t inclLen;
+      uint8_t *buf = ReserveRecord (tsSec, tsUsec, totalLen, inclLen);
+      std::memcpy (buf, data, inclLen);
+      CommitRecord (inclLen);
+      return;
+    }
   uint32_t inclLen = WritePacketHeader (tsSec, tsUsec, totalLen);
   m_file.write ((const char *)data, inclLen);
   NS_BUILD_DEBUG(m_file.flush());
@@ -443,6 +654,18 @@ void
 PcapFile::Write (uint32_t tsSec, uint32_t tsUsec, Ptr<const Packet> p)
 {
   NS_LOG_FUNCTION (this << tsSec << tsUsec << p);
+  if (m_writer)
+    {
+      //
+      // Copy only the captured part of the packet, straight into the
+      // write buffer.
+      //
+      uint32_t inclLen;
+      uint8_t *buf = ReserveRecord (tsSec, tsUsec, p->GetSize (), inclLen);
+      p->CopyData (buf, inclLen);
+      CommitRecord (inclLen);
+      return;
+    }
   uint32_t inclLen = WritePacketHeader (tsSec, tsUsec, p->GetSize ());
   p->CopyData (&m_file, inclLen);
   NS_BUILD_DEBUG(m_file.flush());
@@ -454,11 +677,23 @@ PcapFile::Write (uint32_t tsSec, uint32_t tsUsec, const Header &header, Ptr<cons
   NS_LOG_FUNCTION (this << tsSec << tsUsec << &header << p);
   uint32_t headerSize = header.GetSerializedSize ();
   uint32_t totalSize = headerSize + p->GetSize ();
-  uint32_t inclLen = WritePacketHeader (tsSec, tsUsec, totalSize);
 
   Buffer headerBuffer;
   headerBuffer.AddAtStart (headerSize);
   header.Serialize (headerBuffer.Begin ());
+
+  if (m_writer)
+    {
+      uint32_t inclLen;
+      uint8_t *buf = ReserveRecord (tsSec, tsUsec, totalSize, inclLen);
+      uint32_t toCopy = std::min (headerSize, inclLen);
+      headerBuffer.CopyData (buf, toCopy);
+      p->CopyData (buf + toCopy, inclLen - toCopy);
+      CommitRecord (inclLen);
+      return;
+    }
+
+  uint32_t inclLen = WritePacketHeader (tsSec, tsUsec, totalSize);
   uint32_t toCopy = std::min (headerSize, inclLen);
   headerBuffer.CopyData (&m_file, toCopy);
   inclLen -= toCopy;
@@ -478,6 +713,17 @@ PcapFile::Read (
   NS_LOG_FUNCTION (this << &data <<maxBytes << tsSec << tsUsec << inclLen << origLen << readLen);
   NS_ASSERT (m_file.good ());
 
+  if (m_map)
+    {
+      uint8_t const *record;
+      if (ReadNext (record, tsSec, tsUsec, inclLen, origLen))
+        {
+          readLen = maxBytes < inclLen ? maxBytes : inclLen;
+          std::memcpy (data, record, readLen);
+        }
+      return;
+    }
+
   PcapRecordHeader header;
 
   //
@@ -524,6 +770,150 @@ PcapFile::Read (
     }
 }
 
+bool
+PcapFile::ReadNext (
+  uint8_t const * &data,
+  uint32_t &tsSec,
+  uint32_t &tsUsec,
+  uint32_t &inclLen,
+  uint32_t &origLen)
+{
+  PcapRecordHeader header;
+
+  if (m_map)
+    {
+      if (m_mapSize - m_mapPos < sizeof (header))
+        {
+          m_file.setstate (std::ios::eofbit | std::ios::failbit);
+          return false;
+        }
+      std::memcpy (&header, m_map + m_mapPos, sizeof (header));
+      if (m_swapMode)
+        {
+          Swap (&header, &header);
+        }
+      if (header.m_inclLen > m_mapSize - m_mapPos - sizeof (header))
+        {
+          // Truncated record
+          m_file.setstate (std::ios::eofbit | std::ios::failbit);
+          return false;
+        }
+      data = m_map + m_mapPos + sizeof (header);
+      m_mapPos += sizeof (header) + header.m_inclLen;
+      AdviseReadAhead ();
+    }
+  else
+    {
+      if (!m_file.good ())
+        {
+          return false;
+        }
+      m_file.read ((char *)&header.m_tsSec, sizeof(header.m_tsSec));
+      m_file.read ((char *)&header.m_tsUsec, sizeof(header.m_tsUsec));
+      m_file.read ((char *)&header.m_inclLen, sizeof(header.m_inclLen));
+      m_file.read ((char *)&header.m_origLen, sizeof(header.m_origLen));
+      if (m_file.fail ())
+        {
+          return false;
+        }
+      if (m_swapMode)
+        {
+          Swap (&header, &header);
+        }
+      if (m_readBuffer.size () < header.m_inclLen)
+        {
+          m_readBuffer.resize (header.m_inclLen);
+        }
+      m_file.read ((char *)m_readBuffer.data (), header.m_inclLen);
+      if (m_file.fail ())
+        {
+          return false;
+        }
+      data = m_readBuffer.data ();
+    }
+
+  tsSec = header.m_tsSec;
+  tsUsec = header.m_tsUsec;
+  inclLen = header.m_inclLen;
+  origLen = header.m_origLen;
+  return true;
+}
+
+void
+PcapFile::MapFile (void)
+{
+  NS_LOG_FUNCTION (this);
+#ifdef HAVE_SYS_MMAN_H
+  int fd = open (m_filename.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      NS_LOG_WARN ("Cannot map " << m_filename << ", reading through std::fstream");
+      return;
+    }
+  struct stat st;
+  if (fstat (fd, &st) == 0 && st.st_size > (off_t) sizeof (PcapFileHeader))
+    {
+      void *map = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED)
+        {
+          m_map = static_cast<uint8_t *> (map);
+          m_mapSize = st.st_size;
+          m_mapPos = sizeof (PcapFileHeader);
+          m_adviseEnd = 0;
+          m_releasedTo = 0;
+          madvise (m_map, m_mapSize, MADV_SEQUENTIAL);
+          AdviseReadAhead ();
+        }
+    }
+  close (fd);
+#endif
+}
+
+void
+PcapFile::UnmapFile (void)
+{
+  NS_LOG_FUNCTION (this);
+#ifdef HAVE_SYS_MMAN_H
+  if (m_map)
+    {
+      munmap (m_map, m_mapSize);
+    }
+#endif
+  m_map = 0;
+  m_mapSize = 0;
+  m_mapPos = 0;
+}
+
+void
+PcapFile::AdviseReadAhead (void)
+{
+#ifdef HAVE_SYS_MMAN_H
+  static const uint64_t pageMask = sysconf (_SC_PAGESIZE) - 1;
+
+  //
+  // Ask for the next window once half of the current one has been read, so
+  // that the kernel reads ahead in large chunks rather than page by page.
+  //
+  if (m_adviseEnd < m_mapSize && m_mapPos + m_readAhead / 2 >= m_adviseEnd)
+    {
+      uint64_t end = std::min (m_mapSize, (m_mapPos + m_readAhead + pageMask) & ~pageMask);
+      madvise (m_map + m_adviseEnd, end - m_adviseEnd, MADV_WILLNEED);
+      m_adviseEnd = end;
+    }
+
+  //
+  // Drop what is well behind us, so that the resident part of the file
+  // stays around twice the read-ahead window whatever the file size.
+  //
+  if (m_mapPos > m_releasedTo + 2 * m_readAhead)
+    {
+      uint64_t end = (m_mapPos - m_readAhead) & ~pageMask;
+      madvise (m_map + m_releasedTo, end - m_releasedTo, MADV_DONTNEED);
+      m_releasedTo = end;
+    }
+#endif
+}
+
 bool
 PcapFile::Diff (std::string const & f1, std::string const & f2, 
                 uint32_t & sec, uint32_t & usec, uint32_t & packets,
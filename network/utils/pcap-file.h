@@ -23,8 +23,12 @@
 
 #include <string>
 #include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
 #include <stdint.h>
 #include "ns3/ptr.h"
+#include "buffered-file-writer.h"
 
 namespace ns3 {
 
@@ -85,6 +89,71 @@ public:
    */
   void Close (void);
 
+  /**
+   * \brief Select buffered writing for files subsequently opened for output.
+   *
+   * When enabled, records are serialized into large staging buffers (see
+   * BufferedFileWriter) instead of being pushed through std::fstream a few
+   * bytes at a time, and only the captured (snaplen) part of each packet is
+   * ever copied.  Must be called before Open (); files opened for reading
+   * are not affected.
+   *
+   * \param bufferSize size in bytes of each staging buffer, or 0 to write
+   * through std::fstream directly (the default).
+   * \param asyncFlush if true, full buffers are written to disk by a
+   * background thread.
+   */
+  void SetWriteBuffer (uint32_t bufferSize, bool asyncFlush = false);
+
+  /**
+   * \brief Compress files subsequently opened for output.
+   *
+   * Implies buffered writing (with the default buffer size if
+   * SetWriteBuffer () was not called), flushed by a background thread
+   * whatever the asyncFlush given to SetWriteBuffer (), so that the
+   * compression does not run on the simulation thread.  Must be called
+   * before Open ().
+   *
+   * \param compression the compression method
+   */
+  void SetCompression (BufferedFileWriter::Compression compression);
+
+  /**
+   * \brief Split files subsequently opened for output into a sequence.
+   *
+   * A new file, with its own pcap file header, is started before the next
+   * record once the current file holds maxBytes (uncompressed), or before
+   * the first record whose timestamp is maxDuration after the first record
+   * of the current file.
+   * See BufferedFileWriter::GetRotatedFilename () for the file names.
+   * Implies buffered writing.  Must be called before Open ().
+   *
+   * \param maxBytes size limit of each file, 0 for none
+   * \param maxDuration time span of each file in nanoseconds, 0 for none
+   */
+  void SetRotation (uint64_t maxBytes, int64_t maxDuration);
+
+  /**
+   * \brief Read files subsequently opened for input through a memory map.
+   *
+   * Records are then parsed in place instead of being copied out of
+   * std::fstream, and ReadNext () can hand them out without any copy.  The
+   * file is never read as a whole: the kernel is asked to read readAhead
+   * bytes ahead of the current record, and pages more than readAhead bytes
+   * behind it are released, so large captures can be streamed with bounded
+   * memory.  Falls back to std::fstream where mmap is not available.
+   * Must be called before Open ().
+   *
+   * \param readAhead size in bytes of the read-ahead window, or 0 to read
+   * through std::fstream (the default).
+   */
+  void SetReadMapping (uint64_t readAhead);
+
+  /**
+   * \brief Push any buffered records to the file.
+   */
+  void Flush (void);
+
   /**
    * Initialize the pcap file associated with this object.  This file must have
    * been previously opened with write permissions.
@@ -174,6 +243,28 @@ public:
              uint32_t &origLen, 
              uint32_t &readLen);
 
+  /**
+   * \brief Read the next packet without copying it, if possible
+   *
+   * When the file is mapped (see SetReadMapping ()) data points into the
+   * mapping; otherwise the record is read into an internal buffer.  Either
+   * way, data stays valid until the next call on this object.  At the end
+   * of the file, or on a truncated record, Fail () and Eof () become true.
+   *
+   * \param data       [out] Packet data, inclLen bytes
+   * \param tsSec      [out] Packet timestamp, seconds
+   * \param tsUsec     [out] Packet timestamp, microseconds (nanoseconds in
+   *                   nanosecond mode)
+   * \param inclLen    [out] Included length
+   * \param origLen    [out] Original length
+   * \return false if no record could be read
+   */
+  bool ReadNext (uint8_t const * &data,
+                 uint32_t &tsSec,
+                 uint32_t &tsUsec,
+                 uint32_t &inclLen,
+                 uint32_t &origLen);
+
   /**
    * \brief Get the swap mode of the file.
    *
@@ -361,16 +452,96 @@ private:
    */
   uint32_t WritePacketHeader (uint32_t tsSec, uint32_t tsUsec, uint32_t totalLen);
 
+  /**
+   * \brief Start a record in the write buffer
+   *
+   * Serializes the record header into the buffered writer and returns the
+   * place where the inclLen bytes of packet data must be copied.  Must be
+   * followed by CommitRecord ().
+   *
+   * \param tsSec Time stamp (seconds part)
+   * \param tsUsec Time stamp (microseconds part)
+   * \param totalLen total packet length
+   * \param inclLen [out] the length of the packet data to copy
+   * \returns where to copy the packet data
+   */
+  uint8_t * ReserveRecord (uint32_t tsSec, uint32_t tsUsec, uint32_t totalLen, uint32_t &inclLen);
+
+  /**
+   * \brief Finish a record started with ReserveRecord ()
+   *
+   * \param inclLen the length of the packet data copied
+   */
+  void CommitRecord (uint32_t inclLen);
+
   /**
    * \brief Read and verify a Pcap file header
    */
   void ReadAndVerifyFileHeader (void);
 
+  /**
+   * \brief Map the file opened for reading, after its header was verified
+   */
+  void MapFile (void);
+
+  /**
+   * \brief Unmap the file, if mapped
+   */
+  void UnmapFile (void);
+
+  /**
+   * \brief Move the read-ahead window along with the read position
+   */
+  void AdviseReadAhead (void);
+
+  /**
+   * \brief A stream buffer whose sync flushes the buffered writer
+   *
+   * FatalImpl flushes the streams registered with it on NS_FATAL_ERROR;
+   * an std::ostream over this buffer is registered so that the records
+   * held by m_writer are written then, as those of m_file are.
+   */
+  class WriterSync : public std::streambuf
+  {
+  public:
+    /**
+     * \param pcap the file whose writer is flushed
+     */
+    WriterSync (PcapFile *pcap);
+  protected:
+    /**
+     * \brief Flush the buffered writer, if any
+     * \return 0
+     */
+    virtual int sync (void);
+  private:
+    PcapFile *m_pcap; //!< the file whose writer is flushed
+  };
+
   std::string    m_filename;    //!< file name
   std::fstream   m_file;        //!< file stream
   PcapFileHeader m_fileHeader;  //!< file header
   bool m_swapMode;              //!< swap mode
   bool m_nanosecMode;           //!< nanosecond timestamp mode
+
+  uint32_t m_writeBufferSize;   //!< size of the write buffers, 0 if unbuffered
+  bool m_asyncFlush;            //!< flush write buffers from a background thread
+  BufferedFileWriter::Compression m_compression; //!< compression of written files
+  uint64_t m_rotateBytes;       //!< size limit of written files, 0 for none
+  int64_t m_rotateDuration;     //!< time span of written files in ns, 0 for none
+  BufferedFileWriter *m_writer; //!< buffered writer, when writing buffered
+  std::vector<uint8_t> m_spill; //!< scratch space for records larger than a write buffer
+  bool m_spilling;              //!< the current record is being built in m_spill
+  WriterSync m_writerSync;      //!< flushes m_writer on sync
+  std::ostream m_writerStream;  //!< stream over m_writerSync, registered with FatalImpl
+
+  uint64_t m_readAhead;         //!< read-ahead window of mapped reads, 0 if not mapped
+  uint8_t *m_map;               //!< mapping of the file being read, if any
+  uint64_t m_mapSize;           //!< size of the mapping
+  uint64_t m_mapPos;            //!< offset of the next record in the mapping
+  uint64_t m_adviseEnd;         //!< end of the range requested from the kernel so far
+  uint64_t m_releasedTo;        //!< pages before this offset have been released
+  std::vector<uint8_t> m_readBuffer; //!< record data for ReadNext () on unmapped files
 };
 
 } // namespace ns3
@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the cost of the per-packet CoCoA log statements.
+//
+// Each case runs the statement logged for every enqueued packet, with the
+// DEBUG level disabled and then enabled (printing to a discarding stream),
+// and reports the heap allocations and time per statement.  The old
+// statement, which built its text with an ostringstream before handing it
+// to the log macro, is included for comparison.
+//
+// The program fails if a disabled statement allocates.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/log-event.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("CoCoALogBenchmark");
+
+static uint64_t g_allocations = 0; //!< operator new calls so far
+
+void *
+operator new (std::size_t size)
+{
+  ++g_allocations;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+/**
+ * \brief A stream buffer that discards its output.
+ */
+class NullBuffer : public std::streambuf
+{
+protected:
+  virtual int overflow (int c)
+  {
+    return c;
+  }
+};
+
+/**
+ * \brief The formatter the CoCoA code used before CoCoAFiveTuple.
+ * \param ipv4 the IPv4 header
+ * \param tcp the TCP header
+ * \return the formatted 5-tuple
+ */
+static std::string
+LegacyFiveTupleStr (const Ipv4Header &ipv4, const TcpHeader &tcp)
+{
+  std::ostringstream res;
+  res << ipv4.GetIdentification () << " " << tcp.GetSequenceNumber ().GetValue () << " "
+      << tcp.GetAckNumber ().GetValue () << " "
+      << "(" << ipv4.GetSource () << " " << tcp.GetSourcePort () << " " << ipv4.GetDestination ()
+      << " " << tcp.GetDestinationPort () << " " << (int)ipv4.GetProtocol () << ")";
+  return res.str ();
+}
+
+/**
+ * \brief Run a statement and report its cost.
+ * \param name name of the case
+ * \param iterations number of times to run the statement
+ * \param statement the statement
+ * \return the number of allocations per iteration
+ */
+template <typename F>
+static double
+Measure (std::string const &name, uint32_t iterations, F statement)
+{
+  uint64_t allocations = g_allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t i = 0; i < iterations; ++i)
+    {
+      statement (i);
+    }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now ();
+  double perIteration = double (g_allocations - allocations) / iterations;
+  double ns = std::chrono::duration<double, std::nano> (end - start).count () / iterations;
+  std::cout << std::left << std::setw (32) << name
+            << std::right << std::setw (10) << std::fixed << std::setprecision (2) << perIteration << " allocs"
+            << std::setw (12) << ns << " ns" << std::endl;
+  return perIteration;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t iterations = 1000000;
+
+  CommandLine cmd;
+  cmd.AddValue ("iterations", "Number of log statements per case", iterations);
+  cmd.Parse (argc, argv);
+
+  Ipv4Header ipv4;
+  ipv4.SetSource (Ipv4Address ("10.1.1.1"));
+  ipv4.SetDestination (Ipv4Address ("10.1.1.2"));
+  ipv4.SetProtocol (6);
+  ipv4.SetPayloadSize (20 + 536);
+  ipv4.SetIdentification (42);
+  TcpHeader tcp;
+  tcp.SetSourcePort (49153);
+  tcp.SetDestinationPort (50000);
+  tcp.SetAckNumber (SequenceNumber32 (1));
+  uint32_t node = 2;
+  uint32_t qlen = 5;
+
+  NullBuffer nullBuffer;
+  std::streambuf *clogBuffer = std::clog.rdbuf (&nullBuffer);
+
+  double disabled = 0;
+  for (uint32_t enabled = 0; enabled < 2; ++enabled)
+    {
+      if (enabled)
+        {
+          LogComponentEnable ("CoCoALogBenchmark", LOG_LEVEL_DEBUG);
+        }
+      std::string suffix = enabled ? " (enabled)" : " (disabled)";
+
+      Measure ("legacy ostringstream" + suffix, iterations, [&] (uint32_t i)
+      {
+        tcp.SetSequenceNumber (SequenceNumber32 (i));
+        NS_LOG_DEBUG (node << " SEND| PKT ENQ: " << LegacyFiveTupleStr (ipv4, tcp)
+                           << " - Queue Length: " << qlen);
+      });
+      double allocs = Measure ("CoCoAFiveTuple" + suffix, iterations, [&] (uint32_t i)
+      {
+        tcp.SetSequenceNumber (SequenceNumber32 (i));
+        NS_LOG_DEBUG (node << " SEND| PKT ENQ: " << CoCoAFiveTuple (ipv4, tcp, false)
+                           << " - Queue Length: " << qlen);
+      });
+      allocs += Measure ("NS_LOG_EVENT" + suffix, iterations, [&] (uint32_t i)
+      {
+        tcp.SetSequenceNumber (SequenceNumber32 (i));
+        NS_LOG_EVENT (LOG_DEBUG, "PKT ENQ", "node", node,
+                      "flow", CoCoAFiveTuple (ipv4, tcp, false), "qlen", qlen);
+      });
+      if (!enabled)
+        {
+          disabled = allocs;
+        }
+    }
+
+  std::clog.rdbuf (clogBuffer);
+  LogComponentDisable ("CoCoALogBenchmark", LOG_LEVEL_DEBUG);
+
+  if (disabled != 0)
+    {
+      std::cerr << "disabled log statements allocate" << std::endl;
+      return 1;
+    }
+  return 0;
+}
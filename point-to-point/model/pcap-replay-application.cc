@@ -0,0 +1,291 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/simulator.h"
+#include "ns3/packet.h"
+#include "ns3/node.h"
+#include "ns3/string.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/trace-helper.h"
+#include "point-to-point-net-device.h"
+#include "pcap-replay-application.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("PcapReplayApplication");
+
+NS_OBJECT_ENSURE_REGISTERED (PcapReplayApplication);
+
+/// EtherType of IPv4
+static const uint16_t ETHERTYPE_IPV4 = 0x0800;
+/// EtherType of IPv6
+static const uint16_t ETHERTYPE_IPV6 = 0x86DD;
+/// EtherType of an 802.1Q tag
+static const uint16_t ETHERTYPE_VLAN = 0x8100;
+/// Linktype of raw IPv4 captures
+static const uint32_t LINKTYPE_IPV4 = 228;
+/// Linktype of raw IPv6 captures
+static const uint32_t LINKTYPE_IPV6 = 229;
+
+TypeId
+PcapReplayApplication::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PcapReplayApplication")
+    .SetParent<Application> ()
+    .SetGroupName ("PointToPoint")
+    .AddConstructor<PcapReplayApplication> ()
+    .AddAttribute ("Filename",
+                   "The pcap file to replay.",
+                   StringValue (""),
+                   MakeStringAccessor (&PcapReplayApplication::m_filename),
+                   MakeStringChecker ())
+    .AddAttribute ("TimeScale",
+                   "Factor applied to the time between captured packets "
+                   "(0 sends them all at once).",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&PcapReplayApplication::m_timeScale),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("ReadAhead",
+                   "Bytes of the file read ahead of the packet being sent.",
+                   UintegerValue (4 << 20),
+                   MakeUintegerAccessor (&PcapReplayApplication::m_readAhead),
+                   MakeUintegerChecker<uint64_t> (1))
+    .AddAttribute ("MaxPackets",
+                   "The maximum number of packets to send (zero means the whole file).",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&PcapReplayApplication::m_maxPackets),
+                   MakeUintegerChecker<uint64_t> ())
+    .AddTraceSource ("Tx", "A packet has been sent",
+                     MakeTraceSourceAccessor (&PcapReplayApplication::m_txTrace),
+                     "ns3::Packet::TracedCallback")
+  ;
+  return tid;
+}
+
+PcapReplayApplication::PcapReplayApplication ()
+  : m_timeScale (1.0),
+    m_readAhead (4 << 20),
+    m_maxPackets (0),
+    m_linkType (0),
+    m_nanosecMode (false),
+    m_nextData (0),
+    m_nextInclLen (0),
+    m_nextOrigLen (0),
+    m_nextTime (0),
+    m_firstTime (0),
+    m_sent (0),
+    m_skipped (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+PcapReplayApplication::~PcapReplayApplication ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+PcapReplayApplication::SetDevice (Ptr<NetDevice> device)
+{
+  NS_LOG_FUNCTION (this << device);
+  m_device = device;
+}
+
+uint64_t
+PcapReplayApplication::GetSent (void) const
+{
+  return m_sent;
+}
+
+uint64_t
+PcapReplayApplication::GetSkipped (void) const
+{
+  return m_skipped;
+}
+
+void
+PcapReplayApplication::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_file.Close ();
+  m_device = 0;
+  Application::DoDispose ();
+}
+
+void
+PcapReplayApplication::StartApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_device == 0)
+    {
+      for (uint32_t i = 0; i < GetNode ()->GetNDevices (); ++i)
+        {
+          Ptr<NetDevice> device = GetNode ()->GetDevice (i);
+          if (device->GetObject<PointToPointNetDevice> ())
+            {
+              m_device = device;
+              break;
+            }
+        }
+      NS_ABORT_MSG_IF (m_device == 0, "PcapReplayApplication: node " << GetNode ()->GetId ()
+                                      << " has no PointToPointNetDevice");
+    }
+
+  m_file.SetReadMapping (m_readAhead);
+  m_file.Open (m_filename, std::ios::in);
+  NS_ABORT_MSG_IF (m_file.Fail (), "PcapReplayApplication: cannot read " << m_filename);
+  m_linkType = m_file.GetDataLinkType ();
+  m_nanosecMode = m_file.IsNanoSecMode ();
+
+  if (ReadNext ())
+    {
+      m_firstTime = m_nextTime;
+      m_startTime = Simulator::Now ();
+      m_sendEvent = Simulator::ScheduleNow (&PcapReplayApplication::SendDue, this);
+    }
+}
+
+void
+PcapReplayApplication::StopApplication (void)
+{
+  NS_LOG_FUNCTION (this);
+  Simulator::Cancel (m_sendEvent);
+  m_file.Close ();
+}
+
+bool
+PcapReplayApplication::ReadNext (void)
+{
+  if (m_maxPackets > 0 && m_sent >= m_maxPackets)
+    {
+      return false;
+    }
+  uint32_t tsSec, tsFrac;
+  if (!m_file.ReadNext (m_nextData, tsSec, tsFrac, m_nextInclLen, m_nextOrigLen))
+    {
+      return false;
+    }
+  m_nextTime = int64_t (tsSec) * 1000000000 + (m_nanosecMode ? tsFrac : int64_t (tsFrac) * 1000);
+  return true;
+}
+
+void
+PcapReplayApplication::SendDue (void)
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  Time due;
+
+  do
+    {
+      uint8_t const *data = m_nextData;
+      uint32_t size = m_nextInclLen;
+      uint16_t protocol;
+      if (StripLinkHeader (data, size, protocol))
+        {
+          Ptr<Packet> p = Create<Packet> (data, size);
+          uint32_t linkHeader = m_nextInclLen - size;
+          if (m_nextOrigLen > m_nextInclLen)
+            {
+              p->AddPaddingAtEnd (m_nextOrigLen - m_nextInclLen);
+            }
+          NS_LOG_LOGIC ("Replaying " << p->GetSize () << " bytes (link header " << linkHeader << ")");
+          m_txTrace (p);
+          m_device->Send (p, m_device->GetBroadcast (), protocol);
+          ++m_sent;
+        }
+      else
+        {
+          ++m_skipped;
+        }
+
+      if (!ReadNext ())
+        {
+          NS_LOG_INFO ("Replay of " << m_filename << " done: " << m_sent << " packets sent, "
+                       << m_skipped << " skipped");
+          return;
+        }
+      due = m_startTime + NanoSeconds (int64_t ((m_nextTime - m_firstTime) * m_timeScale));
+    }
+  while (due <= now);
+
+  m_sendEvent = Simulator::Schedule (due - now, &PcapReplayApplication::SendDue, this);
+}
+
+bool
+PcapReplayApplication::StripLinkHeader (uint8_t const * &data, uint32_t &size, uint16_t &protocol) const
+{
+  uint32_t skip = 0;
+  switch (m_linkType)
+    {
+    case PcapHelper::DLT_PPP:
+      {
+        if (size < 2)
+          {
+            return false;
+          }
+        uint16_t ppp = (data[0] << 8) | data[1];
+        protocol = ppp == 0x0021 ? ETHERTYPE_IPV4 : ppp == 0x0057 ? ETHERTYPE_IPV6 : 0;
+        skip = 2;
+        break;
+      }
+    case PcapHelper::DLT_EN10MB:
+      {
+        if (size < 14)
+          {
+            return false;
+          }
+        protocol = (data[12] << 8) | data[13];
+        skip = 14;
+        if (protocol == ETHERTYPE_VLAN && size >= 18)
+          {
+            protocol = (data[16] << 8) | data[17];
+            skip = 18;
+          }
+        break;
+      }
+    case PcapHelper::DLT_RAW:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+      {
+        if (size < 1)
+          {
+            return false;
+          }
+        uint8_t version = data[0] >> 4;
+        protocol = version == 4 ? ETHERTYPE_IPV4 : version == 6 ? ETHERTYPE_IPV6 : 0;
+        break;
+      }
+    default:
+      protocol = 0;
+      break;
+    }
+
+  if (protocol != ETHERTYPE_IPV4 && protocol != ETHERTYPE_IPV6)
+    {
+      return false;
+    }
+  data += skip;
+  size -= skip;
+  return true;
+}
+
+} // namespace ns3
@@ -0,0 +1,137 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef PCAP_REPLAY_APPLICATION_H
+#define PCAP_REPLAY_APPLICATION_H
+
+#include <string>
+
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/traced-callback.h"
+#include "ns3/pcap-file.h"
+
+namespace ns3 {
+
+class NetDevice;
+class Packet;
+
+/**
+ * \ingroup point-to-point
+ * \brief Replays the packets of a pcap file through a device of the node.
+ *
+ * Records are read one at a time from the file, which is memory mapped
+ * with a bounded read-ahead window (see PcapFile::SetReadMapping ()), so
+ * captures much larger than memory can be replayed.  Each packet is handed
+ * to the device's Send () at its capture time relative to the first record,
+ * multiplied by TimeScale, so it goes through the device exactly as traffic
+ * from the node's own stack would (including the CoCoA logic of a
+ * PointToPointNetDevice).  Packets captured at the same instant are sent
+ * from a single event.
+ *
+ * The link-layer header of each record is removed according to the data
+ * link type of the file (PPP, Ethernet or raw IP); records of other
+ * network protocols than IPv4 and IPv6 are skipped.  Records truncated by
+ * the capture's snap length are padded back to their original length.
+ *
+ * The device is the one given to SetDevice () or, by default, the first
+ * PointToPointNetDevice of the node.
+ */
+class PcapReplayApplication : public Application
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  PcapReplayApplication ();
+  virtual ~PcapReplayApplication ();
+
+  /**
+   * \brief Set the device the packets are sent through
+   * \param device the device
+   */
+  void SetDevice (Ptr<NetDevice> device);
+
+  /**
+   * \return the number of packets sent so far
+   */
+  uint64_t GetSent (void) const;
+
+  /**
+   * \return the number of records skipped so far
+   */
+  uint64_t GetSkipped (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  /**
+   * \brief Read the next record of the file into m_next*
+   * \return false at the end of the file or of MaxPackets
+   */
+  bool ReadNext (void);
+
+  /**
+   * \brief Send every record due now and schedule the next one
+   */
+  void SendDue (void);
+
+  /**
+   * \brief Strip the link-layer header of the record read last
+   * \param data [in,out] start of the record, moved past the link header
+   * \param size [in,out] size of the record, reduced accordingly
+   * \param protocol [out] EtherType of the network protocol
+   * \return false if the record does not carry IPv4 or IPv6
+   */
+  bool StripLinkHeader (uint8_t const * &data, uint32_t &size, uint16_t &protocol) const;
+
+  std::string m_filename;       //!< file to replay
+  double m_timeScale;           //!< factor applied to the captured inter-packet times
+  uint64_t m_readAhead;         //!< read-ahead window of the file mapping
+  uint64_t m_maxPackets;        //!< stop after this many packets, 0 for no limit
+
+  PcapFile m_file;              //!< the file being replayed
+  uint32_t m_linkType;          //!< data link type of the file
+  bool m_nanosecMode;           //!< timestamps are in nanoseconds
+  Ptr<NetDevice> m_device;      //!< device the packets are sent through
+  EventId m_sendEvent;          //!< next SendDue () event
+
+  uint8_t const *m_nextData;    //!< data of the next record
+  uint32_t m_nextInclLen;       //!< captured length of the next record
+  uint32_t m_nextOrigLen;       //!< original length of the next record
+  int64_t m_nextTime;           //!< capture time of the next record in ns
+  int64_t m_firstTime;          //!< capture time of the first record in ns
+  Time m_startTime;             //!< simulation time of the first record
+
+  uint64_t m_sent;              //!< packets sent
+  uint64_t m_skipped;           //!< records not sent
+
+  /// Traced callback: packet sent
+  TracedCallback<Ptr<const Packet> > m_txTrace;
+};
+
+} // namespace ns3
+
+#endif /* PCAP_REPLAY_APPLICATION_H */
@@ -17,6 +17,7 @@
  */
 
 #include "ns3/log.h"
+#include "ns3/log-event.h"
 #include "ns3/queue.h"
 #include "ns3/simulator.h"
 #include "ns3/mac48-address.h"
@@ -25,13 +26,14 @@
 #include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
 #include "ns3/pointer.h"
+#include "ns3/boolean.h"
+#include "ns3/tcp-gso.h"
+#include "ns3/tcp-option-ts.h"
 #include "ns3/net-device-queue-interface.h"
 #include "point-to-point-net-device.h"
 #include "point-to-point-channel.h"
 #include "ppp-header.h"
 
-#include <sstream>
-
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("PointToPointNetDevice");
@@ -70,6 +72,24 @@ PointToPointNetDevice::GetTypeId (void)
                    TimeValue (Seconds (0.0)),
                    MakeTimeAccessor (&PointToPointNetDevice::m_tInterframeGap),
                    MakeTimeChecker ())
+    .AddAttribute ("Gso",
+                   "Accept TCP super-segments larger than the MTU, and cut them "
+                   "in segments when they are transmitted",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PointToPointNetDevice::m_gso),
+                   MakeBooleanChecker ())
+    .AddAttribute ("Gro",
+                   "Merge the in-order TCP segments of a flow received "
+                   "back to back before passing them up the stack",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&PointToPointNetDevice::m_gro),
+                   MakeBooleanChecker ())
+    .AddAttribute ("GroTimeout",
+                   "The longest time a received segment is held back to be "
+                   "merged (0 merges the segments received at the same time)",
+                   TimeValue (Seconds (0.0)),
+                   MakeTimeAccessor (&PointToPointNetDevice::m_groTimeout),
+                   MakeTimeChecker ())
 
     //COCOA
     .AddAttribute ("CCLatency",
@@ -187,7 +207,9 @@ PointToPointNetDevice::PointToPointNetDevice ()
     m_txMachineState (READY),
     m_channel (0),
     m_linkUp (false),
-    m_currentPkt (0)
+    m_currentPkt (0),
+    m_gso (false),
+    m_gro (false)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -258,8 +280,12 @@ PointToPointNetDevice::DoDispose ()
   m_channel = 0;
   m_receiveErrorModel = 0;
   m_currentPkt = 0;
+  m_gsoSegments.clear ();
+  m_groEntries.clear ();
+  m_groFlushEvent.Cancel ();
   m_queue = 0;
   m_queueInterface = 0;
+  m_eventTrace = 0;
   NetDevice::DoDispose ();
 }
 
@@ -289,6 +315,11 @@ PointToPointNetDevice::TransmitStart (Ptr<Packet> p)
   // schedule an event that will be executed when the transmission is complete.
   //
   NS_ASSERT_MSG (m_txMachineState == READY, "Must be READY to transmit");
+  TcpGsoTag gsoTag;
+  if (p->PeekPacketTag (gsoTag))
+    {
+      p = CutSuperSegment (p, gsoTag.GetSegmentSize ());
+    }
   m_txMachineState = BUSY;
   m_currentPkt = p;
   m_phyTxBeginTrace (m_currentPkt);
@@ -307,6 +338,31 @@ PointToPointNetDevice::TransmitStart (Ptr<Packet> p)
   return result;
 }
 
+Ptr<Packet>
+PointToPointNetDevice::CutSuperSegment (Ptr<Packet> p, uint16_t segmentSize)
+{
+  NS_LOG_FUNCTION (this << p << segmentSize);
+  Ptr<Packet> packet = p->Copy ();
+  PppHeader ppp;
+  packet->RemoveHeader (ppp);
+  Ipv4Header ipv4;
+  packet->RemoveHeader (ipv4);
+
+  std::list<TcpGso::Ipv4PayloadHeaderPair> segments;
+  TcpGso::Cut (packet, ipv4, segmentSize, segments);
+  for (std::list<TcpGso::Ipv4PayloadHeaderPair>::iterator it = segments.begin (); it != segments.end (); it++)
+    {
+      it->first->AddHeader (it->second);
+      it->first->AddHeader (ppp);
+      m_gsoSegments.push_back (it->first);
+    }
+  NS_LOG_LOGIC ("Cut super-segment in " << m_gsoSegments.size () << " segments");
+
+  Ptr<Packet> segment = m_gsoSegments.front ();
+  m_gsoSegments.pop_front ();
+  return segment;
+}
+
 void
 PointToPointNetDevice::TransmitComplete (void)
 {
@@ -358,7 +414,8 @@ PointToPointNetDevice::TransmitComplete (void)
       NS_LOG_DEBUG(GetNode()->GetId() << " ERRRRRRRRRRRRRRRRR1!");
     }
   }
-  else{
+  else if (NS_LOG_EVENT_ENABLED (LOG_DEBUG)){
+    // The headers are only parsed for the log message
     PppHeader phdr;
     m_currentPkt->RemoveHeader(phdr);
     Ipv4Header ipv4;
@@ -368,12 +425,21 @@ PointToPointNetDevice::TransmitComplete (void)
     m_currentPkt->AddHeader(ipv4);
     m_currentPkt->AddHeader(phdr);
 
-    NS_LOG_DEBUG(GetNode()->GetId() << " SEND| PKT SENT: " << five_tuple_str(ipv4, tcp, false));
+    NS_LOG_DEBUG(GetNode()->GetId() << " SEND| PKT SENT: " << CoCoAFiveTuple(ipv4, tcp, false));
   }
   // CoCoA End
   
   m_currentPkt = 0;
 
+  if (!m_gsoSegments.empty ())
+    {
+      // The rest of the super-segment goes before the next packet
+      Ptr<Packet> segment = m_gsoSegments.front ();
+      m_gsoSegments.pop_front ();
+      TransmitStart (segment);
+      return;
+    }
+
   Ptr<Packet> p = m_queue->Dequeue ();
   if (p == 0)
     {
@@ -421,6 +487,13 @@ PointToPointNetDevice::SetReceiveErrorModel (Ptr<ErrorModel> em)
   m_receiveErrorModel = em;
 }
 
+void
+PointToPointNetDevice::SetEventTrace (Ptr<EventTraceRing> ring)
+{
+  NS_LOG_FUNCTION (this << ring);
+  m_eventTrace = ring;
+}
+
 void
 PointToPointNetDevice::Receive (Ptr<Packet> packet)
 {
@@ -461,13 +534,17 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
       ProcessHeader (packet, protocol);
 
       // CoCoA Start
+      // Non-CoCoA nodes only parse the headers for the log message.
+      bool cocoa = GetNode()->GetId() > 1;
       Ipv4Header ipv4;
-      packet->RemoveHeader(ipv4);
       TcpHeader tcp;
-      packet->PeekHeader(tcp);
-      packet->AddHeader(ipv4);
+      if (cocoa || NS_LOG_EVENT_ENABLED (LOG_DEBUG)){
+        packet->RemoveHeader(ipv4);
+        packet->PeekHeader(tcp);
+        packet->AddHeader(ipv4);
+      }
       
-      if (GetNode()->GetId() > 1){
+      if (cocoa){
         typedef std::tuple<Ipv4Address, uint16_t, Ipv4Address, uint16_t, uint8_t> fid_t;
         
         // Compute FID. Assuming that all packets going out are from
@@ -482,9 +559,12 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
         // Check if new flow
         std::map<fid_t, FlowState>::iterator fit = flow_info.find(fid);
         if (fit == flow_info.end()){
-          NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| NEW FLOW: " << five_tuple_str(ipv4, tcp, true));
+          NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| NEW FLOW: " << CoCoAFiveTuple(ipv4, tcp, true));
           FlowState s;
           RenoInit(s);
+          s.trace_flow_id = EventTraceRecord::FlowId(ipv4.GetSource(), tcp.GetSourcePort(),
+                                                     ipv4.GetDestination(), tcp.GetDestinationPort(),
+                                                     ipv4.GetProtocol());
           flow_info[fid] = s;
           fit = flow_info.find(fid);
         }
@@ -497,7 +577,7 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
                 uint8_t flags = tcp.GetFlags();
                 if ((flags & TcpHeader::SYN) > 0 &&
                     (flags & !(TcpHeader::SYN)) == 0){
-                  NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| SYN: " << five_tuple_str(ipv4, tcp, true));
+                  NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| SYN: " << CoCoAFiveTuple(ipv4, tcp, true));
                   st.setup_state = SYN;
                   st.initiator = false;
                 }
@@ -509,7 +589,7 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
                     (flags & TcpHeader::SYN) > 0 &&
                     (flags & TcpHeader::ACK) > 0 &&
                     (flags & !(TcpHeader::SYN) & !(TcpHeader::ACK)) == 0){
-                  NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| SYN ACK: " << five_tuple_str(ipv4, tcp, true));
+                  NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| SYN ACK: " << CoCoAFiveTuple(ipv4, tcp, true));
                   st.setup_state = SYN_ACK;
                   CoCoAEventHandler(packet, ipv4, tcp, st, ACK_RCVD);
 
@@ -521,7 +601,7 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
                 if (!st.initiator &&
                     (flags & TcpHeader::ACK) > 0 &&
                     (flags & !(TcpHeader::ACK)) == 0){
-                  NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| HANDSHAKE ACK: " << five_tuple_str(ipv4, tcp, true));
+                  NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| HANDSHAKE ACK: " << CoCoAFiveTuple(ipv4, tcp, true));
                   st.setup_state = ACK;
                   st.state = DATA;
                   CoCoAEventHandler(packet, ipv4, tcp, st, ACK_RCVD);
@@ -540,27 +620,192 @@ PointToPointNetDevice::Receive (Ptr<Packet> packet)
               CoCoAEventHandler(packet, ipv4, tcp, st, ACK_RCVD);
             }
             else{
-              NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| DATA: " << five_tuple_str(ipv4, tcp, true));
+              NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| DATA: " << CoCoAFiveTuple(ipv4, tcp, true));
             }
             break;
           }
           case TEAR_DOWN:
-            NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| TEAR DOWN: " << five_tuple_str(ipv4, tcp, true));
+            NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| TEAR DOWN: " << CoCoAFiveTuple(ipv4, tcp, true));
             break;
         }
       }
       else{
-        NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVED | " << five_tuple_str(ipv4, tcp, false));
+        NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVED | " << CoCoAFiveTuple(ipv4, tcp, false));
       }
       // CoCoA End
       if (!m_promiscCallback.IsNull ())
         {
           m_macPromiscRxTrace (originalPacket);
-          m_promiscCallback (this, packet, protocol, GetRemote (), GetAddress (), NetDevice::PACKET_HOST);
         }
-
       m_macRxTrace (originalPacket);
-      m_rxCallback (this, packet, protocol, GetRemote ());
+
+      if (m_gro)
+        {
+          GroReceive (packet, protocol);
+        }
+      else
+        {
+          ForwardUp (packet, protocol);
+        }
+    }
+}
+
+void
+PointToPointNetDevice::ForwardUp (Ptr<Packet> packet, uint16_t protocol)
+{
+  NS_LOG_FUNCTION (this << packet << protocol);
+  if (!m_promiscCallback.IsNull ())
+    {
+      m_promiscCallback (this, packet, protocol, GetRemote (), GetAddress (), NetDevice::PACKET_HOST);
+    }
+  m_rxCallback (this, packet, protocol, GetRemote ());
+}
+
+void
+PointToPointNetDevice::GroReceive (Ptr<Packet> packet, uint16_t protocol)
+{
+  NS_LOG_FUNCTION (this << packet << protocol);
+  if (protocol != 0x0800)
+    {
+      ForwardUp (packet, protocol);
+      return;
+    }
+
+  Ptr<Packet> payload = packet->Copy ();
+  Ipv4Header ipv4;
+  payload->RemoveHeader (ipv4);
+  if (ipv4.GetProtocol () != 6 || !ipv4.IsChecksumOk () || !ipv4.IsLastFragment ()
+      || ipv4.GetFragmentOffset () != 0 || payload->GetSize () != ipv4.GetPayloadSize ())
+    {
+      ForwardUp (packet, protocol);
+      return;
+    }
+  TcpHeader tcp;
+  if (Node::ChecksumEnabled ())
+    {
+      tcp.EnableChecksums ();
+      tcp.InitializeChecksum (ipv4.GetSource (), ipv4.GetDestination (), ipv4.GetProtocol ());
+    }
+  payload->RemoveHeader (tcp);
+  uint32_t size = payload->GetSize ();
+  SequenceNumber32 seq = tcp.GetSequenceNumber ();
+  bool mergeable = size > 0 && tcp.IsChecksumOk ()
+    && (tcp.GetFlags () & ~(TcpHeader::ACK | TcpHeader::PSH)) == 0
+    && !tcp.HasOption (TcpOption::SACK);
+
+  uint32_t i = 0;
+  while (i < m_groEntries.size ()
+         && !(m_groEntries[i].ipv4.GetSource () == ipv4.GetSource ()
+              && m_groEntries[i].ipv4.GetDestination () == ipv4.GetDestination ()
+              && m_groEntries[i].tcp.GetSourcePort () == tcp.GetSourcePort ()
+              && m_groEntries[i].tcp.GetDestinationPort () == tcp.GetDestinationPort ()))
+    {
+      ++i;
+    }
+
+  if (i < m_groEntries.size ())
+    {
+      GroEntry &entry = m_groEntries[i];
+      bool follows = mergeable
+        && seq == entry.nextSeq
+        && size <= entry.segmentSize
+        && ipv4.GetTos () == entry.ipv4.GetTos () // keep the CE marks
+        && tcp.GetAckNumber () == entry.tcp.GetAckNumber ()
+        && tcp.GetWindowSize () == entry.tcp.GetWindowSize ()
+        && tcp.GetLength () == entry.tcp.GetLength ()
+        && entry.ipv4.GetSerializedSize () + entry.tcp.GetSerializedSize ()
+           + entry.payload->GetSize () + size <= 65535;
+      if (follows && entry.tcp.HasOption (TcpOption::TS))
+        {
+          Ptr<const TcpOptionTS> ts = DynamicCast<const TcpOptionTS> (tcp.GetOption (TcpOption::TS));
+          Ptr<const TcpOptionTS> entryTs = DynamicCast<const TcpOptionTS> (entry.tcp.GetOption (TcpOption::TS));
+          follows = ts != 0 && ts->GetTimestamp () == entryTs->GetTimestamp ()
+            && ts->GetEcho () == entryTs->GetEcho ();
+        }
+      if (follows)
+        {
+          entry.payload->AddAtEnd (payload);
+          entry.nextSeq += size;
+          entry.tcp.SetFlags (entry.tcp.GetFlags () | tcp.GetFlags ());
+          ++entry.segments;
+          if ((tcp.GetFlags () & TcpHeader::PSH) || size < entry.segmentSize)
+            {
+              GroFlushEntry (i);
+            }
+          return;
+        }
+      // The segment does not follow: what came before goes up first
+      GroFlushEntry (i);
+    }
+
+  if (!mergeable || (tcp.GetFlags () & TcpHeader::PSH))
+    {
+      ForwardUp (packet, protocol);
+      return;
+    }
+
+  if (m_groEntries.size () >= GRO_MAX_FLOWS)
+    {
+      GroFlushEntry (0);
+    }
+  GroEntry entry;
+  entry.first = packet;
+  entry.ipv4 = ipv4;
+  entry.tcp = tcp;
+  entry.payload = payload;
+  entry.nextSeq = seq + SequenceNumber32 (size);
+  entry.segmentSize = size;
+  entry.segments = 1;
+  entry.deadline = Simulator::Now () + m_groTimeout;
+  m_groEntries.push_back (entry);
+  // The entries are in deadline order: a running flush is for an older one
+  if (!m_groFlushEvent.IsRunning ())
+    {
+      m_groFlushEvent = Simulator::Schedule (m_groTimeout, &PointToPointNetDevice::GroFlush, this);
+    }
+}
+
+void
+PointToPointNetDevice::GroFlushEntry (uint32_t i)
+{
+  NS_LOG_FUNCTION (this << i);
+  GroEntry entry = m_groEntries[i];
+  m_groEntries.erase (m_groEntries.begin () + i);
+
+  if (entry.segments == 1)
+    {
+      ForwardUp (entry.first, 0x0800);
+      return;
+    }
+
+  Ptr<Packet> p = entry.payload;
+  p->AddPacketTag (TcpGsoTag (entry.segmentSize));
+  if (Node::ChecksumEnabled ())
+    {
+      entry.tcp.EnableChecksums ();
+      entry.tcp.InitializeChecksum (entry.ipv4.GetSource (), entry.ipv4.GetDestination (),
+                                    entry.ipv4.GetProtocol ());
+      entry.ipv4.EnableChecksum ();
+    }
+  p->AddHeader (entry.tcp);
+  entry.ipv4.SetPayloadSize (p->GetSize ());
+  p->AddHeader (entry.ipv4);
+  NS_LOG_LOGIC ("Merged " << entry.segments << " segments in " << p->GetSize () << " bytes");
+  ForwardUp (p, 0x0800);
+}
+
+void
+PointToPointNetDevice::GroFlush (void)
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_groEntries.empty () && m_groEntries[0].deadline <= Simulator::Now ())
+    {
+      GroFlushEntry (0);
+    }
+  if (!m_groEntries.empty ())
+    {
+      m_groFlushEvent = Simulator::Schedule (m_groEntries[0].deadline - Simulator::Now (),
+                                             &PointToPointNetDevice::GroFlush, this);
     }
 }
 
@@ -734,8 +979,8 @@ void PointToPointNetDevice::RenoControl(CCState s, std::tuple<Ipv4Address, uint1
     case IDLE:{
     }
   }
-  NS_LOG_DEBUG(GetNode()->GetId() << " RENO CONTROL| WINDOW SIZE: " << st.cm_window_size <<
-                            " State: " << CCState_Names[st.cc_state]);
+  NS_LOG_EVENT(LOG_DEBUG, "RENO CONTROL", "node", GetNode()->GetId(),
+               "window", st.cm_window_size, "state", CCState_Names[st.cc_state].c_str());
   if (!queues_empty){
     Simulator::ScheduleNow(&PointToPointNetDevice::CoCoASched, this);
   }
@@ -791,6 +1036,37 @@ void PointToPointNetDevice::CoCoASched(){
         uint32_t seq = tcp.GetSequenceNumber().GetValue();
 
         NS_LOG_DEBUG(GetNode()->GetId() << " CM " << seq << " " << data_size << " " << st.cm_start << " " << st.cm_window_size * MSS );
+
+        // Only the head of a super-segment fits in the window: cut it in
+        // pieces that fit, so that the head can go now
+        TcpGsoTag gsoTag;
+        if ((seq >= st.cm_start) &&
+            (seq + data_size > st.cm_start + st.cm_window_size * MSS) &&
+            p->PeekPacketTag(gsoTag) &&
+            (seq + gsoTag.GetSegmentSize() <= st.cm_start + st.cm_window_size * MSS)){
+          uint32_t room = st.cm_start + st.cm_window_size * MSS - seq;
+          Ptr<Packet> packet = p->Copy();
+          packet->RemoveHeader(phdr);
+          packet->RemoveHeader(ipv4);
+          std::list<TcpGso::Ipv4PayloadHeaderPair> pieces;
+          TcpGso::Cut(packet, ipv4, room - room % gsoTag.GetSegmentSize(), pieces);
+          st.queue.pop();
+          for (std::list<TcpGso::Ipv4PayloadHeaderPair>::iterator pit = pieces.begin(); pit != pieces.end(); pit++){
+            pit->first->PeekHeader(tcp);
+            pit->first->AddHeader(pit->second);
+            pit->first->AddHeader(phdr);
+            st.queue.push(std::make_pair(pit->first, tcp.GetSequenceNumber().GetValue()));
+          }
+          queues_occ += pieces.size() - 1;
+
+          p = st.queue.top().first;
+          p->RemoveHeader(phdr);
+          p->RemoveHeader(ipv4);
+          p->PeekHeader(tcp);
+          p->AddHeader(ipv4);
+          p->AddHeader(phdr);
+          data_size = ipv4.GetPayloadSize() - tcp.GetLength() * 4;
+        }
         if (seq < st.cm_start){
           
           while(!st.queue.empty() && seq < st.cm_start){
@@ -848,8 +1124,8 @@ void PointToPointNetDevice::CoCoAEventHandler(Ptr<Packet> packet,
     case PKT_ENQ:{
       // CM Code
       st.queue.push(std::make_pair(packet, tcp.GetSequenceNumber().GetValue()));
-      NS_LOG_DEBUG(GetNode()->GetId() << " SEND| PKT ENQ: " << five_tuple_str(ipv4, tcp, false)
-                                     << " - Queue Length: " << st.queue.size());
+      NS_LOG_EVENT(LOG_DEBUG, "PKT ENQ", "node", GetNode()->GetId(),
+                   "flow", CoCoAFiveTuple(ipv4, tcp, false), "qlen", st.queue.size());
       // Event Code
       if (queues_empty){
         queues_empty = false;
@@ -858,12 +1134,13 @@ void PointToPointNetDevice::CoCoAEventHandler(Ptr<Packet> packet,
       break;
     }
     case PKT_DEQ:{
-      NS_LOG_DEBUG(GetNode()->GetId() << " SEND| PKT DEQ: " << five_tuple_str(ipv4, tcp, false)
-                                     << " - Queue Length: " << st.queue.size());
+      NS_LOG_EVENT(LOG_DEBUG, "PKT DEQ", "node", GetNode()->GetId(),
+                   "flow", CoCoAFiveTuple(ipv4, tcp, false), "qlen", st.queue.size());
       break;
     }
     case PKT_SENT:{
-      NS_LOG_DEBUG(GetNode()->GetId() << " SEND| PKT SENT: " << five_tuple_str(ipv4, tcp, false));
+      NS_LOG_EVENT(LOG_DEBUG, "PKT SENT", "node", GetNode()->GetId(),
+                   "flow", CoCoAFiveTuple(ipv4, tcp, false));
       uint16_t data_size = ipv4.GetPayloadSize() - tcp.GetLength() * 4;
       uint32_t sent = tcp.GetSequenceNumber().GetValue() + data_size;
       if (sent > st.max_sent__val){
@@ -879,13 +1156,14 @@ void PointToPointNetDevice::CoCoAEventHandler(Ptr<Packet> packet,
             &PointToPointNetDevice::rtx_timeout__timeout, this, 
                                                ipv4, tcp, st.rtx_timeout__timeout_cnt);
         NS_LOG_DEBUG(GetNode()->GetId() << " RENO| TIME OUT " << st.rtx_timeout__timeout_cnt << " Scheduled for " 
-                                       << five_tuple_str(ipv4, tcp, false, false));
+                                       << CoCoAFiveTuple(ipv4, tcp, false, false));
       }
 
       break;
     }
     case ACK_RCVD:{
-      NS_LOG_DEBUG(GetNode()->GetId() << " RECEIVE| ACK RCVD: " << five_tuple_str(ipv4, tcp, true));
+      NS_LOG_EVENT(LOG_DEBUG, "ACK RCVD", "node", GetNode()->GetId(),
+                   "flow", CoCoAFiveTuple(ipv4, tcp, true));
       uint32_t ack = tcp.GetAckNumber().GetValue();
       if (ack > st.cm_start){
         st.cm_start = ack;
@@ -924,7 +1202,7 @@ void PointToPointNetDevice::CoCoAEventHandler(Ptr<Packet> packet,
         Simulator::Schedule(st.rtx_timeout__timer_delay, &PointToPointNetDevice::rtx_timeout__timeout, 
                                                 this, ipv4, tcp, st.rtx_timeout__timeout_cnt);
         NS_LOG_DEBUG(GetNode()->GetId() << " RENO| TIME OUT " << st.rtx_timeout__timeout_cnt << " Scheduled for " 
-                                       << five_tuple_str(ipv4, tcp, true, false));
+                                       << CoCoAFiveTuple(ipv4, tcp, true, false));
       }
       bool transitioned = true;
       // ASM
@@ -1024,33 +1302,53 @@ void PointToPointNetDevice::CoCoAEventHandler(Ptr<Packet> packet,
       break;
     }
   }
+  if (m_eventTrace){
+    static const EventTraceRecord::Event events[] = {
+      EventTraceRecord::ENQ, EventTraceRecord::DEQ,
+      EventTraceRecord::SENT, EventTraceRecord::ACK,
+    };
+    CoCoATrace(events[ev], st, tcp);
+  }
   /*NS_LOG_DEBUG("max ack " << st.max_ack__val <<
                " new_ack " << st.new_ack__val <<
                " dup_ack " << st.dup_acks__val <<
                " max_sent " << st.max_sent__val); */
 }
 
-std::string PointToPointNetDevice::five_tuple_str(const Ipv4Header& ipv4, 
-                                                  const TcpHeader& tcp,
-                                                  bool flip,
-                                                  bool payload_size){
-  std::ostringstream res;
-  res << ipv4.GetIdentification() << " " << tcp.GetSequenceNumber().GetValue() << " " << tcp.GetAckNumber().GetValue() << " " ;
-  if (flip){
-    res << "(" << ipv4.GetDestination() << " " 
-        << tcp.GetDestinationPort() << " " << ipv4.GetSource() 
-        << " " << tcp.GetSourcePort() << " " << (int)ipv4.GetProtocol() << ")";
-  }
-  else{
-    res << "(" << ipv4.GetSource() << " " 
-        << tcp.GetSourcePort() << " " << ipv4.GetDestination() 
-        << " " << tcp.GetDestinationPort() << " " << (int)ipv4.GetProtocol() << ")";
-  } 
-  if (payload_size){
-    uint16_t data_size = ipv4.GetPayloadSize() - tcp.GetLength() * 4;
-    res << " " << data_size << " Bytes"; 
+void PointToPointNetDevice::CoCoATrace(EventTraceRecord::Event ev,
+                                       const FlowState& st,
+                                       const TcpHeader& tcp){
+  m_eventTrace->Record(EventTraceRecord::COCOA, ev, st.trace_flow_id, st.cc_state,
+                       st.cm_window_size * MSS,
+                       tcp.GetSequenceNumber().GetValue(),
+                       tcp.GetAckNumber().GetValue());
+}
+
+CoCoAFiveTuple::CoCoAFiveTuple(const Ipv4Header& ipv4,
+                               const TcpHeader& tcp,
+                               bool flip,
+                               bool payload_size)
+  : id(ipv4.GetIdentification()),
+    seq(tcp.GetSequenceNumber().GetValue()),
+    ack(tcp.GetAckNumber().GetValue()),
+    src(flip ? ipv4.GetDestination() : ipv4.GetSource()),
+    sport(flip ? tcp.GetDestinationPort() : tcp.GetSourcePort()),
+    dst(flip ? ipv4.GetSource() : ipv4.GetDestination()),
+    dport(flip ? tcp.GetSourcePort() : tcp.GetDestinationPort()),
+    proto(ipv4.GetProtocol()),
+    has_payload(payload_size),
+    payload(ipv4.GetPayloadSize() - tcp.GetLength() * 4)
+{
+}
+
+std::ostream& operator<<(std::ostream& os, const CoCoAFiveTuple& t){
+  os << t.id << " " << t.seq << " " << t.ack << " "
+     << "(" << t.src << " " << t.sport << " " << t.dst
+     << " " << t.dport << " " << (int)t.proto << ")";
+  if (t.has_payload){
+    os << " " << t.payload << " Bytes";
   }
-  return res.str();
+  return os;
 }
 
 void PointToPointNetDevice::rtx_timeout__timeout(Ipv4Header ipv4, TcpHeader tcp, uint32_t cnt){
@@ -1090,6 +1388,9 @@ void PointToPointNetDevice::rtx_timeout__timeout(Ipv4Header ipv4, TcpHeader tcp,
             break;
         }
       }
+      if (m_eventTrace){
+        CoCoATrace(EventTraceRecord::TIMEOUT, st, tcp);
+      }
     }
     return;
   }
@@ -1120,6 +1421,9 @@ void PointToPointNetDevice::rtx_timeout__timeout(Ipv4Header ipv4, TcpHeader tcp,
             break;
         }
       }
+      if (m_eventTrace){
+        CoCoATrace(EventTraceRecord::TIMEOUT, st, tcp);
+      }
     }
   }
 
@@ -1148,12 +1452,15 @@ PointToPointNetDevice::Send (
   
   // COCOA Start
   //
- 
+  // Only CoCoA nodes look at the TCP header of outgoing packets.
+  bool cocoa = GetNode()->GetId() > 1;
   Ipv4Header ipv4;
-  packet->RemoveHeader(ipv4);
   TcpHeader tcp;
-  packet->PeekHeader(tcp);
-  packet->AddHeader(ipv4);
+  if (cocoa){
+    packet->RemoveHeader(ipv4);
+    packet->PeekHeader(tcp);
+    packet->AddHeader(ipv4);
+  }
 
   //
   // Stick a point to point protocol header on the packet in preparation for
@@ -1163,7 +1470,7 @@ PointToPointNetDevice::Send (
 
   m_macTxTrace (packet);
   
-  if (GetNode()->GetId() > 1){
+  if (cocoa){
     typedef std::tuple<Ipv4Address, uint16_t, Ipv4Address, uint16_t, uint8_t> fid_t;
     
     // Compute FID. Assuming that all packets going out are from
@@ -1178,9 +1485,12 @@ PointToPointNetDevice::Send (
     // Check if new flow
     std::map<fid_t, FlowState>::iterator fit = flow_info.find(fid);
     if (fit == flow_info.end()){
-      NS_LOG_DEBUG(GetNode()->GetId() << " SEND| NEW FLOW: " << five_tuple_str(ipv4, tcp, false));
+      NS_LOG_DEBUG(GetNode()->GetId() << " SEND| NEW FLOW: " << CoCoAFiveTuple(ipv4, tcp, false));
       FlowState s;
       RenoInit(s);
+      s.trace_flow_id = EventTraceRecord::FlowId(ipv4.GetSource(), tcp.GetSourcePort(),
+                                                 ipv4.GetDestination(), tcp.GetDestinationPort(),
+                                                 ipv4.GetProtocol());
       flow_info[fid] = s;
       fit = flow_info.find(fid);
     }
@@ -1194,7 +1504,7 @@ PointToPointNetDevice::Send (
             uint8_t flags = tcp.GetFlags();
             if ((flags & TcpHeader::SYN) > 0 &&
                 (flags & !(TcpHeader::SYN)) == 0){
-              NS_LOG_DEBUG(GetNode()->GetId() << " SEND| SYN: " << five_tuple_str(ipv4, tcp, false));
+              NS_LOG_DEBUG(GetNode()->GetId() << " SEND| SYN: " << CoCoAFiveTuple(ipv4, tcp, false));
               st.initiator = true;
               st.setup_state = SYN;
               st.init_seq = tcp.GetSequenceNumber();
@@ -1208,7 +1518,7 @@ PointToPointNetDevice::Send (
                 (flags & TcpHeader::SYN) > 0 &&
                 (flags & TcpHeader::ACK) > 0 &&
                 (flags & !(TcpHeader::SYN) & !(TcpHeader::ACK)) == 0){
-              NS_LOG_DEBUG(GetNode()->GetId() << " SEND| SYN ACK: " << five_tuple_str(ipv4, tcp, false));
+              NS_LOG_DEBUG(GetNode()->GetId() << " SEND| SYN ACK: " << CoCoAFiveTuple(ipv4, tcp, false));
               st.setup_state = SYN_ACK;
               st.init_seq = tcp.GetSequenceNumber();
               st.cm_start = st.init_seq.GetValue();
@@ -1220,7 +1530,7 @@ PointToPointNetDevice::Send (
             if (st.initiator &&
                 (flags & TcpHeader::ACK) > 0 &&
                 (flags & !(TcpHeader::ACK)) == 0){
-              NS_LOG_DEBUG(GetNode()->GetId() << " SEND| HANDSHAKE ACK: " << five_tuple_str(ipv4, tcp, false)
+              NS_LOG_DEBUG(GetNode()->GetId() << " SEND| HANDSHAKE ACK: " << CoCoAFiveTuple(ipv4, tcp, false)
                                                    << " Init SEQ " << st.init_seq);
               st.setup_state = ACK;
               st.state = DATA;
@@ -1266,7 +1576,7 @@ PointToPointNetDevice::Send (
         }
       }
       case TEAR_DOWN:{
-        NS_LOG_DEBUG(GetNode()->GetId() << " SEND| TEAR DOWN " << five_tuple_str(ipv4, tcp, false));
+        NS_LOG_DEBUG(GetNode()->GetId() << " SEND| TEAR DOWN " << CoCoAFiveTuple(ipv4, tcp, false));
       }
     }
   
@@ -1375,6 +1685,13 @@ PointToPointNetDevice::SupportsSendFrom (void) const
   return false;
 }
 
+bool
+PointToPointNetDevice::SupportsGso (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_gso;
+}
+
 void
 PointToPointNetDevice::DoMpiReceive (Ptr<Packet> p)
 {
@@ -20,6 +20,7 @@
 #define POINT_TO_POINT_NET_DEVICE_H
 
 #include <cstring>
+#include <deque>
 #include <map>
 #include <tuple>
 #include <queue>
@@ -42,6 +43,7 @@
 #include "ns3/sequence-number.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/tcp-header.h"
+#include "ns3/event-trace.h"
 
 namespace ns3 {
 
@@ -59,6 +61,45 @@ class ErrorModel;
  * Be sure to read the manual BEFORE going down to the API.
  */
 
+/**
+ * \ingroup point-to-point
+ * \brief The 5-tuple and numbers of a TCP segment, for CoCoA log messages.
+ *
+ * The fields are copied out of the headers and only formatted when the
+ * object is streamed, so a log statement that is not enabled costs no
+ * string building.  Prints "id seq ack (src sport dst dport proto)",
+ * followed by the payload size if requested.
+ */
+struct CoCoAFiveTuple
+{
+  /**
+   * \param ipv4 the IPv4 header of the segment
+   * \param tcp the TCP header of the segment
+   * \param flip swap source and destination (for received segments)
+   * \param payload_size also print the payload size
+   */
+  CoCoAFiveTuple(const Ipv4Header& ipv4, const TcpHeader& tcp, bool flip, bool payload_size = true);
+
+  uint16_t id;        //!< IPv4 identification
+  uint32_t seq;       //!< TCP sequence number
+  uint32_t ack;       //!< TCP acknowledgment number
+  Ipv4Address src;    //!< local address
+  uint16_t sport;     //!< local port
+  Ipv4Address dst;    //!< remote address
+  uint16_t dport;     //!< remote port
+  uint8_t proto;      //!< IP protocol
+  bool has_payload;   //!< print the payload size
+  uint16_t payload;   //!< TCP payload size
+};
+
+/**
+ * \brief Stream a CoCoAFiveTuple.
+ * \param os the output stream
+ * \param t the 5-tuple
+ * \return the output stream
+ */
+std::ostream& operator<<(std::ostream& os, const CoCoAFiveTuple& t);
+
 /**
  * \ingroup point-to-point
  * \class PointToPointNetDevice
@@ -150,6 +191,17 @@ public:
    */
   void SetReceiveErrorModel (Ptr<ErrorModel> em);
 
+  /**
+   * Attach a ring to which the CoCoA controller reports its events.
+   *
+   * Every enqueue, dequeue, transmission, acknowledgment and timeout of a
+   * CoCoA flow is recorded as a fixed-size binary record; see
+   * EventTraceSink for how the rings are collected.
+   *
+   * \param ring the ring, or 0 to stop recording.
+   */
+  void SetEventTrace (Ptr<EventTraceRing> ring);
+
   /**
    * Receive a packet from a connected PointToPointChannel.
    *
@@ -202,6 +254,7 @@ public:
 
   virtual void SetPromiscReceiveCallback (PromiscReceiveCallback cb);
   virtual bool SupportsSendFrom (void) const;
+  virtual bool SupportsGso (void) const;
 
 protected:
   /**
@@ -474,6 +527,76 @@ private:
 
   Ptr<Packet> m_currentPkt; //!< Current packet processed
 
+  bool m_gso; //!< Cut TCP super-segments at transmission
+  std::deque<Ptr<Packet> > m_gsoSegments; //!< Segments of the current super-segment not sent yet
+
+  /**
+   * \brief Cut a TCP super-segment in segments
+   *
+   * The first segment is returned, the others are kept in m_gsoSegments,
+   * and transmitted before the next packet of the queue.
+   *
+   * \param p the super-segment, with its PPP header
+   * \param segmentSize the payload size of the segments
+   * \return the first segment
+   */
+  Ptr<Packet> CutSuperSegment (Ptr<Packet> p, uint16_t segmentSize);
+
+  /// Segments of a TCP flow held back by the receive offload
+  struct GroEntry
+  {
+    Ptr<Packet> first;        //!< First segment, with its headers
+    Ipv4Header ipv4;          //!< IPv4 header of the first segment
+    TcpHeader tcp;            //!< TCP header of the first segment
+    Ptr<Packet> payload;      //!< Payload of the segments so far
+    SequenceNumber32 nextSeq; //!< Sequence number of the next segment
+    uint16_t segmentSize;     //!< Payload size of the first segment
+    uint32_t segments;        //!< Number of segments so far
+    Time deadline;            //!< Time at which the segments go up
+  };
+
+  static const uint32_t GRO_MAX_FLOWS = 8; //!< Flows held back at once
+
+  bool m_gro;                          //!< Merge the TCP segments received
+  Time m_groTimeout;                   //!< Longest time a segment is held back
+  std::vector<GroEntry> m_groEntries;  //!< Flows held back, oldest first
+  EventId m_groFlushEvent;             //!< Flush of the oldest flow held back
+
+  /**
+   * \brief Merge a received packet with the segments of its flow
+   *
+   * In-order TCP segments of a flow, with the same TOS (so that CE marks
+   * are kept), ACK, window and timestamp, are merged in one packet, that
+   * goes up the stack when a segment does not follow, has flags other
+   * than ACK and PSH, or is shorter than the first one, or when the
+   * timeout expires.  The other packets go up at once.
+   *
+   * \param packet the packet, without its PPP header
+   * \param protocol the protocol number
+   */
+  void GroReceive (Ptr<Packet> packet, uint16_t protocol);
+
+  /**
+   * \brief Send the segments of a flow held back up the stack
+   * \param i the index of the flow in m_groEntries
+   */
+  void GroFlushEntry (uint32_t i);
+
+  /**
+   * \brief Send the flows whose timeout expired up the stack
+   *
+   * The flow held back next is flushed in turn when its own timeout
+   * expires.
+   */
+  void GroFlush (void);
+
+  /**
+   * \brief Pass a received packet to the receive callbacks
+   * \param packet the packet, without its PPP header
+   * \param protocol the protocol number
+   */
+  void ForwardUp (Ptr<Packet> packet, uint16_t protocol);
+
   /**
    * \brief PPP to Ethernet protocol number mapping
    * \param protocol A PPP protocol number
@@ -497,6 +620,7 @@ private:
   std::string CCState_Names[6] = {"Start", "Slow Start",
                                "AI", "MD", "FR", "IDLE"};
   uint16_t CC_LATENCY = 0;
+  Ptr<EventTraceRing> m_eventTrace; //!< CoCoA event records, if enabled
 
   enum TCPState{
     SETUP,
@@ -568,6 +692,8 @@ private:
     bool rtx_timeout__timer__isset;
     uint32_t rtx_timeout__timeout_cnt;
     Time rtx_timeout__timer_delay;
+
+    uint32_t trace_flow_id;
   };
 
   std::map<std::tuple<Ipv4Address, uint16_t, Ipv4Address, uint16_t, uint8_t>, FlowState> flow_info;
@@ -579,7 +705,7 @@ private:
   void CoCoASched();
   void RenoInit(FlowState&);
   void CoCoAEventHandler(Ptr<Packet>, const Ipv4Header&, const TcpHeader&, FlowState&, CCEvent);
-  std::string five_tuple_str(const Ipv4Header&, const TcpHeader&, bool, bool = true);
+  void CoCoATrace(EventTraceRecord::Event, const FlowState&, const TcpHeader&);
 };
 
 } // namespace ns3
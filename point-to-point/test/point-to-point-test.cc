@@ -23,7 +23,30 @@
 #include "ns3/simulator.h"
 #include "ns3/point-to-point-net-device.h"
 #include "ns3/point-to-point-channel.h"
+#include "ns3/ppp-header.h"
 #include "ns3/net-device-queue-interface.h"
+#include "ns3/pcap-file.h"
+#include "ns3/trace-helper.h"
+#include "ns3/pcap-replay-application.h"
+#include "ns3/data-rate.h"
+#include "ns3/double.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/tcp-header.h"
+#include "ns3/tcp-gso.h"
+#include "ns3/tcp-l4-protocol.h"
+#include "ns3/tcp-socket-base.h"
+#include "ns3/tcp-dctcp.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/event-trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
 
 using namespace ns3;
 
@@ -101,6 +124,1121 @@ PointToPointTest::DoRun (void)
   Simulator::Destroy ();
 }
 
+/**
+ * \brief Test class for PcapReplayApplication
+ *
+ * It writes a small PPP capture, replays it through a PointToPointNetDevice
+ * at half speed, and checks what the peer receives and when.
+ */
+class PcapReplayTest : public TestCase
+{
+public:
+  /**
+   * \brief Create the test
+   */
+  PcapReplayTest ();
+
+  /**
+   * \brief Run the test
+   */
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Record a packet received by the peer
+   * \param device the receiving device
+   * \param p the packet
+   * \param protocol the protocol number
+   * \param from the sender address
+   * \return true
+   */
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from);
+
+  /**
+   * \brief Record a packet handed to the sending device
+   * \param p the packet
+   */
+  void Transmit (Ptr<const Packet> p);
+
+  std::vector<Time> m_txTimes;    //!< times the packets were handed to the device
+  std::vector<Time> m_times;      //!< receive times
+  std::vector<uint32_t> m_sizes;  //!< received packet sizes
+  bool m_ipv4;                    //!< all packets were IPv4
+};
+
+PcapReplayTest::PcapReplayTest ()
+  : TestCase ("PcapReplayApplication"),
+    m_ipv4 (true)
+{
+}
+
+bool
+PcapReplayTest::Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from)
+{
+  m_times.push_back (Simulator::Now ());
+  m_sizes.push_back (p->GetSize ());
+  m_ipv4 = m_ipv4 && protocol == 0x0800;
+  return true;
+}
+
+void
+PcapReplayTest::Transmit (Ptr<const Packet> p)
+{
+  m_txTimes.push_back (Simulator::Now ());
+}
+
+void
+PcapReplayTest::DoRun (void)
+{
+  const uint32_t nRecords = 5;
+  const uint32_t snapLen = 64;
+  std::string filename = CreateTempDirFilename ("replay.pcap");
+
+  //
+  // Five IPv4 records 1 ms apart, the last one truncated by the snap length,
+  // with an LCP record in the middle that must be skipped.
+  //
+  {
+    PcapFile f;
+    f.Open (filename, std::ios::out);
+    NS_TEST_ASSERT_MSG_EQ (f.Fail (), false, "Cannot create " << filename);
+    f.Init (PcapHelper::DLT_PPP, snapLen);
+    uint8_t record[102] = { 0x00, 0x21, 0x45 };
+    for (uint32_t i = 0; i < nRecords; ++i)
+      {
+        f.Write (10, 500000 + i * 1000, record, i == nRecords - 1 ? sizeof (record) : 30);
+        if (i == 2)
+          {
+            uint8_t lcp[8] = { 0xc0, 0x21 };
+            f.Write (10, 502500, lcp, sizeof (lcp));
+          }
+      }
+    f.Close ();
+  }
+
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devA->SetDataRate (DataRate ("100Mbps"));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devB->SetReceiveCallback (MakeCallback (&PcapReplayTest::Receive, this));
+  devA->TraceConnectWithoutContext ("MacTx", MakeCallback (&PcapReplayTest::Transmit, this));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  Ptr<PcapReplayApplication> app = CreateObject<PcapReplayApplication> ();
+  app->SetAttribute ("Filename", StringValue (filename));
+  app->SetAttribute ("TimeScale", DoubleValue (2.0));
+  app->SetAttribute ("ReadAhead", UintegerValue (4096));
+  a->AddApplication (app);
+  app->SetStartTime (Seconds (1.0));
+
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (app->GetSent (), nRecords, "Every IPv4 record must be sent");
+  NS_TEST_ASSERT_MSG_EQ (app->GetSkipped (), 1, "The LCP record must be skipped");
+  NS_TEST_ASSERT_MSG_EQ (m_times.size (), nRecords, "Every IPv4 record must be received");
+  NS_TEST_EXPECT_MSG_EQ (m_ipv4, true, "Records must be delivered as IPv4");
+  // Receive times also depend on the packet sizes, through the
+  // transmission time; the replay schedule shows in the send times
+  NS_TEST_ASSERT_MSG_EQ (m_txTimes.size (), nRecords, "Every IPv4 record must be handed to the device");
+  for (uint32_t i = 1; i < nRecords; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_txTimes[i] - m_txTimes[i - 1], MilliSeconds (2),
+                             "Captured inter-packet times must be scaled");
+    }
+  NS_TEST_EXPECT_MSG_EQ (m_sizes[0], 28, "The PPP header must be removed");
+  NS_TEST_EXPECT_MSG_EQ (m_sizes[nRecords - 1], 100, "Truncated records must be padded to their original length");
+
+  Simulator::Destroy ();
+  remove (filename.c_str ());
+}
+
+/**
+ * \brief Test class for the segmentation offload of PointToPointNetDevice
+ *
+ * It sends a TCP super-segment through a device with GSO enabled, and
+ * checks that the peer receives the segments it stands for.
+ */
+class PointToPointGsoTest : public TestCase
+{
+public:
+  /**
+   * \brief Create the test
+   */
+  PointToPointGsoTest ();
+
+  /**
+   * \brief Run the test
+   */
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Send a super-segment to the device specified
+   *
+   * \param device NetDevice to send to
+   */
+  void SendSuperSegment (Ptr<PointToPointNetDevice> device);
+
+  /**
+   * \brief Record a segment received by the peer
+   * \param device the receiving device
+   * \param p the packet
+   * \param protocol the protocol number
+   * \param from the sender address
+   * \return true
+   */
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from);
+
+  std::vector<Ipv4Header> m_ipHeaders;  //!< received IPv4 headers
+  std::vector<TcpHeader> m_tcpHeaders;  //!< received TCP headers
+  std::vector<uint32_t> m_sizes;        //!< received payload sizes
+  bool m_tagged;                        //!< a segment kept the TcpGsoTag
+};
+
+PointToPointGsoTest::PointToPointGsoTest ()
+  : TestCase ("PointToPoint GSO"),
+    m_tagged (false)
+{
+}
+
+void
+PointToPointGsoTest::SendSuperSegment (Ptr<PointToPointNetDevice> device)
+{
+  Ptr<Packet> p = Create<Packet> (4500);
+  TcpHeader tcpHeader;
+  tcpHeader.SetSourcePort (49153);
+  tcpHeader.SetDestinationPort (80);
+  tcpHeader.SetSequenceNumber (SequenceNumber32 (1000));
+  tcpHeader.SetFlags (TcpHeader::ACK | TcpHeader::PSH);
+  p->AddHeader (tcpHeader);
+  p->AddPacketTag (TcpGsoTag (1000));
+
+  Ipv4Header ipHeader;
+  ipHeader.SetSource (Ipv4Address ("10.1.1.1"));
+  ipHeader.SetDestination (Ipv4Address ("10.1.1.2"));
+  ipHeader.SetProtocol (6);
+  ipHeader.SetIdentification (7);
+  ipHeader.SetPayloadSize (p->GetSize ());
+  p->AddHeader (ipHeader);
+
+  device->Send (p, device->GetBroadcast (), 0x800);
+}
+
+bool
+PointToPointGsoTest::Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from)
+{
+  Ptr<Packet> packet = p->Copy ();
+  Ipv4Header ipHeader;
+  packet->RemoveHeader (ipHeader);
+  TcpHeader tcpHeader;
+  packet->RemoveHeader (tcpHeader);
+  m_ipHeaders.push_back (ipHeader);
+  m_tcpHeaders.push_back (tcpHeader);
+  m_sizes.push_back (packet->GetSize ());
+  TcpGsoTag tag;
+  m_tagged = m_tagged || packet->PeekPacketTag (tag);
+  return true;
+}
+
+void
+PointToPointGsoTest::DoRun (void)
+{
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+
+  devA->SetAttribute ("Gso", BooleanValue (true));
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devA->SetDataRate (DataRate ("100Mbps"));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devB->SetReceiveCallback (MakeCallback (&PointToPointGsoTest::Receive, this));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  NS_TEST_ASSERT_MSG_EQ (devA->SupportsGso (), true, "The device must accept super-segments");
+  NS_TEST_ASSERT_MSG_EQ (devB->SupportsGso (), false, "GSO must be disabled by default");
+
+  Simulator::Schedule (Seconds (1.0), &PointToPointGsoTest::SendSuperSegment, this, devA);
+
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_sizes.size (), 5, "The super-segment must be received as 5 segments");
+  for (uint32_t i = 0; i < m_sizes.size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (m_sizes[i], i < 4 ? 1000 : 500, "Wrong segment size");
+      NS_TEST_EXPECT_MSG_EQ (m_tcpHeaders[i].GetSequenceNumber (), SequenceNumber32 (1000 + 1000 * i),
+                             "Wrong sequence number");
+      NS_TEST_EXPECT_MSG_EQ (m_tcpHeaders[i].GetDestinationPort (), 80, "Wrong destination port");
+      NS_TEST_EXPECT_MSG_EQ ((m_tcpHeaders[i].GetFlags () & TcpHeader::PSH) != 0, i == 4,
+                             "PSH must only be set on the last segment");
+      NS_TEST_EXPECT_MSG_EQ (m_ipHeaders[i].GetPayloadSize (), m_sizes[i] + m_tcpHeaders[i].GetSerializedSize (),
+                             "Wrong IPv4 payload size");
+      NS_TEST_EXPECT_MSG_EQ (m_ipHeaders[i].GetIdentification (), 7 + i, "Wrong IPv4 identification");
+    }
+  NS_TEST_EXPECT_MSG_EQ (m_tagged, false, "The segments must not carry the GSO tag");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \brief Test class for the segmentation offload of PointToPointNetDevice,
+ * under a TCP socket
+ *
+ * A TCP socket hands super-segments to IPv4 through a device with GSO
+ * enabled: they must be sent whole to the device, never as IPv4 fragments,
+ * and reach the peer as segments within the MTU.  Through a router, the
+ * segments merged by the GRO of its input device must leave by the GSO of
+ * its output device in the same way.
+ */
+class PointToPointGsoTcpTest : public TestCase
+{
+public:
+  /**
+   * \brief Create the test
+   * \param forward whether the segments go through a router
+   * \param name test description
+   */
+  PointToPointGsoTcpTest (bool forward, const std::string &name);
+
+  /**
+   * \brief Run the test
+   */
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Fill the send buffer of the sender
+   * \param socket the sender
+   * \param available bytes available in the send buffer
+   */
+  void Send (Ptr<Socket> socket, uint32_t available);
+
+  /**
+   * \brief Read the data received
+   * \param socket the receiver
+   */
+  void Receive (Ptr<Socket> socket);
+
+  /**
+   * \brief Accept a connection
+   * \param socket the connected socket
+   * \param from the address of the peer
+   */
+  void Accept (Ptr<Socket> socket, const Address &from);
+
+  /**
+   * \brief Record a packet handed to the device of the receiver's link
+   * \param p the packet
+   */
+  void MacTx (Ptr<const Packet> p);
+
+  /**
+   * \brief Record a packet received by the device of the receiver
+   * \param p the packet
+   */
+  void PhyRxEnd (Ptr<const Packet> p);
+
+  /**
+   * \brief Create a link between two nodes
+   * \param a the first node
+   * \param b the second node
+   * \return the devices of the link
+   */
+  NetDeviceContainer Link (Ptr<Node> a, Ptr<Node> b);
+
+  bool m_forward;            //!< the segments go through a router
+  uint32_t m_totalBytes;     //!< bytes to send
+  uint32_t m_sentBytes;      //!< bytes given to the sender
+  uint32_t m_rcvdBytes;      //!< bytes read by the receiver
+  uint32_t m_superSegments;  //!< packets larger than the MTU sent to the device
+  uint32_t m_fragments;      //!< IPv4 fragments received
+  uint32_t m_largestRx;      //!< largest packet received, without the PPP header
+};
+
+PointToPointGsoTcpTest::PointToPointGsoTcpTest (bool forward, const std::string &name)
+  : TestCase (name),
+    m_forward (forward),
+    m_totalBytes (1000000),
+    m_sentBytes (0),
+    m_rcvdBytes (0),
+    m_superSegments (0),
+    m_fragments (0),
+    m_largestRx (0)
+{
+}
+
+void
+PointToPointGsoTcpTest::Send (Ptr<Socket> socket, uint32_t available)
+{
+  while (m_sentBytes < m_totalBytes && socket->GetTxAvailable () > 0)
+    {
+      uint32_t size = std::min (socket->GetTxAvailable (), m_totalBytes - m_sentBytes);
+      int sent = socket->Send (Create<Packet> (size));
+      if (sent <= 0)
+        {
+          break;
+        }
+      m_sentBytes += sent;
+    }
+}
+
+void
+PointToPointGsoTcpTest::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> p;
+  while ((p = socket->Recv ()))
+    {
+      m_rcvdBytes += p->GetSize ();
+    }
+}
+
+void
+PointToPointGsoTcpTest::Accept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&PointToPointGsoTcpTest::Receive, this));
+}
+
+void
+PointToPointGsoTcpTest::MacTx (Ptr<const Packet> p)
+{
+  PppHeader ppp;
+  if (p->GetSize () > ppp.GetSerializedSize () + 1500)
+    {
+      ++m_superSegments;
+    }
+}
+
+void
+PointToPointGsoTcpTest::PhyRxEnd (Ptr<const Packet> p)
+{
+  Ptr<Packet> packet = p->Copy ();
+  PppHeader ppp;
+  packet->RemoveHeader (ppp);
+  m_largestRx = std::max (m_largestRx, packet->GetSize ());
+  Ipv4Header ipHeader;
+  packet->RemoveHeader (ipHeader);
+  if (!ipHeader.IsLastFragment () || ipHeader.GetFragmentOffset () != 0)
+    {
+      ++m_fragments;
+    }
+}
+
+NetDeviceContainer
+PointToPointGsoTcpTest::Link (Ptr<Node> a, Ptr<Node> b)
+{
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+
+  channel->SetAttribute ("Delay", TimeValue (MilliSeconds (1)));
+  devA->SetAttribute ("Gso", BooleanValue (true));
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devA->SetDataRate (DataRate ("100Mbps"));
+  devB->SetAttribute ("Gro", BooleanValue (m_forward));
+  devB->SetAttribute ("GroTimeout", TimeValue (MilliSeconds (1)));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devB->SetDataRate (DataRate ("100Mbps"));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  NetDeviceContainer devices;
+  devices.Add (devA);
+  devices.Add (devB);
+  return devices;
+}
+
+void
+PointToPointGsoTcpTest::DoRun (void)
+{
+  // The device takes the nodes from the third on for CoCoA: through the
+  // router, the receiver is the third one, and only sends ACKs
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> r = m_forward ? CreateObject<Node> () : a;
+  Ptr<Node> b = CreateObject<Node> ();
+  NodeContainer nodes (a, b);
+  if (m_forward)
+    {
+      nodes.Add (r);
+    }
+
+  NetDeviceContainer last = Link (r, b);
+  last.Get (0)->TraceConnectWithoutContext ("MacTx", MakeCallback (&PointToPointGsoTcpTest::MacTx, this));
+  last.Get (1)->TraceConnectWithoutContext ("PhyRxEnd", MakeCallback (&PointToPointGsoTcpTest::PhyRxEnd, this));
+  NetDeviceContainer first;
+  if (m_forward)
+    {
+      first = Link (a, r);
+    }
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = ipv4.Assign (last);
+  if (m_forward)
+    {
+      ipv4.SetBase ("10.1.2.0", "255.255.255.0");
+      ipv4.Assign (first);
+      Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+
+  Ptr<Socket> receiver = b->GetObject<TcpL4Protocol> ()->CreateSocket ();
+  receiver->Bind (InetSocketAddress (Ipv4Address::GetAny (), 5000));
+  receiver->Listen ();
+  receiver->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                               MakeCallback (&PointToPointGsoTcpTest::Accept, this));
+
+  Ptr<Socket> sender = a->GetObject<TcpL4Protocol> ()->CreateSocket ();
+  sender->SetAttribute ("SegmentSize", UintegerValue (1448));
+  sender->SetAttribute ("GsoMaxSize", UintegerValue (65000));
+  sender->SetSendCallback (MakeCallback (&PointToPointGsoTcpTest::Send, this));
+  sender->Bind ();
+  sender->Connect (InetSocketAddress (interfaces.GetAddress (1), 5000));
+
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_rcvdBytes, m_totalBytes, "All the data must be received");
+  NS_TEST_EXPECT_MSG_GT (m_superSegments, 0, "Super-segments must be handed to the device");
+  NS_TEST_EXPECT_MSG_EQ (m_fragments, 0, "The super-segments must not be fragmented");
+  NS_TEST_EXPECT_MSG_LT_OR_EQ (m_largestRx, 1500, "The segments must fit in the MTU");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \brief Test class for the receive offload of PointToPointNetDevice
+ *
+ * It sends a super-segment through a device with GSO enabled, followed by
+ * a segment out of order, to a device with GRO enabled, and checks that
+ * the segments of the super-segment are merged back, and flushed when the
+ * next segment does not follow.  It then checks that a flow held back
+ * after another one is held for the whole timeout.
+ */
+class PointToPointGroTest : public TestCase
+{
+public:
+  /**
+   * \brief Create the test
+   */
+  PointToPointGroTest ();
+
+  /**
+   * \brief Run the test
+   */
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Send a segment, or a super-segment, to the device specified
+   *
+   * \param device NetDevice to send to
+   * \param port source port
+   * \param seq sequence number
+   * \param size payload size
+   */
+  void SendSegment (Ptr<PointToPointNetDevice> device, uint16_t port, uint32_t seq, uint32_t size);
+
+  /**
+   * \brief Record a packet received by the peer
+   * \param device the receiving device
+   * \param p the packet
+   * \param protocol the protocol number
+   * \param from the sender address
+   * \return true
+   */
+  bool Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from);
+
+  std::vector<Time> m_times;            //!< receive times
+  std::vector<TcpHeader> m_tcpHeaders;  //!< received TCP headers
+  std::vector<uint32_t> m_sizes;        //!< received payload sizes
+  std::vector<uint32_t> m_segmentSizes; //!< segment sizes of the TcpGsoTag, or 0
+};
+
+PointToPointGroTest::PointToPointGroTest ()
+  : TestCase ("PointToPoint GRO")
+{
+}
+
+void
+PointToPointGroTest::SendSegment (Ptr<PointToPointNetDevice> device, uint16_t port, uint32_t seq, uint32_t size)
+{
+  Ptr<Packet> p = Create<Packet> (size);
+  TcpHeader tcpHeader;
+  tcpHeader.SetSourcePort (port);
+  tcpHeader.SetDestinationPort (80);
+  tcpHeader.SetSequenceNumber (SequenceNumber32 (seq));
+  tcpHeader.SetFlags (TcpHeader::ACK);
+  p->AddHeader (tcpHeader);
+  if (size > 1000)
+    {
+      p->AddPacketTag (TcpGsoTag (1000));
+    }
+
+  Ipv4Header ipHeader;
+  ipHeader.SetSource (Ipv4Address ("10.1.1.1"));
+  ipHeader.SetDestination (Ipv4Address ("10.1.1.2"));
+  ipHeader.SetProtocol (6);
+  ipHeader.SetPayloadSize (p->GetSize ());
+  p->AddHeader (ipHeader);
+
+  device->Send (p, device->GetBroadcast (), 0x800);
+}
+
+bool
+PointToPointGroTest::Receive (Ptr<NetDevice> device, Ptr<const Packet> p, uint16_t protocol, const Address &from)
+{
+  Ptr<Packet> packet = p->Copy ();
+  Ipv4Header ipHeader;
+  packet->RemoveHeader (ipHeader);
+  TcpHeader tcpHeader;
+  packet->RemoveHeader (tcpHeader);
+  m_times.push_back (Simulator::Now ());
+  m_tcpHeaders.push_back (tcpHeader);
+  m_sizes.push_back (packet->GetSize ());
+  TcpGsoTag tag;
+  m_segmentSizes.push_back (packet->PeekPacketTag (tag) ? tag.GetSegmentSize () : 0);
+  return true;
+}
+
+void
+PointToPointGroTest::DoRun (void)
+{
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+
+  devA->SetAttribute ("Gso", BooleanValue (true));
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devA->SetDataRate (DataRate ("100Mbps"));
+  devB->SetAttribute ("Gro", BooleanValue (true));
+  devB->SetAttribute ("GroTimeout", TimeValue (MilliSeconds (1)));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devB->SetReceiveCallback (MakeCallback (&PointToPointGroTest::Receive, this));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  // Four segments, then one after a hole
+  Simulator::Schedule (Seconds (1.0), &PointToPointGroTest::SendSegment, this, devA, 49153, 1000, 4000);
+  Simulator::Schedule (Seconds (1.0), &PointToPointGroTest::SendSegment, this, devA, 49153, 6000, 1000);
+  // One segment of a second flow just before the first one times out
+  Simulator::Schedule (Seconds (2.0), &PointToPointGroTest::SendSegment, this, devA, 49153, 20000, 1000);
+  Simulator::Schedule (Seconds (2.0009), &PointToPointGroTest::SendSegment, this, devA, 49154, 1000, 1000);
+
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_sizes.size (), 4, "The peer must receive four packets");
+  NS_TEST_EXPECT_MSG_EQ (m_tcpHeaders[0].GetSequenceNumber (), SequenceNumber32 (1000), "Wrong sequence number");
+  NS_TEST_EXPECT_MSG_EQ (m_sizes[0], 4000, "The four segments must be merged");
+  NS_TEST_EXPECT_MSG_EQ (m_segmentSizes[0], 1000, "The merged packet must carry the segment size");
+  NS_TEST_EXPECT_MSG_EQ (m_tcpHeaders[1].GetSequenceNumber (), SequenceNumber32 (6000), "Wrong sequence number");
+  NS_TEST_EXPECT_MSG_EQ (m_sizes[1], 1000, "Wrong segment size");
+  NS_TEST_EXPECT_MSG_EQ (m_segmentSizes[1], 0, "A single segment must not carry the GSO tag");
+  NS_TEST_EXPECT_MSG_EQ (m_times[1] > m_times[0], true, "The segment out of order must flush the merged packet");
+  NS_TEST_EXPECT_MSG_LT (m_times[1], Seconds (1.002), "The last segment must be flushed by the timeout");
+  NS_TEST_EXPECT_MSG_EQ (m_tcpHeaders[2].GetSourcePort (), 49153, "The oldest flow must go up first");
+  NS_TEST_EXPECT_MSG_LT (m_times[2], Seconds (2.0015), "The oldest flow must be flushed by its timeout");
+  NS_TEST_EXPECT_MSG_EQ (m_tcpHeaders[3].GetSourcePort (), 49154, "Wrong source port");
+  NS_TEST_EXPECT_MSG_GT (m_times[3], Seconds (2.0019), "The second flow must be held for the whole timeout");
+  NS_TEST_EXPECT_MSG_LT (m_times[3], Seconds (2.0025), "The second flow must be flushed by its timeout");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \brief A drop tail queue that marks CE the ECN-capable packets
+ *
+ * As the switches of a datacenter do for DCTCP, a packet is marked when it
+ * finds at least the threshold number of packets in the queue.
+ */
+class CeMarkingQueue : public DropTailQueue<Packet>
+{
+public:
+  /**
+   * \brief Create the queue
+   * \param threshold queue length, in packets, from which packets are marked
+   */
+  CeMarkingQueue (uint32_t threshold);
+
+  virtual bool Enqueue (Ptr<Packet> item);
+
+  /**
+   * \brief Get the number of packets marked CE
+   * \return the number of packets marked
+   */
+  uint32_t GetNMarked (void) const;
+
+  /**
+   * \brief Get the largest queue length seen by a packet
+   * \return the largest queue length, in packets
+   */
+  uint32_t GetMaxLength (void) const;
+
+private:
+  uint32_t m_threshold; //!< marking threshold, in packets
+  uint32_t m_marked;    //!< packets marked CE
+  uint32_t m_maxLength; //!< largest queue length seen by a packet
+};
+
+CeMarkingQueue::CeMarkingQueue (uint32_t threshold)
+  : m_threshold (threshold),
+    m_marked (0),
+    m_maxLength (0)
+{
+}
+
+bool
+CeMarkingQueue::Enqueue (Ptr<Packet> item)
+{
+  uint32_t length = GetNPackets ();
+  m_maxLength = std::max (m_maxLength, length);
+
+  // The device queues the packets with their PPP header
+  PppHeader ppp;
+  item->PeekHeader (ppp);
+  if (length >= m_threshold && ppp.GetProtocol () == 0x0021)
+    {
+      item->RemoveHeader (ppp);
+      Ipv4Header ipHeader;
+      item->RemoveHeader (ipHeader);
+      if (ipHeader.GetEcn () == Ipv4Header::ECN_ECT0 || ipHeader.GetEcn () == Ipv4Header::ECN_ECT1)
+        {
+          ipHeader.SetEcn (Ipv4Header::ECN_CE);
+          ++m_marked;
+        }
+      item->AddHeader (ipHeader);
+      item->AddHeader (ppp);
+    }
+
+  return DropTailQueue<Packet>::Enqueue (item);
+}
+
+uint32_t
+CeMarkingQueue::GetNMarked (void) const
+{
+  return m_marked;
+}
+
+uint32_t
+CeMarkingQueue::GetMaxLength (void) const
+{
+  return m_maxLength;
+}
+
+/**
+ * \brief Test class for ECN over PointToPoint, with DCTCP
+ *
+ * A DCTCP flow goes through a CeMarkingQueue at the bottleneck: the marks
+ * must be echoed to the sender, which reduces its window on them, so that
+ * the queue stays short and nothing is lost.  Without ECN, nothing is
+ * marked.
+ */
+class PointToPointEcnTest : public TestCase
+{
+public:
+  /**
+   * \brief Create the test
+   * \param useEcn whether the sockets use DCTCP, and so ECN, or NewReno
+   * \param name test description
+   */
+  PointToPointEcnTest (bool useEcn, const std::string &name);
+
+  /**
+   * \brief Run the test
+   */
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Fill the send buffer of the sender
+   * \param socket the sender
+   * \param available bytes available in the send buffer
+   */
+  void Send (Ptr<Socket> socket, uint32_t available);
+
+  /**
+   * \brief Read the data received
+   * \param socket the receiver
+   */
+  void Receive (Ptr<Socket> socket);
+
+  /**
+   * \brief Accept a connection
+   * \param socket the connected socket
+   * \param from the address of the peer
+   */
+  void Accept (Ptr<Socket> socket, const Address &from);
+
+  /**
+   * \brief Record the congestion states of the sender
+   * \param oldValue previous state
+   * \param newValue new state
+   */
+  void CongState (const TcpSocketState::TcpCongState_t oldValue,
+                  const TcpSocketState::TcpCongState_t newValue);
+
+  bool m_useEcn;          //!< DCTCP, or NewReno without ECN
+  uint32_t m_totalBytes;  //!< bytes to send
+  uint32_t m_sentBytes;   //!< bytes given to the sender
+  uint32_t m_rcvdBytes;   //!< bytes read by the receiver
+  uint32_t m_cwrEntries;  //!< times the sender entered CA_CWR
+};
+
+PointToPointEcnTest::PointToPointEcnTest (bool useEcn, const std::string &name)
+  : TestCase (name),
+    m_useEcn (useEcn),
+    m_totalBytes (1000000),
+    m_sentBytes (0),
+    m_rcvdBytes (0),
+    m_cwrEntries (0)
+{
+}
+
+void
+PointToPointEcnTest::Send (Ptr<Socket> socket, uint32_t available)
+{
+  while (m_sentBytes < m_totalBytes && socket->GetTxAvailable () > 0)
+    {
+      uint32_t size = std::min (socket->GetTxAvailable (), m_totalBytes - m_sentBytes);
+      int sent = socket->Send (Create<Packet> (size));
+      if (sent <= 0)
+        {
+          break;
+        }
+      m_sentBytes += sent;
+    }
+}
+
+void
+PointToPointEcnTest::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> p;
+  while ((p = socket->Recv ()))
+    {
+      m_rcvdBytes += p->GetSize ();
+    }
+}
+
+void
+PointToPointEcnTest::Accept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&PointToPointEcnTest::Receive, this));
+}
+
+void
+PointToPointEcnTest::CongState (const TcpSocketState::TcpCongState_t oldValue,
+                                const TcpSocketState::TcpCongState_t newValue)
+{
+  if (newValue == TcpSocketState::CA_CWR)
+    {
+      ++m_cwrEntries;
+    }
+}
+
+void
+PointToPointEcnTest::DoRun (void)
+{
+  // Two nodes only: the device takes the nodes from the third on for CoCoA
+  Ptr<Node> a = CreateObject<Node> ();
+  Ptr<Node> b = CreateObject<Node> ();
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+  uint32_t threshold = 10;
+  Ptr<CeMarkingQueue> queue = CreateObject<CeMarkingQueue> (threshold);
+
+  channel->SetAttribute ("Delay", TimeValue (MilliSeconds (1)));
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (queue);
+  devA->SetDataRate (DataRate ("10Mbps"));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devB->SetDataRate (DataRate ("10Mbps"));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  InternetStackHelper internet;
+  internet.Install (a);
+  internet.Install (b);
+
+  NetDeviceContainer devices;
+  devices.Add (devA);
+  devices.Add (devB);
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
+
+  TypeId congestionTypeId = m_useEcn ? TcpDctcp::GetTypeId () : TcpNewReno::GetTypeId ();
+  Ptr<Socket> receiver = b->GetObject<TcpL4Protocol> ()->CreateSocket (congestionTypeId);
+  receiver->Bind (InetSocketAddress (Ipv4Address::GetAny (), 5000));
+  receiver->Listen ();
+  receiver->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                               MakeCallback (&PointToPointEcnTest::Accept, this));
+
+  Ptr<Socket> sender = a->GetObject<TcpL4Protocol> ()->CreateSocket (congestionTypeId);
+  sender->TraceConnectWithoutContext ("CongState", MakeCallback (&PointToPointEcnTest::CongState, this));
+  sender->SetSendCallback (MakeCallback (&PointToPointEcnTest::Send, this));
+  sender->Bind ();
+  sender->Connect (InetSocketAddress (interfaces.GetAddress (1), 5000));
+
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_rcvdBytes, m_totalBytes, "All the data must be received");
+  if (m_useEcn)
+    {
+      NS_TEST_EXPECT_MSG_GT (queue->GetNMarked (), 0, "The queue must mark packets CE");
+      NS_TEST_EXPECT_MSG_GT (m_cwrEntries, 0, "The sender must reduce its window on the ECN echoes");
+      NS_TEST_EXPECT_MSG_EQ (queue->GetTotalDroppedPackets (), 0, "DCTCP must not overflow the queue");
+      NS_TEST_EXPECT_MSG_LT (queue->GetMaxLength (), 5 * threshold, "DCTCP must keep the queue short");
+    }
+  else
+    {
+      NS_TEST_EXPECT_MSG_EQ (queue->GetNMarked (), 0, "Packets not ECN-capable must not be marked");
+      NS_TEST_EXPECT_MSG_EQ (m_cwrEntries, 0, "The sender must not react to ECN");
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \brief Test class for the binary event records of PointToPointNetDevice
+ * and TCP
+ *
+ * A TCP flow is sent from a CoCoA node, with a ring attached to its device
+ * and to its TCP stack: the device must record the enqueues, dequeues,
+ * transmissions and ACKs of the flow, and TCP its transmissions and ACKs,
+ * all under the flow id of the connection and in time order.
+ */
+class PointToPointEventTraceTest : public TestCase
+{
+public:
+  /**
+   * \brief Create the test
+   */
+  PointToPointEventTraceTest ();
+
+  /**
+   * \brief Run the test
+   */
+  virtual void DoRun (void);
+
+private:
+  /**
+   * \brief Fill the send buffer of the sender
+   * \param socket the sender
+   * \param available bytes available in the send buffer
+   */
+  void Send (Ptr<Socket> socket, uint32_t available);
+
+  /**
+   * \brief Read the data received
+   * \param socket the receiver
+   */
+  void Receive (Ptr<Socket> socket);
+
+  /**
+   * \brief Accept a connection
+   * \param socket the connected socket
+   * \param from the address of the peer
+   */
+  void Accept (Ptr<Socket> socket, const Address &from);
+
+  /**
+   * \brief Check the records of a ring
+   * \param ring the ring
+   * \param origin the origin of the records
+   * \param flowId the flow id of the connection
+   * \param events the events that must be recorded
+   */
+  void CheckRecords (Ptr<EventTraceRing> ring, EventTraceRecord::Origin origin, uint32_t flowId,
+                     std::vector<EventTraceRecord::Event> const &events);
+
+  uint32_t m_totalBytes;  //!< bytes to send
+  uint32_t m_sentBytes;   //!< bytes given to the sender
+  uint32_t m_rcvdBytes;   //!< bytes read by the receiver
+};
+
+PointToPointEventTraceTest::PointToPointEventTraceTest ()
+  : TestCase ("PointToPoint and TCP event records"),
+    m_totalBytes (100000),
+    m_sentBytes (0),
+    m_rcvdBytes (0)
+{
+}
+
+void
+PointToPointEventTraceTest::Send (Ptr<Socket> socket, uint32_t available)
+{
+  while (m_sentBytes < m_totalBytes && socket->GetTxAvailable () > 0)
+    {
+      uint32_t size = std::min (socket->GetTxAvailable (), m_totalBytes - m_sentBytes);
+      int sent = socket->Send (Create<Packet> (size));
+      if (sent <= 0)
+        {
+          break;
+        }
+      m_sentBytes += sent;
+    }
+}
+
+void
+PointToPointEventTraceTest::Receive (Ptr<Socket> socket)
+{
+  Ptr<Packet> p;
+  while ((p = socket->Recv ()))
+    {
+      m_rcvdBytes += p->GetSize ();
+    }
+}
+
+void
+PointToPointEventTraceTest::Accept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&PointToPointEventTraceTest::Receive, this));
+}
+
+void
+PointToPointEventTraceTest::CheckRecords (Ptr<EventTraceRing> ring, EventTraceRecord::Origin origin,
+                                          uint32_t flowId,
+                                          std::vector<EventTraceRecord::Event> const &events)
+{
+  NS_TEST_ASSERT_MSG_EQ (ring->GetDropped (), 0, "The ring must hold every record");
+  std::vector<EventTraceRecord> records (1 << 16);
+  records.resize (ring->Pop (records.data (), records.size ()));
+
+  std::vector<uint32_t> counts (EventTraceRecord::TIMEOUT + 1, 0);
+  for (uint32_t i = 0; i < records.size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (static_cast<uint32_t> (records[i].origin), static_cast<uint32_t> (origin),
+                             "Wrong origin of record " << i);
+      NS_TEST_EXPECT_MSG_EQ (records[i].source, ring->GetSource (), "Wrong source of record " << i);
+      NS_TEST_EXPECT_MSG_EQ (records[i].flowId, flowId, "Wrong flow id of record " << i);
+      NS_TEST_EXPECT_MSG_EQ ((i == 0 || records[i].time >= records[i - 1].time), true,
+                             "Record " << i << " out of time order");
+      NS_TEST_ASSERT_MSG_LT (static_cast<uint32_t> (records[i].event), counts.size (),
+                             "Unknown event in record " << i);
+      ++counts[records[i].event];
+    }
+  for (uint32_t i = 0; i < events.size (); ++i)
+    {
+      NS_TEST_EXPECT_MSG_GT (counts[events[i]], 0, "Event " << events[i] << " not recorded");
+    }
+}
+
+void
+PointToPointEventTraceTest::DoRun (void)
+{
+  // The device takes the nodes from the third on for CoCoA: the sender is
+  // the third one
+  NodeContainer nodes;
+  nodes.Create (3);
+  Ptr<Node> a = nodes.Get (2);
+  Ptr<Node> b = nodes.Get (1);
+  Ptr<PointToPointNetDevice> devA = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointNetDevice> devB = CreateObject<PointToPointNetDevice> ();
+  Ptr<PointToPointChannel> channel = CreateObject<PointToPointChannel> ();
+
+  channel->SetAttribute ("Delay", TimeValue (MilliSeconds (1)));
+  devA->Attach (channel);
+  devA->SetAddress (Mac48Address::Allocate ());
+  devA->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devA->SetDataRate (DataRate ("10Mbps"));
+  devB->Attach (channel);
+  devB->SetAddress (Mac48Address::Allocate ());
+  devB->SetQueue (CreateObject<DropTailQueue<Packet> > ());
+  devB->SetDataRate (DataRate ("10Mbps"));
+
+  a->AddDevice (devA);
+  b->AddDevice (devB);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+
+  NetDeviceContainer devices;
+  devices.Add (devA);
+  devices.Add (devB);
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
+
+  Ptr<EventTraceRing> deviceRing = Create<EventTraceRing> (1, 1 << 16);
+  Ptr<EventTraceRing> tcpRing = Create<EventTraceRing> (2, 1 << 16);
+  devA->SetEventTrace (deviceRing);
+  a->GetObject<TcpL4Protocol> ()->SetEventTrace (tcpRing);
+
+  Ptr<Socket> receiver = b->GetObject<TcpL4Protocol> ()->CreateSocket ();
+  receiver->Bind (InetSocketAddress (Ipv4Address::GetAny (), 5000));
+  receiver->Listen ();
+  receiver->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                               MakeCallback (&PointToPointEventTraceTest::Accept, this));
+
+  Ptr<Socket> sender = a->GetObject<TcpL4Protocol> ()->CreateSocket ();
+  sender->SetSendCallback (MakeCallback (&PointToPointEventTraceTest::Send, this));
+  sender->Bind ();
+  sender->Connect (InetSocketAddress (interfaces.GetAddress (1), 5000));
+
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  NS_TEST_EXPECT_MSG_EQ (m_rcvdBytes, m_totalBytes, "All the data must be received");
+
+  Address local;
+  sender->GetSockName (local);
+  uint32_t flowId = EventTraceRecord::FlowId (interfaces.GetAddress (0),
+                                              InetSocketAddress::ConvertFrom (local).GetPort (),
+                                              interfaces.GetAddress (1), 5000,
+                                              TcpL4Protocol::PROT_NUMBER);
+
+  std::vector<EventTraceRecord::Event> deviceEvents;
+  deviceEvents.push_back (EventTraceRecord::ENQ);
+  deviceEvents.push_back (EventTraceRecord::DEQ);
+  deviceEvents.push_back (EventTraceRecord::SENT);
+  deviceEvents.push_back (EventTraceRecord::ACK);
+  CheckRecords (deviceRing, EventTraceRecord::COCOA, flowId, deviceEvents);
+
+  std::vector<EventTraceRecord::Event> tcpEvents;
+  tcpEvents.push_back (EventTraceRecord::SENT);
+  tcpEvents.push_back (EventTraceRecord::ACK);
+  CheckRecords (tcpRing, EventTraceRecord::TCP, flowId, tcpEvents);
+
+  Simulator::Destroy ();
+}
+
 /**
  * \brief TestSuite for PointToPoint module
  */
@@ -117,6 +1255,14 @@ PointToPointTestSuite::PointToPointTestSuite ()
   : TestSuite ("devices-point-to-point", UNIT)
 {
   AddTestCase (new PointToPointTest, TestCase::QUICK);
+  AddTestCase (new PcapReplayTest, TestCase::QUICK);
+  AddTestCase (new PointToPointGsoTest, TestCase::QUICK);
+  AddTestCase (new PointToPointGsoTcpTest (false, "PointToPoint GSO under TCP"), TestCase::QUICK);
+  AddTestCase (new PointToPointGsoTcpTest (true, "PointToPoint GRO and GSO through a router"), TestCase::QUICK);
+  AddTestCase (new PointToPointGroTest, TestCase::QUICK);
+  AddTestCase (new PointToPointEcnTest (true, "PointToPoint ECN, DCTCP"), TestCase::QUICK);
+  AddTestCase (new PointToPointEcnTest (false, "PointToPoint ECN, NewReno without ECN"), TestCase::QUICK);
+  AddTestCase (new PointToPointEventTraceTest, TestCase::QUICK);
 }
 
 static PointToPointTestSuite g_pointToPointTestSuite; //!< The testsuite